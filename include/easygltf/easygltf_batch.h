@@ -0,0 +1,101 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+#include "easygltf_threadpool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	// Loads many assets at once on a shared CGLTFThreadPool.
+	// Every asset is a task, and inside it the big sections, external buffers/images and base64 blobs are tasks of their own,
+	// so a level with thousands of small files and one with a few huge ones both keep every core busy.
+	// Whenever a worker picks up a load it takes the highest priority asset that is still waiting, ties go in the order they were added.
+	// Assets can be added while others are loading.
+	class CGLTFBatchLoader
+	{
+	public:
+		typedef uint32_t TAssetId;
+
+		// Called on whichever thread finished the load, before the future becomes ready
+		typedef std::function<void(TAssetId id, bool ok, const CEasyGLTF& easygltf)> TCallback;
+
+		explicit CGLTFBatchLoader(CGLTFThreadPool& pool);
+
+		// Waits for everything still in flight
+		~CGLTFBatchLoader();
+
+		CGLTFBatchLoader(const CGLTFBatchLoader&) = delete;
+		CGLTFBatchLoader& operator=(const CGLTFBatchLoader&) = delete;
+
+		// .glb files go through LoadGLB_file, anything else through LoadGLTF_file
+		TAssetId AddFile(const std::string& filepath, int priority = 0, TCallback callback = nullptr);
+
+		// GLB blobs are recognized by their magic, anything else has to be a self contained .gltf
+		TAssetId AddMemory(std::vector<uint8_t> data, int priority = 0, TCallback callback = nullptr);
+
+		// Ready with the result of the load. Don't block on it from inside a pool task, use the callback there.
+		std::shared_future<bool> GetFuture(TAssetId id) const;
+
+		// Only valid once the asset's future is ready
+		const CEasyGLTF& GetAsset(TAssetId id) const;
+
+		size_t GetAssetCount() const;
+
+		// Blocks until every asset added so far finished, running pool tasks on the calling thread in the meantime
+		void WaitAll();
+
+		// Not owned, set on the CEasyGLTF of every asset added after this call, so it will see events from all pool threads at once
+		void SetLoadListener(IGLTFLoadListener* listener) { m_listener = listener; }
+
+	private:
+		struct SEntry
+		{
+			TAssetId id;
+			int priority;
+			std::string filepath;
+			std::vector<uint8_t> data; // for memory loads, freed once loaded
+			bool fromMemory;
+			TCallback callback;
+			CEasyGLTF easygltf;
+			std::promise<bool> promise;
+			std::shared_future<bool> future;
+		};
+
+		TAssetId Add(std::unique_ptr<SEntry> entry);
+		void LoadNext();
+		bool Load(SEntry& entry);
+
+		CGLTFThreadPool& m_pool;
+		IGLTFLoadListener* m_listener = nullptr;
+
+		mutable std::mutex m_mutex;
+		std::vector<std::unique_ptr<SEntry>> m_entries; // indexed by id
+		std::vector<SEntry*> m_waiting; // heap on priority, then id
+		std::atomic<size_t> m_inFlight;
+	};
+}
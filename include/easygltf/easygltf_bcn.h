@@ -0,0 +1,110 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "easygltf.h"
+#include "easygltf_image.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	enum class EGLTFBlockFormat
+	{
+		BC1, // RGB, 8 bytes per 4x4 block
+		BC3, // RGBA, BC1 color with BC4 alpha, 16 bytes
+		BC4, // R, 8 bytes
+		BC5, // RG, two BC4, 16 bytes
+		BC7 // RGBA, 16 bytes, modes 1, 5 and 6 are written
+	};
+
+	struct SGLTFBlockOptions
+	{
+		// 0 keeps the first endpoints it finds for every block, 1 refines them once, 2 refines until they stop getting better and lets
+		// BC7 try its two subset mode on the two most promising partitions, 3 searches around the endpoints and BC7 tries 16
+		// partitions. BC1 to BC5 get about 1.5x slower per step up to 2 and 3-6x slower at 3. BC7 gets about 8x slower from 1 to 2,
+		// for 4-5 dB more on photos, and 3x slower again at 3 for little more.
+		uint32_t quality = 2;
+		bool mipmaps = true; // box filtered down to 1x1, in linear light for sRGB images, renormalized for normal maps
+
+		// What CompressGLTFImages picks from material usage:
+		//  - base color, emissive and unused images get colorFormat, sRGB. BC1 turns into BC3 for images with alpha.
+		//  - normal maps get BC5, x and y only, z has to be reconstructed in the shader.
+		//  - metallic roughness images (occlusion packed in R or not) get dataFormat, linear. They keep their data in G and B,
+		//    which BC4 and BC5 can't hold without a swizzle.
+		//  - occlusion only images get BC4, linear.
+		EGLTFBlockFormat colorFormat = EGLTFBlockFormat::BC7;
+		EGLTFBlockFormat dataFormat = EGLTFBlockFormat::BC7;
+	};
+
+	struct SGLTFBlockLevel
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> blocks; // rows of 4x4 blocks, blocks past the edge repeat the last row and column
+	};
+
+	struct SGLTFBlockImage
+	{
+		int32_t image = -1; // the asset's image the blocks are for, -1 for bitmaps compressed on their own
+		EGLTFBlockFormat format = EGLTFBlockFormat::BC7;
+		bool srgb = false;
+		std::vector<SGLTFBlockLevel> levels; // empty if the image could not be decoded
+		double psnr = 0.0; // of the first level against the source, over the channels the format keeps
+	};
+
+	struct SGLTFBlockStats
+	{
+		uint32_t images = 0; // compressed
+		uint32_t failed = 0; // could not be decoded
+		uint64_t texels = 0; // every level
+		uint64_t blocks = 0;
+		uint64_t bytesBefore = 0; // RGBA8 for every level
+		uint64_t bytesAfter = 0;
+		double seconds = 0.0; // decoding, mips and encoding
+		double minPsnr = 0.0;
+		double averagePsnr = 0.0;
+
+		double GetMegatexelsPerSecond() const { return seconds > 0.0 ? texels / seconds * 1e-6 : 0.0; }
+		void Print(FILE* out = stdout) const;
+	};
+
+	uint32_t GetGLTFBlockBytes(EGLTFBlockFormat format);
+
+	// Format and color space of an image by what the materials use it for, see SGLTFBlockOptions
+	EGLTFBlockFormat GetGLTFImageBlockFormat(const SGLTFAsset& asset, int32_t image, const SGLTFBlockOptions& options, bool& srgb);
+
+	// Blocks are spread over the pool, the result does not depend on it
+	bool CompressGLTFBitmap(const SGLTFBitmap& bitmap, EGLTFBlockFormat format, bool srgb, SGLTFBlockImage& out,
+		const SGLTFBlockOptions& options = SGLTFBlockOptions(), CGLTFThreadPool* pool = nullptr);
+
+	// Decodes (easygltf_image.h) and compresses every image of the asset, out has one entry per image. False if an image could not
+	// be decoded, the others are compressed anyway.
+	bool CompressGLTFImages(const SGLTFAsset& asset, std::vector<SGLTFBlockImage>& out, SGLTFBlockStats& stats,
+		const SGLTFBlockOptions& options = SGLTFBlockOptions(), CGLTFThreadPool* pool = nullptr);
+
+	// A KTX2 container with the blocks, no supercompression
+	void EncodeGLTFKTX2(const SGLTFBlockImage& image, std::vector<uint8_t>& out);
+	bool WriteGLTFKTX2(const std::string& filepath, const SGLTFBlockImage& image);
+}
@@ -0,0 +1,73 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+#include "easygltf_validator.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	struct SGLTFMeshlet
+	{
+		uint32_t vertexOffset; // into SGLTFMeshletPrimitive::vertices
+		uint32_t triangleOffset; // into SGLTFMeshletPrimitive::triangles, in triangles
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+
+		float center[3]; // bounding sphere
+		float radius;
+
+		// Normal cone, the whole meshlet faces away from a camera at position p when
+		// dot(normalize(coneApex - p), coneAxis) >= coneCutoff. A cutoff of 1 means it can't be culled that way.
+		float coneApex[3];
+		float coneAxis[3];
+		float coneCutoff;
+	};
+
+	struct SGLTFMeshletPrimitive
+	{
+		int32_t mesh = -1;
+		int32_t primitive = -1;
+		std::vector<SGLTFMeshlet> meshlets;
+		std::vector<uint32_t> vertices; // vertex of the primitive for each meshlet vertex
+		std::vector<uint8_t> triangles; // three meshlet vertices per triangle, winding kept
+	};
+
+	struct SGLTFMeshletOptions
+	{
+		uint32_t maxVertices = 64; // at most 256
+		uint32_t maxTriangles = 124;
+	};
+
+	// Splits one triangle list primitive into meshlets. Triangles are added to a meshlet by how few new vertices they bring,
+	// then by how few unused triangles are left on their vertices, so meshlets stay compact and close the holes they leave.
+	// Strips and fans have to be turned into lists first (GenerateGLTFGeometry does that).
+	bool BuildGLTFMeshlets(const SGLTFAsset& asset, int32_t mesh, int32_t primitive, SGLTFMeshletPrimitive& out, const SGLTFMeshletOptions& options = SGLTFMeshletOptions());
+
+	// Every triangle list primitive of the asset, one primitive per task on the pool
+	bool BuildGLTFMeshlets(const SGLTFAsset& asset, std::vector<SGLTFMeshletPrimitive>& out, const SGLTFMeshletOptions& options = SGLTFMeshletOptions(), CGLTFThreadPool* pool = nullptr);
+
+	// Checks the meshlets against the primitive they came from: limits, local indices, every triangle covered exactly once
+	// with its winding and every vertex inside its bounding sphere
+	bool ValidateGLTFMeshlets(const SGLTFAsset& asset, const SGLTFMeshletPrimitive& meshlets, SGLTFValidationReport& report, const SGLTFMeshletOptions& options = SGLTFMeshletOptions());
+}
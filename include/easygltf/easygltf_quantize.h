@@ -0,0 +1,84 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdint>
+#include <cstdio>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	// Error bounds are the largest error an attribute may end up with. The smallest encoding that stays within the bound is used
+	// and attributes that don't fit any of them stay float. 0 means no bound, at the most precise encoding.
+	struct SGLTFQuantizationOptions
+	{
+		bool positions = true;
+		bool normals = true; // NORMAL and TANGENT
+		bool texcoords = true;
+
+		float positionError = 0.0f; // in mesh units, positions only have 16 bit
+		float normalError = 0.01f; // radians, snorm8 or snorm16
+		float texcoordError = 0.0f; // unorm8 or unorm16
+
+		// NORMAL as two octahedral components instead of three. Smaller, but it isn't part of KHR_mesh_quantization so the
+		// renderer has to decode it itself (DecodeGLTFOctahedral), leave it off for assets that have to stay standard.
+		bool octahedral = false;
+	};
+
+	struct SGLTFQuantizationReport
+	{
+		uint64_t bytesBefore = 0; // resident buffer data
+		uint64_t bytesAfter = 0;
+
+		uint32_t quantized = 0; // accessors
+		uint32_t skipped = 0; // vertex attributes that stayed float, shared with other uses, out of range or over the error bound
+		uint32_t nodesAdded = 0; // to hold the position transform where the node itself couldn't
+
+		double maxPositionError = 0.0; // largest distance to the original position, in mesh units
+		double maxNormalError = 0.0; // radians
+		double maxTexcoordError = 0.0;
+
+		uint64_t GetBytesSaved() const { return bytesBefore > bytesAfter ? bytesBefore - bytesAfter : 0; }
+		void Print(FILE* out = stdout) const;
+	};
+
+	// Rewrites float POSITION, NORMAL, TANGENT and TEXCOORD_n accessors of the asset in place the way KHR_mesh_quantization allows:
+	//  - POSITION becomes UNSIGNED_SHORT on a grid spanning the mesh bounds, meshes that share position accessors share the grid.
+	//    The grid's uniform scale and offset go into the matrix of every node using the mesh, or into a new child node taking over
+	//    the mesh when the node has children, a camera or is animated. Skinned, morphed, instanced and unused meshes are left alone
+	//    since the transform can't be moved out of their positions.
+	//  - NORMAL and TANGENT become normalized BYTE or SHORT.
+	//  - TEXCOORD_n in [0, 1] becomes normalized UNSIGNED_BYTE or UNSIGNED_SHORT.
+	// Accessors used for anything else as well are skipped. The new data goes into one new buffer and the float data that is no
+	// longer referenced gets dropped (PruneGLTFBuffers). Pass the compact asset of compact loads, its nodes and bounds are updated.
+	// Anything writing the asset back out has to list KHR_mesh_quantization in extensionsRequired.
+	bool QuantizeGLTFAsset(SGLTFAsset& asset, SGLTFQuantizationReport& report, const SGLTFQuantizationOptions& options = SGLTFQuantizationOptions(),
+		SGLTFCompactAsset* compact = nullptr, CGLTFThreadPool* pool = nullptr);
+
+	// Removes buffer views nothing refers to and compacts the resident buffers down to the views that are left, buffers without
+	// any views left are removed. Returns the bytes freed.
+	// Buffer and view indices change, so it can't run while a progressive load still streams into the asset.
+	uint64_t PruneGLTFBuffers(SGLTFAsset& asset);
+
+	// Inverse of the octahedral NORMAL encoding, x and y already normalized to [-1, 1]
+	void DecodeGLTFOctahedral(float x, float y, float out[3]);
+}
@@ -0,0 +1,194 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EGLTF
+{
+	struct SGLTFPrimitiveRef
+	{
+		int32_t mesh = -1;
+		int32_t primitive = -1;
+	};
+
+	enum class EGLTFAccessorUserType
+	{
+		INDICES, // element is the mesh, index the primitive
+		ATTRIBUTE,
+		TARGET, // a morph target attribute of the primitive
+		INSTANCING, // EXT_mesh_gpu_instancing, element is the node
+		INVERSE_BIND_MATRICES, // element is the skin
+		ANIMATION_INPUT, // element is the animation, index the sampler
+		ANIMATION_OUTPUT
+	};
+
+	struct SGLTFAccessorUser
+	{
+		EGLTFAccessorUserType type;
+		int32_t element;
+		int32_t index; // -1 where there is nothing below the element
+	};
+
+	enum class EGLTFTopologyIssueType
+	{
+		MULTIPLE_PARENTS, // node is a child of parent too, the first parent in node order is the one that counts
+		BAD_CHILD, // parent lists node as a child, but there is no such node
+		CYCLE // node and parent are part of a loop, none of the nodes in it are in the depth first order
+	};
+
+	struct SGLTFTopologyIssue
+	{
+		EGLTFTopologyIssueType type;
+		int32_t node;
+		int32_t parent;
+	};
+
+	// [begin, end) into CGLTFTopology::GetOrder()
+	struct SGLTFNodeRange
+	{
+		uint32_t begin = 0;
+		uint32_t end = 0;
+	};
+
+	// Who refers to whom in an asset, so none of the usual questions needs a scan over all nodes: parents, a depth first order in
+	// which every subtree is a contiguous range, nodes, meshes and materials by name, and the users of every mesh, material, skin
+	// and accessor. Lookups are O(1) or linear in what they return. References to elements that don't exist are left out.
+	// Edits made through the Set* functions go to the asset and the index at once, at a cost linear in the users of the elements
+	// involved. Elements appended to the asset directly are picked up by Sync, anything else done to the asset behind the index's
+	// back needs another Build. Hierarchy edits only mark the depth first order stale, it is rebuilt in one go by the next query
+	// that needs it; call UpdateOrder after editing when several threads are going to query at once.
+	class CGLTFTopology
+	{
+	public:
+		// Compact assets are read from compact when the asset has no nodes, their nodes can't be edited then
+		void Build(const SGLTFAsset& asset, const SGLTFCompactAsset* compact = nullptr);
+		void Clear();
+
+		// Indexes nodes, meshes, materials, skins, accessors and animations added to the end of the asset since the last Build or
+		// Sync. False, with the index untouched, if a section got shorter.
+		bool Sync(const SGLTFAsset& asset);
+
+		// -1 for roots and nodes that are out of range
+		int32_t GetParent(int32_t node) const { return node >= 0 && static_cast<size_t>(node) < m_parents.size() ? m_parents[node] : -1; }
+		size_t GetNodeCount() const { return m_parents.size(); }
+
+		// Roots in node order, each followed by its subtree, children in the order of their parent's list
+		const std::vector<int32_t>& GetOrder() const;
+		// Nodes without a parent, in node order
+		const std::vector<int32_t>& GetRoots() const;
+		// The node itself and everything below it, empty for nodes in a cycle
+		SGLTFNodeRange GetSubtree(int32_t node) const;
+		// 0 for roots, -1 for nodes in a cycle
+		int32_t GetDepth(int32_t node) const;
+		// True for the node itself as well
+		bool IsAncestor(int32_t ancestor, int32_t node) const;
+		const std::vector<SGLTFTopologyIssue>& GetIssues() const;
+
+		// One of the elements with that name, -1 if there is none. Unnamed elements are not indexed.
+		int32_t FindNode(const std::string& name) const { return Find(m_nodeNames, name); }
+		int32_t FindMesh(const std::string& name) const { return Find(m_meshNames, name); }
+		int32_t FindMaterial(const std::string& name) const { return Find(m_materialNames, name); }
+		// All of them, appended to out in no particular order
+		void FindNodes(const std::string& name, std::vector<int32_t>& out) const { FindAll(m_nodeNames, name, out); }
+
+		// Ascending after a Build, in no particular order once edits came in
+		const std::vector<int32_t>& GetMeshUsers(int32_t mesh) const { return Get(m_meshUsers, mesh); } // nodes
+		const std::vector<int32_t>& GetSkinUsers(int32_t skin) const { return Get(m_skinUsers, skin); } // nodes
+		const std::vector<SGLTFPrimitiveRef>& GetMaterialUsers(int32_t material) const { return Get(m_materialUsers, material); }
+		const std::vector<SGLTFAccessorUser>& GetAccessorUsers(int32_t accessor) const { return Get(m_accessorUsers, accessor); }
+
+		// Appends a node without a parent, returns its index
+		int32_t AddNode(SGLTFAsset& asset, const std::string& name = "");
+		// Moves node under parent, at the end of its children, -1 makes it a root. False if that would make a cycle.
+		bool SetParent(SGLTFAsset& asset, int32_t node, int32_t parent);
+		bool SetNodeMesh(SGLTFAsset& asset, int32_t node, int32_t mesh);
+		bool SetNodeSkin(SGLTFAsset& asset, int32_t node, int32_t skin);
+		bool SetNodeName(SGLTFAsset& asset, int32_t node, const std::string& name);
+		bool SetMeshName(SGLTFAsset& asset, int32_t mesh, const std::string& name);
+		bool SetMaterialName(SGLTFAsset& asset, int32_t material, const std::string& name);
+		bool SetPrimitiveMaterial(SGLTFAsset& asset, int32_t mesh, int32_t primitive, int32_t material);
+		bool SetPrimitiveIndices(SGLTFAsset& asset, int32_t mesh, int32_t primitive, int32_t accessor);
+		// accessor -1 removes the attribute
+		bool SetPrimitiveAttribute(SGLTFAsset& asset, int32_t mesh, int32_t primitive, const std::string& attribute, int32_t accessor);
+
+		// Rebuilds the depth first order if the hierarchy changed since it was last built
+		void UpdateOrder() const;
+
+	private:
+		typedef std::unordered_multimap<std::string, int32_t> TNameMap;
+
+		static int32_t Find(const TNameMap& names, const std::string& name);
+		static void FindAll(const TNameMap& names, const std::string& name, std::vector<int32_t>& out);
+		static void AddName(TNameMap& names, const std::string& name, int32_t element);
+		static void RemoveName(TNameMap& names, const std::string& name, int32_t element);
+
+		template<typename T>
+		static const std::vector<T>& Get(const std::vector<std::vector<T>>& users, int32_t element)
+		{
+			static const std::vector<T> none;
+			return element >= 0 && static_cast<size_t>(element) < users.size() ? users[element] : none;
+		}
+
+		void Link(int32_t parent, int32_t child);
+		void Unlink(int32_t child);
+		void AddNodeUsers(int32_t node, int32_t mesh, int32_t skin, const std::map<std::string, int32_t>* instancing);
+		void AddPrimitiveUsers(const SGLTFAsset_Prop_Mesh_Primitive& primitive, int32_t mesh, int32_t index);
+		void GrowUsers(const SGLTFAsset& asset);
+		void AddElements(const SGLTFAsset& asset);
+		bool CheckNode(const SGLTFAsset& asset, int32_t node) const;
+		bool CheckPrimitive(const SGLTFAsset& asset, int32_t mesh, int32_t primitive) const;
+
+		// children of the parent that counts, as lists in the order the parent has them
+		std::vector<int32_t> m_parents;
+		std::vector<int32_t> m_firstChild;
+		std::vector<int32_t> m_lastChild;
+		std::vector<int32_t> m_nextSibling;
+		std::vector<int32_t> m_previousSibling;
+		std::vector<SGLTFTopologyIssue> m_issues; // MULTIPLE_PARENTS and BAD_CHILD, what Build and Sync found
+		bool m_compact = false;
+
+		TNameMap m_nodeNames;
+		TNameMap m_meshNames;
+		TNameMap m_materialNames;
+
+		std::vector<std::vector<int32_t>> m_meshUsers;
+		std::vector<std::vector<int32_t>> m_skinUsers;
+		std::vector<std::vector<SGLTFPrimitiveRef>> m_materialUsers;
+		std::vector<std::vector<SGLTFAccessorUser>> m_accessorUsers;
+		size_t m_meshCount = 0; // indexed so far, the user lists can be longer
+		size_t m_materialCount = 0;
+		size_t m_skinCount = 0;
+		size_t m_animationCount = 0;
+
+		// rebuilt on demand
+		mutable bool m_orderStale = true;
+		mutable std::vector<int32_t> m_order;
+		mutable std::vector<int32_t> m_roots;
+		mutable std::vector<SGLTFNodeRange> m_subtrees;
+		mutable std::vector<int32_t> m_depths;
+		mutable std::vector<SGLTFTopologyIssue> m_allIssues; // m_issues and the cycles
+	};
+}
@@ -0,0 +1,586 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <memory>
+
+// rapidjson forward declarations needed.
+// The fwd.h file provided is not being used because thats an additional library header having to be bundled and most of whats in there is useless to this header
+namespace rapidjson
+{
+	template<typename CharType> struct UTF8;
+
+	class CrtAllocator;
+
+	template <typename BaseAllocator>
+	class MemoryPoolAllocator;
+
+	template <typename Encoding, typename Allocator, typename StackAllocator>
+	class GenericDocument;
+
+	template <typename Encoding, typename Allocator>
+	class GenericValue;
+
+	typedef GenericDocument<UTF8<char>, MemoryPoolAllocator<CrtAllocator>, CrtAllocator> Document;
+	typedef GenericValue<UTF8<char>, MemoryPoolAllocator<CrtAllocator>> Value;
+}
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+	class IGLTFFileSystem;
+	class CGLTFLoadScope;
+	class CGLTFTopology;
+
+	struct SGLB_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t length;
+	};
+
+	struct SGLB_CHUNK
+	{
+		uint32_t chunkLength;
+		uint32_t chunkType;
+		std::vector<uint8_t> chunkData;
+	};
+
+	struct SGLTFAsset_Prop_Asset
+	{
+		std::string version;
+		std::string generator;
+		std::string minVersion;
+		std::string copyright;
+	};
+
+	struct SGLTFAsset_Prop_Scene
+	{
+		std::vector<int32_t> nodes;
+	};
+
+	struct SGLTFAsset_Prop_Node
+	{
+		std::vector<int32_t> children;
+		std::array<double, 16> matrix; // this is calculated in cases where translation, rotation and scale properties are given as seperate attribs
+		int32_t mesh = -1;
+		int32_t skin = -1;
+		int32_t camera = -1;
+		std::string name;
+		std::map<std::string, int32_t> instancing; // EXT_mesh_gpu_instancing attributes (TRANSLATION, ROTATION, SCALE, ...), accessor each
+	};
+
+	typedef std::map<std::string, int32_t> TGLTFAsset_Prop_Mesh_Primitive_Attributes;
+
+	struct SGLTFAsset_Prop_Mesh_Primitive
+	{
+		int32_t mode = -1;
+		int32_t indices = -1;
+		int32_t material = -1;
+		TGLTFAsset_Prop_Mesh_Primitive_Attributes attributes; // the specs were not clear on what these are or how many there can be...
+		std::vector<TGLTFAsset_Prop_Mesh_Primitive_Attributes> targets;
+	};
+
+	struct SGLTFAsset_Prop_Mesh
+	{
+		std::string name;
+		std::vector<SGLTFAsset_Prop_Mesh_Primitive> primitives;
+		std::vector<double> weights;
+	};
+
+	// Sizes, offsets and counts into buffers are 64 bit, external .bin files can be larger than 4 GB
+	struct SGLTFAsset_Prop_Buffer
+	{
+		int64_t byteLength = -1;
+		std::string uri; // as written in the file, empty for the glb binary chunk and once a data uri is decoded
+		std::vector<uint8_t> data;
+	};
+
+	struct SGLTFAsset_Prop_BufferView
+	{
+		int32_t buffer = -1;
+		int64_t byteOffset = -1;
+		int64_t byteLength = -1;
+		int32_t byteStride = -1;
+		int32_t target = -1;
+	};
+
+	struct SGLTFAsset_Prop_Accessor_Sparse
+	{
+		int64_t count = -1;
+		int32_t values = -1; // bufferViewindex
+		std::pair<int32_t, int32_t> indices; // bufferView, componentType
+	};
+
+	struct SGLTFAsset_Prop_Accessor
+	{
+		int32_t bufferView = -1;
+		int64_t byteOffset = -1;
+		std::string type;
+		int32_t componentType = -1;
+		int64_t count = -1;
+		bool normalized = false; // integer components map to [0, 1] or [-1, 1]
+		std::vector<double> min;
+		std::vector<double> max;
+		SGLTFAsset_Prop_Accessor_Sparse sparse;
+	};
+	
+	struct SGLTFAsset_Prop_Material_Texture
+	{
+		int32_t index = -1;
+		int32_t texCoord = -1; // This is the number that determines theTEXCOORD_<n>, 1 or 0. 0 is the default
+	};
+
+	struct SGLTFAsset_Prop_Material_Texture_NT
+	{
+		double scale;
+		int32_t index = -1;
+		int32_t texCoord = -1;
+	};
+
+	struct SGLTFAsset_Prop_Material_Texture_OT
+	{
+		double strength;
+		int32_t index = -1;
+		int32_t texCoord = -1;
+	};
+
+	// GLTF uses the Metallic-Roughness Model from Physically-based rendering
+	struct SGLTFAsset_Prop_Material_MRM
+	{
+		std::array<double, 4> baseColorFactor; // RGBA
+		SGLTFAsset_Prop_Material_Texture baseColorTexture;
+		SGLTFAsset_Prop_Material_Texture metallicRoughnessTexture;
+		double metallicFactor;
+		double roughnessFactor;
+	};
+
+	struct SGLTFAsset_Prop_Material
+	{
+		std::string name;
+		SGLTFAsset_Prop_Material_MRM pbrMetallicRoughness;
+		std::array<double, 3> emissiveFactor;
+		SGLTFAsset_Prop_Material_Texture_OT occlusionTexture;
+		SGLTFAsset_Prop_Material_Texture_NT normalTexture;
+		SGLTFAsset_Prop_Material_Texture emissiveTexture;
+	};
+
+	struct SGLTFAsset_Prop_Texture
+	{
+		int32_t source = -1;
+		int32_t sampler = -1;
+	};
+
+	enum class SGLTFAsset_Prop_Camera_Type
+	{
+		PERSPECTIVE,
+		ORTHOGRAPHIC
+	};
+
+	struct SGLTFAsset_Prop_Camera
+	{
+		SGLTFAsset_Prop_Camera_Type type;
+		double zfar = 0.0; // 0 for infinite, only perspective cameras can have that
+		double znear;
+
+		// TODO: std::optional
+		
+		// Meaning of these two variables change according to type
+		             // orth	|	perspective
+
+		double val0; // xmag	|	aspectRatio
+		double val1; // ymag	|	yfov
+	};
+
+	struct SGLTFAsset_Prop_Image
+	{
+		std::string uri; // as written in the file, empty once a data uri is decoded
+		std::vector<uint8_t> data;
+		// Or
+		int32_t bufferView = -1;
+		std::string mimeType;
+	};
+
+	struct SGLTFAsset_Prop_Skin
+	{
+		int32_t inverseBindMatrices = -1;
+		std::vector<int32_t> joints;
+		int32_t skeleton = -1;
+		std::string name;
+	};
+
+	enum class EGLTFAsset_Prop_Animation_Channel_Target_Type
+	{
+		TRANSLATION,
+		ROTATION,
+		SCALE,
+		WEIGHTS
+	};
+
+	struct SGLTFAsset_Prop_Animation_Channel_Target
+	{
+		int32_t node = -1;
+		EGLTFAsset_Prop_Animation_Channel_Target_Type path;
+	};
+
+	struct SGLTFAsset_Prop_Animation_Channel
+	{
+		SGLTFAsset_Prop_Animation_Channel_Target target;
+		int32_t sampler = -1;
+	};
+
+	enum class EGLTFAsset_Prop_Animation_Sampler_Type
+	{
+		LINEAR,
+		STEP,
+		CUBICSPLINE
+	};
+
+	struct SGLTFAsset_Prop_Animation_Sampler
+	{
+		int32_t input = -1;
+		int32_t output = -1;
+		EGLTFAsset_Prop_Animation_Sampler_Type interpolation;
+	};
+
+	struct SGLTFAsset_Prop_Animation
+	{
+		std::string name;
+		std::vector<SGLTFAsset_Prop_Animation_Channel> channels;
+		std::vector<SGLTFAsset_Prop_Animation_Sampler> samplers;
+	};
+
+	struct SGLTFAsset_Prop_Sampler
+	{
+		int32_t magFiler = -1;
+		int32_t minFiler = -1;
+		int32_t wrapS = -1;
+		int32_t wrapT = -1;
+	};
+
+	struct SGLTFAsset
+	{
+		SGLTFAsset_Prop_Asset asset;
+		std::string scene; // default scene
+		std::vector<SGLTFAsset_Prop_Scene> scenes;
+		std::vector<SGLTFAsset_Prop_Mesh> meshes;
+		std::vector<SGLTFAsset_Prop_Buffer> buffers;
+		std::vector<SGLTFAsset_Prop_BufferView> bufferViews;
+		std::vector<SGLTFAsset_Prop_Accessor> accessors;
+		std::vector<SGLTFAsset_Prop_Material> materials;
+		std::vector<SGLTFAsset_Prop_Texture> textures;
+		std::vector<SGLTFAsset_Prop_Camera> cameras;
+		std::vector<SGLTFAsset_Prop_Image> images;
+		std::vector<SGLTFAsset_Prop_Skin> skins;
+		std::vector<SGLTFAsset_Prop_Animation> animations;
+		std::vector<SGLTFAsset_Prop_Sampler> samplers;
+		std::vector<SGLTFAsset_Prop_Node> nodes;
+	};
+
+	// Compact mode (CEasyGLTF::SetCompact) keeps nodes, accessor bounds and morph weights here instead of in SGLTFAsset.
+	// Everything is float, node transforms stay TRS (see easygltf_compact.h for the matrix) and the variable length parts
+	// are pooled into flat arrays, so a node is 68 bytes without a single allocation of its own.
+	struct SGLTFCompact_Range
+	{
+		uint32_t offset = 0;
+		uint32_t count = 0;
+	};
+
+	struct SGLTFCompact_Node
+	{
+		float translation[3] = { 0.0f, 0.0f, 0.0f };
+		float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; // quaternion, xyzw
+		float scale[3] = { 1.0f, 1.0f, 1.0f };
+		int32_t mesh = -1;
+		int32_t skin = -1;
+		int32_t camera = -1;
+		SGLTFCompact_Range children; // into SGLTFCompactAsset::children
+		SGLTFCompact_Range name; // into SGLTFCompactAsset::names, not null terminated
+	};
+
+	// EXT_mesh_gpu_instancing of a compact node, only the few nodes that have it get one
+	struct SGLTFCompact_Instancing
+	{
+		int32_t node = -1;
+		std::map<std::string, int32_t> attributes;
+	};
+
+	struct SGLTFCompactAsset
+	{
+		std::vector<SGLTFCompact_Node> nodes;
+		std::vector<int32_t> children;
+		std::vector<char> names;
+		std::vector<SGLTFCompact_Instancing> instancing; // in node order
+
+		std::vector<SGLTFCompact_Range> accessorMin; // per accessor, into bounds
+		std::vector<SGLTFCompact_Range> accessorMax;
+		std::vector<float> bounds;
+
+		std::vector<SGLTFCompact_Range> meshWeights; // per mesh, into weights
+		std::vector<float> weights;
+	};
+
+	enum class EGLTFLoadEventCategory
+	{
+		SECTION, // a top level gltf property ParseGLTF converts, the name is the property name ("buffers", "nodes", ...)
+		FILE, // a file read from disk, the name is the path
+		JSON, // rapidjson parsing the document
+		GLB // splitting a glb into its chunks
+	};
+
+	struct SGLTFLoadEvent
+	{
+		EGLTFLoadEventCategory category;
+		const char* name; // only valid for the duration of the callback
+		uint64_t beginNs; // steady clock
+		uint64_t endNs; // 0 in OnEventBegin
+		uint64_t bytesRead; // from disk, including nested file events
+		uint64_t bytesDecoded; // output of base64 decoding
+		uint64_t allocations; // delta of IGLTFLoadListener::GetAllocationCount over the event
+		uint64_t elements; // elements converted, for sections
+	};
+
+	// Receives scoped events for everything a load goes through. Without a listener set, none of this costs more than a null check.
+	class IGLTFLoadListener
+	{
+	public:
+		virtual ~IGLTFLoadListener() {}
+
+		virtual void OnEventBegin(const SGLTFLoadEvent& /*event*/) {}
+		virtual void OnEventEnd(const SGLTFLoadEvent& event) = 0;
+
+		// Return a running allocation count if the application keeps one (a replaced operator new for instance), its sampled around every event
+		virtual uint64_t GetAllocationCount() { return 0; }
+	};
+
+	// What CEasyGLTF::Reload found different from the previous load, as indices into the reloaded asset. New elements count as changed.
+	// Changes are followed through references, a mesh is listed when one of its accessors' buffers changed and a material when one
+	// of its textures' images did, so whatever has to be uploaded again is right there.
+	struct SGLTFChangeSet
+	{
+		bool any = false;
+		std::vector<int32_t> buffers;
+		std::vector<int32_t> bufferViews;
+		std::vector<int32_t> accessors;
+		std::vector<int32_t> images;
+		std::vector<int32_t> samplers;
+		std::vector<int32_t> textures;
+		std::vector<int32_t> materials;
+		std::vector<int32_t> meshes;
+		std::vector<int32_t> cameras;
+		std::vector<int32_t> nodes;
+		std::vector<int32_t> skins;
+		std::vector<int32_t> animations;
+		std::vector<int32_t> scenes;
+	};
+
+	// Narrows a load down to part of an asset (CEasyGLTF::SetLoadFilter). The roots and everything they use get converted: the nodes
+	// below them, meshes, accessors, bufferViews, materials, textures, samplers and images. Ancestors of the selected nodes and skin
+	// joints come along for their transforms only, their meshes do not. Without any roots, everything in the enabled sections is a root.
+	// Sections keep their size so indices stay valid, elements outside the selection are left default constructed.
+	struct SGLTFLoadFilter
+	{
+		std::vector<int32_t> scenes;
+		std::vector<std::string> sceneNames;
+		std::vector<int32_t> nodes;
+		std::vector<std::string> nodeNames;
+		std::vector<int32_t> meshes;
+		std::vector<std::string> meshNames;
+
+		// whole sections, off leaves them out even when something selected refers to them
+		bool loadMeshes = true;
+		bool loadMaterials = true; // with their textures and samplers
+		bool loadImages = true;
+		bool loadSkins = true;
+		bool loadAnimations = true; // with roots, only the ones animating a selected node
+
+		// external buffers are only read over the byte ranges the selected bufferViews cover, the views get offsets into what was read
+		bool rangedReads = true;
+	};
+
+	// What a filtered load converted, a flag per element of the SGLTFAsset section with the same name. Empty after an unfiltered load.
+	struct SGLTFLoadSelection
+	{
+		std::vector<uint8_t> scenes;
+		std::vector<uint8_t> nodes;
+		std::vector<uint8_t> meshes;
+		std::vector<uint8_t> accessors;
+		std::vector<uint8_t> bufferViews;
+		std::vector<uint8_t> buffers;
+		std::vector<uint8_t> materials;
+		std::vector<uint8_t> textures;
+		std::vector<uint8_t> samplers;
+		std::vector<uint8_t> images;
+		std::vector<uint8_t> skins;
+		std::vector<uint8_t> animations;
+
+		// True for everything when the load was not filtered
+		static bool Has(const std::vector<uint8_t>& section, size_t index) { return section.empty() || (index < section.size() && section[index]); }
+	};
+
+	class CEasyGLTF
+	{
+	public:
+		CEasyGLTF();
+		~CEasyGLTF();
+
+		bool LoadGLTF_file(const std::string& filepath);
+		bool LoadGLTF_memory(const std::vector<uint8_t>& buffer);
+
+		bool LoadGLB_memory(const std::vector<uint8_t>& buffer);
+		bool LoadGLB_file(const std::string& filepath);
+
+		const SGLTFAsset& GetAssetInstance() const { return m_asset; }
+		SGLTFAsset& GetAssetInstance() { return m_asset; }
+
+		// Only filled in compact mode
+		const SGLTFCompactAsset& GetCompactAsset() const { return m_compactAsset; }
+
+		// Not owned, nullptr to stop listening
+		void SetLoadListener(IGLTFLoadListener* listener) { m_listener = listener; }
+
+		// Not owned. With a pool, large sections are converted in parallel, the listener then has to cope with events from worker threads.
+		// nullptr (the default) converts everything on the calling thread.
+		void SetThreadPool(CGLTFThreadPool* pool) { m_threadPool = pool; }
+
+		// Leaves the data of buffers and images that have a uri empty (the uri is still filled in), for loaders that stream them in themselves.
+		// Off by default.
+		void SetDeferResources(bool defer) { m_deferResources = defer; }
+
+		// Keeps a hash of every json element and a stamp (size, mtime, content hash) of every file read, which is what lets Reload
+		// skip the parts that did not change. Costs an extra pass over the json per load, off by default.
+		void SetTrackChanges(bool track) { m_trackChanges = track; }
+
+		// Nodes, accessor min/max and mesh weights go into GetCompactAsset() instead of the SGLTFAsset, whose versions stay empty.
+		// Meant for scenes with millions of nodes. Off by default.
+		void SetCompact(bool compact) { m_compact = compact; }
+
+		// Runs ValidateGLB and ValidateGLTFAsset (easygltf_validator.h) on every load, which then fails on errors after printing them.
+		// For files from untrusted sources, off by default.
+		void SetValidation(bool validate) { m_validate = validate; }
+
+		// Loads the file of the last LoadGLTF_file/LoadGLB_file call again, returns true right away if none of the files it read changed.
+		// With change tracking, elements whose json did not change are taken over from the previous load instead of being converted,
+		// buffers and images whose files did not change are not read again. Without it everything is loaded and reported as changed.
+		bool Reload(SGLTFChangeSet* changes = nullptr);
+
+		// Converts only part of the asset on every following load, see SGLTFLoadFilter. GetLoadSelection tells what made it in.
+		void SetLoadFilter(const SGLTFLoadFilter& filter) { m_filter = filter; m_filtered = true; }
+		void ClearLoadFilter() { m_filter = SGLTFLoadFilter(); m_filtered = false; }
+		const SGLTFLoadSelection& GetLoadSelection() const { return m_selection; }
+
+		// Drops the loaded asset and everything kept around for reuse or Reload, settings stay as they are
+		void Reset();
+
+		// For loading a stream of assets on one instance. Every load then clears the previous asset instead of freeing it, so its vectors
+		// and strings, the json parser's pools and the file buffers keep their memory and a load of a similar asset barely allocates.
+		// Holds on to roughly the biggest asset seen so far, call Reset to give it back. Off by default.
+		void SetReuseMemory(bool reuse) { m_reuseMemory = reuse; }
+
+		// Builds a CGLTFTopology (easygltf_topology.h) of every asset loaded, nullptr from GetTopology without. Takes one pass over
+		// the nodes and meshes at the end of the load, off by default.
+		void SetBuildTopology(bool build);
+		const CGLTFTopology* GetTopology() const { return m_topology.get(); }
+		CGLTFTopology* GetTopology() { return m_topology.get(); }
+
+		// Not owned. Where *_file loads, their external uris and Reload's checks read from, see easygltf_vfs.h.
+		// nullptr (the default) reads from disk. Files a backend can hand out a view of are parsed in place instead of being copied.
+		void SetFileSystem(IGLTFFileSystem* fileSystem) { m_fileSystem = fileSystem; }
+		IGLTFFileSystem& GetFileSystem() const;
+
+		// What the uris of the last *_file load resolve against, empty for memory loads
+		const std::string& GetDirectory() const { return m_path; }
+
+	private:
+		struct SFileStamp
+		{
+			uint64_t size;
+			int64_t mtime;
+			uint64_t hash;
+		};
+
+		// What the load before a Reload left behind
+		struct SReload
+		{
+			SGLTFAsset previous;
+			std::map<std::string, std::vector<uint64_t>> elementHashes;
+			std::map<std::string, SFileStamp> fileStamps;
+			std::vector<uint8_t> binaryBuffer;
+			uint64_t binaryHash;
+			SGLTFLoadSelection selection; // elements the previous load left out can't be taken over
+			bool converting; // false while the previous asset is still whole
+			SGLTFChangeSet changes;
+		};
+
+		void BeginLoad(const std::string& filepath, bool isGLB);
+		void ReleaseScratch(std::vector<uint8_t>& buffer);
+		bool ReadSourceFile(const std::string& filepath, const uint8_t*& data, size_t& size);
+		bool ParseJson(const uint8_t* data, size_t size);
+		bool ParseJsonSerial(const uint8_t* data, size_t size);
+		bool ParseGLTF(const rapidjson::Value& document);
+		bool ParseGLB(const uint8_t* data, size_t size);
+		bool ParseCompactNodes(const rapidjson::Value& document);
+		void CompactAccessorsAndMeshes();
+
+		std::vector<uint8_t> TrackSection(const rapidjson::Value& document, const char* section);
+		bool IsSourceUnchanged(const std::string& uri, bool isBuffer);
+		bool IsFileUnchanged(const std::string& filepath);
+		void StampFile(const std::string& filepath, const uint8_t* data, size_t size);
+		template<typename T>
+		void StampSources(const std::vector<T>& out, const std::vector<uint8_t>& jsonUnchanged, const std::vector<uint8_t>& unchanged, bool isBuffer, std::vector<int32_t>* changes);
+
+		SGLTFAsset m_asset;
+		SGLTFCompactAsset m_compactAsset;
+		bool m_compact = false;
+
+		std::string m_path; // For non-embedded .gltf files, also, std::optional
+
+		std::vector<uint8_t> m_binaryBuffer; // For glb file's binary chunk, also, std::optional here as well
+
+		IGLTFLoadListener* m_listener = nullptr;
+		CGLTFLoadScope* m_loadScope = nullptr; // the glb event while ParseGLB runs, what the json and the sections nest in
+		CGLTFThreadPool* m_threadPool = nullptr;
+		IGLTFFileSystem* m_fileSystem = nullptr;
+		bool m_deferResources = false;
+		bool m_validate = false;
+
+		bool m_trackChanges = false;
+		std::string m_filepath; // of the last *_file load, for Reload
+		bool m_filepathIsGLB = false;
+		std::map<std::string, std::vector<uint64_t>> m_elementHashes; // per section
+		std::map<std::string, SFileStamp> m_fileStamps; // by path
+		uint64_t m_binaryHash = 0;
+		SReload* m_reload = nullptr; // only during Reload
+
+		SGLTFLoadFilter m_filter;
+		bool m_filtered = false;
+		SGLTFLoadSelection m_selection; // of the last load
+
+		std::unique_ptr<CGLTFTopology> m_topology;
+
+		bool m_reuseMemory = false;
+		SGLTFAsset m_spare; // the asset before the current one, its elements get recycled by the next load
+		std::vector<uint8_t> m_fileBuffer; // the .gltf/.glb file, unless the file system has a view of it
+		std::vector<char> m_jsonPool; // rapidjson's value and parse stack memory
+		std::vector<char> m_jsonStack;
+	};
+}
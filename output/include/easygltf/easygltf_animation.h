@@ -0,0 +1,131 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	// Local transform of a node, what sampling an animation writes into
+	struct SGLTFNodePose
+	{
+		std::array<float, 3> translation;
+		std::array<float, 4> rotation; // x, y, z, w
+		std::array<float, 3> scale;
+		std::vector<float> weights; // morph target weights
+	};
+
+	// The transforms the node matrices describe and the default weights of their meshes, one pose per node
+	void GetGLTFRestPose(const SGLTFAsset& asset, std::vector<SGLTFNodePose>& poses);
+
+	// Samples an animation as it is stored in the asset, at a time clamped to the animation's range. Only the nodes it has channels
+	// for are written. Reads the accessors on every call, meant for tools and as the reference for the compressed version.
+	bool SampleGLTFAnimation(const SGLTFAsset& asset, int32_t animation, float time, std::vector<SGLTFNodePose>& poses);
+
+	enum class EGLTFTrackFormat : uint8_t
+	{
+		IDENTITY, // no data, translation 0, rotation identity, scale 1, weights 0
+		CONSTANT, // a single value
+		ANIMATED
+	};
+
+	struct SGLTFCompressedTrack
+	{
+		int32_t node = -1;
+		EGLTFAsset_Prop_Animation_Channel_Target_Type path;
+		EGLTFTrackFormat format;
+		bool step = false; // STEP interpolation, linear otherwise
+		bool packed = false; // animated rotations in smallest-three, float otherwise
+		bool exact = false; // key times as floats in exactTimes, for curves the 16 bit times are too coarse for
+		uint32_t width = 0; // floats per value: 3, 4 or the number of morph targets
+		uint32_t keyCount = 0;
+		uint32_t timeOffset = 0; // into times or exactTimes, keyCount of them
+		uint32_t valueOffset = 0; // into rotations (3 per key) for packed rotations, into values (width per key) for everything else
+	};
+
+	// Key times are 16 bit fractions of the duration. Animated rotations are smallest-three quaternions in 48 bits, the index of the
+	// largest component in 2 bits and the other three in 15 bits each, everything else stays float. Tracks whose share of the error
+	// is finer than that keep float rotations or float times (in the same units) instead.
+	struct SGLTFCompressedAnimation
+	{
+		std::string name;
+		float start = 0.0f; // seconds
+		float duration = 0.0f;
+		std::vector<SGLTFCompressedTrack> tracks;
+		std::vector<uint16_t> times;
+		std::vector<float> exactTimes;
+		std::vector<uint16_t> rotations;
+		std::vector<float> values;
+
+		uint64_t GetSize() const; // bytes of the tracks and their data
+	};
+
+	struct SGLTFAnimationCompressionOptions
+	{
+		// Largest drift a node may end up with, in asset units. A rotation or scale error counts at the node's lever, the distance to
+		// its farthest descendant in the rest pose plus leafExtent. Every node gets the share of this its lever has in the heaviest
+		// root to leaf chain it is part of, split between its animated tracks, so the errors summed up along a chain stay within it.
+		float maxError = 0.01f; // a centimetre for assets in metres, the 48 bit rotations alone are off by up to 0.13 mm per metre of reach
+		float leafExtent = 0.1f; // how far the geometry reaches beyond the last node of a chain
+		float weightError = 0.001f; // morph weights, not part of the hierarchy
+
+		// CUBICSPLINE channels become linear keys, from the curve sampled at this rate and at the authored keys
+		float sampleRate = 60.0f;
+	};
+
+	struct SGLTFAnimationCompressionReport
+	{
+		uint64_t bytesBefore = 0; // accessor data of the channels, inputs shared between samplers counted once
+		uint64_t bytesAfter = 0; // SGLTFCompressedAnimation::GetSize of all of them
+
+		uint32_t identityTracks = 0;
+		uint32_t constantTracks = 0;
+		uint32_t animatedTracks = 0;
+		uint32_t floatRotationTracks = 0; // animated rotations that had to stay float to keep within their share
+		uint32_t exactTimeTracks = 0; // animated tracks that had to keep float key times
+		uint32_t overBudgetTracks = 0; // off by more than their share even uncompressed, the compression then fails
+		uint64_t keysBefore = 0;
+		uint64_t keysAfter = 0;
+
+		double maxError = 0.0; // largest drift of a node from the measured errors of its own and its ancestors' tracks
+		double maxWeightError = 0.0;
+
+		double GetRatio() const { return bytesAfter > 0 ? double(bytesBefore) / double(bytesAfter) : 0.0; }
+		void Print(FILE* out = stdout) const;
+	};
+
+	// Compresses every animation of the asset, one per animation in the same order. Keys are dropped greedily, a key goes back in
+	// where interpolating the neighbours (decoded, with the quantized rotations and times) is off by more than the node's share
+	// of the error anywhere on the original curve. Tracks within their share of identity or of a single value keep no keys.
+	// Channels are compressed in parallel on the pool. report.maxError stays within options.maxError, false (with the output still
+	// filled in) if a track can't be made to fit.
+	bool CompressGLTFAnimations(const SGLTFAsset& asset, std::vector<SGLTFCompressedAnimation>& out, SGLTFAnimationCompressionReport& report,
+		const SGLTFAnimationCompressionOptions& options = SGLTFAnimationCompressionOptions(), CGLTFThreadPool* pool = nullptr);
+
+	// Same as SampleGLTFAnimation for a compressed one, without allocating once the poses' weights are sized.
+	// Rotations are interpolated with nlerp, which the compression error already accounts for.
+	void SampleGLTFCompressedAnimation(const SGLTFCompressedAnimation& animation, float time, std::vector<SGLTFNodePose>& poses);
+}
@@ -0,0 +1,48 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace EGLTF
+{
+	// T * R * S of a compact node, column major like the gltf matrix property
+	std::array<float, 16> GetGLTFCompactNodeMatrix(const SGLTFCompact_Node& node);
+
+	std::string GetGLTFCompactNodeName(const SGLTFCompactAsset& asset, const SGLTFCompact_Node& node);
+
+	// Estimated bytes an asset holds, the structs themselves plus everything they allocate (vector capacity, strings past the
+	// small string buffer, map nodes). Good enough to compare a regular load with a compact one.
+	struct SGLTFMemoryReport
+	{
+		uint64_t nodes = 0;
+		uint64_t meshes = 0;
+		uint64_t accessors = 0;
+		uint64_t materials = 0;
+		uint64_t animations = 0;
+		uint64_t bufferData = 0; // buffer and image payloads
+		uint64_t other = 0;
+		uint64_t total = 0;
+	};
+
+	SGLTFMemoryReport GetGLTFMemoryReport(const SGLTFAsset& asset, const SGLTFCompactAsset* compact = nullptr);
+}
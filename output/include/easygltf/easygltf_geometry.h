@@ -0,0 +1,73 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+	class IGLTFFileSystem;
+
+	uint32_t GetGLTFComponentSize(int32_t componentType); // 0 for unknown types
+	uint32_t GetGLTFComponentCount(const std::string& type); // 0 for unknown types
+	uint32_t GetGLTFElementSize(int32_t componentType, const std::string& type); // including the column padding of small matrices
+
+	// Reads any accessor as floats, count * components of them, with its sparse values applied.
+	// Integer components of normalized accessors are mapped to [0, 1] or [-1, 1] the way the specs want, normalized does the same
+	// for accessors that do not say so.
+	bool ReadGLTFAccessor(const SGLTFAsset& asset, int32_t accessor, std::vector<float>& out, bool normalized = false);
+
+	// Raw elements one after the other, GetGLTFElementSize bytes each, with its sparse values applied
+	bool ReadGLTFAccessorBytes(const SGLTFAsset& asset, int32_t accessor, std::vector<uint8_t>& out);
+
+	// ReadGLTFAccessorBytes for the elements [first, first + count) only. Buffers that are not loaded (SetDeferResources) are read
+	// from their file through fileSystem, with the uri resolved against directory (CEasyGLTF::GetDirectory), a few MB at a time
+	// for strided views. Lets a buffer larger than RAM be walked a range at a time.
+	bool ReadGLTFAccessorRange(const SGLTFAsset& asset, int32_t accessor, uint64_t first, uint64_t count, IGLTFFileSystem& fileSystem,
+		const std::string& directory, std::vector<uint8_t>& out);
+
+	// Reads an unsigned SCALAR accessor, for indices
+	bool ReadGLTFAccessorIndices(const SGLTFAsset& asset, int32_t accessor, std::vector<uint32_t>& out);
+
+	enum class EGLTFNormalMode
+	{
+		FLAT, // one normal per face, the vertices get split so no two faces share one
+		SMOOTH // angle weighted average of the faces around a position
+	};
+
+	struct SGLTFGeometryOptions
+	{
+		bool normals = true; // for primitives without NORMAL
+		EGLTFNormalMode normalMode = EGLTFNormalMode::SMOOTH;
+		bool tangents = true; // MikkTSpace, for primitives without TANGENT that have TEXCOORD_0
+		bool triangulate = true; // strips and fans to lists even when nothing else is generated, they always are when something is
+		size_t grain = 16384; // triangles or vertices per chunk on the pool
+	};
+
+	// Adds the missing NORMAL and TANGENT attributes to every triangle primitive, points and lines are left alone.
+	// Generated data goes into one new buffer with a bufferView and accessor per attribute. When vertices have to be split
+	// (flat normals, tangents with opposite handedness on one vertex) every attribute of the primitive is rewritten.
+	// Primitives are processed in parallel on the pool and their larger passes are split into chunks of grain, the result is the
+	// same with or without a pool.
+	bool GenerateGLTFGeometry(SGLTFAsset& asset, const SGLTFGeometryOptions& options = SGLTFGeometryOptions(), CGLTFThreadPool* pool = nullptr);
+}
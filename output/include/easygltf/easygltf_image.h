@@ -0,0 +1,49 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	// 8 bit RGBA, rows top to bottom
+	struct SGLTFBitmap
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> rgba;
+	};
+
+	// The encoded bytes of an image, wherever the asset keeps them: decoded from a data uri, read from an external file during the
+	// load or in a bufferView. False if the image has not been loaded (deferred resources) or points nowhere.
+	bool GetGLTFImageData(const SGLTFAsset& asset, int32_t image, std::vector<uint8_t>& out);
+
+	// PNG (any color type and bit depth, not interlaced) and JPEG (baseline and progressive huffman, 8 bit, grayscale, YCbCr or RGB
+	// with any subsampling, chroma is upsampled nearest). Interlaced PNGs and arithmetic coded JPEGs are not supported.
+	bool DecodeGLTFImage(const uint8_t* data, size_t size, SGLTFBitmap& out);
+	bool DecodeGLTFImage(const SGLTFAsset& asset, int32_t image, SGLTFBitmap& out);
+
+	// Deflate with fixed huffman codes and a per row filter picked the way libpng does, deterministic for the same pixels
+	void EncodeGLTFPNG(const SGLTFBitmap& bitmap, std::vector<uint8_t>& out);
+	bool WriteGLTFPNG(const std::string& filepath, const SGLTFBitmap& bitmap);
+}
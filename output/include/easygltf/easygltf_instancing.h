@@ -0,0 +1,63 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	// Local matrices (column major, 16 floats each) of the instances of a node with EXT_mesh_gpu_instancing, from its
+	// TRANSLATION, ROTATION and SCALE accessors. Any of them can be missing, at least one has to be there.
+	bool ReadGLTFInstanceMatrices(const SGLTFAsset& asset, const std::map<std::string, int32_t>& instancing, std::vector<float>& out);
+
+	// meshRemap[i] is the first mesh with the same geometry as mesh i (attributes, indices, targets and modes, compared by
+	// content, not by accessor index), i itself if there is none. Materials are not part of it. Returns the number of meshes
+	// that have a duplicate in front of them.
+	size_t FindGLTFDuplicateMeshes(const SGLTFAsset& asset, std::vector<int32_t>& meshRemap, CGLTFThreadPool* pool = nullptr);
+
+	// Points the primitives of every duplicate at the accessors of the mesh it duplicates, keeping its own materials.
+	// The accessors and buffer data of the duplicates are left in place, just no longer referenced.
+	size_t MergeGLTFDuplicateMeshes(SGLTFAsset& asset, CGLTFThreadPool* pool = nullptr);
+
+	struct SGLTFInstanceGroup
+	{
+		int32_t mesh = -1; // one of the meshes of the group, all of them have the same geometry and materials
+		int32_t geometry = -1; // the first mesh with that geometry, groups that only differ in materials or skin share it
+		int32_t skin = -1;
+		std::vector<int32_t> materials; // per primitive, what the group is keyed on along with geometry and skin
+		std::vector<int32_t> nodes; // per instance, EXT_mesh_gpu_instancing nodes show up once per instance
+		std::vector<float> transforms; // per instance, world matrix, column major, 16 floats each
+	};
+
+	struct SGLTFInstancing
+	{
+		std::vector<SGLTFInstanceGroup> groups; // in order of first appearance
+		size_t drawCalls = 0; // one per primitive per instance, without instancing
+		size_t instancedDrawCalls = 0; // one per primitive per group
+	};
+
+	// Groups the mesh nodes reachable from the scene by (geometry, skin, materials), with duplicate geometry found by content
+	// like FindGLTFDuplicateMeshes does. scene -1 uses every root node. Compact assets are read from compact when the asset
+	// has no nodes.
+	bool BuildGLTFInstanceGroups(const SGLTFAsset& asset, SGLTFInstancing& out, int32_t scene = -1, const SGLTFCompactAsset* compact = nullptr, CGLTFThreadPool* pool = nullptr);
+}
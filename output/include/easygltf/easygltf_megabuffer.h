@@ -0,0 +1,97 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	// Same layout as the DrawElementsIndirectCommand of GL_ARB_draw_indirect and VkDrawIndexedIndirectCommand's fields in GL order
+	struct SGLTFDrawElementsIndirectCommand
+	{
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+		uint32_t baseInstance;
+	};
+	static_assert(sizeof(SGLTFDrawElementsIndirectCommand) == 20, "has to match the GPU's layout");
+
+	struct SGLTFVertexAttribute
+	{
+		std::string name; // POSITION, NORMAL, ...
+		int32_t componentType;
+		bool normalized;
+		uint32_t components;
+		uint32_t offset; // in the vertex
+	};
+
+	// Interleaved, attributes sorted by name and 4 byte aligned
+	struct SGLTFVertexLayout
+	{
+		std::vector<SGLTFVertexAttribute> attributes;
+		uint32_t stride = 0;
+	};
+
+	// Everything drawn with one vertex layout
+	struct SGLTFMegaBuffer
+	{
+		SGLTFVertexLayout layout;
+		std::vector<uint8_t> vertices;
+		std::vector<uint32_t> indices; // relative to the baseVertex of their draw
+	};
+
+	// What goes with each command, same order
+	struct SGLTFDrawInfo
+	{
+		uint32_t buffer; // into SGLTFCompiledScene::buffers
+		int32_t mode; // GL primitive mode, a multi draw can only cover one
+		int32_t source; // into the sources given to CompileGLTFScene
+		int32_t mesh;
+		int32_t primitive;
+		int32_t material; // of the source asset, -1 for the default material
+		int32_t skin;
+	};
+
+	struct SGLTFCompiledScene
+	{
+		std::vector<SGLTFMegaBuffer> buffers;
+		std::vector<SGLTFDrawElementsIndirectCommand> commands; // sorted by buffer, mode, skin, source and material
+		std::vector<SGLTFDrawInfo> draws;
+		std::vector<float> instanceTransforms; // world matrix per instance, column major, 16 floats each, baseInstance points here
+		std::vector<int32_t> instanceNodes; // node of each instance
+	};
+
+	struct SGLTFSceneSource
+	{
+		const SGLTFAsset* asset = nullptr;
+		const SGLTFCompactAsset* compact = nullptr; // for assets loaded in compact mode
+		int32_t scene = -1; // -1 for every root node
+	};
+
+	// Packs every primitive the scenes of the sources draw into one vertex and index buffer per vertex layout, geometry shared
+	// by several nodes (or several meshes, see FindGLTFDuplicateMeshes) is packed once and drawn instanced.
+	// The primitives are copied in parallel on the pool, straight into their final place, so the result does not depend on it.
+	bool CompileGLTFScene(const std::vector<SGLTFSceneSource>& sources, SGLTFCompiledScene& out, CGLTFThreadPool* pool = nullptr);
+}
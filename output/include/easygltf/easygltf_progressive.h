@@ -0,0 +1,144 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+#include "easygltf_threadpool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace EGLTF
+{
+	// Makes the structure of an asset available right away and streams the data in afterwards, in whatever order the application asks for.
+	// Open parses the json only, every section is usable when it returns, but buffers that live in external files or data uris are
+	// left empty. The application then requests primitives, images or single bufferViews with a priority, the pool reads the most
+	// important parts first (a bufferView at a time for external files) and calls back once a request is resident.
+	// Nothing that is not asked for is ever read or allocated: every bufferView of an external file is moved to a buffer of its own
+	// (appended after the buffers of the file, which stay empty, at byteOffset 0) that gets its memory when the view is read.
+	class CGLTFProgressiveLoader
+	{
+	public:
+		typedef uint32_t TRequestId;
+
+		// ok is false when any of the reads failed
+		typedef std::function<void(TRequestId request, bool ok)> TCallback;
+
+		explicit CGLTFProgressiveLoader(CGLTFThreadPool& pool);
+
+		// Drops everything still queued and waits for the reads in flight
+		~CGLTFProgressiveLoader();
+
+		CGLTFProgressiveLoader(const CGLTFProgressiveLoader&) = delete;
+		CGLTFProgressiveLoader& operator=(const CGLTFProgressiveLoader&) = delete;
+
+		// Not owned, set it before Open. Everything is read through it, nullptr reads from disk.
+		void SetFileSystem(IGLTFFileSystem* fileSystem) { m_easygltf.SetFileSystem(fileSystem); }
+
+		// .glb or .gltf by extension. A glb binary chunk is resident as soon as this returns.
+		bool Open(const std::string& filepath);
+
+		// Buffer and image data is only safe to read once a request covering it called back (or IsResident says so)
+		const SGLTFAsset& GetAsset() const { return m_easygltf.GetAssetInstance(); }
+
+		// Every bufferView the primitive reads from: indices, attributes, morph targets and sparse accessors.
+		// The callback runs on a pool thread once they are all resident, or on this thread before returning if they already were.
+		TRequestId RequestPrimitive(int32_t mesh, int32_t primitive, int priority, TCallback callback);
+		TRequestId RequestImage(int32_t image, int priority, TCallback callback);
+		TRequestId RequestBufferView(int32_t bufferView, int priority, TCallback callback);
+
+		// Parts shared between requests go with the highest priority of the requests still waiting on them
+		void Reprioritize(TRequestId request, int priority);
+
+		// The callback won't be called anymore. Parts nobody else waits on leave the queue, reads that already started still finish.
+		void Cancel(TRequestId request);
+
+		bool IsBufferViewResident(int32_t bufferView) const;
+		bool IsImageResident(int32_t image) const;
+
+		// Blocks until nothing is queued or being read, running pool tasks on the calling thread in the meantime
+		void WaitIdle();
+
+	private:
+		enum class EJobType
+		{
+			BUFFER_VIEW, // range of an external .bin
+			DATA_URI_BUFFER, // whole buffer, base64 can't be decoded in pieces
+			IMAGE // external file or data uri
+		};
+
+		enum class EJobState
+		{
+			IDLE,
+			QUEUED,
+			RUNNING,
+			DONE
+		};
+
+		struct SJob
+		{
+			EJobType type;
+			int32_t index; // bufferView, buffer or image
+			int32_t source = -1; // BUFFER_VIEW: the buffer of the file the view is in
+			uint64_t offset = 0; // and where in it
+			EJobState state = EJobState::IDLE;
+			int priority = 0;
+			bool ok = true;
+			std::vector<TRequestId> waiting;
+		};
+
+		struct SRequest
+		{
+			int priority;
+			TCallback callback;
+			std::vector<uint32_t> jobs;
+			uint32_t remaining = 0;
+			bool ok = true;
+			bool cancelled = false;
+		};
+
+		// highest priority first, then job order which roughly follows the file
+		typedef std::set<std::pair<int, uint32_t>> TQueue;
+
+		TRequestId Request(std::vector<uint32_t> jobs, int priority, TCallback callback);
+		void AddViewJob(int32_t bufferView, std::vector<uint32_t>& jobs) const;
+		void AddAccessorJobs(int32_t accessor, std::vector<uint32_t>& jobs) const;
+		void UpdatePriority(uint32_t job); // m_mutex held
+		void StreamNext();
+		bool RunJob(const SJob& job);
+
+		CGLTFThreadPool& m_pool;
+		CEasyGLTF m_easygltf;
+		std::string m_path;
+
+		mutable std::mutex m_mutex;
+		std::vector<SJob> m_jobs;
+		std::vector<int32_t> m_viewJobs; // per bufferView, -1 when resident from the start
+		std::vector<int32_t> m_imageJobs; // per image, -1 for images in a bufferView, those wait on the view
+		std::vector<std::unique_ptr<SRequest>> m_requests;
+		TQueue m_queue;
+		std::atomic<size_t> m_inFlight;
+	};
+}
@@ -0,0 +1,166 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+#include "easygltf_image.h"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	struct SGLTFRenderOptions
+	{
+		uint32_t width = 256;
+		uint32_t height = 256;
+		uint32_t supersampling = 1; // samples per pixel along each axis, 2 gives smooth edges for 4 times the work
+
+		int32_t scene = -1; // -1 for every root node
+		int32_t camera = -1; // node with a camera to look through, -1 frames the scene
+
+		// Framing: the camera looks at the center of the scene's bounds from this direction, far enough for all of it to fit.
+		// +z is the front in glTF, the default is a bit from the right and above.
+		std::array<float, 3> viewDirection = {{ 0.6f, 0.45f, 1.0f }};
+		float fieldOfView = 0.6f; // vertical, radians
+
+		std::array<uint8_t, 4> background = {{ 0, 0, 0, 0 }}; // RGBA
+		bool textures = true; // base color textures, only the base color factors without
+	};
+
+	struct SGLTFRenderStats
+	{
+		uint32_t draws = 0; // primitives times the nodes and instances they are drawn for
+		uint64_t triangles = 0; // of the draws
+		uint64_t rasterized = 0; // triangles left after clipping, rejection and those too small to cover a sample
+		uint32_t textures = 0; // images decoded
+	};
+
+	// Tile based software rasterizer for previews on machines without a GPU.
+	// Triangle lists, strips and fans of the scene are drawn with their base color (factor times texture, sRGB decoded) lit by a
+	// light coming from over the camera's left shoulder, rigged meshes in the pose of their joints' node matrices and morph targets
+	// at the mesh's default weights. Faces are drawn from both sides, materials are opaque.
+	// Edge functions and the depth test run on 4 samples at a time with SSE2, every tile of 64x64 samples keeps the id of the nearest
+	// triangle, shading happens once per sample afterwards. Tiles and shading are spread over the pool. The image only depends on
+	// the asset and the options, not on the pool or the thread count.
+	// Keep one rasterizer per thread and reuse it, its buffers stay allocated between renders.
+	class CGLTFRasterizer
+	{
+	public:
+		// Not owned, nullptr renders on the calling thread
+		void SetThreadPool(CGLTFThreadPool* pool) { m_pool = pool; }
+
+		// false when the options or the camera node are broken, an asset with nothing to draw renders the background
+		bool Render(const SGLTFAsset& asset, SGLTFBitmap& out, const SGLTFRenderOptions& options = SGLTFRenderOptions());
+
+		const SGLTFRenderStats& GetStats() const { return m_stats; }
+
+	private:
+		typedef std::array<float, 16> TMatrix;
+
+		// a primitive's attributes as they are in the asset, shared by the draws of it
+		struct SPrimitiveData
+		{
+			int32_t mesh;
+			int32_t primitive;
+			int32_t texCoord; // the set the material's base color texture reads, -1 for none
+			bool ok = false;
+			std::vector<float> positions; // morph targets applied
+			std::vector<float> normals; // empty without NORMAL, face normals are used then
+			std::vector<float> uvs;
+			std::vector<float> joints; // 4 per vertex, with weights, empty when not rigged
+			std::vector<float> weights;
+			std::vector<uint32_t> indices; // triangle list
+		};
+
+		struct SDraw
+		{
+			uint32_t primitive; // into m_primitives
+			int32_t material;
+			int32_t skin;
+			TMatrix world;
+			std::vector<float> positions; // world space
+			std::vector<float> normals;
+			float boundsMin[3] = { 0.0f, 0.0f, 0.0f };
+			float boundsMax[3] = { 0.0f, 0.0f, 0.0f };
+		};
+
+		struct STexture
+		{
+			std::vector<SGLTFBitmap> levels; // mip chain, empty when the image could not be decoded
+			int32_t wrapS = 10497;
+			int32_t wrapT = 10497;
+		};
+
+		struct SMaterial
+		{
+			float baseColor[4]; // linear
+			float emissive[3];
+			const STexture* texture = nullptr;
+		};
+
+		// screen space, in samples, everything as planes a * x + b * y + c
+		struct STriangle
+		{
+			float edges[3][3];
+			uint8_t ties; // bit per edge, samples right on an edge belong to the triangle with that edge's bit set
+			float depth[3];
+			float inverseW[3];
+			float attributes[5][3]; // normal and uv, each divided by w
+			int32_t x0, y0, x1, y1; // samples whose centers can be inside, ends exclusive
+			int32_t material;
+			float lod; // mip level
+		};
+
+		bool CollectDraws(const SGLTFAsset& asset, const SGLTFRenderOptions& options);
+		void PrepareMaterials(const SGLTFAsset& asset, const SGLTFRenderOptions& options);
+		bool SetupCamera(const SGLTFAsset& asset, const SGLTFRenderOptions& options, uint32_t width, uint32_t height);
+		void SetupTriangles(const SDraw& draw, std::vector<STriangle>& out) const;
+		void RasterizeTile(uint32_t tile);
+		void Resolve(const SGLTFRenderOptions& options, SGLTFBitmap& out, uint32_t rowBegin, uint32_t rowEnd) const;
+		void Shade(uint32_t triangle, float x, float y, float* rgb) const;
+		void ForEach(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& func);
+
+		CGLTFThreadPool* m_pool = nullptr;
+		SGLTFRenderStats m_stats;
+
+		std::vector<TMatrix> m_nodeWorld;
+		std::vector<SPrimitiveData> m_primitives;
+		std::vector<SDraw> m_draws;
+		std::vector<STexture> m_textures; // per image
+		std::vector<SMaterial> m_materials; // per material, the default material last
+
+		TMatrix m_viewProjection;
+		float m_lightDirection[3];
+		float m_up[3];
+
+		uint32_t m_sampleWidth = 0;
+		uint32_t m_sampleHeight = 0;
+		uint32_t m_tilesWide = 0;
+		uint32_t m_tilesHigh = 0;
+		std::vector<std::vector<STriangle>> m_drawTriangles; // per draw
+		std::vector<const STriangle*> m_triangles; // all of them, in draw order
+		std::vector<std::vector<uint32_t>> m_bins; // per tile, into m_triangles
+		std::vector<float> m_depth; // per sample, rows padded to whole tiles
+		std::vector<uint32_t> m_ids; // nearest triangle per sample, UINT32_MAX for none
+	};
+}
@@ -0,0 +1,340 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdint>
+#include <string>
+
+// A "baked" binary snapshot of a loaded SGLTFAsset.
+// Everything in the file is a flat array of fixed size records, all references are indices or byte offsets relative to the start of the file
+// so the whole thing can be mmap'd and used as is. Nothing gets parsed and nothing gets allocated per element when opening one.
+// The layout assumes a little endian host, same as the GLB loader does.
+
+namespace EGLTF
+{
+	static const uint32_t GLTF_SNAPSHOT_MAGIC = 0x4E534745; // "EGSN"
+	static const uint32_t GLTF_SNAPSHOT_VERSION = 4;
+	static const uint32_t GLTF_SNAPSHOT_ALIGNMENT = 16; // payloads (buffer/image data) start on this boundary
+
+	// offset into the string blob, strings are null terminated as well so c_str style access works
+	struct SGLTFSnapshot_String
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	// [offset, offset + count) into one of the tables
+	struct SGLTFSnapshot_Range
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// byte range of the file
+	struct SGLTFSnapshot_Blob
+	{
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	enum EGLTFSnapshot_Table
+	{
+		GLTF_SNAPSHOT_TABLE_SCENES,
+		GLTF_SNAPSHOT_TABLE_NODES,
+		GLTF_SNAPSHOT_TABLE_MESHES,
+		GLTF_SNAPSHOT_TABLE_PRIMITIVES,
+		GLTF_SNAPSHOT_TABLE_ATTRIBUTES, // primitive attributes and morph target attributes
+		GLTF_SNAPSHOT_TABLE_TARGETS,
+		GLTF_SNAPSHOT_TABLE_BUFFERS,
+		GLTF_SNAPSHOT_TABLE_BUFFERVIEWS,
+		GLTF_SNAPSHOT_TABLE_ACCESSORS,
+		GLTF_SNAPSHOT_TABLE_MATERIALS,
+		GLTF_SNAPSHOT_TABLE_TEXTURES,
+		GLTF_SNAPSHOT_TABLE_IMAGES,
+		GLTF_SNAPSHOT_TABLE_SAMPLERS,
+		GLTF_SNAPSHOT_TABLE_SKINS,
+		GLTF_SNAPSHOT_TABLE_ANIMATIONS,
+		GLTF_SNAPSHOT_TABLE_CHANNELS,
+		GLTF_SNAPSHOT_TABLE_ANIMATION_SAMPLERS,
+		GLTF_SNAPSHOT_TABLE_CAMERAS, // since version 4
+		GLTF_SNAPSHOT_TABLE_INDICES, // int32_t pool for children, scene nodes, joints
+		GLTF_SNAPSHOT_TABLE_DOUBLES, // double pool for min/max/weights
+		GLTF_SNAPSHOT_TABLE_STRINGS, // char blob
+		GLTF_SNAPSHOT_TABLE_COUNT
+	};
+
+	struct SGLTFSnapshot_Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t fileSize;
+		uint64_t sourceHash; // whatever the writer was given, typically HashGLTFSnapshotSource() of the source file(s)
+		uint64_t contentHash; // hash of everything after the header
+		SGLTFSnapshot_Blob tables[GLTF_SNAPSHOT_TABLE_COUNT]; // for tables the size is the element count, not bytes
+		SGLTFSnapshot_String assetVersion;
+		SGLTFSnapshot_String assetGenerator;
+		SGLTFSnapshot_String assetMinVersion;
+		SGLTFSnapshot_String assetCopyright;
+		SGLTFSnapshot_String scene; // SGLTFAsset::scene is stored as is
+	};
+
+	struct SGLTFSnapshot_Scene
+	{
+		SGLTFSnapshot_Range nodes; // indices
+	};
+
+	struct SGLTFSnapshot_Node
+	{
+		double matrix[16];
+		SGLTFSnapshot_Range children; // indices
+		int32_t mesh;
+		int32_t skin;
+		int32_t camera;
+		SGLTFSnapshot_String name;
+		uint32_t reserved;
+	};
+
+	struct SGLTFSnapshot_Attribute
+	{
+		SGLTFSnapshot_String name;
+		int32_t accessor;
+	};
+
+	struct SGLTFSnapshot_Target
+	{
+		SGLTFSnapshot_Range attributes;
+	};
+
+	struct SGLTFSnapshot_Primitive
+	{
+		int32_t mode;
+		int32_t indices;
+		int32_t material;
+		SGLTFSnapshot_Range attributes;
+		SGLTFSnapshot_Range targets;
+	};
+
+	struct SGLTFSnapshot_Mesh
+	{
+		SGLTFSnapshot_String name;
+		SGLTFSnapshot_Range primitives;
+		SGLTFSnapshot_Range weights; // doubles
+	};
+
+	// sizes, offsets and counts into buffers are 64 bit since version 3
+	struct SGLTFSnapshot_Buffer
+	{
+		int64_t byteLength;
+		SGLTFSnapshot_Blob data;
+	};
+
+	struct SGLTFSnapshot_BufferView
+	{
+		int64_t byteOffset;
+		int64_t byteLength;
+		int32_t buffer;
+		int32_t byteStride;
+		int32_t target;
+		uint32_t reserved;
+	};
+
+	struct SGLTFSnapshot_Accessor
+	{
+		int64_t byteOffset;
+		int64_t count;
+		int64_t sparseCount;
+		int32_t bufferView;
+		int32_t componentType;
+		SGLTFSnapshot_String type;
+		SGLTFSnapshot_Range min; // doubles
+		SGLTFSnapshot_Range max; // doubles
+		int32_t sparseValues;
+		int32_t sparseIndicesBufferView;
+		int32_t sparseIndicesComponentType;
+		int32_t normalized; // 0 or 1
+	};
+
+	struct SGLTFSnapshot_Material_Texture
+	{
+		int32_t index;
+		int32_t texCoord;
+		double value; // scale for normal textures, strength for occlusion textures, unused otherwise
+	};
+
+	struct SGLTFSnapshot_Material
+	{
+		SGLTFSnapshot_String name;
+		double baseColorFactor[4];
+		double emissiveFactor[3];
+		double metallicFactor;
+		double roughnessFactor;
+		SGLTFSnapshot_Material_Texture baseColorTexture;
+		SGLTFSnapshot_Material_Texture metallicRoughnessTexture;
+		SGLTFSnapshot_Material_Texture occlusionTexture;
+		SGLTFSnapshot_Material_Texture normalTexture;
+		SGLTFSnapshot_Material_Texture emissiveTexture;
+	};
+
+	struct SGLTFSnapshot_Texture
+	{
+		int32_t source;
+		int32_t sampler;
+	};
+
+	struct SGLTFSnapshot_Image
+	{
+		SGLTFSnapshot_Blob data;
+		int32_t bufferView;
+		SGLTFSnapshot_String mimeType;
+		uint32_t reserved;
+	};
+
+	struct SGLTFSnapshot_Sampler
+	{
+		int32_t magFiler;
+		int32_t minFiler;
+		int32_t wrapS;
+		int32_t wrapT;
+	};
+
+	struct SGLTFSnapshot_Skin
+	{
+		int32_t inverseBindMatrices;
+		int32_t skeleton;
+		SGLTFSnapshot_Range joints; // indices
+		SGLTFSnapshot_String name;
+	};
+
+	struct SGLTFSnapshot_Animation
+	{
+		SGLTFSnapshot_String name;
+		SGLTFSnapshot_Range channels;
+		SGLTFSnapshot_Range samplers;
+	};
+
+	struct SGLTFSnapshot_Animation_Channel
+	{
+		int32_t node;
+		int32_t path; // EGLTFAsset_Prop_Animation_Channel_Target_Type
+		int32_t sampler;
+	};
+
+	struct SGLTFSnapshot_Animation_Sampler
+	{
+		int32_t input;
+		int32_t output;
+		int32_t interpolation; // EGLTFAsset_Prop_Animation_Sampler_Type
+	};
+
+	struct SGLTFSnapshot_Camera
+	{
+		int32_t type; // SGLTFAsset_Prop_Camera_Type
+		uint32_t reserved;
+		double znear;
+		double zfar; // 0 for infinite
+		double val0; // xmag or aspectRatio, same as SGLTFAsset_Prop_Camera
+		double val1; // ymag or yfov
+	};
+
+	// Hash used for both the content hash and the source hash (FNV-1a, 64 bit)
+	uint64_t HashGLTFSnapshotData(const void* data, size_t size, uint64_t seed = 0xCBF29CE484222325ULL);
+
+	// Hashes the file contents, 0 if the file could not be read.
+	// Meant to be stored as the sourceHash so a snapshot can be checked against the .gltf/.glb it was baked from.
+	uint64_t HashGLTFSnapshotSource(const std::string& filepath);
+
+	bool WriteGLTFSnapshot(const SGLTFAsset& asset, const std::string& filepath, uint64_t sourceHash = 0);
+
+	// Read only view over a mmap'd snapshot file
+	class CGLTFSnapshot
+	{
+	public:
+		CGLTFSnapshot();
+		~CGLTFSnapshot();
+
+		CGLTFSnapshot(const CGLTFSnapshot&) = delete;
+		CGLTFSnapshot& operator=(const CGLTFSnapshot&) = delete;
+
+		// expectedSourceHash of 0 skips the staleness check against the source.
+		// verifyContent rehashes the whole file, which costs a full read so its off by default.
+		bool Open(const std::string& filepath, uint64_t expectedSourceHash = 0, bool verifyContent = false);
+		void Close();
+
+		bool IsOpen() const { return m_data != nullptr; }
+
+		const SGLTFSnapshot_Header& GetHeader() const { return *reinterpret_cast<const SGLTFSnapshot_Header*>(m_data); }
+
+		uint32_t GetSceneCount() const { return Count(GLTF_SNAPSHOT_TABLE_SCENES); }
+		uint32_t GetNodeCount() const { return Count(GLTF_SNAPSHOT_TABLE_NODES); }
+		uint32_t GetMeshCount() const { return Count(GLTF_SNAPSHOT_TABLE_MESHES); }
+		uint32_t GetBufferCount() const { return Count(GLTF_SNAPSHOT_TABLE_BUFFERS); }
+		uint32_t GetBufferViewCount() const { return Count(GLTF_SNAPSHOT_TABLE_BUFFERVIEWS); }
+		uint32_t GetAccessorCount() const { return Count(GLTF_SNAPSHOT_TABLE_ACCESSORS); }
+		uint32_t GetMaterialCount() const { return Count(GLTF_SNAPSHOT_TABLE_MATERIALS); }
+		uint32_t GetTextureCount() const { return Count(GLTF_SNAPSHOT_TABLE_TEXTURES); }
+		uint32_t GetImageCount() const { return Count(GLTF_SNAPSHOT_TABLE_IMAGES); }
+		uint32_t GetSamplerCount() const { return Count(GLTF_SNAPSHOT_TABLE_SAMPLERS); }
+		uint32_t GetSkinCount() const { return Count(GLTF_SNAPSHOT_TABLE_SKINS); }
+		uint32_t GetAnimationCount() const { return Count(GLTF_SNAPSHOT_TABLE_ANIMATIONS); }
+		uint32_t GetCameraCount() const { return Count(GLTF_SNAPSHOT_TABLE_CAMERAS); }
+
+		const SGLTFSnapshot_Scene& GetScene(uint32_t i) const { return Table<SGLTFSnapshot_Scene>(GLTF_SNAPSHOT_TABLE_SCENES)[i]; }
+		const SGLTFSnapshot_Node& GetNode(uint32_t i) const { return Table<SGLTFSnapshot_Node>(GLTF_SNAPSHOT_TABLE_NODES)[i]; }
+		const SGLTFSnapshot_Mesh& GetMesh(uint32_t i) const { return Table<SGLTFSnapshot_Mesh>(GLTF_SNAPSHOT_TABLE_MESHES)[i]; }
+		const SGLTFSnapshot_Buffer& GetBuffer(uint32_t i) const { return Table<SGLTFSnapshot_Buffer>(GLTF_SNAPSHOT_TABLE_BUFFERS)[i]; }
+		const SGLTFSnapshot_BufferView& GetBufferView(uint32_t i) const { return Table<SGLTFSnapshot_BufferView>(GLTF_SNAPSHOT_TABLE_BUFFERVIEWS)[i]; }
+		const SGLTFSnapshot_Accessor& GetAccessor(uint32_t i) const { return Table<SGLTFSnapshot_Accessor>(GLTF_SNAPSHOT_TABLE_ACCESSORS)[i]; }
+		const SGLTFSnapshot_Material& GetMaterial(uint32_t i) const { return Table<SGLTFSnapshot_Material>(GLTF_SNAPSHOT_TABLE_MATERIALS)[i]; }
+		const SGLTFSnapshot_Texture& GetTexture(uint32_t i) const { return Table<SGLTFSnapshot_Texture>(GLTF_SNAPSHOT_TABLE_TEXTURES)[i]; }
+		const SGLTFSnapshot_Image& GetImage(uint32_t i) const { return Table<SGLTFSnapshot_Image>(GLTF_SNAPSHOT_TABLE_IMAGES)[i]; }
+		const SGLTFSnapshot_Sampler& GetSampler(uint32_t i) const { return Table<SGLTFSnapshot_Sampler>(GLTF_SNAPSHOT_TABLE_SAMPLERS)[i]; }
+		const SGLTFSnapshot_Skin& GetSkin(uint32_t i) const { return Table<SGLTFSnapshot_Skin>(GLTF_SNAPSHOT_TABLE_SKINS)[i]; }
+		const SGLTFSnapshot_Animation& GetAnimation(uint32_t i) const { return Table<SGLTFSnapshot_Animation>(GLTF_SNAPSHOT_TABLE_ANIMATIONS)[i]; }
+		const SGLTFSnapshot_Camera& GetCamera(uint32_t i) const { return Table<SGLTFSnapshot_Camera>(GLTF_SNAPSHOT_TABLE_CAMERAS)[i]; }
+
+		// Ranges stored in the records above resolve through these
+		const SGLTFSnapshot_Primitive* GetPrimitives(const SGLTFSnapshot_Range& r) const { return Table<SGLTFSnapshot_Primitive>(GLTF_SNAPSHOT_TABLE_PRIMITIVES) + r.offset; }
+		const SGLTFSnapshot_Attribute* GetAttributes(const SGLTFSnapshot_Range& r) const { return Table<SGLTFSnapshot_Attribute>(GLTF_SNAPSHOT_TABLE_ATTRIBUTES) + r.offset; }
+		const SGLTFSnapshot_Target* GetTargets(const SGLTFSnapshot_Range& r) const { return Table<SGLTFSnapshot_Target>(GLTF_SNAPSHOT_TABLE_TARGETS) + r.offset; }
+		const SGLTFSnapshot_Animation_Channel* GetChannels(const SGLTFSnapshot_Range& r) const { return Table<SGLTFSnapshot_Animation_Channel>(GLTF_SNAPSHOT_TABLE_CHANNELS) + r.offset; }
+		const SGLTFSnapshot_Animation_Sampler* GetAnimationSamplers(const SGLTFSnapshot_Range& r) const { return Table<SGLTFSnapshot_Animation_Sampler>(GLTF_SNAPSHOT_TABLE_ANIMATION_SAMPLERS) + r.offset; }
+		const int32_t* GetIndices(const SGLTFSnapshot_Range& r) const { return Table<int32_t>(GLTF_SNAPSHOT_TABLE_INDICES) + r.offset; }
+		const double* GetDoubles(const SGLTFSnapshot_Range& r) const { return Table<double>(GLTF_SNAPSHOT_TABLE_DOUBLES) + r.offset; }
+		const char* GetString(const SGLTFSnapshot_String& s) const { return Table<char>(GLTF_SNAPSHOT_TABLE_STRINGS) + s.offset; }
+		const uint8_t* GetData(const SGLTFSnapshot_Blob& b) const { return m_data + b.offset; }
+
+		// Finds the attribute accessor by name in a primitive, -1 if its not there
+		int32_t FindAttribute(const SGLTFSnapshot_Primitive& primitive, const char* name) const;
+
+	private:
+		template<typename T>
+		const T* Table(EGLTFSnapshot_Table table) const { return reinterpret_cast<const T*>(m_data + GetHeader().tables[table].offset); }
+
+		uint32_t Count(EGLTFSnapshot_Table table) const { return static_cast<uint32_t>(GetHeader().tables[table].size); }
+
+		const uint8_t* m_data = nullptr;
+		uint64_t m_size = 0;
+
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+}
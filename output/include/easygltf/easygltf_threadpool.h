@@ -0,0 +1,79 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EGLTF
+{
+	// Work stealing thread pool.
+	// Every worker has its own deque, tasks spawned from a worker go to the back of its deque and are taken LIFO by the worker itself
+	// and FIFO by idle workers stealing from it. Tasks submitted from outside the pool go to a shared queue.
+	// ParallelFor callers work on their own chunks instead of blocking, so nesting is fine.
+	class CGLTFThreadPool
+	{
+	public:
+		typedef std::function<void()> TTask;
+
+		// 0 uses std::thread::hardware_concurrency
+		explicit CGLTFThreadPool(uint32_t threadCount = 0);
+		~CGLTFThreadPool();
+
+		CGLTFThreadPool(const CGLTFThreadPool&) = delete;
+		CGLTFThreadPool& operator=(const CGLTFThreadPool&) = delete;
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+		void Submit(TTask task);
+
+		// Calls func(begin, end) over [0, count) in chunks of at most grain elements and returns once all of them ran.
+		// The calling thread works on chunks as well.
+		void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& func);
+
+		// Runs a single queued task on the calling thread, false if there was nothing to run
+		bool RunPendingTask();
+
+	private:
+		struct SWorkerQueue
+		{
+			std::mutex mutex;
+			std::deque<TTask> tasks;
+		};
+
+		void WorkerLoop(uint32_t index);
+		bool TryPop(TTask& task);
+
+		std::vector<std::thread> m_workers;
+		std::vector<std::unique_ptr<SWorkerQueue>> m_queues; // one per worker
+		SWorkerQueue m_shared; // for tasks submitted from outside the pool
+
+		std::mutex m_sleepMutex;
+		std::condition_variable m_sleepCondition;
+		std::atomic<uint64_t> m_pending;
+		std::atomic<bool> m_stop;
+	};
+}
@@ -0,0 +1,64 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	// Records every event and writes them out in the Chrome trace_event format, open the file in chrome://tracing or Perfetto.
+	// Events can come in from several threads, each shows up on its own track.
+	class CGLTFChromeTraceExporter : public IGLTFLoadListener
+	{
+	public:
+		void OnEventEnd(const SGLTFLoadEvent& event) override;
+
+		bool Write(const std::string& filepath) const;
+		std::string GetJson() const;
+
+		void Clear();
+
+	private:
+		struct SRecord
+		{
+			SGLTFLoadEvent event;
+			std::string name;
+			uint32_t thread;
+		};
+
+		mutable std::mutex m_mutex;
+		std::vector<SRecord> m_records;
+	};
+
+	// Prints a line per event, pretty much what the library used to do unconditionally
+	class CGLTFProgressPrinter : public IGLTFLoadListener
+	{
+	public:
+		explicit CGLTFProgressPrinter(FILE* out = stdout) : m_out(out) {}
+
+		void OnEventEnd(const SGLTFLoadEvent& event) override;
+
+	private:
+		FILE* m_out;
+	};
+}
@@ -0,0 +1,66 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	enum class EGLTFValidationSeverity
+	{
+		ERROR, // the asset can't be used as is, reading it would go out of bounds or hand out wrong data
+		WARNING // against the specs but harmless to read
+	};
+
+	struct SGLTFValidationIssue
+	{
+		EGLTFValidationSeverity severity;
+		std::string path; // json path of the offending property, "accessors[3].bufferView"
+		std::string message;
+	};
+
+	struct SGLTFValidationReport
+	{
+		std::vector<SGLTFValidationIssue> issues; // in the order of the sections, deterministic with or without a pool
+
+		bool HasErrors() const;
+		void Print(FILE* out = stderr) const;
+	};
+
+	// Checks the container before it is parsed: header, declared length, chunk lengths, types and 4 byte alignment
+	bool ValidateGLB(const std::vector<uint8_t>& buffer, SGLTFValidationReport& report);
+	bool ValidateGLB(const uint8_t* data, size_t size, SGLTFValidationReport& report);
+
+	// Checks a loaded asset for everything an untrusted file could get wrong:
+	// every index into another section, every byte range against the buffer it lives in, strides and alignment,
+	// index values against the vertex count of their primitive, sparse indices (increasing, inside the accessor), accessor min/max
+	// against the data with the sparse values in and the node hierarchy (single parent, no cycles). The data checks run per accessor,
+	// on the pool if there is one.
+	// Returns false if there were errors, warnings alone pass.
+	// With the selection of a filtered load, the buffers, views, accessors and images it left out are not checked.
+	// The compact asset of a compact load (CEasyGLTF::SetCompact) has the nodes and accessor bounds, pass it along with the asset.
+	bool ValidateGLTFAsset(const SGLTFAsset& asset, SGLTFValidationReport& report, CGLTFThreadPool* pool = nullptr, const SGLTFLoadSelection* selection = nullptr,
+		const SGLTFCompactAsset* compact = nullptr);
+}
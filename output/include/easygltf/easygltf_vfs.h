@@ -0,0 +1,163 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace EGLTF
+{
+	// One stretch of a file to read and where it goes
+	struct SGLTFFileRead
+	{
+		uint64_t offset;
+		uint64_t length;
+		uint8_t* out;
+	};
+
+	// Where CEasyGLTF gets its files from: the .gltf/.glb itself, external buffers and images.
+	// Paths are '/' separated, uris get resolved against the directory of the file that refers to them (ResolveGLTFUri).
+	// Resources are read from pool threads, so every method has to be safe to call concurrently.
+	class IGLTFFileSystem
+	{
+	public:
+		virtual ~IGLTFFileSystem() {}
+
+		// The whole file, false if there is no such file
+		virtual bool ReadFile(const std::string& path, std::vector<uint8_t>& out) = 0;
+
+		// Several stretches of the same file, false if one of them could not be read
+		virtual bool ReadFileRanges(const std::string& path, const SGLTFFileRead* reads, size_t count) = 0;
+
+		// Size and modification time, what Reload uses to tell whether a file changed
+		virtual bool StatFile(const std::string& path, uint64_t& size, int64_t& mtime) = 0;
+
+		// Backends that have the file in memory already hand out a view instead of a copy, it stays valid as long as the file system
+		// is not changed or destroyed. False if there is no such file or the backend can't.
+		virtual bool GetFileView(const std::string& /*path*/, const uint8_t*& /*data*/, uint64_t& /*size*/) { return false; }
+	};
+
+	// Files on disk, what CEasyGLTF uses when no file system is set
+	class CGLTFDiskFileSystem : public IGLTFFileSystem
+	{
+	public:
+		bool ReadFile(const std::string& path, std::vector<uint8_t>& out) override;
+		bool ReadFileRanges(const std::string& path, const SGLTFFileRead* reads, size_t count) override;
+		bool StatFile(const std::string& path, uint64_t& size, int64_t& mtime) override;
+
+		// Shared instance, it has no state
+		static CGLTFDiskFileSystem& Get();
+	};
+
+	// Files handed over in memory, for assets that came in over the network or were generated.
+	// Add everything before loading, the file system is only read from during loads.
+	class CGLTFMemoryFileSystem : public IGLTFFileSystem
+	{
+	public:
+		void AddFile(const std::string& path, std::vector<uint8_t> data);
+
+		// Not copied, the memory has to outlive the file system
+		void AddFileView(const std::string& path, const uint8_t* data, size_t size);
+
+		void RemoveFile(const std::string& path);
+		void Clear() { m_files.clear(); }
+
+		bool ReadFile(const std::string& path, std::vector<uint8_t>& out) override;
+		bool ReadFileRanges(const std::string& path, const SGLTFFileRead* reads, size_t count) override;
+		bool StatFile(const std::string& path, uint64_t& size, int64_t& mtime) override; // mtime counts the AddFile calls
+		bool GetFileView(const std::string& path, const uint8_t*& data, uint64_t& size) override;
+
+	private:
+		struct SFile
+		{
+			std::vector<uint8_t> owned;
+			const uint8_t* data;
+			size_t size;
+			int64_t version;
+		};
+
+		const SFile* Find(const std::string& path) const;
+
+		std::map<std::string, SFile> m_files;
+		int64_t m_version = 0;
+	};
+
+	// A package file mapped into memory once, the files in it are views into the mapping. Opening thousands of small assets from a
+	// package costs one open and one mmap instead of one open per .gltf, buffer and image.
+	// Reads zip archives whose entries are stored (compressed entries are skipped) and packs written by WriteGLTFPackage:
+	//   "EGPK", uint32 version = 1, uint32 file count, uint32 0
+	//   per file: uint64 offset, uint64 size, uint32 name length, name
+	//   file data, every file at a 16 byte aligned offset
+	// all little endian. Paths are the names inside the package.
+	class CGLTFArchiveFileSystem : public IGLTFFileSystem
+	{
+	public:
+		CGLTFArchiveFileSystem() {}
+		~CGLTFArchiveFileSystem();
+
+		CGLTFArchiveFileSystem(const CGLTFArchiveFileSystem&) = delete;
+		CGLTFArchiveFileSystem& operator=(const CGLTFArchiveFileSystem&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		bool IsOpen() const { return m_data != nullptr; }
+		size_t GetFileCount() const { return m_entries.size(); }
+
+		bool ReadFile(const std::string& path, std::vector<uint8_t>& out) override;
+		bool ReadFileRanges(const std::string& path, const SGLTFFileRead* reads, size_t count) override;
+		bool StatFile(const std::string& path, uint64_t& size, int64_t& mtime) override; // mtime is the one of the package
+		bool GetFileView(const std::string& path, const uint8_t*& data, uint64_t& size) override;
+
+	private:
+		struct SEntry
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		bool ParsePack();
+		bool ParseZip();
+
+		std::unordered_map<std::string, SEntry> m_entries;
+		const uint8_t* m_data = nullptr;
+		uint64_t m_size = 0;
+		int64_t m_mtime = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+
+	struct SGLTFPackageFile
+	{
+		std::string name; // path inside the package, what loads from it ask for
+		std::string source; // file on disk
+	};
+
+	// Writes a pack CGLTFArchiveFileSystem can open
+	bool WriteGLTFPackage(const std::string& filepath, const std::vector<SGLTFPackageFile>& files);
+
+	// The path of a uri relative to a directory ("" or ending in '/'): percent escapes decoded, "." and ".." folded.
+	// "models/" + "../textures/a%20b.png" is "textures/a b.png".
+	std::string ResolveGLTFUri(const std::string& directory, const std::string& uri);
+}
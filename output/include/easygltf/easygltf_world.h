@@ -0,0 +1,219 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "easygltf.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+	class IGLTFFileSystem;
+
+	struct SGLTFWorldTile
+	{
+		std::string filepath;
+		std::array<float, 3> boundsMin; // world space, min > max for a tile that could not be loaded
+		std::array<float, 3> boundsMax;
+		uint64_t bytes = 0; // what the loaded asset holds, GetGLTFMemoryReport's total
+		uint64_t fileSize = 0; // of the .gltf/.glb at the time it was indexed, to tell whether it changed
+		int64_t mtime = 0;
+	};
+
+	// Bounds and memory footprint of every tile of a world, with a uniform grid over them on the ground (x and z, +y is up in glTF).
+	// Building loads every tile once, so it is meant to be done once and saved:
+	//   "EGWI", uint32 version = 1, uint32 tile count, uint32 column count, uint32 row count, float cell size, float origin x, z
+	//   per tile: float min[3], max[3], uint64 bytes, uint64 file size, int64 mtime, uint32 path length, path
+	//   uint32 offsets[columns * rows + 1], uint32 tiles, what cell c holds is tiles[offsets[c]] to tiles[offsets[c + 1]]
+	// all little endian. Cells are row major, a tile is listed in every cell its bounds overlap.
+	class CGLTFWorldIndex
+	{
+	public:
+		// Not owned, nullptr (the default) reads from disk. Used to stat and load the tiles, the streamer loads through it as well.
+		void SetFileSystem(IGLTFFileSystem* fileSystem) { m_fileSystem = fileSystem; }
+		IGLTFFileSystem* GetFileSystem() const { return m_fileSystem; }
+
+		// Loads the tiles on the pool for their bounds (the POSITION min/max of every mesh instance in the scene) and footprint.
+		// Tiles of previous whose file has the same path, size and mtime are taken over without loading them, so rebuilding after a
+		// few tiles changed only costs those. cellSize 0 uses the median extent of the tiles.
+		// False if a tile could not be loaded, the index is complete otherwise and the tile never gets streamed.
+		bool Build(const std::vector<std::string>& files, float cellSize = 0.0f, CGLTFThreadPool* pool = nullptr, const CGLTFWorldIndex* previous = nullptr);
+
+		bool Save(const std::string& filepath) const;
+
+		// False if the file is missing or broken. Does not check the tiles, see CountStaleTiles.
+		bool Load(const std::string& filepath);
+
+		// Tiles whose file changed or is gone since it was indexed
+		size_t CountStaleTiles() const;
+
+		// Tiles whose bounds come within radius of position, ascending by index
+		void Query(const std::array<float, 3>& position, float radius, std::vector<uint32_t>& out) const;
+
+		// Distance from position to the bounds of a tile, 0 inside
+		float GetDistance(uint32_t tile, const std::array<float, 3>& position) const;
+
+		const std::vector<SGLTFWorldTile>& GetTiles() const { return m_tiles; }
+		float GetCellSize() const { return m_cellSize; }
+
+	private:
+		void BuildGrid(float cellSize);
+
+		IGLTFFileSystem* m_fileSystem = nullptr;
+		std::vector<SGLTFWorldTile> m_tiles;
+
+		float m_cellSize = 0.0f;
+		float m_origin[2] = {}; // x, z of the corner of cell 0
+		uint32_t m_columns = 0; // along x
+		uint32_t m_rows = 0; // along z
+		std::vector<uint32_t> m_cellOffsets;
+		std::vector<uint32_t> m_cellTiles;
+
+		// Query marks the tiles it found here so tiles spanning several cells are reported once
+		mutable std::vector<uint32_t> m_queryMarks;
+		mutable uint32_t m_queryStamp = 0;
+	};
+
+	struct SGLTFStreamingOptions
+	{
+		uint64_t memoryBudget = 512ull << 20; // bytes, resident tiles plus the ones loading, counted with the index's footprints
+
+		// Tiles within loadRadius of a camera are loaded nearest first, resident ones stay until they are farther than unloadRadius
+		// from every camera. A resident tile only makes room for a nearer one if it is farther by at least the difference, so tiles
+		// around the edge of the budget don't keep swapping places.
+		float loadRadius = 100.0f;
+		float unloadRadius = 150.0f;
+
+		uint32_t maxLoadsInFlight = 4;
+	};
+
+	struct SGLTFStreamingStats
+	{
+		uint32_t resident = 0;
+		uint32_t loading = 0;
+		uint64_t residentBytes = 0; // measured once loaded
+		uint64_t reservedBytes = 0; // footprints of the tiles loading
+		uint64_t peakBytes = 0; // of resident plus reserved bytes, as loads are taken in (before anything makes room) and after an Update
+		uint32_t overBudget = 0; // Updates that took in a load bigger than its reservation with more than the budget held
+
+		uint64_t loads = 0; // finished, failures included
+		uint64_t failures = 0;
+		uint64_t unloads = 0; // out of range
+		uint64_t evictions = 0; // unloaded for a nearer tile
+		uint64_t discarded = 0; // finished loading after the cameras moved away
+
+		// From the Update that first wanted a tile to the one that made it resident
+		double averageLatencyMs = 0.0;
+		double p95LatencyMs = 0.0;
+		double maxLatencyMs = 0.0;
+	};
+
+	// Keeps the tiles around a set of cameras loaded within a memory budget. Loads run on the pool, Update does everything else on the
+	// calling thread: takes in finished loads, unloads tiles out of range and starts loads for the nearest missing ones.
+	// A load only starts if its footprint fits the budget, so resident plus loading tiles never add up to more than it as long as the
+	// index is current. A tile that comes out bigger than indexed is let in at the cost of the farthest ones, counted in peakBytes and
+	// overBudget, and reserves what it really took from then on.
+	// Not thread safe, Update and the getters belong to one thread.
+	class CGLTFWorldStreamer
+	{
+	public:
+		// Neither is owned, both have to outlive the streamer
+		CGLTFWorldStreamer(const CGLTFWorldIndex& index, CGLTFThreadPool& pool);
+
+		// Waits for the loads still running
+		~CGLTFWorldStreamer();
+
+		CGLTFWorldStreamer(const CGLTFWorldStreamer&) = delete;
+		CGLTFWorldStreamer& operator=(const CGLTFWorldStreamer&) = delete;
+
+		void SetOptions(const SGLTFStreamingOptions& options) { m_options = options; }
+		const SGLTFStreamingOptions& GetOptions() const { return m_options; }
+
+		// Once per frame
+		void Update(const std::vector<std::array<float, 3>>& cameras);
+
+		// nullptr unless the tile is resident, valid until the Update that unloads it
+		const CEasyGLTF* GetTile(uint32_t tile) const;
+
+		// Runs pool tasks on the calling thread until every load that was started finished, then takes them in
+		void WaitIdle();
+
+		SGLTFStreamingStats GetStats() const;
+
+	private:
+		enum class ETileState : uint8_t
+		{
+			UNLOADED,
+			LOADING,
+			RESIDENT
+		};
+
+		struct STileSlot
+		{
+			ETileState state = ETileState::UNLOADED;
+			bool unwanted = false; // loading, but out of range by now
+			bool failed = false; // not tried again
+			uint64_t bytes = 0; // reserved while loading, measured once resident
+			uint64_t measuredBytes = 0; // what the last load came to, reserved instead of the index's footprint once known
+			double wantedSince = -1.0; // ms, -1 when not wanted
+			uint64_t wantedFrame = 0; // last Update that wanted it
+			std::unique_ptr<CEasyGLTF> easygltf;
+		};
+
+		struct SFinished
+		{
+			uint32_t tile;
+			bool ok;
+			uint64_t bytes;
+		};
+
+		void TakeFinished(double now);
+		void StartLoad(uint32_t tile);
+		void Unload(uint32_t tile);
+		float GetDistance(uint32_t tile, const std::vector<std::array<float, 3>>& cameras) const;
+		uint64_t GetFootprint(uint32_t tile) const;
+
+		const CGLTFWorldIndex& m_index;
+		CGLTFThreadPool& m_pool;
+		SGLTFStreamingOptions m_options;
+
+		std::vector<STileSlot> m_slots; // per tile
+		std::vector<uint32_t> m_resident;
+		std::vector<float> m_residentDistances; // to the nearest camera, as of the last Update
+		uint32_t m_loading = 0;
+		uint64_t m_residentBytes = 0;
+		uint64_t m_reservedBytes = 0;
+
+		std::mutex m_finishedMutex; // the only state pool tasks touch
+		std::vector<SFinished> m_finished;
+
+		std::chrono::steady_clock::time_point m_epoch;
+		uint64_t m_frame = 0;
+		SGLTFStreamingStats m_stats;
+		std::vector<float> m_latencies; // ms
+		std::vector<uint32_t> m_nearby; // scratch for Update
+		std::vector<std::pair<float, uint32_t>> m_wanted;
+	};
+}
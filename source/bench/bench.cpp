@@ -0,0 +1,902 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+// Benchmarks every Load* entry point over a corpus of assets.
+//
+// usage: easygltf_bench [--warmup N] [--reps N] [--threads N] [--compact] [--reuse] [--animations] [--thumbnails] [--textures] [--world] [--budget MB] [--out results.json] [--baseline baseline.json] [--threshold 0.10] [files...]
+//
+// Without files the Monster variants and two generated assets are used, a 50000 node city with images in an external .bin and a
+// skinned, morphed and animated .glb. They are generated next to the executable on the first run and reused after that. With --baseline, the median of every (file, entry point) pair is compared against
+// the baseline and the exit code is 1 if any of them got slower by more than the threshold.
+// With --reuse, every (file, entry point) pair is loaded over and over into one instance in reuse mode (CEasyGLTF::SetReuseMemory),
+// the way a worker going through a stream of assets would, so the allocation counts are the steady state.
+// With --animations, the animations of every file are compressed and the ratio and the cost of sampling a frame are printed.
+// With --thumbnails, every file is rendered to a 256x256 thumbnail by the software rasterizer, on one thread for the per core rate and
+// on the pool with --threads.
+// With --textures, the images of every file are block compressed at the default quality, on one thread and on the pool with --threads.
+// With --world, the files are the tiles of one world: they are indexed (world_index.bin, reused by the next run if the tiles did not
+// change), then a camera flies over them twice at 60 Hz with the tiles streamed within --budget MB (a quarter of the world by default).
+// The load benchmarks are skipped then, the exit code is 1 if the budget was ever exceeded.
+
+#include <easygltf/easygltf.h>
+#include <easygltf/easygltf_animation.h>
+#include <easygltf/easygltf_bcn.h>
+#include <easygltf/easygltf_compact.h>
+#include <easygltf/easygltf_raster.h>
+#include <easygltf/easygltf_world.h>
+#include <easygltf/easygltf_threadpool.h>
+
+#include "rapidjson/document.h"
+#include "rapidjson/istreamwrapper.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/prettywriter.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Allocation counts of the whole process, the library's, rapidjson's and the standard library's alike
+static std::atomic<uint64_t> g_allocCount(0);
+static std::atomic<uint64_t> g_allocBytes(0);
+
+static void CountAllocation(size_t size)
+{
+	g_allocCount.fetch_add(1, std::memory_order_relaxed);
+	g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+// rapidjson's CrtAllocator (the json pools) calls malloc directly, so with glibc malloc itself is replaced and operator new, which
+// ends up in malloc, is counted there
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+extern "C" void* malloc(size_t size) __THROW
+{
+	CountAllocation(size);
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) __THROW
+{
+	CountAllocation(count * size);
+	return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) __THROW
+{
+	CountAllocation(size);
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+// operator new and delete go straight to the same pair underneath, so the compiler never sees free() on a new'd pointer
+static void* RawAllocate(size_t size)
+{
+	CountAllocation(size);
+#ifdef __GLIBC__
+	return __libc_malloc(size);
+#else
+	return malloc(size);
+#endif
+}
+
+static void RawFree(void* ptr)
+{
+#ifdef __GLIBC__
+	__libc_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+// Elsewhere only what goes through operator new is counted, which misses rapidjson
+void* operator new(size_t size)
+{
+	void* ptr = RawAllocate(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	RawFree(ptr);
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	RawFree(ptr);
+}
+
+typedef std::chrono::high_resolution_clock TClock;
+
+static double ElapsedMs(TClock::time_point start, TClock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// In KB
+static uint64_t PeakRSS()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return pmc.PeakWorkingSetSize / 1024;
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+struct SPhaseSample
+{
+	double ms = 0.0;
+	uint64_t allocations = 0;
+	uint64_t bytesRead = 0;
+	uint64_t bytesDecoded = 0;
+	uint64_t elements = 0;
+	uint64_t peakRss = 0; // KB, process wide high water mark at the end of the phase
+};
+
+// Collects the load events, sections are phases of their own and all file reads are summed up into a "files" phase
+class CPhaseTimer : public EGLTF::IGLTFLoadListener
+{
+public:
+	void OnEventEnd(const EGLTF::SGLTFLoadEvent& event) override
+	{
+		const bool isFile = event.category == EGLTF::EGLTFLoadEventCategory::FILE;
+
+		// file events can come from pool threads with --threads
+		std::lock_guard<std::mutex> lock(m_mutex);
+		SPhaseSample& sample = m_phases[isFile ? "files" : event.name];
+		sample.ms += (event.endNs - event.beginNs) / 1000000.0;
+		sample.allocations += event.allocations;
+		sample.bytesRead += event.bytesRead;
+		sample.bytesDecoded += event.bytesDecoded;
+		sample.elements += event.elements;
+		sample.peakRss = PeakRSS();
+	}
+
+	uint64_t GetAllocationCount() override
+	{
+		return g_allocCount.load(std::memory_order_relaxed);
+	}
+
+	std::map<std::string, SPhaseSample> m_phases;
+	std::mutex m_mutex;
+};
+
+enum class EEntryPoint
+{
+	GLTF_FILE,
+	GLTF_MEMORY,
+	GLB_FILE,
+	GLB_MEMORY
+};
+
+static const char* EntryPointName(EEntryPoint entry)
+{
+	switch (entry)
+	{
+	case EEntryPoint::GLTF_FILE: return "LoadGLTF_file";
+	case EEntryPoint::GLTF_MEMORY: return "LoadGLTF_memory";
+	case EEntryPoint::GLB_FILE: return "LoadGLB_file";
+	case EEntryPoint::GLB_MEMORY: return "LoadGLB_memory";
+	}
+	return "";
+}
+
+struct SResult
+{
+	std::string file;
+	EEntryPoint entry;
+	uint64_t bytes = 0;
+	std::vector<double> samples; // ms
+	uint64_t allocations = 0; // per load
+	uint64_t allocatedBytes = 0; // per load
+	std::map<std::string, std::vector<SPhaseSample>> phases;
+	bool ok = true;
+
+	// estimated size of the loaded asset, see GetGLTFMemoryReport
+	EGLTF::SGLTFMemoryReport memory;
+	EGLTF::SGLTFMemoryReport compactMemory;
+
+	double Median() const
+	{
+		std::vector<double> sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		return sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+	}
+
+	double Min() const { return samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end()); }
+
+	double Mean() const
+	{
+		double sum = 0.0;
+		for (double v : samples)
+			sum += v;
+		return samples.empty() ? 0.0 : sum / samples.size();
+	}
+};
+
+static bool ReadFile(const std::string& filepath, std::vector<uint8_t>& out)
+{
+	std::ifstream fh(filepath, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!fh.is_open())
+		return false;
+
+	size_t sz = static_cast<size_t>(fh.tellg());
+	fh.seekg(0, std::ios::beg);
+
+	out.resize(sz + 1);
+	fh.read((char*) out.data(), sz);
+	out[sz] = '\0'; // LoadGLTF_memory expects a null terminated string
+
+	return true;
+}
+
+static bool EndsWith(const std::string& str, const std::string& suffix)
+{
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// LoadGLTF_memory only works if every uri is a data uri
+static bool IsSelfContained(const std::vector<uint8_t>& json)
+{
+	const char* text = (const char*) json.data();
+	const char* pos = text;
+	while ((pos = strstr(pos, "\"uri\"")) != nullptr)
+	{
+		pos += 5;
+		while (*pos == ' ' || *pos == ':' || *pos == '\t' || *pos == '\n' || *pos == '\r')
+			++pos;
+
+		if (strncmp(pos, "\"data:", 6) != 0)
+			return false;
+	}
+	return true;
+}
+
+// set with --threads, loads are serial without it
+static EGLTF::CGLTFThreadPool* g_pool = nullptr;
+
+// set with --compact, the timed loads use compact mode
+static bool g_compact = false;
+
+static bool Load(EGLTF::CEasyGLTF& easygltf, EEntryPoint entry, const std::string& filepath, const std::vector<uint8_t>& contents)
+{
+	switch (entry)
+	{
+	case EEntryPoint::GLTF_FILE: return easygltf.LoadGLTF_file(filepath);
+	case EEntryPoint::GLTF_MEMORY: return easygltf.LoadGLTF_memory(contents);
+	case EEntryPoint::GLB_FILE: return easygltf.LoadGLB_file(filepath);
+	case EEntryPoint::GLB_MEMORY: return easygltf.LoadGLB_memory(contents);
+	}
+	return false;
+}
+
+// set with --reuse, all loads of a pair go into the same instance
+static bool g_reuse = false;
+
+// A fresh instance per load unless reused is set
+static bool RunOnce(EEntryPoint entry, const std::string& filepath, const std::vector<uint8_t>& contents, CPhaseTimer* timer, EGLTF::CEasyGLTF* reused)
+{
+	EGLTF::CEasyGLTF local;
+	EGLTF::CEasyGLTF& easygltf = reused ? *reused : local;
+	easygltf.SetLoadListener(timer);
+	easygltf.SetThreadPool(g_pool);
+	easygltf.SetCompact(g_compact);
+	easygltf.SetReuseMemory(reused != nullptr);
+
+	return Load(easygltf, entry, filepath, contents);
+}
+
+static EGLTF::SGLTFMemoryReport MeasureMemory(EEntryPoint entry, const std::string& filepath, const std::vector<uint8_t>& contents, bool compact)
+{
+	EGLTF::CEasyGLTF easygltf;
+	easygltf.SetThreadPool(g_pool);
+	easygltf.SetCompact(compact);
+
+	Load(easygltf, entry, filepath, contents);
+	return EGLTF::GetGLTFMemoryReport(easygltf.GetAssetInstance(), &easygltf.GetCompactAsset());
+}
+
+static SResult Bench(EEntryPoint entry, const std::string& filepath, const std::vector<uint8_t>& contents, int warmup, int reps)
+{
+	SResult result;
+	result.file = filepath;
+	result.entry = entry;
+	result.bytes = contents.size() - 1;
+
+	// no null termination for binary data, copied up front so it stays out of the timings
+	std::vector<uint8_t> glb;
+	if (entry == EEntryPoint::GLB_MEMORY)
+		glb.assign(contents.begin(), contents.end() - 1);
+	const std::vector<uint8_t>& payload = entry == EEntryPoint::GLB_MEMORY ? glb : contents;
+
+	std::unique_ptr<EGLTF::CEasyGLTF> reused(g_reuse ? new EGLTF::CEasyGLTF() : nullptr);
+
+	for (int i = 0; i < warmup; ++i)
+		RunOnce(entry, filepath, payload, nullptr, reused.get());
+
+	for (int i = 0; i < reps; ++i)
+	{
+		CPhaseTimer timer;
+
+		TClock::time_point start = TClock::now();
+
+		result.ok &= RunOnce(entry, filepath, payload, &timer, reused.get());
+
+		result.samples.push_back(ElapsedMs(start, TClock::now()));
+
+		for (const auto& phase : timer.m_phases)
+			result.phases[phase.first].push_back(phase.second);
+	}
+
+	// counted on a load of its own, the timer allocates for its map which would be noise next to a reused load
+	{
+		uint64_t allocs = g_allocCount.load();
+		uint64_t allocBytes = g_allocBytes.load();
+
+		RunOnce(entry, filepath, payload, nullptr, reused.get());
+
+		result.allocations = g_allocCount.load() - allocs;
+		result.allocatedBytes = g_allocBytes.load() - allocBytes;
+	}
+
+	result.memory = MeasureMemory(entry, filepath, payload, false);
+	result.compactMemory = MeasureMemory(entry, filepath, payload, true);
+
+	return result;
+}
+
+static double MedianMs(std::vector<SPhaseSample> samples)
+{
+	if (samples.empty())
+		return 0.0;
+
+	std::sort(samples.begin(), samples.end(), [](const SPhaseSample& a, const SPhaseSample& b) { return a.ms < b.ms; });
+	return samples[samples.size() / 2].ms;
+}
+
+static void WriteResults(const std::vector<SResult>& results, int warmup, int reps, const std::string& filepath)
+{
+	std::ofstream fh(filepath);
+	rapidjson::OStreamWrapper osw(fh);
+	rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(osw);
+
+	writer.StartObject();
+	writer.Key("warmup");
+	writer.Int(warmup);
+	writer.Key("reps");
+	writer.Int(reps);
+	writer.Key("peakRssKB");
+	writer.Uint64(PeakRSS());
+
+	writer.Key("results");
+	writer.StartArray();
+	for (const auto& r : results)
+	{
+		const double median = r.Median();
+
+		writer.StartObject();
+		writer.Key("file");
+		writer.String(r.file.c_str());
+		writer.Key("entry");
+		writer.String(EntryPointName(r.entry));
+		writer.Key("ok");
+		writer.Bool(r.ok);
+		writer.Key("bytes");
+		writer.Uint64(r.bytes);
+		writer.Key("medianMs");
+		writer.Double(median);
+		writer.Key("minMs");
+		writer.Double(r.Min());
+		writer.Key("meanMs");
+		writer.Double(r.Mean());
+		writer.Key("throughputMBs");
+		writer.Double(median > 0.0 ? (r.bytes / (1024.0 * 1024.0)) / (median / 1000.0) : 0.0);
+		writer.Key("allocations");
+		writer.Uint64(r.allocations);
+		writer.Key("allocatedBytes");
+		writer.Uint64(r.allocatedBytes);
+		writer.Key("assetBytes");
+		writer.Uint64(r.memory.total);
+		writer.Key("assetNodeBytes");
+		writer.Uint64(r.memory.nodes);
+		writer.Key("compactAssetBytes");
+		writer.Uint64(r.compactMemory.total);
+		writer.Key("compactAssetNodeBytes");
+		writer.Uint64(r.compactMemory.nodes);
+
+		writer.Key("phases");
+		writer.StartObject();
+		for (const auto& phase : r.phases)
+		{
+			writer.Key(phase.first.c_str());
+			writer.StartObject();
+			writer.Key("medianMs");
+			writer.Double(MedianMs(phase.second));
+			writer.Key("allocations");
+			writer.Uint64(phase.second.back().allocations);
+			writer.Key("bytesRead");
+			writer.Uint64(phase.second.back().bytesRead);
+			writer.Key("bytesDecoded");
+			writer.Uint64(phase.second.back().bytesDecoded);
+			writer.Key("elements");
+			writer.Uint64(phase.second.back().elements);
+			writer.Key("peakRssKB");
+			writer.Uint64(phase.second.back().peakRss);
+			writer.EndObject();
+		}
+		writer.EndObject();
+
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.EndObject();
+}
+
+// Returns the number of regressions
+static int CompareBaseline(const std::vector<SResult>& results, const std::string& filepath, double threshold)
+{
+	std::ifstream fh(filepath);
+	if (!fh.is_open())
+	{
+		fprintf(stderr, "Could not open baseline %s\n", filepath.c_str());
+		return 1;
+	}
+
+	rapidjson::IStreamWrapper isw(fh);
+	rapidjson::Document document;
+	document.ParseStream(isw);
+
+	if (document.HasParseError() || !document.HasMember("results") || !document["results"].IsArray())
+	{
+		fprintf(stderr, "Baseline %s is not a benchmark result file\n", filepath.c_str());
+		return 1;
+	}
+
+	// Malformed entries of a stale or hand edited baseline are skipped
+	std::vector<const rapidjson::Value*> entries;
+	const rapidjson::Value& baselineResults = document["results"];
+	for (rapidjson::SizeType i = 0; i < baselineResults.Size(); ++i)
+	{
+		const rapidjson::Value& v = baselineResults[i];
+		if (!v.IsObject() || !v.HasMember("file") || !v["file"].IsString() || !v.HasMember("entry") || !v["entry"].IsString() ||
+			!v.HasMember("medianMs") || !v["medianMs"].IsNumber())
+		{
+			fprintf(stderr, "\nError: Skipping malformed entry %u of baseline %s\n", i, filepath.c_str());
+			continue;
+		}
+		entries.push_back(&v);
+	}
+
+	int regressions = 0;
+	for (const auto& r : results)
+	{
+		for (const rapidjson::Value* entry : entries)
+		{
+			const rapidjson::Value& v = *entry;
+			if (r.file != v["file"].GetString() || strcmp(EntryPointName(r.entry), v["entry"].GetString()) != 0)
+				continue;
+
+			const double baseline = v["medianMs"].GetDouble();
+			const double current = r.Median();
+			const double change = baseline > 0.0 ? (current - baseline) / baseline : 0.0;
+			const bool regressed = change > threshold;
+
+			printf("%-10s %-16s %s: %.3f ms -> %.3f ms (%+.1f%%)\n", regressed ? "REGRESSED" : "ok", EntryPointName(r.entry),
+				r.file.c_str(), baseline, current, change * 100.0);
+
+			if (regressed)
+				++regressions;
+		}
+	}
+
+	return regressions;
+}
+
+// The generated part of the default corpus
+static bool GenerateCorpus(std::vector<std::string>& files)
+{
+	struct SGenerated
+	{
+		const char* name;
+		const char* args;
+	};
+
+	static const SGenerated generated[] = {
+		{ "city.gltf", "--seed 7 --nodes 50000 --hierarchy tree --meshes 64 --vertices 20000 --materials 16 --images 4" },
+		{ "skinned.glb", "--nodes 200 --meshes 4 --targets 8 --animations 10 --keyframes 600" }
+	};
+
+	for (const SGenerated& asset : generated)
+	{
+		const std::string filepath = std::string(EASYGLTF_BENCH_GENERATED) + "/" + asset.name;
+		if (!std::ifstream(filepath).good())
+		{
+			const std::string command = std::string("\"") + EASYGLTF_BENCH_GENERATOR + "\" --out \"" + filepath + "\" " + asset.args;
+			if (system(command.c_str()) != 0)
+			{
+				fprintf(stderr, "Could not generate %s\n", filepath.c_str());
+				return false;
+			}
+		}
+		files.push_back(filepath);
+	}
+
+	return true;
+}
+
+// Compression ratio and the time it takes to sample every compressed animation once per frame, over a second at 60 Hz
+static void BenchAnimations(const std::string& filepath, int reps)
+{
+	EGLTF::CEasyGLTF easygltf;
+	easygltf.SetThreadPool(g_pool);
+	if (!(EndsWith(filepath, ".glb") ? easygltf.LoadGLB_file(filepath) : easygltf.LoadGLTF_file(filepath)))
+		return;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	if (asset.animations.empty())
+		return;
+
+	std::vector<EGLTF::SGLTFCompressedAnimation> animations;
+	EGLTF::SGLTFAnimationCompressionReport report;
+	const auto compressStart = std::chrono::steady_clock::now();
+	EGLTF::CompressGLTFAnimations(asset, animations, report, EGLTF::SGLTFAnimationCompressionOptions(), g_pool);
+	const double compressMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compressStart).count();
+
+	std::vector<EGLTF::SGLTFNodePose> poses;
+	EGLTF::GetGLTFRestPose(asset, poses);
+
+	const int frames = 60;
+	uint64_t tracks = 0;
+	for (const auto& animation : animations)
+		tracks += animation.tracks.size();
+
+	const auto sampleStart = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; ++r)
+		for (int f = 0; f < frames; ++f)
+			for (const auto& animation : animations)
+				EGLTF::SampleGLTFCompressedAnimation(animation, animation.start + animation.duration * f / (frames - 1), poses);
+	const double sampleNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - sampleStart).count() / (double(reps) * frames);
+
+	printf("%-10zu %8.2f:1 %10.1f %10llu %12.1f %12.3f %10.3g  %s\n", animations.size(), report.GetRatio(), report.bytesAfter / 1024.0,
+		(unsigned long long) tracks, sampleNs, compressMs, report.maxError, filepath.c_str());
+}
+
+// Thumbnails per second on one core, the way a farm of single threaded workers would render them, textures decoded every time
+static void BenchThumbnails(const std::string& filepath, int reps)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!(EndsWith(filepath, ".glb") ? easygltf.LoadGLB_file(filepath) : easygltf.LoadGLTF_file(filepath)))
+		return;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	EGLTF::SGLTFRenderOptions options;
+	EGLTF::SGLTFBitmap bitmap;
+
+	EGLTF::CGLTFRasterizer serial;
+	if (!serial.Render(asset, bitmap, options))
+		return;
+
+	const auto serialStart = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; ++r)
+		serial.Render(asset, bitmap, options);
+	const double serialMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - serialStart).count() / reps;
+
+	double pooledMs = 0.0;
+	if (g_pool)
+	{
+		EGLTF::CGLTFRasterizer pooled;
+		pooled.SetThreadPool(g_pool);
+		pooled.Render(asset, bitmap, options);
+
+		const auto pooledStart = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; ++r)
+			pooled.Render(asset, bitmap, options);
+		pooledMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pooledStart).count() / reps;
+	}
+
+	const EGLTF::SGLTFRenderStats& stats = serial.GetStats();
+	printf("%-10llu %10llu %12.3f %12.1f %12.3f  %s\n", (unsigned long long) stats.triangles, (unsigned long long) stats.rasterized, serialMs,
+		serialMs > 0.0 ? 1000.0 / serialMs : 0.0, pooledMs, filepath.c_str());
+}
+
+// Texels per second through the block compressor, decoding and mips included, and what the blocks lose against the source
+static void BenchTextures(const std::string& filepath)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!(EndsWith(filepath, ".glb") ? easygltf.LoadGLB_file(filepath) : easygltf.LoadGLTF_file(filepath)))
+		return;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	std::vector<EGLTF::SGLTFBlockImage> images;
+	EGLTF::SGLTFBlockStats serial;
+	EGLTF::CompressGLTFImages(asset, images, serial);
+
+	EGLTF::SGLTFBlockStats pooled;
+	if (g_pool)
+		EGLTF::CompressGLTFImages(asset, images, pooled, EGLTF::SGLTFBlockOptions(), g_pool);
+
+	printf("%-10u %10.2f %10.2f %10.2f %8.2f:1 %12.2f  %s\n", serial.images, serial.GetMegatexelsPerSecond(), serial.minPsnr, serial.averagePsnr,
+		serial.bytesAfter > 0 ? double(serial.bytesBefore) / double(serial.bytesAfter) : 0.0, pooled.GetMegatexelsPerSecond(), filepath.c_str());
+}
+
+// Indexes the tiles, then streams them along a scripted camera path: from one corner of the world to the opposite one and back
+// through the middle, paced at 60 Hz so loads have the time they would have in a game. False if the budget was exceeded.
+static bool BenchWorld(const std::vector<std::string>& files, double budgetMB)
+{
+	std::unique_ptr<EGLTF::CGLTFThreadPool> ownPool;
+	EGLTF::CGLTFThreadPool* pool = g_pool;
+	if (!pool)
+	{
+		ownPool.reset(new EGLTF::CGLTFThreadPool());
+		pool = ownPool.get();
+	}
+
+	const std::string indexPath = "world_index.bin";
+	EGLTF::CGLTFWorldIndex previous;
+	const bool havePrevious = previous.Load(indexPath);
+
+	EGLTF::CGLTFWorldIndex index;
+	const auto buildStart = std::chrono::steady_clock::now();
+	index.Build(files, 0.0f, pool, havePrevious ? &previous : nullptr);
+	const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+	index.Save(indexPath);
+
+	const auto& tiles = index.GetTiles();
+	std::array<float, 3> worldMin = {{ FLT_MAX, FLT_MAX, FLT_MAX }}, worldMax = {{ -FLT_MAX, -FLT_MAX, -FLT_MAX }};
+	uint64_t worldBytes = 0;
+	for (const auto& tile : tiles)
+	{
+		if (tile.boundsMin[0] > tile.boundsMax[0])
+			continue;
+
+		worldBytes += tile.bytes;
+		for (int i = 0; i < 3; ++i)
+		{
+			worldMin[i] = std::min(worldMin[i], tile.boundsMin[i]);
+			worldMax[i] = std::max(worldMax[i], tile.boundsMax[i]);
+		}
+	}
+
+	if (worldBytes == 0)
+		return true;
+
+	EGLTF::SGLTFStreamingOptions options;
+	options.memoryBudget = budgetMB > 0.0 ? static_cast<uint64_t>(budgetMB * 1024.0 * 1024.0) : worldBytes / 4;
+	options.loadRadius = index.GetCellSize() * 2.0f;
+	options.unloadRadius = index.GetCellSize() * 3.0f;
+	options.maxLoadsInFlight = std::max<uint32_t>(2, pool->GetThreadCount());
+
+	EGLTF::CGLTFWorldStreamer streamer(index, *pool);
+	streamer.SetOptions(options);
+
+	const int frames = 600;
+	const auto frameTime = std::chrono::microseconds(16667);
+	std::vector<std::array<float, 3>> cameras(1);
+
+	auto next = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames; ++f)
+	{
+		// corner to corner over the first half, back along the other diagonal in the second
+		const float t = float(f % (frames / 2)) / float(frames / 2 - 1);
+		const bool back = f >= frames / 2;
+		cameras[0][0] = worldMin[0] + (worldMax[0] - worldMin[0]) * (back ? 1.0f - t : t);
+		cameras[0][1] = (worldMin[1] + worldMax[1]) * 0.5f;
+		cameras[0][2] = worldMin[2] + (worldMax[2] - worldMin[2]) * t;
+
+		streamer.Update(cameras);
+
+		next += frameTime;
+		std::this_thread::sleep_until(next);
+	}
+	streamer.WaitIdle();
+
+	const EGLTF::SGLTFStreamingStats stats = streamer.GetStats();
+	printf("\n%-8s %10s %10s %10s %10s %8s %8s %8s %8s %10s %10s %10s %8s\n", "tiles", "index ms", "stale", "budget MB", "peak MB", "loads",
+		"unloads", "evicted", "dropped", "avg ms", "p95 ms", "max ms", "over");
+	printf("%-8zu %10.1f %10zu %10.1f %10.1f %8llu %8llu %8llu %8llu %10.1f %10.1f %10.1f %8u\n", tiles.size(), buildMs,
+		havePrevious ? previous.CountStaleTiles() : tiles.size(), options.memoryBudget / (1024.0 * 1024.0), stats.peakBytes / (1024.0 * 1024.0),
+		(unsigned long long) stats.loads, (unsigned long long) stats.unloads, (unsigned long long) stats.evictions,
+		(unsigned long long) stats.discarded, stats.averageLatencyMs, stats.p95LatencyMs, stats.maxLatencyMs, stats.overBudget);
+
+	// the peak is taken as loads finish, before the streamer makes room for a tile that came out bigger than indexed
+	return stats.peakBytes <= options.memoryBudget;
+}
+
+int main(int argc, char** argv)
+{
+	int warmup = 2;
+	int reps = 10;
+	int threads = 0;
+	double threshold = 0.10;
+	std::string outPath = "bench_results.json";
+	std::string baselinePath;
+	bool animations = false;
+	bool thumbnails = false;
+	bool textures = false;
+	bool world = false;
+	double budgetMB = 0.0;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--warmup" && i + 1 < argc)
+			warmup = atoi(argv[++i]);
+		else if (arg == "--reps" && i + 1 < argc)
+			reps = std::max(1, atoi(argv[++i]));
+		else if (arg == "--threads" && i + 1 < argc)
+			threads = std::max(0, atoi(argv[++i]));
+		else if (arg == "--compact")
+			g_compact = true;
+		else if (arg == "--reuse")
+			g_reuse = true;
+		else if (arg == "--animations")
+			animations = true;
+		else if (arg == "--thumbnails")
+			thumbnails = true;
+		else if (arg == "--textures")
+			textures = true;
+		else if (arg == "--world")
+			world = true;
+		else if (arg == "--budget" && i + 1 < argc)
+			budgetMB = atof(argv[++i]);
+		else if (arg == "--out" && i + 1 < argc)
+			outPath = argv[++i];
+		else if (arg == "--baseline" && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else
+			files.push_back(arg);
+	}
+
+	if (files.empty())
+	{
+		const std::string corpus = EASYGLTF_BENCH_CORPUS;
+		files.push_back(corpus + "/glTF/Monster.gltf");
+		files.push_back(corpus + "/glTF-Embedded/Monster.gltf");
+		files.push_back(corpus + "/glTF-Binary/Monster.glb");
+
+		if (!GenerateCorpus(files))
+			return 1;
+	}
+
+	std::unique_ptr<EGLTF::CGLTFThreadPool> pool;
+	if (threads > 0)
+	{
+		pool.reset(new EGLTF::CGLTFThreadPool(threads));
+		g_pool = pool.get();
+	}
+
+	// the tiles of a world are streamed, not loaded one by one
+	if (world)
+		return BenchWorld(files, budgetMB) ? 0 : 1;
+
+	std::vector<SResult> results;
+	for (const auto& file : files)
+	{
+		std::vector<uint8_t> contents;
+		if (!ReadFile(file, contents))
+		{
+			fprintf(stderr, "Could not read %s\n", file.c_str());
+			return 1;
+		}
+
+		if (EndsWith(file, ".glb"))
+		{
+			results.push_back(Bench(EEntryPoint::GLB_FILE, file, contents, warmup, reps));
+			results.push_back(Bench(EEntryPoint::GLB_MEMORY, file, contents, warmup, reps));
+		}
+		else
+		{
+			results.push_back(Bench(EEntryPoint::GLTF_FILE, file, contents, warmup, reps));
+			if (IsSelfContained(contents))
+				results.push_back(Bench(EEntryPoint::GLTF_MEMORY, file, contents, warmup, reps));
+		}
+	}
+
+	printf("\n%-16s %10s %10s %12s %10s  %s\n", "entry", "median ms", "MB/s", "allocations", "ok", "file");
+	for (const auto& r : results)
+	{
+		const double median = r.Median();
+		printf("%-16s %10.3f %10.1f %12llu %10s  %s\n", EntryPointName(r.entry), median,
+			median > 0.0 ? (r.bytes / (1024.0 * 1024.0)) / (median / 1000.0) : 0.0,
+			(unsigned long long) r.allocations, r.ok ? "yes" : "FAILED", r.file.c_str());
+	}
+	printf("peak RSS: %llu KB\n", (unsigned long long) PeakRSS());
+
+	printf("\n%-16s %12s %12s %12s %12s %8s  %s\n", "asset memory", "KB", "compact KB", "nodes KB", "compact", "saved", "file");
+	for (const auto& r : results)
+	{
+		if (r.entry != EEntryPoint::GLTF_FILE && r.entry != EEntryPoint::GLB_FILE)
+			continue;
+
+		printf("%-16s %12.1f %12.1f %12.1f %12.1f %7.1f%%  %s\n", EntryPointName(r.entry), r.memory.total / 1024.0, r.compactMemory.total / 1024.0,
+			r.memory.nodes / 1024.0, r.compactMemory.nodes / 1024.0,
+			r.memory.total > 0 ? 100.0 * (1.0 - double(r.compactMemory.total) / double(r.memory.total)) : 0.0, r.file.c_str());
+	}
+
+	if (animations)
+	{
+		printf("\n%-10s %10s %10s %10s %12s %12s %10s  %s\n", "animations", "ratio", "KB", "tracks", "ns/frame", "compress ms", "drift", "file");
+		for (const auto& file : files)
+			BenchAnimations(file, reps);
+	}
+
+	if (thumbnails)
+	{
+		printf("\n%-10s %10s %12s %12s %12s  %s\n", "triangles", "rasterized", "ms", "per s/core", "pool ms", "file");
+		for (const auto& file : files)
+			BenchThumbnails(file, reps);
+	}
+
+	if (textures)
+	{
+		printf("\n%-10s %10s %10s %10s %10s %12s  %s\n", "images", "Mtex/s", "min dB", "avg dB", "ratio", "pool Mtex/s", "file");
+		for (const auto& file : files)
+			BenchTextures(file);
+	}
+
+	WriteResults(results, warmup, reps, outPath);
+
+	int status = 0;
+	for (const auto& r : results)
+		if (!r.ok)
+			status = 1;
+
+	if (!baselinePath.empty() && CompareBaseline(results, baselinePath, threshold) > 0)
+		status = 1;
+
+	return status;
+}
@@ -16,465 +16,800 @@
 // along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
 
 #include "easygltf.h"
+#include "easygltf_base64.h"
+#include "easygltf_filter.h"
+#include "easygltf_json.h"
+#include "easygltf_loadscope.h"
+#include "easygltf_snapshot.h"
+#include "easygltf_threadpool.h"
+#include "easygltf_topology.h"
+#include "easygltf_validator.h"
+#include "easygltf_vfs.h"
 
 #include "rapidjson/document.h"
 #include "rapidjson/error/en.h"
 #include "base64.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <fstream>
+#include <cstdint>
 #include <numeric>
 
-#define PRINT_PROGRESS 1
+// Each section is reported as a load event, the element count is whatever ended up in m_asset for it
+#define BEGIN_PARSE(x) { CGLTFLoadScope sectionScope(m_listener, EGLTFLoadEventCategory::SECTION, #x, m_loadScope);
+#define END_PARSE(x) sectionScope.SetElements(ElementCount(m_asset.x)); }
 
-#if PRINT_PROGRESS
-#define BEGIN_PARSE(x) printf("Parsing %s...\n", #x);
-#define END_PARSE(x) printf("Parsed %s...\n", #x);
-#else
-#define BEGIN_PARSE(x)
-#define END_PARSE(x)
-#endif
+template<typename T>
+static uint64_t ElementCount(const std::vector<T>& section)
+{
+	return section.size();
+}
+
+template<typename T>
+static uint64_t ElementCount(const T& /*section*/)
+{
+	return 1;
+}
 
 static std::array<double, 16> MatxMat(const std::array<double, 16>& matA, const std::array<double, 16>& matB)
 {
-	std::array<double, 16> res;
+	std::array<double, 16> res = {};
 	for (size_t i = 0; i < 4; i++)
 		for (size_t j = 0; j < 4; j++)
 			for (size_t k = 0; k < 4; k++)
-				res[j * 4 + i] = matA[k * 4 + i] * matB[j*4 + k];
+				res[j * 4 + i] += matA[k * 4 + i] * matB[j*4 + k];
 
 	return res;
 }
 
-// null terminated at eof
-static void LoadFile(const std::string& filepath, std::vector<uint8_t>& out)
+// Empty if the file could not be read. Reading into the same vector again reuses its memory.
+static void LoadFile(EGLTF::IGLTFFileSystem& fileSystem, const std::string& filepath, std::vector<uint8_t>& out, EGLTF::IGLTFLoadListener* listener,
+	EGLTF::CGLTFLoadScope* parent)
 {
-#if PRINT_PROGRESS
-	printf("Loading file: %s..,\n", filepath.c_str());
-#endif
-
-	std::ifstream fh(filepath, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
-	size_t sz = fh.tellg();
-
-	if (sz < 1)
-		return;
+	EGLTF::CGLTFLoadScope scope(listener, EGLTF::EGLTFLoadEventCategory::FILE, filepath.c_str(), parent);
 
-	fh.seekg(0, std::ios::beg);
-
-	out.clear();
-	out.resize(sz + 1); // null char
-
-	if (!fh.is_open())
+	if (!fileSystem.ReadFile(filepath, out))
+	{
+		out.clear();
 		return;
+	}
 
-	fh.read((char*) out.data(), sz);
-
-	fh.close();
-
-#if PRINT_PROGRESS
-	printf("Loaded file: %s...\n", filepath.c_str());
-#endif
+	scope.AddBytesRead(out.size());
 }
 
 EGLTF::CEasyGLTF::CEasyGLTF() {}
 
 EGLTF::CEasyGLTF::~CEasyGLTF() {}
 
-bool EGLTF::CEasyGLTF::LoadGLTF_file(const std::string& filepath)
+// Buffers that are only needed during a load stay allocated for the next one in reuse mode
+void EGLTF::CEasyGLTF::ReleaseScratch(std::vector<uint8_t>& buffer)
+{
+	if (!m_reuseMemory)
+		std::vector<uint8_t>().swap(buffer);
+}
+
+EGLTF::IGLTFFileSystem& EGLTF::CEasyGLTF::GetFileSystem() const
 {
-	std::vector<uint8_t> buffer;
-	
-	size_t lastPos = filepath.find_last_of('/') + 1;
-	m_path = filepath.substr(0, lastPos);
+	return m_fileSystem ? *m_fileSystem : CGLTFDiskFileSystem::Get();
+}
 
-	LoadFile(filepath, buffer);
+// The .gltf/.glb itself, a view where the file system has one so it gets parsed in place, m_fileBuffer otherwise
+bool EGLTF::CEasyGLTF::ReadSourceFile(const std::string& filepath, const uint8_t*& data, size_t& size)
+{
+	IGLTFFileSystem& fileSystem = GetFileSystem();
 
-	if (buffer.size() < 1)
+	uint64_t viewSize = 0;
+	if (fileSystem.GetFileView(filepath, data, viewSize))
 	{
-		return false;
+		CGLTFLoadScope scope(m_listener, EGLTFLoadEventCategory::FILE, filepath.c_str(), nullptr);
+		scope.AddBytesRead(viewSize);
+		size = static_cast<size_t>(viewSize);
+		return size > 0;
 	}
 
-	rapidjson::Document document;
-	document.Parse((char*) buffer.data());
+	LoadFile(fileSystem, filepath, m_fileBuffer, m_listener, nullptr);
+	data = m_fileBuffer.data();
+	size = m_fileBuffer.size();
+	return size > 0;
+}
 
-	if (document.HasParseError())
-	{
-		fprintf(stderr, "\nError(offset %u): %s\n",
-			(unsigned)document.GetErrorOffset(),
-			rapidjson::GetParseError_En(document.GetParseError()));
+bool EGLTF::CEasyGLTF::LoadGLTF_file(const std::string& filepath)
+{
+	BeginLoad(filepath, false);
 
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	if (!ReadSourceFile(filepath, data, size))
 		return false;
-	}
 
-	return ParseGLTF(document);
+	StampFile(filepath, data, size);
+
+	const bool ok = ParseJson(data, size);
+	ReleaseScratch(m_fileBuffer);
+	return ok;
 }
 
 // Only works for gltf files with embedded data
 bool EGLTF::CEasyGLTF::LoadGLTF_memory(const std::vector<uint8_t>& buffer)
 {
-	rapidjson::Document document;
-	document.Parse((char*)buffer.data());
+	BeginLoad("", false);
 
-	if (document.HasParseError())
-	{
-		fprintf(stderr, "\nError(offset %u): %s\n",
-			(unsigned)document.GetErrorOffset(),
-			rapidjson::GetParseError_En(document.GetParseError()));
+	return ParseJson(buffer.data(), buffer.size());
+}
+
+bool EGLTF::CEasyGLTF::LoadGLB_memory(const std::vector<uint8_t>& buffer)
+{
+	BeginLoad("", true);
 
+	return ParseGLB(buffer.data(), buffer.size());
+}
+
+bool EGLTF::CEasyGLTF::LoadGLB_file(const std::string& filepath)
+{
+	BeginLoad(filepath, true);
+
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	if (!ReadSourceFile(filepath, data, size))
 		return false;
+
+	StampFile(filepath, data, size);
+
+	const bool ok = ParseGLB(data, size);
+	ReleaseScratch(m_fileBuffer);
+	return ok;
+}
+
+// Clears everything but the capacity, strings and vectors of the elements are left to Recycle
+static void ClearAsset(EGLTF::SGLTFAsset& asset)
+{
+	asset.asset.version.clear();
+	asset.asset.generator.clear();
+	asset.asset.minVersion.clear();
+	asset.asset.copyright.clear();
+	asset.scene.clear();
+	asset.scenes.clear();
+	asset.meshes.clear();
+	asset.buffers.clear();
+	asset.bufferViews.clear();
+	asset.accessors.clear();
+	asset.materials.clear();
+	asset.textures.clear();
+	asset.cameras.clear();
+	asset.images.clear();
+	asset.skins.clear();
+	asset.animations.clear();
+	asset.samplers.clear();
+	asset.nodes.clear();
+}
+
+static void ClearCompactAsset(EGLTF::SGLTFCompactAsset& compact)
+{
+	compact.nodes.clear();
+	compact.children.clear();
+	compact.names.clear();
+	compact.instancing.clear();
+	compact.accessorMin.clear();
+	compact.accessorMax.clear();
+	compact.bounds.clear();
+	compact.meshWeights.clear();
+	compact.weights.clear();
+}
+
+// Every load starts from scratch, loading into the same instance twice used to append to the previous asset
+void EGLTF::CEasyGLTF::BeginLoad(const std::string& filepath, bool isGLB)
+{
+	// a Reload took the previous asset already
+	if (m_reuseMemory && !m_reload)
+	{
+		// the elements of the last asset get recycled by this load, the ones of the asset before that are husks by now
+		std::swap(m_asset, m_spare);
+		ClearAsset(m_asset);
+		ClearCompactAsset(m_compactAsset);
+	}
+	else
+	{
+		m_asset = SGLTFAsset();
+		m_compactAsset = SGLTFCompactAsset();
 	}
 
-	return ParseGLTF(document);
+	m_binaryBuffer.clear();
+	m_selection = SGLTFLoadSelection();
+
+	// external uris are relative to the file, memory loads have nothing to be relative to
+	const size_t lastPos = filepath.find_last_of('/');
+	if (lastPos != std::string::npos)
+		m_path.assign(filepath, 0, lastPos + 1);
+	else
+		m_path.clear();
+
+	m_filepath = filepath;
+	m_filepathIsGLB = isGLB;
+
+	m_elementHashes.clear();
+	m_fileStamps.clear();
+	m_binaryHash = 0;
+
+	if (m_topology)
+		m_topology->Clear();
 }
 
-bool EGLTF::CEasyGLTF::LoadGLB_memory(const std::vector<uint8_t>& buffer)
+void EGLTF::CEasyGLTF::SetBuildTopology(bool build)
 {
-	return ParseGLB(buffer);
+	if (!build)
+		m_topology.reset();
+	else if (!m_topology)
+		m_topology.reset(new CGLTFTopology());
 }
 
-bool EGLTF::CEasyGLTF::LoadGLB_file(const std::string& filepath)
+void EGLTF::CEasyGLTF::Reset()
 {
-	std::vector<uint8_t> buffer;
-	LoadFile(m_path + filepath, buffer);
+	m_asset = SGLTFAsset();
+	m_spare = SGLTFAsset();
+	m_compactAsset = SGLTFCompactAsset();
+	m_selection = SGLTFLoadSelection();
+
+	std::string().swap(m_path);
+	std::string().swap(m_filepath);
+	m_filepathIsGLB = false;
+
+	std::vector<uint8_t>().swap(m_binaryBuffer);
+	std::vector<uint8_t>().swap(m_fileBuffer);
+	std::vector<char>().swap(m_jsonPool);
+	std::vector<char>().swap(m_jsonStack);
+
+	m_elementHashes.clear();
+	m_fileStamps.clear();
+	m_binaryHash = 0;
+
+	if (m_topology)
+		m_topology->Clear();
+}
 
-	if (buffer.size() < 1)
-		return false;
+// Values and the parse stack each get a pool of their own, the stack then always grows in place
+static const size_t GLTF_JSON_MIN_POOL = 64 * 1024;
 
-	return ParseGLB(buffer);
+// Grows a pool to what the last parse used plus some slack, so the next one of a similar document fits without extra chunks
+static void FitJsonPool(std::vector<char>& pool, size_t used)
+{
+	if (used + GLTF_JSON_MIN_POOL / 4 > pool.size())
+		pool.resize(used + used / 4 + GLTF_JSON_MIN_POOL / 4);
 }
 
-bool EGLTF::CEasyGLTF::ParseGLTF(const rapidjson::Document& document)
+bool EGLTF::CEasyGLTF::ParseJson(const uint8_t* data, size_t size)
 {
-	// For some weird reason, GCC still doesnt "support" this pragma. Ironically, to support this, all it needs to do is ignore it.
-	// Even llvm supports this stuff...
+	bool parsed = false;
 
-	BEGIN_PARSE(asset)
-	if (document.HasMember("asset"))
+	// big documents get split up and parsed on the pool, whatever the split does not take goes the serial way
+	bool split = false;
+	if (m_threadPool)
 	{
-		SGLTFAsset_Prop_Asset asset;
-		if (document["asset"].HasMember("version") && document["asset"]["version"].IsString())
+		CGLTFParallelJson parallel;
 		{
-			asset.version = document["asset"]["version"].GetString();
+			CGLTFLoadScope scope(m_listener, EGLTFLoadEventCategory::JSON, "json", m_loadScope);
+			split = parallel.Parse((const char*) data, size, *m_threadPool);
 		}
-		else
-			return false;
 
-		if (document["asset"].HasMember("minVersion") && document["asset"]["minVersion"].IsString())
-			asset.minVersion = document["asset"]["minVersion"].GetString();
+		if (split)
+			parsed = ParseGLTF(parallel.GetDocument());
+	}
 
-		if (document["asset"].HasMember("generator") && document["asset"]["generator"].IsString())
-			asset.generator = document["asset"]["generator"].GetString();
+	if (!split)
+		parsed = ParseJsonSerial(data, size);
 
-		if (document["asset"].HasMember("copyright") && document["asset"]["copyright"].IsString())
-			asset.copyright = document["asset"]["copyright"].GetString();
+	if (!parsed)
+		return false;
 
-		// The specs kinda allows to have whatever metadata you want in here, but we wont bother with more since these are the 4 the specs actually mention
-		m_asset.asset = asset;
+	if (m_validate)
+	{
+		SGLTFValidationReport report;
+		const bool valid = ValidateGLTFAsset(m_asset, report, m_threadPool, m_filtered ? &m_selection : nullptr, m_compact ? &m_compactAsset : nullptr);
+		report.Print();
+		if (!valid)
+			return false;
 	}
-	else
-		return false; // This is the only top level field the specs actually require to be present
-	END_PARSE(asset)
 
-	BEGIN_PARSE(buffers)
-	if (document.HasMember("buffers") && document["buffers"].IsArray())
+	return true;
+}
+
+bool EGLTF::CEasyGLTF::ParseJsonSerial(const uint8_t* data, size_t size)
+{
+	// without reuse the pools go away with the load, like rapidjson's own would
+	std::vector<char> localPool;
+	std::vector<char> localStack;
+	std::vector<char>& pool = m_reuseMemory ? m_jsonPool : localPool;
+	std::vector<char>& stack = m_reuseMemory ? m_jsonStack : localStack;
+
+	if (pool.size() < GLTF_JSON_MIN_POOL)
+		pool.resize(GLTF_JSON_MIN_POOL);
+	if (stack.size() < GLTF_JSON_MIN_POOL / 16)
+		stack.resize(GLTF_JSON_MIN_POOL / 16);
+
+	size_t poolUsed = 0;
+	size_t stackUsed = 0;
+	bool parsed = false;
 	{
-		for (const auto& v : document["buffers"].GetArray())
+		// a local base so running out of the buffers does not make the pools new one up
+		rapidjson::CrtAllocator base;
+		TJsonPool valueAllocator(pool.data(), pool.size(), GLTF_JSON_MIN_POOL, &base);
+		TJsonPool stackAllocator(stack.data(), stack.size(), GLTF_JSON_MIN_POOL / 16, &base);
+
+		TJsonDocument document(&valueAllocator, stack.size() / 2, &stackAllocator);
 		{
-			if (!v.HasMember("byteLength") || (!v.HasMember("uri") && m_binaryBuffer.size() < 1))
-				return false;
+			CGLTFLoadScope scope(m_listener, EGLTFLoadEventCategory::JSON, "json", m_loadScope);
+			document.Parse((const char*) data, size);
+		}
 
-			SGLTFAsset_Prop_Buffer buffer;
+		poolUsed = valueAllocator.Size();
+		stackUsed = stackAllocator.Size();
+
+		if (document.HasParseError())
+		{
+			fprintf(stderr, "\nError(offset %u): %s\n",
+				(unsigned)document.GetErrorOffset(),
+				rapidjson::GetParseError_En(document.GetParseError()));
+		}
+		else
+			parsed = ParseGLTF(document);
+	}
 
-			buffer.byteLength = v["byteLength"].GetInt();
+	// only once the document is gone, it lives in there
+	if (m_reuseMemory)
+	{
+		FitJsonPool(pool, poolUsed);
+		FitJsonPool(stack, stackUsed);
+	}
 
-			if (m_binaryBuffer.size() < 1)
-			{
-				std::vector<uint8_t> data;
-				std::string value = v["uri"].GetString();
+	return parsed;
+}
 
-				static std::string bufferMIMEType = "data:application/octet-stream;base64,";
-				size_t needlePos = value.find(bufferMIMEType);
-				if (needlePos != std::string::npos)
-				{
-					std::vector<uint8_t> encoded_raw;
-					encoded_raw.resize(value.size() - bufferMIMEType.size());
-					memcpy(encoded_raw.data(), &value[bufferMIMEType.size()], encoded_raw.size());
+// Everything ParseGLTF needs to know about the load that is not in the json itself
+struct SParseContext
+{
+	const std::string& path;
+	EGLTF::IGLTFFileSystem& fileSystem;
+	const std::vector<uint8_t>& binaryBuffer;
+	EGLTF::IGLTFLoadListener* listener;
+	bool deferResources;
+	bool reuseMemory;
+	EGLTF::CGLTFLoadScope* scope; // of the section, files read and blobs decoded on the pool's workers count towards it
+};
+
+// Arrays at least this long get split into chunks of this size when a thread pool is set
+static const size_t GLTF_PARALLEL_GRAIN = 512;
+
+// Buffers and images can be whole files to read or base64 blobs to decode, each one is worth a task
+static const size_t GLTF_RESOURCE_GRAIN = 1;
+
+// Empties a container into another one, which takes over its memory
+template<typename C>
+static void Keep(C& from, C& to)
+{
+	to.swap(from);
+	to.clear();
+}
 
-					std::string encoded(encoded_raw.begin(), encoded_raw.end());
-					std::string decoded;
+// Resets an element of an earlier load to how a new one starts out, holding on to the memory of its strings and vectors
+template<typename T>
+static void Recycle(T& element)
+{
+	element = T();
+}
 
-					std::string error = macaron::Base64::Decode(encoded, decoded);
+static void Recycle(EGLTF::SGLTFAsset_Prop_Buffer& buffer)
+{
+	EGLTF::SGLTFAsset_Prop_Buffer fresh = EGLTF::SGLTFAsset_Prop_Buffer();
+	Keep(buffer.uri, fresh.uri);
+	Keep(buffer.data, fresh.data);
+	buffer = std::move(fresh);
+}
 
-					std::vector<uint8_t> decodedBuffer(decoded.begin(), decoded.end());
-					data = decodedBuffer;
-				}
-				else
-				{
-					std::vector<uint8_t> out;
-					LoadFile(m_path + value, out);
-					data.resize(out.size() - 1); // strip the null termination
-					memcpy(data.data(), out.data(), out.size() - 1);
-				}
+static void Recycle(EGLTF::SGLTFAsset_Prop_Accessor& accessor)
+{
+	EGLTF::SGLTFAsset_Prop_Accessor fresh = EGLTF::SGLTFAsset_Prop_Accessor();
+	Keep(accessor.type, fresh.type);
+	Keep(accessor.min, fresh.min);
+	Keep(accessor.max, fresh.max);
+	accessor = std::move(fresh);
+}
 
-				buffer.data = data;
-			}
-			else
-				buffer.data = m_binaryBuffer;
+static void Recycle(EGLTF::SGLTFAsset_Prop_Material& mat)
+{
+	EGLTF::SGLTFAsset_Prop_Material fresh = EGLTF::SGLTFAsset_Prop_Material();
+	Keep(mat.name, fresh.name);
+	mat = std::move(fresh);
+}
 
-			m_asset.buffers.push_back(buffer);
-		}
-	}
-	END_PARSE(buffers)
+static void Recycle(EGLTF::SGLTFAsset_Prop_Image& image)
+{
+	EGLTF::SGLTFAsset_Prop_Image fresh = EGLTF::SGLTFAsset_Prop_Image();
+	Keep(image.uri, fresh.uri);
+	Keep(image.data, fresh.data);
+	Keep(image.mimeType, fresh.mimeType);
+	image = std::move(fresh);
+}
 
-	BEGIN_PARSE(bufferViews)
-	if (document.HasMember("bufferViews") && document["bufferViews"].IsArray())
+// Primitives and their attribute maps stay, ParseMesh overwrites them in place
+static void Recycle(EGLTF::SGLTFAsset_Prop_Mesh& mesh)
+{
+	mesh.name.clear();
+	mesh.weights.clear();
+	for (auto& primitive : mesh.primitives)
 	{
-		for (const auto& v : document["bufferViews"].GetArray())
-		{
-			if (!v.HasMember("buffer") || !v.HasMember("byteLength"))
-				return false;
+		primitive.mode = -1;
+		primitive.indices = -1;
+		primitive.material = -1;
+	}
+}
 
-			SGLTFAsset_Prop_BufferView bv;
+static void Recycle(EGLTF::SGLTFAsset_Prop_Node& node)
+{
+	EGLTF::SGLTFAsset_Prop_Node fresh = EGLTF::SGLTFAsset_Prop_Node();
+	Keep(node.children, fresh.children);
+	Keep(node.name, fresh.name);
+	node = std::move(fresh);
+}
 
-			bv.buffer = v["buffer"].GetInt();
-			bv.byteLength = v["byteLength"].GetInt();
+static void Recycle(EGLTF::SGLTFAsset_Prop_Skin& skin)
+{
+	EGLTF::SGLTFAsset_Prop_Skin fresh = EGLTF::SGLTFAsset_Prop_Skin();
+	Keep(skin.joints, fresh.joints);
+	Keep(skin.name, fresh.name);
+	skin = std::move(fresh);
+}
 
-			if (v.HasMember("byteOffset"))
-				bv.byteOffset = v["byteOffset"].GetInt();
+static void Recycle(EGLTF::SGLTFAsset_Prop_Animation& anim)
+{
+	anim.name.clear();
+	anim.channels.clear();
+	anim.samplers.clear();
+}
 
-			if (v.HasMember("byteStride"))
-				bv.byteStride = v["byteStride"].GetInt();
-			if (v.HasMember("target"))
-				bv.target = v["target"].GetInt();
+static void Recycle(EGLTF::SGLTFAsset_Prop_Scene& scene)
+{
+	scene.nodes.clear();
+}
 
-			m_asset.bufferViews.push_back(bv);
-		}
-	}
-	END_PARSE(bufferViews)
+// Converts every element of a json array, appending to out.
+// With a thread pool, big arrays are split into chunks that convert in parallel straight into their slot of the presized output,
+// so the result is the same as converting them one after the other. If elements are invalid, the lowest index is the one reported
+// and out ends right before it, which is exactly where the serial loop would have stopped.
+// Elements flagged in unchanged are moved over from previous instead of being converted, that's how Reload keeps what did not change.
+// Elements of recycled are moved into their slot and Recycle'd before converting, so they are parsed into memory that is already there.
+// Elements not flagged in selected stay default constructed.
+template<typename T, typename F>
+static bool ParseArray(const rapidjson::Value& array, std::vector<T>& out, EGLTF::CGLTFThreadPool* pool, size_t grain, const char* section, F parse,
+	std::vector<T>* previous = nullptr, const std::vector<uint8_t>& unchanged = std::vector<uint8_t>(), std::vector<T>* recycled = nullptr,
+	const std::vector<uint8_t>* selected = nullptr)
+{
+	const size_t count = array.Size();
+	const size_t base = out.size();
+	out.resize(base + count);
 
-	BEGIN_PARSE(accessors)
-	if (document.HasMember("accessors") && document["accessors"].IsArray())
+	auto convert = [&](size_t i)
 	{
-		for (const auto& v : document["accessors"].GetArray())
+		if (selected && !EGLTF::SGLTFLoadSelection::Has(*selected, i))
+			return true;
+
+		if (previous && i < unchanged.size() && unchanged[i] && i < previous->size())
 		{
-			if (!v.HasMember("bufferView") || !v.HasMember("type") || !v.HasMember("componentType") || !v.HasMember("count"))
-				return false;
+			out[base + i] = std::move((*previous)[i]);
+			return true;
+		}
+
+		if (recycled && i < recycled->size())
+		{
+			out[base + i] = std::move((*recycled)[i]);
+			Recycle(out[base + i]);
+		}
 
-			SGLTFAsset_Prop_Accessor accessor;
+		return parse(array[static_cast<rapidjson::SizeType>(i)], out[base + i]);
+	};
 
-			accessor.bufferView = v["bufferView"].GetInt();
-			accessor.componentType = v["componentType"].GetInt();
-			accessor.count = v["count"].GetInt();
-			accessor.type = v["type"].GetString();
-			
-			if (v.HasMember("min") && v.HasMember("max"))
+	size_t failed = SIZE_MAX;
+
+	if (!pool || count < grain * 2)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!convert(i))
 			{
-				if (!v["min"].IsArray() || !v["max"].IsArray())
-					return false;
+				failed = i;
+				break;
+			}
+		}
+	}
+	else
+	{
+		std::atomic<size_t> firstFailure(SIZE_MAX);
 
-				for (const auto& vv : v["min"].GetArray())
-				{
-					accessor.min.push_back(vv.GetDouble());
-				}
+		pool->ParallelFor(count, grain, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				// something before this already failed, the rest of the chunk would be thrown away anyway
+				if (i > firstFailure.load(std::memory_order_relaxed))
+					return;
 
-				for (const auto& vv : v["max"].GetArray())
+				if (!convert(i))
 				{
-					accessor.max.push_back(vv.GetDouble());
+					size_t current = firstFailure.load();
+					while (i < current && !firstFailure.compare_exchange_weak(current, i)) {}
+					return;
 				}
 			}
+		});
 
-			if (v.HasMember("byteOffset"))
-				accessor.byteOffset = v["byteOffset"].GetInt();
+		failed = firstFailure.load();
+	}
 
-			if (v.HasMember("sparse"))
-			{
-				const auto& vv = v["sparse"];
+	if (failed != SIZE_MAX)
+	{
+		out.resize(base + failed);
+		fprintf(stderr, "\nError: %s[%zu] is invalid\n", section, failed);
+		return false;
+	}
 
-				if (!vv.HasMember("count") || !vv.HasMember("indices") ||
-				    !vv["indices"].HasMember("bufferView") || !vv["indices"].HasMember("componentType") ||
-				    !vv.HasMember("values") || !vv["values"].HasMember("bufferView"))
-					return false;
+	return true;
+}
 
-				SGLTFAsset_Prop_Accessor_Sparse as;
-				as.count = vv["count"].GetInt();
-				as.values = vv["values"]["bufferView"].GetInt();
-				as.indices = std::make_pair(vv["indices"]["bufferView"].GetInt(), vv["indices"]["componentType"].GetInt());
+// ParseArray over a top level section if the document has it, listing every element that was not taken over in changes
+template<typename T, typename F>
+static bool ParseSection(const rapidjson::Value& document, const char* section, std::vector<T>& out, EGLTF::CGLTFThreadPool* pool, size_t grain, F parse,
+	std::vector<T>* previous, const std::vector<uint8_t>& unchanged, std::vector<int32_t>* changes, std::vector<T>* recycled, const std::vector<uint8_t>* selected)
+{
+	if (!document.HasMember(section) || !document[section].IsArray())
+		return true;
 
-				accessor.sparse = as;
-			}
+	if (!ParseArray(document[section], out, pool, grain, section, parse, previous, unchanged, recycled, selected))
+		return false;
 
-			m_asset.accessors.push_back(accessor);
-		}
+	if (changes)
+	{
+		for (size_t i = 0; i < out.size(); ++i)
+			if (i >= unchanged.size() || !unchanged[i])
+				changes->push_back(static_cast<int32_t>(i));
 	}
-	END_PARSE(accessors)
 
-	BEGIN_PARSE(materials)
-	if (document.HasMember("materials") && document["materials"].IsArray())
+	return true;
+}
+
+// Hashes the json structure itself, so formatting and member order in the file don't matter but every value does
+static uint64_t HashJsonValue(const rapidjson::Value& v, uint64_t hash)
+{
+	const uint8_t type = static_cast<uint8_t>(v.GetType());
+	hash = EGLTF::HashGLTFSnapshotData(&type, sizeof(type), hash);
+
+	switch (v.GetType())
 	{
-		for (const auto& v : document["materials"].GetArray())
-		{
-			SGLTFAsset_Prop_Material mat;
+	case rapidjson::kObjectType:
+	{
+		// xor of the members keeps it independent of their order
+		uint64_t members = 0;
+		for (const auto& member : v.GetObject())
+			members ^= HashJsonValue(member.value, EGLTF::HashGLTFSnapshotData(member.name.GetString(), member.name.GetStringLength()));
+		hash = EGLTF::HashGLTFSnapshotData(&members, sizeof(members), hash);
+		break;
+	}
+	case rapidjson::kArrayType:
+		for (const auto& element : v.GetArray())
+			hash = HashJsonValue(element, hash);
+		break;
+	case rapidjson::kStringType:
+		hash = EGLTF::HashGLTFSnapshotData(v.GetString(), v.GetStringLength(), hash);
+		break;
+	case rapidjson::kNumberType:
+	{
+		const double number = v.GetDouble();
+		hash = EGLTF::HashGLTFSnapshotData(&number, sizeof(number), hash);
+		break;
+	}
+	default:
+		break; // null, true and false are all in the type
+	}
 
-			// In a move that suprised literally no one, the standard doesnt really say which fields are actually necessary...
-			// So, I am going to allow the model to omit anything they want. Dont blame me, blame the standards.
+	return hash;
+}
 
-			// This is not necessary from what I can tell and it surely is not needed to use a mat
-			if (v.HasMember("name") && v["name"].IsString())
-				mat.name = v["name"].GetString();
+namespace EGLTF
+{
+	// Same as macaron::Base64::Decode, but straight from the uri into the output without the string copies in between
+	bool DecodeGLTFBase64(const char* in, size_t length, std::vector<uint8_t>& out)
+	{
+		static const struct STable
+		{
+			uint8_t values[256];
 
-			// I think this is actually needed but wth
-			if (v.HasMember("pbrMetallicRoughness"))
+			STable()
 			{
-				SGLTFAsset_Prop_Material_MRM pbrMRM = {};
+				memset(values, 64, sizeof(values));
+				const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+				for (uint8_t i = 0; i < 64; ++i)
+					values[static_cast<uint8_t>(alphabet[i])] = i;
+				values[static_cast<uint8_t>('=')] = 0;
+			}
+		} table;
 
-				if (v["pbrMetallicRoughness"].HasMember("baseColorTexture"))
-				{
-					SGLTFAsset_Prop_Material_Texture tex;
+		out.clear();
+		if (length % 4 != 0)
+			return false;
 
-					if (!v["pbrMetallicRoughness"]["baseColorTexture"].HasMember("index"))
-						return false;
-					tex.index = v["pbrMetallicRoughness"]["baseColorTexture"]["index"].GetInt();
-
-					if (v["pbrMetallicRoughness"]["baseColorTexture"].HasMember("texCoord"))
-					{
-						size_t tc = v["pbrMetallicRoughness"]["baseColorTexture"]["texCoord"].GetInt();
-						if (tc == 0 || tc == 1)
-							tex.texCoord = tc;
-						else
-							return false;
-					}
-					else
-						tex.texCoord = 0;
+		size_t outLength = length / 4 * 3;
+		if (length > 0 && in[length - 1] == '=')
+			outLength--;
+		if (length > 1 && in[length - 2] == '=')
+			outLength--;
+		out.resize(outLength);
 
-					pbrMRM.baseColorTexture = tex;
-				}
+		for (size_t i = 0, j = 0; i < length; i += 4)
+		{
+			const uint32_t triple = (table.values[static_cast<uint8_t>(in[i])] << 18) + (table.values[static_cast<uint8_t>(in[i + 1])] << 12) +
+				(table.values[static_cast<uint8_t>(in[i + 2])] << 6) + table.values[static_cast<uint8_t>(in[i + 3])];
 
-				if (v["pbrMetallicRoughness"].HasMember("baseColorFactor"))
-				{
-					if (!v["pbrMetallicRoughness"]["baseColorFactor"].IsArray())
-						return false;
+			if (j < outLength) out[j++] = (triple >> 16) & 0xFF;
+			if (j < outLength) out[j++] = (triple >> 8) & 0xFF;
+			if (j < outLength) out[j++] = triple & 0xFF;
+		}
 
-					const auto& vv = v["pbrMetallicRoughness"]["baseColorFactor"].GetArray();
-					if (vv.Size() != 4)
-						return false;
+		return true;
+	}
 
-					for (rapidjson::SizeType i = 0; i < 4; ++i)
-					{
-						double val = vv[i].GetDouble();
-						if (val > 1.0f || val < 0.0f)
-							return false;
-						pbrMRM.baseColorFactor[i] = val;
-					}
-				}
-				
-				if (v["pbrMetallicRoughness"].HasMember("metallicRoughnessTexture"))
-				{
-					SGLTFAsset_Prop_Material_Texture tex;
+	// With ranges, only those parts of an external file are read and byteLength becomes the size of what was read
+	static bool ParseBuffer(const rapidjson::Value& v, SGLTFAsset_Prop_Buffer& buffer, const SParseContext& context,
+		const std::vector<SGLTFFileRange>* ranges, uint8_t* rangeRead)
+	{
+		if (!v.HasMember("byteLength") || (!v.HasMember("uri") && context.binaryBuffer.size() < 1))
+			return false;
 
-					if (!v["pbrMetallicRoughness"]["metallicRoughnessTexture"].HasMember("index"))
-						return false;
-					tex.index = v["pbrMetallicRoughness"]["metallicRoughnessTexture"]["index"].GetInt();
-
-					if (v["pbrMetallicRoughness"]["metallicRoughnessTexture"].HasMember("texCoord"))
-					{
-						size_t tc = v["pbrMetallicRoughness"]["metallicRoughnessTexture"]["texCoord"].GetInt();
-						if (tc == 0 || tc == 1)
-							tex.texCoord = tc;
-						else
-							return false;
-					}
-					else
-						tex.texCoord = 0;
+		buffer.byteLength = v["byteLength"].GetInt64();
 
-					pbrMRM.metallicRoughnessTexture = tex;
-				}
+		if (context.binaryBuffer.size() < 1)
+		{
+			buffer.uri = v["uri"].GetString();
+			if (context.deferResources)
+				return true;
 
-				if (v["pbrMetallicRoughness"].HasMember("metallicFactor"))
-				{
-					if (!v["pbrMetallicRoughness"]["metallicFactor"].IsDouble())
-						return false;
+			const std::string& value = buffer.uri;
 
-					// Maybe these were supposed to be between 0.0 and 1.0?
-					pbrMRM.metallicFactor = v["pbrMetallicRoughness"]["metallicFactor"].GetDouble();
-				}
+			static const char bufferMIMEType[] = "data:application/octet-stream;base64,";
+			const size_t mimeLength = sizeof(bufferMIMEType) - 1;
+			size_t needlePos = value.find(bufferMIMEType);
+			if (needlePos != std::string::npos)
+			{
+				DecodeGLTFBase64(value.data() + mimeLength, value.size() - mimeLength, buffer.data);
+				if (context.scope)
+					context.scope->AddBytesDecoded(buffer.data.size());
 
-				if (v["pbrMetallicRoughness"].HasMember("roughnessFactor"))
+				// no point in keeping the whole blob around twice, unless it's memory the next load gets to reuse
+				if (context.reuseMemory)
+					buffer.uri.clear();
+				else
+					std::string().swap(buffer.uri);
+			}
+			else if (ranges && !ranges->empty())
+			{
+				if (ReadGLTFFileRanges(context.fileSystem, ResolveGLTFUri(context.path, value), *ranges, buffer.data, context.listener, context.scope))
 				{
-					if (!v["pbrMetallicRoughness"]["roughnessFactor"].IsDouble())
-						return false;
-
-					// Maybe these were supposed to be between 0.0 and 1.0?
-					pbrMRM.roughnessFactor = v["pbrMetallicRoughness"]["roughnessFactor"].GetDouble();
+					buffer.byteLength = static_cast<int64_t>(buffer.data.size());
+					*rangeRead = 1;
 				}
-
-				mat.pbrMetallicRoughness = pbrMRM;
 			}
-
-			if (v.HasMember("normalTexture"))
+			else
 			{
-				SGLTFAsset_Prop_Material_Texture_NT tex;
-				// Again, are these supposed to be between 0.0 and 1.0?
+				LoadFile(context.fileSystem, ResolveGLTFUri(context.path, value), buffer.data, context.listener, context.scope);
+			}
+		}
+		else
+			buffer.data = context.binaryBuffer;
 
-				if (v["normalTexture"].HasMember("index") && v["normalTexture"]["index"].IsInt())
-					tex.index = v["normalTexture"]["index"].GetInt();
+		return true;
+	}
 
+	static bool ParseBufferView(const rapidjson::Value& v, SGLTFAsset_Prop_BufferView& bv)
+	{
+		if (!v.HasMember("buffer") || !v.HasMember("byteLength"))
+			return false;
 
-				if (v["normalTexture"].HasMember("scale") && v["normalTexture"]["scale"].IsDouble())
-					tex.scale = v["normalTexture"]["scale"].GetDouble();
+		bv.buffer = v["buffer"].GetInt();
+		bv.byteLength = v["byteLength"].GetInt64();
 
-				if (v["normalTexture"].HasMember("texCoord") && v["normalTexture"]["texCoord"].IsInt())
-				{
-					size_t tc = v["normalTexture"]["texCoord"].GetInt();
-					if (tc == 0 || tc == 1)
-						tex.texCoord = tc;
-					else
-						return false;
-				}
-				else
-					tex.texCoord = 0;
+		if (v.HasMember("byteOffset"))
+			bv.byteOffset = v["byteOffset"].GetInt64();
 
-				mat.normalTexture = tex;
+		if (v.HasMember("byteStride"))
+			bv.byteStride = v["byteStride"].GetInt();
+		if (v.HasMember("target"))
+			bv.target = v["target"].GetInt();
+
+		return true;
+	}
+
+	static bool ParseAccessor(const rapidjson::Value& v, SGLTFAsset_Prop_Accessor& accessor)
+	{
+		if (!v.HasMember("bufferView") || !v.HasMember("type") || !v.HasMember("componentType") || !v.HasMember("count"))
+			return false;
+
+		accessor.bufferView = v["bufferView"].GetInt();
+		accessor.componentType = v["componentType"].GetInt();
+		accessor.count = v["count"].GetInt64();
+		accessor.type = v["type"].GetString();
+		
+		if (v.HasMember("min") && v.HasMember("max"))
+		{
+			if (!v["min"].IsArray() || !v["max"].IsArray())
+				return false;
+
+			for (const auto& vv : v["min"].GetArray())
+			{
+				accessor.min.push_back(vv.GetDouble());
 			}
 
-			if (v.HasMember("occlusionTexture"))
+			for (const auto& vv : v["max"].GetArray())
 			{
-				if (!v["occlusionTexture"].HasMember("strength") || !v["occlusionTexture"].HasMember("index"))
-					return false;
+				accessor.max.push_back(vv.GetDouble());
+			}
+		}
 
-				if (!v["occlusionTexture"]["strength"].IsDouble() || !v["occlusionTexture"]["index"].IsInt())
-					return false;
+		if (v.HasMember("byteOffset"))
+			accessor.byteOffset = v["byteOffset"].GetInt64();
 
-				SGLTFAsset_Prop_Material_Texture_OT tex;
-				// Again, are these supposed to be between 0.0 and 1.0?
-				tex.strength = v["occlusionTexture"]["strength"].GetDouble();
-				tex.index = v["occlusionTexture"]["index"].GetInt();
+		if (v.HasMember("normalized") && v["normalized"].IsBool())
+			accessor.normalized = v["normalized"].GetBool();
 
-				if (v["occlusionTexture"].HasMember("texCoord") && v["occlusionTexture"]["texCoord"].IsInt())
-				{
-					size_t tc = v["occlusionTexture"]["texCoord"].GetInt();
-					if (tc == 0 || tc == 1)
-						tex.texCoord = tc;
-					else
-						return false;
-				}
-				else
-					tex.texCoord = 0;
+		if (v.HasMember("sparse"))
+		{
+			const auto& vv = v["sparse"];
 
-				mat.occlusionTexture = tex;
-			}
+			if (!vv.HasMember("count") || !vv.HasMember("indices") ||
+			    !vv["indices"].HasMember("bufferView") || !vv["indices"].HasMember("componentType") ||
+			    !vv.HasMember("values") || !vv["values"].HasMember("bufferView"))
+				return false;
+
+			SGLTFAsset_Prop_Accessor_Sparse as;
+			as.count = vv["count"].GetInt64();
+			as.values = vv["values"]["bufferView"].GetInt();
+			as.indices = std::make_pair(vv["indices"]["bufferView"].GetInt(), vv["indices"]["componentType"].GetInt());
+
+			accessor.sparse = as;
+		}
+
+		return true;
+	}
+
+	static bool ParseMaterial(const rapidjson::Value& v, SGLTFAsset_Prop_Material& mat)
+	{
+		// In a move that suprised literally no one, the standard doesnt really say which fields are actually necessary...
+		// So, I am going to allow the model to omit anything they want. Dont blame me, blame the standards.
+
+		// This is not necessary from what I can tell and it surely is not needed to use a mat
+		if (v.HasMember("name") && v["name"].IsString())
+			mat.name = v["name"].GetString();
+
+		// the defaults the specs give for whatever is left out
+		SGLTFAsset_Prop_Material_MRM defaultMRM = {};
+		defaultMRM.baseColorFactor = { { 1.0, 1.0, 1.0, 1.0 } };
+		defaultMRM.metallicFactor = 1.0;
+		defaultMRM.roughnessFactor = 1.0;
+		mat.pbrMetallicRoughness = defaultMRM;
+		mat.emissiveFactor = { { 0.0, 0.0, 0.0 } };
+
+		// I think this is actually needed but wth
+		if (v.HasMember("pbrMetallicRoughness"))
+		{
+			SGLTFAsset_Prop_Material_MRM pbrMRM = defaultMRM;
 
-			if (v.HasMember("emissiveTexture"))
+			if (v["pbrMetallicRoughness"].HasMember("baseColorTexture"))
 			{
 				SGLTFAsset_Prop_Material_Texture tex;
 
-				if (!v["emissiveTexture"].HasMember("index"))
+				if (!v["pbrMetallicRoughness"]["baseColorTexture"].HasMember("index"))
 					return false;
-				tex.index = v["emissiveTexture"]["index"].GetInt();
+				tex.index = v["pbrMetallicRoughness"]["baseColorTexture"]["index"].GetInt();
 
-				if (v["emissiveTexture"].HasMember("texCoord"))
+				if (v["pbrMetallicRoughness"]["baseColorTexture"].HasMember("texCoord"))
 				{
-					size_t tc = v["emissiveTexture"]["texCoord"].GetInt();
+					size_t tc = v["pbrMetallicRoughness"]["baseColorTexture"]["texCoord"].GetInt();
 					if (tc == 0 || tc == 1)
 						tex.texCoord = tc;
 					else
@@ -483,473 +818,1430 @@ bool EGLTF::CEasyGLTF::ParseGLTF(const rapidjson::Document& document)
 				else
 					tex.texCoord = 0;
 
-				mat.emissiveTexture = tex;
+				pbrMRM.baseColorTexture = tex;
 			}
 
-			if (v.HasMember("emissiveFactor"))
+			if (v["pbrMetallicRoughness"].HasMember("baseColorFactor"))
 			{
-				if (!v["emissiveFactor"].IsArray())
+				if (!v["pbrMetallicRoughness"]["baseColorFactor"].IsArray())
 					return false;
 
-				const auto& vv = v["emissiveFactor"].GetArray();
-				if (vv.Size() != 3)
+				const auto& vv = v["pbrMetallicRoughness"]["baseColorFactor"].GetArray();
+				if (vv.Size() != 4)
 					return false;
 
-				for (rapidjson::SizeType i = 0; i < 3; ++i)
+				for (rapidjson::SizeType i = 0; i < 4; ++i)
 				{
 					double val = vv[i].GetDouble();
 					if (val > 1.0f || val < 0.0f)
 						return false;
-					mat.emissiveFactor[i] = val;
+					pbrMRM.baseColorFactor[i] = val;
 				}
 			}
+			
+			if (v["pbrMetallicRoughness"].HasMember("metallicRoughnessTexture"))
+			{
+				SGLTFAsset_Prop_Material_Texture tex;
 
-			m_asset.materials.push_back(mat);
-		}
-	}
-	END_PARSE(materials)
-
-	BEGIN_PARSE(textures)
-	// Pretty sure this is needed but whatever
-	if (document.HasMember("textures") && document["textures"].IsArray())
-	{
-		for (const auto& v : document["textures"].GetArray())
-		{
-			SGLTFAsset_Prop_Texture tex;
-			if (v.HasMember("source"))
-				tex.source = v["source"].GetInt();
+				if (!v["pbrMetallicRoughness"]["metallicRoughnessTexture"].HasMember("index"))
+					return false;
+				tex.index = v["pbrMetallicRoughness"]["metallicRoughnessTexture"]["index"].GetInt();
 
-			if (v.HasMember("sampler"))
-				tex.sampler = v["sampler"].GetInt();
+				if (v["pbrMetallicRoughness"]["metallicRoughnessTexture"].HasMember("texCoord"))
+				{
+					size_t tc = v["pbrMetallicRoughness"]["metallicRoughnessTexture"]["texCoord"].GetInt();
+					if (tc == 0 || tc == 1)
+						tex.texCoord = tc;
+					else
+						return false;
+				}
+				else
+					tex.texCoord = 0;
 
-			m_asset.textures.push_back(tex);
-		}
-	}
-	END_PARSE(textures)
+				pbrMRM.metallicRoughnessTexture = tex;
+			}
 
-	BEGIN_PARSE(images)
-	if (document.HasMember("images") && document["images"].IsArray())
-	{
-		for (const auto& v : document["images"].GetArray())
-		{
-			SGLTFAsset_Prop_Image image;
-			if (v.HasMember("uri"))
+			if (v["pbrMetallicRoughness"].HasMember("metallicFactor"))
 			{
-				std::string value = v["uri"].GetString();
-				static std::string jpegMIMEType = "data:image/jpeg;base64";
-				size_t needlePosJpeg = value.find(jpegMIMEType);
-				static std::string pngMIMEType = "data:image/png;base64";
-				size_t needlePosPng = value.find(pngMIMEType);
+				if (!v["pbrMetallicRoughness"]["metallicFactor"].IsDouble())
+					return false;
 
-				if (needlePosJpeg != std::string::npos)
-				{
-					image.data.resize(value.size() - jpegMIMEType.size());
-					memcpy(image.data.data(), &value[jpegMIMEType.size()], image.data.size());
-				}
-				else if (needlePosPng != std::string::npos)
-				{
-					image.data.resize(value.size() - pngMIMEType.size());
-					memcpy(image.data.data(), &value[pngMIMEType.size()], image.data.size());
-				}
-				else
-				{
-					std::vector<uint8_t> out;
-					LoadFile(m_path + value, out);
-					image.data.resize(out.size() - 1); // strip the null termination
-					memcpy(image.data.data(), out.data(), out.size() - 1);
-				}
+				// Maybe these were supposed to be between 0.0 and 1.0?
+				pbrMRM.metallicFactor = v["pbrMetallicRoughness"]["metallicFactor"].GetDouble();
 			}
-			else
+
+			if (v["pbrMetallicRoughness"].HasMember("roughnessFactor"))
 			{
-				if (!v.HasMember("bufferView") || !v.HasMember("mimeType"))
+				if (!v["pbrMetallicRoughness"]["roughnessFactor"].IsDouble())
 					return false;
 
-				image.bufferView = v["bufferView"].GetInt();
-				image.mimeType = v["mimeType"].GetString();
+				// Maybe these were supposed to be between 0.0 and 1.0?
+				pbrMRM.roughnessFactor = v["pbrMetallicRoughness"]["roughnessFactor"].GetDouble();
 			}
 
-			m_asset.images.push_back(image);
+			mat.pbrMetallicRoughness = pbrMRM;
 		}
-	}
-	END_PARSE(images)
 
-	BEGIN_PARSE(samplers)
-	if (document.HasMember("samplers") && document["samplers"].IsArray())
-	{
-		for (const auto& v : document["samplers"].GetArray())
+		if (v.HasMember("normalTexture"))
 		{
-			if (!v.HasMember("magFilter") || !v.HasMember("minFilter") || !v.HasMember("wrapT") || !v.HasMember("wrapS"))
-				return false;
+			SGLTFAsset_Prop_Material_Texture_NT tex;
+			// Again, are these supposed to be between 0.0 and 1.0?
 
-			SGLTFAsset_Prop_Sampler sampler;
-			sampler.magFiler = v["magFilter"].GetInt();
-			sampler.magFiler = v["minFilter"].GetInt();
-			sampler.magFiler = v["wrapT"].GetInt();
-			sampler.magFiler = v["wrapS"].GetInt();
+			if (v["normalTexture"].HasMember("index") && v["normalTexture"]["index"].IsInt())
+				tex.index = v["normalTexture"]["index"].GetInt();
+
+			if (v["normalTexture"].HasMember("scale") && v["normalTexture"]["scale"].IsDouble())
+				tex.scale = v["normalTexture"]["scale"].GetDouble();
+
+			if (v["normalTexture"].HasMember("texCoord") && v["normalTexture"]["texCoord"].IsInt())
+			{
+				size_t tc = v["normalTexture"]["texCoord"].GetInt();
+				if (tc == 0 || tc == 1)
+					tex.texCoord = tc;
+				else
+					return false;
+			}
+			else
+				tex.texCoord = 0;
 
-			m_asset.samplers.push_back(sampler);
+			mat.normalTexture = tex;
 		}
-	}
-	END_PARSE(samplers)
 
-	BEGIN_PARSE(meshes)
-	if (document.HasMember("meshes") && document["meshes"].IsArray())
-	{
-		for (const auto& v : document["meshes"].GetArray())
+		if (v.HasMember("occlusionTexture"))
 		{
-			if (!v.HasMember("primitives") || !v["primitives"].IsArray())
+			if (!v["occlusionTexture"].HasMember("strength") || !v["occlusionTexture"].HasMember("index"))
 				return false;
 
-			SGLTFAsset_Prop_Mesh mesh;
-			
-			for (const auto& vv : v["primitives"].GetArray())
+			if (!v["occlusionTexture"]["strength"].IsDouble() || !v["occlusionTexture"]["index"].IsInt())
+				return false;
+
+			SGLTFAsset_Prop_Material_Texture_OT tex;
+			// Again, are these supposed to be between 0.0 and 1.0?
+			tex.strength = v["occlusionTexture"]["strength"].GetDouble();
+			tex.index = v["occlusionTexture"]["index"].GetInt();
+
+			if (v["occlusionTexture"].HasMember("texCoord") && v["occlusionTexture"]["texCoord"].IsInt())
 			{
-				if (!vv.HasMember("indices") || !vv.HasMember("attributes"))
+				size_t tc = v["occlusionTexture"]["texCoord"].GetInt();
+				if (tc == 0 || tc == 1)
+					tex.texCoord = tc;
+				else
 					return false;
+			}
+			else
+				tex.texCoord = 0;
 
-				SGLTFAsset_Prop_Mesh_Primitive meshPrimitive;
+			mat.occlusionTexture = tex;
+		}
 
-				if (vv.HasMember("mode"))
-					meshPrimitive.mode = vv["mode"].GetInt();
-				meshPrimitive.indices = vv["indices"].GetInt();
-				if (vv.HasMember("materials"))
-					meshPrimitive.material = vv["material"].GetInt();
+		if (v.HasMember("emissiveTexture"))
+		{
+			SGLTFAsset_Prop_Material_Texture tex;
 
-				for (auto iter = vv["attributes"].MemberBegin(); iter != vv["attributes"].MemberEnd(); ++iter)
-					meshPrimitive.attributes.emplace(iter->name.GetString(), iter->value.GetInt());
+			if (!v["emissiveTexture"].HasMember("index"))
+				return false;
+			tex.index = v["emissiveTexture"]["index"].GetInt();
 
-				if (vv.HasMember("targets") && vv["targets"].IsArray())
-				{
-					for (const auto& vvv : vv["targets"].GetArray())
-					{
-						TGLTFAsset_Prop_Mesh_Primitive_Attributes attr;
+			if (v["emissiveTexture"].HasMember("texCoord"))
+			{
+				size_t tc = v["emissiveTexture"]["texCoord"].GetInt();
+				if (tc == 0 || tc == 1)
+					tex.texCoord = tc;
+				else
+					return false;
+			}
+			else
+				tex.texCoord = 0;
 
-						for (auto iter = vvv.MemberBegin(); iter != vvv.MemberEnd(); ++iter)
-							attr.emplace(iter->name.GetString(), iter->value.GetInt());
+			mat.emissiveTexture = tex;
+		}
 
-						meshPrimitive.targets.push_back(attr);
-					}
-				}
+		if (v.HasMember("emissiveFactor"))
+		{
+			if (!v["emissiveFactor"].IsArray())
+				return false;
 
-				mesh.primitives.push_back(meshPrimitive);
-			}
+			const auto& vv = v["emissiveFactor"].GetArray();
+			if (vv.Size() != 3)
+				return false;
 
-			if (v.HasMember("weights") && v["weights"].IsArray())
+			for (rapidjson::SizeType i = 0; i < 3; ++i)
 			{
-				for (const auto& vv : v["weights"].GetArray())
-					mesh.weights.push_back(vv.GetDouble());
+				double val = vv[i].GetDouble();
+				if (val > 1.0f || val < 0.0f)
+					return false;
+				mat.emissiveFactor[i] = val;
 			}
-
-			m_asset.meshes.push_back(mesh);
 		}
+
+		return true;
 	}
-	END_PARSE(meshes)
 
-	BEGIN_PARSE(nodes)
-	if (document.HasMember("nodes") && document["nodes"].IsArray())
+	static bool ParseTexture(const rapidjson::Value& v, SGLTFAsset_Prop_Texture& tex)
+	{
+		if (v.HasMember("source"))
+			tex.source = v["source"].GetInt();
+
+		if (v.HasMember("sampler"))
+			tex.sampler = v["sampler"].GetInt();
+
+		return true;
+	}
+
+	static bool ParseImage(const rapidjson::Value& v, SGLTFAsset_Prop_Image& image, const SParseContext& context)
 	{
-		for (const auto& v : document["nodes"].GetArray())
+		if (v.HasMember("uri"))
 		{
-			SGLTFAsset_Prop_Node node;
+			image.uri = v["uri"].GetString();
+			if (context.deferResources)
+				return true;
+
+			const std::string& value = image.uri;
+			static std::string jpegMIMEType = "data:image/jpeg;base64";
+			size_t needlePosJpeg = value.find(jpegMIMEType);
+			static std::string pngMIMEType = "data:image/png;base64";
+			size_t needlePosPng = value.find(pngMIMEType);
 
-			if (v.HasMember("children") && v["children"].IsArray())
+			if (needlePosJpeg != std::string::npos)
 			{
-				for (const auto& vv : v["children"].GetArray())
-					node.children.push_back(vv.GetInt());
+				image.data.resize(value.size() - jpegMIMEType.size());
+				memcpy(image.data.data(), &value[jpegMIMEType.size()], image.data.size());
 			}
-
-			if (v.HasMember("matrix"))
+			else if (needlePosPng != std::string::npos)
 			{
-				if (!v["matrix"].IsArray())
-					return false;
+				image.data.resize(value.size() - pngMIMEType.size());
+				memcpy(image.data.data(), &value[pngMIMEType.size()], image.data.size());
+			}
 
-				for (rapidjson::SizeType i = 0; i < v["matrix"].Capacity(); ++i)
-					node.matrix[i] = v["matrix"][i].GetDouble();
+			if (needlePosJpeg != std::string::npos || needlePosPng != std::string::npos)
+			{
+				if (context.reuseMemory)
+					image.uri.clear();
+				else
+					std::string().swap(image.uri);
 			}
-			else if (v.HasMember("translation") && v.HasMember("scale") && v.HasMember("rotation"))
+			else
 			{
-				if (!v["translation"].IsArray() || !v["scale"].IsArray() || !v["rotation"].IsArray())
-					return false;
+				LoadFile(context.fileSystem, ResolveGLTFUri(context.path, value), image.data, context.listener, context.scope);
+			}
+		}
+		else
+		{
+			if (!v.HasMember("bufferView") || !v.HasMember("mimeType"))
+				return false;
 
-				const auto& translation = v["translation"].GetArray();
-				const auto& scale = v["scale"].GetArray();
-				const auto& rotation = v["rotation"].GetArray();
-
-				static const std::array<double, 16> identityMatrix = {
-					1.0f, 0.0f, 0.0f, 0.0f,
-					0.0f, 1.0f, 0.0f, 0.0f,
-					0.0f, 0.0f, 1.0f, 0.0f,
-					0.0f, 0.0f, 0.0f, 1.0f
-				};
-
-				std::array<double, 16> translationMatrix = identityMatrix;
-				translationMatrix[3] = translation[0].GetDouble();
-				translationMatrix[7] = translation[1].GetDouble();
-				translationMatrix[1] = translation[2].GetDouble();
-
-				std::array<double, 16> scaleMatrix = identityMatrix;
-				scaleMatrix[0] = scale[0].GetDouble();
-				scaleMatrix[5] = scale[1].GetDouble();
-				scaleMatrix[10] = scale[2].GetDouble();
-
-				// rotation quarternion
-				double qx = rotation[0].GetDouble();
-				double qy = rotation[1].GetDouble();
-				double qz = rotation[2].GetDouble();
-				double qw = rotation[3].GetDouble();
+			image.bufferView = v["bufferView"].GetInt();
+			image.mimeType = v["mimeType"].GetString();
+		}
 
-#define SQR(x) (x * x)
+		return true;
+	}
+
+	static bool ParseSampler(const rapidjson::Value& v, SGLTFAsset_Prop_Sampler& sampler)
+	{
+		if (!v.HasMember("magFilter") || !v.HasMember("minFilter") || !v.HasMember("wrapT") || !v.HasMember("wrapS"))
+			return false;
 
-				const double normalizationVal = 1.0f / std::sqrt(SQR(qx) + SQR(qy) + SQR(qz) + SQR(qw));
-				qx *= normalizationVal;
-				qy *= normalizationVal;
-				qz *= normalizationVal;
-				qw *= normalizationVal;
+		sampler.magFiler = v["magFilter"].GetInt();
+		sampler.magFiler = v["minFilter"].GetInt();
+		sampler.magFiler = v["wrapT"].GetInt();
+		sampler.magFiler = v["wrapS"].GetInt();
 
-				std::array<double, 16> rotationMatrix = {
-					1.0f - 2.0f * qy * qy - 2.0f * qz * qz, 2.0f * qx * qy - 2.0f * qz * qw, 2.0f * qx * qz + 2.0f * qy * qw, 0.0f,
-					2.0f * qx * qy + 2.0f * qz * qw, 1.0f - 2.0f * qx * qx - 2.0f * qz * qz, 2.0f * qy * qz - 2.0f * qx * qw, 0.0f,
-					2.0f * qx * qz - 2.0f * qy * qw, 2.0f * qy * qz + 2.0f * qx * qw, 1.0f - 2.0f * qx * qx - 2.0f * qy * qy, 0.0f,
-					0.0f, 0.0f, 0.0f, 1.0f,
-				};
+		return true;
+	}
 
-				// M = T * R * S
-				std::array<double, 16> TR = MatxMat(translationMatrix, rotationMatrix);
-				node.matrix = MatxMat(TR, scaleMatrix);
+	static bool ParseCamera(const rapidjson::Value& v, SGLTFAsset_Prop_Camera& camera)
+	{
+		if (!v.HasMember("type") || !v["type"].IsString())
+			return false;
 
-				// No regrets
-			}
+		const std::string type = v["type"].GetString();
+		if (type == "perspective" && v.HasMember("perspective"))
+		{
+			const rapidjson::Value& vv = v["perspective"];
+			if (!vv.HasMember("yfov") || !vv.HasMember("znear"))
+				return false;
 
-			if (v.HasMember("mesh"))
-				node.mesh = v["mesh"].GetInt();
+			camera.type = SGLTFAsset_Prop_Camera_Type::PERSPECTIVE;
+			camera.val0 = vv.HasMember("aspectRatio") ? vv["aspectRatio"].GetDouble() : 0.0; // 0 follows the viewport
+			camera.val1 = vv["yfov"].GetDouble();
+			camera.znear = vv["znear"].GetDouble();
+			camera.zfar = vv.HasMember("zfar") ? vv["zfar"].GetDouble() : 0.0;
+			return true;
+		}
+
+		if (type == "orthographic" && v.HasMember("orthographic"))
+		{
+			const rapidjson::Value& vv = v["orthographic"];
+			if (!vv.HasMember("xmag") || !vv.HasMember("ymag") || !vv.HasMember("znear") || !vv.HasMember("zfar"))
+				return false;
 
-			if (v.HasMember("camera"))
-				node.camera = v["camera"].GetInt();
+			camera.type = SGLTFAsset_Prop_Camera_Type::ORTHOGRAPHIC;
+			camera.val0 = vv["xmag"].GetDouble();
+			camera.val1 = vv["ymag"].GetDouble();
+			camera.znear = vv["znear"].GetDouble();
+			camera.zfar = vv["zfar"].GetDouble();
+			return true;
+		}
+
+		return false;
+	}
 
-			if (v.HasMember("skin"))
-				node.skin = v["skin"].GetInt();
+	// Overwrites the values of a map that already has the same keys, only a different set of keys builds it up again
+	static void ParseAttributes(const rapidjson::Value& v, TGLTFAsset_Prop_Mesh_Primitive_Attributes& attributes)
+	{
+		bool sameKeys = attributes.size() == v.MemberCount();
+		for (auto iter = v.MemberBegin(); sameKeys && iter != v.MemberEnd(); ++iter)
+			sameKeys = attributes.count(iter->name.GetString()) != 0;
 
-			if (v.HasMember("name"))
-				node.name = v["name"].GetString();
+		if (!sameKeys)
+			attributes.clear();
 
-			m_asset.nodes.push_back(node);
+		for (auto iter = v.MemberBegin(); iter != v.MemberEnd(); ++iter)
+		{
+			if (sameKeys)
+				attributes.find(iter->name.GetString())->second = iter->value.GetInt();
+			else
+				attributes.emplace(iter->name.GetString(), iter->value.GetInt());
 		}
 	}
-	END_PARSE(nodes)
 
-	BEGIN_PARSE(skins)
-	if (document.HasMember("skins") && document["skins"].IsArray())
+	// Fills the primitives that are already there (a recycled mesh has some) before adding new ones
+	static bool ParseMesh(const rapidjson::Value& v, SGLTFAsset_Prop_Mesh& mesh)
 	{
-		for (const auto& v : document["skins"].GetArray())
+		if (!v.HasMember("primitives") || !v["primitives"].IsArray())
+			return false;
+
+		size_t count = 0;
+		for (const auto& vv : v["primitives"].GetArray())
 		{
-			if (!v.HasMember("inverseBindMatrices") || !v.HasMember("joints") || !v["joints"].IsArray())
+			if (!vv.HasMember("indices") || !vv.HasMember("attributes"))
 				return false;
 
-			SGLTFAsset_Prop_Skin skin;
-			skin.inverseBindMatrices = v["inverseBindMatrices"].GetInt();
-			
-			for (const auto& vv : v["joints"].GetArray())
-				skin.joints.push_back(vv.GetInt());
+			if (count == mesh.primitives.size())
+				mesh.primitives.emplace_back();
+			SGLTFAsset_Prop_Mesh_Primitive& meshPrimitive = mesh.primitives[count++];
+
+			if (vv.HasMember("mode"))
+				meshPrimitive.mode = vv["mode"].GetInt();
+			meshPrimitive.indices = vv["indices"].GetInt();
+			if (vv.HasMember("material"))
+				meshPrimitive.material = vv["material"].GetInt();
 
-			if (v.HasMember("skeleton"))
-				skin.skeleton = v["skeleton"].GetInt();
+			ParseAttributes(vv["attributes"], meshPrimitive.attributes);
 
-			if (v.HasMember("name"))
-				skin.name = v["name"].GetString();
+			size_t targets = 0;
+			if (vv.HasMember("targets") && vv["targets"].IsArray())
+			{
+				for (const auto& vvv : vv["targets"].GetArray())
+				{
+					if (targets == meshPrimitive.targets.size())
+						meshPrimitive.targets.emplace_back();
 
-			m_asset.skins.push_back(skin);
+					ParseAttributes(vvv, meshPrimitive.targets[targets++]);
+				}
+			}
+			meshPrimitive.targets.resize(targets);
 		}
-	}
-	END_PARSE(skins)
+		mesh.primitives.resize(count);
 
-	BEGIN_PARSE(animations)
-	if (document.HasMember("animations") && document["animations"].IsArray())
-	{
-		for (const auto& v : document["animations"].GetArray())
+		if (v.HasMember("weights") && v["weights"].IsArray())
 		{
-			if (!v.HasMember("channels") || !v.HasMember("samplers"))
-				return false;
+			for (const auto& vv : v["weights"].GetArray())
+				mesh.weights.push_back(vv.GetDouble());
+		}
 
-			SGLTFAsset_Prop_Animation anim;
+		return true;
+	}
 
-			for (const auto& vv : v["channels"].GetArray())
-			{
-				if (!vv.HasMember("target") || !vv.HasMember("sampler"))
-					return false;
+	// EXT_mesh_gpu_instancing, false if the node does not have it
+	static bool ParseInstancing(const rapidjson::Value& v, std::map<std::string, int32_t>& attributes)
+	{
+		if (!v.HasMember("extensions") || !v["extensions"].IsObject() || !v["extensions"].HasMember("EXT_mesh_gpu_instancing"))
+			return false;
+
+		const rapidjson::Value& extension = v["extensions"]["EXT_mesh_gpu_instancing"];
+		if (!extension.IsObject() || !extension.HasMember("attributes") || !extension["attributes"].IsObject())
+			return false;
 
-				SGLTFAsset_Prop_Animation_Channel channel;
-				SGLTFAsset_Prop_Animation_Channel_Target target;
+		for (auto iter = extension["attributes"].MemberBegin(); iter != extension["attributes"].MemberEnd(); ++iter)
+			if (iter->value.IsInt())
+				attributes.emplace(iter->name.GetString(), iter->value.GetInt());
 
-				if (!vv["target"].HasMember("path"))
-					return false;
+		return !attributes.empty();
+	}
 
-				std::string type = vv["target"]["path"].GetString();
-				EGLTFAsset_Prop_Animation_Channel_Target_Type etype;
-				
-				if (type == "translation")
-					etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::TRANSLATION;
-				else if (type == "rotation")
-					etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::ROTATION;
-				else if (type == "scale")
-					etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::SCALE;
-				else if (type == "weights")
-					etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::WEIGHTS;
-				else
-					return false;
+	static bool ParseNode(const rapidjson::Value& v, SGLTFAsset_Prop_Node& node)
+	{
+		if (v.HasMember("children") && v["children"].IsArray())
+		{
+			for (const auto& vv : v["children"].GetArray())
+				node.children.push_back(vv.GetInt());
+		}
 
-				target.path = etype;
+		if (v.HasMember("matrix"))
+		{
+			if (!v["matrix"].IsArray())
+				return false;
 
-				// This target _usually_ refers to a node
-				if (vv["target"].HasMember("node"))
-					target.node = vv["target"]["node"].GetInt();
+			for (rapidjson::SizeType i = 0; i < v["matrix"].Capacity(); ++i)
+				node.matrix[i] = v["matrix"][i].GetDouble();
+		}
+		else
+		{
+			// each of them can be left out, a node with none of them is the identity
+			double translation[3] = { 0.0, 0.0, 0.0 };
+			double scale[3] = { 1.0, 1.0, 1.0 };
+			double rotation[4] = { 0.0, 0.0, 0.0, 1.0 };
 
-				channel.target = target;
+			if (v.HasMember("translation") && v["translation"].IsArray() && v["translation"].Size() >= 3)
+				for (rapidjson::SizeType i = 0; i < 3; ++i)
+					translation[i] = v["translation"][i].GetDouble();
 
-				channel.sampler = vv["sampler"].GetInt();
+			if (v.HasMember("scale") && v["scale"].IsArray() && v["scale"].Size() >= 3)
+				for (rapidjson::SizeType i = 0; i < 3; ++i)
+					scale[i] = v["scale"][i].GetDouble();
+
+			if (v.HasMember("rotation") && v["rotation"].IsArray() && v["rotation"].Size() >= 4)
+				for (rapidjson::SizeType i = 0; i < 4; ++i)
+					rotation[i] = v["rotation"][i].GetDouble();
+
+			static const std::array<double, 16> identityMatrix = {
+				1.0f, 0.0f, 0.0f, 0.0f,
+				0.0f, 1.0f, 0.0f, 0.0f,
+				0.0f, 0.0f, 1.0f, 0.0f,
+				0.0f, 0.0f, 0.0f, 1.0f
+			};
+
+			// column major like the matrix property, translation goes in the last column
+			std::array<double, 16> translationMatrix = identityMatrix;
+			translationMatrix[12] = translation[0];
+			translationMatrix[13] = translation[1];
+			translationMatrix[14] = translation[2];
+
+			std::array<double, 16> scaleMatrix = identityMatrix;
+			scaleMatrix[0] = scale[0];
+			scaleMatrix[5] = scale[1];
+			scaleMatrix[10] = scale[2];
+
+			// rotation quarternion
+			double qx = rotation[0];
+			double qy = rotation[1];
+			double qz = rotation[2];
+			double qw = rotation[3];
 
-				anim.channels.push_back(channel);
-			}
+#define SQR(x) (x * x)
 
-			for (const auto& vv : v["samplers"].GetArray())
-			{
-				if (!vv.HasMember("input") || !vv.HasMember("output") || !vv.HasMember("interpolation"))
-					return false;
+			const double length = std::sqrt(SQR(qx) + SQR(qy) + SQR(qz) + SQR(qw));
+			const double normalizationVal = length > 0.0 ? 1.0 / length : 0.0;
+			qx *= normalizationVal;
+			qy *= normalizationVal;
+			qz *= normalizationVal;
+			qw = length > 0.0 ? qw * normalizationVal : 1.0;
+
+			// one column per line
+			std::array<double, 16> rotationMatrix = {
+				1.0f - 2.0f * qy * qy - 2.0f * qz * qz, 2.0f * qx * qy + 2.0f * qz * qw, 2.0f * qx * qz - 2.0f * qy * qw, 0.0f,
+				2.0f * qx * qy - 2.0f * qz * qw, 1.0f - 2.0f * qx * qx - 2.0f * qz * qz, 2.0f * qy * qz + 2.0f * qx * qw, 0.0f,
+				2.0f * qx * qz + 2.0f * qy * qw, 2.0f * qy * qz - 2.0f * qx * qw, 1.0f - 2.0f * qx * qx - 2.0f * qy * qy, 0.0f,
+				0.0f, 0.0f, 0.0f, 1.0f,
+			};
+
+			// M = T * R * S
+			std::array<double, 16> TR = MatxMat(translationMatrix, rotationMatrix);
+			node.matrix = MatxMat(TR, scaleMatrix);
+
+			// No regrets
+		}
 
-				SGLTFAsset_Prop_Animation_Sampler sampler;
+		if (v.HasMember("mesh"))
+			node.mesh = v["mesh"].GetInt();
 
-				sampler.input = vv["input"].GetInt();
-				sampler.output = vv["output"].GetInt();
+		if (v.HasMember("camera"))
+			node.camera = v["camera"].GetInt();
 
-				std::string type = vv["interpolation"].GetString();
-				EGLTFAsset_Prop_Animation_Sampler_Type etype;
+		if (v.HasMember("skin"))
+			node.skin = v["skin"].GetInt();
 
-				if (type == "LINEAR")
-					etype = EGLTFAsset_Prop_Animation_Sampler_Type::LINEAR;
-				else if (type == "STEP")
-					etype = EGLTFAsset_Prop_Animation_Sampler_Type::STEP;
-				else if (type == "CUBICSPLINE")
-					etype = EGLTFAsset_Prop_Animation_Sampler_Type::CUBICSPLINE;
-				else
-					return false;
+		if (v.HasMember("name"))
+			node.name = v["name"].GetString();
 
-				sampler.interpolation = etype;
+		ParseInstancing(v, node.instancing);
 
-				anim.samplers.push_back(sampler);
-			}
+		return true;
+	}
 
-			m_asset.animations.push_back(anim);
+	// Splits a column major matrix into TRS, the specs require node matrices to be decomposable (no shear or projection)
+	static void DecomposeMatrix(const double* m, SGLTFCompact_Node& node)
+	{
+		node.translation[0] = static_cast<float>(m[12]);
+		node.translation[1] = static_cast<float>(m[13]);
+		node.translation[2] = static_cast<float>(m[14]);
+
+		double sx = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+		const double sy = std::sqrt(m[4] * m[4] + m[5] * m[5] + m[6] * m[6]);
+		const double sz = std::sqrt(m[8] * m[8] + m[9] * m[9] + m[10] * m[10]);
+
+		// a mirrored basis puts the flip on x
+		const double det = m[0] * (m[5] * m[10] - m[9] * m[6]) - m[4] * (m[1] * m[10] - m[9] * m[2]) + m[8] * (m[1] * m[6] - m[5] * m[2]);
+		if (det < 0.0)
+			sx = -sx;
+
+		node.scale[0] = static_cast<float>(sx);
+		node.scale[1] = static_cast<float>(sy);
+		node.scale[2] = static_cast<float>(sz);
+
+		if (sx == 0.0 || sy == 0.0 || sz == 0.0)
+			return; // rotation is meaningless, stays identity
+
+		// r[row][col] of the pure rotation
+		const double r00 = m[0] / sx, r10 = m[1] / sx, r20 = m[2] / sx;
+		const double r01 = m[4] / sy, r11 = m[5] / sy, r21 = m[6] / sy;
+		const double r02 = m[8] / sz, r12 = m[9] / sz, r22 = m[10] / sz;
+
+		double qx, qy, qz, qw;
+		const double trace = r00 + r11 + r22;
+		if (trace > 0.0)
+		{
+			const double t = std::sqrt(trace + 1.0) * 2.0;
+			qw = 0.25 * t;
+			qx = (r21 - r12) / t;
+			qy = (r02 - r20) / t;
+			qz = (r10 - r01) / t;
+		}
+		else if (r00 > r11 && r00 > r22)
+		{
+			const double t = std::sqrt(1.0 + r00 - r11 - r22) * 2.0;
+			qw = (r21 - r12) / t;
+			qx = 0.25 * t;
+			qy = (r01 + r10) / t;
+			qz = (r02 + r20) / t;
+		}
+		else if (r11 > r22)
+		{
+			const double t = std::sqrt(1.0 + r11 - r00 - r22) * 2.0;
+			qw = (r02 - r20) / t;
+			qx = (r01 + r10) / t;
+			qy = 0.25 * t;
+			qz = (r12 + r21) / t;
+		}
+		else
+		{
+			const double t = std::sqrt(1.0 + r22 - r00 - r11) * 2.0;
+			qw = (r10 - r01) / t;
+			qx = (r02 + r20) / t;
+			qy = (r12 + r21) / t;
+			qz = 0.25 * t;
 		}
+
+		node.rotation[0] = static_cast<float>(qx);
+		node.rotation[1] = static_cast<float>(qy);
+		node.rotation[2] = static_cast<float>(qz);
+		node.rotation[3] = static_cast<float>(qw);
 	}
-	END_PARSE(animations)
 
-	BEGIN_PARSE(scenes)
-	if (document.HasMember("scenes") && document["scenes"].IsArray())
+	// First pass of ParseCompactNodes, children and name only get counted here
+	static bool ParseCompactNode(const rapidjson::Value& v, SGLTFCompact_Node& node)
 	{
-		for (const auto& v : document["scenes"].GetArray())
+		if (v.HasMember("matrix"))
 		{
-			if (!v.HasMember("nodes") || !v["nodes"].IsArray())
+			if (!v["matrix"].IsArray() || v["matrix"].Size() < 16)
 				return false;
 
-			SGLTFAsset_Prop_Scene scene;
-			for (const auto& vv : v["nodes"].GetArray())
-				scene.nodes.push_back(vv.GetInt());
+			double m[16];
+			for (rapidjson::SizeType i = 0; i < 16; ++i)
+				m[i] = v["matrix"][i].GetDouble();
 
-			m_asset.scenes.push_back(scene);
+			DecomposeMatrix(m, node);
 		}
-	}
-	END_PARSE(scenes)
+		else
+		{
+			// unlike the regular nodes, each of these can be there on its own
+			if (v.HasMember("translation") && v["translation"].IsArray() && v["translation"].Size() >= 3)
+				for (rapidjson::SizeType i = 0; i < 3; ++i)
+					node.translation[i] = static_cast<float>(v["translation"][i].GetDouble());
 
-	BEGIN_PARSE(scene)
-	if (document.HasMember("scene"))
-		m_asset.scene = document["scene"].GetInt();
-	END_PARSE(scene)
+			if (v.HasMember("rotation") && v["rotation"].IsArray() && v["rotation"].Size() >= 4)
+				for (rapidjson::SizeType i = 0; i < 4; ++i)
+					node.rotation[i] = static_cast<float>(v["rotation"][i].GetDouble());
 
-	return true;
-}
+			if (v.HasMember("scale") && v["scale"].IsArray() && v["scale"].Size() >= 3)
+				for (rapidjson::SizeType i = 0; i < 3; ++i)
+					node.scale[i] = static_cast<float>(v["scale"][i].GetDouble());
+		}
 
-bool EGLTF::CEasyGLTF::ParseGLB(const std::vector<uint8_t>& buffer)
-{
-	size_t offset = 0; // how much of the buffer has been traversed
+		if (v.HasMember("mesh"))
+			node.mesh = v["mesh"].GetInt();
 
-	SGLB_HEADER header = {};
+		if (v.HasMember("camera"))
+			node.camera = v["camera"].GetInt();
 
-	{
-		uint32_t val;
-		size_t tsize = sizeof(uint32_t);
+		if (v.HasMember("skin"))
+			node.skin = v["skin"].GetInt();
 
-		memcpy(&val, buffer.data() + offset, tsize);
-		header.magic = val;
-		offset += tsize;
+		if (v.HasMember("children") && v["children"].IsArray())
+			node.children.count = v["children"].Size();
 
-		memcpy(&val, buffer.data() + offset, tsize);
-		header.version = val;
-		offset += tsize;
+		if (v.HasMember("name") && v["name"].IsString())
+			node.name.count = v["name"].GetStringLength();
 
-		memcpy(&val, buffer.data() + offset, tsize);
-		header.length = val;
-		offset += tsize;
+		return true;
 	}
 
-	std::vector<SGLB_CHUNK> chunks; // The first chunk would always be json
+	static bool ParseSkin(const rapidjson::Value& v, SGLTFAsset_Prop_Skin& skin)
+	{
+		if (!v.HasMember("inverseBindMatrices") || !v.HasMember("joints") || !v["joints"].IsArray())
+			return false;
+
+		skin.inverseBindMatrices = v["inverseBindMatrices"].GetInt();
+		
+		for (const auto& vv : v["joints"].GetArray())
+			skin.joints.push_back(vv.GetInt());
 
+		if (v.HasMember("skeleton"))
+			skin.skeleton = v["skeleton"].GetInt();
+
+		if (v.HasMember("name"))
+			skin.name = v["name"].GetString();
+
+		return true;
+	}
+
+	static bool ParseAnimation(const rapidjson::Value& v, SGLTFAsset_Prop_Animation& anim)
 	{
-		for (;;)
-		{
-			uint32_t chunkLength;
-			uint32_t chunkType;
-			size_t chunkOffset = 0;
-			size_t typeSize = sizeof(uint32_t);
+		if (!v.HasMember("channels") || !v.HasMember("samplers"))
+			return false;
 
-			if (offset + (typeSize * 2) >= buffer.size())
-				break;
+		for (const auto& vv : v["channels"].GetArray())
+		{
+			if (!vv.HasMember("target") || !vv.HasMember("sampler"))
+				return false;
 
-			// TODO: bounds check
-			memcpy(&chunkLength, buffer.data() + offset + chunkOffset, typeSize); // memcpy_s would have been nice here
-			chunkOffset += typeSize;
+			SGLTFAsset_Prop_Animation_Channel channel;
+			SGLTFAsset_Prop_Animation_Channel_Target target;
 
-			memcpy(&chunkType, buffer.data() + offset + chunkOffset, typeSize);
-			chunkOffset += typeSize;
+			if (!vv["target"].HasMember("path"))
+				return false;
 
-			// TODO: Add library support to define gltf extensions maybe?
-			// the standards explicity specify to ignore unknown extensions to the client
-			// Even if there were extensions, its guaranteed to be after the spec defined chunks
-			if (chunkType != 0x4E4F534A && chunkType != 0x004E4942)
-			{
-				offset += chunkOffset + chunkLength;
-				continue;
-			}
+			std::string type = vv["target"]["path"].GetString();
+			EGLTFAsset_Prop_Animation_Channel_Target_Type etype;
+			
+			if (type == "translation")
+				etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::TRANSLATION;
+			else if (type == "rotation")
+				etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::ROTATION;
+			else if (type == "scale")
+				etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::SCALE;
+			else if (type == "weights")
+				etype = EGLTFAsset_Prop_Animation_Channel_Target_Type::WEIGHTS;
+			else
+				return false;
 
-			SGLB_CHUNK chunk;
-			chunk.chunkLength = chunkLength;
-			chunk.chunkType = chunkType;
+			target.path = etype;
 
-			chunk.chunkData.resize(chunkLength);
-			memcpy(chunk.chunkData.data(), buffer.data() + offset + chunkOffset, chunkLength);
-			chunkOffset += chunkLength;
+			// This target _usually_ refers to a node
+			if (vv["target"].HasMember("node"))
+				target.node = vv["target"]["node"].GetInt();
 
-			offset += chunkOffset;
+			channel.target = target;
 
-			chunks.push_back(chunk);
+			channel.sampler = vv["sampler"].GetInt();
 
-			if (offset + (typeSize * 2) >= buffer.size())
-				break;
+			anim.channels.push_back(channel);
 		}
-	}
 
-	if (chunks.size() >= 2)
+		for (const auto& vv : v["samplers"].GetArray())
+		{
+			if (!vv.HasMember("input") || !vv.HasMember("output") || !vv.HasMember("interpolation"))
+				return false;
+
+			SGLTFAsset_Prop_Animation_Sampler sampler;
+
+			sampler.input = vv["input"].GetInt();
+			sampler.output = vv["output"].GetInt();
+
+			std::string type = vv["interpolation"].GetString();
+			EGLTFAsset_Prop_Animation_Sampler_Type etype;
+
+			if (type == "LINEAR")
+				etype = EGLTFAsset_Prop_Animation_Sampler_Type::LINEAR;
+			else if (type == "STEP")
+				etype = EGLTFAsset_Prop_Animation_Sampler_Type::STEP;
+			else if (type == "CUBICSPLINE")
+				etype = EGLTFAsset_Prop_Animation_Sampler_Type::CUBICSPLINE;
+			else
+				return false;
+
+			sampler.interpolation = etype;
+
+			anim.samplers.push_back(sampler);
+		}
+
+		return true;
+	}
+
+	static bool ParseScene(const rapidjson::Value& v, SGLTFAsset_Prop_Scene& scene)
+	{
+		if (!v.HasMember("nodes") || !v["nodes"].IsArray())
+			return false;
+
+		for (const auto& vv : v["nodes"].GetArray())
+			scene.nodes.push_back(vv.GetInt());
+
+		return true;
+	}
+}
+
+bool EGLTF::CEasyGLTF::ParseGLTF(const rapidjson::Value& document)
+{
+	const SParseContext context = { m_path, GetFileSystem(), m_binaryBuffer, m_listener, m_deferResources, m_reuseMemory, nullptr };
+
+	// what BeginLoad set aside from the last load, not while reloading since that takes over the previous asset itself
+	SGLTFAsset* spare = m_reuseMemory && !m_reload ? &m_spare : nullptr;
+
+	// the whole closure is known from the json alone, before anything gets converted
+	SGLTFLoadSelection* selection = nullptr;
+	TGLTFBufferRanges ranges;
+	if (m_filtered)
+	{
+		SelectGLTFElements(document, m_filter, m_selection, ranges);
+		selection = &m_selection;
+	}
+
+	// buffers read in ranges and the views into them only fit together when both come from this load
+	const bool ranged = m_filtered && m_filter.rangedReads;
+	std::vector<uint8_t> rangeRead(ranges.size(), 0);
+
+	// from here on parts of the previous asset get moved into the new one
+	if (m_reload)
+		m_reload->converting = true;
+
+	// For some weird reason, GCC still doesnt "support" this pragma. Ironically, to support this, all it needs to do is ignore it.
+	// Even llvm supports this stuff...
+
+	BEGIN_PARSE(asset)
+	if (document.HasMember("asset"))
 	{
-		m_binaryBuffer.resize(chunks[1].chunkLength);
-		m_binaryBuffer = chunks[1].chunkData;
+		SGLTFAsset_Prop_Asset& asset = m_asset.asset;
+		if (document["asset"].HasMember("version") && document["asset"]["version"].IsString())
+		{
+			asset.version = document["asset"]["version"].GetString();
+		}
+		else
+			return false;
+
+		if (document["asset"].HasMember("minVersion") && document["asset"]["minVersion"].IsString())
+			asset.minVersion = document["asset"]["minVersion"].GetString();
+
+		if (document["asset"].HasMember("generator") && document["asset"]["generator"].IsString())
+			asset.generator = document["asset"]["generator"].GetString();
+
+		if (document["asset"].HasMember("copyright") && document["asset"]["copyright"].IsString())
+			asset.copyright = document["asset"]["copyright"].GetString();
+
+		// The specs kinda allows to have whatever metadata you want in here, but we wont bother with more since these are the 4 the specs actually mention
+	}
+	else
+		return false; // This is the only top level field the specs actually require to be present
+	END_PARSE(asset)
+
+	BEGIN_PARSE(buffers)
+	{
+		// same json is not enough, the data behind the uri might have changed too
+		const std::vector<uint8_t> jsonUnchanged = TrackSection(document, "buffers");
+		std::vector<uint8_t> unchanged = jsonUnchanged;
+		for (size_t i = 0; i < unchanged.size(); ++i)
+			unchanged[i] = unchanged[i] && IsSourceUnchanged(m_reload->previous.buffers[i].uri, true);
+
+		SParseContext sectionContext = context;
+		sectionContext.scope = &sectionScope;
+
+		auto parse = [&](const rapidjson::Value& v, SGLTFAsset_Prop_Buffer& buffer)
+		{
+			const size_t index = static_cast<size_t>(&buffer - m_asset.buffers.data());
+			return ParseBuffer(v, buffer, sectionContext, index < ranges.size() ? &ranges[index] : nullptr, index < rangeRead.size() ? &rangeRead[index] : nullptr);
+		};
+
+		if (!ParseSection(document, "buffers", m_asset.buffers, m_threadPool, GLTF_RESOURCE_GRAIN, parse,
+			m_reload && !ranged ? &m_reload->previous.buffers : nullptr, unchanged, nullptr, spare ? &spare->buffers : nullptr, selection ? &selection->buffers : nullptr))
+			return false;
+
+		StampSources(m_asset.buffers, jsonUnchanged, unchanged, true, m_reload ? &m_reload->changes.buffers : nullptr);
+	}
+	END_PARSE(buffers)
+
+	BEGIN_PARSE(bufferViews)
+	if (!ParseSection(document, "bufferViews", m_asset.bufferViews, m_threadPool, GLTF_PARALLEL_GRAIN, ParseBufferView,
+		m_reload && !ranged ? &m_reload->previous.bufferViews : nullptr, TrackSection(document, "bufferViews"), m_reload ? &m_reload->changes.bufferViews : nullptr, spare ? &spare->bufferViews : nullptr, selection ? &selection->bufferViews : nullptr))
+		return false;
+
+	// views into a buffer that was read in ranges point into what was read
+	for (auto& view : m_asset.bufferViews)
+		if (view.buffer >= 0 && static_cast<size_t>(view.buffer) < rangeRead.size() && rangeRead[view.buffer])
+			view.byteOffset = static_cast<int64_t>(RemapGLTFFileOffset(ranges[view.buffer], static_cast<uint64_t>(std::max<int64_t>(view.byteOffset, 0))));
+	END_PARSE(bufferViews)
+
+	BEGIN_PARSE(accessors)
+	if (!ParseSection(document, "accessors", m_asset.accessors, m_threadPool, GLTF_PARALLEL_GRAIN, ParseAccessor,
+		m_reload && !m_compact ? &m_reload->previous.accessors : nullptr, TrackSection(document, "accessors"), m_reload ? &m_reload->changes.accessors : nullptr, spare ? &spare->accessors : nullptr, selection ? &selection->accessors : nullptr))
+		return false;
+	END_PARSE(accessors)
+
+	BEGIN_PARSE(materials)
+	if (!ParseSection(document, "materials", m_asset.materials, m_threadPool, GLTF_PARALLEL_GRAIN, ParseMaterial,
+		m_reload ? &m_reload->previous.materials : nullptr, TrackSection(document, "materials"), m_reload ? &m_reload->changes.materials : nullptr, spare ? &spare->materials : nullptr, selection ? &selection->materials : nullptr))
+		return false;
+	END_PARSE(materials)
+
+	BEGIN_PARSE(textures)
+	// Pretty sure this is needed but whatever
+	if (!ParseSection(document, "textures", m_asset.textures, m_threadPool, GLTF_PARALLEL_GRAIN, ParseTexture,
+		m_reload ? &m_reload->previous.textures : nullptr, TrackSection(document, "textures"), m_reload ? &m_reload->changes.textures : nullptr, spare ? &spare->textures : nullptr, selection ? &selection->textures : nullptr))
+		return false;
+	END_PARSE(textures)
+
+	BEGIN_PARSE(images)
+	{
+		const std::vector<uint8_t> jsonUnchanged = TrackSection(document, "images");
+		std::vector<uint8_t> unchanged = jsonUnchanged;
+		for (size_t i = 0; i < unchanged.size(); ++i)
+			unchanged[i] = unchanged[i] && IsSourceUnchanged(m_reload->previous.images[i].uri, false);
+
+		SParseContext sectionContext = context;
+		sectionContext.scope = &sectionScope;
+
+		if (!ParseSection(document, "images", m_asset.images, m_threadPool, GLTF_RESOURCE_GRAIN, [&](const rapidjson::Value& v, SGLTFAsset_Prop_Image& image) { return ParseImage(v, image, sectionContext); },
+			m_reload ? &m_reload->previous.images : nullptr, unchanged, nullptr, spare ? &spare->images : nullptr, selection ? &selection->images : nullptr))
+			return false;
+
+		StampSources(m_asset.images, jsonUnchanged, unchanged, false, m_reload ? &m_reload->changes.images : nullptr);
 	}
+	END_PARSE(images)
+
+	BEGIN_PARSE(samplers)
+	if (!ParseSection(document, "samplers", m_asset.samplers, m_threadPool, GLTF_PARALLEL_GRAIN, ParseSampler,
+		m_reload ? &m_reload->previous.samplers : nullptr, TrackSection(document, "samplers"), m_reload ? &m_reload->changes.samplers : nullptr, spare ? &spare->samplers : nullptr, selection ? &selection->samplers : nullptr))
+		return false;
+	END_PARSE(samplers)
+
+	// not filtered, there is little to a camera
+	BEGIN_PARSE(cameras)
+	if (!ParseSection(document, "cameras", m_asset.cameras, m_threadPool, GLTF_PARALLEL_GRAIN, ParseCamera,
+		m_reload ? &m_reload->previous.cameras : nullptr, TrackSection(document, "cameras"), m_reload ? &m_reload->changes.cameras : nullptr, spare ? &spare->cameras : nullptr, nullptr))
+		return false;
+	END_PARSE(cameras)
+
+	BEGIN_PARSE(meshes)
+	if (!ParseSection(document, "meshes", m_asset.meshes, m_threadPool, GLTF_PARALLEL_GRAIN, ParseMesh,
+		m_reload && !m_compact ? &m_reload->previous.meshes : nullptr, TrackSection(document, "meshes"), m_reload ? &m_reload->changes.meshes : nullptr, spare ? &spare->meshes : nullptr, selection ? &selection->meshes : nullptr))
+		return false;
+	END_PARSE(meshes)
+
+	BEGIN_PARSE(nodes)
+	if (m_compact)
+	{
+		// not tracked, compact nodes always get converted again
+		if (!ParseCompactNodes(document))
+			return false;
+
+		if (m_reload)
+			for (size_t i = 0; i < m_compactAsset.nodes.size(); ++i)
+				m_reload->changes.nodes.push_back(static_cast<int32_t>(i));
+	}
+	else if (!ParseSection(document, "nodes", m_asset.nodes, m_threadPool, GLTF_PARALLEL_GRAIN, ParseNode,
+		m_reload ? &m_reload->previous.nodes : nullptr, TrackSection(document, "nodes"), m_reload ? &m_reload->changes.nodes : nullptr, spare ? &spare->nodes : nullptr, selection ? &selection->nodes : nullptr))
+		return false;
+	sectionScope.SetElements(ElementCount(m_asset.nodes) + ElementCount(m_compactAsset.nodes)); }
+
+	BEGIN_PARSE(skins)
+	if (!ParseSection(document, "skins", m_asset.skins, m_threadPool, GLTF_PARALLEL_GRAIN, ParseSkin,
+		m_reload ? &m_reload->previous.skins : nullptr, TrackSection(document, "skins"), m_reload ? &m_reload->changes.skins : nullptr, spare ? &spare->skins : nullptr, selection ? &selection->skins : nullptr))
+		return false;
+	END_PARSE(skins)
+
+	BEGIN_PARSE(animations)
+	if (!ParseSection(document, "animations", m_asset.animations, m_threadPool, GLTF_PARALLEL_GRAIN, ParseAnimation,
+		m_reload ? &m_reload->previous.animations : nullptr, TrackSection(document, "animations"), m_reload ? &m_reload->changes.animations : nullptr, spare ? &spare->animations : nullptr, selection ? &selection->animations : nullptr))
+		return false;
+	END_PARSE(animations)
+
+	BEGIN_PARSE(scenes)
+	if (!ParseSection(document, "scenes", m_asset.scenes, m_threadPool, GLTF_PARALLEL_GRAIN, ParseScene,
+		m_reload ? &m_reload->previous.scenes : nullptr, TrackSection(document, "scenes"), m_reload ? &m_reload->changes.scenes : nullptr, spare ? &spare->scenes : nullptr, selection ? &selection->scenes : nullptr))
+		return false;
+	END_PARSE(scenes)
+
+	if (m_compact)
+		CompactAccessorsAndMeshes();
+
+	BEGIN_PARSE(scene)
+	if (document.HasMember("scene"))
+		m_asset.scene = document["scene"].GetInt();
+	END_PARSE(scene)
+
+	if (m_topology)
+		m_topology->Build(m_asset, m_compact ? &m_compactAsset : nullptr);
+
+	return true;
+}
+
+bool EGLTF::CEasyGLTF::ParseGLB(const uint8_t* data, size_t size)
+{
+	CGLTFLoadScope scope(m_listener, EGLTFLoadEventCategory::GLB, "glb", nullptr);
+
+	// the json and the sections nest in the glb event for as long as this runs
+	struct SNest
+	{
+		CGLTFLoadScope*& current;
+		~SNest() { current = nullptr; }
+	} nest = { m_loadScope };
+	m_loadScope = &scope;
+
+	if (m_validate)
+	{
+		SGLTFValidationReport report;
+		const bool valid = ValidateGLB(data, size, report);
+		report.Print();
+		if (!valid)
+			return false;
+	}
+
+	size_t offset = 0; // how much of the buffer has been traversed
+
+	SGLB_HEADER header = {};
+
+	if (size < sizeof(uint32_t) * 3)
+	{
+		fprintf(stderr, "\nError: glb is too small for its header\n");
+		return false;
+	}
+
+	{
+		uint32_t val;
+		size_t tsize = sizeof(uint32_t);
+
+		memcpy(&val, data + offset, tsize);
+		header.magic = val;
+		offset += tsize;
+
+		memcpy(&val, data + offset, tsize);
+		header.version = val;
+		offset += tsize;
+
+		memcpy(&val, data + offset, tsize);
+		header.length = val;
+		offset += tsize;
+	}
+
+	if (header.magic != 0x46546C67 || header.version != 2) // "glTF"
+	{
+		fprintf(stderr, "\nError: not a version 2 glb (magic 0x%08X, version %u)\n", header.magic, header.version);
+		return false;
+	}
+
+	// whatever comes after the declared length is not part of the glb
+	if (header.length >= offset && header.length < size)
+		size = header.length;
+
+	// where the json and binary chunks are, nothing gets copied out until it's clear which is which
+	struct SChunkSpan
+	{
+		uint32_t type;
+		size_t offset;
+		size_t length;
+	};
+
+	SChunkSpan chunks[2] = {}; // The first chunk would always be json
+	size_t chunkCount = 0;
+
+	{
+		for (;;)
+		{
+			uint32_t chunkLength;
+			uint32_t chunkType;
+			size_t chunkOffset = 0;
+			size_t typeSize = sizeof(uint32_t);
+
+			if (offset + (typeSize * 2) >= size)
+				break;
+
+			memcpy(&chunkLength, data + offset + chunkOffset, typeSize); // memcpy_s would have been nice here
+			chunkOffset += typeSize;
 
+			memcpy(&chunkType, data + offset + chunkOffset, typeSize);
+			chunkOffset += typeSize;
+
+			if (chunkLength > size - offset - chunkOffset)
+			{
+				fprintf(stderr, "\nError: glb chunk at offset %zu runs past the end of the file\n", offset);
+				return false;
+			}
+
+			// TODO: Add library support to define gltf extensions maybe?
+			// the standards explicity specify to ignore unknown extensions to the client
+			// Even if there were extensions, its guaranteed to be after the spec defined chunks
+			if (chunkType != 0x4E4F534A && chunkType != 0x004E4942)
+			{
+				offset += chunkOffset + chunkLength;
+				continue;
+			}
+
+			// only the first two matter
+			if (chunkCount < 2)
+			{
+				chunks[chunkCount].type = chunkType;
+				chunks[chunkCount].offset = offset + chunkOffset;
+				chunks[chunkCount].length = chunkLength;
+				++chunkCount;
+			}
+
+			chunkOffset += chunkLength;
+			offset += chunkOffset;
+
+			if (offset + (typeSize * 2) >= size)
+				break;
+		}
+	}
+
+	if (chunkCount == 0 || chunks[0].type != 0x4E4F534A)
+	{
+		fprintf(stderr, "\nError: glb does not start with a json chunk\n");
+		return false;
+	}
+
+	if (chunkCount >= 2)
+		m_binaryBuffer.assign(data + chunks[1].offset, data + chunks[1].offset + chunks[1].length);
+
+	const uint8_t* json = data + chunks[0].offset;
 	size_t lastBrace = 0;
-	std::vector<uint8_t>::reverse_iterator rit = std::find(chunks[0].chunkData.rbegin(), chunks[0].chunkData.rend(), 0x7D);
-	if (rit != chunks[0].chunkData.rend())
-		lastBrace = std::distance(begin(chunks[0].chunkData), rit.base()) - 1;
+	for (size_t i = chunks[0].length; i > 0; --i)
+	{
+		if (json[i - 1] == 0x7D)
+		{
+			lastBrace = i - 1;
+			break;
+		}
+	}
+
+	if (m_trackChanges)
+		m_binaryHash = HashGLTFSnapshotData(m_binaryBuffer.data(), m_binaryBuffer.size());
+
+	scope.End();
+
+	// the chunk pads with spaces, the json ends at the last brace and gets parsed where it is
+	return ParseJson(json, lastBrace + 1);
+}
+
+// The flags of a section by its json name, nullptr for sections a filter does not select in
+static const std::vector<uint8_t>* GetSelectionSection(const EGLTF::SGLTFLoadSelection& selection, const char* section)
+{
+	static const struct
+	{
+		const char* name;
+		std::vector<uint8_t> EGLTF::SGLTFLoadSelection::* flags;
+	} sections[] = {
+		{ "scenes", &EGLTF::SGLTFLoadSelection::scenes },
+		{ "nodes", &EGLTF::SGLTFLoadSelection::nodes },
+		{ "meshes", &EGLTF::SGLTFLoadSelection::meshes },
+		{ "accessors", &EGLTF::SGLTFLoadSelection::accessors },
+		{ "bufferViews", &EGLTF::SGLTFLoadSelection::bufferViews },
+		{ "buffers", &EGLTF::SGLTFLoadSelection::buffers },
+		{ "materials", &EGLTF::SGLTFLoadSelection::materials },
+		{ "textures", &EGLTF::SGLTFLoadSelection::textures },
+		{ "samplers", &EGLTF::SGLTFLoadSelection::samplers },
+		{ "images", &EGLTF::SGLTFLoadSelection::images },
+		{ "skins", &EGLTF::SGLTFLoadSelection::skins },
+		{ "animations", &EGLTF::SGLTFLoadSelection::animations },
+	};
+
+	for (const auto& entry : sections)
+		if (strcmp(entry.name, section) == 0)
+			return &(selection.*entry.flags);
+	return nullptr;
+}
+
+std::vector<uint8_t> EGLTF::CEasyGLTF::TrackSection(const rapidjson::Value& document, const char* section)
+{
+	std::vector<uint8_t> unchanged;
+	if (!m_trackChanges || !document.HasMember(section) || !document[section].IsArray())
+		return unchanged;
+
+	const rapidjson::Value& array = document[section];
+	std::vector<uint64_t>& hashes = m_elementHashes[section];
+	hashes.resize(array.Size());
+
+	auto hash = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			hashes[i] = HashJsonValue(array[static_cast<rapidjson::SizeType>(i)], HashGLTFSnapshotData(nullptr, 0));
+	};
+
+	if (m_threadPool && hashes.size() >= GLTF_PARALLEL_GRAIN * 2)
+		m_threadPool->ParallelFor(hashes.size(), GLTF_PARALLEL_GRAIN, hash);
+	else
+		hash(0, hashes.size());
+
+	if (!m_reload)
+		return unchanged;
+
+	auto previous = m_reload->elementHashes.find(section);
+	if (previous == m_reload->elementHashes.end())
+		return unchanged;
+
+	const std::vector<uint8_t>* selected = GetSelectionSection(m_reload->selection, section);
+
+	unchanged.resize(hashes.size());
+	for (size_t i = 0; i < hashes.size(); ++i)
+		unchanged[i] = i < previous->second.size() && previous->second[i] == hashes[i] && (!selected || SGLTFLoadSelection::Has(*selected, i));
+
+	return unchanged;
+}
+
+// Whether the data of a buffer/image whose json did not change is still the same
+bool EGLTF::CEasyGLTF::IsSourceUnchanged(const std::string& uri, bool isBuffer)
+{
+	if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+		return IsFileUnchanged(ResolveGLTFUri(m_path, uri));
+
+	// a buffer without a uri is the glb binary chunk
+	if (isBuffer && uri.empty() && !m_binaryBuffer.empty())
+		return m_binaryHash == m_reload->binaryHash;
+
+	// data uris are part of the json, images in a bufferView go with their view
+	return true;
+}
+
+bool EGLTF::CEasyGLTF::IsFileUnchanged(const std::string& filepath)
+{
+	if (!m_reload)
+		return false;
+
+	auto previous = m_reload->fileStamps.find(filepath);
+	if (previous == m_reload->fileStamps.end())
+		return false;
+
+	uint64_t size;
+	int64_t mtime;
+	if (!GetFileSystem().StatFile(filepath, size, mtime) || size != previous->second.size || mtime != previous->second.mtime)
+		return false;
+
+	m_fileStamps[filepath] = previous->second;
+	return true;
+}
+
+void EGLTF::CEasyGLTF::StampFile(const std::string& filepath, const uint8_t* data, size_t size)
+{
+	if (!m_trackChanges)
+		return;
+
+	SFileStamp stamp = {};
+	GetFileSystem().StatFile(filepath, stamp.size, stamp.mtime);
+	stamp.hash = HashGLTFSnapshotData(data, size);
+
+	m_fileStamps[filepath] = stamp;
+}
+
+// Stamps the files that were read for a buffer/image section and works out which elements really changed.
+// An element that was read again because its file got touched still counts as unchanged if the contents hash the same.
+template<typename T>
+void EGLTF::CEasyGLTF::StampSources(const std::vector<T>& out, const std::vector<uint8_t>& jsonUnchanged, const std::vector<uint8_t>& unchanged, bool isBuffer, std::vector<int32_t>* changes)
+{
+	for (size_t i = 0; i < out.size(); ++i)
+	{
+		const T& element = out[i];
+		const bool external = !element.uri.empty() && element.uri.compare(0, 5, "data:") != 0;
+		const bool reused = i < unchanged.size() && unchanged[i];
+
+		if (external && !reused && !m_deferResources)
+			StampFile(ResolveGLTFUri(m_path, element.uri), element.data.data(), element.data.size());
+
+		if (!changes)
+			continue;
+
+		bool same = i < jsonUnchanged.size() && jsonUnchanged[i];
+		if (same && !reused)
+		{
+			if (external)
+			{
+				const std::string filepath = ResolveGLTFUri(m_path, element.uri);
+				auto previous = m_reload->fileStamps.find(filepath);
+				auto current = m_fileStamps.find(filepath);
+				same = previous != m_reload->fileStamps.end() && current != m_fileStamps.end() && previous->second.hash == current->second.hash;
+			}
+			else
+				same = !isBuffer; // the glb binary chunk changed
+		}
+
+		if (!same)
+			changes->push_back(static_cast<int32_t>(i));
+	}
+}
+
+// Adds everything that depends on a changed element to the change set
+static void PropagateChanges(const EGLTF::SGLTFAsset& asset, EGLTF::SGLTFChangeSet& changes)
+{
+	auto flags = [](const std::vector<int32_t>& indices, size_t count)
+	{
+		std::vector<uint8_t> result(count, 0);
+		for (int32_t index : indices)
+			if (index >= 0 && static_cast<size_t>(index) < count)
+				result[index] = 1;
+		return result;
+	};
+
+	auto isSet = [](const std::vector<uint8_t>& set, int32_t index)
+	{
+		return index >= 0 && static_cast<size_t>(index) < set.size() && set[index];
+	};
+
+	auto collect = [](const std::vector<uint8_t>& set, std::vector<int32_t>& indices)
+	{
+		indices.clear();
+		for (size_t i = 0; i < set.size(); ++i)
+			if (set[i])
+				indices.push_back(static_cast<int32_t>(i));
+	};
+
+	const std::vector<uint8_t> buffers = flags(changes.buffers, asset.buffers.size());
+
+	std::vector<uint8_t> bufferViews = flags(changes.bufferViews, asset.bufferViews.size());
+	for (size_t i = 0; i < asset.bufferViews.size(); ++i)
+		bufferViews[i] |= isSet(buffers, asset.bufferViews[i].buffer);
+
+	std::vector<uint8_t> accessors = flags(changes.accessors, asset.accessors.size());
+	for (size_t i = 0; i < asset.accessors.size(); ++i)
+	{
+		const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[i];
+		accessors[i] |= isSet(bufferViews, accessor.bufferView) || isSet(bufferViews, accessor.sparse.values) || isSet(bufferViews, accessor.sparse.indices.first);
+	}
+
+	std::vector<uint8_t> images = flags(changes.images, asset.images.size());
+	for (size_t i = 0; i < asset.images.size(); ++i)
+		images[i] |= isSet(bufferViews, asset.images[i].bufferView);
+
+	const std::vector<uint8_t> samplers = flags(changes.samplers, asset.samplers.size());
+
+	std::vector<uint8_t> textures = flags(changes.textures, asset.textures.size());
+	for (size_t i = 0; i < asset.textures.size(); ++i)
+		textures[i] |= isSet(images, asset.textures[i].source) || isSet(samplers, asset.textures[i].sampler);
+
+	std::vector<uint8_t> materials = flags(changes.materials, asset.materials.size());
+	for (size_t i = 0; i < asset.materials.size(); ++i)
+	{
+		const EGLTF::SGLTFAsset_Prop_Material& material = asset.materials[i];
+		materials[i] |= isSet(textures, material.pbrMetallicRoughness.baseColorTexture.index) || isSet(textures, material.pbrMetallicRoughness.metallicRoughnessTexture.index) ||
+			isSet(textures, material.normalTexture.index) || isSet(textures, material.occlusionTexture.index) || isSet(textures, material.emissiveTexture.index);
+	}
+
+	std::vector<uint8_t> meshes = flags(changes.meshes, asset.meshes.size());
+	for (size_t i = 0; i < asset.meshes.size(); ++i)
+	{
+		for (const auto& primitive : asset.meshes[i].primitives)
+		{
+			meshes[i] |= isSet(accessors, primitive.indices);
+			for (const auto& attribute : primitive.attributes)
+				meshes[i] |= isSet(accessors, attribute.second);
+			for (const auto& target : primitive.targets)
+				for (const auto& attribute : target)
+					meshes[i] |= isSet(accessors, attribute.second);
+		}
+	}
+
+	std::vector<uint8_t> skins = flags(changes.skins, asset.skins.size());
+	for (size_t i = 0; i < asset.skins.size(); ++i)
+		skins[i] |= isSet(accessors, asset.skins[i].inverseBindMatrices);
+
+	std::vector<uint8_t> animations = flags(changes.animations, asset.animations.size());
+	for (size_t i = 0; i < asset.animations.size(); ++i)
+		for (const auto& sampler : asset.animations[i].samplers)
+			animations[i] |= isSet(accessors, sampler.input) || isSet(accessors, sampler.output);
+
+	collect(bufferViews, changes.bufferViews);
+	collect(accessors, changes.accessors);
+	collect(images, changes.images);
+	collect(textures, changes.textures);
+	collect(materials, changes.materials);
+	collect(meshes, changes.meshes);
+	collect(skins, changes.skins);
+	collect(animations, changes.animations);
+
+	changes.any = !changes.buffers.empty() || !changes.bufferViews.empty() || !changes.accessors.empty() || !changes.images.empty() ||
+		!changes.samplers.empty() || !changes.textures.empty() || !changes.materials.empty() || !changes.meshes.empty() ||
+		!changes.cameras.empty() || !changes.nodes.empty() || !changes.skins.empty() || !changes.animations.empty() || !changes.scenes.empty();
+}
+
+bool EGLTF::CEasyGLTF::Reload(SGLTFChangeSet* changes)
+{
+	if (changes)
+		*changes = SGLTFChangeSet();
+
+	if (m_filepath.empty())
+	{
+		fprintf(stderr, "\nError: nothing to reload, the asset was not loaded from a file\n");
+		return false;
+	}
+
+	// nothing that was read last time got touched
+	if (m_trackChanges && !m_fileStamps.empty())
+	{
+		bool touched = false;
+		for (const auto& stamp : m_fileStamps)
+		{
+			uint64_t size;
+			int64_t mtime;
+			if (!GetFileSystem().StatFile(stamp.first, size, mtime) || size != stamp.second.size || mtime != stamp.second.mtime)
+			{
+				touched = true;
+				break;
+			}
+		}
+
+		if (!touched)
+			return true;
+	}
+
+	SReload reload;
+	reload.previous = std::move(m_asset);
+	reload.elementHashes = std::move(m_elementHashes);
+	reload.fileStamps = std::move(m_fileStamps);
+	reload.binaryBuffer = std::move(m_binaryBuffer);
+	reload.binaryHash = m_binaryHash;
+	reload.selection = std::move(m_selection);
+	reload.converting = false;
+
+	m_reload = &reload;
+	const std::string filepath = m_filepath;
+	const bool ok = m_filepathIsGLB ? LoadGLB_file(filepath) : LoadGLTF_file(filepath);
+	m_reload = nullptr;
+
+	if (!ok)
+	{
+		// a half saved file that does not even parse, keep what was there
+		if (!reload.converting)
+		{
+			m_asset = std::move(reload.previous);
+			m_elementHashes = std::move(reload.elementHashes);
+			m_fileStamps = std::move(reload.fileStamps);
+			m_binaryBuffer = std::move(reload.binaryBuffer);
+			m_binaryHash = reload.binaryHash;
+			m_selection = std::move(reload.selection);
+		}
+		return false;
+	}
+
+	PropagateChanges(m_asset, reload.changes);
+
+	if (changes)
+		*changes = std::move(reload.changes);
+
+	return true;
+}
+
+bool EGLTF::CEasyGLTF::ParseCompactNodes(const rapidjson::Value& document)
+{
+	if (!document.HasMember("nodes") || !document["nodes"].IsArray())
+		return true;
+
+	const rapidjson::Value& array = document["nodes"];
+	std::vector<SGLTFCompact_Node>& nodes = m_compactAsset.nodes;
+
+	const std::vector<uint8_t>* selected = m_filtered ? &m_selection.nodes : nullptr;
+	std::vector<SGLTFCompact_Node>* none = nullptr;
+	if (!ParseArray(array, nodes, m_threadPool, GLTF_PARALLEL_GRAIN, "nodes", ParseCompactNode, none, std::vector<uint8_t>(), none, selected))
+		return false;
+
+	// lay the pools out in node order, then every node can fill its own slice
+	uint64_t children = 0;
+	uint64_t names = 0;
+	for (auto& node : nodes)
+	{
+		node.children.offset = static_cast<uint32_t>(children);
+		node.name.offset = static_cast<uint32_t>(names);
+		children += node.children.count;
+		names += node.name.count;
+	}
+
+	if (children > UINT32_MAX || names > UINT32_MAX)
+	{
+		fprintf(stderr, "\nError: too many children or name characters for a compact asset\n");
+		return false;
+	}
+
+	m_compactAsset.children.resize(static_cast<size_t>(children));
+	m_compactAsset.names.resize(static_cast<size_t>(names));
+
+	auto fill = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			const rapidjson::Value& v = array[static_cast<rapidjson::SizeType>(i)];
+			const SGLTFCompact_Node& node = nodes[i];
+
+			for (uint32_t c = 0; c < node.children.count; ++c)
+				m_compactAsset.children[node.children.offset + c] = v["children"][c].GetInt();
+
+			if (node.name.count > 0)
+				memcpy(&m_compactAsset.names[node.name.offset], v["name"].GetString(), node.name.count);
+		}
+	};
+
+	if (m_threadPool && nodes.size() >= GLTF_PARALLEL_GRAIN * 2)
+		m_threadPool->ParallelFor(nodes.size(), GLTF_PARALLEL_GRAIN, fill);
+	else
+		fill(0, nodes.size());
+
+	// few nodes have it, not worth a slot in every compact node
+	for (rapidjson::SizeType i = 0; i < array.Size(); ++i)
+	{
+		SGLTFCompact_Instancing instancing;
+		if ((selected && !SGLTFLoadSelection::Has(*selected, i)) || !ParseInstancing(array[i], instancing.attributes))
+			continue;
+
+		instancing.node = static_cast<int32_t>(i);
+		m_compactAsset.instancing.push_back(std::move(instancing));
+	}
+
+	return true;
+}
+
+// Moves accessor bounds and mesh weights into the float pools and frees the double versions
+void EGLTF::CEasyGLTF::CompactAccessorsAndMeshes()
+{
+	size_t bounds = 0;
+	for (const auto& accessor : m_asset.accessors)
+		bounds += accessor.min.size() + accessor.max.size();
+
+	m_compactAsset.bounds.reserve(bounds);
+	m_compactAsset.accessorMin.resize(m_asset.accessors.size());
+	m_compactAsset.accessorMax.resize(m_asset.accessors.size());
+
+	const bool reuse = m_reuseMemory;
+	auto pool = [reuse](std::vector<double>& values, std::vector<float>& out, SGLTFCompact_Range& range)
+	{
+		range.offset = static_cast<uint32_t>(out.size());
+		range.count = static_cast<uint32_t>(values.size());
+		out.insert(out.end(), values.begin(), values.end());
+
+		// the next load fills them again when reusing
+		if (reuse)
+			values.clear();
+		else
+			std::vector<double>().swap(values);
+	};
+
+	for (size_t i = 0; i < m_asset.accessors.size(); ++i)
+	{
+		pool(m_asset.accessors[i].min, m_compactAsset.bounds, m_compactAsset.accessorMin[i]);
+		pool(m_asset.accessors[i].max, m_compactAsset.bounds, m_compactAsset.accessorMax[i]);
+	}
+
+	size_t weights = 0;
+	for (const auto& mesh : m_asset.meshes)
+		weights += mesh.weights.size();
 
-	std::vector<uint8_t> validJson(lastBrace + 2);
-	memcpy(validJson.data(), chunks[0].chunkData.data(), lastBrace + 2);
-	validJson[lastBrace + 1] = '\0';
+	m_compactAsset.weights.reserve(weights);
+	m_compactAsset.meshWeights.resize(m_asset.meshes.size());
 
-	return LoadGLTF_memory(validJson);
+	for (size_t i = 0; i < m_asset.meshes.size(); ++i)
+		pool(m_asset.meshes[i].weights, m_compactAsset.weights, m_compactAsset.meshWeights[i]);
 }
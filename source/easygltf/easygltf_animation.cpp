@@ -0,0 +1,957 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_animation.h"
+#include "easygltf_geometry.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <set>
+
+typedef EGLTF::EGLTFAsset_Prop_Animation_Channel_Target_Type TPath;
+typedef EGLTF::EGLTFAsset_Prop_Animation_Sampler_Type TInterpolation;
+
+// The three smaller components of a unit quaternion are within +-1/sqrt(2)
+static const float GLTF_SMALLEST_THREE_RANGE = 0.70710678f;
+static const uint32_t GLTF_SMALLEST_THREE_MAX = 0x7FFF;
+
+// Key times are fractions of the duration in this many steps
+static const float GLTF_KEY_TIME_STEPS = 65535.0f;
+
+namespace
+{
+	// A channel read out of its accessors
+	struct SChannelCurve
+	{
+		std::vector<float> times;
+		std::vector<float> values; // width per key, 3 * width for CUBICSPLINE (in tangent, value, out tangent)
+		uint32_t width = 0;
+		TPath path;
+		TInterpolation interpolation;
+	};
+
+	// What the error of a node's tracks is measured against
+	struct SHierarchy
+	{
+		std::vector<int32_t> parent;
+		std::vector<int32_t> order; // parents before their children
+		std::vector<double> lever; // distance to the farthest descendant in the rest pose plus the leaf extent
+		std::vector<double> chain; // largest sum of levers along a root to leaf chain going through the node
+	};
+
+	struct STrackResult
+	{
+		EGLTF::SGLTFCompressedTrack track;
+		std::vector<uint16_t> times;
+		std::vector<float> exactTimes;
+		std::vector<uint16_t> rotations;
+		std::vector<float> values;
+		uint64_t keysBefore = 0;
+		double error = 0.0; // drift for transforms, largest weight difference for weights
+		double budget = 0.0;
+		bool ok = false;
+	};
+}
+
+static bool ReadCurve(const EGLTF::SGLTFAsset& asset, const EGLTF::SGLTFAsset_Prop_Animation& animation, const EGLTF::SGLTFAsset_Prop_Animation_Channel& channel,
+	SChannelCurve& curve)
+{
+	if (channel.sampler < 0 || static_cast<size_t>(channel.sampler) >= animation.samplers.size())
+		return false;
+
+	const EGLTF::SGLTFAsset_Prop_Animation_Sampler& sampler = animation.samplers[channel.sampler];
+	curve.path = channel.target.path;
+	curve.interpolation = sampler.interpolation;
+
+	if (!EGLTF::ReadGLTFAccessor(asset, sampler.input, curve.times) || !EGLTF::ReadGLTFAccessor(asset, sampler.output, curve.values) || curve.times.empty())
+		return false;
+
+	const size_t perKey = curve.interpolation == TInterpolation::CUBICSPLINE ? 3 : 1;
+	if (curve.values.size() % (curve.times.size() * perKey) != 0)
+		return false;
+
+	curve.width = static_cast<uint32_t>(curve.values.size() / (curve.times.size() * perKey));
+	if (curve.path == TPath::ROTATION)
+		return curve.width == 4;
+	if (curve.path == TPath::WEIGHTS)
+		return curve.width > 0;
+	return curve.width == 3;
+}
+
+static void NormalizeQuaternion(float* q)
+{
+	const float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	if (length > 0.0f)
+		for (int i = 0; i < 4; ++i)
+			q[i] /= length;
+}
+
+static void Slerp(const float* a, const float* b, float f, float* out)
+{
+	double dot = 0.0;
+	for (int i = 0; i < 4; ++i)
+		dot += double(a[i]) * b[i];
+
+	// the shortest way around
+	const double sign = dot < 0.0 ? -1.0 : 1.0;
+	dot = std::fabs(dot);
+
+	double wa = 1.0 - f;
+	double wb = f;
+	if (dot < 0.9995)
+	{
+		const double theta = std::acos(dot);
+		const double s = std::sin(theta);
+		wa = std::sin((1.0 - f) * theta) / s;
+		wb = std::sin(f * theta) / s;
+	}
+
+	for (int i = 0; i < 4; ++i)
+		out[i] = static_cast<float>(wa * a[i] + sign * wb * b[i]);
+	NormalizeQuaternion(out);
+}
+
+static void Nlerp(const float* a, const float* b, float f, float* out)
+{
+	const float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+	const float sign = dot < 0.0f ? -1.0f : 1.0f;
+
+	for (int i = 0; i < 4; ++i)
+		out[i] = a[i] * (1.0f - f) + sign * b[i] * f;
+	NormalizeQuaternion(out);
+}
+
+static void EvaluateCurve(const SChannelCurve& curve, float time, float* out)
+{
+	const uint32_t width = curve.width;
+	const bool cubic = curve.interpolation == TInterpolation::CUBICSPLINE;
+	const size_t stride = cubic ? 3 * width : width;
+	const size_t value = cubic ? width : 0;
+	const size_t count = curve.times.size();
+
+	size_t key = 0;
+	if (count > 1 && time >= curve.times.back())
+		key = count - 1;
+	else if (count > 1 && time > curve.times[0])
+		key = std::upper_bound(curve.times.begin(), curve.times.end(), time) - curve.times.begin() - 1;
+
+	const float* v0 = curve.values.data() + key * stride + value;
+	if (key + 1 >= count || time <= curve.times[key] || curve.interpolation == TInterpolation::STEP)
+	{
+		memcpy(out, v0, width * sizeof(float));
+		if (curve.path == TPath::ROTATION)
+			NormalizeQuaternion(out);
+		return;
+	}
+
+	const float* v1 = v0 + stride;
+	const float dt = curve.times[key + 1] - curve.times[key];
+	const float f = dt > 0.0f ? (time - curve.times[key]) / dt : 1.0f;
+
+	if (cubic)
+	{
+		const float s2 = f * f;
+		const float s3 = s2 * f;
+		const float* outTangent = v0 + width;
+		const float* inTangent = v1 - width;
+		for (uint32_t i = 0; i < width; ++i)
+			out[i] = (2 * s3 - 3 * s2 + 1) * v0[i] + (s3 - 2 * s2 + f) * dt * outTangent[i] + (-2 * s3 + 3 * s2) * v1[i] + (s3 - s2) * dt * inTangent[i];
+		if (curve.path == TPath::ROTATION)
+			NormalizeQuaternion(out);
+	}
+	else if (curve.path == TPath::ROTATION)
+		Slerp(v0, v1, f, out);
+	else
+		for (uint32_t i = 0; i < width; ++i)
+			out[i] = v0[i] + (v1[i] - v0[i]) * f;
+}
+
+static float* PoseTarget(EGLTF::SGLTFNodePose& pose, TPath path, uint32_t width)
+{
+	switch (path)
+	{
+	case TPath::TRANSLATION:
+		return pose.translation.data();
+	case TPath::ROTATION:
+		return pose.rotation.data();
+	case TPath::SCALE:
+		return pose.scale.data();
+	case TPath::WEIGHTS:
+	default:
+		if (pose.weights.size() != width)
+			pose.weights.resize(width);
+		return pose.weights.data();
+	}
+}
+
+static void IdentityValue(TPath path, uint32_t width, float* out)
+{
+	for (uint32_t i = 0; i < width; ++i)
+		out[i] = path == TPath::SCALE ? 1.0f : 0.0f;
+	if (path == TPath::ROTATION)
+		out[3] = 1.0f;
+}
+
+void EGLTF::GetGLTFRestPose(const SGLTFAsset& asset, std::vector<SGLTFNodePose>& poses)
+{
+	poses.resize(asset.nodes.size());
+
+	for (size_t n = 0; n < asset.nodes.size(); ++n)
+	{
+		const std::array<double, 16>& m = asset.nodes[n].matrix;
+		SGLTFNodePose& pose = poses[n];
+
+		pose.translation = { { float(m[12]), float(m[13]), float(m[14]) } };
+
+		double scale[3];
+		for (int c = 0; c < 3; ++c)
+			scale[c] = std::sqrt(m[c * 4] * m[c * 4] + m[c * 4 + 1] * m[c * 4 + 1] + m[c * 4 + 2] * m[c * 4 + 2]);
+
+		// a mirroring matrix keeps its rotation proper by flipping one axis
+		const double det = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[4] * (m[1] * m[10] - m[2] * m[9]) + m[8] * (m[1] * m[6] - m[2] * m[5]);
+		if (det < 0.0)
+			scale[0] = -scale[0];
+
+		double r[9]; // column major rotation
+		for (int c = 0; c < 3; ++c)
+			for (int i = 0; i < 3; ++i)
+				r[c * 3 + i] = scale[c] != 0.0 ? m[c * 4 + i] / scale[c] : (c == i ? 1.0 : 0.0);
+
+		double q[4];
+		const double trace = r[0] + r[4] + r[8];
+		if (trace > 0.0)
+		{
+			const double s = std::sqrt(trace + 1.0) * 2.0;
+			q[3] = 0.25 * s;
+			q[0] = (r[5] - r[7]) / s;
+			q[1] = (r[6] - r[2]) / s;
+			q[2] = (r[1] - r[3]) / s;
+		}
+		else if (r[0] > r[4] && r[0] > r[8])
+		{
+			const double s = std::sqrt(1.0 + r[0] - r[4] - r[8]) * 2.0;
+			q[3] = (r[5] - r[7]) / s;
+			q[0] = 0.25 * s;
+			q[1] = (r[3] + r[1]) / s;
+			q[2] = (r[6] + r[2]) / s;
+		}
+		else if (r[4] > r[8])
+		{
+			const double s = std::sqrt(1.0 + r[4] - r[0] - r[8]) * 2.0;
+			q[3] = (r[6] - r[2]) / s;
+			q[0] = (r[3] + r[1]) / s;
+			q[1] = 0.25 * s;
+			q[2] = (r[7] + r[5]) / s;
+		}
+		else
+		{
+			const double s = std::sqrt(1.0 + r[8] - r[0] - r[4]) * 2.0;
+			q[3] = (r[1] - r[3]) / s;
+			q[0] = (r[6] + r[2]) / s;
+			q[1] = (r[7] + r[5]) / s;
+			q[2] = 0.25 * s;
+		}
+
+		pose.rotation = { { float(q[0]), float(q[1]), float(q[2]), float(q[3]) } };
+		NormalizeQuaternion(pose.rotation.data());
+		pose.scale = { { float(scale[0]), float(scale[1]), float(scale[2]) } };
+
+		const int32_t mesh = asset.nodes[n].mesh;
+		if (mesh >= 0 && static_cast<size_t>(mesh) < asset.meshes.size())
+			pose.weights.assign(asset.meshes[mesh].weights.begin(), asset.meshes[mesh].weights.end());
+		else
+			pose.weights.clear();
+	}
+}
+
+bool EGLTF::SampleGLTFAnimation(const SGLTFAsset& asset, int32_t animation, float time, std::vector<SGLTFNodePose>& poses)
+{
+	if (animation < 0 || static_cast<size_t>(animation) >= asset.animations.size())
+		return false;
+
+	const SGLTFAsset_Prop_Animation& anim = asset.animations[animation];
+
+	SChannelCurve curve;
+	for (const auto& channel : anim.channels)
+	{
+		if (channel.target.node < 0 || static_cast<size_t>(channel.target.node) >= poses.size())
+			continue;
+
+		if (!ReadCurve(asset, anim, channel, curve))
+			return false;
+
+		EvaluateCurve(curve, time, PoseTarget(poses[channel.target.node], curve.path, curve.width));
+	}
+
+	return true;
+}
+
+// Smallest-three: the largest component is left out and rebuilt from the others, its sign is folded into them
+static void EncodeRotation(const float* q, uint16_t* out)
+{
+	uint32_t largest = 0;
+	for (uint32_t i = 1; i < 4; ++i)
+		if (std::fabs(q[i]) > std::fabs(q[largest]))
+			largest = i;
+
+	const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+	uint64_t bits = largest;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+
+		const float v = std::min(1.0f, std::max(-1.0f, q[i] * sign / GLTF_SMALLEST_THREE_RANGE));
+		const uint64_t quantized = static_cast<uint64_t>(std::lround((v * 0.5f + 0.5f) * GLTF_SMALLEST_THREE_MAX));
+		bits = (bits << 15) | quantized;
+	}
+
+	out[0] = static_cast<uint16_t>(bits);
+	out[1] = static_cast<uint16_t>(bits >> 16);
+	out[2] = static_cast<uint16_t>(bits >> 32);
+}
+
+static void DecodeRotation(const uint16_t* in, float* q)
+{
+	const uint64_t bits = uint64_t(in[0]) | (uint64_t(in[1]) << 16) | (uint64_t(in[2]) << 32);
+	const uint32_t largest = static_cast<uint32_t>(bits >> 45) & 3;
+
+	float sum = 0.0f;
+	int shift = 30;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+
+		const uint32_t quantized = static_cast<uint32_t>(bits >> shift) & GLTF_SMALLEST_THREE_MAX;
+		q[i] = (quantized * (2.0f / GLTF_SMALLEST_THREE_MAX) - 1.0f) * GLTF_SMALLEST_THREE_RANGE;
+		sum += q[i] * q[i];
+		shift -= 15;
+	}
+
+	q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+}
+
+static float ToKeyTime(float time, float start, float duration)
+{
+	if (duration <= 0.0f)
+		return 0.0f;
+	return std::min(GLTF_KEY_TIME_STEPS, std::max(0.0f, (time - start) * (GLTF_KEY_TIME_STEPS / duration)));
+}
+
+template <typename T>
+static float KeyFactor(float time, T t0, T t1)
+{
+	// keys that ended up on the same step, the later one wins like it would for a time past both
+	if (t1 <= t0)
+		return 1.0f;
+	return std::min(1.0f, std::max(0.0f, (time - t0) / float(t1 - t0)));
+}
+
+static void InterpolateKeys(const float* a, const float* b, float f, uint32_t width, bool rotation, float* out)
+{
+	if (rotation)
+		Nlerp(a, b, f, out);
+	else
+		for (uint32_t i = 0; i < width; ++i)
+			out[i] = a[i] + (b[i] - a[i]) * f;
+}
+
+// One track at a key time, the data pointers already at the track's offsets
+template <typename T>
+static void DecodeTrack(const EGLTF::SGLTFCompressedTrack& track, const T* times, const uint16_t* rotations, const float* values, float time, float* out)
+{
+	if (track.format == EGLTF::EGLTFTrackFormat::IDENTITY)
+	{
+		IdentityValue(track.path, track.width, out);
+		return;
+	}
+
+	if (track.format == EGLTF::EGLTFTrackFormat::CONSTANT || track.keyCount == 1)
+	{
+		memcpy(out, values, track.width * sizeof(float));
+		return;
+	}
+
+	const uint32_t count = track.keyCount;
+	uint32_t key = 0;
+	if (time >= times[count - 1])
+		key = count - 1;
+	else if (time > times[0])
+		key = static_cast<uint32_t>(std::upper_bound(times, times + count, time) - times) - 1;
+
+	const bool rotation = track.path == TPath::ROTATION;
+	const bool interpolate = !track.step && key + 1 < count;
+	const float f = interpolate ? KeyFactor(time, times[key], times[key + 1]) : 0.0f;
+
+	if (track.packed)
+	{
+		float a[4];
+		DecodeRotation(rotations + key * 3, a);
+		if (!interpolate)
+		{
+			memcpy(out, a, sizeof(a));
+			return;
+		}
+
+		float b[4];
+		DecodeRotation(rotations + (key + 1) * 3, b);
+		Nlerp(a, b, f, out);
+		return;
+	}
+
+	const float* a = values + key * track.width;
+	if (!interpolate)
+		memcpy(out, a, track.width * sizeof(float));
+	else
+		InterpolateKeys(a, a + track.width, f, track.width, rotation, out);
+}
+
+// How far off a value is, as the drift it causes for transforms
+static double TrackError(const float* a, const float* b, uint32_t width, TPath path, double lever)
+{
+	switch (path)
+	{
+	case TPath::TRANSLATION:
+	{
+		double sum = 0.0;
+		for (uint32_t i = 0; i < width; ++i)
+			sum += double(a[i] - b[i]) * (a[i] - b[i]);
+		return std::sqrt(sum);
+	}
+	case TPath::ROTATION:
+	{
+		// from the chord between the two, acos of their dot product loses small angles to rounding
+		const double dot = double(a[0]) * b[0] + double(a[1]) * b[1] + double(a[2]) * b[2] + double(a[3]) * b[3];
+		const double sign = dot < 0.0 ? -1.0 : 1.0;
+		double chord = 0.0;
+		for (int i = 0; i < 4; ++i)
+			chord += (a[i] - sign * b[i]) * (a[i] - sign * b[i]);
+		return 4.0 * std::asin(std::min(1.0, std::sqrt(chord) * 0.5)) * lever;
+	}
+	case TPath::SCALE:
+	case TPath::WEIGHTS:
+	default:
+	{
+		double largest = 0.0;
+		for (uint32_t i = 0; i < width; ++i)
+			largest = std::max(largest, std::fabs(double(a[i]) - b[i]));
+		return path == TPath::SCALE ? largest * lever : largest;
+	}
+	}
+}
+
+static void BuildHierarchy(const EGLTF::SGLTFAsset& asset, double leafExtent, SHierarchy& hierarchy)
+{
+	const size_t count = asset.nodes.size();
+	hierarchy.parent.assign(count, -1);
+	hierarchy.lever.assign(count, leafExtent);
+	hierarchy.chain.assign(count, leafExtent);
+	hierarchy.order.clear();
+
+	for (size_t n = 0; n < count; ++n)
+		for (int32_t child : asset.nodes[n].children)
+			if (child >= 0 && static_cast<size_t>(child) < count && hierarchy.parent[child] < 0 && child != static_cast<int32_t>(n))
+				hierarchy.parent[child] = static_cast<int32_t>(n);
+
+	// world positions of the rest pose, parents first
+	std::vector<std::array<double, 16>> world(count);
+	std::vector<uint8_t> visited(count, 0);
+	for (size_t n = 0; n < count; ++n)
+	{
+		if (hierarchy.parent[n] >= 0)
+			continue;
+
+		const size_t first = hierarchy.order.size();
+		hierarchy.order.push_back(static_cast<int32_t>(n));
+		visited[n] = 1;
+		world[n] = asset.nodes[n].matrix;
+
+		for (size_t i = first; i < hierarchy.order.size(); ++i)
+		{
+			const int32_t node = hierarchy.order[i];
+			for (int32_t child : asset.nodes[node].children)
+			{
+				if (child < 0 || static_cast<size_t>(child) >= count || visited[child] || hierarchy.parent[child] != node)
+					continue;
+
+				visited[child] = 1;
+
+				const std::array<double, 16>& a = world[node];
+				const std::array<double, 16>& b = asset.nodes[child].matrix;
+				std::array<double, 16>& res = world[child];
+				for (int c = 0; c < 4; ++c)
+					for (int r = 0; r < 4; ++r)
+						res[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+
+				hierarchy.order.push_back(child);
+			}
+		}
+	}
+
+	std::vector<double> reach(count, 0.0);
+	for (int32_t node : hierarchy.order)
+	{
+		const std::array<double, 16>& p = world[node];
+		for (int32_t a = hierarchy.parent[node]; a >= 0; a = hierarchy.parent[a])
+		{
+			const std::array<double, 16>& q = world[a];
+			const double d = std::sqrt((p[12] - q[12]) * (p[12] - q[12]) + (p[13] - q[13]) * (p[13] - q[13]) + (p[14] - q[14]) * (p[14] - q[14]));
+			reach[a] = std::max(reach[a], d);
+		}
+	}
+
+	// levers summed up from the root and down to the heaviest leaf
+	std::vector<double> above(count, 0.0);
+	std::vector<double> below(count, 0.0);
+	for (int32_t node : hierarchy.order)
+	{
+		const int32_t parent = hierarchy.parent[node];
+		hierarchy.lever[node] = reach[node] + leafExtent;
+		above[node] = hierarchy.lever[node] + (parent >= 0 ? above[parent] : 0.0);
+	}
+	for (size_t i = hierarchy.order.size(); i > 0; --i)
+	{
+		const int32_t node = hierarchy.order[i - 1];
+		below[node] += hierarchy.lever[node];
+		const int32_t parent = hierarchy.parent[node];
+		if (parent >= 0)
+			below[parent] = std::max(below[parent], below[node]);
+	}
+	for (int32_t node : hierarchy.order)
+		hierarchy.chain[node] = above[node] + below[node] - hierarchy.lever[node];
+}
+
+// The time and value of every point the compressed track is checked against
+static void ReferencePoints(const SChannelCurve& curve, float sampleRate, std::vector<float>& times, std::vector<float>& values)
+{
+	times = curve.times;
+
+	// cubic curves bend between their keys, the samples in between are what the linear keys have to follow
+	if (curve.interpolation == TInterpolation::CUBICSPLINE && sampleRate > 0.0f)
+	{
+		const float first = curve.times.front();
+		const float last = curve.times.back();
+		const uint64_t steps = static_cast<uint64_t>(std::floor((last - first) * sampleRate));
+		for (uint64_t i = 1; i < steps; ++i)
+			times.push_back(first + float(i) / sampleRate);
+
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+	}
+
+	values.resize(times.size() * curve.width);
+	for (size_t i = 0; i < times.size(); ++i)
+		EvaluateCurve(curve, times[i], values.data() + i * curve.width);
+}
+
+// Every key the same, such tracks end up as identity or constant without using up any of the node's budget
+static bool IsStatic(const SChannelCurve& curve)
+{
+	for (size_t i = curve.width; i < curve.values.size(); ++i)
+		if (curve.values[i] != curve.values[i % curve.width])
+			return false;
+	return true;
+}
+
+static void CompressTrack(const SChannelCurve& curve, int32_t node, float start, float duration, double budget, double lever,
+	const EGLTF::SGLTFAnimationCompressionOptions& options, STrackResult& result)
+{
+	const uint32_t width = curve.width;
+	const bool rotation = curve.path == TPath::ROTATION;
+
+	EGLTF::SGLTFCompressedTrack& track = result.track;
+	track.node = node;
+	track.path = curve.path;
+	track.width = width;
+	track.step = curve.interpolation == TInterpolation::STEP;
+	result.keysBefore = curve.times.size();
+
+	std::vector<float> times;
+	std::vector<float> values;
+	ReferencePoints(curve, options.sampleRate, times, values);
+	const size_t count = times.size();
+
+	// identity, then a single value
+	std::vector<float> candidate(width);
+	IdentityValue(curve.path, width, candidate.data());
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 1)
+			candidate.assign(values.begin(), values.begin() + width);
+
+		double error = 0.0;
+		for (size_t i = 0; i < count && error <= budget; ++i)
+			error = std::max(error, TrackError(values.data() + i * width, candidate.data(), width, curve.path, lever));
+
+		if (error <= budget || (pass == 1 && duration <= 0.0f))
+		{
+			track.format = pass == 0 ? EGLTF::EGLTFTrackFormat::IDENTITY : EGLTF::EGLTFTrackFormat::CONSTANT;
+			track.keyCount = pass == 0 ? 0 : 1;
+			if (pass == 1)
+				result.values = candidate;
+			result.error = error;
+			result.ok = true;
+			return;
+		}
+	}
+
+	track.format = EGLTF::EGLTFTrackFormat::ANIMATED;
+
+	// every point as a key, the way the decoder will see it
+	std::vector<float> sampleTimes(count);
+	std::vector<float> roundedTimes(count);
+	std::vector<uint16_t> encoded(rotation ? count * 3 : 0);
+	std::vector<float> quantized(rotation ? count * 4 : 0);
+	for (size_t i = 0; i < count; ++i)
+	{
+		sampleTimes[i] = ToKeyTime(times[i], start, duration);
+		roundedTimes[i] = static_cast<float>(std::lround(sampleTimes[i]));
+		if (rotation)
+		{
+			EncodeRotation(values.data() + i * 4, encoded.data() + i * 3);
+			DecodeRotation(encoded.data() + i * 3, quantized.data() + i * 4);
+		}
+	}
+
+	std::vector<uint8_t> keep(count);
+	std::vector<float> value(width);
+
+	// keeps the keys the budget needs and measures what the decoder really gives
+	auto reduce = [&](bool packed, bool exact)
+	{
+		const std::vector<float>& decoded = packed ? quantized : values;
+		const std::vector<float>& keyTimes = exact ? sampleTimes : roundedTimes;
+		track.packed = packed;
+		track.exact = exact;
+		keep.assign(count, 0);
+		keep[0] = 1;
+
+		if (track.step)
+		{
+			// a key can go when the one before it still holds within the budget
+			size_t previous = 0;
+			for (size_t i = 1; i < count; ++i)
+			{
+				if (TrackError(values.data() + i * width, decoded.data() + previous * width, width, curve.path, lever) > budget)
+				{
+					keep[i] = 1;
+					previous = i;
+				}
+			}
+		}
+		else
+		{
+			keep[count - 1] = 1;
+
+			// split the worst segment until every point is within the budget of the line between its neighbouring keys
+			std::vector<std::pair<size_t, size_t>> segments;
+			segments.push_back(std::make_pair(size_t(0), count - 1));
+			while (!segments.empty())
+			{
+				const size_t a = segments.back().first;
+				const size_t b = segments.back().second;
+				segments.pop_back();
+
+				double worst = budget;
+				size_t split = 0;
+				for (size_t i = a + 1; i < b; ++i)
+				{
+					const float f = KeyFactor(sampleTimes[i], keyTimes[a], keyTimes[b]);
+					InterpolateKeys(decoded.data() + a * width, decoded.data() + b * width, f, width, rotation, value.data());
+
+					const double error = TrackError(values.data() + i * width, value.data(), width, curve.path, lever);
+					if (error > worst)
+					{
+						worst = error;
+						split = i;
+					}
+				}
+
+				if (split == 0)
+					continue;
+
+				keep[split] = 1;
+				segments.push_back(std::make_pair(a, split));
+				segments.push_back(std::make_pair(split, b));
+			}
+		}
+
+		result.times.clear();
+		result.exactTimes.clear();
+		result.rotations.clear();
+		result.values.clear();
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!keep[i])
+				continue;
+
+			if (exact)
+				result.exactTimes.push_back(sampleTimes[i]);
+			else
+				result.times.push_back(static_cast<uint16_t>(roundedTimes[i]));
+			if (packed)
+				result.rotations.insert(result.rotations.end(), encoded.begin() + i * 3, encoded.begin() + i * 3 + 3);
+			else
+				result.values.insert(result.values.end(), values.begin() + i * width, values.begin() + (i + 1) * width);
+		}
+		track.keyCount = static_cast<uint32_t>(exact ? result.exactTimes.size() : result.times.size());
+
+		result.error = 0.0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (exact)
+				DecodeTrack(track, result.exactTimes.data(), result.rotations.data(), result.values.data(), sampleTimes[i], value.data());
+			else
+				DecodeTrack(track, result.times.data(), result.rotations.data(), result.values.data(), sampleTimes[i], value.data());
+			result.error = std::max(result.error, TrackError(values.data() + i * width, value.data(), width, curve.path, lever));
+		}
+	};
+
+	// Smallest first. A node with a long lever and a fast curve can get a share that the 48 bit rotations or the 16 bit key times
+	// are too coarse for, even with every key kept, those fall back to float.
+	for (int attempt = 0; attempt < 4; ++attempt)
+	{
+		const bool packed = rotation && attempt < 2;
+		if (!rotation && attempt >= 2)
+			break;
+
+		reduce(packed, (attempt & 1) != 0);
+		if (result.error <= budget)
+			break;
+	}
+
+	result.ok = true;
+}
+
+uint64_t EGLTF::SGLTFCompressedAnimation::GetSize() const
+{
+	return tracks.size() * sizeof(SGLTFCompressedTrack) + times.size() * sizeof(uint16_t) + exactTimes.size() * sizeof(float) +
+		rotations.size() * sizeof(uint16_t) + values.size() * sizeof(float);
+}
+
+void EGLTF::SGLTFAnimationCompressionReport::Print(FILE* out) const
+{
+	fprintf(out, "\nAnimation compression: %u identity, %u constant, %u animated tracks (%u with float rotations, %u with float times), %llu -> %llu keys",
+		identityTracks, constantTracks, animatedTracks, floatRotationTracks, exactTimeTracks, static_cast<unsigned long long>(keysBefore),
+		static_cast<unsigned long long>(keysAfter));
+	fprintf(out, "\nAnimation data: %llu -> %llu bytes, %.2f:1", static_cast<unsigned long long>(bytesBefore), static_cast<unsigned long long>(bytesAfter), GetRatio());
+	fprintf(out, "\nLargest error: drift %g, weight %g\n", maxError, maxWeightError);
+}
+
+bool EGLTF::CompressGLTFAnimations(const SGLTFAsset& asset, std::vector<SGLTFCompressedAnimation>& out, SGLTFAnimationCompressionReport& report,
+	const SGLTFAnimationCompressionOptions& options, CGLTFThreadPool* pool)
+{
+	report = SGLTFAnimationCompressionReport();
+	out.clear();
+	out.resize(asset.animations.size());
+
+	SHierarchy hierarchy;
+	BuildHierarchy(asset, options.leafExtent, hierarchy);
+	const size_t nodeCount = asset.nodes.size();
+
+	struct SJob
+	{
+		size_t animation;
+		size_t channel;
+	};
+
+	std::vector<SJob> jobs;
+	std::set<int32_t> accessors;
+	for (size_t a = 0; a < asset.animations.size(); ++a)
+	{
+		const SGLTFAsset_Prop_Animation& animation = asset.animations[a];
+		for (size_t c = 0; c < animation.channels.size(); ++c)
+		{
+			const SGLTFAsset_Prop_Animation_Channel& channel = animation.channels[c];
+			if (channel.target.node < 0 || static_cast<size_t>(channel.target.node) >= nodeCount)
+				continue;
+
+			jobs.push_back({ a, c });
+			if (channel.sampler >= 0 && static_cast<size_t>(channel.sampler) < animation.samplers.size())
+			{
+				accessors.insert(animation.samplers[channel.sampler].input);
+				accessors.insert(animation.samplers[channel.sampler].output);
+			}
+		}
+	}
+
+	for (int32_t accessor : accessors)
+	{
+		if (accessor < 0 || static_cast<size_t>(accessor) >= asset.accessors.size())
+			continue;
+		const SGLTFAsset_Prop_Accessor& acc = asset.accessors[accessor];
+		report.bytesBefore += static_cast<uint64_t>(std::max<int64_t>(acc.count, 0)) * GetGLTFElementSize(acc.componentType, acc.type);
+	}
+
+	// the time range of every animation, and how many transform tracks share a node's budget
+	std::vector<SChannelCurve> curves(jobs.size());
+	std::vector<uint8_t> readOk(jobs.size(), 0);
+	auto read = [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; ++j)
+		{
+			const SGLTFAsset_Prop_Animation& animation = asset.animations[jobs[j].animation];
+			readOk[j] = ReadCurve(asset, animation, animation.channels[jobs[j].channel], curves[j]);
+		}
+	};
+
+	if (pool)
+		pool->ParallelFor(jobs.size(), 1, read);
+	else
+		read(0, jobs.size());
+
+	std::vector<float> starts(out.size(), 0.0f);
+	std::vector<float> ends(out.size(), 0.0f);
+	std::vector<uint8_t> hasRange(out.size(), 0);
+	std::vector<std::vector<uint32_t>> tracksPerNode(out.size());
+	for (size_t j = 0; j < jobs.size(); ++j)
+	{
+		const SGLTFAsset_Prop_Animation& animation = asset.animations[jobs[j].animation];
+		if (!readOk[j])
+		{
+			fprintf(stderr, "\nError: animations[%zu].channels[%zu] has a sampler that can't be read\n", jobs[j].animation, jobs[j].channel);
+			return false;
+		}
+
+		const size_t a = jobs[j].animation;
+		starts[a] = hasRange[a] ? std::min(starts[a], curves[j].times.front()) : curves[j].times.front();
+		ends[a] = hasRange[a] ? std::max(ends[a], curves[j].times.back()) : curves[j].times.back();
+		hasRange[a] = 1;
+
+		if (tracksPerNode[a].empty())
+			tracksPerNode[a].assign(nodeCount, 0);
+		if (curves[j].path != TPath::WEIGHTS && !IsStatic(curves[j]))
+			++tracksPerNode[a][animation.channels[jobs[j].channel].target.node];
+	}
+
+	std::vector<STrackResult> results(jobs.size());
+	auto compress = [&](size_t begin, size_t end)
+	{
+		for (size_t j = begin; j < end; ++j)
+		{
+			const size_t a = jobs[j].animation;
+			const int32_t node = asset.animations[a].channels[jobs[j].channel].target.node;
+
+			// a node's share goes with its lever, which makes the angle a rotation may be off by the same along a chain
+			double budget = options.weightError;
+			if (curves[j].path != TPath::WEIGHTS)
+				budget = options.maxError * hierarchy.lever[node] / hierarchy.chain[node] / std::max<uint32_t>(tracksPerNode[a][node], 1);
+
+			results[j].budget = budget;
+			CompressTrack(curves[j], node, starts[a], ends[a] - starts[a], budget, hierarchy.lever[node], options, results[j]);
+		}
+	};
+
+	if (pool)
+		pool->ParallelFor(jobs.size(), 1, compress);
+	else
+		compress(0, jobs.size());
+
+	// in channel order, the drift of a node adds up from the root
+	std::vector<std::vector<double>> nodeErrors(out.size());
+	for (size_t j = 0; j < jobs.size(); ++j)
+	{
+		const size_t a = jobs[j].animation;
+		STrackResult& result = results[j];
+		SGLTFCompressedAnimation& animation = out[a];
+
+		result.track.timeOffset = static_cast<uint32_t>(result.track.exact ? animation.exactTimes.size() : animation.times.size());
+		result.track.valueOffset = static_cast<uint32_t>(result.track.packed ? animation.rotations.size() : animation.values.size());
+
+		animation.times.insert(animation.times.end(), result.times.begin(), result.times.end());
+		animation.exactTimes.insert(animation.exactTimes.end(), result.exactTimes.begin(), result.exactTimes.end());
+		animation.rotations.insert(animation.rotations.end(), result.rotations.begin(), result.rotations.end());
+		animation.values.insert(animation.values.end(), result.values.begin(), result.values.end());
+		animation.tracks.push_back(result.track);
+
+		report.keysBefore += result.keysBefore;
+		report.keysAfter += result.track.keyCount;
+		if (result.track.format == EGLTFTrackFormat::IDENTITY)
+			++report.identityTracks;
+		else if (result.track.format == EGLTFTrackFormat::CONSTANT)
+			++report.constantTracks;
+		else
+			++report.animatedTracks;
+
+		if (result.track.format == EGLTFTrackFormat::ANIMATED && result.track.path == TPath::ROTATION && !result.track.packed)
+			++report.floatRotationTracks;
+		if (result.track.exact)
+			++report.exactTimeTracks;
+		if (result.error > result.budget)
+			++report.overBudgetTracks;
+
+		if (result.track.path == TPath::WEIGHTS)
+			report.maxWeightError = std::max(report.maxWeightError, result.error);
+		else
+		{
+			if (nodeErrors[a].empty())
+				nodeErrors[a].assign(nodeCount, 0.0);
+			nodeErrors[a][result.track.node] += result.error;
+		}
+	}
+
+	for (size_t a = 0; a < out.size(); ++a)
+	{
+		out[a].name = asset.animations[a].name;
+		out[a].start = starts[a];
+		out[a].duration = ends[a] - starts[a];
+		report.bytesAfter += out[a].GetSize();
+
+		if (nodeErrors[a].empty())
+			continue;
+
+		std::vector<double> drift(nodeCount, 0.0);
+		for (int32_t node : hierarchy.order)
+		{
+			const int32_t parent = hierarchy.parent[node];
+			drift[node] = nodeErrors[a][node] + (parent >= 0 ? drift[parent] : 0.0);
+			report.maxError = std::max(report.maxError, drift[node]);
+		}
+	}
+
+	if (report.overBudgetTracks > 0)
+	{
+		fprintf(stderr, "\nError: %u animation tracks are off by more than their share of maxError even uncompressed, largest drift %g\n",
+			report.overBudgetTracks, report.maxError);
+		return false;
+	}
+
+	return true;
+}
+
+void EGLTF::SampleGLTFCompressedAnimation(const SGLTFCompressedAnimation& animation, float time, std::vector<SGLTFNodePose>& poses)
+{
+	const float keyTime = ToKeyTime(time, animation.start, animation.duration);
+
+	for (const auto& track : animation.tracks)
+	{
+		if (track.node < 0 || static_cast<size_t>(track.node) >= poses.size())
+			continue;
+
+		const uint16_t* rotations = track.packed ? animation.rotations.data() + track.valueOffset : nullptr;
+		const float* values = track.packed ? nullptr : animation.values.data() + track.valueOffset;
+		float* out = PoseTarget(poses[track.node], track.path, track.width);
+		if (track.exact)
+			DecodeTrack(track, animation.exactTimes.data() + track.timeOffset, rotations, values, keyTime, out);
+		else
+			DecodeTrack(track, animation.times.data() + track.timeOffset, rotations, values, keyTime, out);
+	}
+}
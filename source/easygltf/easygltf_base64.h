@@ -0,0 +1,31 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+// Internal, not part of the installed headers
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace EGLTF
+{
+	// The base64 payload of a data uri into out. False when its length is not a multiple of 4.
+	// Used by regular loads and the progressive loader alike, so both accept the same uris.
+	bool DecodeGLTFBase64(const char* in, size_t length, std::vector<uint8_t>& out);
+}
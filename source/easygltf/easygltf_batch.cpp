@@ -0,0 +1,165 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_batch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+// true when a should be loaded after b
+static bool LoadsLater(const EGLTF::CGLTFBatchLoader::TAssetId aId, int aPriority, const EGLTF::CGLTFBatchLoader::TAssetId bId, int bPriority)
+{
+	if (aPriority != bPriority)
+		return aPriority < bPriority;
+
+	return aId > bId;
+}
+
+static bool EndsWith(const std::string& str, const char* suffix)
+{
+	const size_t len = strlen(suffix);
+	return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+EGLTF::CGLTFBatchLoader::CGLTFBatchLoader(CGLTFThreadPool& pool)
+	: m_pool(pool), m_inFlight(0)
+{
+}
+
+EGLTF::CGLTFBatchLoader::~CGLTFBatchLoader()
+{
+	WaitAll();
+}
+
+EGLTF::CGLTFBatchLoader::TAssetId EGLTF::CGLTFBatchLoader::AddFile(const std::string& filepath, int priority, TCallback callback)
+{
+	std::unique_ptr<SEntry> entry(new SEntry());
+	entry->priority = priority;
+	entry->filepath = filepath;
+	entry->fromMemory = false;
+	entry->callback = std::move(callback);
+
+	return Add(std::move(entry));
+}
+
+EGLTF::CGLTFBatchLoader::TAssetId EGLTF::CGLTFBatchLoader::AddMemory(std::vector<uint8_t> data, int priority, TCallback callback)
+{
+	std::unique_ptr<SEntry> entry(new SEntry());
+	entry->priority = priority;
+	entry->data = std::move(data);
+	entry->fromMemory = true;
+	entry->callback = std::move(callback);
+
+	return Add(std::move(entry));
+}
+
+EGLTF::CGLTFBatchLoader::TAssetId EGLTF::CGLTFBatchLoader::Add(std::unique_ptr<SEntry> entry)
+{
+	entry->future = entry->promise.get_future().share();
+	entry->easygltf.SetThreadPool(&m_pool);
+	entry->easygltf.SetLoadListener(m_listener);
+
+	TAssetId id;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		id = static_cast<TAssetId>(m_entries.size());
+		entry->id = id;
+
+		m_waiting.push_back(entry.get());
+		std::push_heap(m_waiting.begin(), m_waiting.end(), [](const SEntry* a, const SEntry* b) { return LoadsLater(a->id, a->priority, b->id, b->priority); });
+
+		m_entries.push_back(std::move(entry));
+	}
+
+	// the task does not stand for this asset in particular, whoever runs it loads the most important one waiting at that point
+	m_inFlight.fetch_add(1);
+	m_pool.Submit([this]() { LoadNext(); });
+
+	return id;
+}
+
+void EGLTF::CGLTFBatchLoader::LoadNext()
+{
+	SEntry* entry;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::pop_heap(m_waiting.begin(), m_waiting.end(), [](const SEntry* a, const SEntry* b) { return LoadsLater(a->id, a->priority, b->id, b->priority); });
+		entry = m_waiting.back();
+		m_waiting.pop_back();
+	}
+
+	const bool ok = Load(*entry);
+
+	if (entry->callback)
+		entry->callback(entry->id, ok, entry->easygltf);
+
+	entry->promise.set_value(ok);
+
+	m_inFlight.fetch_sub(1);
+}
+
+bool EGLTF::CGLTFBatchLoader::Load(SEntry& entry)
+{
+	if (!entry.fromMemory)
+	{
+		if (EndsWith(entry.filepath, ".glb") || EndsWith(entry.filepath, ".GLB"))
+			return entry.easygltf.LoadGLB_file(entry.filepath);
+
+		return entry.easygltf.LoadGLTF_file(entry.filepath);
+	}
+
+	std::vector<uint8_t> data = std::move(entry.data);
+
+	if (data.size() >= 4 && memcmp(data.data(), "glTF", 4) == 0)
+		return entry.easygltf.LoadGLB_memory(data);
+
+	// rapidjson parses it as a null terminated string
+	if (data.empty() || data.back() != 0)
+		data.push_back(0);
+
+	return entry.easygltf.LoadGLTF_memory(data);
+}
+
+std::shared_future<bool> EGLTF::CGLTFBatchLoader::GetFuture(TAssetId id) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries[id]->future;
+}
+
+const EGLTF::CEasyGLTF& EGLTF::CGLTFBatchLoader::GetAsset(TAssetId id) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries[id]->easygltf;
+}
+
+size_t EGLTF::CGLTFBatchLoader::GetAssetCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+void EGLTF::CGLTFBatchLoader::WaitAll()
+{
+	while (m_inFlight.load() > 0)
+	{
+		if (!m_pool.RunPendingTask())
+			std::this_thread::yield();
+	}
+}
@@ -0,0 +1,1690 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#include "easygltf_bcn.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EGLTF_BCN_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// BC7 two subset partitions, bit i is the subset of pixel i, and the pixel of subset 1 whose index loses its top bit
+static const uint16_t BC7_PARTITIONS[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22 };
+static const uint8_t BC7_ANCHORS[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+	15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6, 6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15 };
+static const uint8_t BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+static const uint8_t BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const uint8_t BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static uint32_t FirstBit(uint32_t x)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_ctz(x));
+#endif
+}
+
+namespace
+{
+	// A 4x4 block, planar so 4 pixels go through SSE2 at once. Channels a format does not keep are 0.
+	struct SPixels
+	{
+		float c[4][16];
+	};
+
+	struct SBitWriter
+	{
+		uint8_t* out;
+		uint32_t bit;
+
+		void Write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; ++i, ++bit)
+				if ((value >> i) & 1)
+					out[bit >> 3] |= static_cast<uint8_t>(1 << (bit & 7));
+		}
+	};
+
+	struct SBitReader
+	{
+		const uint8_t* in;
+		uint32_t bit;
+
+		uint32_t Read(uint32_t count)
+		{
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < count; ++i, ++bit)
+				value |= static_cast<uint32_t>((in[bit >> 3] >> (bit & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	struct SBC1
+	{
+		uint16_t c0;
+		uint16_t c1;
+		uint8_t indices[16];
+		float error;
+	};
+
+	struct SBC4
+	{
+		uint8_t r0;
+		uint8_t r1;
+		uint8_t indices[16];
+		float error;
+	};
+
+	// modes 5 and 6 use subset 0 only, mode 5 has no p-bits and indexes its alpha separately
+	struct SBC7
+	{
+		uint32_t mode;
+		uint32_t partition;
+		uint8_t q[2][2][4]; // subset, endpoint, channel, before the p-bit
+		uint8_t p[2][2]; // mode 1 shares it between the endpoints of a subset
+		uint8_t indices[16];
+		uint8_t alphaIndices[16];
+		float error;
+	};
+}
+
+// Nearest palette entry of every pixel and its squared error, ties go to the lower entry
+static void FindIndices(const SPixels& px, const float (*palette)[4], uint32_t count, uint8_t* indices, float* errors)
+{
+#ifdef EGLTF_BCN_SSE2
+	for (uint32_t g = 0; g < 16; g += 4)
+	{
+		const __m128 r = _mm_loadu_ps(px.c[0] + g), gr = _mm_loadu_ps(px.c[1] + g), b = _mm_loadu_ps(px.c[2] + g), a = _mm_loadu_ps(px.c[3] + g);
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (uint32_t k = 0; k < count; ++k)
+		{
+			const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k][0]));
+			const __m128 dg = _mm_sub_ps(gr, _mm_set1_ps(palette[k][1]));
+			const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k][2]));
+			const __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[k][3]));
+			const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+			const __m128i less = _mm_castps_si128(_mm_cmplt_ps(d, best));
+			best = _mm_min_ps(d, best);
+			bestIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(static_cast<int>(k))), _mm_andnot_si128(less, bestIndex));
+		}
+
+		int32_t lanes[4];
+		_mm_storeu_ps(errors + g, best);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+		for (uint32_t i = 0; i < 4; ++i)
+			indices[g + i] = static_cast<uint8_t>(lanes[i]);
+	}
+#else
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float best = FLT_MAX;
+		uint32_t bestIndex = 0;
+		for (uint32_t k = 0; k < count; ++k)
+		{
+			float d = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+				d += (px.c[c][i] - palette[k][c]) * (px.c[c][i] - palette[k][c]);
+			if (d < best)
+			{
+				best = d;
+				bestIndex = k;
+			}
+		}
+		errors[i] = best;
+		indices[i] = static_cast<uint8_t>(bestIndex);
+	}
+#endif
+}
+
+static float SumErrors(const float* errors, uint16_t mask)
+{
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+		if ((mask >> i) & 1)
+			sum += errors[i];
+	return sum;
+}
+
+// Line through the pixels of mask by their principal axis, endpoints at the outermost projections
+static void FitLine(const SPixels& px, uint16_t mask, uint32_t channels, float e0[4], float e1[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float n = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		if (!((mask >> i) & 1))
+			continue;
+		for (uint32_t c = 0; c < channels; ++c)
+			mean[c] += px.c[c][i];
+		n += 1.0f;
+	}
+	for (uint32_t c = 0; c < 4; ++c)
+		mean[c] = n > 0.0f ? mean[c] / n : 0.0f;
+
+	float cov[4][4] = {};
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		if (!((mask >> i) & 1))
+			continue;
+		for (uint32_t a = 0; a < channels; ++a)
+			for (uint32_t b = a; b < channels; ++b)
+				cov[a][b] += (px.c[a][i] - mean[a]) * (px.c[b][i] - mean[b]);
+	}
+	for (uint32_t a = 0; a < channels; ++a)
+		for (uint32_t b = 0; b < a; ++b)
+			cov[a][b] = cov[b][a];
+
+	// power iteration from the column of the channel that varies most
+	uint32_t widest = 0;
+	for (uint32_t c = 1; c < channels; ++c)
+		if (cov[c][c] > cov[widest][widest])
+			widest = c;
+
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32_t c = 0; c < channels; ++c)
+		axis[c] = cov[c][widest];
+	for (uint32_t iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (uint32_t a = 0; a < channels; ++a)
+		{
+			for (uint32_t b = 0; b < channels; ++b)
+				next[a] += cov[a][b] * axis[b];
+			length += next[a] * next[a];
+		}
+		if (length < 1e-12f)
+			break;
+		length = 1.0f / std::sqrt(length);
+		for (uint32_t c = 0; c < channels; ++c)
+			axis[c] = next[c] * length;
+	}
+
+	float tMin = FLT_MAX, tMax = -FLT_MAX;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		if (!((mask >> i) & 1))
+			continue;
+		float t = 0.0f;
+		for (uint32_t c = 0; c < channels; ++c)
+			t += (px.c[c][i] - mean[c]) * axis[c];
+		tMin = std::min(tMin, t);
+		tMax = std::max(tMax, t);
+	}
+	if (tMin > tMax)
+		tMin = tMax = 0.0f;
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		e0[c] = std::min(std::max(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+		e1[c] = std::min(std::max(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+	}
+}
+
+// Endpoints that best reproduce the pixels of mask for fixed interpolation weights, weight 0 is all e0. False if the weights don't
+// pin them down.
+static bool SolveEndpoints(const SPixels& px, uint16_t mask, uint32_t channels, const float* weights, float e0[4], float e1[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ap[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, bp[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		if (!((mask >> i) & 1))
+			continue;
+		const float b = weights[i], a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			ap[c] += a * px.c[c][i];
+			bp[c] += b * px.c[c][i];
+		}
+	}
+
+	const float det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return false;
+
+	for (uint32_t c = 0; c < channels; ++c)
+	{
+		e0[c] = std::min(std::max((bb * ap[c] - ab * bp[c]) / det, 0.0f), 255.0f);
+		e1[c] = std::min(std::max((aa * bp[c] - ab * ap[c]) / det, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static int32_t Clamp(int32_t value, int32_t low, int32_t high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+// BC1
+
+static void Expand565(uint16_t color, int32_t out[3])
+{
+	const int32_t r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+static uint16_t Quantize565(const float color[4])
+{
+	const int32_t r = Clamp(static_cast<int32_t>(color[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+	const int32_t g = Clamp(static_cast<int32_t>(color[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+	const int32_t b = Clamp(static_cast<int32_t>(color[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+// The four color palette, c0 > c1 from here on
+static void BC1Palette(uint16_t c0, uint16_t c1, float palette[4][4])
+{
+	int32_t a[3], b[3];
+	Expand565(c0, a);
+	Expand565(c1, b);
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		palette[0][c] = static_cast<float>(a[c]);
+		palette[1][c] = static_cast<float>(b[c]);
+		palette[2][c] = static_cast<float>((2 * a[c] + b[c]) / 3);
+		palette[3][c] = static_cast<float>((a[c] + 2 * b[c]) / 3);
+	}
+	for (uint32_t k = 0; k < 4; ++k)
+		palette[k][3] = 0.0f;
+}
+
+static void EvaluateBC1(const SPixels& px, uint16_t c0, uint16_t c1, SBC1& out)
+{
+	if (c0 < c1)
+		std::swap(c0, c1);
+
+	float palette[4][4];
+	float errors[16];
+	BC1Palette(c0, c1, palette);
+	FindIndices(px, palette, 4, out.indices, errors);
+	out.c0 = c0;
+	out.c1 = c1;
+	out.error = SumErrors(errors, 0xFFFF);
+}
+
+// For every 8 bit value the 5 and 6 bit endpoint pair whose 2/3 : 1/3 mix comes closest, for blocks of a single color
+struct SSingleColorTables
+{
+	uint8_t pairs5[256][2];
+	uint8_t pairs6[256][2];
+
+	SSingleColorTables()
+	{
+		Fill(pairs5, 5);
+		Fill(pairs6, 6);
+	}
+
+	static void Fill(uint8_t (*pairs)[2], uint32_t bits)
+	{
+		const int32_t top = (1 << bits) - 1;
+		for (int32_t v = 0; v < 256; ++v)
+		{
+			int32_t best = INT32_MAX;
+			for (int32_t a = 0; a <= top; ++a)
+			{
+				for (int32_t b = 0; b <= top; ++b)
+				{
+					const int32_t ea = bits == 5 ? (a << 3) | (a >> 2) : (a << 2) | (a >> 4);
+					const int32_t eb = bits == 5 ? (b << 3) | (b >> 2) : (b << 2) | (b >> 4);
+					const int32_t error = std::abs((2 * ea + eb) / 3 - v);
+					if (error < best)
+					{
+						best = error;
+						pairs[v][0] = static_cast<uint8_t>(a);
+						pairs[v][1] = static_cast<uint8_t>(b);
+					}
+				}
+			}
+		}
+	}
+};
+
+static float EncodeBC1(const SPixels& px, uint32_t quality, uint8_t* out)
+{
+	SBC1 best;
+
+	bool single = true;
+	for (uint32_t i = 1; i < 16 && single; ++i)
+		single = px.c[0][i] == px.c[0][0] && px.c[1][i] == px.c[1][0] && px.c[2][i] == px.c[2][0];
+
+	if (single)
+	{
+		static const SSingleColorTables tables;
+		const uint8_t* r = tables.pairs5[static_cast<int32_t>(px.c[0][0])];
+		const uint8_t* g = tables.pairs6[static_cast<int32_t>(px.c[1][0])];
+		const uint8_t* b = tables.pairs5[static_cast<int32_t>(px.c[2][0])];
+		EvaluateBC1(px, static_cast<uint16_t>((r[0] << 11) | (g[0] << 5) | b[0]), static_cast<uint16_t>((r[1] << 11) | (g[1] << 5) | b[1]), best);
+	}
+	else
+	{
+		float e0[4], e1[4];
+		FitLine(px, 0xFFFF, 3, e0, e1);
+
+		// pulling the ends in a bit covers more of the block with the two mixes when nothing refines them afterwards
+		if (quality == 0)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const float inset = (e1[c] - e0[c]) / 16.0f;
+				e0[c] += inset;
+				e1[c] -= inset;
+			}
+		}
+		EvaluateBC1(px, Quantize565(e0), Quantize565(e1), best);
+
+		const uint32_t iterations = quality == 0 ? 0 : (quality == 1 ? 1 : 8);
+		static const float WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		for (uint32_t iteration = 0; iteration < iterations && best.c0 != best.c1; ++iteration)
+		{
+			float weights[16];
+			for (uint32_t i = 0; i < 16; ++i)
+				weights[i] = WEIGHTS[best.indices[i]];
+			if (!SolveEndpoints(px, 0xFFFF, 3, weights, e0, e1))
+				break;
+
+			SBC1 candidate;
+			EvaluateBC1(px, Quantize565(e0), Quantize565(e1), candidate);
+			if (candidate.error >= best.error)
+				break;
+			best = candidate;
+		}
+
+		// one step along every channel of every endpoint while that helps
+		if (quality >= 3)
+		{
+			static const int32_t SHIFTS[3] = { 11, 5, 0 };
+			static const int32_t TOPS[3] = { 31, 63, 31 };
+			for (bool improved = true; improved;)
+			{
+				improved = false;
+				for (uint32_t e = 0; e < 2; ++e)
+				{
+					for (uint32_t c = 0; c < 3; ++c)
+					{
+						for (int32_t step = -1; step <= 1; step += 2)
+						{
+							uint16_t ends[2] = { best.c0, best.c1 };
+							const int32_t value = ((ends[e] >> SHIFTS[c]) & TOPS[c]) + step;
+							if (value < 0 || value > TOPS[c])
+								continue;
+							ends[e] = static_cast<uint16_t>((ends[e] & ~(TOPS[c] << SHIFTS[c])) | (value << SHIFTS[c]));
+
+							SBC1 candidate;
+							EvaluateBC1(px, ends[0], ends[1], candidate);
+							if (candidate.error < best.error)
+							{
+								best = candidate;
+								improved = true;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// equal endpoints would read as the three color mode, index 0 is the same in both
+	if (best.c0 == best.c1)
+		memset(best.indices, 0, sizeof(best.indices));
+
+	memset(out, 0, 8);
+	out[0] = static_cast<uint8_t>(best.c0);
+	out[1] = static_cast<uint8_t>(best.c0 >> 8);
+	out[2] = static_cast<uint8_t>(best.c1);
+	out[3] = static_cast<uint8_t>(best.c1 >> 8);
+	for (uint32_t i = 0; i < 16; ++i)
+		out[4 + i / 4] |= static_cast<uint8_t>(best.indices[i] << ((i % 4) * 2));
+	return best.error;
+}
+
+// BC4
+
+static void BC4Palette(uint8_t r0, uint8_t r1, float palette[8][4])
+{
+	memset(palette, 0, sizeof(float) * 8 * 4);
+	palette[0][0] = r0;
+	palette[1][0] = r1;
+	if (r0 > r1)
+	{
+		for (int32_t i = 2; i < 8; ++i)
+			palette[i][0] = static_cast<float>(((8 - i) * r0 + (i - 1) * r1) / 7);
+	}
+	else
+	{
+		for (int32_t i = 2; i < 6; ++i)
+			palette[i][0] = static_cast<float>(((6 - i) * r0 + (i - 1) * r1) / 5);
+		palette[6][0] = 0.0f;
+		palette[7][0] = 255.0f;
+	}
+}
+
+static void EvaluateBC4(const SPixels& px, int32_t r0, int32_t r1, SBC4& out)
+{
+	float palette[8][4];
+	float errors[16];
+	out.r0 = static_cast<uint8_t>(Clamp(r0, 0, 255));
+	out.r1 = static_cast<uint8_t>(Clamp(r1, 0, 255));
+	BC4Palette(out.r0, out.r1, palette);
+	FindIndices(px, palette, 8, out.indices, errors);
+	out.error = SumErrors(errors, 0xFFFF);
+}
+
+// px holds the channel in c[0], the others are 0
+static float EncodeBC4(const SPixels& px, uint32_t quality, uint8_t* out)
+{
+	float low = 255.0f, high = 0.0f;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		low = std::min(low, px.c[0][i]);
+		high = std::max(high, px.c[0][i]);
+	}
+
+	SBC4 best;
+	EvaluateBC4(px, static_cast<int32_t>(high), static_cast<int32_t>(low), best);
+
+	if (high > low && quality >= 1)
+	{
+		static const float WEIGHTS[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+		const uint32_t iterations = quality == 1 ? 1 : 4;
+		for (uint32_t iteration = 0; iteration < iterations && best.r0 > best.r1; ++iteration)
+		{
+			float weights[16], e0[4], e1[4];
+			for (uint32_t i = 0; i < 16; ++i)
+				weights[i] = WEIGHTS[best.indices[i]];
+			if (!SolveEndpoints(px, 0xFFFF, 1, weights, e0, e1))
+				break;
+
+			const int32_t r0 = static_cast<int32_t>(e0[0] + 0.5f), r1 = static_cast<int32_t>(e1[0] + 0.5f);
+			if (r0 <= r1)
+				break;
+
+			SBC4 candidate;
+			EvaluateBC4(px, r0, r1, candidate);
+			if (candidate.error >= best.error)
+				break;
+			best = candidate;
+		}
+
+		// the six value mode has exact 0 and 255 for the pixels at the ends, the rest get the range in between
+		if (quality >= 2 && (low == 0.0f || high == 255.0f))
+		{
+			float innerLow = 255.0f, innerHigh = 0.0f;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				if (px.c[0][i] == 0.0f || px.c[0][i] == 255.0f)
+					continue;
+				innerLow = std::min(innerLow, px.c[0][i]);
+				innerHigh = std::max(innerHigh, px.c[0][i]);
+			}
+			if (innerLow > innerHigh)
+				innerLow = innerHigh = 0.0f;
+
+			SBC4 candidate;
+			EvaluateBC4(px, static_cast<int32_t>(innerLow), static_cast<int32_t>(innerHigh), candidate);
+			if (candidate.error < best.error)
+				best = candidate;
+		}
+
+		if (quality >= 3)
+		{
+			const int32_t r0 = best.r0, r1 = best.r1;
+			for (int32_t d0 = -2; d0 <= 2; ++d0)
+			{
+				for (int32_t d1 = -2; d1 <= 2; ++d1)
+				{
+					if ((r0 > r1) != (r0 + d0 > r1 + d1) || r0 + d0 < 0 || r0 + d0 > 255 || r1 + d1 < 0 || r1 + d1 > 255)
+						continue;
+
+					SBC4 candidate;
+					EvaluateBC4(px, r0 + d0, r1 + d1, candidate);
+					if (candidate.error < best.error)
+						best = candidate;
+				}
+			}
+		}
+	}
+
+	memset(out, 0, 8);
+	out[0] = best.r0;
+	out[1] = best.r1;
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 16; ++i)
+		bits |= static_cast<uint64_t>(best.indices[i]) << (i * 3);
+	for (uint32_t i = 0; i < 6; ++i)
+		out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+	return best.error;
+}
+
+// BC7, mode 6 (one subset, RGBA, 16 levels) and mode 1 (two subsets, RGB, 8 levels)
+
+static uint32_t Expand7(uint32_t q, uint32_t p)
+{
+	return (q << 1) | p;
+}
+
+static uint32_t Expand6(uint32_t q, uint32_t p)
+{
+	const uint32_t v = (q << 1) | p;
+	return (v << 1) | (v >> 6);
+}
+
+static void BC7Palette(const SBC7& block, uint32_t subset, float palette[16][4])
+{
+	const bool six = block.mode == 6;
+	const uint8_t* weights = six ? BC7_WEIGHTS4 : BC7_WEIGHTS3;
+	const uint32_t count = six ? 16 : 8;
+	const uint32_t channels = six ? 4 : 3;
+
+	uint32_t e[2][4];
+	for (uint32_t j = 0; j < 2; ++j)
+	{
+		const uint32_t p = six ? block.p[0][j] : block.p[subset][0];
+		for (uint32_t c = 0; c < 4; ++c)
+			e[j][c] = c >= channels ? 255 : (six ? Expand7(block.q[0][j][c], p) : Expand6(block.q[subset][j][c], p));
+	}
+
+	for (uint32_t k = 0; k < count; ++k)
+		for (uint32_t c = 0; c < 4; ++c)
+			palette[k][c] = static_cast<float>(((64 - weights[k]) * e[0][c] + weights[k] * e[1][c] + 32) >> 6);
+}
+
+// Best quantized value for an endpoint channel with a given p-bit
+static uint8_t QuantizeBC7(float value, uint32_t p, bool six)
+{
+	if (six)
+		return static_cast<uint8_t>(Clamp(static_cast<int32_t>((value - p) * 0.5f + 0.5f), 0, 127));
+
+	const int32_t estimate = static_cast<int32_t>(((value * 127.0f / 255.0f) - p) * 0.5f);
+	int32_t best = 0;
+	float bestError = FLT_MAX;
+	for (int32_t q = estimate - 1; q <= estimate + 1; ++q)
+	{
+		const int32_t clamped = Clamp(q, 0, 63);
+		const float error = std::fabs(static_cast<float>(Expand6(clamped, p)) - value);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = clamped;
+		}
+	}
+	return static_cast<uint8_t>(best);
+}
+
+static float EvaluateBC7Subset(const SPixels& px, SBC7& block, uint32_t subset, uint16_t mask)
+{
+	float palette[16][4];
+	float errors[16];
+	uint8_t indices[16];
+	BC7Palette(block, subset, palette);
+	FindIndices(px, palette, block.mode == 6 ? 16 : 8, indices, errors);
+	for (uint32_t i = 0; i < 16; ++i)
+		if ((mask >> i) & 1)
+			block.indices[i] = indices[i];
+	return SumErrors(errors, mask);
+}
+
+// Quantizes the float endpoints of a subset with every p-bit choice the quality allows and keeps the best, returns its error
+static float FitBC7Subset(const SPixels& px, SBC7& block, uint32_t subset, uint16_t mask, const float e0[4], const float e1[4], uint32_t quality)
+{
+	const bool six = block.mode == 6;
+	const uint32_t channels = six ? 4 : 3;
+
+	// mode 6 has a p-bit per endpoint, mode 1 one per subset
+	uint32_t choices[4][2];
+	uint32_t choiceCount = 0;
+	if (!six)
+	{
+		choices[choiceCount][0] = choices[choiceCount][1] = 0;
+		++choiceCount;
+		choices[choiceCount][0] = choices[choiceCount][1] = 1;
+		++choiceCount;
+	}
+	else if (quality >= 2)
+	{
+		for (uint32_t p = 0; p < 4; ++p, ++choiceCount)
+		{
+			choices[choiceCount][0] = p & 1;
+			choices[choiceCount][1] = p >> 1;
+		}
+	}
+	else
+	{
+		// the p-bit that rounds each endpoint best on its own
+		const float* ends[2] = { e0, e1 };
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			float errors[2] = { 0.0f, 0.0f };
+			for (uint32_t p = 0; p < 2; ++p)
+				for (uint32_t c = 0; c < channels; ++c)
+					errors[p] += std::fabs(static_cast<float>(Expand7(QuantizeBC7(ends[j][c], p, true), p)) - ends[j][c]);
+			choices[0][j] = errors[1] < errors[0] ? 1 : 0;
+		}
+		choiceCount = 1;
+	}
+
+	SBC7 best = block;
+	float bestError = FLT_MAX;
+	for (uint32_t choice = 0; choice < choiceCount; ++choice)
+	{
+		SBC7 candidate = block;
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			const float* end = j == 0 ? e0 : e1;
+			if (six)
+				candidate.p[0][j] = static_cast<uint8_t>(choices[choice][j]);
+			else
+				candidate.p[subset][0] = static_cast<uint8_t>(choices[choice][0]);
+			for (uint32_t c = 0; c < channels; ++c)
+				candidate.q[subset][j][c] = QuantizeBC7(end[c], choices[choice][j], six);
+		}
+
+		const float error = EvaluateBC7Subset(px, candidate, subset, mask);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = candidate;
+		}
+	}
+
+	block = best;
+	return bestError;
+}
+
+static float EncodeBC7Subset(const SPixels& px, SBC7& block, uint32_t subset, uint16_t mask, uint32_t quality)
+{
+	const bool six = block.mode == 6;
+	const uint32_t channels = six ? 4 : 3;
+
+	float e0[4], e1[4];
+	FitLine(px, mask, channels, e0, e1);
+	float error = FitBC7Subset(px, block, subset, mask, e0, e1, quality);
+
+	const uint32_t iterations = quality == 0 ? 0 : (quality == 1 ? 1 : (quality == 2 ? 3 : 8));
+	const uint8_t* table = six ? BC7_WEIGHTS4 : BC7_WEIGHTS3;
+	for (uint32_t iteration = 0; iteration < iterations && error > 0.0f; ++iteration)
+	{
+		float weights[16];
+		for (uint32_t i = 0; i < 16; ++i)
+			weights[i] = table[block.indices[i]] / 64.0f;
+		if (!SolveEndpoints(px, mask, channels, weights, e0, e1))
+			break;
+
+		SBC7 candidate = block;
+		const float candidateError = FitBC7Subset(px, candidate, subset, mask, e0, e1, quality);
+		if (candidateError >= error)
+			break;
+		block = candidate;
+		error = candidateError;
+	}
+
+	return error;
+}
+
+// Sums of the color channels and their products, enough to tell how well any subset of the pixels fits a line
+struct SMoments
+{
+	float n;
+	float sum[3];
+	float products[6]; // rr, rg, rb, gg, gb, bb
+};
+
+static void AddMoments(SMoments& moments, const float (*terms)[9], uint32_t i)
+{
+	moments.n += 1.0f;
+	for (uint32_t k = 0; k < 3; ++k)
+		moments.sum[k] += terms[i][k];
+	for (uint32_t k = 0; k < 6; ++k)
+		moments.products[k] += terms[i][3 + k];
+}
+
+// The variance left over after the principal axis, how far the pixels are from a line
+static float EstimateLineError(const SMoments& moments)
+{
+	if (moments.n <= 1.0f)
+		return 0.0f;
+
+	const float* s = moments.sum;
+	const float inverse = 1.0f / moments.n;
+	const float cov[3][3] = {
+		{ moments.products[0] - s[0] * s[0] * inverse, moments.products[1] - s[0] * s[1] * inverse, moments.products[2] - s[0] * s[2] * inverse },
+		{ moments.products[1] - s[0] * s[1] * inverse, moments.products[3] - s[1] * s[1] * inverse, moments.products[4] - s[1] * s[2] * inverse },
+		{ moments.products[2] - s[0] * s[2] * inverse, moments.products[4] - s[1] * s[2] * inverse, moments.products[5] - s[2] * s[2] * inverse } };
+
+	// two steps of power iteration from the widest column, then the rayleigh quotient gives the largest eigenvalue closely enough
+	uint32_t widest = cov[1][1] > cov[0][0] ? 1 : 0;
+	widest = cov[2][2] > cov[widest][widest] ? 2 : widest;
+	float axis[3] = { cov[0][widest], cov[1][widest], cov[2][widest] };
+	const float trace = cov[0][0] + cov[1][1] + cov[2][2];
+	if (trace < 1e-6f)
+		return 0.0f;
+	const float scale = 1.0f / trace; // keeps the products in float range
+	for (uint32_t iteration = 0; iteration < 2; ++iteration)
+	{
+		float next[3];
+		for (uint32_t a = 0; a < 3; ++a)
+			next[a] = (cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2]) * scale;
+		memcpy(axis, next, sizeof(axis));
+	}
+
+	float projected[3];
+	for (uint32_t a = 0; a < 3; ++a)
+		projected[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+	const float length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	const float largest = length > 1e-12f ? (axis[0] * projected[0] + axis[1] * projected[1] + axis[2] * projected[2]) / length : 0.0f;
+
+	return std::max(trace - largest, 0.0f);
+}
+
+// Mode 5 in one part, the color line at 7 bits or the alpha line at 8 bits, each with 2 bit indices. Returns the squared error.
+static float EncodeBC7Mode5Part(const SPixels& px, uint32_t channels, uint32_t bits, uint32_t quality, uint8_t q[2][4], uint8_t* indices)
+{
+	const float levels = static_cast<float>((1 << bits) - 1);
+	float e0[4], e1[4];
+	FitLine(px, 0xFFFF, channels, e0, e1);
+
+	float best = FLT_MAX;
+	const uint32_t iterations = quality == 0 ? 0 : (quality == 1 ? 1 : (quality == 2 ? 3 : 8));
+	for (uint32_t iteration = 0; iteration <= iterations; ++iteration)
+	{
+		uint8_t candidate[2][4] = {};
+		float palette[4][4] = {};
+		uint32_t e[2][4] = {};
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			const float* end = j == 0 ? e0 : e1;
+			for (uint32_t c = 0; c < channels; ++c)
+			{
+				candidate[j][c] = static_cast<uint8_t>(Clamp(static_cast<int32_t>(end[c] * levels / 255.0f + 0.5f), 0, static_cast<int32_t>(levels)));
+				e[j][c] = bits == 8 ? candidate[j][c] : ((candidate[j][c] << 1) | (candidate[j][c] >> 6));
+			}
+		}
+		for (uint32_t k = 0; k < 4; ++k)
+			for (uint32_t c = 0; c < channels; ++c)
+				palette[k][c] = static_cast<float>(((64 - BC7_WEIGHTS2[k]) * e[0][c] + BC7_WEIGHTS2[k] * e[1][c] + 32) >> 6);
+
+		uint8_t found[16];
+		float errors[16];
+		FindIndices(px, palette, 4, found, errors);
+		const float error = SumErrors(errors, 0xFFFF);
+		if (error >= best)
+			break;
+		best = error;
+		memcpy(q, candidate, sizeof(candidate));
+		memcpy(indices, found, 16);
+
+		float weights[16];
+		for (uint32_t i = 0; i < 16; ++i)
+			weights[i] = BC7_WEIGHTS2[found[i]] / 64.0f;
+		if (error == 0.0f || !SolveEndpoints(px, 0xFFFF, channels, weights, e0, e1))
+			break;
+	}
+	return best;
+}
+
+// Mode 5 for blocks with alpha, which rarely sits on the same line as the color
+static float EncodeBC7Mode5(const SPixels& px, uint32_t quality, SBC7& block)
+{
+	SPixels color = px, alpha = {};
+	memset(color.c[3], 0, sizeof(color.c[3]));
+	memcpy(alpha.c[0], px.c[3], sizeof(alpha.c[0]));
+
+	uint8_t q[2][4];
+	block.mode = 5;
+	float error = EncodeBC7Mode5Part(color, 3, 7, quality, q, block.indices);
+	for (uint32_t j = 0; j < 2; ++j)
+		memcpy(block.q[0][j], q[j], 3);
+	error += EncodeBC7Mode5Part(alpha, 1, 8, quality, q, block.alphaIndices);
+	for (uint32_t j = 0; j < 2; ++j)
+		block.q[0][j][3] = q[j][0];
+	return error;
+}
+
+static void PackBC7(SBC7 block, uint8_t* out)
+{
+	memset(out, 0, 16);
+	SBitWriter writer = { out, 0 };
+
+	if (block.mode == 6)
+	{
+		// the anchor's index is written without its top bit, so that bit has to be 0
+		if (block.indices[0] & 8)
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+				std::swap(block.q[0][0][c], block.q[0][1][c]);
+			std::swap(block.p[0][0], block.p[0][1]);
+			for (uint32_t i = 0; i < 16; ++i)
+				block.indices[i] = static_cast<uint8_t>(15 - block.indices[i]);
+		}
+
+		writer.Write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; ++c)
+			for (uint32_t j = 0; j < 2; ++j)
+				writer.Write(block.q[0][j][c], 7);
+		writer.Write(block.p[0][0], 1);
+		writer.Write(block.p[0][1], 1);
+		for (uint32_t i = 0; i < 16; ++i)
+			writer.Write(block.indices[i], i == 0 ? 3 : 4);
+		return;
+	}
+
+	if (block.mode == 5)
+	{
+		// color and alpha each have their anchor at pixel 0
+		if (block.indices[0] & 2)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				std::swap(block.q[0][0][c], block.q[0][1][c]);
+			for (uint32_t i = 0; i < 16; ++i)
+				block.indices[i] = static_cast<uint8_t>(3 - block.indices[i]);
+		}
+		if (block.alphaIndices[0] & 2)
+		{
+			std::swap(block.q[0][0][3], block.q[0][1][3]);
+			for (uint32_t i = 0; i < 16; ++i)
+				block.alphaIndices[i] = static_cast<uint8_t>(3 - block.alphaIndices[i]);
+		}
+
+		writer.Write(1 << 5, 6);
+		writer.Write(0, 2); // no channel rotation
+		for (uint32_t c = 0; c < 3; ++c)
+			for (uint32_t j = 0; j < 2; ++j)
+				writer.Write(block.q[0][j][c], 7);
+		for (uint32_t j = 0; j < 2; ++j)
+			writer.Write(block.q[0][j][3], 8);
+		for (uint32_t i = 0; i < 16; ++i)
+			writer.Write(block.indices[i], i == 0 ? 1 : 2);
+		for (uint32_t i = 0; i < 16; ++i)
+			writer.Write(block.alphaIndices[i], i == 0 ? 1 : 2);
+		return;
+	}
+
+	const uint16_t partition = BC7_PARTITIONS[block.partition];
+	const uint32_t anchors[2] = { 0, BC7_ANCHORS[block.partition] };
+	for (uint32_t s = 0; s < 2; ++s)
+	{
+		if (!(block.indices[anchors[s]] & 4))
+			continue;
+		for (uint32_t c = 0; c < 3; ++c)
+			std::swap(block.q[s][0][c], block.q[s][1][c]);
+		for (uint32_t i = 0; i < 16; ++i)
+			if (((partition >> i) & 1) == s)
+				block.indices[i] = static_cast<uint8_t>(7 - block.indices[i]);
+	}
+
+	writer.Write(1 << 1, 2);
+	writer.Write(block.partition, 6);
+	for (uint32_t c = 0; c < 3; ++c)
+		for (uint32_t s = 0; s < 2; ++s)
+			for (uint32_t j = 0; j < 2; ++j)
+				writer.Write(block.q[s][j][c], 6);
+	writer.Write(block.p[0][0], 1);
+	writer.Write(block.p[1][0], 1);
+	for (uint32_t i = 0; i < 16; ++i)
+		writer.Write(block.indices[i], i == anchors[0] || i == anchors[1] ? 2 : 3);
+}
+
+static float EncodeBC7(const SPixels& px, uint32_t quality, uint8_t* out)
+{
+	SBC7 best = {};
+	best.mode = 6;
+	best.error = EncodeBC7Subset(px, best, 0, 0xFFFF, quality);
+
+	bool opaque = true;
+	for (uint32_t i = 0; i < 16 && opaque; ++i)
+		opaque = px.c[3][i] == 255.0f;
+
+	if (!opaque && best.error > 0.0f)
+	{
+		SBC7 candidate = {};
+		candidate.error = EncodeBC7Mode5(px, quality, candidate);
+		if (candidate.error < best.error)
+			best = candidate;
+	}
+
+	// mode 1 for opaque blocks, only on the partitions whose halves sit closest to a line each
+	if (quality >= 2 && opaque && best.error > 0.0f)
+	{
+		// the per pixel terms once, each partition then only walks the set bits of its second subset
+		float terms[16][9];
+		SMoments all = {};
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			const float r = px.c[0][i], g = px.c[1][i], b = px.c[2][i];
+			const float values[9] = { r, g, b, r * r, r * g, r * b, g * g, g * b, b * b };
+			memcpy(terms[i], values, sizeof(values));
+			AddMoments(all, terms, i);
+		}
+
+		float estimates[64];
+		uint32_t order[64];
+		for (uint32_t p = 0; p < 64; ++p)
+		{
+			SMoments one = {};
+			for (uint32_t bits = BC7_PARTITIONS[p]; bits; bits &= bits - 1)
+				AddMoments(one, terms, FirstBit(bits));
+
+			SMoments zero = all;
+			zero.n -= one.n;
+			for (uint32_t c = 0; c < 3; ++c)
+				zero.sum[c] -= one.sum[c];
+			for (uint32_t c = 0; c < 6; ++c)
+				zero.products[c] -= one.products[c];
+
+			estimates[p] = EstimateLineError(zero) + EstimateLineError(one);
+			order[p] = p;
+		}
+
+		const uint32_t tries = quality == 2 ? 2 : 16;
+		std::partial_sort(order, order + tries, order + 64, [&](uint32_t a, uint32_t b) { return estimates[a] < estimates[b] || (estimates[a] == estimates[b] && a < b); });
+
+		for (uint32_t t = 0; t < tries; ++t)
+		{
+			SBC7 candidate = {};
+			candidate.mode = 1;
+			candidate.partition = order[t];
+			const uint16_t mask = BC7_PARTITIONS[order[t]];
+			candidate.error = EncodeBC7Subset(px, candidate, 0, static_cast<uint16_t>(~mask), quality);
+			if (candidate.error >= best.error)
+				continue;
+			candidate.error += EncodeBC7Subset(px, candidate, 1, mask, quality);
+			if (candidate.error < best.error)
+				best = candidate;
+		}
+	}
+
+	PackBC7(best, out);
+	return best.error;
+}
+
+// Decoding, only what the encoders write, for the error of what came out
+
+static void DecodeBC1(const uint8_t* in, uint8_t rgba[16][4])
+{
+	const uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8)), c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+	int32_t a[3], b[3];
+	Expand565(c0, a);
+	Expand565(c1, b);
+
+	uint8_t palette[4][4];
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		palette[0][c] = static_cast<uint8_t>(a[c]);
+		palette[1][c] = static_cast<uint8_t>(b[c]);
+		palette[2][c] = static_cast<uint8_t>(c0 > c1 ? (2 * a[c] + b[c]) / 3 : (a[c] + b[c]) / 2);
+		palette[3][c] = static_cast<uint8_t>(c0 > c1 ? (a[c] + 2 * b[c]) / 3 : 0);
+	}
+	for (uint32_t k = 0; k < 4; ++k)
+		palette[k][3] = 255;
+
+	for (uint32_t i = 0; i < 16; ++i)
+		memcpy(rgba[i], palette[(in[4 + i / 4] >> ((i % 4) * 2)) & 3], 4);
+}
+
+static void DecodeBC4(const uint8_t* in, uint8_t rgba[16][4], uint32_t channel)
+{
+	float palette[8][4];
+	BC4Palette(in[0], in[1], palette);
+
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 6; ++i)
+		bits |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+	for (uint32_t i = 0; i < 16; ++i)
+		rgba[i][channel] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7][0]);
+}
+
+static bool DecodeBC7(const uint8_t* in, uint8_t rgba[16][4])
+{
+	SBitReader reader = { in, 0 };
+	uint32_t mode = 0;
+	while (mode < 8 && !reader.Read(1))
+		++mode;
+
+	SBC7 block = {};
+	block.mode = mode;
+	if (mode == 6)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			for (uint32_t j = 0; j < 2; ++j)
+				block.q[0][j][c] = static_cast<uint8_t>(reader.Read(7));
+		block.p[0][0] = static_cast<uint8_t>(reader.Read(1));
+		block.p[0][1] = static_cast<uint8_t>(reader.Read(1));
+		for (uint32_t i = 0; i < 16; ++i)
+			block.indices[i] = static_cast<uint8_t>(reader.Read(i == 0 ? 3 : 4));
+
+		float palette[16][4];
+		BC7Palette(block, 0, palette);
+		for (uint32_t i = 0; i < 16; ++i)
+			for (uint32_t c = 0; c < 4; ++c)
+				rgba[i][c] = static_cast<uint8_t>(palette[block.indices[i]][c]);
+		return true;
+	}
+
+	if (mode == 5)
+	{
+		const uint32_t rotation = reader.Read(2);
+		uint32_t e[2][4];
+		for (uint32_t c = 0; c < 3; ++c)
+			for (uint32_t j = 0; j < 2; ++j)
+			{
+				const uint32_t v = reader.Read(7);
+				e[j][c] = (v << 1) | (v >> 6);
+			}
+		for (uint32_t j = 0; j < 2; ++j)
+			e[j][3] = reader.Read(8);
+		for (uint32_t i = 0; i < 16; ++i)
+			block.indices[i] = static_cast<uint8_t>(reader.Read(i == 0 ? 1 : 2));
+		for (uint32_t i = 0; i < 16; ++i)
+			block.alphaIndices[i] = static_cast<uint8_t>(reader.Read(i == 0 ? 1 : 2));
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const uint32_t w = BC7_WEIGHTS2[c == 3 ? block.alphaIndices[i] : block.indices[i]];
+				rgba[i][c] = static_cast<uint8_t>(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+			}
+			if (rotation)
+				std::swap(rgba[i][rotation - 1], rgba[i][3]);
+		}
+		return true;
+	}
+
+	if (mode == 1)
+	{
+		block.partition = reader.Read(6);
+		for (uint32_t c = 0; c < 3; ++c)
+			for (uint32_t s = 0; s < 2; ++s)
+				for (uint32_t j = 0; j < 2; ++j)
+					block.q[s][j][c] = static_cast<uint8_t>(reader.Read(6));
+		block.p[0][0] = static_cast<uint8_t>(reader.Read(1));
+		block.p[1][0] = static_cast<uint8_t>(reader.Read(1));
+		const uint32_t anchor = BC7_ANCHORS[block.partition];
+		for (uint32_t i = 0; i < 16; ++i)
+			block.indices[i] = static_cast<uint8_t>(reader.Read(i == 0 || i == anchor ? 2 : 3));
+
+		float palettes[2][16][4];
+		BC7Palette(block, 0, palettes[0]);
+		BC7Palette(block, 1, palettes[1]);
+		for (uint32_t i = 0; i < 16; ++i)
+			for (uint32_t c = 0; c < 4; ++c)
+				rgba[i][c] = static_cast<uint8_t>(palettes[(BC7_PARTITIONS[block.partition] >> i) & 1][block.indices[i]][c]);
+		return true;
+	}
+
+	return false;
+}
+
+static void DecodeBlock(EGLTF::EGLTFBlockFormat format, const uint8_t* in, uint8_t rgba[16][4])
+{
+	memset(rgba, 0, 16 * 4);
+	switch (format)
+	{
+	case EGLTF::EGLTFBlockFormat::BC1:
+		DecodeBC1(in, rgba);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC3:
+		DecodeBC1(in + 8, rgba);
+		DecodeBC4(in, rgba, 3);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC4:
+		DecodeBC4(in, rgba, 0);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC5:
+		DecodeBC4(in, rgba, 0);
+		DecodeBC4(in + 8, rgba, 1);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC7:
+		DecodeBC7(in, rgba);
+		break;
+	}
+}
+
+static uint32_t GetChannelCount(EGLTF::EGLTFBlockFormat format)
+{
+	switch (format)
+	{
+	case EGLTF::EGLTFBlockFormat::BC1: return 3;
+	case EGLTF::EGLTFBlockFormat::BC4: return 1;
+	case EGLTF::EGLTFBlockFormat::BC5: return 2;
+	default: return 4;
+	}
+}
+
+// Compresses block (x, y) of a level, pixels past the edge repeat the last row and column
+static void CompressBlock(const EGLTF::SGLTFBitmap& level, uint32_t x, uint32_t y, EGLTF::EGLTFBlockFormat format, uint32_t quality, uint8_t* out)
+{
+	uint8_t rgba[16][4];
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t px = std::min(x * 4 + i % 4, level.width - 1), py = std::min(y * 4 + i / 4, level.height - 1);
+		memcpy(rgba[i], &level.rgba[(size_t(py) * level.width + px) * 4], 4);
+	}
+
+	// the channels of every part of the block in c[0] up, the rest 0
+	auto gather = [&](SPixels& pixels, uint32_t first, uint32_t count)
+	{
+		memset(&pixels, 0, sizeof(pixels));
+		for (uint32_t c = 0; c < count; ++c)
+			for (uint32_t i = 0; i < 16; ++i)
+				pixels.c[c][i] = rgba[i][first + c];
+	};
+
+	SPixels pixels;
+	switch (format)
+	{
+	case EGLTF::EGLTFBlockFormat::BC1:
+		gather(pixels, 0, 3);
+		EncodeBC1(pixels, quality, out);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC3:
+		gather(pixels, 3, 1);
+		EncodeBC4(pixels, quality, out);
+		gather(pixels, 0, 3);
+		EncodeBC1(pixels, quality, out + 8);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC4:
+		gather(pixels, 0, 1);
+		EncodeBC4(pixels, quality, out);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC5:
+		gather(pixels, 0, 1);
+		EncodeBC4(pixels, quality, out);
+		gather(pixels, 1, 1);
+		EncodeBC4(pixels, quality, out + 8);
+		break;
+	case EGLTF::EGLTFBlockFormat::BC7:
+		gather(pixels, 0, 4);
+		EncodeBC7(pixels, quality, out);
+		break;
+	}
+}
+
+// Mips
+
+namespace
+{
+	enum class EMipFilter
+	{
+		LINEAR,
+		SRGB, // color channels averaged in linear light
+		NORMAL // xyz in RGB averaged as vectors and renormalized
+	};
+
+	struct SSrgbTables
+	{
+		float toLinear[256];
+		uint8_t fromLinear[4096];
+
+		SSrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				const float v = i / 255.0f;
+				toLinear[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < 4096; ++i)
+			{
+				const float v = i / 4095.0f;
+				const float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = static_cast<uint8_t>(Clamp(static_cast<int32_t>(s * 255.0f + 0.5f), 0, 255));
+			}
+		}
+	};
+}
+
+static void Downsample(const EGLTF::SGLTFBitmap& above, EGLTF::SGLTFBitmap& below, EMipFilter filter)
+{
+	static const SSrgbTables tables;
+
+	below.width = std::max(above.width / 2, 1u);
+	below.height = std::max(above.height / 2, 1u);
+	below.rgba.resize(size_t(below.width) * below.height * 4);
+
+	for (uint32_t y = 0; y < below.height; ++y)
+	{
+		const uint32_t y0 = std::min(y * 2, above.height - 1), y1 = std::min(y * 2 + 1, above.height - 1);
+		for (uint32_t x = 0; x < below.width; ++x)
+		{
+			const uint32_t x0 = std::min(x * 2, above.width - 1), x1 = std::min(x * 2 + 1, above.width - 1);
+			const uint8_t* texels[4] = { &above.rgba[(size_t(y0) * above.width + x0) * 4], &above.rgba[(size_t(y0) * above.width + x1) * 4],
+				&above.rgba[(size_t(y1) * above.width + x0) * 4], &above.rgba[(size_t(y1) * above.width + x1) * 4] };
+			uint8_t* out = &below.rgba[(size_t(y) * below.width + x) * 4];
+
+			out[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+			if (filter == EMipFilter::LINEAR)
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+					out[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+			}
+			else if (filter == EMipFilter::SRGB)
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					const float sum = tables.toLinear[texels[0][c]] + tables.toLinear[texels[1][c]] + tables.toLinear[texels[2][c]] + tables.toLinear[texels[3][c]];
+					out[c] = tables.fromLinear[static_cast<uint32_t>(sum * 0.25f * 4095.0f + 0.5f)];
+				}
+			}
+			else
+			{
+				float n[3] = { 0.0f, 0.0f, 0.0f };
+				for (uint32_t t = 0; t < 4; ++t)
+					for (uint32_t c = 0; c < 3; ++c)
+						n[c] += texels[t][c] / 127.5f - 1.0f;
+				const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					const float v = length > 1e-6f ? n[c] / length : (c == 2 ? 1.0f : 0.0f);
+					out[c] = static_cast<uint8_t>(Clamp(static_cast<int32_t>((v + 1.0f) * 127.5f + 0.5f), 0, 255));
+				}
+			}
+		}
+	}
+}
+
+uint32_t EGLTF::GetGLTFBlockBytes(EGLTFBlockFormat format)
+{
+	return format == EGLTFBlockFormat::BC1 || format == EGLTFBlockFormat::BC4 ? 8 : 16;
+}
+
+bool EGLTF::CompressGLTFBitmap(const SGLTFBitmap& bitmap, EGLTFBlockFormat format, bool srgb, SGLTFBlockImage& out, const SGLTFBlockOptions& options, CGLTFThreadPool* pool)
+{
+	out.format = format;
+	out.srgb = srgb;
+	out.levels.clear();
+	out.psnr = 0.0;
+
+	if (bitmap.width == 0 || bitmap.height == 0 || bitmap.rgba.size() != size_t(bitmap.width) * bitmap.height * 4)
+	{
+		fprintf(stderr, "\nError: bitmap to compress is empty or its size does not match\n");
+		return false;
+	}
+
+	// BC5 holds normal maps, anything else linear is data that averages as it is
+	const EMipFilter filter = srgb ? EMipFilter::SRGB : (format == EGLTFBlockFormat::BC5 ? EMipFilter::NORMAL : EMipFilter::LINEAR);
+	std::vector<SGLTFBitmap> mips;
+	if (options.mipmaps)
+	{
+		for (uint32_t w = bitmap.width, h = bitmap.height; w > 1 || h > 1; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+			mips.emplace_back();
+		for (size_t m = 0; m < mips.size(); ++m)
+			Downsample(m == 0 ? bitmap : mips[m - 1], mips[m], filter);
+	}
+
+	std::vector<const SGLTFBitmap*> levels(1, &bitmap);
+	for (const SGLTFBitmap& mip : mips)
+		levels.push_back(&mip);
+
+	// every row of blocks of every level is a job
+	struct SRow
+	{
+		uint32_t level;
+		uint32_t y;
+	};
+	std::vector<SRow> rows;
+	const uint32_t blockBytes = GetGLTFBlockBytes(format);
+	out.levels.resize(levels.size());
+	for (size_t l = 0; l < levels.size(); ++l)
+	{
+		SGLTFBlockLevel& level = out.levels[l];
+		level.width = levels[l]->width;
+		level.height = levels[l]->height;
+		const uint32_t blocksHigh = (level.height + 3) / 4;
+		level.blocks.resize(size_t((level.width + 3) / 4) * blocksHigh * blockBytes);
+		for (uint32_t y = 0; y < blocksHigh; ++y)
+		{
+			const SRow row = { static_cast<uint32_t>(l), y };
+			rows.push_back(row);
+		}
+	}
+
+	// squared error per row of the first level, summed in order afterwards so the result does not depend on the pool
+	const uint32_t channels = GetChannelCount(format);
+	std::vector<double> rowErrors((bitmap.height + 3) / 4, 0.0);
+
+	auto compress = [&](size_t begin, size_t end)
+	{
+		for (size_t r = begin; r < end; ++r)
+		{
+			const SGLTFBitmap& source = *levels[rows[r].level];
+			SGLTFBlockLevel& level = out.levels[rows[r].level];
+			const uint32_t y = rows[r].y;
+			const uint32_t blocksWide = (level.width + 3) / 4;
+			for (uint32_t x = 0; x < blocksWide; ++x)
+			{
+				uint8_t* block = &level.blocks[(size_t(y) * blocksWide + x) * blockBytes];
+				CompressBlock(source, x, y, format, options.quality, block);
+				if (rows[r].level != 0)
+					continue;
+
+				uint8_t decoded[16][4];
+				DecodeBlock(format, block, decoded);
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					const uint32_t px = x * 4 + i % 4, py = y * 4 + i / 4;
+					if (px >= source.width || py >= source.height)
+						continue;
+					const uint8_t* original = &source.rgba[(size_t(py) * source.width + px) * 4];
+					for (uint32_t c = 0; c < channels; ++c)
+						rowErrors[y] += double(int32_t(decoded[i][c]) - original[c]) * double(int32_t(decoded[i][c]) - original[c]);
+				}
+			}
+		}
+	};
+
+	if (pool && rows.size() > 1)
+		pool->ParallelFor(rows.size(), 1, compress);
+	else
+		compress(0, rows.size());
+
+	double error = 0.0;
+	for (double rowError : rowErrors)
+		error += rowError;
+	const double mse = error / (double(bitmap.width) * bitmap.height * channels);
+	out.psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+	return true;
+}
+
+EGLTF::EGLTFBlockFormat EGLTF::GetGLTFImageBlockFormat(const SGLTFAsset& asset, int32_t image, const SGLTFBlockOptions& options, bool& srgb)
+{
+	auto uses = [&](int32_t texture)
+	{
+		return texture >= 0 && static_cast<size_t>(texture) < asset.textures.size() && asset.textures[texture].source == image;
+	};
+
+	bool color = false, normal = false, metallicRoughness = false, occlusion = false;
+	for (const auto& material : asset.materials)
+	{
+		color = color || uses(material.pbrMetallicRoughness.baseColorTexture.index) || uses(material.emissiveTexture.index);
+		normal = normal || uses(material.normalTexture.index);
+		metallicRoughness = metallicRoughness || uses(material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+		occlusion = occlusion || uses(material.occlusionTexture.index);
+	}
+
+	// anything that is looked at goes by the color rules, so do images no material uses
+	srgb = color || !(normal || metallicRoughness || occlusion);
+	if (srgb)
+		return options.colorFormat;
+	if (normal)
+		return EGLTFBlockFormat::BC5;
+	if (metallicRoughness)
+		return options.dataFormat;
+	return EGLTFBlockFormat::BC4;
+}
+
+bool EGLTF::CompressGLTFImages(const SGLTFAsset& asset, std::vector<SGLTFBlockImage>& out, SGLTFBlockStats& stats, const SGLTFBlockOptions& options, CGLTFThreadPool* pool)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	const size_t count = asset.images.size();
+	out.assign(count, SGLTFBlockImage());
+
+	auto compress = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			SGLTFBlockImage& image = out[i];
+			image.image = static_cast<int32_t>(i);
+
+			bool srgb = false;
+			EGLTFBlockFormat format = GetGLTFImageBlockFormat(asset, image.image, options, srgb);
+			image.format = format;
+			image.srgb = srgb;
+
+			SGLTFBitmap bitmap;
+			if (!DecodeGLTFImage(asset, image.image, bitmap))
+				continue;
+
+			if (format == EGLTFBlockFormat::BC1)
+			{
+				for (size_t t = 3; t < bitmap.rgba.size(); t += 4)
+				{
+					if (bitmap.rgba[t] != 255)
+					{
+						format = EGLTFBlockFormat::BC3;
+						break;
+					}
+				}
+			}
+
+			CompressGLTFBitmap(bitmap, format, srgb, image, options, pool);
+		}
+	};
+
+	// images on the pool as well, each one spreads its blocks over it too
+	if (pool && count > 1)
+		pool->ParallelFor(count, 1, compress);
+	else
+		compress(0, count);
+
+	stats = SGLTFBlockStats();
+	stats.minPsnr = std::numeric_limits<double>::infinity();
+	for (const SGLTFBlockImage& image : out)
+	{
+		if (image.levels.empty())
+		{
+			fprintf(stderr, "\nError: image %d could not be decoded for compression\n", image.image);
+			++stats.failed;
+			continue;
+		}
+
+		++stats.images;
+		stats.minPsnr = std::min(stats.minPsnr, image.psnr);
+		stats.averagePsnr += image.psnr;
+		for (const SGLTFBlockLevel& level : image.levels)
+		{
+			stats.texels += uint64_t(level.width) * level.height;
+			stats.blocks += level.blocks.size() / GetGLTFBlockBytes(image.format);
+			stats.bytesBefore += uint64_t(level.width) * level.height * 4;
+			stats.bytesAfter += level.blocks.size();
+		}
+	}
+	if (stats.images > 0)
+		stats.averagePsnr /= stats.images;
+	else
+		stats.minPsnr = 0.0;
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats.failed == 0;
+}
+
+void EGLTF::SGLTFBlockStats::Print(FILE* out) const
+{
+	fprintf(out, "\nBlock compression: %u images, %u failed, %llu blocks", images, failed, static_cast<unsigned long long>(blocks));
+	fprintf(out, "\nTexel data: %llu -> %llu bytes", static_cast<unsigned long long>(bytesBefore), static_cast<unsigned long long>(bytesAfter));
+	fprintf(out, "\nPSNR: %.2f dB lowest, %.2f dB average", minPsnr, averagePsnr);
+	fprintf(out, "\nTook %.3f s, %.2f Mtexels/s\n", seconds, GetMegatexelsPerSecond());
+}
+
+// KTX2
+
+static void PutU32(std::vector<uint8_t>& out, uint32_t value)
+{
+	for (uint32_t i = 0; i < 4; ++i)
+		out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+static void SetU32(std::vector<uint8_t>& out, size_t offset, uint32_t value)
+{
+	for (uint32_t i = 0; i < 4; ++i)
+		out[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+}
+
+static void SetU64(std::vector<uint8_t>& out, size_t offset, uint64_t value)
+{
+	for (uint32_t i = 0; i < 8; ++i)
+		out[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+}
+
+void EGLTF::EncodeGLTFKTX2(const SGLTFBlockImage& image, std::vector<uint8_t>& out)
+{
+	static const uint8_t IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	// vkFormat, data format descriptor color model and the channels of its samples
+	uint32_t vkFormat = 0, model = 0;
+	uint32_t sampleChannels[2] = { 0, 0 };
+	uint32_t sampleCount = 1;
+	bool srgb = image.srgb;
+	switch (image.format)
+	{
+	case EGLTFBlockFormat::BC1:
+		vkFormat = srgb ? 132 : 131; // VK_FORMAT_BC1_RGB_*_BLOCK
+		model = 128; // KHR_DF_MODEL_BC1A
+		break;
+	case EGLTFBlockFormat::BC3:
+		vkFormat = srgb ? 138 : 137;
+		model = 130;
+		sampleChannels[0] = 15; // alpha block first
+		sampleChannels[1] = 0;
+		sampleCount = 2;
+		break;
+	case EGLTFBlockFormat::BC4:
+		vkFormat = 139;
+		model = 131;
+		srgb = false;
+		break;
+	case EGLTFBlockFormat::BC5:
+		vkFormat = 141;
+		model = 132;
+		sampleChannels[1] = 1;
+		sampleCount = 2;
+		srgb = false;
+		break;
+	case EGLTFBlockFormat::BC7:
+		vkFormat = srgb ? 146 : 145;
+		model = 134;
+		break;
+	}
+
+	const uint32_t blockBytes = GetGLTFBlockBytes(image.format);
+	const uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+	const uint32_t width = levelCount ? image.levels[0].width : 0, height = levelCount ? image.levels[0].height : 0;
+
+	out.assign(IDENTIFIER, IDENTIFIER + 12);
+	PutU32(out, vkFormat);
+	PutU32(out, 1); // typeSize
+	PutU32(out, width);
+	PutU32(out, height);
+	PutU32(out, 0); // depth
+	PutU32(out, 0); // layers
+	PutU32(out, 1); // faces
+	PutU32(out, levelCount);
+	PutU32(out, 0); // no supercompression
+
+	const size_t indexOffset = out.size();
+	out.resize(out.size() + 4 * 4 + 8 * 2, 0); // dfd, kvd and sgd offsets and lengths, filled in below
+	const size_t levelIndex = out.size();
+	out.resize(out.size() + size_t(levelCount) * 24, 0);
+
+	// data format descriptor with one basic block
+	const size_t dfdOffset = out.size();
+	const uint32_t blockSize = 24 + 16 * sampleCount;
+	PutU32(out, 4 + blockSize);
+	PutU32(out, 0); // vendor Khronos, basic descriptor type
+	PutU32(out, 2 | (blockSize << 16)); // version 2
+	PutU32(out, model | (1 << 8) | ((srgb ? 2u : 1u) << 16)); // BT.709 primaries, sRGB or linear, straight alpha
+	PutU32(out, 3 | (3 << 8)); // 4x4 texel blocks
+	PutU32(out, blockBytes);
+	PutU32(out, 0);
+	for (uint32_t s = 0; s < sampleCount; ++s)
+	{
+		const uint32_t bits = sampleCount == 1 ? blockBytes * 8 : 64;
+		PutU32(out, (s * 64) | ((bits - 1) << 16) | (sampleChannels[s] << 24));
+		PutU32(out, 0); // sample position
+		PutU32(out, 0); // lower
+		PutU32(out, 0xFFFFFFFFu); // upper
+	}
+	const size_t dfdLength = out.size() - dfdOffset;
+
+	// key/value data, just the writer
+	const size_t kvdOffset = out.size();
+	static const char WRITER[] = "KTXwriter\0EasyGLTF";
+	PutU32(out, sizeof(WRITER));
+	out.insert(out.end(), WRITER, WRITER + sizeof(WRITER));
+	while (out.size() % 4)
+		out.push_back(0);
+	const size_t kvdLength = out.size() - kvdOffset;
+
+	SetU32(out, indexOffset, static_cast<uint32_t>(dfdOffset));
+	SetU32(out, indexOffset + 4, static_cast<uint32_t>(dfdLength));
+	SetU32(out, indexOffset + 8, static_cast<uint32_t>(kvdOffset));
+	SetU32(out, indexOffset + 12, static_cast<uint32_t>(kvdLength));
+
+	// smallest level first, each aligned to its block size
+	for (uint32_t l = levelCount; l-- > 0;)
+	{
+		while (out.size() % blockBytes)
+			out.push_back(0);
+		const std::vector<uint8_t>& blocks = image.levels[l].blocks;
+		SetU64(out, levelIndex + l * 24, out.size());
+		SetU64(out, levelIndex + l * 24 + 8, blocks.size());
+		SetU64(out, levelIndex + l * 24 + 16, blocks.size());
+		out.insert(out.end(), blocks.begin(), blocks.end());
+	}
+}
+
+bool EGLTF::WriteGLTFKTX2(const std::string& filepath, const SGLTFBlockImage& image)
+{
+	if (image.levels.empty())
+	{
+		fprintf(stderr, "\nError: image for %s has no blocks\n", filepath.c_str());
+		return false;
+	}
+
+	std::vector<uint8_t> ktx;
+	EncodeGLTFKTX2(image, ktx);
+
+	FILE* file = fopen(filepath.c_str(), "wb");
+	if (!file)
+	{
+		fprintf(stderr, "\nError: could not open %s for writing\n", filepath.c_str());
+		return false;
+	}
+	const bool written = fwrite(ktx.data(), 1, ktx.size(), file) == ktx.size();
+	fclose(file);
+
+	if (!written)
+		fprintf(stderr, "\nError: could not write %s\n", filepath.c_str());
+	return written;
+}
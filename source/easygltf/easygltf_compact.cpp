@@ -0,0 +1,145 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_compact.h"
+
+#include <map>
+#include <vector>
+
+std::array<float, 16> EGLTF::GetGLTFCompactNodeMatrix(const SGLTFCompact_Node& node)
+{
+	const float x = node.rotation[0];
+	const float y = node.rotation[1];
+	const float z = node.rotation[2];
+	const float w = node.rotation[3];
+
+	const float sx = node.scale[0];
+	const float sy = node.scale[1];
+	const float sz = node.scale[2];
+
+	std::array<float, 16> m;
+
+	m[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+	m[1] = (2.0f * (x * y + z * w)) * sx;
+	m[2] = (2.0f * (x * z - y * w)) * sx;
+	m[3] = 0.0f;
+
+	m[4] = (2.0f * (x * y - z * w)) * sy;
+	m[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+	m[6] = (2.0f * (y * z + x * w)) * sy;
+	m[7] = 0.0f;
+
+	m[8] = (2.0f * (x * z + y * w)) * sz;
+	m[9] = (2.0f * (y * z - x * w)) * sz;
+	m[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+	m[11] = 0.0f;
+
+	m[12] = node.translation[0];
+	m[13] = node.translation[1];
+	m[14] = node.translation[2];
+	m[15] = 1.0f;
+
+	return m;
+}
+
+std::string EGLTF::GetGLTFCompactNodeName(const SGLTFCompactAsset& asset, const SGLTFCompact_Node& node)
+{
+	if (node.name.count == 0)
+		return std::string();
+
+	return std::string(&asset.names[node.name.offset], node.name.count);
+}
+
+template<typename T>
+static uint64_t VectorBytes(const std::vector<T>& v)
+{
+	return v.capacity() * sizeof(T);
+}
+
+// Only what lives outside the std::string object
+static uint64_t StringBytes(const std::string& str)
+{
+	static const size_t smallStringCapacity = std::string().capacity();
+	return str.capacity() > smallStringCapacity ? str.capacity() + 1 : 0;
+}
+
+// Rough size of a red-black tree node on the common implementations
+static const uint64_t MAP_NODE_OVERHEAD = 32;
+
+static uint64_t AttributesBytes(const EGLTF::TGLTFAsset_Prop_Mesh_Primitive_Attributes& attributes)
+{
+	uint64_t bytes = 0;
+	for (const auto& attribute : attributes)
+		bytes += MAP_NODE_OVERHEAD + sizeof(attribute) + StringBytes(attribute.first);
+	return bytes;
+}
+
+EGLTF::SGLTFMemoryReport EGLTF::GetGLTFMemoryReport(const SGLTFAsset& asset, const SGLTFCompactAsset* compact)
+{
+	SGLTFMemoryReport report;
+
+	report.nodes += VectorBytes(asset.nodes);
+	for (const auto& node : asset.nodes)
+		report.nodes += VectorBytes(node.children) + StringBytes(node.name);
+
+	report.meshes += VectorBytes(asset.meshes);
+	for (const auto& mesh : asset.meshes)
+	{
+		report.meshes += StringBytes(mesh.name) + VectorBytes(mesh.primitives) + VectorBytes(mesh.weights);
+		for (const auto& primitive : mesh.primitives)
+		{
+			report.meshes += AttributesBytes(primitive.attributes) + VectorBytes(primitive.targets);
+			for (const auto& target : primitive.targets)
+				report.meshes += AttributesBytes(target);
+		}
+	}
+
+	report.accessors += VectorBytes(asset.accessors);
+	for (const auto& accessor : asset.accessors)
+		report.accessors += StringBytes(accessor.type) + VectorBytes(accessor.min) + VectorBytes(accessor.max);
+
+	report.materials += VectorBytes(asset.materials);
+	for (const auto& material : asset.materials)
+		report.materials += StringBytes(material.name);
+
+	report.animations += VectorBytes(asset.animations);
+	for (const auto& animation : asset.animations)
+		report.animations += StringBytes(animation.name) + VectorBytes(animation.channels) + VectorBytes(animation.samplers);
+
+	report.bufferData += VectorBytes(asset.buffers) + VectorBytes(asset.images);
+	for (const auto& buffer : asset.buffers)
+		report.bufferData += VectorBytes(buffer.data) + StringBytes(buffer.uri);
+	for (const auto& image : asset.images)
+		report.bufferData += VectorBytes(image.data) + StringBytes(image.uri) + StringBytes(image.mimeType);
+
+	report.other += VectorBytes(asset.scenes) + VectorBytes(asset.bufferViews) + VectorBytes(asset.textures) + VectorBytes(asset.cameras) +
+		VectorBytes(asset.skins) + VectorBytes(asset.samplers);
+	for (const auto& scene : asset.scenes)
+		report.other += VectorBytes(scene.nodes);
+	for (const auto& skin : asset.skins)
+		report.other += VectorBytes(skin.joints) + StringBytes(skin.name);
+
+	if (compact)
+	{
+		report.nodes += VectorBytes(compact->nodes) + VectorBytes(compact->children) + VectorBytes(compact->names);
+		report.accessors += VectorBytes(compact->accessorMin) + VectorBytes(compact->accessorMax) + VectorBytes(compact->bounds);
+		report.meshes += VectorBytes(compact->meshWeights) + VectorBytes(compact->weights);
+	}
+
+	report.total = report.nodes + report.meshes + report.accessors + report.materials + report.animations + report.bufferData + report.other;
+	return report;
+}
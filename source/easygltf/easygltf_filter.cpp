@@ -0,0 +1,538 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#include "easygltf_filter.h"
+#include "easygltf_loadscope.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Ranges closer than this get read as one, a few KB of unused bytes are cheaper than another syscall
+static const uint64_t GLTF_RANGE_MERGE_GAP = 64 * 1024;
+
+static const rapidjson::Value* GetSection(const rapidjson::Value& document, const char* name)
+{
+	auto iter = document.FindMember(name);
+	if (iter == document.MemberEnd() || !iter->value.IsArray())
+		return nullptr;
+	return &iter->value;
+}
+
+static int32_t GetIndex(const rapidjson::Value& v, const char* key)
+{
+	if (!v.IsObject())
+		return -1;
+
+	auto iter = v.FindMember(key);
+	return iter != v.MemberEnd() && iter->value.IsInt() ? iter->value.GetInt() : -1;
+}
+
+static int64_t GetOffset(const rapidjson::Value& v, const char* key)
+{
+	auto iter = v.FindMember(key);
+	return iter != v.MemberEnd() && iter->value.IsInt64() ? iter->value.GetInt64() : -1;
+}
+
+// Walks the references of the json from the roots outwards, every element is visited once
+class CGLTFSelector
+{
+public:
+	CGLTFSelector(const rapidjson::Value& document, const EGLTF::SGLTFLoadFilter& filter, EGLTF::SGLTFLoadSelection& selection)
+		: m_filter(filter), m_selection(selection)
+	{
+		m_scenes = GetSection(document, "scenes");
+		m_nodes = GetSection(document, "nodes");
+		m_meshes = GetSection(document, "meshes");
+		m_accessors = GetSection(document, "accessors");
+		m_bufferViews = GetSection(document, "bufferViews");
+		m_buffers = GetSection(document, "buffers");
+		m_materials = GetSection(document, "materials");
+		m_textures = GetSection(document, "textures");
+		m_samplers = GetSection(document, "samplers");
+		m_images = GetSection(document, "images");
+		m_skins = GetSection(document, "skins");
+		m_animations = GetSection(document, "animations");
+
+		Reset(m_selection.scenes, m_scenes);
+		Reset(m_selection.nodes, m_nodes);
+		Reset(m_selection.meshes, m_meshes);
+		Reset(m_selection.accessors, m_accessors);
+		Reset(m_selection.bufferViews, m_bufferViews);
+		Reset(m_selection.buffers, m_buffers);
+		Reset(m_selection.materials, m_materials);
+		Reset(m_selection.textures, m_textures);
+		Reset(m_selection.samplers, m_samplers);
+		Reset(m_selection.images, m_images);
+		Reset(m_selection.skins, m_skins);
+		Reset(m_selection.animations, m_animations);
+
+		m_content.assign(m_selection.nodes.size(), 0);
+	}
+
+	void Run(EGLTF::TGLTFBufferRanges& ranges)
+	{
+		const bool roots = !m_filter.scenes.empty() || !m_filter.sceneNames.empty() || !m_filter.nodes.empty() ||
+			!m_filter.nodeNames.empty() || !m_filter.meshes.empty() || !m_filter.meshNames.empty();
+
+		if (roots)
+		{
+			for (int32_t scene : m_filter.scenes)
+				Scene(scene);
+			for (int32_t scene : Named(m_scenes, m_filter.sceneNames))
+				Scene(scene);
+
+			for (int32_t node : m_filter.nodes)
+				m_pending.push_back(node);
+			for (int32_t node : Named(m_nodes, m_filter.nodeNames))
+				m_pending.push_back(node);
+
+			if (m_filter.loadMeshes)
+			{
+				for (int32_t mesh : m_filter.meshes)
+					Mesh(mesh);
+				for (int32_t mesh : Named(m_meshes, m_filter.meshNames))
+					Mesh(mesh);
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < m_selection.scenes.size(); ++i)
+				Scene(static_cast<int32_t>(i));
+			for (size_t i = 0; i < m_selection.nodes.size(); ++i)
+				m_pending.push_back(static_cast<int32_t>(i));
+			if (m_filter.loadMeshes)
+				for (size_t i = 0; i < m_selection.meshes.size(); ++i)
+					Mesh(static_cast<int32_t>(i));
+			if (m_filter.loadMaterials)
+				for (size_t i = 0; i < m_selection.materials.size(); ++i)
+					Material(static_cast<int32_t>(i));
+			if (m_filter.loadSkins)
+				for (size_t i = 0; i < m_selection.skins.size(); ++i)
+					Skin(static_cast<int32_t>(i));
+		}
+
+		// the nodes below the roots with everything on them
+		while (!m_pending.empty())
+		{
+			const int32_t node = m_pending.back();
+			m_pending.pop_back();
+
+			if (!InRange(m_content, node) || m_content[node])
+				continue;
+
+			m_content[node] = 1;
+			m_selection.nodes[node] = 1;
+
+			const rapidjson::Value& v = (*m_nodes)[node];
+			if (m_filter.loadMeshes)
+			{
+				Mesh(GetIndex(v, "mesh"));
+				Instancing(v);
+			}
+			if (m_filter.loadSkins)
+				Skin(GetIndex(v, "skin"));
+
+			auto children = v.FindMember("children");
+			if (children != v.MemberEnd() && children->value.IsArray())
+				for (const auto& child : children->value.GetArray())
+					if (child.IsInt())
+						m_pending.push_back(child.GetInt());
+		}
+
+		Ancestors();
+
+		if (m_filter.loadAnimations)
+			for (size_t i = 0; i < m_selection.animations.size(); ++i)
+				Animation(static_cast<int32_t>(i), !roots);
+
+		// images in a bufferView are the last thing that can pull in a view
+		for (size_t i = 0; i < m_selection.images.size(); ++i)
+			if (m_selection.images[i])
+				BufferView(GetIndex((*m_images)[i], "bufferView"));
+
+		Ranges(ranges);
+	}
+
+private:
+	static void Reset(std::vector<uint8_t>& mask, const rapidjson::Value* section)
+	{
+		mask.assign(section ? section->Size() : 0, 0);
+	}
+
+	static bool InRange(const std::vector<uint8_t>& mask, int32_t index)
+	{
+		return index >= 0 && static_cast<size_t>(index) < mask.size();
+	}
+
+	// Marks an element, false if it already was or does not exist
+	static bool Mark(std::vector<uint8_t>& mask, int32_t index)
+	{
+		if (!InRange(mask, index) || mask[index])
+			return false;
+
+		mask[index] = 1;
+		return true;
+	}
+
+	static std::vector<int32_t> Named(const rapidjson::Value* section, const std::vector<std::string>& names)
+	{
+		std::vector<int32_t> indices;
+		if (!section || names.empty())
+			return indices;
+
+		for (rapidjson::SizeType i = 0; i < section->Size(); ++i)
+		{
+			const rapidjson::Value& v = (*section)[i];
+			auto name = v.IsObject() ? v.FindMember("name") : v.MemberEnd();
+			if (v.IsObject() && name != v.MemberEnd() && name->value.IsString() &&
+				std::find(names.begin(), names.end(), name->value.GetString()) != names.end())
+				indices.push_back(static_cast<int32_t>(i));
+		}
+		return indices;
+	}
+
+	void Scene(int32_t scene)
+	{
+		if (!Mark(m_selection.scenes, scene))
+			return;
+
+		const rapidjson::Value& v = (*m_scenes)[scene];
+		auto nodes = v.FindMember("nodes");
+		if (nodes != v.MemberEnd() && nodes->value.IsArray())
+			for (const auto& node : nodes->value.GetArray())
+				if (node.IsInt())
+					m_pending.push_back(node.GetInt());
+	}
+
+	void Attributes(const rapidjson::Value& attributes)
+	{
+		if (!attributes.IsObject())
+			return;
+
+		for (auto iter = attributes.MemberBegin(); iter != attributes.MemberEnd(); ++iter)
+			if (iter->value.IsInt())
+				Accessor(iter->value.GetInt());
+	}
+
+	void Mesh(int32_t mesh)
+	{
+		if (!Mark(m_selection.meshes, mesh))
+			return;
+
+		const rapidjson::Value& v = (*m_meshes)[mesh];
+		auto primitives = v.FindMember("primitives");
+		if (primitives == v.MemberEnd() || !primitives->value.IsArray())
+			return;
+
+		for (const auto& primitive : primitives->value.GetArray())
+		{
+			if (!primitive.IsObject())
+				continue;
+
+			Accessor(GetIndex(primitive, "indices"));
+			if (m_filter.loadMaterials)
+				Material(GetIndex(primitive, "material"));
+
+			auto attributes = primitive.FindMember("attributes");
+			if (attributes != primitive.MemberEnd())
+				Attributes(attributes->value);
+
+			auto targets = primitive.FindMember("targets");
+			if (targets != primitive.MemberEnd() && targets->value.IsArray())
+				for (const auto& target : targets->value.GetArray())
+					Attributes(target);
+		}
+	}
+
+	// EXT_mesh_gpu_instancing
+	void Instancing(const rapidjson::Value& node)
+	{
+		auto extensions = node.FindMember("extensions");
+		if (extensions == node.MemberEnd() || !extensions->value.IsObject())
+			return;
+
+		auto instancing = extensions->value.FindMember("EXT_mesh_gpu_instancing");
+		if (instancing == extensions->value.MemberEnd() || !instancing->value.IsObject())
+			return;
+
+		auto attributes = instancing->value.FindMember("attributes");
+		if (attributes != instancing->value.MemberEnd())
+			Attributes(attributes->value);
+	}
+
+	void Material(int32_t material)
+	{
+		if (!Mark(m_selection.materials, material))
+			return;
+
+		const rapidjson::Value& v = (*m_materials)[material];
+		auto texture = [&](const rapidjson::Value& parent, const char* key)
+		{
+			auto iter = parent.FindMember(key);
+			if (iter != parent.MemberEnd())
+				Texture(GetIndex(iter->value, "index"));
+		};
+
+		auto pbr = v.FindMember("pbrMetallicRoughness");
+		if (pbr != v.MemberEnd() && pbr->value.IsObject())
+		{
+			texture(pbr->value, "baseColorTexture");
+			texture(pbr->value, "metallicRoughnessTexture");
+		}
+		texture(v, "normalTexture");
+		texture(v, "occlusionTexture");
+		texture(v, "emissiveTexture");
+	}
+
+	void Texture(int32_t texture)
+	{
+		if (!Mark(m_selection.textures, texture))
+			return;
+
+		const rapidjson::Value& v = (*m_textures)[texture];
+		Mark(m_selection.samplers, GetIndex(v, "sampler"));
+		if (m_filter.loadImages)
+			Mark(m_selection.images, GetIndex(v, "source"));
+	}
+
+	void Skin(int32_t skin)
+	{
+		if (!Mark(m_selection.skins, skin))
+			return;
+
+		const rapidjson::Value& v = (*m_skins)[skin];
+		Accessor(GetIndex(v, "inverseBindMatrices"));
+		Mark(m_selection.nodes, GetIndex(v, "skeleton"));
+
+		auto joints = v.FindMember("joints");
+		if (joints != v.MemberEnd() && joints->value.IsArray())
+			for (const auto& joint : joints->value.GetArray())
+				if (joint.IsInt())
+					Mark(m_selection.nodes, joint.GetInt());
+	}
+
+	// Parents of everything selected so far, for the transforms
+	void Ancestors()
+	{
+		const size_t count = m_selection.nodes.size();
+		std::vector<int32_t> parents(count, -1);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const rapidjson::Value& v = (*m_nodes)[static_cast<rapidjson::SizeType>(i)];
+			auto children = v.IsObject() ? v.FindMember("children") : v.MemberEnd();
+			if (!v.IsObject() || children == v.MemberEnd() || !children->value.IsArray())
+				continue;
+
+			for (const auto& child : children->value.GetArray())
+				if (child.IsInt() && InRange(m_selection.nodes, child.GetInt()) && parents[child.GetInt()] == -1)
+					parents[child.GetInt()] = static_cast<int32_t>(i);
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!m_selection.nodes[i])
+				continue;
+
+			// stops at the first one that is in already, which has its own ancestors in as well. Also ends cycles.
+			int32_t parent = parents[i];
+			while (parent != -1 && Mark(m_selection.nodes, parent))
+				parent = parents[parent];
+		}
+	}
+
+	void Animation(int32_t animation, bool all)
+	{
+		const rapidjson::Value& v = (*m_animations)[animation];
+		auto channels = v.FindMember("channels");
+		auto samplers = v.FindMember("samplers");
+		if (channels == v.MemberEnd() || !channels->value.IsArray() || samplers == v.MemberEnd() || !samplers->value.IsArray())
+			return;
+
+		bool used = all;
+		for (const auto& channel : channels->value.GetArray())
+		{
+			auto target = channel.IsObject() ? channel.FindMember("target") : channel.MemberEnd();
+			if (channel.IsObject() && target != channel.MemberEnd())
+			{
+				const int32_t node = GetIndex(target->value, "node");
+				used |= InRange(m_selection.nodes, node) && m_selection.nodes[node];
+			}
+		}
+
+		if (!used)
+			return;
+
+		m_selection.animations[animation] = 1;
+		for (const auto& sampler : samplers->value.GetArray())
+		{
+			Accessor(GetIndex(sampler, "input"));
+			Accessor(GetIndex(sampler, "output"));
+		}
+	}
+
+	void Accessor(int32_t accessor)
+	{
+		if (!Mark(m_selection.accessors, accessor))
+			return;
+
+		const rapidjson::Value& v = (*m_accessors)[accessor];
+		BufferView(GetIndex(v, "bufferView"));
+
+		auto sparse = v.FindMember("sparse");
+		if (sparse != v.MemberEnd() && sparse->value.IsObject())
+		{
+			auto indices = sparse->value.FindMember("indices");
+			auto values = sparse->value.FindMember("values");
+			if (indices != sparse->value.MemberEnd())
+				BufferView(GetIndex(indices->value, "bufferView"));
+			if (values != sparse->value.MemberEnd())
+				BufferView(GetIndex(values->value, "bufferView"));
+		}
+	}
+
+	void BufferView(int32_t view)
+	{
+		if (Mark(m_selection.bufferViews, view))
+			Mark(m_selection.buffers, GetIndex((*m_bufferViews)[view], "buffer"));
+	}
+
+	// The bytes of every external buffer the selected views cover
+	void Ranges(EGLTF::TGLTFBufferRanges& ranges)
+	{
+		ranges.assign(m_selection.buffers.size(), std::vector<EGLTF::SGLTFFileRange>());
+		if (!m_filter.rangedReads)
+			return;
+
+		for (size_t i = 0; i < m_selection.bufferViews.size(); ++i)
+		{
+			if (!m_selection.bufferViews[i])
+				continue;
+
+			const rapidjson::Value& v = (*m_bufferViews)[static_cast<rapidjson::SizeType>(i)];
+			const int32_t buffer = GetIndex(v, "buffer");
+			const int64_t offset = std::max<int64_t>(GetOffset(v, "byteOffset"), 0);
+			const int64_t length = GetOffset(v, "byteLength");
+			if (!InRange(m_selection.buffers, buffer) || length < 1)
+				continue;
+
+			// data uris and the glb chunk are in memory already
+			const rapidjson::Value& b = (*m_buffers)[buffer];
+			auto uri = b.FindMember("uri");
+			if (uri == b.MemberEnd() || !uri->value.IsString() || strncmp(uri->value.GetString(), "data:", 5) == 0)
+				continue;
+
+			EGLTF::SGLTFFileRange range = { static_cast<uint64_t>(offset), static_cast<uint64_t>(length), 0 };
+			ranges[buffer].push_back(range);
+		}
+
+		for (auto& list : ranges)
+		{
+			if (list.empty())
+				continue;
+
+			std::sort(list.begin(), list.end(), [](const EGLTF::SGLTFFileRange& a, const EGLTF::SGLTFFileRange& b) { return a.offset < b.offset; });
+
+			size_t merged = 0;
+			for (size_t i = 1; i < list.size(); ++i)
+			{
+				EGLTF::SGLTFFileRange& last = list[merged];
+				if (list[i].offset <= last.offset + last.length + GLTF_RANGE_MERGE_GAP)
+					last.length = std::max(last.offset + last.length, list[i].offset + list[i].length) - last.offset;
+				else
+					list[++merged] = list[i];
+			}
+			list.resize(merged + 1);
+
+			// offsets keep their alignment within 4 bytes, accessors are aligned to their component size
+			uint64_t size = 0;
+			for (auto& range : list)
+			{
+				size += (range.offset - size) & 3;
+				range.target = size;
+				size += range.length;
+			}
+		}
+	}
+
+	const EGLTF::SGLTFLoadFilter& m_filter;
+	EGLTF::SGLTFLoadSelection& m_selection;
+
+	const rapidjson::Value* m_scenes;
+	const rapidjson::Value* m_nodes;
+	const rapidjson::Value* m_meshes;
+	const rapidjson::Value* m_accessors;
+	const rapidjson::Value* m_bufferViews;
+	const rapidjson::Value* m_buffers;
+	const rapidjson::Value* m_materials;
+	const rapidjson::Value* m_textures;
+	const rapidjson::Value* m_samplers;
+	const rapidjson::Value* m_images;
+	const rapidjson::Value* m_skins;
+	const rapidjson::Value* m_animations;
+
+	std::vector<uint8_t> m_content; // nodes whose mesh, skin and children are in, not just the transform
+	std::vector<int32_t> m_pending;
+};
+
+void EGLTF::SelectGLTFElements(const rapidjson::Value& document, const SGLTFLoadFilter& filter, SGLTFLoadSelection& selection, TGLTFBufferRanges& ranges)
+{
+	CGLTFSelector selector(document, filter, selection);
+	selector.Run(ranges);
+}
+
+bool EGLTF::ReadGLTFFileRanges(IGLTFFileSystem& fileSystem, const std::string& filepath, const std::vector<SGLTFFileRange>& ranges, std::vector<uint8_t>& out, IGLTFLoadListener* listener,
+	CGLTFLoadScope* parent)
+{
+	CGLTFLoadScope scope(listener, EGLTFLoadEventCategory::FILE, filepath.c_str(), parent);
+
+	out.clear();
+	if (ranges.empty())
+		return true;
+
+	out.resize(static_cast<size_t>(ranges.back().target + ranges.back().length));
+
+	std::vector<SGLTFFileRead> reads(ranges.size());
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		reads[i].offset = ranges[i].offset;
+		reads[i].length = ranges[i].length;
+		reads[i].out = out.data() + ranges[i].target;
+	}
+
+	if (!fileSystem.ReadFileRanges(filepath, reads.data(), reads.size()))
+	{
+		out.clear();
+		return false;
+	}
+
+	for (const auto& range : ranges)
+		scope.AddBytesRead(range.length);
+
+	return true;
+}
+
+uint64_t EGLTF::RemapGLTFFileOffset(const std::vector<SGLTFFileRange>& ranges, uint64_t offset)
+{
+	// the last range starting at or before the offset
+	auto iter = std::upper_bound(ranges.begin(), ranges.end(), offset, [](uint64_t value, const SGLTFFileRange& range) { return value < range.offset; });
+	if (iter == ranges.begin())
+		return offset;
+
+	--iter;
+	return offset - iter->offset + iter->target;
+}
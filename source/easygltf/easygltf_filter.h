@@ -0,0 +1,49 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+// Internal, not part of the installed headers
+
+#include "easygltf.h"
+#include "easygltf_vfs.h"
+
+#include "rapidjson/document.h"
+
+namespace EGLTF
+{
+	// A stretch of an external buffer's file that a filtered load reads, and where it goes in the buffer's data
+	struct SGLTFFileRange
+	{
+		uint64_t offset; // in the file
+		uint64_t length;
+		uint64_t target; // in the data
+	};
+
+	// Per buffer, merged and in offset order. Empty for buffers that are read whole or not at all.
+	typedef std::vector<std::vector<SGLTFFileRange>> TGLTFBufferRanges;
+
+	// Works out the closure of the filter on the json, before anything gets converted
+	void SelectGLTFElements(const rapidjson::Value& document, const SGLTFLoadFilter& filter, SGLTFLoadSelection& selection, TGLTFBufferRanges& ranges);
+
+	// Reads the ranges of a file into out, which ends up as long as the last range's target + length. One ReadFileRanges call.
+	bool ReadGLTFFileRanges(IGLTFFileSystem& fileSystem, const std::string& filepath, const std::vector<SGLTFFileRange>& ranges, std::vector<uint8_t>& out, IGLTFLoadListener* listener,
+		CGLTFLoadScope* parent);
+
+	// Where an offset into the file ended up in the data, the offset has to be inside one of the ranges
+	uint64_t RemapGLTFFileOffset(const std::vector<SGLTFFileRange>& ranges, uint64_t offset);
+}
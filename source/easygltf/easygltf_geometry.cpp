@@ -0,0 +1,1264 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_geometry.h"
+#include "easygltf_snapshot.h"
+#include "easygltf_threadpool.h"
+#include "easygltf_vfs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <numeric>
+
+static const int32_t ARRAY_BUFFER = 34962;
+static const int32_t ELEMENT_ARRAY_BUFFER = 34963;
+
+uint32_t EGLTF::GetGLTFComponentSize(int32_t componentType)
+{
+	switch (componentType)
+	{
+	case 5120: case 5121: return 1;
+	case 5122: case 5123: return 2;
+	case 5125: case 5126: return 4;
+	default: return 0;
+	}
+}
+
+uint32_t EGLTF::GetGLTFComponentCount(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+static uint32_t MatrixRows(const std::string& type)
+{
+	if (type == "MAT2") return 2;
+	if (type == "MAT3") return 3;
+	if (type == "MAT4") return 4;
+	return 0;
+}
+
+// Matrix columns start on 4 byte boundaries
+static size_t ComponentOffset(uint32_t component, uint32_t componentSize, uint32_t rows)
+{
+	if (rows == 0)
+		return component * componentSize;
+
+	const size_t column = (rows * componentSize + 3) & ~size_t(3);
+	return (component / rows) * column + (component % rows) * componentSize;
+}
+
+uint32_t EGLTF::GetGLTFElementSize(int32_t componentType, const std::string& type)
+{
+	const uint32_t size = GetGLTFComponentSize(componentType);
+	const uint32_t rows = MatrixRows(type);
+	if (rows == 0)
+		return size * GetGLTFComponentCount(type);
+
+	return static_cast<uint32_t>(rows * ((rows * size + 3) & ~3u));
+}
+
+static double ReadComponent(const uint8_t* p, int32_t componentType)
+{
+	switch (componentType)
+	{
+	case 5120: { int8_t v; memcpy(&v, p, 1); return v; }
+	case 5121: { uint8_t v; memcpy(&v, p, 1); return v; }
+	case 5122: { int16_t v; memcpy(&v, p, 2); return v; }
+	case 5123: { uint16_t v; memcpy(&v, p, 2); return v; }
+	case 5125: { uint32_t v; memcpy(&v, p, 4); return v; }
+	case 5126: { float v; memcpy(&v, p, 4); return v; }
+	default: return 0.0;
+	}
+}
+
+static float Normalize(double value, int32_t componentType)
+{
+	switch (componentType)
+	{
+	case 5120: return static_cast<float>(std::max(value / 127.0, -1.0));
+	case 5121: return static_cast<float>(value / 255.0);
+	case 5122: return static_cast<float>(std::max(value / 32767.0, -1.0));
+	case 5123: return static_cast<float>(value / 65535.0);
+	default: return static_cast<float>(value);
+	}
+}
+
+// Where count elements of elementSize starting offset bytes into a bufferView are, false if they are not all in loaded data
+static bool GetViewData(const EGLTF::SGLTFAsset& asset, int32_t viewIndex, uint64_t offset, uint64_t elementSize, uint64_t count, const uint8_t*& data, uint64_t& stride)
+{
+	if (viewIndex < 0 || static_cast<size_t>(viewIndex) >= asset.bufferViews.size())
+	{
+		fprintf(stderr, "\nError: bufferView %d does not exist\n", viewIndex);
+		return false;
+	}
+
+	const EGLTF::SGLTFAsset_Prop_BufferView& view = asset.bufferViews[viewIndex];
+	if (view.buffer < 0 || static_cast<size_t>(view.buffer) >= asset.buffers.size())
+	{
+		fprintf(stderr, "\nError: bufferView %d refers to buffer %d which does not exist\n", viewIndex, view.buffer);
+		return false;
+	}
+
+	const std::vector<uint8_t>& buffer = asset.buffers[view.buffer].data;
+	const uint64_t viewOffset = static_cast<uint64_t>(std::max<int64_t>(view.byteOffset, 0));
+	const uint64_t viewEnd = viewOffset + static_cast<uint64_t>(std::max<int64_t>(view.byteLength, 0));
+
+	stride = view.byteStride > 0 ? static_cast<uint64_t>(view.byteStride) : elementSize;
+	const uint64_t begin = viewOffset + offset;
+	const uint64_t end = count > 0 ? begin + (count - 1) * stride + elementSize : begin;
+
+	if (end > viewEnd || end > buffer.size())
+	{
+		fprintf(stderr, "\nError: data in bufferView %d is out of bounds or not loaded\n", viewIndex);
+		return false;
+	}
+
+	data = buffer.data() + begin;
+	return true;
+}
+
+bool EGLTF::ReadGLTFAccessor(const SGLTFAsset& asset, int32_t index, std::vector<float>& out, bool normalized)
+{
+	if (index < 0 || static_cast<size_t>(index) >= asset.accessors.size())
+	{
+		fprintf(stderr, "\nError: accessor %d does not exist\n", index);
+		return false;
+	}
+
+	const SGLTFAsset_Prop_Accessor& accessor = asset.accessors[index];
+	const uint32_t components = GetGLTFComponentCount(accessor.type);
+	const uint32_t size = GetGLTFComponentSize(accessor.componentType);
+	const uint32_t rows = MatrixRows(accessor.type);
+	if (components == 0 || size == 0 || accessor.count < 0)
+	{
+		fprintf(stderr, "\nError: accessor %d has an invalid type, componentType or count\n", index);
+		return false;
+	}
+
+	auto read = [&](const uint8_t* element, float* values)
+	{
+		for (uint32_t c = 0; c < components; ++c)
+		{
+			const double v = ReadComponent(element + ComponentOffset(c, size, rows), accessor.componentType);
+			values[c] = normalized || accessor.normalized ? Normalize(v, accessor.componentType) : static_cast<float>(v);
+		}
+	};
+
+	const size_t count = static_cast<size_t>(accessor.count);
+	out.assign(count * components, 0.0f); // no bufferView means zeros
+
+	if (accessor.bufferView != -1)
+	{
+		const uint8_t* data;
+		uint64_t stride;
+		if (!GetViewData(asset, accessor.bufferView, static_cast<uint64_t>(std::max<int64_t>(accessor.byteOffset, 0)), GetGLTFElementSize(accessor.componentType, accessor.type), count, data, stride))
+			return false;
+
+		for (size_t e = 0; e < count; ++e)
+			read(data + e * stride, &out[e * components]);
+	}
+
+	if (accessor.sparse.count > 0)
+	{
+		const int32_t indexType = accessor.sparse.indices.second;
+		const uint32_t indexSize = GetGLTFComponentSize(indexType);
+		const size_t sparseCount = static_cast<size_t>(accessor.sparse.count);
+
+		const uint8_t* indices;
+		const uint8_t* values;
+		uint64_t indexStride, valueStride;
+		if (indexSize == 0 || indexType == 5126 ||
+			!GetViewData(asset, accessor.sparse.indices.first, 0, indexSize, sparseCount, indices, indexStride) ||
+			!GetViewData(asset, accessor.sparse.values, 0, GetGLTFElementSize(accessor.componentType, accessor.type), sparseCount, values, valueStride))
+		{
+			fprintf(stderr, "\nError: sparse data of accessor %d can't be read\n", index);
+			return false;
+		}
+
+		for (size_t i = 0; i < sparseCount; ++i)
+		{
+			const size_t target = static_cast<size_t>(ReadComponent(indices + i * indexStride, indexType));
+			if (target >= count)
+			{
+				fprintf(stderr, "\nError: sparse index %zu of accessor %d is out of range\n", target, index);
+				return false;
+			}
+			read(values + i * valueStride, &out[target * components]);
+		}
+	}
+
+	return true;
+}
+
+bool EGLTF::ReadGLTFAccessorBytes(const SGLTFAsset& asset, int32_t index, std::vector<uint8_t>& out)
+{
+	if (index < 0 || static_cast<size_t>(index) >= asset.accessors.size())
+	{
+		fprintf(stderr, "\nError: accessor %d does not exist\n", index);
+		return false;
+	}
+
+	const SGLTFAsset_Prop_Accessor& accessor = asset.accessors[index];
+	const uint64_t elementSize = GetGLTFElementSize(accessor.componentType, accessor.type);
+	if (elementSize == 0 || accessor.count < 0)
+	{
+		fprintf(stderr, "\nError: accessor %d has an invalid type, componentType or count\n", index);
+		return false;
+	}
+
+	const size_t count = static_cast<size_t>(accessor.count);
+	out.assign(count * elementSize, 0);
+
+	if (accessor.bufferView != -1)
+	{
+		const uint8_t* data;
+		uint64_t stride;
+		if (!GetViewData(asset, accessor.bufferView, static_cast<uint64_t>(std::max<int64_t>(accessor.byteOffset, 0)), elementSize, count, data, stride))
+			return false;
+
+		if (stride == elementSize)
+			memcpy(out.data(), data, out.size());
+		else
+			for (size_t e = 0; e < count; ++e)
+				memcpy(&out[e * elementSize], data + e * stride, elementSize);
+	}
+
+	if (accessor.sparse.count > 0)
+	{
+		const int32_t indexType = accessor.sparse.indices.second;
+		const uint32_t indexSize = GetGLTFComponentSize(indexType);
+		const size_t sparseCount = static_cast<size_t>(accessor.sparse.count);
+
+		const uint8_t* indices;
+		const uint8_t* values;
+		uint64_t indexStride, valueStride;
+		if (indexSize == 0 || indexType == 5126 ||
+			!GetViewData(asset, accessor.sparse.indices.first, 0, indexSize, sparseCount, indices, indexStride) ||
+			!GetViewData(asset, accessor.sparse.values, 0, elementSize, sparseCount, values, valueStride))
+		{
+			fprintf(stderr, "\nError: sparse data of accessor %d can't be read\n", index);
+			return false;
+		}
+
+		for (size_t i = 0; i < sparseCount; ++i)
+		{
+			const size_t target = static_cast<size_t>(ReadComponent(indices + i * indexStride, indexType));
+			if (target >= count)
+			{
+				fprintf(stderr, "\nError: sparse index %zu of accessor %d is out of range\n", target, index);
+				return false;
+			}
+			memcpy(&out[target * elementSize], values + i * valueStride, elementSize);
+		}
+	}
+
+	return true;
+}
+
+// Strided views are read from files in pieces of about this size and gathered
+static const uint64_t RANGE_READ_CHUNK = 4 << 20;
+
+// Elements [first, first + count) of a bufferView into out, tightly packed, from the loaded data or the buffer's file
+static bool ReadViewRange(const EGLTF::SGLTFAsset& asset, int32_t viewIndex, uint64_t offset, uint64_t elementSize, uint64_t first, uint64_t count,
+	EGLTF::IGLTFFileSystem& fileSystem, const std::string& directory, uint8_t* out)
+{
+	if (viewIndex < 0 || static_cast<size_t>(viewIndex) >= asset.bufferViews.size())
+	{
+		fprintf(stderr, "\nError: bufferView %d does not exist\n", viewIndex);
+		return false;
+	}
+
+	const EGLTF::SGLTFAsset_Prop_BufferView& view = asset.bufferViews[viewIndex];
+	if (view.buffer < 0 || static_cast<size_t>(view.buffer) >= asset.buffers.size())
+	{
+		fprintf(stderr, "\nError: bufferView %d refers to buffer %d which does not exist\n", viewIndex, view.buffer);
+		return false;
+	}
+
+	if (count == 0)
+		return true;
+
+	const EGLTF::SGLTFAsset_Prop_Buffer& buffer = asset.buffers[view.buffer];
+	const uint64_t viewOffset = static_cast<uint64_t>(std::max<int64_t>(view.byteOffset, 0));
+	const uint64_t viewEnd = viewOffset + static_cast<uint64_t>(std::max<int64_t>(view.byteLength, 0));
+
+	const uint64_t stride = view.byteStride > 0 ? static_cast<uint64_t>(view.byteStride) : elementSize;
+	const uint64_t begin = viewOffset + offset + first * stride;
+	const uint64_t end = begin + (count - 1) * stride + elementSize;
+	if (end > viewEnd)
+	{
+		fprintf(stderr, "\nError: data in bufferView %d is out of bounds\n", viewIndex);
+		return false;
+	}
+
+	if (!buffer.data.empty())
+	{
+		if (end > buffer.data.size())
+		{
+			fprintf(stderr, "\nError: data in bufferView %d is out of bounds\n", viewIndex);
+			return false;
+		}
+
+		const uint8_t* data = buffer.data.data() + begin;
+		if (stride == elementSize)
+			memcpy(out, data, static_cast<size_t>(count * elementSize));
+		else
+			for (uint64_t e = 0; e < count; ++e)
+				memcpy(out + e * elementSize, data + e * stride, static_cast<size_t>(elementSize));
+		return true;
+	}
+
+	if (buffer.uri.empty() || buffer.uri.compare(0, 5, "data:") == 0)
+	{
+		fprintf(stderr, "\nError: buffer %d is not loaded and has no file to read from\n", view.buffer);
+		return false;
+	}
+
+	const std::string path = EGLTF::ResolveGLTFUri(directory, buffer.uri);
+
+	if (stride == elementSize)
+	{
+		const EGLTF::SGLTFFileRead read = { begin, count * elementSize, out };
+		if (!fileSystem.ReadFileRanges(path, &read, 1))
+		{
+			fprintf(stderr, "\nError: could not read %s\n", path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// one read per piece rather than per element, the gaps between elements come along
+	const uint64_t perChunk = std::max<uint64_t>(1, RANGE_READ_CHUNK / stride);
+	std::vector<uint8_t> chunk;
+	for (uint64_t e = 0; e < count; e += perChunk)
+	{
+		const uint64_t n = std::min(perChunk, count - e);
+		chunk.resize(static_cast<size_t>((n - 1) * stride + elementSize));
+
+		const EGLTF::SGLTFFileRead read = { begin + e * stride, chunk.size(), chunk.data() };
+		if (!fileSystem.ReadFileRanges(path, &read, 1))
+		{
+			fprintf(stderr, "\nError: could not read %s\n", path.c_str());
+			return false;
+		}
+
+		for (uint64_t i = 0; i < n; ++i)
+			memcpy(out + (e + i) * elementSize, chunk.data() + i * stride, static_cast<size_t>(elementSize));
+	}
+
+	return true;
+}
+
+bool EGLTF::ReadGLTFAccessorRange(const SGLTFAsset& asset, int32_t index, uint64_t first, uint64_t count, IGLTFFileSystem& fileSystem,
+	const std::string& directory, std::vector<uint8_t>& out)
+{
+	if (index < 0 || static_cast<size_t>(index) >= asset.accessors.size())
+	{
+		fprintf(stderr, "\nError: accessor %d does not exist\n", index);
+		return false;
+	}
+
+	const SGLTFAsset_Prop_Accessor& accessor = asset.accessors[index];
+	const uint64_t elementSize = GetGLTFElementSize(accessor.componentType, accessor.type);
+	if (elementSize == 0 || accessor.count < 0)
+	{
+		fprintf(stderr, "\nError: accessor %d has an invalid type, componentType or count\n", index);
+		return false;
+	}
+
+	const uint64_t accessorCount = static_cast<uint64_t>(accessor.count);
+	if (first > accessorCount || count > accessorCount - first)
+	{
+		fprintf(stderr, "\nError: elements %llu to %llu are past the end of accessor %d\n", (unsigned long long) first,
+			(unsigned long long) (first + count), index);
+		return false;
+	}
+
+	out.assign(static_cast<size_t>(count * elementSize), 0);
+
+	if (accessor.bufferView != -1 && !ReadViewRange(asset, accessor.bufferView, static_cast<uint64_t>(std::max<int64_t>(accessor.byteOffset, 0)),
+		elementSize, first, count, fileSystem, directory, out.data()))
+		return false;
+
+	if (accessor.sparse.count > 0 && count > 0)
+	{
+		const int32_t indexType = accessor.sparse.indices.second;
+		const uint32_t indexSize = GetGLTFComponentSize(indexType);
+		const uint64_t sparseCount = static_cast<uint64_t>(accessor.sparse.count);
+
+		// the indices are needed to know which values fall in the range, the values only for the ones that do
+		std::vector<uint8_t> indices(static_cast<size_t>(sparseCount * indexSize));
+		if (indexSize == 0 || indexType == 5126 ||
+			!ReadViewRange(asset, accessor.sparse.indices.first, 0, indexSize, 0, sparseCount, fileSystem, directory, indices.data()))
+		{
+			fprintf(stderr, "\nError: sparse data of accessor %d can't be read\n", index);
+			return false;
+		}
+
+		uint64_t lo = sparseCount, hi = 0;
+		for (uint64_t i = 0; i < sparseCount; ++i)
+		{
+			const uint64_t target = static_cast<uint64_t>(ReadComponent(&indices[static_cast<size_t>(i * indexSize)], indexType));
+			if (target >= accessorCount)
+			{
+				fprintf(stderr, "\nError: sparse index %llu of accessor %d is out of range\n", (unsigned long long) target, index);
+				return false;
+			}
+			if (target >= first && target < first + count)
+			{
+				lo = std::min(lo, i);
+				hi = i + 1;
+			}
+		}
+
+		if (lo < hi)
+		{
+			std::vector<uint8_t> values(static_cast<size_t>((hi - lo) * elementSize));
+			if (!ReadViewRange(asset, accessor.sparse.values, 0, elementSize, lo, hi - lo, fileSystem, directory, values.data()))
+			{
+				fprintf(stderr, "\nError: sparse data of accessor %d can't be read\n", index);
+				return false;
+			}
+
+			for (uint64_t i = lo; i < hi; ++i)
+			{
+				const uint64_t target = static_cast<uint64_t>(ReadComponent(&indices[static_cast<size_t>(i * indexSize)], indexType));
+				if (target >= first && target < first + count)
+					memcpy(&out[static_cast<size_t>((target - first) * elementSize)], &values[static_cast<size_t>((i - lo) * elementSize)],
+						static_cast<size_t>(elementSize));
+			}
+		}
+	}
+
+	return true;
+}
+
+bool EGLTF::ReadGLTFAccessorIndices(const SGLTFAsset& asset, int32_t index, std::vector<uint32_t>& out)
+{
+	if (index < 0 || static_cast<size_t>(index) >= asset.accessors.size())
+	{
+		fprintf(stderr, "\nError: accessor %d does not exist\n", index);
+		return false;
+	}
+
+	const SGLTFAsset_Prop_Accessor& accessor = asset.accessors[index];
+	const int32_t type = accessor.componentType;
+	if ((type != 5121 && type != 5123 && type != 5125) || accessor.type != "SCALAR" || accessor.count < 0)
+	{
+		fprintf(stderr, "\nError: accessor %d can't be used for indices\n", index);
+		return false;
+	}
+
+	const size_t count = static_cast<size_t>(accessor.count);
+	out.assign(count, 0);
+
+	if (accessor.bufferView == -1)
+		return true;
+
+	const uint8_t* data;
+	uint64_t stride;
+	if (!GetViewData(asset, accessor.bufferView, static_cast<uint64_t>(std::max<int64_t>(accessor.byteOffset, 0)), GetGLTFComponentSize(type), count, data, stride))
+		return false;
+
+	if (type == 5125 && stride == 4)
+	{
+		memcpy(out.data(), data, count * 4);
+		return true;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		out[i] = static_cast<uint32_t>(ReadComponent(data + i * stride, type));
+	return true;
+}
+
+namespace
+{
+	// What was generated for one primitive. It only goes into the asset once every primitive is done, in primitive order, so
+	// the result does not depend on which thread finished first.
+	struct SGeneratedPrimitive
+	{
+		int32_t mesh = -1;
+		int32_t primitive = -1;
+		bool changed = false;
+		bool failed = false;
+
+		std::vector<uint8_t> data;
+		std::vector<EGLTF::SGLTFAsset_Prop_BufferView> views; // byteOffset into data
+		std::vector<EGLTF::SGLTFAsset_Prop_Accessor> accessors; // bufferView into views
+
+		// accessor references below -1 are generated ones, -2 - index into accessors
+		EGLTF::SGLTFAsset_Prop_Mesh_Primitive result;
+
+		int32_t Add(const void* bytes, size_t byteLength, size_t byteStride, int32_t target, EGLTF::SGLTFAsset_Prop_Accessor accessor)
+		{
+			data.resize((data.size() + 3) & ~size_t(3), 0);
+
+			EGLTF::SGLTFAsset_Prop_BufferView view;
+			view.byteOffset = static_cast<int64_t>(data.size());
+			view.byteLength = static_cast<int64_t>(byteLength);
+			view.byteStride = byteStride > 0 ? static_cast<int32_t>(byteStride) : -1;
+			view.target = target;
+
+			data.insert(data.end(), static_cast<const uint8_t*>(bytes), static_cast<const uint8_t*>(bytes) + byteLength);
+
+			accessor.bufferView = static_cast<int32_t>(views.size());
+			accessor.byteOffset = -1;
+			views.push_back(view);
+			accessors.push_back(accessor);
+			return -2 - static_cast<int32_t>(accessors.size() - 1);
+		}
+
+		int32_t AddFloats(const std::vector<float>& values, uint32_t components, const char* type, bool bounds)
+		{
+			EGLTF::SGLTFAsset_Prop_Accessor accessor;
+			accessor.type = type;
+			accessor.componentType = 5126;
+			accessor.count = static_cast<int64_t>(values.size() / components);
+
+			if (bounds && accessor.count > 0)
+			{
+				accessor.min.assign(values.begin(), values.begin() + components);
+				accessor.max = accessor.min;
+				for (size_t i = 0; i < values.size(); ++i)
+				{
+					accessor.min[i % components] = std::min<double>(accessor.min[i % components], values[i]);
+					accessor.max[i % components] = std::max<double>(accessor.max[i % components], values[i]);
+				}
+			}
+
+			return Add(values.data(), values.size() * sizeof(float), 0, ARRAY_BUFFER, accessor);
+		}
+	};
+
+	struct SVec3
+	{
+		float x, y, z;
+	};
+}
+
+static SVec3 Sub(const SVec3& a, const SVec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static SVec3 Scale(const SVec3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+static float Dot(const SVec3& a, const SVec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static SVec3 Cross(const SVec3& a, const SVec3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+static bool NormalizeVec(SVec3& v)
+{
+	const float length = std::sqrt(Dot(v, v));
+	if (!(length > 1e-20f))
+		return false;
+	v = Scale(v, 1.0f / length);
+	return true;
+}
+
+static SVec3 Load3(const std::vector<float>& values, size_t index)
+{
+	return { values[index * 3], values[index * 3 + 1], values[index * 3 + 2] };
+}
+
+static void Store3(std::vector<float>& values, size_t index, const SVec3& v)
+{
+	values[index * 3] = v.x;
+	values[index * 3 + 1] = v.y;
+	values[index * 3 + 2] = v.z;
+}
+
+// Angle between the two edges leaving corner a of triangle a, b, c
+static float CornerAngle(const SVec3& a, const SVec3& b, const SVec3& c)
+{
+	SVec3 e1 = Sub(b, a);
+	SVec3 e2 = Sub(c, a);
+	if (!NormalizeVec(e1) || !NormalizeVec(e2))
+		return 0.0f;
+	return std::acos(std::max(-1.0f, std::min(1.0f, Dot(e1, e2))));
+}
+
+template<typename T>
+static std::vector<T> Gather(const std::vector<T>& values, size_t width, const std::vector<uint32_t>& remap)
+{
+	std::vector<T> out(remap.size() * width);
+	for (size_t v = 0; v < remap.size(); ++v)
+		std::copy(values.begin() + remap[v] * width, values.begin() + (remap[v] + 1) * width, out.begin() + v * width);
+	return out;
+}
+
+// Strips and fans to a list, the way the specs number their triangles. Strips often glue parts together with degenerate
+// triangles, those are dropped.
+static void Triangulate(int32_t mode, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> list;
+
+	if (mode == 5 && indices.size() >= 3)
+	{
+		list.reserve((indices.size() - 2) * 3);
+		for (size_t i = 0; i + 2 < indices.size(); ++i)
+		{
+			const uint32_t a = indices[i];
+			const uint32_t b = indices[i + 1 + i % 2];
+			const uint32_t c = indices[i + 2 - i % 2];
+			if (a == b || b == c || a == c)
+				continue;
+			list.push_back(a);
+			list.push_back(b);
+			list.push_back(c);
+		}
+	}
+	else if (mode == 6 && indices.size() >= 3)
+	{
+		list.reserve((indices.size() - 2) * 3);
+		for (size_t i = 0; i + 2 < indices.size(); ++i)
+		{
+			list.push_back(indices[i + 1]);
+			list.push_back(indices[i + 2]);
+			list.push_back(indices[0]);
+		}
+	}
+	else if (mode != 5 && mode != 6)
+	{
+		indices.resize(indices.size() - indices.size() % 3);
+		return;
+	}
+
+	indices.swap(list);
+}
+
+// Vertices whose keys are bitwise equal end up in the same group, groups are numbered in order of first appearance
+static uint32_t WeldVertices(std::vector<float>& keys, size_t width, std::vector<uint32_t>& groups)
+{
+	const size_t count = keys.size() / width;
+	for (float& key : keys)
+		key += 0.0f; // -0 and 0 are the same vertex
+
+	size_t capacity = 16;
+	while (capacity < count * 2)
+		capacity *= 2;
+
+	std::vector<uint32_t> table(capacity, UINT32_MAX); // first vertex of each group
+	groups.resize(count);
+
+	uint32_t groupCount = 0;
+	for (size_t v = 0; v < count; ++v)
+	{
+		const float* key = &keys[v * width];
+		size_t slot = static_cast<size_t>(EGLTF::HashGLTFSnapshotData(key, width * sizeof(float))) & (capacity - 1);
+
+		for (;;)
+		{
+			const uint32_t other = table[slot];
+			if (other == UINT32_MAX)
+			{
+				table[slot] = static_cast<uint32_t>(v);
+				groups[v] = groupCount++;
+				break;
+			}
+			if (memcmp(key, &keys[other * width], width * sizeof(float)) == 0)
+			{
+				groups[v] = groups[other];
+				break;
+			}
+			slot = (slot + 1) & (capacity - 1);
+		}
+	}
+
+	return groupCount;
+}
+
+// Corners sorted by group, in corner order within a group, so sums over them come out the same every time
+static void GroupCorners(const std::vector<uint32_t>& cornerGroups, uint32_t groupCount, std::vector<uint32_t>& offsets, std::vector<uint32_t>& corners)
+{
+	offsets.assign(groupCount + 1, 0);
+	for (uint32_t group : cornerGroups)
+		++offsets[group + 1];
+	for (uint32_t g = 0; g < groupCount; ++g)
+		offsets[g + 1] += offsets[g];
+
+	std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	corners.resize(cornerGroups.size());
+	for (size_t c = 0; c < cornerGroups.size(); ++c)
+		corners[cursor[cornerGroups[c]]++] = static_cast<uint32_t>(c);
+}
+
+namespace
+{
+	// Passes over one primitive, on the pool when there is one
+	struct SGeometryContext
+	{
+		EGLTF::CGLTFThreadPool* pool;
+		size_t grain;
+
+		void ParallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& func) const
+		{
+			if (pool && count > grain)
+				pool->ParallelFor(count, grain, func);
+			else if (count > 0)
+				func(0, count);
+		}
+	};
+}
+
+static void ComputeFlatNormals(const SGeometryContext& context, const std::vector<float>& positions, const std::vector<uint32_t>& indices, std::vector<float>& normals)
+{
+	normals.assign(positions.size(), 0.0f);
+	context.ParallelFor(indices.size() / 3, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; ++t)
+		{
+			const SVec3 a = Load3(positions, indices[t * 3]);
+			SVec3 n = Cross(Sub(Load3(positions, indices[t * 3 + 1]), a), Sub(Load3(positions, indices[t * 3 + 2]), a));
+			if (!NormalizeVec(n))
+				n = { 0.0f, 0.0f, 1.0f };
+
+			// every corner has its own vertex here
+			for (int k = 0; k < 3; ++k)
+				Store3(normals, indices[t * 3 + k], n);
+		}
+	});
+}
+
+static void ComputeSmoothNormals(const SGeometryContext& context, const std::vector<float>& positions, const std::vector<uint32_t>& indices, std::vector<float>& normals)
+{
+	const size_t triangles = indices.size() / 3;
+
+	// face normal times the angle at each corner
+	std::vector<float> weighted(indices.size() * 3, 0.0f);
+	context.ParallelFor(triangles, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; ++t)
+		{
+			const SVec3 p[3] = { Load3(positions, indices[t * 3]), Load3(positions, indices[t * 3 + 1]), Load3(positions, indices[t * 3 + 2]) };
+			SVec3 n = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+			if (!NormalizeVec(n))
+				continue;
+
+			for (int k = 0; k < 3; ++k)
+				Store3(weighted, t * 3 + k, Scale(n, CornerAngle(p[k], p[(k + 1) % 3], p[(k + 2) % 3])));
+		}
+	});
+
+	// faces meet at positions, not at vertices, a uv seam should not show up as a crease
+	std::vector<float> keys(positions);
+	std::vector<uint32_t> vertexGroups;
+	const uint32_t groupCount = WeldVertices(keys, 3, vertexGroups);
+
+	std::vector<uint32_t> cornerGroups(indices.size());
+	for (size_t c = 0; c < indices.size(); ++c)
+		cornerGroups[c] = vertexGroups[indices[c]];
+
+	std::vector<uint32_t> offsets, corners;
+	GroupCorners(cornerGroups, groupCount, offsets, corners);
+
+	std::vector<float> groupNormals(groupCount * 3);
+	context.ParallelFor(groupCount, [&](size_t begin, size_t end)
+	{
+		for (size_t g = begin; g < end; ++g)
+		{
+			SVec3 n = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = offsets[g]; i < offsets[g + 1]; ++i)
+			{
+				const SVec3 w = Load3(weighted, corners[i]);
+				n = { n.x + w.x, n.y + w.y, n.z + w.z };
+			}
+			if (!NormalizeVec(n))
+				n = { 0.0f, 0.0f, 1.0f };
+			Store3(groupNormals, g, n);
+		}
+	});
+
+	normals.resize(positions.size());
+	context.ParallelFor(vertexGroups.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; ++v)
+			Store3(normals, v, Load3(groupNormals, vertexGroups[v]));
+	});
+}
+
+// MikkTSpace: per face the direction of increasing u, per corner projected into the plane of the vertex normal and weighted
+// by the corner angle, summed over the corners of each vertex. Vertices are identified by position, normal and uv like the
+// reference implementation does, and split where faces with opposite uv winding meet so each one has a single handedness.
+// The splits are appended to remap and the vertex arrays, the corners in indices are pointed at them.
+static void ComputeTangents(const SGeometryContext& context, std::vector<float>& positions, std::vector<float>& normals, std::vector<float>& uvs,
+	std::vector<uint32_t>& indices, std::vector<uint32_t>& remap, std::vector<float>& tangents)
+{
+	const size_t triangles = indices.size() / 3;
+
+	std::vector<float> faceTangents(triangles * 3, 0.0f);
+	std::vector<int8_t> orientation(triangles, 0); // 1 preserving, -1 flipped, 0 degenerate in uv
+	context.ParallelFor(triangles, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; ++t)
+		{
+			const uint32_t i0 = indices[t * 3], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+			const SVec3 d1 = Sub(Load3(positions, i1), Load3(positions, i0));
+			const SVec3 d2 = Sub(Load3(positions, i2), Load3(positions, i0));
+			const float t21x = uvs[i1 * 2] - uvs[i0 * 2], t21y = uvs[i1 * 2 + 1] - uvs[i0 * 2 + 1];
+			const float t31x = uvs[i2 * 2] - uvs[i0 * 2], t31y = uvs[i2 * 2 + 1] - uvs[i0 * 2 + 1];
+
+			const float signedArea = t21x * t31y - t21y * t31x;
+			SVec3 os = Sub(Scale(d1, t31y), Scale(d2, t21y));
+
+			if (std::fabs(signedArea) > 1e-20f && NormalizeVec(os))
+			{
+				orientation[t] = signedArea > 0.0f ? 1 : -1;
+				Store3(faceTangents, t, os);
+			}
+		}
+	});
+
+	// every vertex keeps the handedness of the first face that has one, corners of faces with the other get a copy
+	const size_t originalCount = positions.size() / 3;
+	std::vector<int8_t> vertexOrientation(originalCount, 0);
+	std::vector<uint32_t> split(originalCount, UINT32_MAX);
+
+	for (size_t c = 0; c < indices.size(); ++c)
+	{
+		const int8_t o = orientation[c / 3];
+		const uint32_t v = indices[c];
+		if (o == 0)
+			continue;
+		if (vertexOrientation[v] == 0)
+			vertexOrientation[v] = o;
+		if (vertexOrientation[v] == o)
+			continue;
+
+		if (split[v] == UINT32_MAX)
+		{
+			split[v] = static_cast<uint32_t>(positions.size() / 3);
+			remap.push_back(remap[v]);
+			for (int k = 0; k < 3; ++k)
+			{
+				positions.push_back(positions[v * 3 + k]);
+				normals.push_back(normals[v * 3 + k]);
+			}
+			uvs.push_back(uvs[v * 2]);
+			uvs.push_back(uvs[v * 2 + 1]);
+			vertexOrientation.push_back(o);
+		}
+		indices[c] = split[v];
+	}
+
+	const size_t vertexCount = positions.size() / 3;
+	for (int8_t& o : vertexOrientation)
+		if (o == 0)
+			o = 1;
+
+	std::vector<float> keys(vertexCount * 9);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		std::copy(positions.begin() + v * 3, positions.begin() + v * 3 + 3, keys.begin() + v * 9);
+		std::copy(normals.begin() + v * 3, normals.begin() + v * 3 + 3, keys.begin() + v * 9 + 3);
+		std::copy(uvs.begin() + v * 2, uvs.begin() + v * 2 + 2, keys.begin() + v * 9 + 6);
+		keys[v * 9 + 8] = vertexOrientation[v];
+	}
+
+	std::vector<uint32_t> vertexGroups;
+	const uint32_t groupCount = WeldVertices(keys, 9, vertexGroups);
+
+	std::vector<uint32_t> cornerGroups(indices.size());
+	for (size_t c = 0; c < indices.size(); ++c)
+		cornerGroups[c] = vertexGroups[indices[c]];
+
+	std::vector<uint32_t> offsets, corners;
+	GroupCorners(cornerGroups, groupCount, offsets, corners);
+
+	std::vector<float> groupTangents(groupCount * 3, 0.0f);
+	context.ParallelFor(groupCount, [&](size_t begin, size_t end)
+	{
+		for (size_t g = begin; g < end; ++g)
+		{
+			SVec3 sum = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = offsets[g]; i < offsets[g + 1]; ++i)
+			{
+				const uint32_t c = corners[i];
+				const size_t t = c / 3;
+				if (orientation[t] == 0)
+					continue;
+
+				const uint32_t v = indices[c];
+				const SVec3 n = Load3(normals, v);
+				SVec3 os = Load3(faceTangents, t);
+				os = Sub(os, Scale(n, Dot(n, os)));
+				if (!NormalizeVec(os))
+					continue;
+
+				// the angle is measured between the edges projected into the normal's plane
+				const SVec3 p = Load3(positions, v);
+				SVec3 e1 = Sub(Load3(positions, indices[t * 3 + (c + 1) % 3]), p);
+				SVec3 e2 = Sub(Load3(positions, indices[t * 3 + (c + 2) % 3]), p);
+				e1 = Sub(e1, Scale(n, Dot(n, e1)));
+				e2 = Sub(e2, Scale(n, Dot(n, e2)));
+				if (!NormalizeVec(e1) || !NormalizeVec(e2))
+					continue;
+
+				const float angle = std::acos(std::max(-1.0f, std::min(1.0f, Dot(e1, e2))));
+				sum = { sum.x + os.x * angle, sum.y + os.y * angle, sum.z + os.z * angle };
+			}
+			Store3(groupTangents, g, sum);
+		}
+	});
+
+	tangents.resize(vertexCount * 4);
+	context.ParallelFor(vertexCount, [&](size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; ++v)
+		{
+			SVec3 t = Load3(groupTangents, vertexGroups[v]);
+			if (!NormalizeVec(t))
+			{
+				// nothing to go by, any direction in the normal's plane
+				const SVec3 n = Load3(normals, v);
+				t = Cross(std::fabs(n.x) < 0.9f ? SVec3{ 1.0f, 0.0f, 0.0f } : SVec3{ 0.0f, 1.0f, 0.0f }, n);
+				if (!NormalizeVec(t))
+					t = { 1.0f, 0.0f, 0.0f };
+			}
+
+			tangents[v * 4] = t.x;
+			tangents[v * 4 + 1] = t.y;
+			tangents[v * 4 + 2] = t.z;
+			tangents[v * 4 + 3] = vertexOrientation[v];
+		}
+	});
+}
+
+// Copies an accessor's elements in remap order into out, tightly packed but 4 byte aligned as vertex attributes have to be
+static bool GatherAccessor(const EGLTF::SGLTFAsset& asset, int32_t index, const std::vector<uint32_t>& remap, SGeneratedPrimitive& out, int32_t& result)
+{
+	if (index < 0 || static_cast<size_t>(index) >= asset.accessors.size())
+	{
+		fprintf(stderr, "\nError: accessor %d does not exist\n", index);
+		return false;
+	}
+
+	const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[index];
+	const uint32_t components = EGLTF::GetGLTFComponentCount(accessor.type);
+	const bool bounds = !accessor.min.empty() || !accessor.max.empty();
+
+	for (uint32_t v : remap)
+	{
+		if (v >= static_cast<uint64_t>(std::max<int64_t>(accessor.count, 0)))
+		{
+			fprintf(stderr, "\nError: accessor %d has fewer elements than the primitive has vertices\n", index);
+			return false;
+		}
+	}
+
+	if (accessor.sparse.count > 0)
+	{
+		// the sparse values have to be applied, which only comes out right without conversion for floats
+		std::vector<float> values;
+		if (accessor.componentType != 5126 || !EGLTF::ReadGLTFAccessor(asset, index, values))
+		{
+			fprintf(stderr, "\nError: sparse accessor %d can't be rewritten\n", index);
+			return false;
+		}
+
+		result = out.AddFloats(Gather(values, components, remap), components, accessor.type.c_str(), bounds);
+		return true;
+	}
+
+	const uint64_t elementSize = EGLTF::GetGLTFElementSize(accessor.componentType, accessor.type);
+	if (elementSize == 0)
+	{
+		fprintf(stderr, "\nError: accessor %d has an invalid type or componentType\n", index);
+		return false;
+	}
+
+	const uint64_t packedStride = (elementSize + 3) & ~uint64_t(3);
+	std::vector<uint8_t> packed(remap.size() * packedStride, 0);
+
+	if (accessor.bufferView != -1)
+	{
+		const uint8_t* data;
+		uint64_t stride;
+		if (!GetViewData(asset, accessor.bufferView, static_cast<uint64_t>(std::max<int64_t>(accessor.byteOffset, 0)), elementSize, static_cast<uint64_t>(accessor.count), data, stride))
+			return false;
+
+		for (size_t v = 0; v < remap.size(); ++v)
+			memcpy(&packed[v * packedStride], data + remap[v] * stride, elementSize);
+	}
+
+	EGLTF::SGLTFAsset_Prop_Accessor gathered = accessor;
+	gathered.count = static_cast<int64_t>(remap.size());
+	gathered.sparse = EGLTF::SGLTFAsset_Prop_Accessor_Sparse();
+	gathered.min.clear();
+	gathered.max.clear();
+
+	// vertices no face used are gone, the bounds can shrink
+	if (bounds && !remap.empty())
+	{
+		const uint32_t size = EGLTF::GetGLTFComponentSize(accessor.componentType);
+		const uint32_t rows = MatrixRows(accessor.type);
+		gathered.min.assign(components, 0.0);
+		gathered.max.assign(components, 0.0);
+		for (size_t v = 0; v < remap.size(); ++v)
+		{
+			for (uint32_t c = 0; c < components; ++c)
+			{
+				const double value = ReadComponent(&packed[v * packedStride + ComponentOffset(c, size, rows)], accessor.componentType);
+				gathered.min[c] = v == 0 ? value : std::min(gathered.min[c], value);
+				gathered.max[c] = v == 0 ? value : std::max(gathered.max[c], value);
+			}
+		}
+	}
+
+	result = out.Add(packed.data(), packed.size(), packedStride != elementSize ? packedStride : 0, ARRAY_BUFFER, gathered);
+	return true;
+}
+
+static void ProcessPrimitive(const EGLTF::SGLTFAsset& asset, const EGLTF::SGLTFGeometryOptions& options, const SGeometryContext& context, SGeneratedPrimitive& out)
+{
+	const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[out.mesh].primitives[out.primitive];
+	out.result = primitive;
+
+	const int32_t mode = primitive.mode == -1 ? 4 : primitive.mode;
+	if (mode < 4 || mode > 6)
+		return; // points and lines
+
+	const auto position = primitive.attributes.find("POSITION");
+	const auto normal = primitive.attributes.find("NORMAL");
+	const auto uv = primitive.attributes.find("TEXCOORD_0");
+	if (position == primitive.attributes.end())
+		return;
+
+	const bool makeNormals = options.normals && normal == primitive.attributes.end();
+	const bool makeTangents = options.tangents && !primitive.attributes.count("TANGENT") && uv != primitive.attributes.end();
+	const bool triangulate = mode != 4 && (options.triangulate || makeNormals || makeTangents);
+	if (!makeNormals && !makeTangents && !triangulate)
+		return;
+
+	out.failed = true; // until it made it to the end
+
+	std::vector<float> positions;
+	if (!EGLTF::ReadGLTFAccessor(asset, position->second, positions))
+		return;
+	if (asset.accessors[position->second].type != "VEC3")
+	{
+		fprintf(stderr, "\nError: POSITION of mesh %d primitive %d is not a VEC3\n", out.mesh, out.primitive);
+		return;
+	}
+
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+
+	std::vector<uint32_t> indices;
+	if (primitive.indices != -1)
+	{
+		if (!EGLTF::ReadGLTFAccessorIndices(asset, primitive.indices, indices))
+			return;
+
+		for (uint32_t i : indices)
+		{
+			if (i >= vertexCount)
+			{
+				fprintf(stderr, "\nError: mesh %d primitive %d has index %u but only %u vertices\n", out.mesh, out.primitive, i, vertexCount);
+				return;
+			}
+		}
+	}
+	else
+	{
+		indices.resize(vertexCount);
+		std::iota(indices.begin(), indices.end(), 0u);
+	}
+
+	Triangulate(mode, indices);
+
+	// new vertex -> vertex of the primitive as it was
+	std::vector<uint32_t> remap(vertexCount);
+	std::iota(remap.begin(), remap.end(), 0u);
+	bool remapped = false;
+
+	if (makeNormals && options.normalMode == EGLTF::EGLTFNormalMode::FLAT && (primitive.indices != -1 || triangulate))
+	{
+		remap = indices;
+		std::iota(indices.begin(), indices.end(), 0u);
+		positions = Gather(positions, 3, remap);
+		remapped = true;
+	}
+
+	std::vector<float> normals;
+	if (makeNormals)
+	{
+		if (options.normalMode == EGLTF::EGLTFNormalMode::FLAT)
+			ComputeFlatNormals(context, positions, indices, normals);
+		else
+			ComputeSmoothNormals(context, positions, indices, normals);
+	}
+	else if (makeTangents)
+	{
+		if (!EGLTF::ReadGLTFAccessor(asset, normal->second, normals, true) || normals.size() != static_cast<size_t>(vertexCount) * 3)
+		{
+			fprintf(stderr, "\nError: NORMAL of mesh %d primitive %d does not match its POSITION\n", out.mesh, out.primitive);
+			return;
+		}
+		if (remapped)
+			normals = Gather(normals, 3, remap);
+
+		for (size_t v = 0; v < normals.size() / 3; ++v)
+		{
+			SVec3 n = Load3(normals, v);
+			if (NormalizeVec(n))
+				Store3(normals, v, n);
+		}
+	}
+
+	std::vector<float> tangents;
+	if (makeTangents)
+	{
+		std::vector<float> uvs;
+		if (!EGLTF::ReadGLTFAccessor(asset, uv->second, uvs, true) || uvs.size() != static_cast<size_t>(vertexCount) * 2)
+		{
+			fprintf(stderr, "\nError: TEXCOORD_0 of mesh %d primitive %d does not match its POSITION\n", out.mesh, out.primitive);
+			return;
+		}
+		if (remapped)
+			uvs = Gather(uvs, 2, remap);
+
+		const size_t before = remap.size();
+		ComputeTangents(context, positions, normals, uvs, indices, remap, tangents);
+		remapped = remapped || remap.size() != before;
+	}
+
+	if (remapped)
+	{
+		for (const auto& attribute : primitive.attributes)
+			if (!GatherAccessor(asset, attribute.second, remap, out, out.result.attributes[attribute.first]))
+				return;
+
+		for (size_t t = 0; t < primitive.targets.size(); ++t)
+			for (const auto& attribute : primitive.targets[t])
+				if (!GatherAccessor(asset, attribute.second, remap, out, out.result.targets[t][attribute.first]))
+					return;
+	}
+
+	if (makeNormals)
+		out.result.attributes["NORMAL"] = out.AddFloats(normals, 3, "VEC3", false);
+	if (makeTangents)
+		out.result.attributes["TANGENT"] = out.AddFloats(tangents, 4, "VEC4", false);
+
+	if (triangulate || remapped)
+	{
+		// the largest value of a type is reserved for primitive restart
+		EGLTF::SGLTFAsset_Prop_Accessor accessor;
+		accessor.type = "SCALAR";
+		accessor.count = static_cast<int64_t>(indices.size());
+
+		if (remap.size() < 0xFFFF)
+		{
+			std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+			accessor.componentType = 5123;
+			out.result.indices = out.Add(shortIndices.data(), shortIndices.size() * 2, 0, ELEMENT_ARRAY_BUFFER, accessor);
+		}
+		else
+		{
+			accessor.componentType = 5125;
+			out.result.indices = out.Add(indices.data(), indices.size() * 4, 0, ELEMENT_ARRAY_BUFFER, accessor);
+		}
+		out.result.mode = 4;
+	}
+
+	out.changed = true;
+	out.failed = false;
+}
+
+bool EGLTF::GenerateGLTFGeometry(SGLTFAsset& asset, const SGLTFGeometryOptions& options, CGLTFThreadPool* pool)
+{
+	std::vector<SGeneratedPrimitive> work;
+	for (size_t m = 0; m < asset.meshes.size(); ++m)
+	{
+		for (size_t p = 0; p < asset.meshes[m].primitives.size(); ++p)
+		{
+			SGeneratedPrimitive primitive;
+			primitive.mesh = static_cast<int32_t>(m);
+			primitive.primitive = static_cast<int32_t>(p);
+			work.push_back(primitive);
+		}
+	}
+
+	SGeometryContext context = { pool, std::max<size_t>(options.grain, 1) };
+	auto process = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			ProcessPrimitive(asset, options, context, work[i]);
+	};
+
+	if (pool && work.size() > 1)
+		pool->ParallelFor(work.size(), 1, process);
+	else
+		process(0, work.size());
+
+	bool result = true;
+	SGLTFAsset_Prop_Buffer buffer;
+	const int32_t bufferIndex = static_cast<int32_t>(asset.buffers.size());
+
+	for (SGeneratedPrimitive& generated : work)
+	{
+		if (generated.failed)
+			result = false;
+		if (!generated.changed)
+			continue;
+
+		buffer.data.resize((buffer.data.size() + 3) & ~size_t(3), 0);
+		const int32_t dataBase = static_cast<int32_t>(buffer.data.size());
+		const int32_t viewBase = static_cast<int32_t>(asset.bufferViews.size());
+		const int32_t accessorBase = static_cast<int32_t>(asset.accessors.size());
+
+		buffer.data.insert(buffer.data.end(), generated.data.begin(), generated.data.end());
+
+		for (SGLTFAsset_Prop_BufferView view : generated.views)
+		{
+			view.buffer = bufferIndex;
+			view.byteOffset += dataBase;
+			asset.bufferViews.push_back(view);
+		}
+
+		for (SGLTFAsset_Prop_Accessor accessor : generated.accessors)
+		{
+			accessor.bufferView += viewBase;
+			asset.accessors.push_back(accessor);
+		}
+
+		auto resolve = [accessorBase](int32_t& index)
+		{
+			if (index < -1)
+				index = accessorBase + (-2 - index);
+		};
+
+		SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[generated.mesh].primitives[generated.primitive];
+		primitive = generated.result;
+		resolve(primitive.indices);
+		for (auto& attribute : primitive.attributes)
+			resolve(attribute.second);
+		for (auto& target : primitive.targets)
+			for (auto& attribute : target)
+				resolve(attribute.second);
+	}
+
+	if (!buffer.data.empty())
+	{
+		buffer.byteLength = static_cast<int64_t>(buffer.data.size());
+		asset.buffers.push_back(std::move(buffer));
+	}
+
+	return result;
+}
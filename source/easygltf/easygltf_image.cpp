@@ -0,0 +1,1493 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_image.h"
+
+#include "base64.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static uint32_t ReadBE32(const uint8_t* p)
+{
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static void WriteBE32(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint8_t ClampByte(int value)
+{
+	return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// ---- inflate ----
+
+// Deflate reads bits from the least significant end of every byte
+class CInflateBits
+{
+public:
+	CInflateBits(const uint8_t* data, size_t size) : m_data(data), m_end(data + size) {}
+
+	uint32_t Peek(uint32_t count)
+	{
+		Fill();
+		return static_cast<uint32_t>(m_bits & ((uint64_t(1) << count) - 1));
+	}
+
+	void Skip(uint32_t count)
+	{
+		m_bits >>= count;
+		m_count -= count;
+	}
+
+	uint32_t Read(uint32_t count)
+	{
+		if (count == 0)
+			return 0;
+		const uint32_t value = Peek(count);
+		Skip(count);
+		return value;
+	}
+
+	void AlignToByte() { Skip(m_count & 7); }
+
+	// Past the end of the data only zeros come in, a stream that needs them is broken
+	bool IsOverrun() const { return m_padding * 8 > m_count; }
+
+private:
+	void Fill()
+	{
+		while (m_count <= 56)
+		{
+			uint64_t byte = 0;
+			if (m_data < m_end)
+				byte = *m_data++;
+			else
+				++m_padding;
+			m_bits |= byte << m_count;
+			m_count += 8;
+		}
+	}
+
+	const uint8_t* m_data;
+	const uint8_t* m_end;
+	uint64_t m_bits = 0;
+	uint32_t m_count = 0;
+	uint32_t m_padding = 0;
+};
+
+// Codes up to 9 bits come from one lookup, longer ones are found from the canonical code ranges
+struct SInflateTable
+{
+	uint16_t fast[512]; // (length << 9) | symbol, 0 where the code is longer
+	uint16_t firstCode[17];
+	uint16_t firstSymbol[17];
+	uint32_t maxCode[18]; // first code past the codes of a length, left aligned to 16 bits
+	uint16_t symbols[288];
+
+	bool Build(const uint8_t* lengths, uint32_t count)
+	{
+		uint32_t sizes[17] = {};
+		for (uint32_t i = 0; i < count; ++i)
+			++sizes[lengths[i]];
+		sizes[0] = 0;
+
+		memset(fast, 0, sizeof(fast));
+
+		uint32_t nextCode[16];
+		uint32_t code = 0;
+		uint32_t symbol = 0;
+		for (uint32_t length = 1; length < 16; ++length)
+		{
+			nextCode[length] = code;
+			firstCode[length] = static_cast<uint16_t>(code);
+			firstSymbol[length] = static_cast<uint16_t>(symbol);
+			code += sizes[length];
+			if (sizes[length] && code - 1 >= (1u << length))
+				return false;
+			maxCode[length] = code << (16 - length);
+			code <<= 1;
+			symbol += sizes[length];
+		}
+		maxCode[16] = 0x10000;
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint32_t length = lengths[i];
+			if (length == 0)
+				continue;
+
+			symbols[nextCode[length] - firstCode[length] + firstSymbol[length]] = static_cast<uint16_t>(i);
+			if (length <= 9)
+			{
+				uint32_t reversed = 0;
+				for (uint32_t b = 0; b < length; ++b)
+					reversed |= ((nextCode[length] >> b) & 1) << (length - 1 - b);
+				for (uint32_t j = reversed; j < 512; j += 1u << length)
+					fast[j] = static_cast<uint16_t>((length << 9) | i);
+			}
+			++nextCode[length];
+		}
+		return true;
+	}
+
+	int Decode(CInflateBits& bits) const
+	{
+		const uint32_t peek = bits.Peek(16);
+		const uint16_t entry = fast[peek & 511];
+		if (entry)
+		{
+			bits.Skip(entry >> 9);
+			return entry & 511;
+		}
+
+		uint32_t reversed = 0;
+		for (uint32_t b = 0; b < 16; ++b)
+			reversed |= ((peek >> b) & 1) << (15 - b);
+
+		uint32_t length = 10;
+		while (reversed >= maxCode[length])
+			++length;
+		if (length >= 16)
+			return -1;
+
+		bits.Skip(length);
+		return symbols[(reversed >> (16 - length)) - firstCode[length] + firstSymbol[length]];
+	}
+};
+
+static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+	6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// A zlib stream into out, which has to be exactly the size of the inflated data (PNG knows it up front)
+static bool Inflate(const uint8_t* data, size_t size, uint8_t* out, size_t outSize)
+{
+	if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+		return false;
+
+	CInflateBits bits(data + 2, size - 2);
+	size_t written = 0;
+
+	SInflateTable literals;
+	SInflateTable distances;
+	bool last = false;
+
+	while (!last)
+	{
+		last = bits.Read(1) != 0;
+		const uint32_t type = bits.Read(2);
+
+		if (type == 0)
+		{
+			bits.AlignToByte();
+			const uint32_t length = bits.Read(16);
+			if ((length ^ 0xFFFF) != bits.Read(16) || written + length > outSize)
+				return false;
+			for (uint32_t i = 0; i < length; ++i)
+				out[written++] = static_cast<uint8_t>(bits.Read(8));
+			continue;
+		}
+
+		uint8_t lengths[288 + 32];
+		if (type == 1)
+		{
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 32);
+			literals.Build(lengths, 288);
+			distances.Build(lengths + 288, 32);
+		}
+		else if (type == 2)
+		{
+			const uint32_t literalCount = bits.Read(5) + 257;
+			const uint32_t distanceCount = bits.Read(5) + 1;
+			const uint32_t codeLengthCount = bits.Read(4) + 4;
+
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			uint8_t codeLengths[19] = {};
+			for (uint32_t i = 0; i < codeLengthCount; ++i)
+				codeLengths[order[i]] = static_cast<uint8_t>(bits.Read(3));
+
+			SInflateTable codeLengthTable;
+			if (!codeLengthTable.Build(codeLengths, 19))
+				return false;
+
+			uint32_t n = 0;
+			while (n < literalCount + distanceCount)
+			{
+				const int symbol = codeLengthTable.Decode(bits);
+				if (symbol < 0)
+					return false;
+
+				if (symbol < 16)
+				{
+					lengths[n++] = static_cast<uint8_t>(symbol);
+					continue;
+				}
+
+				uint8_t value = 0;
+				uint32_t repeat;
+				if (symbol == 16)
+				{
+					if (n == 0)
+						return false;
+					value = lengths[n - 1];
+					repeat = 3 + bits.Read(2);
+				}
+				else if (symbol == 17)
+					repeat = 3 + bits.Read(3);
+				else
+					repeat = 11 + bits.Read(7);
+
+				if (n + repeat > literalCount + distanceCount)
+					return false;
+				memset(lengths + n, value, repeat);
+				n += repeat;
+			}
+
+			if (!literals.Build(lengths, literalCount) || !distances.Build(lengths + literalCount, distanceCount))
+				return false;
+		}
+		else
+			return false;
+
+		for (;;)
+		{
+			const int symbol = literals.Decode(bits);
+			if (symbol < 0)
+				return false;
+
+			if (symbol < 256)
+			{
+				if (written >= outSize)
+					return false;
+				out[written++] = static_cast<uint8_t>(symbol);
+				continue;
+			}
+			if (symbol == 256)
+				break;
+			if (symbol > 285)
+				return false;
+
+			const uint32_t length = LENGTH_BASE[symbol - 257] + bits.Read(LENGTH_EXTRA[symbol - 257]);
+			const int distanceSymbol = distances.Decode(bits);
+			if (distanceSymbol < 0 || distanceSymbol > 29)
+				return false;
+			const uint32_t distance = DISTANCE_BASE[distanceSymbol] + bits.Read(DISTANCE_EXTRA[distanceSymbol]);
+
+			if (distance > written || written + length > outSize)
+				return false;
+
+			// overlapping copies repeat the last bytes, byte by byte on purpose
+			const uint8_t* from = out + written - distance;
+			uint8_t* to = out + written;
+			for (uint32_t i = 0; i < length; ++i)
+				to[i] = from[i];
+			written += length;
+		}
+
+		if (bits.IsOverrun())
+			return false;
+	}
+
+	return written == outSize;
+}
+
+// ---- PNG ----
+
+static const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+static uint8_t Paeth(int a, int b, int c)
+{
+	const int p = a + b - c;
+	const int pa = std::abs(p - a);
+	const int pb = std::abs(p - b);
+	const int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return static_cast<uint8_t>(a);
+	return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+static bool DecodePNG(const uint8_t* data, size_t size, EGLTF::SGLTFBitmap& out)
+{
+	uint32_t width = 0, height = 0;
+	uint8_t bitDepth = 0, colorType = 0, interlace = 0;
+	uint8_t palette[256][4];
+	uint32_t paletteSize = 0;
+	uint16_t colorKey[3] = {};
+	bool hasColorKey = false;
+	std::vector<uint8_t> compressed;
+
+	for (uint32_t i = 0; i < 256; ++i)
+		palette[i][0] = palette[i][1] = palette[i][2] = 0, palette[i][3] = 255;
+
+	size_t pos = 8;
+	bool ended = false;
+	while (!ended && pos + 12 <= size)
+	{
+		const uint32_t length = ReadBE32(data + pos);
+		const uint8_t* type = data + pos + 4;
+		const uint8_t* chunk = data + pos + 8;
+		if (length > size - pos - 12)
+			break;
+
+		if (!memcmp(type, "IHDR", 4) && length >= 13)
+		{
+			width = ReadBE32(chunk);
+			height = ReadBE32(chunk + 4);
+			bitDepth = chunk[8];
+			colorType = chunk[9];
+			interlace = chunk[12];
+		}
+		else if (!memcmp(type, "PLTE", 4))
+		{
+			paletteSize = std::min<uint32_t>(length / 3, 256);
+			for (uint32_t i = 0; i < paletteSize; ++i)
+				palette[i][0] = chunk[i * 3], palette[i][1] = chunk[i * 3 + 1], palette[i][2] = chunk[i * 3 + 2];
+		}
+		else if (!memcmp(type, "tRNS", 4))
+		{
+			if (colorType == 3)
+			{
+				for (uint32_t i = 0; i < std::min<uint32_t>(length, 256); ++i)
+					palette[i][3] = chunk[i];
+			}
+			else if (colorType == 0 && length >= 2)
+			{
+				colorKey[0] = static_cast<uint16_t>((chunk[0] << 8) | chunk[1]);
+				hasColorKey = true;
+			}
+			else if (colorType == 2 && length >= 6)
+			{
+				for (int c = 0; c < 3; ++c)
+					colorKey[c] = static_cast<uint16_t>((chunk[c * 2] << 8) | chunk[c * 2 + 1]);
+				hasColorKey = true;
+			}
+		}
+		else if (!memcmp(type, "IDAT", 4))
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		else if (!memcmp(type, "IEND", 4))
+			ended = true;
+
+		pos += 12 + length;
+	}
+
+	static const uint8_t channelsOf[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	const uint32_t channels = colorType <= 6 ? channelsOf[colorType] : 0;
+	if (width == 0 || height == 0 || width > 32768 || height > 32768 || channels == 0 ||
+		(bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16) || ((colorType == 2 || colorType == 4 || colorType == 6) && bitDepth < 8) ||
+		(colorType == 3 && bitDepth == 16))
+	{
+		fprintf(stderr, "\nError: PNG header is broken or not supported\n");
+		return false;
+	}
+	if (interlace)
+	{
+		fprintf(stderr, "\nError: interlaced PNGs are not supported\n");
+		return false;
+	}
+
+	const size_t bitsPerPixel = channels * bitDepth;
+	const size_t stride = (width * bitsPerPixel + 7) / 8;
+	const size_t bytesPerPixel = std::max<size_t>(1, bitsPerPixel / 8);
+
+	std::vector<uint8_t> raw(height * (stride + 1));
+	if (!Inflate(compressed.data(), compressed.size(), raw.data(), raw.size()))
+	{
+		fprintf(stderr, "\nError: PNG image data is broken\n");
+		return false;
+	}
+
+	// undo the filters in place, every row starts with its filter type
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		uint8_t* row = &raw[y * (stride + 1) + 1];
+		const uint8_t* previous = y > 0 ? &raw[(y - 1) * (stride + 1) + 1] : nullptr;
+		const uint8_t filter = row[-1];
+
+		for (size_t x = 0; x < stride; ++x)
+		{
+			const int a = x >= bytesPerPixel ? row[x - bytesPerPixel] : 0;
+			const int b = previous ? previous[x] : 0;
+			const int c = previous && x >= bytesPerPixel ? previous[x - bytesPerPixel] : 0;
+
+			switch (filter)
+			{
+			case 0: break;
+			case 1: row[x] = static_cast<uint8_t>(row[x] + a); break;
+			case 2: row[x] = static_cast<uint8_t>(row[x] + b); break;
+			case 3: row[x] = static_cast<uint8_t>(row[x] + ((a + b) >> 1)); break;
+			case 4: row[x] = static_cast<uint8_t>(row[x] + Paeth(a, b, c)); break;
+			default:
+				fprintf(stderr, "\nError: PNG row filter %u does not exist\n", filter);
+				return false;
+			}
+		}
+	}
+
+	out.width = width;
+	out.height = height;
+	out.rgba.resize(size_t(width) * height * 4);
+
+	const uint32_t maxValue = (1u << std::min<uint32_t>(bitDepth, 16)) - 1;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const uint8_t* row = &raw[y * (stride + 1) + 1];
+		uint8_t* pixel = &out.rgba[size_t(y) * width * 4];
+
+		// sample c of pixel x at its own bit depth
+		auto sample = [&](uint32_t x, uint32_t c) -> uint32_t
+		{
+			const size_t index = size_t(x) * channels + c;
+			if (bitDepth == 8)
+				return row[index];
+			if (bitDepth == 16)
+				return (uint32_t(row[index * 2]) << 8) | row[index * 2 + 1];
+			const size_t bit = index * bitDepth;
+			return (row[bit / 8] >> (8 - bitDepth - bit % 8)) & maxValue;
+		};
+		auto toByte = [&](uint32_t value) { return static_cast<uint8_t>(bitDepth == 16 ? value >> 8 : value * 255 / maxValue); };
+
+		for (uint32_t x = 0; x < width; ++x, pixel += 4)
+		{
+			switch (colorType)
+			{
+			case 0:
+			{
+				const uint32_t gray = sample(x, 0);
+				pixel[0] = pixel[1] = pixel[2] = toByte(gray);
+				pixel[3] = hasColorKey && gray == colorKey[0] ? 0 : 255;
+				break;
+			}
+			case 2:
+			{
+				const uint32_t r = sample(x, 0), g = sample(x, 1), b = sample(x, 2);
+				pixel[0] = toByte(r), pixel[1] = toByte(g), pixel[2] = toByte(b);
+				pixel[3] = hasColorKey && r == colorKey[0] && g == colorKey[1] && b == colorKey[2] ? 0 : 255;
+				break;
+			}
+			case 3:
+			{
+				const uint32_t index = sample(x, 0);
+				memcpy(pixel, palette[index], 4);
+				break;
+			}
+			case 4:
+				pixel[0] = pixel[1] = pixel[2] = toByte(sample(x, 0));
+				pixel[3] = toByte(sample(x, 1));
+				break;
+			case 6:
+				for (uint32_t c = 0; c < 4; ++c)
+					pixel[c] = toByte(sample(x, c));
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+// ---- JPEG ----
+
+static const uint8_t ZIGZAG[64 + 16] = { 0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21,
+	28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+	// broken streams can run past the last coefficient, they land here
+	63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63 };
+
+struct SJpegHuffman
+{
+	uint8_t fastLength[512]; // 0 where the code is longer than 9 bits
+	uint8_t fastSymbol[512];
+	int32_t maxCode[18]; // largest code of a length, -1 for none
+	int32_t offset[17]; // symbol index minus code for a length
+	uint8_t symbols[256];
+	bool defined = false;
+
+	bool Build(const uint8_t counts[16], const uint8_t* values, uint32_t total)
+	{
+		memcpy(symbols, values, total);
+		memset(fastLength, 0, sizeof(fastLength));
+
+		int32_t code = 0;
+		uint32_t k = 0;
+		for (uint32_t length = 1; length <= 16; ++length)
+		{
+			offset[length] = static_cast<int32_t>(k) - code;
+			for (uint32_t i = 0; i < counts[length - 1]; ++i, ++k, ++code)
+			{
+				if (length <= 9)
+				{
+					// JPEG codes are read from the most significant bit, the table is indexed the same way
+					const uint32_t first = static_cast<uint32_t>(code) << (9 - length);
+					for (uint32_t j = 0; j < (1u << (9 - length)); ++j)
+					{
+						fastLength[first + j] = static_cast<uint8_t>(length);
+						fastSymbol[first + j] = symbols[k];
+					}
+				}
+			}
+			maxCode[length] = counts[length - 1] ? code - 1 : -1;
+			if (code > (1 << length))
+				return false;
+			code <<= 1;
+		}
+		maxCode[17] = INT32_MAX;
+		defined = true;
+		return true;
+	}
+};
+
+// Entropy coded data, with the stuffed zero bytes dropped. Stops at a marker and feeds zeros from there on.
+class CJpegBits
+{
+public:
+	CJpegBits(const uint8_t* data, size_t size, size_t pos) : m_data(data), m_size(size), m_pos(pos) {}
+
+	uint32_t Peek(uint32_t count)
+	{
+		Fill();
+		return static_cast<uint32_t>(m_bits >> (64 - count));
+	}
+
+	void Skip(uint32_t count)
+	{
+		m_bits <<= count;
+		m_count -= count;
+	}
+
+	uint32_t Read(uint32_t count)
+	{
+		if (count == 0)
+			return 0;
+		const uint32_t value = Peek(count);
+		Skip(count);
+		return value;
+	}
+
+	// a value of count bits, sign extended the way JPEG does it
+	int32_t Receive(uint32_t count)
+	{
+		if (count == 0)
+			return 0;
+		const int32_t value = static_cast<int32_t>(Read(count));
+		return value < (1 << (count - 1)) ? value - (1 << count) + 1 : value;
+	}
+
+	int Decode(const SJpegHuffman& table)
+	{
+		const uint32_t peek = Peek(16);
+		const uint32_t fast = peek >> 7;
+		if (table.fastLength[fast])
+		{
+			Skip(table.fastLength[fast]);
+			return table.fastSymbol[fast];
+		}
+
+		for (uint32_t length = 10; length <= 16; ++length)
+		{
+			const int32_t code = static_cast<int32_t>(peek >> (16 - length));
+			if (code <= table.maxCode[length])
+			{
+				Skip(length);
+				return table.symbols[(code + table.offset[length]) & 0xFF];
+			}
+		}
+		return -1;
+	}
+
+	// Drops what is left of the current byte and steps over the RSTn marker
+	bool Restart()
+	{
+		m_bits = 0;
+		m_count = 0;
+		if (m_marker == 0)
+		{
+			// the data may not have reached the marker yet
+			while (m_pos + 1 < m_size && !(m_data[m_pos] == 0xFF && m_data[m_pos + 1] != 0 && m_data[m_pos + 1] != 0xFF))
+				++m_pos;
+			if (m_pos + 1 >= m_size)
+				return false;
+			m_marker = m_data[m_pos + 1];
+			m_pos += 2;
+		}
+		const bool isRestart = m_marker >= 0xD0 && m_marker <= 0xD7;
+		m_marker = 0;
+		return isRestart;
+	}
+
+	// Where the data ended, at the marker that follows it
+	size_t End()
+	{
+		if (m_marker)
+			return m_pos - 2;
+		while (m_pos + 1 < m_size && !(m_data[m_pos] == 0xFF && m_data[m_pos + 1] != 0 && !(m_data[m_pos + 1] >= 0xD0 && m_data[m_pos + 1] <= 0xD7)))
+			++m_pos;
+		return m_pos;
+	}
+
+private:
+	void Fill()
+	{
+		while (m_count <= 56)
+		{
+			uint64_t byte = 0;
+			if (m_marker == 0 && m_pos < m_size)
+			{
+				byte = m_data[m_pos];
+				if (byte == 0xFF)
+				{
+					// 0xFF 0x00 is a literal 0xFF, 0xFF 0xFF is fill, anything else a marker
+					size_t next = m_pos + 1;
+					while (next < m_size && m_data[next] == 0xFF)
+						++next;
+					if (next < m_size && m_data[next] == 0)
+						m_pos = next + 1;
+					else
+					{
+						m_marker = next < m_size ? m_data[next] : 0xD9;
+						m_pos = next + 1;
+						byte = 0;
+					}
+				}
+				else
+					++m_pos;
+			}
+			m_bits |= byte << (56 - m_count);
+			m_count += 8;
+		}
+	}
+
+	const uint8_t* m_data;
+	size_t m_size;
+	size_t m_pos;
+	uint64_t m_bits = 0;
+	uint32_t m_count = 0;
+	uint8_t m_marker = 0;
+};
+
+struct SJpegComponent
+{
+	uint8_t id;
+	uint32_t h, v; // sampling factors
+	uint32_t quant;
+	uint32_t blocksWide, blocksHigh; // padded to whole MCUs
+	std::vector<int16_t> coefficients; // 64 per block in natural order, not dequantized
+	SJpegHuffman* dc = nullptr;
+	SJpegHuffman* ac = nullptr;
+	int32_t predictor = 0;
+};
+
+// 8x8 inverse DCT into a plane, separable and in float
+static void InverseDCT(const int16_t* coefficients, const uint16_t* quant, uint8_t* out, size_t stride)
+{
+	static const struct SCosines
+	{
+		float values[8][8]; // [x][u], with the 1/sqrt(2) of u = 0 and the 1/2 folded in
+
+		SCosines()
+		{
+			for (int x = 0; x < 8; ++x)
+				for (int u = 0; u < 8; ++u)
+					values[x][u] = static_cast<float>((u == 0 ? std::sqrt(0.5) : 1.0) * 0.5 * std::cos((2 * x + 1) * u * 3.14159265358979323846 / 16.0));
+		}
+	} cosines;
+
+	float block[64];
+	for (int i = 0; i < 64; ++i)
+		block[i] = static_cast<float>(coefficients[i] * quant[i]);
+
+	// columns, most of them are all zero below the first row
+	float columns[64];
+	for (int u = 0; u < 8; ++u)
+	{
+		bool zero = true;
+		for (int v = 1; v < 8 && zero; ++v)
+			zero = block[v * 8 + u] == 0.0f;
+
+		for (int y = 0; y < 8; ++y)
+		{
+			if (zero)
+			{
+				columns[y * 8 + u] = block[u] * cosines.values[y][0];
+				continue;
+			}
+			float sum = 0.0f;
+			for (int v = 0; v < 8; ++v)
+				sum += block[v * 8 + u] * cosines.values[y][v];
+			columns[y * 8 + u] = sum;
+		}
+	}
+
+	for (int y = 0; y < 8; ++y)
+	{
+		for (int x = 0; x < 8; ++x)
+		{
+			float sum = 0.0f;
+			for (int u = 0; u < 8; ++u)
+				sum += columns[y * 8 + u] * cosines.values[x][u];
+			out[y * stride + x] = ClampByte(static_cast<int>(std::floor(sum + 128.5f)));
+		}
+	}
+}
+
+static bool DecodeJPEG(const uint8_t* data, size_t size, EGLTF::SGLTFBitmap& out)
+{
+	uint16_t quant[4][64];
+	SJpegHuffman dcTables[4], acTables[4];
+	std::vector<SJpegComponent> components;
+	uint32_t width = 0, height = 0, hMax = 1, vMax = 1, mcusWide = 0, mcusHigh = 0;
+	uint32_t restartInterval = 0;
+	bool progressive = false;
+	bool frame = false;
+	int adobeTransform = -1;
+
+	for (int t = 0; t < 4; ++t)
+		for (int i = 0; i < 64; ++i)
+			quant[t][i] = 1;
+
+	auto fail = [](const char* message)
+	{
+		fprintf(stderr, "\nError: JPEG %s\n", message);
+		return false;
+	};
+
+	size_t pos = 2;
+	for (;;)
+	{
+		// markers can be padded with any number of 0xFF
+		while (pos < size && data[pos] == 0xFF && pos + 1 < size && data[pos + 1] == 0xFF)
+			++pos;
+		if (pos + 2 > size || data[pos] != 0xFF)
+			return fail("stream is broken");
+
+		const uint8_t marker = data[pos + 1];
+		if (marker == 0xD9)
+			break;
+		if (marker >= 0xD0 && marker <= 0xD7)
+		{
+			pos += 2;
+			continue;
+		}
+		if (pos + 4 > size)
+			return fail("stream is broken");
+
+		const uint32_t length = (uint32_t(data[pos + 2]) << 8) | data[pos + 3];
+		const uint8_t* segment = data + pos + 4;
+		if (length < 2 || pos + 2 + length > size)
+			return fail("segment is cut off");
+		const uint32_t payload = length - 2;
+		pos += 2 + length;
+
+		if (marker == 0xDB)
+		{
+			for (uint32_t p = 0; p < payload;)
+			{
+				const uint32_t precision = segment[p] >> 4;
+				const uint32_t table = segment[p] & 3;
+				++p;
+				if (p + 64 * (precision + 1) > payload)
+					return fail("quantization table is cut off");
+				for (int i = 0; i < 64; ++i)
+				{
+					quant[table][ZIGZAG[i]] = precision ? static_cast<uint16_t>((segment[p] << 8) | segment[p + 1]) : segment[p];
+					p += precision + 1;
+				}
+			}
+		}
+		else if (marker == 0xC4)
+		{
+			for (uint32_t p = 0; p < payload;)
+			{
+				if (p + 17 > payload)
+					return fail("huffman table is cut off");
+				const uint32_t tableClass = segment[p] >> 4;
+				const uint32_t table = segment[p] & 3;
+				const uint8_t* counts = segment + p + 1;
+				uint32_t total = 0;
+				for (int i = 0; i < 16; ++i)
+					total += counts[i];
+				if (total > 256 || p + 17 + total > payload)
+					return fail("huffman table is cut off");
+				if (!(tableClass ? acTables : dcTables)[table].Build(counts, segment + p + 17, total))
+					return fail("huffman table is broken");
+				p += 17 + total;
+			}
+		}
+		else if (marker == 0xDD)
+		{
+			if (payload >= 2)
+				restartInterval = (uint32_t(segment[0]) << 8) | segment[1];
+		}
+		else if (marker == 0xEE)
+		{
+			if (payload >= 12 && !memcmp(segment, "Adobe", 5))
+				adobeTransform = segment[11];
+		}
+		else if (marker == 0xC0 || marker == 0xC1 || marker == 0xC2)
+		{
+			if (frame || payload < 6 || segment[0] != 8)
+				return fail("frame is not supported, only 8 bit samples are");
+
+			progressive = marker == 0xC2;
+			height = (uint32_t(segment[1]) << 8) | segment[2];
+			width = (uint32_t(segment[3]) << 8) | segment[4];
+			const uint32_t count = segment[5];
+			if (width == 0 || height == 0 || (count != 1 && count != 3) || payload < 6 + count * 3)
+				return fail("frame is not supported, only grayscale and 3 component images are");
+
+			components.resize(count);
+			for (uint32_t c = 0; c < count; ++c)
+			{
+				components[c].id = segment[6 + c * 3];
+				components[c].h = segment[7 + c * 3] >> 4;
+				components[c].v = segment[7 + c * 3] & 15;
+				components[c].quant = segment[8 + c * 3] & 3;
+				if (components[c].h < 1 || components[c].h > 4 || components[c].v < 1 || components[c].v > 4)
+					return fail("sampling factors are broken");
+				hMax = std::max(hMax, components[c].h);
+				vMax = std::max(vMax, components[c].v);
+			}
+
+			mcusWide = (width + 8 * hMax - 1) / (8 * hMax);
+			mcusHigh = (height + 8 * vMax - 1) / (8 * vMax);
+			for (auto& component : components)
+			{
+				component.blocksWide = mcusWide * component.h;
+				component.blocksHigh = mcusHigh * component.v;
+				component.coefficients.assign(size_t(component.blocksWide) * component.blocksHigh * 64, 0);
+			}
+			frame = true;
+		}
+		else if ((marker >= 0xC3 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC))
+			return fail("is lossless, hierarchical or arithmetic coded, which is not supported");
+		else if (marker == 0xDA)
+		{
+			if (!frame || payload < 1)
+				return fail("scan comes before the frame");
+
+			const uint32_t count = segment[0];
+			if (count < 1 || count > 4 || payload < 4 + count * 2)
+				return fail("scan header is broken");
+
+			SJpegComponent* scan[4];
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const uint8_t id = segment[1 + i * 2];
+				const uint8_t tables = segment[2 + i * 2];
+				scan[i] = nullptr;
+				for (auto& component : components)
+					if (component.id == id)
+						scan[i] = &component;
+				if (!scan[i])
+					return fail("scan refers to a component that does not exist");
+				scan[i]->dc = &dcTables[tables >> 4];
+				scan[i]->ac = &acTables[tables & 3];
+				scan[i]->predictor = 0;
+			}
+
+			const uint32_t start = segment[1 + count * 2];
+			const uint32_t end = std::min<uint32_t>(segment[2 + count * 2], 63);
+			const uint32_t high = segment[3 + count * 2] >> 4;
+			const uint32_t low = segment[3 + count * 2] & 15;
+			if (!progressive && (start != 0 || end != 63))
+				return fail("baseline scan does not cover every coefficient");
+			if (start > end || (start == 0 && end != 0 && progressive))
+				return fail("progressive scan mixes DC and AC coefficients");
+
+			for (uint32_t i = 0; i < count; ++i)
+				if ((start == 0 && high == 0 && !scan[i]->dc->defined) || ((start > 0 || !progressive) && !scan[i]->ac->defined))
+					return fail("scan uses a huffman table that was not defined");
+
+			CJpegBits bits(data, size, pos);
+			uint32_t eobRun = 0;
+
+			auto decodeBlock = [&](SJpegComponent& component, int16_t* block) -> bool
+			{
+				if (!progressive)
+				{
+					const int t = bits.Decode(*component.dc);
+					if (t < 0 || t > 16)
+						return false;
+					component.predictor += bits.Receive(t);
+					block[0] = static_cast<int16_t>(component.predictor);
+
+					for (uint32_t k = 1; k < 64;)
+					{
+						const int rs = bits.Decode(*component.ac);
+						if (rs < 0)
+							return false;
+						const uint32_t r = rs >> 4, s = rs & 15;
+						if (s == 0)
+						{
+							if (r != 15)
+								break;
+							k += 16;
+							continue;
+						}
+						k += r;
+						block[ZIGZAG[k]] = static_cast<int16_t>(bits.Receive(s));
+						++k;
+					}
+					return true;
+				}
+
+				if (start == 0)
+				{
+					if (high == 0)
+					{
+						const int t = bits.Decode(*component.dc);
+						if (t < 0 || t > 16)
+							return false;
+						component.predictor += bits.Receive(t);
+						block[0] = static_cast<int16_t>(component.predictor * (1 << low));
+					}
+					else if (bits.Read(1))
+						block[0] = static_cast<int16_t>(block[0] | (1 << low));
+					return true;
+				}
+
+				if (high == 0)
+				{
+					// first pass over a band
+					if (eobRun > 0)
+					{
+						--eobRun;
+						return true;
+					}
+					for (uint32_t k = start; k <= end;)
+					{
+						const int rs = bits.Decode(*component.ac);
+						if (rs < 0)
+							return false;
+						const uint32_t r = rs >> 4, s = rs & 15;
+						if (s == 0)
+						{
+							if (r < 15)
+							{
+								eobRun = (1u << r) - 1 + bits.Read(r);
+								break;
+							}
+							k += 16;
+							continue;
+						}
+						k += r;
+						block[ZIGZAG[k]] = static_cast<int16_t>(bits.Receive(s) * (1 << low));
+						++k;
+					}
+					return true;
+				}
+
+				// refinement: one more bit for coefficients that are there already, new ones are +-1 at this bit
+				const int16_t plus = static_cast<int16_t>(1 << low);
+				const int16_t minus = static_cast<int16_t>(-1 * (1 << low));
+				auto refine = [&](int16_t& coefficient)
+				{
+					if (bits.Read(1) && (coefficient & plus) == 0)
+						coefficient = static_cast<int16_t>(coefficient + (coefficient >= 0 ? plus : minus));
+				};
+
+				uint32_t k = start;
+				if (eobRun == 0)
+				{
+					for (; k <= end; ++k)
+					{
+						const int rs = bits.Decode(*component.ac);
+						if (rs < 0)
+							return false;
+						int32_t r = rs >> 4;
+						const uint32_t s = rs & 15;
+						int16_t value = 0;
+						if (s)
+							value = bits.Read(1) ? plus : minus;
+						else if (r != 15)
+						{
+							eobRun = (1u << r) + bits.Read(r);
+							break;
+						}
+
+						for (; k <= end; ++k)
+						{
+							int16_t& coefficient = block[ZIGZAG[k]];
+							if (coefficient != 0)
+								refine(coefficient);
+							else if (--r < 0)
+								break;
+						}
+						if (value && k <= end)
+							block[ZIGZAG[k]] = value;
+					}
+				}
+				if (eobRun > 0)
+				{
+					for (; k <= end; ++k)
+					{
+						int16_t& coefficient = block[ZIGZAG[k]];
+						if (coefficient != 0)
+							refine(coefficient);
+					}
+					--eobRun;
+				}
+				return true;
+			};
+
+			auto restart = [&](uint32_t& untilRestart) -> bool
+			{
+				if (restartInterval == 0)
+					return true;
+				if (untilRestart == 0)
+				{
+					if (!bits.Restart())
+						return false;
+					for (uint32_t i = 0; i < count; ++i)
+						scan[i]->predictor = 0;
+					eobRun = 0;
+					untilRestart = restartInterval;
+				}
+				--untilRestart;
+				return true;
+			};
+
+			uint32_t untilRestart = restartInterval;
+			bool ok = true;
+			if (count == 1)
+			{
+				// a single component goes block by block over the blocks that cover the image, not whole MCUs
+				SJpegComponent& component = *scan[0];
+				const uint32_t wide = ((width * component.h + hMax - 1) / hMax + 7) / 8;
+				const uint32_t high_ = ((height * component.v + vMax - 1) / vMax + 7) / 8;
+				for (uint32_t by = 0; by < high_ && ok; ++by)
+					for (uint32_t bx = 0; bx < wide && ok; ++bx)
+						ok = restart(untilRestart) && decodeBlock(component, &component.coefficients[(size_t(by) * component.blocksWide + bx) * 64]);
+			}
+			else
+			{
+				for (uint32_t my = 0; my < mcusHigh && ok; ++my)
+				{
+					for (uint32_t mx = 0; mx < mcusWide && ok; ++mx)
+					{
+						ok = restart(untilRestart);
+						for (uint32_t i = 0; i < count && ok; ++i)
+						{
+							SJpegComponent& component = *scan[i];
+							for (uint32_t y = 0; y < component.v && ok; ++y)
+								for (uint32_t x = 0; x < component.h && ok; ++x)
+								{
+									const size_t block = size_t(my * component.v + y) * component.blocksWide + mx * component.h + x;
+									ok = decodeBlock(component, &component.coefficients[block * 64]);
+								}
+						}
+					}
+				}
+			}
+			if (!ok)
+				return fail("scan data is broken");
+
+			pos = bits.End();
+		}
+		// everything else (APPn, COM, DNL) is skipped
+	}
+
+	if (!frame)
+		return fail("has no frame");
+
+	// every component into a plane of its own resolution, then upsampled and converted
+	std::vector<std::vector<uint8_t>> planes(components.size());
+	for (size_t c = 0; c < components.size(); ++c)
+	{
+		const SJpegComponent& component = components[c];
+		const size_t stride = size_t(component.blocksWide) * 8;
+		planes[c].resize(stride * component.blocksHigh * 8);
+		for (uint32_t by = 0; by < component.blocksHigh; ++by)
+			for (uint32_t bx = 0; bx < component.blocksWide; ++bx)
+				InverseDCT(&component.coefficients[(size_t(by) * component.blocksWide + bx) * 64], quant[component.quant],
+					&planes[c][by * 8 * stride + bx * 8], stride);
+	}
+
+	out.width = width;
+	out.height = height;
+	out.rgba.resize(size_t(width) * height * 4);
+
+	const bool ycbcr = components.size() == 3 && adobeTransform != 0 &&
+		!(components[0].id == 'R' && components[1].id == 'G' && components[2].id == 'B');
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		uint8_t* pixel = &out.rgba[size_t(y) * width * 4];
+		for (uint32_t x = 0; x < width; ++x, pixel += 4)
+		{
+			int samples[3];
+			for (size_t c = 0; c < components.size(); ++c)
+			{
+				const SJpegComponent& component = components[c];
+				samples[c] = planes[c][size_t(y * component.v / vMax) * component.blocksWide * 8 + x * component.h / hMax];
+			}
+
+			if (components.size() == 1)
+				pixel[0] = pixel[1] = pixel[2] = static_cast<uint8_t>(samples[0]);
+			else if (ycbcr)
+			{
+				// fixed point with 16 fractional bits
+				const int luma = (samples[0] << 16) + 32768;
+				const int cb = samples[1] - 128;
+				const int cr = samples[2] - 128;
+				pixel[0] = ClampByte((luma + 91881 * cr) >> 16);
+				pixel[1] = ClampByte((luma - 22554 * cb - 46802 * cr) >> 16);
+				pixel[2] = ClampByte((luma + 116130 * cb) >> 16);
+			}
+			else
+				pixel[0] = static_cast<uint8_t>(samples[0]), pixel[1] = static_cast<uint8_t>(samples[1]), pixel[2] = static_cast<uint8_t>(samples[2]);
+			pixel[3] = 255;
+		}
+	}
+
+	return true;
+}
+
+bool EGLTF::GetGLTFImageData(const SGLTFAsset& asset, int32_t image, std::vector<uint8_t>& out)
+{
+	out.clear();
+	if (image < 0 || static_cast<size_t>(image) >= asset.images.size())
+		return false;
+
+	const SGLTFAsset_Prop_Image& source = asset.images[image];
+	if (source.bufferView >= 0)
+	{
+		if (static_cast<size_t>(source.bufferView) >= asset.bufferViews.size())
+			return false;
+
+		const SGLTFAsset_Prop_BufferView& view = asset.bufferViews[source.bufferView];
+		if (view.buffer < 0 || static_cast<size_t>(view.buffer) >= asset.buffers.size())
+			return false;
+
+		const std::vector<uint8_t>& buffer = asset.buffers[view.buffer].data;
+		const size_t offset = view.byteOffset > 0 ? view.byteOffset : 0;
+		if (view.byteLength < 0 || offset + view.byteLength > buffer.size())
+			return false;
+
+		out.assign(buffer.begin() + offset, buffer.begin() + offset + view.byteLength);
+		return true;
+	}
+
+	// data uris keep their base64 payload, from the ',' after the mime type on
+	if (!source.data.empty() && source.data[0] == ',')
+	{
+		std::string decoded;
+		if (!macaron::Base64::Decode(std::string(source.data.begin() + 1, source.data.end()), decoded).empty())
+			return false;
+		out.assign(decoded.begin(), decoded.end());
+		return true;
+	}
+
+	out = source.data;
+	return !out.empty();
+}
+
+bool EGLTF::DecodeGLTFImage(const uint8_t* data, size_t size, SGLTFBitmap& out)
+{
+	out = SGLTFBitmap();
+	if (size >= 8 && !memcmp(data, PNG_SIGNATURE, 8))
+		return DecodePNG(data, size, out);
+	if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+		return DecodeJPEG(data, size, out);
+
+	fprintf(stderr, "\nError: image is neither PNG nor JPEG\n");
+	return false;
+}
+
+bool EGLTF::DecodeGLTFImage(const SGLTFAsset& asset, int32_t image, SGLTFBitmap& out)
+{
+	std::vector<uint8_t> data;
+	if (!GetGLTFImageData(asset, image, data))
+	{
+		fprintf(stderr, "\nError: image %d has no data\n", image);
+		return false;
+	}
+	return DecodeGLTFImage(data.data(), data.size(), out);
+}
+
+// ---- PNG encoding ----
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+	static const struct STable
+	{
+		uint32_t values[256];
+
+		STable()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int k = 0; k < 8; ++k)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				values[i] = c;
+			}
+		}
+	} table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+class CDeflateBits
+{
+public:
+	explicit CDeflateBits(std::vector<uint8_t>& out) : m_out(out) {}
+
+	void Write(uint32_t value, uint32_t count)
+	{
+		m_bits |= uint64_t(value) << m_count;
+		m_count += count;
+		while (m_count >= 8)
+		{
+			m_out.push_back(static_cast<uint8_t>(m_bits));
+			m_bits >>= 8;
+			m_count -= 8;
+		}
+	}
+
+	// huffman codes go out most significant bit first
+	void WriteCode(uint32_t code, uint32_t length)
+	{
+		uint32_t reversed = 0;
+		for (uint32_t b = 0; b < length; ++b)
+			reversed |= ((code >> b) & 1) << (length - 1 - b);
+		Write(reversed, length);
+	}
+
+	void Flush()
+	{
+		if (m_count > 0)
+			m_out.push_back(static_cast<uint8_t>(m_bits));
+		m_bits = 0;
+		m_count = 0;
+	}
+
+private:
+	std::vector<uint8_t>& m_out;
+	uint64_t m_bits = 0;
+	uint32_t m_count = 0;
+};
+
+static void WriteFixedLiteral(CDeflateBits& bits, uint32_t symbol)
+{
+	if (symbol < 144)
+		bits.WriteCode(0x30 + symbol, 8);
+	else if (symbol < 256)
+		bits.WriteCode(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		bits.WriteCode(symbol - 256, 7);
+	else
+		bits.WriteCode(0xC0 + symbol - 280, 8);
+}
+
+// zlib stream with one fixed huffman block, greedy matches from hash chains of limited length
+static void Deflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+	static const uint32_t WINDOW = 32768;
+	static const uint32_t HASH_BITS = 15;
+	static const uint32_t MAX_CHAIN = 32;
+	static const uint32_t MAX_MATCH = 258;
+
+	out.push_back(0x78);
+	out.push_back(0x01);
+
+	CDeflateBits bits(out);
+	bits.Write(1, 1); // last block
+	bits.Write(1, 2); // fixed codes
+
+	std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+	std::vector<int32_t> previous(WINDOW, -1);
+	auto hash = [&](size_t i) { return ((uint32_t(data[i]) << 16 | uint32_t(data[i + 1]) << 8 | data[i + 2]) * 2654435761u) >> (32 - HASH_BITS); };
+	auto insert = [&](size_t i)
+	{
+		if (i + 3 > size)
+			return;
+		const uint32_t h = hash(i);
+		previous[i % WINDOW] = head[h];
+		head[h] = static_cast<int32_t>(i);
+	};
+
+	for (size_t i = 0; i < size;)
+	{
+		uint32_t bestLength = 0;
+		size_t bestDistance = 0;
+		if (i + 3 <= size)
+		{
+			const size_t limit = std::min<size_t>(MAX_MATCH, size - i);
+			int32_t candidate = head[hash(i)];
+			for (uint32_t chain = 0; chain < MAX_CHAIN && candidate >= 0 && i - candidate <= WINDOW - 1; ++chain)
+			{
+				const uint8_t* a = data + candidate;
+				const uint8_t* b = data + i;
+				uint32_t length = 0;
+				while (length < limit && a[length] == b[length])
+					++length;
+				if (length > bestLength)
+				{
+					bestLength = length;
+					bestDistance = i - candidate;
+					if (length == limit)
+						break;
+				}
+				candidate = previous[candidate % WINDOW];
+			}
+		}
+
+		if (bestLength < 3)
+		{
+			WriteFixedLiteral(bits, data[i]);
+			insert(i);
+			++i;
+			continue;
+		}
+
+		uint32_t lengthSymbol = 28;
+		while (LENGTH_BASE[lengthSymbol] > bestLength)
+			--lengthSymbol;
+		WriteFixedLiteral(bits, 257 + lengthSymbol);
+		bits.Write(bestLength - LENGTH_BASE[lengthSymbol], LENGTH_EXTRA[lengthSymbol]);
+
+		uint32_t distanceSymbol = 29;
+		while (DISTANCE_BASE[distanceSymbol] > bestDistance)
+			--distanceSymbol;
+		bits.WriteCode(distanceSymbol, 5);
+		bits.Write(static_cast<uint32_t>(bestDistance - DISTANCE_BASE[distanceSymbol]), DISTANCE_EXTRA[distanceSymbol]);
+
+		for (uint32_t k = 0; k < bestLength; ++k)
+			insert(i + k);
+		i += bestLength;
+	}
+
+	WriteFixedLiteral(bits, 256);
+	bits.Flush();
+
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	WriteBE32(out, (b << 16) | a);
+}
+
+static void WriteChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+{
+	WriteBE32(out, static_cast<uint32_t>(size));
+	const size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + size);
+	WriteBE32(out, Crc32(&out[start], size + 4));
+}
+
+void EGLTF::EncodeGLTFPNG(const SGLTFBitmap& bitmap, std::vector<uint8_t>& out)
+{
+	out.assign(PNG_SIGNATURE, PNG_SIGNATURE + 8);
+
+	uint8_t header[13] = {};
+	const uint32_t dimensions[2] = { bitmap.width, bitmap.height };
+	for (int i = 0; i < 2; ++i)
+		for (int b = 0; b < 4; ++b)
+			header[i * 4 + b] = static_cast<uint8_t>(dimensions[i] >> (24 - b * 8));
+	header[8] = 8; // bit depth
+	header[9] = 6; // RGBA
+	WriteChunk(out, "IHDR", header, sizeof(header));
+
+	// every row with the filter whose output has the smallest sum of absolute (signed) values
+	const size_t stride = size_t(bitmap.width) * 4;
+	std::vector<uint8_t> filtered((stride + 1) * bitmap.height);
+	std::vector<uint8_t> candidate(stride);
+	for (uint32_t y = 0; y < bitmap.height; ++y)
+	{
+		const uint8_t* row = &bitmap.rgba[y * stride];
+		const uint8_t* previous = y > 0 ? row - stride : nullptr;
+		uint8_t* target = &filtered[y * (stride + 1)];
+
+		uint64_t bestCost = UINT64_MAX;
+		for (uint8_t filter = 0; filter < 5; ++filter)
+		{
+			uint64_t cost = 0;
+			for (size_t x = 0; x < stride; ++x)
+			{
+				const int a = x >= 4 ? row[x - 4] : 0;
+				const int b = previous ? previous[x] : 0;
+				const int c = previous && x >= 4 ? previous[x - 4] : 0;
+				int predicted = 0;
+				switch (filter)
+				{
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) >> 1; break;
+				case 4: predicted = Paeth(a, b, c); break;
+				}
+				candidate[x] = static_cast<uint8_t>(row[x] - predicted);
+				cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(candidate[x])));
+			}
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				target[0] = filter;
+				std::copy(candidate.begin(), candidate.end(), target + 1);
+			}
+		}
+	}
+
+	std::vector<uint8_t> compressed;
+	Deflate(filtered.data(), filtered.size(), compressed);
+	WriteChunk(out, "IDAT", compressed.data(), compressed.size());
+	WriteChunk(out, "IEND", nullptr, 0);
+}
+
+bool EGLTF::WriteGLTFPNG(const std::string& filepath, const SGLTFBitmap& bitmap)
+{
+	if (bitmap.width == 0 || bitmap.height == 0 || bitmap.rgba.size() != size_t(bitmap.width) * bitmap.height * 4)
+	{
+		fprintf(stderr, "\nError: bitmap for %s is empty or its size does not match\n", filepath.c_str());
+		return false;
+	}
+
+	std::vector<uint8_t> png;
+	EncodeGLTFPNG(bitmap, png);
+
+	FILE* file = fopen(filepath.c_str(), "wb");
+	if (!file)
+	{
+		fprintf(stderr, "\nError: could not open %s for writing\n", filepath.c_str());
+		return false;
+	}
+	const bool written = fwrite(png.data(), 1, png.size(), file) == png.size();
+	fclose(file);
+
+	if (!written)
+		fprintf(stderr, "\nError: could not write %s\n", filepath.c_str());
+	return written;
+}
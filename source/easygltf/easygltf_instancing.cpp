@@ -0,0 +1,459 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_instancing.h"
+#include "easygltf_compact.h"
+#include "easygltf_geometry.h"
+#include "easygltf_snapshot.h"
+#include "easygltf_threadpool.h"
+
+#include <array>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+
+typedef std::array<float, 16> TMatrix;
+
+static const TMatrix IDENTITY = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+// column major, a * b
+static TMatrix Multiply(const TMatrix& a, const TMatrix& b)
+{
+	TMatrix result;
+	for (int column = 0; column < 4; ++column)
+		for (int row = 0; row < 4; ++row)
+			result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] + a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+	return result;
+}
+
+bool EGLTF::ReadGLTFInstanceMatrices(const SGLTFAsset& asset, const std::map<std::string, int32_t>& instancing, std::vector<float>& out)
+{
+	std::vector<float> translation, rotation, scale;
+	size_t count = SIZE_MAX;
+
+	auto read = [&](const char* name, uint32_t components, std::vector<float>& values)
+	{
+		const auto iter = instancing.find(name);
+		if (iter == instancing.end())
+			return true;
+
+		// rotations can be normalized bytes or shorts
+		if (!ReadGLTFAccessor(asset, iter->second, values, true) || GetGLTFComponentCount(asset.accessors[iter->second].type) != components)
+		{
+			fprintf(stderr, "\nError: EXT_mesh_gpu_instancing %s accessor %d can't be used\n", name, iter->second);
+			return false;
+		}
+
+		const size_t instances = values.size() / components;
+		if (count != SIZE_MAX && instances != count)
+		{
+			fprintf(stderr, "\nError: EXT_mesh_gpu_instancing attributes have different counts\n");
+			return false;
+		}
+		count = instances;
+		return true;
+	};
+
+	if (!read("TRANSLATION", 3, translation) || !read("ROTATION", 4, rotation) || !read("SCALE", 3, scale))
+		return false;
+
+	if (count == SIZE_MAX)
+	{
+		fprintf(stderr, "\nError: EXT_mesh_gpu_instancing without TRANSLATION, ROTATION or SCALE\n");
+		return false;
+	}
+
+	out.resize(count * 16);
+	for (size_t i = 0; i < count; ++i)
+	{
+		SGLTFCompact_Node trs;
+		if (!translation.empty())
+			std::copy(&translation[i * 3], &translation[i * 3] + 3, trs.translation);
+		if (!rotation.empty())
+			std::copy(&rotation[i * 4], &rotation[i * 4] + 4, trs.rotation);
+		if (!scale.empty())
+			std::copy(&scale[i * 3], &scale[i * 3] + 3, trs.scale);
+
+		const TMatrix matrix = GetGLTFCompactNodeMatrix(trs);
+		std::copy(matrix.begin(), matrix.end(), out.begin() + i * 16);
+	}
+
+	return true;
+}
+
+namespace
+{
+	// Content hashes of the accessors meshes use, only worked out for those
+	struct SAccessorHashes
+	{
+		std::vector<uint64_t> hashes;
+		std::vector<uint8_t> valid;
+	};
+}
+
+static void HashAccessors(const EGLTF::SGLTFAsset& asset, EGLTF::CGLTFThreadPool* pool, SAccessorHashes& out)
+{
+	out.hashes.assign(asset.accessors.size(), 0);
+	out.valid.assign(asset.accessors.size(), 0);
+
+	std::vector<uint8_t> used(asset.accessors.size(), 0);
+	auto use = [&](int32_t index)
+	{
+		if (index >= 0 && static_cast<size_t>(index) < used.size())
+			used[index] = 1;
+	};
+
+	for (const auto& mesh : asset.meshes)
+	{
+		for (const auto& primitive : mesh.primitives)
+		{
+			use(primitive.indices);
+			for (const auto& attribute : primitive.attributes)
+				use(attribute.second);
+			for (const auto& target : primitive.targets)
+				for (const auto& attribute : target)
+					use(attribute.second);
+		}
+	}
+
+	std::vector<int32_t> list;
+	for (size_t i = 0; i < used.size(); ++i)
+		if (used[i])
+			list.push_back(static_cast<int32_t>(i));
+
+	auto hash = [&](size_t begin, size_t end)
+	{
+		std::vector<uint8_t> bytes;
+		for (size_t i = begin; i < end; ++i)
+		{
+			const int32_t index = list[i];
+			const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[index];
+			if (!EGLTF::ReadGLTFAccessorBytes(asset, index, bytes))
+				continue;
+
+			uint64_t h = EGLTF::HashGLTFSnapshotData(&accessor.componentType, sizeof(accessor.componentType));
+			h = EGLTF::HashGLTFSnapshotData(accessor.type.data(), accessor.type.size(), h);
+			h = EGLTF::HashGLTFSnapshotData(&accessor.count, sizeof(accessor.count), h);
+			out.hashes[index] = EGLTF::HashGLTFSnapshotData(bytes.data(), bytes.size(), h);
+			out.valid[index] = 1;
+		}
+	};
+
+	if (pool && list.size() > 1)
+		pool->ParallelFor(list.size(), 1, hash);
+	else
+		hash(0, list.size());
+}
+
+// Same hash isn't proof, the bytes get compared as well
+static bool SameAccessor(const EGLTF::SGLTFAsset& asset, const SAccessorHashes& hashes, int32_t a, int32_t b)
+{
+	if (a == b)
+		return true;
+	if (a < 0 || b < 0 || !hashes.valid[a] || !hashes.valid[b] || hashes.hashes[a] != hashes.hashes[b])
+		return false;
+
+	const EGLTF::SGLTFAsset_Prop_Accessor& x = asset.accessors[a];
+	const EGLTF::SGLTFAsset_Prop_Accessor& y = asset.accessors[b];
+	if (x.componentType != y.componentType || x.normalized != y.normalized || x.type != y.type || x.count != y.count)
+		return false;
+
+	std::vector<uint8_t> bytesA, bytesB;
+	return EGLTF::ReadGLTFAccessorBytes(asset, a, bytesA) && EGLTF::ReadGLTFAccessorBytes(asset, b, bytesB) && bytesA == bytesB;
+}
+
+static bool SameAttributes(const EGLTF::SGLTFAsset& asset, const SAccessorHashes& hashes, const std::map<std::string, int32_t>& a, const std::map<std::string, int32_t>& b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (auto x = a.begin(), y = b.begin(); x != a.end(); ++x, ++y)
+		if (x->first != y->first || !SameAccessor(asset, hashes, x->second, y->second))
+			return false;
+	return true;
+}
+
+static bool SameGeometry(const EGLTF::SGLTFAsset& asset, const SAccessorHashes& hashes, const EGLTF::SGLTFAsset_Prop_Mesh& a, const EGLTF::SGLTFAsset_Prop_Mesh& b)
+{
+	if (a.primitives.size() != b.primitives.size())
+		return false;
+
+	for (size_t p = 0; p < a.primitives.size(); ++p)
+	{
+		const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& x = a.primitives[p];
+		const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& y = b.primitives[p];
+
+		if ((x.mode == -1 ? 4 : x.mode) != (y.mode == -1 ? 4 : y.mode) || x.targets.size() != y.targets.size())
+			return false;
+		if ((x.indices == -1) != (y.indices == -1) || (x.indices != -1 && !SameAccessor(asset, hashes, x.indices, y.indices)))
+			return false;
+		if (!SameAttributes(asset, hashes, x.attributes, y.attributes))
+			return false;
+		for (size_t t = 0; t < x.targets.size(); ++t)
+			if (!SameAttributes(asset, hashes, x.targets[t], y.targets[t]))
+				return false;
+	}
+
+	return a.weights == b.weights;
+}
+
+static uint64_t HashGeometry(const SAccessorHashes& hashes, const EGLTF::SGLTFAsset_Prop_Mesh& mesh)
+{
+	auto accessorHash = [&](int32_t index) -> uint64_t
+	{
+		if (index < 0 || static_cast<size_t>(index) >= hashes.hashes.size() || !hashes.valid[index])
+			return static_cast<uint64_t>(index); // unreadable ones only match themselves
+		return hashes.hashes[index];
+	};
+
+	uint64_t h = EGLTF::HashGLTFSnapshotData(nullptr, 0);
+	for (const auto& primitive : mesh.primitives)
+	{
+		const int32_t mode = primitive.mode == -1 ? 4 : primitive.mode;
+		const uint64_t indices = primitive.indices == -1 ? 0 : accessorHash(primitive.indices);
+		h = EGLTF::HashGLTFSnapshotData(&mode, sizeof(mode), h);
+		h = EGLTF::HashGLTFSnapshotData(&indices, sizeof(indices), h);
+
+		for (const auto& attribute : primitive.attributes)
+		{
+			const uint64_t value = accessorHash(attribute.second);
+			h = EGLTF::HashGLTFSnapshotData(attribute.first.data(), attribute.first.size(), h);
+			h = EGLTF::HashGLTFSnapshotData(&value, sizeof(value), h);
+		}
+	}
+	return h;
+}
+
+size_t EGLTF::FindGLTFDuplicateMeshes(const SGLTFAsset& asset, std::vector<int32_t>& meshRemap, CGLTFThreadPool* pool)
+{
+	SAccessorHashes hashes;
+	HashAccessors(asset, pool, hashes);
+
+	meshRemap.resize(asset.meshes.size());
+	std::unordered_map<uint64_t, std::vector<int32_t>> unique; // geometry hash -> meshes that are not duplicates
+	size_t duplicates = 0;
+
+	for (size_t m = 0; m < asset.meshes.size(); ++m)
+	{
+		meshRemap[m] = static_cast<int32_t>(m);
+
+		std::vector<int32_t>& candidates = unique[HashGeometry(hashes, asset.meshes[m])];
+		for (int32_t candidate : candidates)
+		{
+			if (SameGeometry(asset, hashes, asset.meshes[candidate], asset.meshes[m]))
+			{
+				meshRemap[m] = candidate;
+				break;
+			}
+		}
+
+		if (meshRemap[m] == static_cast<int32_t>(m))
+			candidates.push_back(static_cast<int32_t>(m));
+		else
+			++duplicates;
+	}
+
+	return duplicates;
+}
+
+size_t EGLTF::MergeGLTFDuplicateMeshes(SGLTFAsset& asset, CGLTFThreadPool* pool)
+{
+	std::vector<int32_t> meshRemap;
+	const size_t duplicates = FindGLTFDuplicateMeshes(asset, meshRemap, pool);
+
+	for (size_t m = 0; m < asset.meshes.size(); ++m)
+	{
+		if (meshRemap[m] == static_cast<int32_t>(m))
+			continue;
+
+		const SGLTFAsset_Prop_Mesh& original = asset.meshes[meshRemap[m]];
+		for (size_t p = 0; p < original.primitives.size(); ++p)
+		{
+			SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[m].primitives[p];
+			primitive.indices = original.primitives[p].indices;
+			primitive.attributes = original.primitives[p].attributes;
+			primitive.targets = original.primitives[p].targets;
+		}
+	}
+
+	return duplicates;
+}
+
+bool EGLTF::BuildGLTFInstanceGroups(const SGLTFAsset& asset, SGLTFInstancing& out, int32_t scene, const SGLTFCompactAsset* compact, CGLTFThreadPool* pool)
+{
+	out = SGLTFInstancing();
+
+	const bool useCompact = asset.nodes.empty() && compact && !compact->nodes.empty();
+	const size_t nodeCount = useCompact ? compact->nodes.size() : asset.nodes.size();
+
+	// the two node layouts behind the same few questions
+	std::map<int32_t, const std::map<std::string, int32_t>*> compactInstancing;
+	if (useCompact)
+		for (const auto& instancing : compact->instancing)
+			compactInstancing[instancing.node] = &instancing.attributes;
+
+	auto getMesh = [&](size_t n) { return useCompact ? compact->nodes[n].mesh : asset.nodes[n].mesh; };
+	auto getSkin = [&](size_t n) { return useCompact ? compact->nodes[n].skin : asset.nodes[n].skin; };
+	auto getLocal = [&](size_t n)
+	{
+		if (useCompact)
+			return GetGLTFCompactNodeMatrix(compact->nodes[n]);
+
+		TMatrix matrix;
+		for (int i = 0; i < 16; ++i)
+			matrix[i] = static_cast<float>(asset.nodes[n].matrix[i]);
+		return matrix;
+	};
+	auto getChildren = [&](size_t n, std::vector<int32_t>& children)
+	{
+		if (useCompact)
+		{
+			const SGLTFCompact_Range& range = compact->nodes[n].children;
+			children.assign(compact->children.begin() + range.offset, compact->children.begin() + range.offset + range.count);
+		}
+		else
+			children = asset.nodes[n].children;
+	};
+	auto getInstancing = [&](size_t n) -> const std::map<std::string, int32_t>*
+	{
+		if (!useCompact)
+			return asset.nodes[n].instancing.empty() ? nullptr : &asset.nodes[n].instancing;
+
+		const auto iter = compactInstancing.find(static_cast<int32_t>(n));
+		return iter == compactInstancing.end() ? nullptr : iter->second;
+	};
+
+	std::vector<int32_t> roots;
+	if (scene >= 0)
+	{
+		if (static_cast<size_t>(scene) >= asset.scenes.size())
+		{
+			fprintf(stderr, "\nError: scene %d does not exist\n", scene);
+			return false;
+		}
+		roots = asset.scenes[scene].nodes;
+	}
+	else
+	{
+		std::vector<uint8_t> isChild(nodeCount, 0);
+		std::vector<int32_t> children;
+		for (size_t n = 0; n < nodeCount; ++n)
+		{
+			getChildren(n, children);
+			for (int32_t child : children)
+				if (child >= 0 && static_cast<size_t>(child) < nodeCount)
+					isChild[child] = 1;
+		}
+
+		for (size_t n = 0; n < nodeCount; ++n)
+			if (!isChild[n])
+				roots.push_back(static_cast<int32_t>(n));
+	}
+
+	std::vector<int32_t> meshRemap;
+	FindGLTFDuplicateMeshes(asset, meshRemap, pool);
+
+	typedef std::pair<std::pair<int32_t, int32_t>, std::vector<int32_t>> TGroupKey; // (geometry, skin), materials
+	std::map<TGroupKey, size_t> groupIndex;
+
+	// depth first with the world matrix of each node on the stack, nodes seen twice (broken files) are skipped
+	std::vector<std::pair<int32_t, TMatrix>> stack;
+	for (auto root = roots.rbegin(); root != roots.rend(); ++root)
+		stack.emplace_back(*root, IDENTITY);
+
+	std::vector<uint8_t> visited(nodeCount, 0);
+	std::vector<int32_t> children;
+	std::vector<float> instanceMatrices;
+	bool result = true;
+
+	while (!stack.empty())
+	{
+		const int32_t n = stack.back().first;
+		const TMatrix parent = stack.back().second;
+		stack.pop_back();
+
+		if (n < 0 || static_cast<size_t>(n) >= nodeCount || visited[n])
+			continue;
+		visited[n] = 1;
+
+		const TMatrix world = Multiply(parent, getLocal(n));
+
+		getChildren(n, children);
+		for (auto child = children.rbegin(); child != children.rend(); ++child)
+			stack.emplace_back(*child, world);
+
+		const int32_t mesh = getMesh(n);
+		if (mesh == -1)
+			continue;
+		if (mesh < 0 || static_cast<size_t>(mesh) >= asset.meshes.size())
+		{
+			fprintf(stderr, "\nError: node %d refers to mesh %d which does not exist\n", n, mesh);
+			result = false;
+			continue;
+		}
+
+		TGroupKey key;
+		key.first = std::make_pair(meshRemap[mesh], getSkin(n));
+		for (const auto& primitive : asset.meshes[mesh].primitives)
+			key.second.push_back(primitive.material);
+
+		const auto found = groupIndex.emplace(key, out.groups.size());
+		if (found.second)
+		{
+			SGLTFInstanceGroup group;
+			group.mesh = mesh;
+			group.geometry = key.first.first;
+			group.skin = key.first.second;
+			group.materials = key.second;
+			out.groups.push_back(group);
+		}
+		SGLTFInstanceGroup& group = out.groups[found.first->second];
+
+		const std::map<std::string, int32_t>* instancing = getInstancing(n);
+		if (instancing)
+		{
+			if (!ReadGLTFInstanceMatrices(asset, *instancing, instanceMatrices))
+			{
+				result = false;
+				continue;
+			}
+
+			// instance transforms are relative to the node
+			for (size_t i = 0; i < instanceMatrices.size() / 16; ++i)
+			{
+				TMatrix local;
+				std::copy(instanceMatrices.begin() + i * 16, instanceMatrices.begin() + (i + 1) * 16, local.begin());
+				const TMatrix matrix = Multiply(world, local);
+
+				group.nodes.push_back(n);
+				group.transforms.insert(group.transforms.end(), matrix.begin(), matrix.end());
+			}
+			out.drawCalls += asset.meshes[mesh].primitives.size() * (instanceMatrices.size() / 16);
+		}
+		else
+		{
+			group.nodes.push_back(n);
+			group.transforms.insert(group.transforms.end(), world.begin(), world.end());
+			out.drawCalls += asset.meshes[mesh].primitives.size();
+		}
+	}
+
+	for (const auto& group : out.groups)
+		out.instancedDrawCalls += group.materials.size();
+
+	return result;
+}
@@ -0,0 +1,553 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#include "easygltf_json.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLTF_JSON_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Smaller documents parse faster serially than it takes to index them
+static const size_t GLTF_JSON_PARALLEL_MIN = 4u << 20;
+
+// Chunks of the text the index is built in, a multiple of 64
+static const size_t GLTF_JSON_CHUNK = 1u << 20;
+
+// Arrays shorter than this are parsed as a whole, longer ones are cut into runs of elements at least this long
+static const size_t GLTF_JSON_RUN_MIN = 256u << 10;
+
+// Elements of top level arrays are only remembered this far apart, there is no need for more places to cut
+static const size_t GLTF_JSON_CUT_GAP = 64u << 10;
+
+static int PopCount(uint64_t x)
+{
+#ifdef _MSC_VER
+	return static_cast<int>(__popcnt64(x));
+#else
+	return __builtin_popcountll(x);
+#endif
+}
+
+static int FirstBit(uint64_t x)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+// Bit i for the characters inside a string, from the opening quote up to the closing one
+static uint64_t PrefixXor(uint64_t x)
+{
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+namespace
+{
+	// Per 64 byte block, bit i for byte i
+	struct SBlockMasks
+	{
+		uint64_t quote;
+		uint64_t backslash;
+		uint64_t open; // { and [
+		uint64_t close; // } and ]
+		uint64_t comma;
+		uint64_t colon;
+	};
+
+	// What the index keeps: everything at the top level and in the top level object, the brackets of its member values and
+	// every so many commas in between
+	struct SJsonEvent
+	{
+		uint64_t offset;
+		uint32_t depth; // of the object or array the character belongs to, 1 for the top level object
+		char c;
+	};
+
+	// A member value or a run of array elements, wrapped in brackets for the parser then
+	struct SPiece
+	{
+		size_t begin;
+		size_t end;
+		bool brackets;
+	};
+
+	struct SMember
+	{
+		size_t keyBegin;
+		size_t keyEnd;
+		size_t firstPiece;
+		size_t pieceCount;
+		bool split; // an array cut into runs
+	};
+
+	// Up to three spans, "[", the text and "]", read like a MemoryStream
+	class CJsonPieceStream
+	{
+	public:
+		typedef char Ch;
+
+		CJsonPieceStream(const char* begin, const char* end, bool brackets)
+		{
+			static const char open = '[';
+			static const char close = ']';
+			if (brackets)
+				m_spans[m_spanCount++] = { &open, &open + 1 };
+			if (begin < end)
+				m_spans[m_spanCount++] = { begin, end };
+			if (brackets)
+				m_spans[m_spanCount++] = { &close, &close + 1 };
+
+			m_cur = m_spanCount > 0 ? m_spans[0].begin : nullptr;
+			m_spanEnd = m_spanCount > 0 ? m_spans[0].end : nullptr;
+		}
+
+		Ch Peek() const { return RAPIDJSON_UNLIKELY(m_cur == m_spanEnd) ? '\0' : *m_cur; }
+
+		Ch Take()
+		{
+			if (RAPIDJSON_UNLIKELY(m_cur == m_spanEnd))
+				return '\0';
+
+			const Ch c = *m_cur++;
+			if (RAPIDJSON_UNLIKELY(m_cur == m_spanEnd) && m_span + 1 < m_spanCount)
+			{
+				m_taken += m_spans[m_span].end - m_spans[m_span].begin;
+				++m_span;
+				m_cur = m_spans[m_span].begin;
+				m_spanEnd = m_spans[m_span].end;
+			}
+			return c;
+		}
+
+		size_t Tell() const { return m_taken + static_cast<size_t>(m_cur - m_spans[m_span].begin); }
+
+		// read only
+		Ch* PutBegin() { RAPIDJSON_ASSERT(false); return 0; }
+		void Put(Ch) { RAPIDJSON_ASSERT(false); }
+		void Flush() { RAPIDJSON_ASSERT(false); }
+		size_t PutEnd(Ch*) { RAPIDJSON_ASSERT(false); return 0; }
+
+	private:
+		struct SSpan
+		{
+			const char* begin;
+			const char* end;
+		};
+
+		SSpan m_spans[3];
+		size_t m_spanCount = 0;
+		size_t m_span = 0;
+		size_t m_taken = 0;
+		const char* m_cur;
+		const char* m_spanEnd;
+	};
+}
+
+static void ClassifyBlock(const uint8_t* p, SBlockMasks& m)
+{
+#ifdef GLTF_JSON_SSE2
+	m = SBlockMasks();
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i lower = _mm_set1_epi8(0x20); // { and [, } and ] differ in that bit only
+	const __m128i open = _mm_set1_epi8('{');
+	const __m128i close = _mm_set1_epi8('}');
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i colon = _mm_set1_epi8(':');
+	for (int i = 0; i < 4; ++i)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+		const __m128i folded = _mm_or_si128(v, lower);
+		const int shift = i * 16;
+		m.quote |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << shift;
+		m.backslash |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))) << shift;
+		m.open |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, open)))) << shift;
+		m.close |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, close)))) << shift;
+		m.comma |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma)))) << shift;
+		m.colon |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, colon)))) << shift;
+	}
+#else
+	m = SBlockMasks();
+	for (int i = 0; i < 64; ++i)
+	{
+		const uint64_t bit = 1ull << i;
+		switch (p[i])
+		{
+		case '"': m.quote |= bit; break;
+		case '\\': m.backslash |= bit; break;
+		case '{': case '[': m.open |= bit; break;
+		case '}': case ']': m.close |= bit; break;
+		case ',': m.comma |= bit; break;
+		case ':': m.colon |= bit; break;
+		default: break;
+		}
+	}
+#endif
+}
+
+// Characters right after an odd run of backslashes. Backslashes hardly ever show up in gltf, so the walk over them is rare.
+static uint64_t FindEscaped(uint64_t backslash, bool& carry)
+{
+	if (!backslash && !carry)
+		return 0;
+
+	uint64_t escaped = 0;
+	bool pending = carry;
+	for (int i = 0; i < 64; ++i)
+	{
+		if (pending)
+		{
+			escaped |= 1ull << i;
+			pending = false;
+		}
+		else if (backslash & (1ull << i))
+			pending = true;
+	}
+
+	carry = pending;
+	return escaped;
+}
+
+// Whether the character at pos is escaped, from the backslashes in front of it
+static bool IsEscaped(const uint8_t* data, size_t pos)
+{
+	size_t count = 0;
+	while (count < pos && data[pos - count - 1] == '\\')
+		++count;
+	return (count & 1) != 0;
+}
+
+// Calls func(offset of the block, masks) over the 64 byte blocks of [begin, end), with quotes that are escaped and structural
+// characters inside strings taken out. Returns whether the text at end is inside a string.
+template<typename F>
+static bool ScanChunk(const uint8_t* data, size_t size, size_t begin, size_t end, bool inString, F func)
+{
+	bool escapeCarry = IsEscaped(data, begin);
+	uint8_t tail[64];
+	for (size_t offset = begin; offset < end; offset += 64)
+	{
+		const uint8_t* block = data + offset;
+		if (size - offset < 64)
+		{
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, block, size - offset);
+			block = tail;
+		}
+
+		SBlockMasks m;
+		ClassifyBlock(block, m);
+
+		m.quote &= ~FindEscaped(m.backslash, escapeCarry);
+		const uint64_t inside = PrefixXor(m.quote) ^ (inString ? ~0ull : 0ull);
+		inString = (inside >> 63) != 0;
+
+		m.open &= ~inside;
+		m.close &= ~inside;
+		m.comma &= ~inside;
+		m.colon &= ~inside;
+		func(offset, m);
+	}
+
+	return inString;
+}
+
+static bool IsWhitespace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static bool IsBlank(const char* begin, const char* end)
+{
+	for (; begin < end; ++begin)
+		if (!IsWhitespace(*begin))
+			return false;
+	return true;
+}
+
+bool EGLTF::CGLTFParallelJson::Parse(const char* text, size_t size, CGLTFThreadPool& pool)
+{
+	m_pools.clear();
+	m_pieces.clear();
+	m_root.reset();
+
+	if (size < GLTF_JSON_PARALLEL_MIN || pool.GetThreadCount() < 2)
+		return false;
+
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(text);
+	const size_t chunkCount = (size + GLTF_JSON_CHUNK - 1) / GLTF_JSON_CHUNK;
+	auto chunkBegin = [](size_t c) { return c * GLTF_JSON_CHUNK; };
+	auto chunkEnd = [size](size_t c) { return std::min(size, (c + 1) * GLTF_JSON_CHUNK); };
+
+	// whether a chunk starts inside a string only depends on the number of quotes in front of it
+	std::vector<uint8_t> quoteParity(chunkCount);
+	pool.ParallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; ++c)
+		{
+			int quotes = 0;
+			ScanChunk(data, size, chunkBegin(c), chunkEnd(c), false, [&quotes](size_t, const SBlockMasks& m) { quotes += PopCount(m.quote); });
+			quoteParity[c] = static_cast<uint8_t>(quotes & 1);
+		}
+	});
+
+	std::vector<uint8_t> inString(chunkCount + 1, 0);
+	for (size_t c = 0; c < chunkCount; ++c)
+		inString[c + 1] = inString[c] ^ quoteParity[c];
+	if (inString[chunkCount])
+		return false;
+
+	std::vector<int64_t> depth(chunkCount + 1, 0);
+	pool.ParallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; ++c)
+		{
+			int64_t delta = 0;
+			ScanChunk(data, size, chunkBegin(c), chunkEnd(c), inString[c] != 0, [&delta](size_t, const SBlockMasks& m) { delta += PopCount(m.open) - PopCount(m.close); });
+			depth[c + 1] = delta;
+		}
+	});
+	for (size_t c = 0; c < chunkCount; ++c)
+		depth[c + 1] += depth[c];
+	if (depth[chunkCount] != 0)
+		return false;
+
+	std::vector<std::vector<SJsonEvent>> chunkEvents(chunkCount);
+	std::atomic<bool> broken(false);
+	pool.ParallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; ++c)
+		{
+			std::vector<SJsonEvent>& events = chunkEvents[c];
+			int64_t d = depth[c];
+			uint64_t lastCut = 0;
+			bool haveCut = false;
+			ScanChunk(data, size, chunkBegin(c), chunkEnd(c), inString[c] != 0, [&](size_t offset, const SBlockMasks& m)
+			{
+				uint64_t bits = m.open | m.close | m.comma | m.colon;
+
+				// nothing in here can be shallow enough to keep
+				if (d - PopCount(m.close) > 2)
+				{
+					d += PopCount(m.open) - PopCount(m.close);
+					return;
+				}
+
+				while (bits)
+				{
+					const int b = FirstBit(bits);
+					bits &= bits - 1;
+					const uint64_t bit = 1ull << b;
+					const uint64_t position = offset + b;
+					const char ch = text[position];
+
+					if (m.open & bit)
+					{
+						++d;
+						if (d <= 2)
+							events.push_back({ position, static_cast<uint32_t>(d), ch });
+					}
+					else if (m.close & bit)
+					{
+						if (d <= 0)
+							broken = true;
+						if (d <= 2)
+							events.push_back({ position, static_cast<uint32_t>(std::max<int64_t>(d, 0)), ch });
+						--d;
+					}
+					else if (d <= 1)
+						events.push_back({ position, static_cast<uint32_t>(std::max<int64_t>(d, 0)), ch });
+					else if (d == 2 && ch == ',' && (!haveCut || position - lastCut >= GLTF_JSON_CUT_GAP))
+					{
+						events.push_back({ position, 2, ch });
+						lastCut = position;
+						haveCut = true;
+					}
+				}
+			});
+		}
+	});
+	if (broken)
+		return false;
+
+	std::vector<SJsonEvent> events;
+	{
+		size_t total = 0;
+		for (const auto& e : chunkEvents)
+			total += e.size();
+		events.reserve(total);
+		for (auto& e : chunkEvents)
+		{
+			events.insert(events.end(), e.begin(), e.end());
+			std::vector<SJsonEvent>().swap(e);
+		}
+	}
+
+	// an object at the top with nothing around it, a BOM or anything else goes to the serial parse
+	if (events.size() < 2 || events.front().c != '{' || events.back().c != '}' || events.back().depth != 1 ||
+		!IsBlank(text, text + events.front().offset) || !IsBlank(text + events.back().offset + 1, text + size))
+		return false;
+
+	const size_t runTarget = std::max(GLTF_JSON_RUN_MIN, size / (size_t(pool.GetThreadCount()) * 8));
+	std::vector<SMember> members;
+	std::vector<SPiece> pieces;
+
+	size_t e = 1;
+	size_t memberBegin = events.front().offset + 1;
+	if (events[e].c == '}' && events[e].depth == 1)
+	{
+		if (!IsBlank(text + memberBegin, text + events[e].offset))
+			return false;
+	}
+	else
+	{
+		for (;;)
+		{
+			// "key" : value followed by , or }
+			if (e >= events.size() || events[e].c != ':' || events[e].depth != 1)
+				return false;
+
+			SMember member = {};
+			member.keyBegin = memberBegin;
+			member.keyEnd = events[e].offset;
+			member.firstPiece = pieces.size();
+
+			const size_t valueBegin = events[e].offset + 1;
+			size_t next = e + 1;
+			while (next < events.size() && events[next].depth != 1)
+				++next;
+			if (next >= events.size() || (events[next].c != ',' && events[next].c != '}'))
+				return false;
+			const size_t valueEnd = events[next].offset;
+
+			// [ and ] right at the ends of the value, with the cuts in between
+			const bool array = next - e >= 3 && events[e + 1].c == '[' && events[next - 1].c == ']' && events[e + 1].depth == 2 &&
+				IsBlank(text + valueBegin, text + events[e + 1].offset) && IsBlank(text + events[next - 1].offset + 1, text + valueEnd);
+
+			if (array && valueEnd - valueBegin >= GLTF_JSON_RUN_MIN && next - e > 3)
+			{
+				member.split = true;
+				size_t runBegin = events[e + 1].offset + 1;
+				for (size_t k = e + 2; k < next; ++k)
+				{
+					const size_t cut = events[k].offset; // a comma, or the closing bracket for the last run
+					if (k + 1 == next || cut - runBegin >= runTarget)
+					{
+						pieces.push_back({ runBegin, cut, true });
+						runBegin = cut + 1;
+					}
+				}
+			}
+			else
+				pieces.push_back({ valueBegin, valueEnd, false });
+
+			member.pieceCount = pieces.size() - member.firstPiece;
+			members.push_back(member);
+
+			if (events[next].c == '}')
+			{
+				if (next + 1 != events.size())
+					return false;
+				break;
+			}
+
+			memberBegin = events[next].offset + 1;
+			e = next + 1;
+		}
+	}
+	std::vector<SJsonEvent>().swap(events);
+
+	m_pools.resize(pieces.size());
+	m_pieces.resize(pieces.size());
+	std::atomic<bool> failed(false);
+	pool.ParallelFor(pieces.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t p = begin; p < end && !failed; ++p)
+		{
+			const SPiece& piece = pieces[p];
+
+			// values take about as much as their text, one chunk for most pieces
+			m_pools[p].reset(new TJsonPool(piece.end - piece.begin + 64 * 1024));
+			m_pieces[p].reset(new TJsonDocument(m_pools[p].get()));
+
+			CJsonPieceStream stream(text + piece.begin, text + piece.end, piece.brackets);
+			m_pieces[p]->ParseStream<rapidjson::kParseDefaultFlags, rapidjson::UTF8<>>(stream);
+			if (m_pieces[p]->HasParseError())
+				failed = true;
+		}
+	});
+	if (failed)
+		return false;
+
+	m_pools.emplace_back(new TJsonPool());
+	TJsonPool& allocator = *m_pools.back();
+	m_root.reset(new TJsonDocument(&allocator));
+	m_root->SetObject();
+	m_root->MemberReserve(static_cast<rapidjson::SizeType>(members.size()), allocator);
+
+	for (const auto& member : members)
+	{
+		TJsonDocument key(&allocator);
+		key.Parse(text + member.keyBegin, member.keyEnd - member.keyBegin);
+		if (key.HasParseError() || !key.IsString())
+			return false;
+
+		rapidjson::Value name;
+		name.Swap(key);
+
+		rapidjson::Value value;
+		if (!member.split)
+			value.Swap(*m_pieces[member.firstPiece]);
+		else
+		{
+			size_t count = 0;
+			for (size_t p = member.firstPiece; p < member.firstPiece + member.pieceCount; ++p)
+				count += m_pieces[p]->Size();
+
+			value.SetArray();
+			value.Reserve(static_cast<rapidjson::SizeType>(count), allocator);
+			for (size_t p = member.firstPiece; p < member.firstPiece + member.pieceCount; ++p)
+				for (auto& element : m_pieces[p]->GetArray())
+					value.PushBack(element.Move(), allocator);
+		}
+
+		m_root->AddMember(name, value, allocator);
+	}
+
+	return true;
+}
@@ -0,0 +1,56 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+// Internal, not part of the installed headers
+
+#include "rapidjson/document.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace EGLTF
+{
+	class CGLTFThreadPool;
+
+	typedef rapidjson::MemoryPoolAllocator<rapidjson::CrtAllocator> TJsonPool;
+	typedef rapidjson::GenericDocument<rapidjson::UTF8<>, TJsonPool, TJsonPool> TJsonDocument;
+
+	// Front end for big documents. A structural index of the text, built on the pool 64 bytes at a time (SSE2 where there is
+	// SSE2), finds the members of the top level object and places to cut its big arrays between elements. The members and runs
+	// of elements are parsed on the pool and moved into one document, which holds the same values in the same order as a serial
+	// parse of the text.
+	class CGLTFParallelJson
+	{
+	public:
+		// false when there is nothing to gain (a small document, a pool with a single thread) or the text is not something the
+		// index can split, also when a piece fails to parse: the serial parse is the one to report where the error is
+		bool Parse(const char* data, size_t size, CGLTFThreadPool& pool);
+
+		// Valid after a successful Parse, as long as this lives
+		const TJsonDocument& GetDocument() const { return *m_root; }
+
+	private:
+		// the values of the document live in these
+		std::vector<std::unique_ptr<TJsonPool>> m_pools;
+		std::vector<std::unique_ptr<TJsonDocument>> m_pieces;
+		std::unique_ptr<TJsonDocument> m_root;
+	};
+}
@@ -0,0 +1,100 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#pragma once
+
+// Internal, not part of the installed headers
+
+#include "easygltf.h"
+
+#include <atomic>
+#include <chrono>
+
+namespace EGLTF
+{
+	// RAII helper that turns a block of code into a SGLTFLoadEvent.
+	// The enclosing scope is passed in, not looked up per thread, so a file a worker loads for a section still counts for that section
+	// (and for the right asset when a pool is shared between loads). Bytes read/decoded bubble up into it when the scope ends, atomically
+	// since workers may end theirs at the same time.
+	// With a null listener the constructor and destructor are a single branch each.
+	class CGLTFLoadScope
+	{
+	public:
+		CGLTFLoadScope(IGLTFLoadListener* listener, EGLTFLoadEventCategory category, const char* name, CGLTFLoadScope* parent)
+			: m_listener(listener), m_parent(parent), m_bytesRead(0), m_bytesDecoded(0)
+		{
+			if (!m_listener)
+				return;
+
+			m_event.category = category;
+			m_event.name = name;
+			m_event.beginNs = Now();
+			m_event.endNs = 0;
+			m_event.bytesRead = 0;
+			m_event.bytesDecoded = 0;
+			m_event.allocations = m_listener->GetAllocationCount();
+			m_event.elements = 0;
+
+			m_listener->OnEventBegin(m_event);
+		}
+
+		~CGLTFLoadScope()
+		{
+			End();
+		}
+
+		CGLTFLoadScope(const CGLTFLoadScope&) = delete;
+		CGLTFLoadScope& operator=(const CGLTFLoadScope&) = delete;
+
+		// Ends the event before the scope goes away, for when whatever follows should not be part of it
+		void End()
+		{
+			if (!m_listener)
+				return;
+
+			m_event.endNs = Now();
+			m_event.bytesRead = m_bytesRead.load();
+			m_event.bytesDecoded = m_bytesDecoded.load();
+			m_event.allocations = m_listener->GetAllocationCount() - m_event.allocations;
+			m_listener->OnEventEnd(m_event);
+
+			if (m_parent)
+			{
+				m_parent->AddBytesRead(m_event.bytesRead);
+				m_parent->AddBytesDecoded(m_event.bytesDecoded);
+			}
+
+			m_listener = nullptr;
+		}
+
+		void SetElements(uint64_t elements) { m_event.elements = elements; }
+		void AddBytesRead(uint64_t bytes) { m_bytesRead.fetch_add(bytes, std::memory_order_relaxed); }
+		void AddBytesDecoded(uint64_t bytes) { m_bytesDecoded.fetch_add(bytes, std::memory_order_relaxed); }
+
+		static uint64_t Now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+	private:
+		IGLTFLoadListener* m_listener;
+		CGLTFLoadScope* m_parent;
+		std::atomic<uint64_t> m_bytesRead;
+		std::atomic<uint64_t> m_bytesDecoded;
+		SGLTFLoadEvent m_event;
+	};
+}
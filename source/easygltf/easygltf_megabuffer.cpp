@@ -0,0 +1,275 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_megabuffer.h"
+#include "easygltf_geometry.h"
+#include "easygltf_instancing.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+namespace
+{
+	// A primitive's geometry and where it goes, packed once no matter how many draws use it
+	struct SPackedPrimitive
+	{
+		int32_t source;
+		int32_t mesh;
+		int32_t primitive;
+		uint32_t buffer;
+		uint64_t firstVertex;
+		uint64_t vertexCount;
+		uint64_t firstIndex;
+		uint64_t indexCount;
+	};
+}
+
+static bool SameLayout(const EGLTF::SGLTFVertexLayout& a, const EGLTF::SGLTFVertexLayout& b)
+{
+	if (a.attributes.size() != b.attributes.size())
+		return false;
+
+	for (size_t i = 0; i < a.attributes.size(); ++i)
+		if (a.attributes[i].name != b.attributes[i].name || a.attributes[i].componentType != b.attributes[i].componentType ||
+			a.attributes[i].normalized != b.attributes[i].normalized || a.attributes[i].components != b.attributes[i].components)
+			return false;
+	return true;
+}
+
+static bool PackPrimitive(const EGLTF::SGLTFAsset& asset, const SPackedPrimitive& packed, EGLTF::SGLTFMegaBuffer& buffer)
+{
+	const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[packed.mesh].primitives[packed.primitive];
+	const uint32_t stride = buffer.layout.stride;
+	uint8_t* vertices = buffer.vertices.data() + packed.firstVertex * stride;
+
+	std::vector<uint8_t> bytes;
+	for (const auto& attribute : buffer.layout.attributes)
+	{
+		const int32_t accessor = primitive.attributes.at(attribute.name);
+		if (!EGLTF::ReadGLTFAccessorBytes(asset, accessor, bytes))
+			return false;
+
+		const size_t elementSize = EGLTF::GetGLTFElementSize(attribute.componentType, asset.accessors[accessor].type);
+		if (bytes.size() < packed.vertexCount * elementSize)
+		{
+			fprintf(stderr, "\nError: %s of mesh %d primitive %d has fewer elements than POSITION\n", attribute.name.c_str(), packed.mesh, packed.primitive);
+			return false;
+		}
+
+		for (uint64_t v = 0; v < packed.vertexCount; ++v)
+			memcpy(vertices + v * stride + attribute.offset, &bytes[v * elementSize], elementSize);
+	}
+
+	uint32_t* indices = buffer.indices.data() + packed.firstIndex;
+	if (primitive.indices == -1)
+	{
+		std::iota(indices, indices + packed.indexCount, 0u);
+		return true;
+	}
+
+	std::vector<uint32_t> values;
+	if (!EGLTF::ReadGLTFAccessorIndices(asset, primitive.indices, values))
+		return false;
+
+	for (uint32_t index : values)
+	{
+		if (index >= packed.vertexCount)
+		{
+			fprintf(stderr, "\nError: mesh %d primitive %d has index %u but only %llu vertices\n", packed.mesh, packed.primitive, index, static_cast<unsigned long long>(packed.vertexCount));
+			return false;
+		}
+	}
+
+	std::copy(values.begin(), values.end(), indices);
+	return true;
+}
+
+bool EGLTF::CompileGLTFScene(const std::vector<SGLTFSceneSource>& sources, SGLTFCompiledScene& out, CGLTFThreadPool* pool)
+{
+	out = SGLTFCompiledScene();
+	bool result = true;
+
+	std::vector<SPackedPrimitive> packed;
+	std::map<std::tuple<int32_t, int32_t, int32_t>, size_t> packedIndex; // (source, geometry mesh, primitive)
+	std::vector<uint64_t> vertexCounts; // per buffer while laying out
+
+	for (size_t s = 0; s < sources.size(); ++s)
+	{
+		if (!sources[s].asset)
+			continue;
+
+		const SGLTFAsset& asset = *sources[s].asset;
+		SGLTFInstancing instancing;
+		if (!BuildGLTFInstanceGroups(asset, instancing, sources[s].scene, sources[s].compact, pool))
+			result = false;
+
+		for (const SGLTFInstanceGroup& group : instancing.groups)
+		{
+			const uint32_t baseInstance = static_cast<uint32_t>(out.instanceNodes.size());
+			out.instanceNodes.insert(out.instanceNodes.end(), group.nodes.begin(), group.nodes.end());
+			out.instanceTransforms.insert(out.instanceTransforms.end(), group.transforms.begin(), group.transforms.end());
+
+			const SGLTFAsset_Prop_Mesh& mesh = asset.meshes[group.geometry];
+			for (size_t p = 0; p < mesh.primitives.size(); ++p)
+			{
+				const SGLTFAsset_Prop_Mesh_Primitive& primitive = mesh.primitives[p];
+				const auto position = primitive.attributes.find("POSITION");
+				if (position == primitive.attributes.end())
+					continue; // nothing to draw
+
+				const auto key = std::make_tuple(static_cast<int32_t>(s), group.geometry, static_cast<int32_t>(p));
+				auto found = packedIndex.find(key);
+				if (found == packedIndex.end())
+				{
+					// the layout comes straight from the accessors, nothing gets converted
+					SGLTFVertexLayout layout;
+					bool valid = true;
+					for (const auto& attribute : primitive.attributes)
+					{
+						if (attribute.second < 0 || static_cast<size_t>(attribute.second) >= asset.accessors.size())
+						{
+							fprintf(stderr, "\nError: %s of mesh %d primitive %zu refers to accessor %d which does not exist\n", attribute.first.c_str(), group.geometry, p, attribute.second);
+							valid = false;
+							break;
+						}
+
+						const SGLTFAsset_Prop_Accessor& accessor = asset.accessors[attribute.second];
+						SGLTFVertexAttribute vertexAttribute;
+						vertexAttribute.name = attribute.first;
+						vertexAttribute.componentType = accessor.componentType;
+						vertexAttribute.normalized = accessor.normalized;
+						vertexAttribute.components = GetGLTFComponentCount(accessor.type);
+						vertexAttribute.offset = layout.stride;
+						layout.stride += (GetGLTFElementSize(accessor.componentType, accessor.type) + 3) & ~3u;
+						layout.attributes.push_back(vertexAttribute);
+					}
+
+					const int32_t indices = primitive.indices;
+					if (valid && indices != -1 && (indices < 0 || static_cast<size_t>(indices) >= asset.accessors.size()))
+					{
+						fprintf(stderr, "\nError: mesh %d primitive %zu refers to accessor %d which does not exist\n", group.geometry, p, indices);
+						valid = false;
+					}
+
+					if (!valid)
+					{
+						result = false;
+						continue;
+					}
+
+					size_t buffer = 0;
+					while (buffer < out.buffers.size() && !SameLayout(out.buffers[buffer].layout, layout))
+						++buffer;
+					if (buffer == out.buffers.size())
+					{
+						out.buffers.emplace_back();
+						out.buffers.back().layout = layout;
+						vertexCounts.push_back(0);
+					}
+
+					SPackedPrimitive entry;
+					entry.source = static_cast<int32_t>(s);
+					entry.mesh = group.geometry;
+					entry.primitive = static_cast<int32_t>(p);
+					entry.buffer = static_cast<uint32_t>(buffer);
+					entry.vertexCount = static_cast<uint64_t>(std::max<int64_t>(asset.accessors[position->second].count, 0));
+					entry.indexCount = indices == -1 ? entry.vertexCount : static_cast<uint64_t>(std::max<int64_t>(asset.accessors[indices].count, 0));
+					entry.firstVertex = vertexCounts[buffer];
+					entry.firstIndex = out.buffers[buffer].indices.size(); // only counts for now
+
+					vertexCounts[buffer] += entry.vertexCount;
+					out.buffers[buffer].indices.resize(out.buffers[buffer].indices.size() + entry.indexCount);
+
+					if (entry.firstVertex > INT32_MAX || entry.firstIndex + entry.indexCount > UINT32_MAX)
+					{
+						fprintf(stderr, "\nError: too much geometry for one buffer\n");
+						return false;
+					}
+
+					found = packedIndex.emplace(key, packed.size()).first;
+					packed.push_back(entry);
+				}
+
+				const SPackedPrimitive& entry = packed[found->second];
+
+				SGLTFDrawElementsIndirectCommand command;
+				command.count = static_cast<uint32_t>(entry.indexCount);
+				command.instanceCount = static_cast<uint32_t>(group.nodes.size());
+				command.firstIndex = static_cast<uint32_t>(entry.firstIndex);
+				command.baseVertex = static_cast<int32_t>(entry.firstVertex);
+				command.baseInstance = baseInstance;
+
+				SGLTFDrawInfo draw;
+				draw.buffer = entry.buffer;
+				draw.mode = primitive.mode == -1 ? 4 : primitive.mode;
+				draw.source = static_cast<int32_t>(s);
+				draw.mesh = group.mesh;
+				draw.primitive = static_cast<int32_t>(p);
+				draw.material = group.materials[p];
+				draw.skin = group.skin;
+
+				out.commands.push_back(command);
+				out.draws.push_back(draw);
+			}
+		}
+	}
+
+	for (size_t b = 0; b < out.buffers.size(); ++b)
+		out.buffers[b].vertices.resize(vertexCounts[b] * out.buffers[b].layout.stride);
+
+	// every primitive has its own slice of the buffers, they can be filled in any order
+	std::vector<uint8_t> failed(packed.size(), 0);
+	auto pack = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			failed[i] = !PackPrimitive(*sources[packed[i].source].asset, packed[i], out.buffers[packed[i].buffer]);
+	};
+
+	if (pool && packed.size() > 1)
+		pool->ParallelFor(packed.size(), 1, pack);
+	else
+		pack(0, packed.size());
+
+	if (std::find(failed.begin(), failed.end(), 1) != failed.end())
+		result = false;
+
+	// draws that can share state end up next to each other, ties keep the scene order
+	std::vector<size_t> order(out.commands.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+	{
+		const SGLTFDrawInfo& x = out.draws[a];
+		const SGLTFDrawInfo& y = out.draws[b];
+		return std::tie(x.buffer, x.mode, x.skin, x.source, x.material) < std::tie(y.buffer, y.mode, y.skin, y.source, y.material);
+	});
+
+	std::vector<SGLTFDrawElementsIndirectCommand> commands(order.size());
+	std::vector<SGLTFDrawInfo> draws(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		commands[i] = out.commands[order[i]];
+		draws[i] = out.draws[order[i]];
+	}
+	out.commands.swap(commands);
+	out.draws.swap(draws);
+
+	return result;
+}
@@ -0,0 +1,470 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_meshlet.h"
+#include "easygltf_geometry.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+
+// Positions and triangles of a triangle list primitive
+static bool ReadTriangles(const EGLTF::SGLTFAsset& asset, int32_t mesh, int32_t primitive, std::vector<float>& positions, std::vector<uint32_t>& indices)
+{
+	if (mesh < 0 || static_cast<size_t>(mesh) >= asset.meshes.size() || primitive < 0 || static_cast<size_t>(primitive) >= asset.meshes[mesh].primitives.size())
+	{
+		fprintf(stderr, "\nError: mesh %d primitive %d does not exist\n", mesh, primitive);
+		return false;
+	}
+
+	const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& source = asset.meshes[mesh].primitives[primitive];
+	if (source.mode != -1 && source.mode != 4)
+	{
+		fprintf(stderr, "\nError: mesh %d primitive %d is not a triangle list\n", mesh, primitive);
+		return false;
+	}
+
+	const auto position = source.attributes.find("POSITION");
+	if (position == source.attributes.end() || !EGLTF::ReadGLTFAccessor(asset, position->second, positions) || asset.accessors[position->second].type != "VEC3")
+	{
+		fprintf(stderr, "\nError: mesh %d primitive %d has no usable POSITION\n", mesh, primitive);
+		return false;
+	}
+
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+	if (source.indices == -1)
+	{
+		indices.resize(vertexCount);
+		std::iota(indices.begin(), indices.end(), 0u);
+	}
+	else if (!EGLTF::ReadGLTFAccessorIndices(asset, source.indices, indices))
+		return false;
+
+	indices.resize(indices.size() - indices.size() % 3);
+	for (uint32_t index : indices)
+	{
+		if (index >= vertexCount)
+		{
+			fprintf(stderr, "\nError: mesh %d primitive %d has index %u but only %u vertices\n", mesh, primitive, index, vertexCount);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+struct SVec3
+{
+	float x, y, z;
+};
+
+static SVec3 Load3(const std::vector<float>& values, size_t index)
+{
+	return { values[index * 3], values[index * 3 + 1], values[index * 3 + 2] };
+}
+
+static SVec3 Sub(const SVec3& a, const SVec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static float Dot(const SVec3& a, const SVec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static SVec3 Cross(const SVec3& a, const SVec3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+
+// Sphere around the bounding box and the cone of the face normals, the cone the way meshoptimizer sets it up
+static void ComputeBounds(const std::vector<float>& positions, const uint32_t* vertices, const uint8_t* triangles, EGLTF::SGLTFMeshlet& meshlet)
+{
+	SVec3 lo = Load3(positions, vertices[0]);
+	SVec3 hi = lo;
+	for (uint32_t v = 1; v < meshlet.vertexCount; ++v)
+	{
+		const SVec3 p = Load3(positions, vertices[v]);
+		lo = { std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z) };
+		hi = { std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z) };
+	}
+
+	const SVec3 center = { (lo.x + hi.x) * 0.5f, (lo.y + hi.y) * 0.5f, (lo.z + hi.z) * 0.5f };
+	float radius = 0.0f;
+	for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+	{
+		const SVec3 d = Sub(Load3(positions, vertices[v]), center);
+		radius = std::max(radius, std::sqrt(Dot(d, d)));
+	}
+
+	meshlet.center[0] = center.x;
+	meshlet.center[1] = center.y;
+	meshlet.center[2] = center.z;
+	meshlet.radius = radius;
+
+	// no usable cone unless proven otherwise
+	meshlet.coneApex[0] = center.x;
+	meshlet.coneApex[1] = center.y;
+	meshlet.coneApex[2] = center.z;
+	meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+	meshlet.coneCutoff = 1.0f;
+
+	std::vector<SVec3> normals;
+	std::vector<SVec3> corners;
+	normals.reserve(meshlet.triangleCount);
+	SVec3 sum = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+	{
+		const SVec3 a = Load3(positions, vertices[triangles[t * 3]]);
+		SVec3 n = Cross(Sub(Load3(positions, vertices[triangles[t * 3 + 1]]), a), Sub(Load3(positions, vertices[triangles[t * 3 + 2]]), a));
+		const float length = std::sqrt(Dot(n, n));
+		if (!(length > 0.0f))
+			continue; // degenerate, faces nowhere
+
+		n = { n.x / length, n.y / length, n.z / length };
+		normals.push_back(n);
+		corners.push_back(a);
+		sum = { sum.x + n.x, sum.y + n.y, sum.z + n.z };
+	}
+
+	const float sumLength = std::sqrt(Dot(sum, sum));
+	if (normals.empty() || !(sumLength > 0.0f))
+		return;
+
+	const SVec3 axis = { sum.x / sumLength, sum.y / sumLength, sum.z / sumLength };
+	float minDot = 1.0f;
+	for (const SVec3& n : normals)
+		minDot = std::min(minDot, Dot(n, axis));
+
+	// too wide to ever be all back facing
+	if (minDot <= 0.1f)
+		return;
+
+	// move the apex back until every triangle's plane is in front of it
+	float maxT = 0.0f;
+	for (size_t i = 0; i < normals.size(); ++i)
+		maxT = std::max(maxT, Dot(Sub(center, corners[i]), normals[i]) / Dot(axis, normals[i]));
+
+	meshlet.coneApex[0] = center.x - axis.x * maxT;
+	meshlet.coneApex[1] = center.y - axis.y * maxT;
+	meshlet.coneApex[2] = center.z - axis.z * maxT;
+	meshlet.coneAxis[0] = axis.x;
+	meshlet.coneAxis[1] = axis.y;
+	meshlet.coneAxis[2] = axis.z;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+bool EGLTF::BuildGLTFMeshlets(const SGLTFAsset& asset, int32_t mesh, int32_t primitive, SGLTFMeshletPrimitive& out, const SGLTFMeshletOptions& options)
+{
+	out = SGLTFMeshletPrimitive();
+	out.mesh = mesh;
+	out.primitive = primitive;
+
+	if (options.maxVertices < 3 || options.maxVertices > 256 || options.maxTriangles < 1)
+	{
+		fprintf(stderr, "\nError: meshlets need 3 to 256 vertices and at least one triangle\n");
+		return false;
+	}
+
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	if (!ReadTriangles(asset, mesh, primitive, positions, indices))
+		return false;
+
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	// triangles around each vertex
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t index : indices)
+		++offsets[index + 1];
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+		for (size_t c = 0; c < indices.size(); ++c)
+			adjacency[cursor[indices[c]]++] = static_cast<uint32_t>(c / 3);
+	}
+
+	std::vector<uint32_t> live(vertexCount); // unused triangles left on each vertex
+	for (uint32_t v = 0; v < vertexCount; ++v)
+		live[v] = offsets[v + 1] - offsets[v];
+
+	std::vector<uint8_t> used(triangleCount, 0);
+	std::vector<uint32_t> localStamp(vertexCount, UINT32_MAX); // meshlet a vertex was last added to
+	std::vector<uint8_t> localIndex(vertexCount, 0);
+	std::vector<uint32_t> candidateStamp(triangleCount, UINT32_MAX); // meshlet a triangle was last a candidate of
+
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	uint32_t stamp = 0;
+	uint32_t cursor = 0; // first triangle that may still be unused
+	uint32_t seed = UINT32_MAX;
+
+	auto liveScore = [&](uint32_t t) { return live[indices[t * 3]] + live[indices[t * 3 + 1]] + live[indices[t * 3 + 2]]; };
+
+	auto flush = [&]()
+	{
+		if (meshletTriangles.empty())
+			return;
+
+		SGLTFMeshlet meshlet;
+		meshlet.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(out.triangles.size() / 3);
+		meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size() / 3);
+		ComputeBounds(positions, meshletVertices.data(), meshletTriangles.data(), meshlet);
+
+		// the next one starts next to this one, where the fewest triangles are left
+		seed = UINT32_MAX;
+		uint32_t seedScore = UINT32_MAX;
+		for (uint32_t v : meshletVertices)
+		{
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+			{
+				const uint32_t t = adjacency[i];
+				if (!used[t] && (liveScore(t) < seedScore || (liveScore(t) == seedScore && t < seed)))
+				{
+					seed = t;
+					seedScore = liveScore(t);
+				}
+			}
+		}
+
+		out.meshlets.push_back(meshlet);
+		out.vertices.insert(out.vertices.end(), meshletVertices.begin(), meshletVertices.end());
+		out.triangles.insert(out.triangles.end(), meshletTriangles.begin(), meshletTriangles.end());
+
+		meshletVertices.clear();
+		meshletTriangles.clear();
+		candidates.clear();
+		++stamp;
+	};
+
+	for (;;)
+	{
+		// best candidate: fewest new vertices, then fewest unused triangles around it
+		uint32_t best = UINT32_MAX;
+		uint64_t bestScore = UINT64_MAX;
+		size_t kept = 0;
+		for (size_t i = 0; i < candidates.size(); ++i)
+		{
+			const uint32_t t = candidates[i];
+			if (used[t])
+				continue;
+			candidates[kept++] = t;
+
+			uint32_t added = 0;
+			for (int k = 0; k < 3; ++k)
+				added += localStamp[indices[t * 3 + k]] != stamp;
+			if (meshletVertices.size() + added > options.maxVertices)
+				continue;
+
+			const uint64_t score = static_cast<uint64_t>(added) << 32 | liveScore(t);
+			if (score < bestScore)
+			{
+				best = t;
+				bestScore = score;
+			}
+		}
+		candidates.resize(kept);
+
+		if (best == UINT32_MAX)
+		{
+			// nothing connected fits, carry on with the next triangle in index order if it does
+			if (seed != UINT32_MAX && !used[seed])
+				best = seed;
+			else
+			{
+				while (cursor < triangleCount && used[cursor])
+					++cursor;
+				if (cursor == triangleCount)
+					break;
+				best = cursor;
+			}
+			seed = UINT32_MAX;
+
+			uint32_t added = 0;
+			for (int k = 0; k < 3; ++k)
+				added += localStamp[indices[best * 3 + k]] != stamp;
+			if (meshletVertices.size() + added > options.maxVertices)
+			{
+				flush();
+				continue;
+			}
+		}
+
+		used[best] = 1;
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t v = indices[best * 3 + k];
+			--live[v];
+
+			if (localStamp[v] != stamp)
+			{
+				localStamp[v] = stamp;
+				localIndex[v] = static_cast<uint8_t>(meshletVertices.size());
+				meshletVertices.push_back(v);
+
+				for (uint32_t i = offsets[v]; i < offsets[v + 1]; ++i)
+				{
+					const uint32_t t = adjacency[i];
+					if (!used[t] && candidateStamp[t] != stamp)
+					{
+						candidateStamp[t] = stamp;
+						candidates.push_back(t);
+					}
+				}
+			}
+			meshletTriangles.push_back(localIndex[v]);
+		}
+
+		if (meshletTriangles.size() / 3 >= options.maxTriangles)
+			flush();
+	}
+
+	flush();
+	return true;
+}
+
+bool EGLTF::BuildGLTFMeshlets(const SGLTFAsset& asset, std::vector<SGLTFMeshletPrimitive>& out, const SGLTFMeshletOptions& options, CGLTFThreadPool* pool)
+{
+	out.clear();
+	for (size_t m = 0; m < asset.meshes.size(); ++m)
+	{
+		for (size_t p = 0; p < asset.meshes[m].primitives.size(); ++p)
+		{
+			const int32_t mode = asset.meshes[m].primitives[p].mode;
+			if (mode != -1 && mode != 4)
+				continue;
+
+			SGLTFMeshletPrimitive primitive;
+			primitive.mesh = static_cast<int32_t>(m);
+			primitive.primitive = static_cast<int32_t>(p);
+			out.push_back(primitive);
+		}
+	}
+
+	std::vector<uint8_t> failed(out.size(), 0);
+	auto build = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			failed[i] = !BuildGLTFMeshlets(asset, out[i].mesh, out[i].primitive, out[i], options);
+	};
+
+	if (pool && out.size() > 1)
+		pool->ParallelFor(out.size(), 1, build);
+	else
+		build(0, out.size());
+
+	return std::find(failed.begin(), failed.end(), 1) == failed.end();
+}
+
+bool EGLTF::ValidateGLTFMeshlets(const SGLTFAsset& asset, const SGLTFMeshletPrimitive& meshlets, SGLTFValidationReport& report, const SGLTFMeshletOptions& options)
+{
+	const size_t before = report.issues.size();
+	const std::string path = "meshes[" + std::to_string(meshlets.mesh) + "].primitives[" + std::to_string(meshlets.primitive) + "]";
+
+	auto error = [&](const std::string& where, const std::string& message)
+	{
+		SGLTFValidationIssue issue;
+		issue.severity = EGLTFValidationSeverity::ERROR;
+		issue.path = where;
+		issue.message = message;
+		report.issues.push_back(issue);
+	};
+
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	if (!ReadTriangles(asset, meshlets.mesh, meshlets.primitive, positions, indices))
+	{
+		error(path, "can't be read");
+		return false;
+	}
+
+	// triangles rotated so the smallest index comes first, which keeps the winding
+	typedef std::array<uint32_t, 3> TTriangle;
+	auto canonical = [](uint32_t a, uint32_t b, uint32_t c) -> TTriangle
+	{
+		if (b < a && b <= c)
+			return { { b, c, a } };
+		if (c < a && c < b)
+			return { { c, a, b } };
+		return { { a, b, c } };
+	};
+
+	std::vector<TTriangle> expected(indices.size() / 3);
+	for (size_t t = 0; t < expected.size(); ++t)
+		expected[t] = canonical(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2]);
+
+	std::vector<TTriangle> covered;
+	for (size_t m = 0; m < meshlets.meshlets.size(); ++m)
+	{
+		const SGLTFMeshlet& meshlet = meshlets.meshlets[m];
+		const std::string where = path + ".meshlets[" + std::to_string(m) + "]";
+
+		if (meshlet.vertexCount > options.maxVertices || meshlet.triangleCount > options.maxTriangles)
+			error(where, "has " + std::to_string(meshlet.vertexCount) + " vertices and " + std::to_string(meshlet.triangleCount) + " triangles, over the limits");
+
+		if (static_cast<uint64_t>(meshlet.vertexOffset) + meshlet.vertexCount > meshlets.vertices.size() ||
+			(static_cast<uint64_t>(meshlet.triangleOffset) + meshlet.triangleCount) * 3 > meshlets.triangles.size())
+		{
+			error(where, "points past the vertex or triangle table");
+			continue;
+		}
+
+		const uint32_t* vertices = &meshlets.vertices[meshlet.vertexOffset];
+		bool valid = true;
+		for (uint32_t v = 0; v < meshlet.vertexCount; ++v)
+		{
+			if (vertices[v] >= positions.size() / 3)
+			{
+				error(where, "uses vertex " + std::to_string(vertices[v]) + " which the primitive does not have");
+				valid = false;
+				break;
+			}
+
+			const SVec3 d = Sub(Load3(positions, vertices[v]), { meshlet.center[0], meshlet.center[1], meshlet.center[2] });
+			if (std::sqrt(Dot(d, d)) > meshlet.radius * 1.0001f + 1e-6f)
+				error(where, "does not contain vertex " + std::to_string(vertices[v]) + " in its bounding sphere");
+		}
+		if (!valid)
+			continue;
+
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+		{
+			const uint8_t* triangle = &meshlets.triangles[(meshlet.triangleOffset + t) * 3];
+			if (triangle[0] >= meshlet.vertexCount || triangle[1] >= meshlet.vertexCount || triangle[2] >= meshlet.vertexCount)
+			{
+				error(where, "triangle " + std::to_string(t) + " uses a local vertex past its vertex count");
+				continue;
+			}
+			covered.push_back(canonical(vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]]));
+		}
+	}
+
+	std::sort(expected.begin(), expected.end());
+	std::sort(covered.begin(), covered.end());
+	if (expected != covered)
+	{
+		std::vector<TTriangle> missing, extra;
+		std::set_difference(expected.begin(), expected.end(), covered.begin(), covered.end(), std::back_inserter(missing));
+		std::set_difference(covered.begin(), covered.end(), expected.begin(), expected.end(), std::back_inserter(extra));
+		error(path, std::to_string(missing.size()) + " triangles are not in any meshlet, " + std::to_string(extra.size()) + " are in one too many times or not in the primitive");
+	}
+
+	for (size_t i = before; i < report.issues.size(); ++i)
+		if (report.issues[i].severity == EGLTFValidationSeverity::ERROR)
+			return false;
+	return true;
+}
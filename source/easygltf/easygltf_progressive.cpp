@@ -0,0 +1,488 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_progressive.h"
+#include "easygltf_vfs.h"
+#include "easygltf_base64.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+static bool StartsWith(const std::string& str, const char* prefix)
+{
+	return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static bool EndsWith(const std::string& str, const char* suffix)
+{
+	const size_t len = strlen(suffix);
+	return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+EGLTF::CGLTFProgressiveLoader::CGLTFProgressiveLoader(CGLTFThreadPool& pool)
+	: m_pool(pool), m_inFlight(0)
+{
+}
+
+EGLTF::CGLTFProgressiveLoader::~CGLTFProgressiveLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const auto& entry : m_queue)
+			m_jobs[entry.second].state = EJobState::IDLE;
+		m_queue.clear();
+	}
+
+	WaitIdle();
+}
+
+bool EGLTF::CGLTFProgressiveLoader::Open(const std::string& filepath)
+{
+	m_path = filepath.substr(0, filepath.find_last_of('/') + 1);
+
+	m_easygltf.SetThreadPool(&m_pool);
+	m_easygltf.SetDeferResources(true);
+
+	const bool ok = EndsWith(filepath, ".glb") || EndsWith(filepath, ".GLB") ? m_easygltf.LoadGLB_file(filepath) : m_easygltf.LoadGLTF_file(filepath);
+	if (!ok)
+		return false;
+
+	SGLTFAsset& asset = m_easygltf.GetAssetInstance();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// -1 resident, -2 streamed per bufferView, otherwise the job decoding the whole buffer
+	std::vector<int32_t> bufferJobs(asset.buffers.size(), -1);
+	for (size_t i = 0; i < asset.buffers.size(); ++i)
+	{
+		SGLTFAsset_Prop_Buffer& buffer = asset.buffers[i];
+		if (!buffer.data.empty() || buffer.uri.empty())
+			continue;
+
+		if (StartsWith(buffer.uri, "data:"))
+		{
+			bufferJobs[i] = static_cast<int32_t>(m_jobs.size());
+
+			SJob job;
+			job.type = EJobType::DATA_URI_BUFFER;
+			job.index = static_cast<int32_t>(i);
+			m_jobs.push_back(job);
+		}
+		else
+			bufferJobs[i] = -2;
+	}
+
+	m_viewJobs.assign(asset.bufferViews.size(), -1);
+	for (size_t i = 0; i < asset.bufferViews.size(); ++i)
+	{
+		const int32_t buffer = asset.bufferViews[i].buffer;
+		if (buffer < 0 || buffer >= static_cast<int32_t>(bufferJobs.size()))
+			continue;
+
+		if (bufferJobs[buffer] == -2)
+		{
+			m_viewJobs[i] = static_cast<int32_t>(m_jobs.size());
+
+			SJob job;
+			job.type = EJobType::BUFFER_VIEW;
+			job.index = static_cast<int32_t>(i);
+			job.source = buffer;
+			job.offset = static_cast<uint64_t>(std::max<int64_t>(asset.bufferViews[i].byteOffset, 0));
+			m_jobs.push_back(job);
+
+			// the view gets a buffer of its own, allocated once it is read, so the parts of the file nobody asks for take no memory
+			SGLTFAsset_Prop_Buffer own;
+			own.byteLength = std::max<int64_t>(asset.bufferViews[i].byteLength, 0);
+			own.uri = asset.buffers[buffer].uri;
+
+			asset.bufferViews[i].buffer = static_cast<int32_t>(asset.buffers.size());
+			asset.bufferViews[i].byteOffset = 0;
+			asset.buffers.push_back(std::move(own));
+		}
+		else
+			m_viewJobs[i] = bufferJobs[buffer];
+	}
+
+	m_imageJobs.assign(asset.images.size(), -1);
+	for (size_t i = 0; i < asset.images.size(); ++i)
+	{
+		if (!asset.images[i].data.empty() || asset.images[i].uri.empty())
+			continue;
+
+		m_imageJobs[i] = static_cast<int32_t>(m_jobs.size());
+
+		SJob job;
+		job.type = EJobType::IMAGE;
+		job.index = static_cast<int32_t>(i);
+		m_jobs.push_back(job);
+	}
+
+	return true;
+}
+
+void EGLTF::CGLTFProgressiveLoader::AddViewJob(int32_t bufferView, std::vector<uint32_t>& jobs) const
+{
+	if (bufferView < 0 || bufferView >= static_cast<int32_t>(m_viewJobs.size()) || m_viewJobs[bufferView] < 0)
+		return;
+
+	const uint32_t job = static_cast<uint32_t>(m_viewJobs[bufferView]);
+	if (std::find(jobs.begin(), jobs.end(), job) == jobs.end())
+		jobs.push_back(job);
+}
+
+void EGLTF::CGLTFProgressiveLoader::AddAccessorJobs(int32_t accessor, std::vector<uint32_t>& jobs) const
+{
+	const SGLTFAsset& asset = GetAsset();
+	if (accessor < 0 || accessor >= static_cast<int32_t>(asset.accessors.size()))
+		return;
+
+	const SGLTFAsset_Prop_Accessor& a = asset.accessors[accessor];
+	AddViewJob(a.bufferView, jobs);
+	if (a.sparse.count > 0)
+	{
+		AddViewJob(a.sparse.values, jobs);
+		AddViewJob(a.sparse.indices.first, jobs);
+	}
+}
+
+EGLTF::CGLTFProgressiveLoader::TRequestId EGLTF::CGLTFProgressiveLoader::RequestPrimitive(int32_t mesh, int32_t primitive, int priority, TCallback callback)
+{
+	const SGLTFAsset& asset = GetAsset();
+
+	std::vector<uint32_t> jobs;
+	if (mesh >= 0 && mesh < static_cast<int32_t>(asset.meshes.size()) &&
+		primitive >= 0 && primitive < static_cast<int32_t>(asset.meshes[mesh].primitives.size()))
+	{
+		const SGLTFAsset_Prop_Mesh_Primitive& p = asset.meshes[mesh].primitives[primitive];
+
+		AddAccessorJobs(p.indices, jobs);
+		for (const auto& attribute : p.attributes)
+			AddAccessorJobs(attribute.second, jobs);
+		for (const auto& target : p.targets)
+			for (const auto& attribute : target)
+				AddAccessorJobs(attribute.second, jobs);
+	}
+
+	return Request(std::move(jobs), priority, std::move(callback));
+}
+
+EGLTF::CGLTFProgressiveLoader::TRequestId EGLTF::CGLTFProgressiveLoader::RequestImage(int32_t image, int priority, TCallback callback)
+{
+	const SGLTFAsset& asset = GetAsset();
+
+	std::vector<uint32_t> jobs;
+	if (image >= 0 && image < static_cast<int32_t>(asset.images.size()))
+	{
+		if (m_imageJobs[image] >= 0)
+			jobs.push_back(static_cast<uint32_t>(m_imageJobs[image]));
+		else
+			AddViewJob(asset.images[image].bufferView, jobs);
+	}
+
+	return Request(std::move(jobs), priority, std::move(callback));
+}
+
+EGLTF::CGLTFProgressiveLoader::TRequestId EGLTF::CGLTFProgressiveLoader::RequestBufferView(int32_t bufferView, int priority, TCallback callback)
+{
+	std::vector<uint32_t> jobs;
+	AddViewJob(bufferView, jobs);
+
+	return Request(std::move(jobs), priority, std::move(callback));
+}
+
+EGLTF::CGLTFProgressiveLoader::TRequestId EGLTF::CGLTFProgressiveLoader::Request(std::vector<uint32_t> jobs, int priority, TCallback callback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const TRequestId id = static_cast<TRequestId>(m_requests.size());
+	m_requests.emplace_back(new SRequest());
+
+	SRequest& request = *m_requests.back();
+	request.priority = priority;
+	request.callback = std::move(callback);
+	request.jobs = std::move(jobs);
+
+	size_t queued = 0;
+	for (uint32_t index : request.jobs)
+	{
+		SJob& job = m_jobs[index];
+		if (job.state == EJobState::DONE)
+		{
+			request.ok &= job.ok;
+			continue;
+		}
+
+		job.waiting.push_back(id);
+		++request.remaining;
+
+		if (job.state == EJobState::IDLE)
+		{
+			job.state = EJobState::QUEUED;
+			job.priority = priority;
+			m_queue.insert(std::make_pair(-priority, index));
+			++queued;
+		}
+		else if (job.state == EJobState::QUEUED)
+			UpdatePriority(index);
+	}
+
+	if (request.remaining == 0)
+	{
+		TCallback done = std::move(request.callback);
+		const bool ok = request.ok;
+		lock.unlock();
+
+		if (done)
+			done(id, ok);
+		return id;
+	}
+
+	lock.unlock();
+
+	// like the batch loader, a task does not stand for a job in particular but for whatever is most important by the time it runs
+	for (size_t i = 0; i < queued; ++i)
+	{
+		m_inFlight.fetch_add(1);
+		m_pool.Submit([this]() { StreamNext(); });
+	}
+
+	return id;
+}
+
+void EGLTF::CGLTFProgressiveLoader::UpdatePriority(uint32_t index)
+{
+	SJob& job = m_jobs[index];
+
+	bool any = false;
+	int priority = 0;
+	for (TRequestId id : job.waiting)
+	{
+		const SRequest& request = *m_requests[id];
+		if (request.cancelled)
+			continue;
+
+		priority = any ? std::max(priority, request.priority) : request.priority;
+		any = true;
+	}
+
+	if (job.state != EJobState::QUEUED)
+		return;
+
+	m_queue.erase(std::make_pair(-job.priority, index));
+
+	if (!any)
+	{
+		// nobody wants it anymore
+		job.state = EJobState::IDLE;
+		job.waiting.clear();
+		return;
+	}
+
+	job.priority = priority;
+	m_queue.insert(std::make_pair(-priority, index));
+}
+
+void EGLTF::CGLTFProgressiveLoader::Reprioritize(TRequestId id, int priority)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (id >= m_requests.size())
+		return;
+
+	SRequest& request = *m_requests[id];
+	request.priority = priority;
+
+	for (uint32_t index : request.jobs)
+		UpdatePriority(index);
+}
+
+void EGLTF::CGLTFProgressiveLoader::Cancel(TRequestId id)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (id >= m_requests.size())
+		return;
+
+	SRequest& request = *m_requests[id];
+	request.cancelled = true;
+	request.callback = nullptr;
+
+	for (uint32_t index : request.jobs)
+		UpdatePriority(index);
+}
+
+void EGLTF::CGLTFProgressiveLoader::StreamNext()
+{
+	uint32_t index;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_queue.empty())
+		{
+			// what this task was submitted for got cancelled
+			m_inFlight.fetch_sub(1);
+			return;
+		}
+
+		index = m_queue.begin()->second;
+		m_queue.erase(m_queue.begin());
+		m_jobs[index].state = EJobState::RUNNING;
+	}
+
+	const bool ok = RunJob(m_jobs[index]);
+
+	std::vector<std::pair<TRequestId, TCallback>> done;
+	std::vector<bool> doneOk;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		SJob& job = m_jobs[index];
+		job.state = EJobState::DONE;
+		job.ok = ok;
+
+		for (TRequestId id : job.waiting)
+		{
+			SRequest& request = *m_requests[id];
+			if (request.cancelled)
+				continue;
+
+			request.ok &= ok;
+			if (--request.remaining == 0)
+			{
+				done.push_back(std::make_pair(id, std::move(request.callback)));
+				doneOk.push_back(request.ok);
+			}
+		}
+		job.waiting.clear();
+	}
+
+	for (size_t i = 0; i < done.size(); ++i)
+	{
+		if (done[i].second)
+			done[i].second(done[i].first, doneOk[i]);
+	}
+
+	m_inFlight.fetch_sub(1);
+}
+
+bool EGLTF::CGLTFProgressiveLoader::RunJob(const SJob& job)
+{
+	SGLTFAsset& asset = m_easygltf.GetAssetInstance();
+
+	switch (job.type)
+	{
+	case EJobType::BUFFER_VIEW:
+	{
+		const SGLTFAsset_Prop_BufferView& view = asset.bufferViews[job.index];
+		const SGLTFAsset_Prop_Buffer& file = asset.buffers[job.source];
+		SGLTFAsset_Prop_Buffer& buffer = asset.buffers[view.buffer];
+
+		const uint64_t size = static_cast<uint64_t>(std::max<int64_t>(view.byteLength, 0));
+		if (file.byteLength < 0 || job.offset + size > static_cast<uint64_t>(file.byteLength))
+		{
+			fprintf(stderr, "\nError: bufferViews[%d] is out of the bounds of its buffer\n", job.index);
+			return false;
+		}
+
+		// only this job touches the view's buffer until it is resident
+		buffer.data.resize(static_cast<size_t>(size));
+
+		const SGLTFFileRead read = { job.offset, size, buffer.data.data() };
+		if (!m_easygltf.GetFileSystem().ReadFileRanges(ResolveGLTFUri(m_path, file.uri), &read, 1))
+		{
+			fprintf(stderr, "\nError: could not read bufferViews[%d] from %s\n", job.index, file.uri.c_str());
+			std::vector<uint8_t>().swap(buffer.data);
+			return false;
+		}
+		return true;
+	}
+	case EJobType::DATA_URI_BUFFER:
+	{
+		SGLTFAsset_Prop_Buffer& buffer = asset.buffers[job.index];
+
+		const size_t payload = buffer.uri.find("base64,");
+		if (payload == std::string::npos)
+			return false;
+
+		// the decoder a regular load uses, so both take the same uris
+		const char* base64 = buffer.uri.c_str() + payload + 7;
+		if (!DecodeGLTFBase64(base64, buffer.uri.size() - payload - 7, buffer.data))
+		{
+			fprintf(stderr, "\nError: buffers[%d] is not valid base64\n", job.index);
+			return false;
+		}
+		return true;
+	}
+	case EJobType::IMAGE:
+	{
+		SGLTFAsset_Prop_Image& image = asset.images[job.index];
+
+		// same as a regular load, data uri payloads are handed out as they are
+		static const char* mimeTypes[] = { "data:image/jpeg;base64", "data:image/png;base64" };
+		for (const char* mimeType : mimeTypes)
+		{
+			if (StartsWith(image.uri, mimeType))
+			{
+				image.data.assign(image.uri.begin() + strlen(mimeType), image.uri.end());
+				return true;
+			}
+		}
+
+		std::vector<uint8_t> data;
+		if (!m_easygltf.GetFileSystem().ReadFile(ResolveGLTFUri(m_path, image.uri), data))
+		{
+			fprintf(stderr, "\nError: could not read image %s\n", image.uri.c_str());
+			return false;
+		}
+
+		image.data = std::move(data);
+		return true;
+	}
+	}
+
+	return false;
+}
+
+bool EGLTF::CGLTFProgressiveLoader::IsBufferViewResident(int32_t bufferView) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (bufferView < 0 || bufferView >= static_cast<int32_t>(m_viewJobs.size()))
+		return false;
+
+	return m_viewJobs[bufferView] < 0 || m_jobs[m_viewJobs[bufferView]].state == EJobState::DONE;
+}
+
+bool EGLTF::CGLTFProgressiveLoader::IsImageResident(int32_t image) const
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (image < 0 || image >= static_cast<int32_t>(m_imageJobs.size()))
+			return false;
+
+		if (m_imageJobs[image] >= 0)
+			return m_jobs[m_imageJobs[image]].state == EJobState::DONE;
+	}
+
+	return GetAsset().images[image].bufferView < 0 || IsBufferViewResident(GetAsset().images[image].bufferView);
+}
+
+void EGLTF::CGLTFProgressiveLoader::WaitIdle()
+{
+	while (m_inFlight.load() > 0)
+	{
+		if (!m_pool.RunPendingTask())
+			std::this_thread::yield();
+	}
+}
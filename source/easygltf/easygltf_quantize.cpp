@@ -0,0 +1,955 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#include "easygltf_quantize.h"
+#include "easygltf_geometry.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#define ARRAY_BUFFER 34962
+
+namespace
+{
+	enum class ERole
+	{
+		NONE,
+		POSITION,
+		NORMAL,
+		TANGENT,
+		TEXCOORD,
+		OTHER // used for something that has to stay as it is
+	};
+
+	// Uniform scale and offset from the quantized positions back to mesh units, shared by every mesh in the group
+	struct SPositionGrid
+	{
+		bool usable = true;
+		float lo[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		float hi[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+		float scale = 1.0f;
+	};
+
+	struct SQuantizedAccessor
+	{
+		int32_t accessor = -1;
+		ERole role = ERole::NONE;
+		int32_t grid = -1; // positions only
+
+		bool done = false;
+		std::vector<uint8_t> data;
+		int32_t componentType = -1;
+		std::string type;
+		uint32_t stride = 0;
+		std::vector<double> min; // positions only
+		std::vector<double> max;
+		double error = 0.0;
+	};
+}
+
+static uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+static bool IsResident(const EGLTF::SGLTFAsset& asset, int32_t viewIndex)
+{
+	if (viewIndex < 0 || static_cast<size_t>(viewIndex) >= asset.bufferViews.size())
+		return false;
+
+	const int32_t buffer = asset.bufferViews[viewIndex].buffer;
+	return buffer >= 0 && static_cast<size_t>(buffer) < asset.buffers.size() && !asset.buffers[buffer].data.empty() &&
+		asset.buffers[buffer].data.size() >= static_cast<size_t>(std::max<int64_t>(asset.buffers[buffer].byteLength, 0));
+}
+
+// Float, dense and loaded, with the type the role needs
+static bool IsQuantizable(const EGLTF::SGLTFAsset& asset, int32_t index, ERole role)
+{
+	const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[index];
+	if (accessor.componentType != 5126 || accessor.sparse.count > 0 || accessor.count <= 0 || !IsResident(asset, accessor.bufferView))
+		return false;
+
+	switch (role)
+	{
+	case ERole::POSITION: return accessor.type == "VEC3";
+	case ERole::NORMAL: return accessor.type == "VEC3";
+	case ERole::TANGENT: return accessor.type == "VEC4";
+	case ERole::TEXCOORD: return accessor.type == "VEC2";
+	default: return false;
+	}
+}
+
+template<typename T>
+static void Put(std::vector<uint8_t>& data, size_t offset, T value)
+{
+	memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+static float SignNotZero(float v)
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static void EncodeOctahedral(const float n[3], float& x, float& y)
+{
+	const float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+	x = n[0] / l1;
+	y = n[1] / l1;
+	if (n[2] < 0.0f)
+	{
+		const float ox = (1.0f - std::fabs(y)) * SignNotZero(x);
+		const float oy = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = ox;
+		y = oy;
+	}
+}
+
+void EGLTF::DecodeGLTFOctahedral(float x, float y, float out[3])
+{
+	out[0] = x;
+	out[1] = y;
+	out[2] = 1.0f - std::fabs(x) - std::fabs(y);
+
+	const float t = std::max(-out[2], 0.0f);
+	out[0] += out[0] >= 0.0f ? -t : t;
+	out[1] += out[1] >= 0.0f ? -t : t;
+
+	const float length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+	for (int c = 0; c < 3; ++c)
+		out[c] /= length;
+}
+
+static float Snorm(float v, float max)
+{
+	return std::round(std::max(-1.0f, std::min(1.0f, v)) * max);
+}
+
+static double AngleBetween(const float a[3], const float b[3])
+{
+	const double la = std::sqrt(double(a[0]) * a[0] + double(a[1]) * a[1] + double(a[2]) * a[2]);
+	const double lb = std::sqrt(double(b[0]) * b[0] + double(b[1]) * b[1] + double(b[2]) * b[2]);
+	if (!(la > 0.0) || !(lb > 0.0))
+		return 0.0;
+
+	const double d = (double(a[0]) * b[0] + double(a[1]) * b[1] + double(a[2]) * b[2]) / (la * lb);
+	return std::acos(std::max(-1.0, std::min(1.0, d)));
+}
+
+// NORMAL or TANGENT (xyz + handedness) as snorm with 8 or 16 bits, returns the largest angle error
+static double EncodeDirections(const std::vector<float>& values, uint32_t components, bool octahedral, uint32_t bits, SQuantizedAccessor& out)
+{
+	const size_t count = values.size() / components;
+	const uint32_t size = bits / 8;
+	const float max = bits == 8 ? 127.0f : 32767.0f;
+	const uint32_t stored = octahedral ? 2 : components;
+
+	out.componentType = bits == 8 ? 5120 : 5122;
+	out.type = stored == 2 ? "VEC2" : stored == 3 ? "VEC3" : "VEC4";
+	out.stride = (stored * size + 3) & ~3u;
+	out.data.assign(count * out.stride, 0);
+
+	double error = 0.0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		float n[3] = { values[i * components], values[i * components + 1], values[i * components + 2] };
+		const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (!(length > 0.0f) || !std::isfinite(length))
+			continue; // stays zero, nothing to keep
+
+		for (int c = 0; c < 3; ++c)
+			n[c] /= length;
+
+		float encoded[4];
+		float decoded[3];
+		if (octahedral)
+		{
+			EncodeOctahedral(n, encoded[0], encoded[1]);
+			encoded[0] = Snorm(encoded[0], max);
+			encoded[1] = Snorm(encoded[1], max);
+			EGLTF::DecodeGLTFOctahedral(std::max(encoded[0] / max, -1.0f), std::max(encoded[1] / max, -1.0f), decoded);
+		}
+		else
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				encoded[c] = Snorm(n[c], max);
+				decoded[c] = std::max(encoded[c] / max, -1.0f);
+			}
+		}
+		if (components == 4)
+			encoded[stored - 1] = values[i * components + 3] < 0.0f ? -max : max;
+
+		error = std::max(error, AngleBetween(n, decoded));
+
+		const size_t offset = i * out.stride;
+		for (uint32_t c = 0; c < stored; ++c)
+		{
+			if (bits == 8)
+				Put(out.data, offset + c, static_cast<int8_t>(encoded[c]));
+			else
+				Put(out.data, offset + c * 2, static_cast<int16_t>(encoded[c]));
+		}
+	}
+	return error;
+}
+
+static double EncodeTexcoords(const std::vector<float>& values, uint32_t bits, SQuantizedAccessor& out)
+{
+	const size_t count = values.size() / 2;
+	const float max = bits == 8 ? 255.0f : 65535.0f;
+
+	out.componentType = bits == 8 ? 5121 : 5123;
+	out.type = "VEC2";
+	out.stride = 4; // vertex attributes start on 4 bytes
+	out.data.assign(count * out.stride, 0);
+
+	double error = 0.0;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		const float encoded = std::round(values[i] * max);
+		error = std::max(error, std::fabs(double(values[i]) - encoded / max));
+
+		const size_t offset = (i / 2) * out.stride;
+		if (bits == 8)
+			Put(out.data, offset + (i % 2), static_cast<uint8_t>(encoded));
+		else
+			Put(out.data, offset + (i % 2) * 2, static_cast<uint16_t>(encoded));
+	}
+	return error;
+}
+
+static void EncodePositions(const std::vector<float>& values, const SPositionGrid& grid, SQuantizedAccessor& out)
+{
+	const size_t count = values.size() / 3;
+
+	out.componentType = 5123;
+	out.type = "VEC3";
+	out.stride = 8;
+	out.data.assign(count * out.stride, 0);
+	out.min.assign(3, 65535.0);
+	out.max.assign(3, 0.0);
+
+	double error = 0.0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		double distance = 0.0;
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			const float v = values[i * 3 + c];
+			const float q = std::max(0.0f, std::min(65535.0f, std::round((v - grid.lo[c]) / grid.scale)));
+			const double d = double(v) - (double(grid.lo[c]) + double(q) * grid.scale);
+			distance += d * d;
+
+			out.min[c] = std::min<double>(out.min[c], q);
+			out.max[c] = std::max<double>(out.max[c], q);
+			Put(out.data, i * out.stride + c * 2, static_cast<uint16_t>(q));
+		}
+		error = std::max(error, std::sqrt(distance));
+	}
+	out.error = error;
+}
+
+static void QuantizeAccessor(const EGLTF::SGLTFAsset& asset, const EGLTF::SGLTFQuantizationOptions& options, const std::vector<SPositionGrid>& grids, SQuantizedAccessor& out)
+{
+	std::vector<float> values;
+	if (!EGLTF::ReadGLTFAccessor(asset, out.accessor, values))
+		return;
+
+	for (float v : values)
+		if (!std::isfinite(v))
+			return;
+
+	switch (out.role)
+	{
+	case ERole::POSITION:
+		EncodePositions(values, grids[out.grid], out);
+		out.done = true;
+		break;
+
+	case ERole::NORMAL:
+	case ERole::TANGENT:
+	{
+		const uint32_t components = out.role == ERole::NORMAL ? 3 : 4;
+		const bool octahedral = options.octahedral && out.role == ERole::NORMAL;
+
+		// 8 bit if the bound allows it, no bound means as precise as it gets
+		if (options.normalError > 0.0f)
+		{
+			out.error = EncodeDirections(values, components, octahedral, 8, out);
+			if (out.error <= options.normalError)
+			{
+				out.done = true;
+				break;
+			}
+		}
+
+		out.error = EncodeDirections(values, components, octahedral, 16, out);
+		out.done = options.normalError <= 0.0f || out.error <= options.normalError;
+		break;
+	}
+
+	case ERole::TEXCOORD:
+	{
+		// unorm can't hold anything outside [0, 1], wrapping uvs stay float
+		for (float v : values)
+			if (v < 0.0f || v > 1.0f)
+				return;
+
+		if (options.texcoordError > 0.0f)
+		{
+			out.error = EncodeTexcoords(values, 8, out);
+			if (out.error <= options.texcoordError)
+			{
+				out.done = true;
+				break;
+			}
+		}
+
+		out.error = EncodeTexcoords(values, 16, out);
+		out.done = options.texcoordError <= 0.0f || out.error <= options.texcoordError;
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	if (!out.done)
+		out.data = std::vector<uint8_t>();
+}
+
+// Quaternion (xyzw) times vector
+static void Rotate(const float q[4], const float v[3], float out[3])
+{
+	const float t[3] = {
+		2.0f * (q[1] * v[2] - q[2] * v[1]),
+		2.0f * (q[2] * v[0] - q[0] * v[2]),
+		2.0f * (q[0] * v[1] - q[1] * v[0])
+	};
+	out[0] = v[0] + q[3] * t[0] + (q[1] * t[2] - q[2] * t[1]);
+	out[1] = v[1] + q[3] * t[1] + (q[2] * t[0] - q[0] * t[2]);
+	out[2] = v[2] + q[3] * t[2] + (q[0] * t[1] - q[1] * t[0]);
+}
+
+void EGLTF::SGLTFQuantizationReport::Print(FILE* out) const
+{
+	fprintf(out, "\nQuantization: %u accessors quantized, %u skipped, %u nodes added", quantized, skipped, nodesAdded);
+	fprintf(out, "\nBuffer data: %llu -> %llu bytes, %llu saved", static_cast<unsigned long long>(bytesBefore), static_cast<unsigned long long>(bytesAfter),
+		static_cast<unsigned long long>(GetBytesSaved()));
+	fprintf(out, "\nLargest error: position %g, normal %g rad, texcoord %g\n", maxPositionError, maxNormalError, maxTexcoordError);
+}
+
+bool EGLTF::QuantizeGLTFAsset(SGLTFAsset& asset, SGLTFQuantizationReport& report, const SGLTFQuantizationOptions& options, SGLTFCompactAsset* compact, CGLTFThreadPool* pool)
+{
+	report = SGLTFQuantizationReport();
+	for (const auto& buffer : asset.buffers)
+		report.bytesBefore += buffer.data.size();
+
+	const size_t accessorCount = asset.accessors.size();
+	const size_t nodeCount = compact ? compact->nodes.size() : asset.nodes.size();
+
+	// What every accessor is used for, anything used in two ways is left alone
+	std::vector<ERole> roles(accessorCount, ERole::NONE);
+	auto use = [&](int32_t index, ERole role)
+	{
+		if (index < 0 || static_cast<size_t>(index) >= accessorCount)
+			return;
+		roles[index] = roles[index] == ERole::NONE || roles[index] == role ? role : ERole::OTHER;
+	};
+
+	for (const auto& mesh : asset.meshes)
+	{
+		for (const auto& primitive : mesh.primitives)
+		{
+			use(primitive.indices, ERole::OTHER);
+			for (const auto& attribute : primitive.attributes)
+			{
+				const std::string& name = attribute.first;
+				use(attribute.second, name == "POSITION" ? ERole::POSITION : name == "NORMAL" ? ERole::NORMAL : name == "TANGENT" ? ERole::TANGENT :
+					name.compare(0, 9, "TEXCOORD_") == 0 ? ERole::TEXCOORD : ERole::OTHER);
+			}
+			for (const auto& target : primitive.targets)
+				for (const auto& attribute : target)
+					use(attribute.second, ERole::OTHER);
+		}
+	}
+	for (const auto& skin : asset.skins)
+		use(skin.inverseBindMatrices, ERole::OTHER);
+	for (const auto& animation : asset.animations)
+	{
+		for (const auto& sampler : animation.samplers)
+		{
+			use(sampler.input, ERole::OTHER);
+			use(sampler.output, ERole::OTHER);
+		}
+	}
+	for (const auto& node : asset.nodes)
+		for (const auto& attribute : node.instancing)
+			use(attribute.second, ERole::OTHER);
+	if (compact)
+		for (const auto& instancing : compact->instancing)
+			for (const auto& attribute : instancing.attributes)
+				use(attribute.second, ERole::OTHER);
+
+	// Meshes sharing position accessors have to share the grid, the groups come from a union find over meshes
+	const uint32_t meshCount = static_cast<uint32_t>(asset.meshes.size());
+	std::vector<uint32_t> parents(meshCount);
+	std::iota(parents.begin(), parents.end(), 0u);
+	std::vector<char> meshUsable(meshCount, 1);
+	std::vector<int32_t> owners(accessorCount, -1);
+
+	for (uint32_t m = 0; m < meshCount; ++m)
+	{
+		for (const auto& primitive : asset.meshes[m].primitives)
+		{
+			if (!primitive.targets.empty())
+				meshUsable[m] = 0; // the deltas would need the grid as well
+
+			const auto position = primitive.attributes.find("POSITION");
+			if (position == primitive.attributes.end())
+				continue;
+
+			const int32_t index = position->second;
+			if (index < 0 || static_cast<size_t>(index) >= accessorCount || roles[index] != ERole::POSITION || !IsQuantizable(asset, index, ERole::POSITION))
+			{
+				meshUsable[m] = 0;
+				continue;
+			}
+
+			if (owners[index] == -1)
+				owners[index] = static_cast<int32_t>(m);
+			else
+				parents[FindRoot(parents, m)] = FindRoot(parents, static_cast<uint32_t>(owners[index]));
+		}
+	}
+
+	// The grid transform has to go into a node, so the mesh needs one, and one that actually applies its transform to it
+	std::vector<char> meshReferenced(meshCount, 0);
+	for (size_t n = 0; n < nodeCount; ++n)
+	{
+		const int32_t mesh = compact ? compact->nodes[n].mesh : asset.nodes[n].mesh;
+		const int32_t skin = compact ? compact->nodes[n].skin : asset.nodes[n].skin;
+		if (mesh < 0 || static_cast<uint32_t>(mesh) >= meshCount)
+			continue;
+
+		meshReferenced[mesh] = 1;
+		if (skin != -1 || (!compact && !asset.nodes[n].instancing.empty()))
+			meshUsable[mesh] = 0;
+	}
+	if (compact)
+	{
+		for (const auto& instancing : compact->instancing)
+		{
+			const int32_t mesh = instancing.node >= 0 && static_cast<size_t>(instancing.node) < nodeCount ? compact->nodes[instancing.node].mesh : -1;
+			if (mesh >= 0 && static_cast<uint32_t>(mesh) < meshCount)
+				meshUsable[mesh] = 0;
+		}
+	}
+
+	std::vector<int32_t> meshGrid(meshCount, -1);
+	std::vector<SPositionGrid> grids;
+	for (uint32_t m = 0; m < meshCount; ++m)
+	{
+		const uint32_t root = FindRoot(parents, m);
+		if (meshGrid[root] == -1)
+		{
+			meshGrid[root] = static_cast<int32_t>(grids.size());
+			grids.push_back(SPositionGrid());
+		}
+		meshGrid[m] = meshGrid[root];
+		if (!meshUsable[m] || !meshReferenced[m] || !options.positions)
+			grids[meshGrid[m]].usable = false;
+	}
+
+	// Work list, in accessor order so the output doesn't depend on the threads
+	std::vector<SQuantizedAccessor> work;
+	for (size_t i = 0; i < accessorCount; ++i)
+	{
+		const ERole role = roles[i];
+		if (role == ERole::NONE || role == ERole::OTHER || !IsQuantizable(asset, static_cast<int32_t>(i), role))
+			continue;
+		if ((role == ERole::NORMAL || role == ERole::TANGENT) && !options.normals)
+			continue;
+		if (role == ERole::TEXCOORD && !options.texcoords)
+			continue;
+
+		SQuantizedAccessor item;
+		item.accessor = static_cast<int32_t>(i);
+		item.role = role;
+		if (role == ERole::POSITION)
+		{
+			const int32_t owner = owners[i];
+			if (owner == -1 || !grids[meshGrid[owner]].usable)
+				continue;
+			item.grid = meshGrid[owner];
+		}
+		work.push_back(std::move(item));
+	}
+
+	auto run = [&](const std::function<void(SQuantizedAccessor&)>& func)
+	{
+		auto range = [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+				func(work[i]);
+		};
+
+		if (pool && work.size() > 1)
+			pool->ParallelFor(work.size(), 1, range);
+		else
+			range(0, work.size());
+	};
+
+	// Bounds of the position accessors first, the grids span all of them
+	run([&](SQuantizedAccessor& item)
+	{
+		if (item.role != ERole::POSITION)
+			return;
+
+		std::vector<float> values;
+		item.min.assign(3, std::numeric_limits<double>::infinity());
+		item.max.assign(3, -std::numeric_limits<double>::infinity());
+		if (!ReadGLTFAccessor(asset, item.accessor, values))
+			return;
+
+		for (size_t v = 0; v < values.size(); ++v)
+		{
+			item.min[v % 3] = std::min<double>(item.min[v % 3], values[v]);
+			item.max[v % 3] = std::max<double>(item.max[v % 3], values[v]);
+		}
+	});
+
+	for (const SQuantizedAccessor& item : work)
+	{
+		if (item.role != ERole::POSITION)
+			continue;
+
+		SPositionGrid& grid = grids[item.grid];
+		for (int c = 0; c < 3; ++c)
+		{
+			if (!std::isfinite(item.min[c]) || !std::isfinite(item.max[c]))
+				grid.usable = false;
+			grid.lo[c] = std::min(grid.lo[c], static_cast<float>(item.min[c]));
+			grid.hi[c] = std::max(grid.hi[c], static_cast<float>(item.max[c]));
+		}
+	}
+
+	for (SPositionGrid& grid : grids)
+	{
+		if (!grid.usable || grid.lo[0] > grid.hi[0])
+			continue;
+
+		const float extent = std::max(grid.hi[0] - grid.lo[0], std::max(grid.hi[1] - grid.lo[1], grid.hi[2] - grid.lo[2]));
+		grid.scale = extent > 0.0f ? extent / 65535.0f : 1.0f;
+
+		// rounding to the grid is off by half a step on every axis at most
+		if (options.positionError > 0.0f && 0.5 * std::sqrt(3.0) * grid.scale > options.positionError)
+			grid.usable = false;
+	}
+
+	run([&](SQuantizedAccessor& item)
+	{
+		if (item.role != ERole::POSITION || grids[item.grid].usable)
+			QuantizeAccessor(asset, options, grids, item);
+	});
+
+	// A grid only works if every position on it made it
+	for (const SQuantizedAccessor& item : work)
+		if (item.role == ERole::POSITION && !item.done)
+			grids[item.grid].usable = false;
+
+	// Everything goes into one new buffer
+	SGLTFAsset_Prop_Buffer buffer;
+	const int32_t bufferIndex = static_cast<int32_t>(asset.buffers.size());
+	std::vector<char> quantized(accessorCount, 0);
+
+	for (SQuantizedAccessor& item : work)
+	{
+		if (!item.done || (item.role == ERole::POSITION && !grids[item.grid].usable))
+			continue;
+
+		buffer.data.resize((buffer.data.size() + 3) & ~size_t(3), 0);
+
+		SGLTFAsset_Prop_BufferView view;
+		view.buffer = bufferIndex;
+		view.byteOffset = static_cast<int64_t>(buffer.data.size());
+		view.byteLength = static_cast<int64_t>(item.data.size());
+		view.byteStride = item.stride != GetGLTFElementSize(item.componentType, item.type) ? static_cast<int32_t>(item.stride) : -1;
+		view.target = ARRAY_BUFFER;
+		buffer.data.insert(buffer.data.end(), item.data.begin(), item.data.end());
+		item.data = std::vector<uint8_t>();
+
+		SGLTFAsset_Prop_Accessor& accessor = asset.accessors[item.accessor];
+		accessor.bufferView = static_cast<int32_t>(asset.bufferViews.size());
+		accessor.byteOffset = -1;
+		accessor.componentType = item.componentType;
+		accessor.normalized = item.role != ERole::POSITION;
+		accessor.type = item.type;
+		asset.bufferViews.push_back(view);
+
+		// positions need their bounds, in grid units now. Nothing else needs any and the float ones are wrong by now.
+		const bool bounds = item.role == ERole::POSITION;
+		if (compact)
+		{
+			if (compact->accessorMin.size() > static_cast<size_t>(item.accessor) && compact->accessorMax.size() > static_cast<size_t>(item.accessor))
+			{
+				SGLTFCompact_Range& min = compact->accessorMin[item.accessor];
+				SGLTFCompact_Range& max = compact->accessorMax[item.accessor];
+				min = SGLTFCompact_Range();
+				max = SGLTFCompact_Range();
+				if (bounds)
+				{
+					min.offset = static_cast<uint32_t>(compact->bounds.size());
+					min.count = 3;
+					compact->bounds.insert(compact->bounds.end(), item.min.begin(), item.min.end());
+					max.offset = static_cast<uint32_t>(compact->bounds.size());
+					max.count = 3;
+					compact->bounds.insert(compact->bounds.end(), item.max.begin(), item.max.end());
+				}
+			}
+		}
+		else
+		{
+			accessor.min = bounds ? item.min : std::vector<double>();
+			accessor.max = bounds ? item.max : std::vector<double>();
+		}
+
+		quantized[item.accessor] = 1;
+		++report.quantized;
+
+		double& error = item.role == ERole::POSITION ? report.maxPositionError : item.role == ERole::TEXCOORD ? report.maxTexcoordError : report.maxNormalError;
+		error = std::max(error, item.error);
+	}
+
+	for (size_t i = 0; i < accessorCount; ++i)
+		if (roles[i] != ERole::NONE && roles[i] != ERole::OTHER && !quantized[i])
+			++report.skipped;
+
+	if (!buffer.data.empty())
+	{
+		buffer.byteLength = static_cast<int64_t>(buffer.data.size());
+		asset.buffers.push_back(std::move(buffer));
+	}
+
+	// The grid transform goes into the nodes. Straight into the node's own transform when nothing else sees it,
+	// otherwise into a new child that takes over the mesh.
+	std::vector<char> animated(nodeCount, 0);
+	for (const auto& animation : asset.animations)
+		for (const auto& channel : animation.channels)
+			if (channel.target.node >= 0 && static_cast<size_t>(channel.target.node) < nodeCount)
+				animated[channel.target.node] = 1;
+
+	for (size_t n = 0; n < nodeCount; ++n)
+	{
+		const int32_t mesh = compact ? compact->nodes[n].mesh : asset.nodes[n].mesh;
+		if (mesh < 0 || static_cast<uint32_t>(mesh) >= meshCount || !grids[meshGrid[mesh]].usable)
+			continue;
+
+		const SPositionGrid& grid = grids[meshGrid[mesh]];
+		if (compact)
+		{
+			SGLTFCompact_Node& node = compact->nodes[n];
+			if (node.children.count == 0 && node.camera == -1 && !animated[n])
+			{
+				// T * R * S * (scale, offset) is still a TRS
+				float offset[3];
+				float rotated[3];
+				for (int c = 0; c < 3; ++c)
+					offset[c] = node.scale[c] * grid.lo[c];
+				Rotate(node.rotation, offset, rotated);
+				for (int c = 0; c < 3; ++c)
+				{
+					node.translation[c] += rotated[c];
+					node.scale[c] *= grid.scale;
+				}
+				continue;
+			}
+
+			SGLTFCompact_Node child;
+			for (int c = 0; c < 3; ++c)
+			{
+				child.translation[c] = grid.lo[c];
+				child.scale[c] = grid.scale;
+			}
+			child.mesh = mesh;
+
+			// the children move to the end of the pool so the new one fits in the range
+			SGLTFCompact_Range children = node.children;
+			node.mesh = -1;
+			node.children.offset = static_cast<uint32_t>(compact->children.size());
+			node.children.count = children.count + 1;
+			for (uint32_t c = 0; c < children.count; ++c)
+			{
+				const int32_t index = compact->children[children.offset + c];
+				compact->children.push_back(index);
+			}
+			compact->children.push_back(static_cast<int32_t>(compact->nodes.size()));
+			compact->nodes.push_back(child);
+		}
+		else
+		{
+			SGLTFAsset_Prop_Node& node = asset.nodes[n];
+			if (node.children.empty() && node.camera == -1 && !animated[n])
+			{
+				// matrix * grid, the grid only scales and translates
+				for (int c = 0; c < 3; ++c)
+					node.matrix[12 + c] += node.matrix[c] * grid.lo[0] + node.matrix[4 + c] * grid.lo[1] + node.matrix[8 + c] * grid.lo[2];
+				for (int c = 0; c < 12; ++c)
+					node.matrix[c] *= grid.scale;
+				continue;
+			}
+
+			SGLTFAsset_Prop_Node child;
+			child.matrix = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			for (int c = 0; c < 3; ++c)
+			{
+				child.matrix[c * 5] = grid.scale;
+				child.matrix[12 + c] = grid.lo[c];
+			}
+			child.mesh = mesh;
+
+			node.mesh = -1;
+			node.children.push_back(static_cast<int32_t>(asset.nodes.size()));
+			asset.nodes.push_back(child);
+		}
+		++report.nodesAdded;
+	}
+
+	PruneGLTFBuffers(asset);
+	for (const auto& b : asset.buffers)
+		report.bytesAfter += b.data.size();
+
+	return true;
+}
+
+// Views that are not interleaved get one view per accessor, cut down to what the accessor reads,
+// so the data of an accessor that isn't used any more can go even when its neighbours stay
+static void SplitGLTFBufferViews(EGLTF::SGLTFAsset& asset)
+{
+	const size_t viewCount = asset.bufferViews.size();
+	std::vector<char> shared(viewCount, 0); // referenced by something other than a plain accessor
+	std::vector<std::vector<size_t>> accessors(viewCount);
+
+	auto share = [&](int32_t view)
+	{
+		if (view >= 0 && static_cast<size_t>(view) < viewCount)
+			shared[view] = 1;
+	};
+	for (size_t i = 0; i < asset.accessors.size(); ++i)
+	{
+		const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[i];
+		if (accessor.sparse.count > 0)
+		{
+			share(accessor.bufferView);
+			share(accessor.sparse.values);
+			share(accessor.sparse.indices.first);
+		}
+		else if (accessor.bufferView >= 0 && static_cast<size_t>(accessor.bufferView) < viewCount)
+			accessors[accessor.bufferView].push_back(i);
+	}
+	for (const auto& image : asset.images)
+		share(image.bufferView);
+
+	for (size_t v = 0; v < viewCount; ++v)
+	{
+		if (shared[v] || accessors[v].empty() || !IsResident(asset, static_cast<int32_t>(v)))
+			continue;
+
+		const EGLTF::SGLTFAsset_Prop_BufferView view = asset.bufferViews[v];
+		const int64_t viewBegin = std::max<int64_t>(view.byteOffset, 0);
+		const int64_t viewEnd = viewBegin + std::max<int64_t>(view.byteLength, 0);
+
+		bool valid = true;
+		for (size_t i : accessors[v])
+		{
+			const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[i];
+			const uint32_t elementSize = EGLTF::GetGLTFElementSize(accessor.componentType, accessor.type);
+			const int64_t size = static_cast<int64_t>(elementSize) * std::max<int64_t>(accessor.count, 0);
+			if (size <= 0 || viewBegin + std::max<int64_t>(accessor.byteOffset, 0) + size > viewEnd)
+				valid = false;
+
+			// interleaved
+			if (view.byteStride > 0 && static_cast<uint32_t>(view.byteStride) != elementSize)
+				valid = false;
+		}
+		if (!valid)
+			continue;
+
+		for (size_t n = 0; n < accessors[v].size(); ++n)
+		{
+			EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[accessors[v][n]];
+
+			EGLTF::SGLTFAsset_Prop_BufferView part = view;
+			part.byteOffset = static_cast<int64_t>(viewBegin + std::max<int64_t>(accessor.byteOffset, 0));
+			part.byteLength = static_cast<int64_t>(EGLTF::GetGLTFElementSize(accessor.componentType, accessor.type) * accessor.count);
+			accessor.byteOffset = -1;
+
+			if (n == 0)
+				asset.bufferViews[v] = part;
+			else
+			{
+				accessor.bufferView = static_cast<int32_t>(asset.bufferViews.size());
+				asset.bufferViews.push_back(part);
+			}
+		}
+	}
+}
+
+uint64_t EGLTF::PruneGLTFBuffers(SGLTFAsset& asset)
+{
+	SplitGLTFBufferViews(asset);
+
+	const size_t viewCount = asset.bufferViews.size();
+	std::vector<char> used(viewCount, 0);
+	auto use = [&](int32_t view)
+	{
+		if (view >= 0 && static_cast<size_t>(view) < viewCount)
+			used[view] = 1;
+	};
+
+	for (const auto& accessor : asset.accessors)
+	{
+		use(accessor.bufferView);
+		if (accessor.sparse.count > 0)
+		{
+			use(accessor.sparse.values);
+			use(accessor.sparse.indices.first);
+		}
+	}
+	for (const auto& image : asset.images)
+		use(image.bufferView);
+
+	// Views of buffers that aren't loaded are kept as they are, their offsets have to match the file
+	for (size_t v = 0; v < viewCount; ++v)
+		if (!IsResident(asset, static_cast<int32_t>(v)))
+			used[v] = 1;
+
+	uint64_t freed = 0;
+	std::vector<int32_t> bufferRemap(asset.buffers.size(), -1);
+	std::vector<SGLTFAsset_Prop_Buffer> buffers;
+
+	for (size_t b = 0; b < asset.buffers.size(); ++b)
+	{
+		SGLTFAsset_Prop_Buffer& buffer = asset.buffers[b];
+		std::vector<size_t> views;
+		for (size_t v = 0; v < viewCount; ++v)
+			if (used[v] && asset.bufferViews[v].buffer == static_cast<int32_t>(b))
+				views.push_back(v);
+
+		if (views.empty())
+		{
+			freed += buffer.data.size();
+			continue;
+		}
+
+		bufferRemap[b] = static_cast<int32_t>(buffers.size());
+		if (buffer.data.empty() || buffer.data.size() < static_cast<size_t>(std::max<int64_t>(buffer.byteLength, 0)))
+		{
+			buffers.push_back(std::move(buffer));
+			continue;
+		}
+
+		// Copy the views over by offset, overlapping ones stay overlapping. Every piece keeps its offset modulo 4 so the
+		// accessors in it stay aligned.
+		std::sort(views.begin(), views.end(), [&](size_t x, size_t y) { return std::max<int64_t>(asset.bufferViews[x].byteOffset, 0) < std::max<int64_t>(asset.bufferViews[y].byteOffset, 0); });
+
+		std::vector<uint8_t> data;
+		std::vector<int32_t> offsets(views.size());
+		size_t pieceBegin = 0, pieceEnd = 0, pieceTarget = 0;
+		bool open = false;
+		for (size_t i = 0; i < views.size(); ++i)
+		{
+			const SGLTFAsset_Prop_BufferView& view = asset.bufferViews[views[i]];
+			const size_t begin = static_cast<size_t>(std::max<int64_t>(view.byteOffset, 0));
+			const size_t end = std::min(buffer.data.size(), begin + static_cast<size_t>(std::max<int64_t>(view.byteLength, 0)));
+
+			if (!open || begin > pieceEnd)
+			{
+				if (open)
+					data.insert(data.end(), buffer.data.begin() + pieceBegin, buffer.data.begin() + pieceEnd);
+
+				pieceTarget = data.size() + ((begin - data.size()) & 3);
+				data.resize(pieceTarget, 0);
+				pieceBegin = begin;
+				pieceEnd = std::max(begin, end);
+				open = true;
+			}
+			else
+				pieceEnd = std::max(pieceEnd, end);
+
+			offsets[i] = static_cast<int32_t>(pieceTarget + (begin - pieceBegin));
+		}
+		if (open)
+			data.insert(data.end(), buffer.data.begin() + pieceBegin, buffer.data.begin() + pieceEnd);
+
+		for (size_t i = 0; i < views.size(); ++i)
+			asset.bufferViews[views[i]].byteOffset = offsets[i];
+
+		if (data.size() != buffer.data.size())
+		{
+			// the data no longer matches the file, it only lives in memory now
+			freed += buffer.data.size() - data.size();
+			buffer.data = std::move(data);
+			buffer.byteLength = static_cast<int64_t>(buffer.data.size());
+			buffer.uri.clear();
+		}
+		buffers.push_back(std::move(buffer));
+	}
+	asset.buffers = std::move(buffers);
+
+	std::vector<int32_t> viewRemap(viewCount, -1);
+	std::vector<SGLTFAsset_Prop_BufferView> views;
+	for (size_t v = 0; v < viewCount; ++v)
+	{
+		if (!used[v] || asset.bufferViews[v].buffer < 0 || static_cast<size_t>(asset.bufferViews[v].buffer) >= bufferRemap.size())
+			continue;
+
+		viewRemap[v] = static_cast<int32_t>(views.size());
+		views.push_back(asset.bufferViews[v]);
+		views.back().buffer = bufferRemap[asset.bufferViews[v].buffer];
+	}
+	asset.bufferViews = std::move(views);
+
+	auto remap = [&](int32_t& view)
+	{
+		if (view >= 0 && static_cast<size_t>(view) < viewCount)
+			view = viewRemap[view];
+	};
+	for (auto& accessor : asset.accessors)
+	{
+		remap(accessor.bufferView);
+		if (accessor.sparse.count > 0)
+		{
+			remap(accessor.sparse.values);
+			remap(accessor.sparse.indices.first);
+		}
+	}
+	for (auto& image : asset.images)
+		remap(image.bufferView);
+
+	return freed;
+}
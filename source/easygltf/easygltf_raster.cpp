@@ -0,0 +1,1251 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_raster.h"
+#include "easygltf_geometry.h"
+#include "easygltf_instancing.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EGLTF_RASTER_SSE2
+#endif
+
+typedef std::array<float, 16> TMatrix;
+
+static const TMatrix IDENTITY = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+static const uint32_t TILE_SIZE = 64;
+static const uint32_t MAX_SAMPLES = 8192; // along each axis, keeps sample coordinates exact enough in float
+static const float GUARD_BAND = 2.0f; // triangles reaching further out than this many viewports get clipped
+
+// column major, a * b
+static TMatrix Multiply(const TMatrix& a, const TMatrix& b)
+{
+	TMatrix result;
+	for (int column = 0; column < 4; ++column)
+		for (int row = 0; row < 4; ++row)
+			result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] + a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+	return result;
+}
+
+static void TransformPoint(const TMatrix& m, const float* p, float* out)
+{
+	for (int row = 0; row < 3; ++row)
+		out[row] = m[row] * p[0] + m[4 + row] * p[1] + m[8 + row] * p[2] + m[12 + row];
+}
+
+// The cofactors of the upper 3x3, what normals are transformed with. Unlike the inverse transpose it keeps the sign of the
+// determinant, mirrored nodes flip their normals along with their winding.
+static void NormalMatrix(const TMatrix& m, float* out)
+{
+	out[0] = m[5] * m[10] - m[6] * m[9];
+	out[1] = m[6] * m[8] - m[4] * m[10];
+	out[2] = m[4] * m[9] - m[5] * m[8];
+	out[3] = m[2] * m[9] - m[1] * m[10];
+	out[4] = m[0] * m[10] - m[2] * m[8];
+	out[5] = m[1] * m[8] - m[0] * m[9];
+	out[6] = m[1] * m[6] - m[2] * m[5];
+	out[7] = m[2] * m[4] - m[0] * m[6];
+	out[8] = m[0] * m[5] - m[1] * m[4];
+}
+
+static void TransformNormal(const float* normalMatrix, const float* n, float* out)
+{
+	for (int row = 0; row < 3; ++row)
+		out[row] = normalMatrix[row] * n[0] + normalMatrix[3 + row] * n[1] + normalMatrix[6 + row] * n[2];
+}
+
+static bool Inverse(const TMatrix& m, TMatrix& out)
+{
+	TMatrix inv;
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	const float determinant = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (determinant == 0.0f || !std::isfinite(determinant))
+		return false;
+
+	for (int i = 0; i < 16; ++i)
+		out[i] = inv[i] / determinant;
+	return true;
+}
+
+static float Dot(const float* a, const float* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void Cross(const float* a, const float* b, float* out)
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static bool Normalize(float* v)
+{
+	const float length = std::sqrt(Dot(v, v));
+	if (!(length > 0.0f) || !std::isfinite(length))
+		return false;
+	v[0] /= length, v[1] /= length, v[2] /= length;
+	return true;
+}
+
+// GL conventions, clip z from -w at the near plane to w at the far one, zfar 0 for none
+static TMatrix Perspective(float yfov, float aspect, float znear, float zfar)
+{
+	const float f = 1.0f / std::tan(yfov * 0.5f);
+	TMatrix m = {};
+	m[0] = f / aspect;
+	m[5] = f;
+	m[10] = zfar > znear ? (zfar + znear) / (znear - zfar) : -1.0f;
+	m[11] = -1.0f;
+	m[14] = zfar > znear ? 2.0f * zfar * znear / (znear - zfar) : -2.0f * znear;
+	return m;
+}
+
+static TMatrix Orthographic(float xmag, float ymag, float znear, float zfar)
+{
+	TMatrix m = {};
+	m[0] = 1.0f / xmag;
+	m[5] = 1.0f / ymag;
+	m[10] = 2.0f / (znear - zfar);
+	m[14] = (zfar + znear) / (znear - zfar);
+	m[15] = 1.0f;
+	return m;
+}
+
+static const struct SColorTables
+{
+	float toLinear[256];
+	uint8_t toSRGB[4096];
+
+	SColorTables()
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			const double c = i / 255.0;
+			toLinear[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+		}
+		for (int i = 0; i < 4096; ++i)
+		{
+			const double c = (i + 0.5) / 4096.0;
+			const double s = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+			toSRGB[i] = static_cast<uint8_t>(std::min(255.0, std::floor(s * 255.0 + 0.5)));
+		}
+	}
+} g_colorTables;
+
+static uint8_t LinearToSRGB(float value)
+{
+	const int index = static_cast<int>(value * 4096.0f);
+	return g_colorTables.toSRGB[index < 0 ? 0 : (index > 4095 ? 4095 : index)];
+}
+
+static int32_t Wrap(int32_t i, int32_t size, int32_t mode)
+{
+	if (mode == 33071) // CLAMP_TO_EDGE
+		return i < 0 ? 0 : (i >= size ? size - 1 : i);
+
+	if (mode == 33648) // MIRRORED_REPEAT
+	{
+		const int32_t period = size * 2;
+		int32_t m = i % period;
+		if (m < 0)
+			m += period;
+		return m < size ? m : period - 1 - m;
+	}
+
+	int32_t m = i % size;
+	return m < 0 ? m + size : m;
+}
+
+// Reads what the renderer needs of a primitive: positions with the morph targets at the mesh's weights, normals, one uv set,
+// skinning attributes and the triangles as a list
+static bool ReadPrimitive(const EGLTF::SGLTFAsset& asset, int32_t mesh, int32_t primitiveIndex, int32_t texCoord, std::vector<float>& positions,
+	std::vector<float>& normals, std::vector<float>& uvs, std::vector<float>& joints, std::vector<float>& weights, std::vector<uint32_t>& indices)
+{
+	using namespace EGLTF;
+	const SGLTFAsset_Prop_Mesh& source = asset.meshes[mesh];
+	const SGLTFAsset_Prop_Mesh_Primitive& primitive = source.primitives[primitiveIndex];
+
+	auto read = [&](const TGLTFAsset_Prop_Mesh_Primitive_Attributes& attributes, const char* name, uint32_t components, size_t count, std::vector<float>& out)
+	{
+		out.clear();
+		const auto iter = attributes.find(name);
+		if (iter == attributes.end() || iter->second < 0 || static_cast<size_t>(iter->second) >= asset.accessors.size())
+			return false;
+		if (GetGLTFComponentCount(asset.accessors[iter->second].type) != components || !ReadGLTFAccessor(asset, iter->second, out) ||
+			(count != SIZE_MAX && out.size() != count * components))
+		{
+			out.clear();
+			return false;
+		}
+		return true;
+	};
+
+	if (!read(primitive.attributes, "POSITION", 3, SIZE_MAX, positions))
+	{
+		fprintf(stderr, "\nError: meshes[%d].primitives[%d] has no usable POSITION\n", mesh, primitiveIndex);
+		return false;
+	}
+	const size_t count = positions.size() / 3;
+
+	read(primitive.attributes, "NORMAL", 3, count, normals);
+	if (texCoord >= 0)
+		read(primitive.attributes, ("TEXCOORD_" + std::to_string(texCoord)).c_str(), 2, count, uvs);
+	else
+		uvs.clear();
+
+	if (!read(primitive.attributes, "JOINTS_0", 4, count, joints) || !read(primitive.attributes, "WEIGHTS_0", 4, count, weights))
+	{
+		joints.clear();
+		weights.clear();
+	}
+
+	// morph targets at the default weights
+	std::vector<float> delta;
+	for (size_t t = 0; t < primitive.targets.size() && t < source.weights.size(); ++t)
+	{
+		const float weight = static_cast<float>(source.weights[t]);
+		if (weight == 0.0f)
+			continue;
+
+		if (read(primitive.targets[t], "POSITION", 3, count, delta))
+			for (size_t i = 0; i < delta.size(); ++i)
+				positions[i] += weight * delta[i];
+		if (!normals.empty() && read(primitive.targets[t], "NORMAL", 3, count, delta))
+			for (size_t i = 0; i < delta.size(); ++i)
+				normals[i] += weight * delta[i];
+	}
+
+	std::vector<uint32_t> elements;
+	if (primitive.indices >= 0)
+	{
+		if (!ReadGLTFAccessorIndices(asset, primitive.indices, elements))
+		{
+			fprintf(stderr, "\nError: meshes[%d].primitives[%d] has indices that can't be read\n", mesh, primitiveIndex);
+			return false;
+		}
+	}
+	else
+	{
+		elements.resize(count);
+		for (size_t i = 0; i < count; ++i)
+			elements[i] = static_cast<uint32_t>(i);
+	}
+
+	indices.clear();
+	auto add = [&](uint32_t a, uint32_t b, uint32_t c)
+	{
+		if (a < count && b < count && c < count)
+		{
+			indices.push_back(a);
+			indices.push_back(b);
+			indices.push_back(c);
+		}
+	};
+
+	const int32_t mode = primitive.mode == -1 ? 4 : primitive.mode;
+	if (mode == 4)
+	{
+		for (size_t i = 0; i + 2 < elements.size(); i += 3)
+			add(elements[i], elements[i + 1], elements[i + 2]);
+	}
+	else if (mode == 5)
+	{
+		for (size_t i = 0; i + 2 < elements.size(); ++i)
+			if (i % 2 == 0)
+				add(elements[i], elements[i + 1], elements[i + 2]);
+			else
+				add(elements[i + 1], elements[i], elements[i + 2]);
+	}
+	else if (mode == 6)
+	{
+		for (size_t i = 1; i + 1 < elements.size(); ++i)
+			add(elements[0], elements[i], elements[i + 1]);
+	}
+	return true;
+}
+
+void EGLTF::CGLTFRasterizer::ForEach(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& func)
+{
+	if (m_pool && count > grain)
+		m_pool->ParallelFor(count, grain, func);
+	else if (count > 0)
+		func(0, count);
+}
+
+bool EGLTF::CGLTFRasterizer::CollectDraws(const SGLTFAsset& asset, const SGLTFRenderOptions& options)
+{
+	const size_t nodeCount = asset.nodes.size();
+
+	std::vector<uint8_t> isChild(nodeCount, 0);
+	for (const auto& node : asset.nodes)
+		for (int32_t child : node.children)
+			if (child >= 0 && static_cast<size_t>(child) < nodeCount)
+				isChild[child] = 1;
+
+	std::vector<int32_t> roots;
+	for (size_t n = 0; n < nodeCount; ++n)
+		if (!isChild[n])
+			roots.push_back(static_cast<int32_t>(n));
+
+	// world matrix of every node, joints and cameras don't have to be in the scene that is drawn
+	m_nodeWorld.assign(nodeCount, IDENTITY);
+	std::vector<uint8_t> visited(nodeCount, 0);
+	std::vector<std::pair<int32_t, TMatrix>> stack;
+	for (auto root = roots.rbegin(); root != roots.rend(); ++root)
+		stack.emplace_back(*root, IDENTITY);
+
+	while (!stack.empty())
+	{
+		const int32_t n = stack.back().first;
+		const TMatrix parent = stack.back().second;
+		stack.pop_back();
+
+		if (visited[n])
+			continue;
+		visited[n] = 1;
+
+		TMatrix local;
+		for (int i = 0; i < 16; ++i)
+			local[i] = static_cast<float>(asset.nodes[n].matrix[i]);
+		m_nodeWorld[n] = Multiply(parent, local);
+
+		for (auto child = asset.nodes[n].children.rbegin(); child != asset.nodes[n].children.rend(); ++child)
+			if (*child >= 0 && static_cast<size_t>(*child) < nodeCount)
+				stack.emplace_back(*child, m_nodeWorld[n]);
+	}
+
+	std::vector<int32_t> drawn;
+	if (options.scene >= 0)
+	{
+		if (static_cast<size_t>(options.scene) >= asset.scenes.size())
+		{
+			fprintf(stderr, "\nError: scene %d does not exist\n", options.scene);
+			return false;
+		}
+		drawn = asset.scenes[options.scene].nodes;
+	}
+	else
+		drawn = roots;
+
+	m_primitives.clear();
+	m_draws.clear();
+	std::map<std::pair<int32_t, int32_t>, uint32_t> primitiveIndex;
+	std::vector<float> instanceMatrices;
+
+	std::fill(visited.begin(), visited.end(), 0);
+	std::vector<int32_t> pending(drawn.rbegin(), drawn.rend());
+	while (!pending.empty())
+	{
+		const int32_t n = pending.back();
+		pending.pop_back();
+		if (n < 0 || static_cast<size_t>(n) >= nodeCount || visited[n])
+			continue;
+		visited[n] = 1;
+
+		const SGLTFAsset_Prop_Node& node = asset.nodes[n];
+		for (auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+			pending.push_back(*child);
+
+		if (node.mesh < 0 || static_cast<size_t>(node.mesh) >= asset.meshes.size())
+			continue;
+
+		// EXT_mesh_gpu_instancing draws the mesh once per instance, relative to the node
+		std::vector<TMatrix> transforms;
+		if (!node.instancing.empty() && ReadGLTFInstanceMatrices(asset, node.instancing, instanceMatrices))
+		{
+			for (size_t i = 0; i < instanceMatrices.size() / 16; ++i)
+			{
+				TMatrix local;
+				std::copy(instanceMatrices.begin() + i * 16, instanceMatrices.begin() + (i + 1) * 16, local.begin());
+				transforms.push_back(Multiply(m_nodeWorld[n], local));
+			}
+		}
+		else
+			transforms.push_back(m_nodeWorld[n]);
+
+		const SGLTFAsset_Prop_Mesh& mesh = asset.meshes[node.mesh];
+		for (size_t p = 0; p < mesh.primitives.size(); ++p)
+		{
+			const int32_t mode = mesh.primitives[p].mode;
+			if (mode != -1 && mode != 4 && mode != 5 && mode != 6)
+				continue;
+
+			int32_t material = mesh.primitives[p].material;
+			if (material < 0 || static_cast<size_t>(material) >= asset.materials.size())
+				material = -1;
+
+			const auto found = primitiveIndex.emplace(std::make_pair(node.mesh, static_cast<int32_t>(p)), static_cast<uint32_t>(m_primitives.size()));
+			if (found.second)
+			{
+				SPrimitiveData data;
+				data.mesh = node.mesh;
+				data.primitive = static_cast<int32_t>(p);
+				data.texCoord = -1;
+				if (material >= 0 && options.textures && asset.materials[material].pbrMetallicRoughness.baseColorTexture.index >= 0)
+					data.texCoord = std::max(asset.materials[material].pbrMetallicRoughness.baseColorTexture.texCoord, 0);
+				m_primitives.push_back(std::move(data));
+			}
+
+			for (const TMatrix& transform : transforms)
+			{
+				SDraw draw;
+				draw.primitive = found.first->second;
+				draw.material = material;
+				draw.skin = node.skin >= 0 && static_cast<size_t>(node.skin) < asset.skins.size() ? node.skin : -1;
+				draw.world = transform;
+				m_draws.push_back(std::move(draw));
+			}
+		}
+	}
+
+	m_stats.draws = static_cast<uint32_t>(m_draws.size());
+	return true;
+}
+
+void EGLTF::CGLTFRasterizer::PrepareMaterials(const SGLTFAsset& asset, const SGLTFRenderOptions& options)
+{
+	// only the images the drawn materials use are decoded
+	std::vector<int32_t> images;
+	m_textures.assign(asset.images.size(), STexture());
+	std::vector<int32_t> imageOfTexture(asset.textures.size(), -1);
+
+	m_materials.assign(asset.materials.size() + 1, SMaterial());
+	for (size_t m = 0; m <= asset.materials.size(); ++m)
+	{
+		SMaterial& material = m_materials[m];
+		if (m == asset.materials.size())
+		{
+			// the default material, white and rough
+			material.baseColor[0] = material.baseColor[1] = material.baseColor[2] = material.baseColor[3] = 1.0f;
+			material.emissive[0] = material.emissive[1] = material.emissive[2] = 0.0f;
+			continue;
+		}
+
+		const SGLTFAsset_Prop_Material& source = asset.materials[m];
+		for (int c = 0; c < 4; ++c)
+			material.baseColor[c] = static_cast<float>(source.pbrMetallicRoughness.baseColorFactor[c]);
+		for (int c = 0; c < 3; ++c)
+			material.emissive[c] = static_cast<float>(source.emissiveFactor[c]);
+	}
+
+	if (!options.textures)
+		return;
+
+	std::vector<uint8_t> used(asset.materials.size(), 0);
+	for (const SDraw& draw : m_draws)
+		if (draw.material >= 0)
+			used[draw.material] = 1;
+
+	for (size_t m = 0; m < asset.materials.size(); ++m)
+	{
+		const int32_t texture = asset.materials[m].pbrMetallicRoughness.baseColorTexture.index;
+		if (!used[m] || texture < 0 || static_cast<size_t>(texture) >= asset.textures.size())
+			continue;
+
+		const int32_t image = asset.textures[texture].source;
+		if (image < 0 || static_cast<size_t>(image) >= asset.images.size())
+			continue;
+
+		STexture& target = m_textures[image];
+		const int32_t sampler = asset.textures[texture].sampler;
+		if (sampler >= 0 && static_cast<size_t>(sampler) < asset.samplers.size())
+		{
+			target.wrapS = asset.samplers[sampler].wrapS;
+			target.wrapT = asset.samplers[sampler].wrapT;
+		}
+		m_materials[m].texture = &target;
+
+		if (std::find(images.begin(), images.end(), image) == images.end())
+			images.push_back(image);
+	}
+
+	ForEach(images.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			STexture& texture = m_textures[images[i]];
+			SGLTFBitmap level;
+			if (!DecodeGLTFImage(asset, images[i], level))
+				continue;
+
+			// box filtered mip chain down to 1x1
+			texture.levels.push_back(std::move(level));
+			while (texture.levels.back().width > 1 || texture.levels.back().height > 1)
+			{
+				const SGLTFBitmap& above = texture.levels.back();
+				SGLTFBitmap below;
+				below.width = std::max(above.width / 2, 1u);
+				below.height = std::max(above.height / 2, 1u);
+				below.rgba.resize(size_t(below.width) * below.height * 4);
+
+				for (uint32_t y = 0; y < below.height; ++y)
+				{
+					const uint32_t y0 = std::min(y * 2, above.height - 1), y1 = std::min(y * 2 + 1, above.height - 1);
+					for (uint32_t x = 0; x < below.width; ++x)
+					{
+						const uint32_t x0 = std::min(x * 2, above.width - 1), x1 = std::min(x * 2 + 1, above.width - 1);
+						for (int c = 0; c < 4; ++c)
+						{
+							const uint32_t sum = above.rgba[(size_t(y0) * above.width + x0) * 4 + c] + above.rgba[(size_t(y0) * above.width + x1) * 4 + c] +
+								above.rgba[(size_t(y1) * above.width + x0) * 4 + c] + above.rgba[(size_t(y1) * above.width + x1) * 4 + c];
+							below.rgba[(size_t(y) * below.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+						}
+					}
+				}
+				texture.levels.push_back(std::move(below));
+			}
+		}
+	});
+
+	for (int32_t image : images)
+		if (!m_textures[image].levels.empty())
+			++m_stats.textures;
+}
+
+bool EGLTF::CGLTFRasterizer::SetupCamera(const SGLTFAsset& asset, const SGLTFRenderOptions& options, uint32_t width, uint32_t height)
+{
+	const float aspect = float(width) / float(height);
+	float right[3], up[3], back[3];
+	TMatrix view, projection;
+
+	if (options.camera >= 0)
+	{
+		if (static_cast<size_t>(options.camera) >= asset.nodes.size() || asset.nodes[options.camera].camera < 0 ||
+			static_cast<size_t>(asset.nodes[options.camera].camera) >= asset.cameras.size())
+		{
+			fprintf(stderr, "\nError: node %d has no camera\n", options.camera);
+			return false;
+		}
+
+		const TMatrix& world = m_nodeWorld[options.camera];
+		if (!Inverse(world, view))
+		{
+			fprintf(stderr, "\nError: camera node %d has a transform that can't be inverted\n", options.camera);
+			return false;
+		}
+		for (int i = 0; i < 3; ++i)
+			right[i] = world[i], up[i] = world[4 + i], back[i] = world[8 + i];
+
+		const SGLTFAsset_Prop_Camera& camera = asset.cameras[asset.nodes[options.camera].camera];
+		const float znear = static_cast<float>(camera.znear);
+		const float zfar = static_cast<float>(camera.zfar);
+		if (camera.type == SGLTFAsset_Prop_Camera_Type::PERSPECTIVE)
+			projection = Perspective(static_cast<float>(camera.val1), aspect, znear > 0.0f ? znear : 0.01f, zfar);
+		else
+		{
+			// ymag decides, xmag follows the image
+			const float ymag = std::fabs(static_cast<float>(camera.val1)) > 0.0f ? std::fabs(static_cast<float>(camera.val1)) : 1.0f;
+			projection = Orthographic(ymag * aspect, ymag, znear, zfar > znear ? zfar : znear + 1.0f);
+		}
+	}
+	else
+	{
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const SDraw& draw : m_draws)
+			for (int i = 0; i < 3; ++i)
+			{
+				boundsMin[i] = std::min(boundsMin[i], draw.boundsMin[i]);
+				boundsMax[i] = std::max(boundsMax[i], draw.boundsMax[i]);
+			}
+		if (boundsMin[0] > boundsMax[0])
+			for (int i = 0; i < 3; ++i)
+				boundsMin[i] = -1.0f, boundsMax[i] = 1.0f;
+
+		float center[3], extent[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			center[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+			extent[i] = (boundsMax[i] - boundsMin[i]) * 0.5f;
+		}
+		const float radius = std::max(std::sqrt(Dot(extent, extent)), 1e-6f);
+
+		for (int i = 0; i < 3; ++i)
+			back[i] = options.viewDirection[i];
+		if (!Normalize(back))
+			back[0] = 0.0f, back[1] = 0.0f, back[2] = 1.0f;
+
+		float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+		if (std::fabs(back[1]) > 0.999f)
+			worldUp[1] = 0.0f, worldUp[2] = -back[1];
+		Cross(worldUp, back, right);
+		Normalize(right);
+		Cross(back, right, up);
+
+		// back off until the corners of the bounds are inside both fields of view, tighter than the bounding sphere for long shapes
+		const float fieldOfView = std::min(std::max(options.fieldOfView, 0.01f), 3.0f);
+		const float tanVertical = std::tan(fieldOfView * 0.5f);
+		const float tanHorizontal = tanVertical * aspect;
+		float distance = 0.0f, nearest = -FLT_MAX;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			float offset[3];
+			for (int i = 0; i < 3; ++i)
+				offset[i] = corner & (1 << i) ? extent[i] : -extent[i];
+			const float x = std::fabs(Dot(offset, right)), y = std::fabs(Dot(offset, up)), z = Dot(offset, back);
+			distance = std::max(distance, z + std::max(x / tanHorizontal, y / tanVertical));
+			nearest = std::max(nearest, z);
+		}
+		distance = std::max(distance * 1.02f, radius * 1e-3f);
+
+		float eye[3];
+		for (int i = 0; i < 3; ++i)
+			eye[i] = center[i] + back[i] * distance;
+
+		view = IDENTITY;
+		for (int i = 0; i < 3; ++i)
+		{
+			view[i * 4] = right[i];
+			view[i * 4 + 1] = up[i];
+			view[i * 4 + 2] = back[i];
+		}
+		view[12] = -Dot(right, eye);
+		view[13] = -Dot(up, eye);
+		view[14] = -Dot(back, eye);
+
+		projection = Perspective(fieldOfView, aspect, std::max((distance - nearest) * 0.99f, distance * 0.001f), distance + radius * 1.01f);
+	}
+
+	m_viewProjection = Multiply(projection, view);
+
+	// from over the left shoulder of the camera
+	Normalize(right);
+	Normalize(up);
+	Normalize(back);
+	for (int i = 0; i < 3; ++i)
+	{
+		m_lightDirection[i] = -0.45f * right[i] + 0.6f * up[i] + 0.65f * back[i];
+		m_up[i] = up[i];
+	}
+	Normalize(m_lightDirection);
+	return true;
+}
+
+namespace
+{
+	struct SClipVertex
+	{
+		float p[4];
+		float n[3];
+		float uv[2];
+	};
+
+	SClipVertex Lerp(const SClipVertex& a, const SClipVertex& b, float t)
+	{
+		SClipVertex v;
+		for (int i = 0; i < 4; ++i)
+			v.p[i] = a.p[i] + (b.p[i] - a.p[i]) * t;
+		for (int i = 0; i < 3; ++i)
+			v.n[i] = a.n[i] + (b.n[i] - a.n[i]) * t;
+		for (int i = 0; i < 2; ++i)
+			v.uv[i] = a.uv[i] + (b.uv[i] - a.uv[i]) * t;
+		return v;
+	}
+
+	// distance to the clip planes, inside where it is >= 0: near, then the guard band left, right, bottom and top
+	float PlaneDistance(const SClipVertex& v, int plane)
+	{
+		switch (plane)
+		{
+		case 0: return v.p[2] + v.p[3];
+		case 1: return v.p[0] + GUARD_BAND * v.p[3];
+		case 2: return GUARD_BAND * v.p[3] - v.p[0];
+		case 3: return v.p[1] + GUARD_BAND * v.p[3];
+		default: return GUARD_BAND * v.p[3] - v.p[1];
+		}
+	}
+
+	// outside the view frustum (not the guard band), a bit per plane
+	uint32_t Outcode(const float* p)
+	{
+		return (p[2] < -p[3] ? 1u : 0u) | (p[0] < -p[3] ? 2u : 0u) | (p[0] > p[3] ? 4u : 0u) | (p[1] < -p[3] ? 8u : 0u) | (p[1] > p[3] ? 16u : 0u) |
+			(p[2] > p[3] ? 32u : 0u);
+	}
+}
+
+void EGLTF::CGLTFRasterizer::SetupTriangles(const SDraw& draw, std::vector<STriangle>& out) const
+{
+	out.clear();
+	const SPrimitiveData& data = m_primitives[draw.primitive];
+	if (!data.ok)
+		return;
+
+	const size_t vertexCount = data.positions.size() / 3;
+	std::vector<float> clip(vertexCount * 4);
+	std::vector<uint32_t> outcodes(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		const float* p = &draw.positions[v * 3];
+		float* c = &clip[v * 4];
+		for (int row = 0; row < 4; ++row)
+			c[row] = m_viewProjection[row] * p[0] + m_viewProjection[4 + row] * p[1] + m_viewProjection[8 + row] * p[2] + m_viewProjection[12 + row];
+		outcodes[v] = Outcode(c);
+	}
+
+	const int32_t material = draw.material >= 0 ? draw.material : static_cast<int32_t>(m_materials.size() - 1);
+	const STexture* texture = m_materials[material].texture;
+	const float texels = texture && !texture->levels.empty() ? float(texture->levels[0].width) * float(texture->levels[0].height) : 0.0f;
+	const bool hasUVs = !data.uvs.empty();
+	const float halfWidth = m_sampleWidth * 0.5f;
+	const float halfHeight = m_sampleHeight * 0.5f;
+
+	auto emit = [&](const SClipVertex& a, const SClipVertex& b, const SClipVertex& c)
+	{
+		const SClipVertex* corners[3] = { &a, &b, &c };
+		float x[3], y[3], z[3], inverseW[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const float* p = corners[k]->p;
+			inverseW[k] = 1.0f / p[3];
+			// snapped to 1/16th of a sample, shared vertices land on exactly the same spot
+			x[k] = std::floor((p[0] * inverseW[k] * halfWidth + halfWidth) * 16.0f + 0.5f) / 16.0f;
+			y[k] = std::floor((halfHeight - p[1] * inverseW[k] * halfHeight) * 16.0f + 0.5f) / 16.0f;
+			z[k] = p[2] * inverseW[k] * 0.5f + 0.5f;
+		}
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area == 0.0f || !std::isfinite(area))
+			return;
+
+		// counter clockwise in clip space is clockwise with y going down, those face the camera
+		const bool facing = area < 0.0f;
+		int order[3] = { 0, 1, 2 };
+		if (facing)
+		{
+			std::swap(order[1], order[2]);
+			area = -area;
+		}
+
+		STriangle triangle;
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+		for (int k = 0; k < 3; ++k)
+		{
+			minX = std::min(minX, x[k]), maxX = std::max(maxX, x[k]);
+			minY = std::min(minY, y[k]), maxY = std::max(maxY, y[k]);
+		}
+		triangle.x0 = std::max(0, static_cast<int32_t>(std::ceil(minX - 0.5f)));
+		triangle.y0 = std::max(0, static_cast<int32_t>(std::ceil(minY - 0.5f)));
+		triangle.x1 = std::min(static_cast<int32_t>(m_sampleWidth), static_cast<int32_t>(std::floor(maxX - 0.5f)) + 1);
+		triangle.y1 = std::min(static_cast<int32_t>(m_sampleHeight), static_cast<int32_t>(std::floor(maxY - 0.5f)) + 1);
+		if (triangle.x0 >= triangle.x1 || triangle.y0 >= triangle.y1)
+			return;
+
+		// edge k lies opposite of corner k, positive inside. A shared edge comes out exactly negated in the other triangle,
+		// the tie bit goes to exactly one of them.
+		triangle.ties = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			const int i = order[(k + 1) % 3], j = order[(k + 2) % 3];
+			const float edgeA = y[i] - y[j];
+			const float edgeB = x[j] - x[i];
+			triangle.edges[k][0] = edgeA;
+			triangle.edges[k][1] = edgeB;
+			triangle.edges[k][2] = x[i] * y[j] - x[j] * y[i];
+			if (edgeA > 0.0f || (edgeA == 0.0f && edgeB > 0.0f))
+				triangle.ties |= 1 << k;
+		}
+
+		// a value at the corners as a plane over the samples, through the barycentrics the edges give
+		auto plane = [&](const float* values, float* out)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 3; ++k)
+					sum += triangle.edges[k][c] * values[order[k]];
+				out[c] = sum / area;
+			}
+		};
+
+		plane(z, triangle.depth);
+		plane(inverseW, triangle.inverseW);
+
+		const float flip = facing ? 1.0f : -1.0f;
+		for (int a = 0; a < 5; ++a)
+		{
+			float values[3];
+			for (int k = 0; k < 3; ++k)
+				values[k] = (a < 3 ? corners[k]->n[a] * flip : corners[k]->uv[a - 3]) * inverseW[k];
+			plane(values, triangle.attributes[a]);
+		}
+
+		triangle.material = material;
+		triangle.lod = 0.0f;
+		if (texels > 0.0f && hasUVs)
+		{
+			// texels per sample over the triangle, no perspective
+			const float uvArea = std::fabs((a.uv[0] - c.uv[0]) * (b.uv[1] - c.uv[1]) - (b.uv[0] - c.uv[0]) * (a.uv[1] - c.uv[1]));
+			const float ratio = uvArea * texels / area;
+			if (ratio > 1.0f)
+				triangle.lod = std::min(0.5f * std::log2(ratio), float(texture->levels.size() - 1));
+		}
+
+		out.push_back(triangle);
+	};
+
+	SClipVertex polygon[2][12];
+	const float* normals = data.normals.empty() ? nullptr : draw.normals.data();
+	for (size_t t = 0; t + 2 < data.indices.size(); t += 3)
+	{
+		const uint32_t* index = &data.indices[t];
+		if (outcodes[index[0]] & outcodes[index[1]] & outcodes[index[2]])
+			continue;
+
+		SClipVertex corners[3];
+		float faceNormal[3] = {};
+		if (!normals)
+		{
+			const float* p0 = &draw.positions[index[0] * 3];
+			const float* p1 = &draw.positions[index[1] * 3];
+			const float* p2 = &draw.positions[index[2] * 3];
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			Cross(e1, e2, faceNormal);
+			Normalize(faceNormal);
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			const uint32_t v = index[k];
+			memcpy(corners[k].p, &clip[v * 4], sizeof(float) * 4);
+			memcpy(corners[k].n, normals ? normals + v * 3 : faceNormal, sizeof(float) * 3);
+			corners[k].uv[0] = hasUVs ? data.uvs[v * 2] : 0.0f;
+			corners[k].uv[1] = hasUVs ? data.uvs[v * 2 + 1] : 0.0f;
+		}
+
+		bool needsClipping = false;
+		for (int k = 0; k < 3 && !needsClipping; ++k)
+			for (int plane = 0; plane < 5 && !needsClipping; ++plane)
+				needsClipping = PlaneDistance(corners[k], plane) < 0.0f;
+
+		if (!needsClipping)
+		{
+			emit(corners[0], corners[1], corners[2]);
+			continue;
+		}
+
+		// Sutherland-Hodgman against the near plane and the guard band, then a fan
+		int count = 3;
+		std::copy(corners, corners + 3, polygon[0]);
+		int current = 0;
+		for (int plane = 0; plane < 5 && count > 0; ++plane)
+		{
+			int next = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				const SClipVertex& from = polygon[current][i];
+				const SClipVertex& to = polygon[current][(i + 1) % count];
+				const float d0 = PlaneDistance(from, plane);
+				const float d1 = PlaneDistance(to, plane);
+				if (d0 >= 0.0f)
+					polygon[1 - current][next++] = from;
+				if ((d0 >= 0.0f) != (d1 >= 0.0f))
+					polygon[1 - current][next++] = Lerp(from, to, d0 / (d0 - d1));
+			}
+			count = next;
+			current = 1 - current;
+		}
+
+		for (int i = 1; i + 1 < count; ++i)
+			emit(polygon[current][0], polygon[current][i], polygon[current][i + 1]);
+	}
+}
+
+void EGLTF::CGLTFRasterizer::RasterizeTile(uint32_t tile)
+{
+	const uint32_t stride = m_tilesWide * TILE_SIZE;
+	const int32_t tileX = static_cast<int32_t>((tile % m_tilesWide) * TILE_SIZE);
+	const int32_t tileY = static_cast<int32_t>((tile / m_tilesWide) * TILE_SIZE);
+
+	for (uint32_t y = 0; y < TILE_SIZE; ++y)
+	{
+		std::fill_n(&m_depth[(tileY + y) * stride + tileX], TILE_SIZE, FLT_MAX);
+		std::fill_n(&m_ids[(tileY + y) * stride + tileX], TILE_SIZE, UINT32_MAX);
+	}
+
+	for (uint32_t id : m_bins[tile])
+	{
+		const STriangle& t = *m_triangles[id];
+		const int32_t x0 = std::max(t.x0, tileX), x1 = std::min(t.x1, tileX + static_cast<int32_t>(TILE_SIZE));
+		const int32_t y0 = std::max(t.y0, tileY), y1 = std::min(t.y1, tileY + static_cast<int32_t>(TILE_SIZE));
+
+		for (int32_t y = y0; y < y1; ++y)
+		{
+			const float fy = y + 0.5f;
+			float* depth = &m_depth[y * stride];
+			uint32_t* ids = &m_ids[y * stride];
+
+#ifdef EGLTF_RASTER_SSE2
+			// E = (a * x + b * y) + c on 4 samples, x0 rounded down so the loads stay inside the tile
+			const __m128 vy = _mm_set1_ps(fy);
+			__m128 edgeA[3], edgeBY[3], edgeC[3], edgeTie[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				edgeA[k] = _mm_set1_ps(t.edges[k][0]);
+				edgeBY[k] = _mm_mul_ps(_mm_set1_ps(t.edges[k][1]), vy);
+				edgeC[k] = _mm_set1_ps(t.edges[k][2]);
+				edgeTie[k] = _mm_castsi128_ps(_mm_set1_epi32((t.ties >> k) & 1 ? -1 : 0));
+			}
+			const __m128 depthA = _mm_set1_ps(t.depth[0]);
+			const __m128 depthBY = _mm_mul_ps(_mm_set1_ps(t.depth[1]), vy);
+			const __m128 depthC = _mm_set1_ps(t.depth[2]);
+			const __m128i id4 = _mm_set1_epi32(static_cast<int32_t>(id));
+			const __m128 zero = _mm_setzero_ps();
+
+			for (int32_t x = x0 & ~3; x < x1; x += 4)
+			{
+				const __m128i lane = _mm_add_epi32(_mm_set1_epi32(x), _mm_set_epi32(3, 2, 1, 0));
+				const __m128 vx = _mm_add_ps(_mm_cvtepi32_ps(lane), _mm_set1_ps(0.5f));
+				__m128 mask = _mm_castsi128_ps(_mm_and_si128(_mm_cmpgt_epi32(lane, _mm_set1_epi32(x0 - 1)), _mm_cmplt_epi32(lane, _mm_set1_epi32(x1))));
+
+				for (int k = 0; k < 3; ++k)
+				{
+					const __m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[k], vx), edgeBY[k]), edgeC[k]);
+					const __m128 inside = _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(_mm_cmpeq_ps(e, zero), edgeTie[k]));
+					mask = _mm_and_ps(mask, inside);
+				}
+				if (_mm_movemask_ps(mask) == 0)
+					continue;
+
+				const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, vx), depthBY), depthC);
+				const __m128 stored = _mm_loadu_ps(depth + x);
+				mask = _mm_and_ps(mask, _mm_cmplt_ps(z, stored));
+
+				_mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, stored)));
+				const __m128i storedIds = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + x));
+				const __m128i idMask = _mm_castps_si128(mask);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(ids + x), _mm_or_si128(_mm_and_si128(idMask, id4), _mm_andnot_si128(idMask, storedIds)));
+			}
+#else
+			float edgeBY[3];
+			for (int k = 0; k < 3; ++k)
+				edgeBY[k] = t.edges[k][1] * fy;
+			const float depthBY = t.depth[1] * fy;
+
+			for (int32_t x = x0; x < x1; ++x)
+			{
+				const float fx = x + 0.5f;
+				bool inside = true;
+				for (int k = 0; k < 3 && inside; ++k)
+				{
+					const float e = (t.edges[k][0] * fx + edgeBY[k]) + t.edges[k][2];
+					inside = e > 0.0f || (e == 0.0f && ((t.ties >> k) & 1));
+				}
+				if (!inside)
+					continue;
+
+				const float z = (t.depth[0] * fx + depthBY) + t.depth[2];
+				if (z < depth[x])
+				{
+					depth[x] = z;
+					ids[x] = id;
+				}
+			}
+#endif
+		}
+	}
+}
+
+void EGLTF::CGLTFRasterizer::Shade(uint32_t id, float x, float y, float* rgb) const
+{
+	const STriangle& t = *m_triangles[id];
+	const SMaterial& material = m_materials[t.material];
+
+	auto plane = [&](const float* p) { return p[0] * x + p[1] * y + p[2]; };
+	const float w = 1.0f / plane(t.inverseW);
+
+	float normal[3] = { plane(t.attributes[0]) * w, plane(t.attributes[1]) * w, plane(t.attributes[2]) * w };
+	if (!Normalize(normal))
+		memcpy(normal, m_lightDirection, sizeof(normal));
+
+	float color[3] = { material.baseColor[0], material.baseColor[1], material.baseColor[2] };
+	if (material.texture && !material.texture->levels.empty())
+	{
+		const STexture& texture = *material.texture;
+		const SGLTFBitmap& level = texture.levels[static_cast<size_t>(t.lod + 0.5f)];
+		const float u = plane(t.attributes[3]) * w * level.width - 0.5f;
+		const float v = plane(t.attributes[4]) * w * level.height - 0.5f;
+		const float fu = std::floor(u), fv = std::floor(v);
+		const float du = u - fu, dv = v - fv;
+
+		// clamped before the conversion, uvs far outside of [0, 1] would overflow it
+		const float limit = 1e6f;
+		const int32_t u0 = static_cast<int32_t>(std::max(-limit, std::min(limit, fu)));
+		const int32_t v0 = static_cast<int32_t>(std::max(-limit, std::min(limit, fv)));
+		const int32_t width = static_cast<int32_t>(level.width), height = static_cast<int32_t>(level.height);
+		const int32_t xs[2] = { Wrap(u0, width, texture.wrapS), Wrap(u0 + 1, width, texture.wrapS) };
+		const int32_t ys[2] = { Wrap(v0, height, texture.wrapT), Wrap(v0 + 1, height, texture.wrapT) };
+		const float weights[4] = { (1.0f - du) * (1.0f - dv), du * (1.0f - dv), (1.0f - du) * dv, du * dv };
+
+		float texel[3] = {};
+		for (int i = 0; i < 4; ++i)
+		{
+			const uint8_t* p = &level.rgba[(size_t(ys[i / 2]) * level.width + xs[i % 2]) * 4];
+			for (int c = 0; c < 3; ++c)
+				texel[c] += weights[i] * g_colorTables.toLinear[p[c]];
+		}
+		for (int c = 0; c < 3; ++c)
+			color[c] *= texel[c];
+	}
+
+	// key light plus a sky that is a bit brighter above than below
+	const float diffuse = std::max(Dot(normal, m_lightDirection), 0.0f);
+	const float ambient = 0.2f + 0.12f * (Dot(normal, m_up) * 0.5f + 0.5f);
+	for (int c = 0; c < 3; ++c)
+		rgb[c] = color[c] * (ambient + 0.8f * diffuse) + material.emissive[c];
+}
+
+void EGLTF::CGLTFRasterizer::Resolve(const SGLTFRenderOptions& options, SGLTFBitmap& out, uint32_t rowBegin, uint32_t rowEnd) const
+{
+	const uint32_t samples = std::max(options.supersampling, 1u);
+	const uint32_t stride = m_tilesWide * TILE_SIZE;
+	const float background[3] = { g_colorTables.toLinear[options.background[0]], g_colorTables.toLinear[options.background[1]],
+		g_colorTables.toLinear[options.background[2]] };
+	const float backgroundAlpha = options.background[3] / 255.0f;
+	const float share = 1.0f / float(samples * samples);
+
+	for (uint32_t y = rowBegin; y < rowEnd; ++y)
+	{
+		for (uint32_t x = 0; x < out.width; ++x)
+		{
+			// straight alpha, colors weighted by their coverage
+			float sum[3] = {};
+			float alpha = 0.0f;
+			for (uint32_t sy = y * samples; sy < (y + 1) * samples; ++sy)
+			{
+				for (uint32_t sx = x * samples; sx < (x + 1) * samples; ++sx)
+				{
+					const uint32_t id = m_ids[sy * stride + sx];
+					if (id == UINT32_MAX)
+					{
+						for (int c = 0; c < 3; ++c)
+							sum[c] += background[c] * backgroundAlpha;
+						alpha += backgroundAlpha;
+						continue;
+					}
+
+					float rgb[3];
+					Shade(id, sx + 0.5f, sy + 0.5f, rgb);
+					for (int c = 0; c < 3; ++c)
+						sum[c] += rgb[c];
+					alpha += 1.0f;
+				}
+			}
+
+			uint8_t* pixel = &out.rgba[(size_t(y) * out.width + x) * 4];
+			for (int c = 0; c < 3; ++c)
+				pixel[c] = alpha > 0.0f ? LinearToSRGB(sum[c] / alpha) : 0;
+			pixel[3] = static_cast<uint8_t>(std::floor(alpha * share * 255.0f + 0.5f));
+		}
+	}
+}
+
+bool EGLTF::CGLTFRasterizer::Render(const SGLTFAsset& asset, SGLTFBitmap& out, const SGLTFRenderOptions& options)
+{
+	m_stats = SGLTFRenderStats();
+
+	const uint32_t samples = std::max(options.supersampling, 1u);
+	if (options.width == 0 || options.height == 0 || options.width * samples > MAX_SAMPLES || options.height * samples > MAX_SAMPLES)
+	{
+		fprintf(stderr, "\nError: %ux%u at %u samples per axis is not a size that can be rendered\n", options.width, options.height, samples);
+		return false;
+	}
+
+	if (!CollectDraws(asset, options))
+		return false;
+	PrepareMaterials(asset, options);
+
+	ForEach(m_primitives.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			SPrimitiveData& data = m_primitives[i];
+			data.ok = ReadPrimitive(asset, data.mesh, data.primitive, data.texCoord, data.positions, data.normals, data.uvs, data.joints, data.weights, data.indices);
+		}
+	});
+
+	// into world space, rigged meshes through their joints
+	ForEach(m_draws.size(), 1, [&](size_t begin, size_t end)
+	{
+		std::vector<TMatrix> jointMatrices;
+		std::vector<float> jointNormals;
+		std::vector<float> inverseBinds;
+
+		for (size_t d = begin; d < end; ++d)
+		{
+			SDraw& draw = m_draws[d];
+			const SPrimitiveData& data = m_primitives[draw.primitive];
+			const size_t count = data.ok ? data.positions.size() / 3 : 0;
+			draw.positions.resize(count * 3);
+			draw.normals.resize(data.normals.empty() ? 0 : count * 3);
+			for (int i = 0; i < 3; ++i)
+				draw.boundsMin[i] = FLT_MAX, draw.boundsMax[i] = -FLT_MAX;
+
+			jointMatrices.clear();
+			if (draw.skin >= 0 && !data.joints.empty())
+			{
+				const SGLTFAsset_Prop_Skin& skin = asset.skins[draw.skin];
+				inverseBinds.clear();
+				if (skin.inverseBindMatrices >= 0)
+					ReadGLTFAccessor(asset, skin.inverseBindMatrices, inverseBinds);
+
+				for (size_t j = 0; j < skin.joints.size(); ++j)
+				{
+					const int32_t joint = skin.joints[j];
+					TMatrix inverseBind = IDENTITY;
+					if ((j + 1) * 16 <= inverseBinds.size())
+						std::copy(inverseBinds.begin() + j * 16, inverseBinds.begin() + (j + 1) * 16, inverseBind.begin());
+					const TMatrix& world = joint >= 0 && static_cast<size_t>(joint) < m_nodeWorld.size() ? m_nodeWorld[joint] : IDENTITY;
+					jointMatrices.push_back(Multiply(world, inverseBind));
+				}
+				jointNormals.resize(jointMatrices.size() * 9);
+				for (size_t j = 0; j < jointMatrices.size(); ++j)
+					NormalMatrix(jointMatrices[j], &jointNormals[j * 9]);
+			}
+
+			float normalMatrix[9];
+			NormalMatrix(draw.world, normalMatrix);
+
+			for (size_t v = 0; v < count; ++v)
+			{
+				const float* position = &data.positions[v * 3];
+				float* target = &draw.positions[v * 3];
+
+				if (jointMatrices.empty())
+				{
+					TransformPoint(draw.world, position, target);
+					if (!draw.normals.empty())
+						TransformNormal(normalMatrix, &data.normals[v * 3], &draw.normals[v * 3]);
+				}
+				else
+				{
+					target[0] = target[1] = target[2] = 0.0f;
+					float normal[3] = {};
+					for (int k = 0; k < 4; ++k)
+					{
+						const float weight = data.weights[v * 4 + k];
+						const size_t joint = static_cast<size_t>(data.joints[v * 4 + k]);
+						if (weight == 0.0f || joint >= jointMatrices.size())
+							continue;
+
+						float p[3];
+						TransformPoint(jointMatrices[joint], position, p);
+						for (int i = 0; i < 3; ++i)
+							target[i] += weight * p[i];
+
+						if (!draw.normals.empty())
+						{
+							float n[3];
+							TransformNormal(&jointNormals[joint * 9], &data.normals[v * 3], n);
+							for (int i = 0; i < 3; ++i)
+								normal[i] += weight * n[i];
+						}
+					}
+					if (!draw.normals.empty())
+						memcpy(&draw.normals[v * 3], normal, sizeof(normal));
+				}
+
+				for (int i = 0; i < 3; ++i)
+				{
+					draw.boundsMin[i] = std::min(draw.boundsMin[i], target[i]);
+					draw.boundsMax[i] = std::max(draw.boundsMax[i], target[i]);
+				}
+			}
+		}
+	});
+
+	for (const SDraw& draw : m_draws)
+		m_stats.triangles += m_primitives[draw.primitive].indices.size() / 3;
+
+	m_sampleWidth = options.width * samples;
+	m_sampleHeight = options.height * samples;
+	m_tilesWide = (m_sampleWidth + TILE_SIZE - 1) / TILE_SIZE;
+	m_tilesHigh = (m_sampleHeight + TILE_SIZE - 1) / TILE_SIZE;
+
+	if (!SetupCamera(asset, options, options.width, options.height))
+		return false;
+
+	m_drawTriangles.resize(m_draws.size());
+	ForEach(m_draws.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t d = begin; d < end; ++d)
+			SetupTriangles(m_draws[d], m_drawTriangles[d]);
+	});
+
+	// binned in draw order, so every tile sees its triangles in the same order no matter who set them up
+	m_triangles.clear();
+	m_bins.resize(size_t(m_tilesWide) * m_tilesHigh);
+	for (auto& bin : m_bins)
+		bin.clear();
+
+	for (size_t d = 0; d < m_draws.size(); ++d)
+	{
+		for (const STriangle& triangle : m_drawTriangles[d])
+		{
+			const uint32_t id = static_cast<uint32_t>(m_triangles.size());
+			m_triangles.push_back(&triangle);
+			for (int32_t ty = triangle.y0 / TILE_SIZE; ty <= (triangle.y1 - 1) / static_cast<int32_t>(TILE_SIZE); ++ty)
+				for (int32_t tx = triangle.x0 / TILE_SIZE; tx <= (triangle.x1 - 1) / static_cast<int32_t>(TILE_SIZE); ++tx)
+					m_bins[ty * m_tilesWide + tx].push_back(id);
+		}
+	}
+	m_stats.rasterized = m_triangles.size();
+
+	const size_t stride = size_t(m_tilesWide) * TILE_SIZE;
+	m_depth.resize(stride * m_tilesHigh * TILE_SIZE);
+	m_ids.resize(stride * m_tilesHigh * TILE_SIZE);
+
+	ForEach(m_bins.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t tile = begin; tile < end; ++tile)
+			RasterizeTile(static_cast<uint32_t>(tile));
+	});
+
+	out.width = options.width;
+	out.height = options.height;
+	out.rgba.resize(size_t(out.width) * out.height * 4);
+	ForEach(out.height, 16, [&](size_t begin, size_t end)
+	{
+		Resolve(options, out, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+	});
+
+	return true;
+}
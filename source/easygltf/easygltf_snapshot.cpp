@@ -0,0 +1,648 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The records get written and read as raw memory, so keep their sizes pinned down.
+// If one of these changes, GLTF_SNAPSHOT_VERSION has to be bumped.
+static_assert(sizeof(EGLTF::SGLTFSnapshot_Header) == 408, "snapshot header layout changed");
+static_assert(sizeof(EGLTF::SGLTFSnapshot_Node) == 160, "snapshot node layout changed");
+static_assert(sizeof(EGLTF::SGLTFSnapshot_Accessor) == 72, "snapshot accessor layout changed");
+static_assert(sizeof(EGLTF::SGLTFSnapshot_Material) == 160, "snapshot material layout changed");
+static_assert(sizeof(EGLTF::SGLTFSnapshot_Camera) == 40, "snapshot camera layout changed");
+
+static uint64_t AlignUp(uint64_t val, uint64_t alignment)
+{
+	return (val + alignment - 1) & ~(alignment - 1);
+}
+
+uint64_t EGLTF::HashGLTFSnapshotData(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+uint64_t EGLTF::HashGLTFSnapshotSource(const std::string& filepath)
+{
+	std::ifstream fh(filepath, std::ios::in | std::ios::binary);
+	if (!fh.is_open())
+		return 0;
+
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	std::vector<char> chunk(1 << 16);
+	while (fh)
+	{
+		fh.read(chunk.data(), chunk.size());
+		hash = HashGLTFSnapshotData(chunk.data(), static_cast<size_t>(fh.gcount()), hash);
+	}
+	return hash;
+}
+
+namespace
+{
+	// Collects all the tables in memory before anything gets written.
+	// The payloads (buffer and image data) are not copied, they are only referenced and streamed out at the end.
+	struct SSnapshotBuilder
+	{
+		std::vector<EGLTF::SGLTFSnapshot_Scene> scenes;
+		std::vector<EGLTF::SGLTFSnapshot_Node> nodes;
+		std::vector<EGLTF::SGLTFSnapshot_Mesh> meshes;
+		std::vector<EGLTF::SGLTFSnapshot_Primitive> primitives;
+		std::vector<EGLTF::SGLTFSnapshot_Attribute> attributes;
+		std::vector<EGLTF::SGLTFSnapshot_Target> targets;
+		std::vector<EGLTF::SGLTFSnapshot_Buffer> buffers;
+		std::vector<EGLTF::SGLTFSnapshot_BufferView> bufferViews;
+		std::vector<EGLTF::SGLTFSnapshot_Accessor> accessors;
+		std::vector<EGLTF::SGLTFSnapshot_Material> materials;
+		std::vector<EGLTF::SGLTFSnapshot_Texture> textures;
+		std::vector<EGLTF::SGLTFSnapshot_Image> images;
+		std::vector<EGLTF::SGLTFSnapshot_Sampler> samplers;
+		std::vector<EGLTF::SGLTFSnapshot_Skin> skins;
+		std::vector<EGLTF::SGLTFSnapshot_Animation> animations;
+		std::vector<EGLTF::SGLTFSnapshot_Animation_Channel> channels;
+		std::vector<EGLTF::SGLTFSnapshot_Animation_Sampler> animationSamplers;
+		std::vector<EGLTF::SGLTFSnapshot_Camera> cameras;
+		std::vector<int32_t> indices;
+		std::vector<double> doubles;
+		std::vector<char> strings;
+
+		std::vector<const std::vector<uint8_t>*> payloads;
+		uint64_t payloadSize = 0;
+
+		EGLTF::SGLTFSnapshot_String AddString(const std::string& str)
+		{
+			EGLTF::SGLTFSnapshot_String res;
+			res.offset = static_cast<uint32_t>(strings.size());
+			res.length = static_cast<uint32_t>(str.size());
+			strings.insert(strings.end(), str.begin(), str.end());
+			strings.push_back('\0');
+			return res;
+		}
+
+		EGLTF::SGLTFSnapshot_Range AddIndices(const std::vector<int32_t>& values)
+		{
+			EGLTF::SGLTFSnapshot_Range res;
+			res.offset = static_cast<uint32_t>(indices.size());
+			res.count = static_cast<uint32_t>(values.size());
+			indices.insert(indices.end(), values.begin(), values.end());
+			return res;
+		}
+
+		EGLTF::SGLTFSnapshot_Range AddDoubles(const std::vector<double>& values)
+		{
+			EGLTF::SGLTFSnapshot_Range res;
+			res.offset = static_cast<uint32_t>(doubles.size());
+			res.count = static_cast<uint32_t>(values.size());
+			doubles.insert(doubles.end(), values.begin(), values.end());
+			return res;
+		}
+
+		EGLTF::SGLTFSnapshot_Range AddAttributes(const EGLTF::TGLTFAsset_Prop_Mesh_Primitive_Attributes& attribs)
+		{
+			EGLTF::SGLTFSnapshot_Range res;
+			res.offset = static_cast<uint32_t>(attributes.size());
+			res.count = static_cast<uint32_t>(attribs.size());
+			for (const auto& attrib : attribs)
+			{
+				EGLTF::SGLTFSnapshot_Attribute a;
+				a.name = AddString(attrib.first);
+				a.accessor = attrib.second;
+				attributes.push_back(a);
+			}
+			return res;
+		}
+
+		// offset is relative to the start of the payload section until the layout is known
+		EGLTF::SGLTFSnapshot_Blob AddPayload(const std::vector<uint8_t>& data)
+		{
+			EGLTF::SGLTFSnapshot_Blob res = {};
+			if (data.empty())
+				return res;
+
+			payloadSize = AlignUp(payloadSize, EGLTF::GLTF_SNAPSHOT_ALIGNMENT);
+			res.offset = payloadSize;
+			res.size = data.size();
+			payloadSize += data.size();
+			payloads.push_back(&data);
+			return res;
+		}
+
+		EGLTF::SGLTFSnapshot_Material_Texture MakeTexture(int32_t index, int32_t texCoord, double value)
+		{
+			EGLTF::SGLTFSnapshot_Material_Texture res;
+			res.index = index;
+			res.texCoord = texCoord;
+			res.value = value;
+			return res;
+		}
+
+		void Build(const EGLTF::SGLTFAsset& asset)
+		{
+			for (const auto& v : asset.scenes)
+			{
+				EGLTF::SGLTFSnapshot_Scene scene;
+				scene.nodes = AddIndices(v.nodes);
+				scenes.push_back(scene);
+			}
+
+			nodes.reserve(asset.nodes.size());
+			for (const auto& v : asset.nodes)
+			{
+				EGLTF::SGLTFSnapshot_Node node = {};
+				memcpy(node.matrix, v.matrix.data(), sizeof(node.matrix));
+				node.children = AddIndices(v.children);
+				node.mesh = v.mesh;
+				node.skin = v.skin;
+				node.camera = v.camera;
+				node.name = AddString(v.name);
+				nodes.push_back(node);
+			}
+
+			for (const auto& v : asset.meshes)
+			{
+				EGLTF::SGLTFSnapshot_Mesh mesh;
+				mesh.name = AddString(v.name);
+				mesh.weights = AddDoubles(v.weights);
+				mesh.primitives.offset = static_cast<uint32_t>(primitives.size());
+				mesh.primitives.count = static_cast<uint32_t>(v.primitives.size());
+
+				for (const auto& vv : v.primitives)
+				{
+					EGLTF::SGLTFSnapshot_Primitive primitive;
+					primitive.mode = vv.mode;
+					primitive.indices = vv.indices;
+					primitive.material = vv.material;
+					primitive.attributes = AddAttributes(vv.attributes);
+
+					// targets are added after the attributes so they dont interleave with the primitive's own attribute range
+					primitive.targets.offset = static_cast<uint32_t>(targets.size());
+					primitive.targets.count = static_cast<uint32_t>(vv.targets.size());
+					for (const auto& vvv : vv.targets)
+					{
+						EGLTF::SGLTFSnapshot_Target target;
+						target.attributes = AddAttributes(vvv);
+						targets.push_back(target);
+					}
+
+					primitives.push_back(primitive);
+				}
+
+				meshes.push_back(mesh);
+			}
+
+			for (const auto& v : asset.buffers)
+			{
+				EGLTF::SGLTFSnapshot_Buffer buffer = {};
+				buffer.byteLength = v.byteLength;
+				buffer.data = AddPayload(v.data);
+				buffers.push_back(buffer);
+			}
+
+			for (const auto& v : asset.bufferViews)
+			{
+				EGLTF::SGLTFSnapshot_BufferView bv = {};
+				bv.buffer = v.buffer;
+				bv.byteOffset = v.byteOffset;
+				bv.byteLength = v.byteLength;
+				bv.byteStride = v.byteStride;
+				bv.target = v.target;
+				bufferViews.push_back(bv);
+			}
+
+			accessors.reserve(asset.accessors.size());
+			for (const auto& v : asset.accessors)
+			{
+				EGLTF::SGLTFSnapshot_Accessor accessor;
+				accessor.bufferView = v.bufferView;
+				accessor.byteOffset = v.byteOffset;
+				accessor.componentType = v.componentType;
+				accessor.count = v.count;
+				accessor.type = AddString(v.type);
+				accessor.min = AddDoubles(v.min);
+				accessor.max = AddDoubles(v.max);
+				accessor.sparseCount = v.sparse.count;
+				accessor.sparseValues = v.sparse.values;
+				accessor.sparseIndicesBufferView = v.sparse.indices.first;
+				accessor.sparseIndicesComponentType = v.sparse.indices.second;
+				accessor.normalized = v.normalized ? 1 : 0;
+				accessors.push_back(accessor);
+			}
+
+			for (const auto& v : asset.materials)
+			{
+				EGLTF::SGLTFSnapshot_Material mat;
+				mat.name = AddString(v.name);
+				memcpy(mat.baseColorFactor, v.pbrMetallicRoughness.baseColorFactor.data(), sizeof(mat.baseColorFactor));
+				memcpy(mat.emissiveFactor, v.emissiveFactor.data(), sizeof(mat.emissiveFactor));
+				mat.metallicFactor = v.pbrMetallicRoughness.metallicFactor;
+				mat.roughnessFactor = v.pbrMetallicRoughness.roughnessFactor;
+				mat.baseColorTexture = MakeTexture(v.pbrMetallicRoughness.baseColorTexture.index, v.pbrMetallicRoughness.baseColorTexture.texCoord, 0.0);
+				mat.metallicRoughnessTexture = MakeTexture(v.pbrMetallicRoughness.metallicRoughnessTexture.index, v.pbrMetallicRoughness.metallicRoughnessTexture.texCoord, 0.0);
+				mat.occlusionTexture = MakeTexture(v.occlusionTexture.index, v.occlusionTexture.texCoord, v.occlusionTexture.strength);
+				mat.normalTexture = MakeTexture(v.normalTexture.index, v.normalTexture.texCoord, v.normalTexture.scale);
+				mat.emissiveTexture = MakeTexture(v.emissiveTexture.index, v.emissiveTexture.texCoord, 0.0);
+				materials.push_back(mat);
+			}
+
+			for (const auto& v : asset.textures)
+			{
+				EGLTF::SGLTFSnapshot_Texture tex;
+				tex.source = v.source;
+				tex.sampler = v.sampler;
+				textures.push_back(tex);
+			}
+
+			for (const auto& v : asset.images)
+			{
+				EGLTF::SGLTFSnapshot_Image image = {};
+				image.data = AddPayload(v.data);
+				image.bufferView = v.bufferView;
+				image.mimeType = AddString(v.mimeType);
+				images.push_back(image);
+			}
+
+			for (const auto& v : asset.samplers)
+			{
+				EGLTF::SGLTFSnapshot_Sampler sampler;
+				sampler.magFiler = v.magFiler;
+				sampler.minFiler = v.minFiler;
+				sampler.wrapS = v.wrapS;
+				sampler.wrapT = v.wrapT;
+				samplers.push_back(sampler);
+			}
+
+			for (const auto& v : asset.skins)
+			{
+				EGLTF::SGLTFSnapshot_Skin skin;
+				skin.inverseBindMatrices = v.inverseBindMatrices;
+				skin.skeleton = v.skeleton;
+				skin.joints = AddIndices(v.joints);
+				skin.name = AddString(v.name);
+				skins.push_back(skin);
+			}
+
+			for (const auto& v : asset.animations)
+			{
+				EGLTF::SGLTFSnapshot_Animation anim;
+				anim.name = AddString(v.name);
+				anim.channels.offset = static_cast<uint32_t>(channels.size());
+				anim.channels.count = static_cast<uint32_t>(v.channels.size());
+				anim.samplers.offset = static_cast<uint32_t>(animationSamplers.size());
+				anim.samplers.count = static_cast<uint32_t>(v.samplers.size());
+
+				for (const auto& vv : v.channels)
+				{
+					EGLTF::SGLTFSnapshot_Animation_Channel channel;
+					channel.node = vv.target.node;
+					channel.path = static_cast<int32_t>(vv.target.path);
+					channel.sampler = vv.sampler;
+					channels.push_back(channel);
+				}
+
+				for (const auto& vv : v.samplers)
+				{
+					EGLTF::SGLTFSnapshot_Animation_Sampler sampler;
+					sampler.input = vv.input;
+					sampler.output = vv.output;
+					sampler.interpolation = static_cast<int32_t>(vv.interpolation);
+					animationSamplers.push_back(sampler);
+				}
+
+				animations.push_back(anim);
+			}
+
+			for (const auto& v : asset.cameras)
+			{
+				EGLTF::SGLTFSnapshot_Camera camera = {};
+				camera.type = static_cast<int32_t>(v.type);
+				camera.znear = v.znear;
+				camera.zfar = v.zfar;
+				camera.val0 = v.val0;
+				camera.val1 = v.val1;
+				cameras.push_back(camera);
+			}
+		}
+	};
+
+	// Writes and hashes at the same time so the file never has to be held in memory as a whole
+	class CSnapshotStream
+	{
+	public:
+		explicit CSnapshotStream(std::ofstream& fh) : m_fh(fh) {}
+
+		void Write(const void* data, size_t size)
+		{
+			m_fh.write(static_cast<const char*>(data), size);
+			m_hash = EGLTF::HashGLTFSnapshotData(data, size, m_hash);
+			m_offset += size;
+		}
+
+		void PadTo(uint64_t offset)
+		{
+			static const uint8_t zeros[EGLTF::GLTF_SNAPSHOT_ALIGNMENT] = {};
+			while (m_offset < offset)
+				Write(zeros, static_cast<size_t>(std::min<uint64_t>(offset - m_offset, sizeof(zeros))));
+		}
+
+		uint64_t GetOffset() const { return m_offset; }
+		uint64_t GetHash() const { return m_hash; }
+
+	private:
+		std::ofstream& m_fh;
+		uint64_t m_offset = sizeof(EGLTF::SGLTFSnapshot_Header);
+		uint64_t m_hash = 0xCBF29CE484222325ULL;
+	};
+}
+
+template<typename T>
+static void LayoutTable(EGLTF::SGLTFSnapshot_Header& header, EGLTF::EGLTFSnapshot_Table table, const std::vector<T>& data, uint64_t& offset)
+{
+	offset = AlignUp(offset, EGLTF::GLTF_SNAPSHOT_ALIGNMENT);
+	header.tables[table].offset = offset;
+	header.tables[table].size = data.size();
+	offset += data.size() * sizeof(T);
+}
+
+template<typename T>
+static void WriteTable(CSnapshotStream& stream, const EGLTF::SGLTFSnapshot_Header& header, EGLTF::EGLTFSnapshot_Table table, const std::vector<T>& data)
+{
+	stream.PadTo(header.tables[table].offset);
+	if (!data.empty())
+		stream.Write(data.data(), data.size() * sizeof(T));
+}
+
+bool EGLTF::WriteGLTFSnapshot(const SGLTFAsset& asset, const std::string& filepath, uint64_t sourceHash)
+{
+	SSnapshotBuilder builder;
+
+	SGLTFSnapshot_Header header = {};
+	header.magic = GLTF_SNAPSHOT_MAGIC;
+	header.version = GLTF_SNAPSHOT_VERSION;
+	header.sourceHash = sourceHash;
+	header.assetVersion = builder.AddString(asset.asset.version);
+	header.assetGenerator = builder.AddString(asset.asset.generator);
+	header.assetMinVersion = builder.AddString(asset.asset.minVersion);
+	header.assetCopyright = builder.AddString(asset.asset.copyright);
+	header.scene = builder.AddString(asset.scene);
+
+	builder.Build(asset);
+
+	uint64_t offset = sizeof(SGLTFSnapshot_Header);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_SCENES, builder.scenes, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_NODES, builder.nodes, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_MESHES, builder.meshes, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_PRIMITIVES, builder.primitives, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_ATTRIBUTES, builder.attributes, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_TARGETS, builder.targets, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_BUFFERS, builder.buffers, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_BUFFERVIEWS, builder.bufferViews, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_ACCESSORS, builder.accessors, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_MATERIALS, builder.materials, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_TEXTURES, builder.textures, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_IMAGES, builder.images, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_SAMPLERS, builder.samplers, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_SKINS, builder.skins, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_ANIMATIONS, builder.animations, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_CHANNELS, builder.channels, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_ANIMATION_SAMPLERS, builder.animationSamplers, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_CAMERAS, builder.cameras, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_INDICES, builder.indices, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_DOUBLES, builder.doubles, offset);
+	LayoutTable(header, GLTF_SNAPSHOT_TABLE_STRINGS, builder.strings, offset);
+
+	// Now that the tables are placed, the payload offsets can be made absolute
+	const uint64_t payloadBase = AlignUp(offset, GLTF_SNAPSHOT_ALIGNMENT);
+	for (auto& v : builder.buffers)
+		if (v.data.size > 0)
+			v.data.offset += payloadBase;
+	for (auto& v : builder.images)
+		if (v.data.size > 0)
+			v.data.offset += payloadBase;
+
+	header.fileSize = payloadBase + builder.payloadSize;
+
+	std::ofstream fh(filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fh.is_open())
+	{
+		fprintf(stderr, "\nError: could not open %s for writing\n", filepath.c_str());
+		return false;
+	}
+
+	// placeholder, the real one goes in once the content hash is known
+	fh.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	CSnapshotStream stream(fh);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_SCENES, builder.scenes);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_NODES, builder.nodes);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_MESHES, builder.meshes);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_PRIMITIVES, builder.primitives);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_ATTRIBUTES, builder.attributes);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_TARGETS, builder.targets);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_BUFFERS, builder.buffers);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_BUFFERVIEWS, builder.bufferViews);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_ACCESSORS, builder.accessors);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_MATERIALS, builder.materials);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_TEXTURES, builder.textures);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_IMAGES, builder.images);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_SAMPLERS, builder.samplers);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_SKINS, builder.skins);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_ANIMATIONS, builder.animations);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_CHANNELS, builder.channels);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_ANIMATION_SAMPLERS, builder.animationSamplers);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_CAMERAS, builder.cameras);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_INDICES, builder.indices);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_DOUBLES, builder.doubles);
+	WriteTable(stream, header, GLTF_SNAPSHOT_TABLE_STRINGS, builder.strings);
+
+	stream.PadTo(payloadBase);
+	for (const auto* payload : builder.payloads)
+	{
+		stream.PadTo(AlignUp(stream.GetOffset(), GLTF_SNAPSHOT_ALIGNMENT));
+		stream.Write(payload->data(), payload->size());
+	}
+
+	header.contentHash = stream.GetHash();
+
+	fh.seekp(0, std::ios::beg);
+	fh.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fh.close();
+
+	return !fh.fail();
+}
+
+EGLTF::CGLTFSnapshot::CGLTFSnapshot() {}
+
+EGLTF::CGLTFSnapshot::~CGLTFSnapshot()
+{
+	Close();
+}
+
+bool EGLTF::CGLTFSnapshot::Open(const std::string& filepath, uint64_t expectedSourceHash, bool verifyContent)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG) sizeof(SGLTFSnapshot_Header))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	m_file = file;
+	m_mapping = mapping;
+	m_size = static_cast<uint64_t>(size.QuadPart);
+
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+#else
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(SGLTFSnapshot_Header))
+	{
+		close(fd);
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file alive
+
+	if (mapped == MAP_FAILED)
+		return false;
+
+	m_data = static_cast<const uint8_t*>(mapped);
+	m_size = static_cast<uint64_t>(st.st_size);
+#endif
+
+	const SGLTFSnapshot_Header& header = GetHeader();
+
+	if (header.magic != GLTF_SNAPSHOT_MAGIC || header.version != GLTF_SNAPSHOT_VERSION || header.fileSize != m_size)
+	{
+		fprintf(stderr, "\nError: %s is not a compatible snapshot (version %u, expected %u)\n", filepath.c_str(), header.version, GLTF_SNAPSHOT_VERSION);
+		Close();
+		return false;
+	}
+
+	if (expectedSourceHash != 0 && header.sourceHash != expectedSourceHash)
+	{
+		fprintf(stderr, "\nError: %s is stale, the source asset changed since it was baked\n", filepath.c_str());
+		Close();
+		return false;
+	}
+
+	// Table bounds are cheap to check, the per element ranges are trusted since the writer produced them
+	static const size_t tableElementSizes[GLTF_SNAPSHOT_TABLE_COUNT] = {
+		sizeof(SGLTFSnapshot_Scene), sizeof(SGLTFSnapshot_Node), sizeof(SGLTFSnapshot_Mesh), sizeof(SGLTFSnapshot_Primitive),
+		sizeof(SGLTFSnapshot_Attribute), sizeof(SGLTFSnapshot_Target), sizeof(SGLTFSnapshot_Buffer), sizeof(SGLTFSnapshot_BufferView),
+		sizeof(SGLTFSnapshot_Accessor), sizeof(SGLTFSnapshot_Material), sizeof(SGLTFSnapshot_Texture), sizeof(SGLTFSnapshot_Image),
+		sizeof(SGLTFSnapshot_Sampler), sizeof(SGLTFSnapshot_Skin), sizeof(SGLTFSnapshot_Animation), sizeof(SGLTFSnapshot_Animation_Channel),
+		sizeof(SGLTFSnapshot_Animation_Sampler), sizeof(SGLTFSnapshot_Camera), sizeof(int32_t), sizeof(double), sizeof(char)
+	};
+
+	for (size_t i = 0; i < GLTF_SNAPSHOT_TABLE_COUNT; ++i)
+	{
+		const SGLTFSnapshot_Blob& table = header.tables[i];
+		if (table.offset > m_size || table.size > (m_size - table.offset) / tableElementSizes[i])
+		{
+			fprintf(stderr, "\nError: %s is truncated or corrupt\n", filepath.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	if (verifyContent)
+	{
+		uint64_t hash = HashGLTFSnapshotData(m_data + sizeof(SGLTFSnapshot_Header), static_cast<size_t>(m_size - sizeof(SGLTFSnapshot_Header)));
+		if (hash != header.contentHash)
+		{
+			fprintf(stderr, "\nError: %s failed the content hash check\n", filepath.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void EGLTF::CGLTFSnapshot::Close()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_data)
+		munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_size));
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+int32_t EGLTF::CGLTFSnapshot::FindAttribute(const SGLTFSnapshot_Primitive& primitive, const char* name) const
+{
+	const SGLTFSnapshot_Attribute* attributes = GetAttributes(primitive.attributes);
+	for (uint32_t i = 0; i < primitive.attributes.count; ++i)
+	{
+		if (strcmp(GetString(attributes[i].name), name) == 0)
+			return attributes[i].accessor;
+	}
+	return -1;
+}
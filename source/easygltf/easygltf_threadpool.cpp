@@ -0,0 +1,205 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+
+// Which pool and queue the current thread works for, so Submit from inside a task stays local
+struct SWorkerIdentity
+{
+	const EGLTF::CGLTFThreadPool* pool;
+	uint32_t index;
+};
+
+static thread_local SWorkerIdentity t_worker = { nullptr, 0 };
+
+EGLTF::CGLTFThreadPool::CGLTFThreadPool(uint32_t threadCount)
+	: m_pending(0), m_stop(false)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+		m_queues.emplace_back(new SWorkerQueue());
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+		m_workers.emplace_back(&CGLTFThreadPool::WorkerLoop, this, i);
+}
+
+EGLTF::CGLTFThreadPool::~CGLTFThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_sleepCondition.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+void EGLTF::CGLTFThreadPool::Submit(TTask task)
+{
+	SWorkerQueue& queue = t_worker.pool == this ? *m_queues[t_worker.index] : m_shared;
+
+	// counted before its visible so m_pending never drops below the number of queued tasks
+	m_pending.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	{
+		// taking the lock makes sure a worker about to sleep sees the new task
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_sleepCondition.notify_one();
+}
+
+bool EGLTF::CGLTFThreadPool::TryPop(TTask& task)
+{
+	const uint32_t count = static_cast<uint32_t>(m_queues.size());
+	const bool isWorker = t_worker.pool == this;
+	const uint32_t self = isWorker ? t_worker.index : 0;
+
+	// own queue first, newest task since its the most likely to still be in cache
+	if (isWorker)
+	{
+		SWorkerQueue& queue = *m_queues[self];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+			return true;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_shared.mutex);
+		if (!m_shared.tasks.empty())
+		{
+			task = std::move(m_shared.tasks.front());
+			m_shared.tasks.pop_front();
+			return true;
+		}
+	}
+
+	// steal the oldest task from someone else
+	for (uint32_t i = 1; i <= count; ++i)
+	{
+		SWorkerQueue& queue = *m_queues[(self + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool EGLTF::CGLTFThreadPool::RunPendingTask()
+{
+	TTask task;
+	if (!TryPop(task))
+		return false;
+
+	m_pending.fetch_sub(1);
+	task();
+	return true;
+}
+
+void EGLTF::CGLTFThreadPool::WorkerLoop(uint32_t index)
+{
+	t_worker.pool = this;
+	t_worker.index = index;
+
+	for (;;)
+	{
+		if (RunPendingTask())
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleepCondition.wait(lock, [this]() { return m_stop || m_pending.load() > 0; });
+
+		if (m_stop && m_pending.load() == 0)
+			return;
+	}
+}
+
+void EGLTF::CGLTFThreadPool::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& func)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+	const size_t chunks = (count + grain - 1) / grain;
+
+	if (chunks == 1)
+	{
+		func(0, count);
+		return;
+	}
+
+	// Chunks are claimed from a counter instead of being queued one by one, the caller keeps claiming until none are left and
+	// then only waits for the ones in flight. It never picks up unrelated tasks while waiting, which would pile whole asset loads
+	// on top of each other on its stack when loads are nested in a batch.
+	// Helpers that run after everything got claimed return straight away, so the state has to outlive this call.
+	struct SState
+	{
+		const std::function<void(size_t begin, size_t end)>* func;
+		size_t count;
+		size_t grain;
+		size_t chunks;
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+	};
+
+	std::shared_ptr<SState> state = std::make_shared<SState>();
+	state->func = &func;
+	state->count = count;
+	state->grain = grain;
+	state->chunks = chunks;
+	state->next = 0;
+	state->done = 0;
+
+	auto work = [](SState& s)
+	{
+		for (;;)
+		{
+			const size_t chunk = s.next.fetch_add(1);
+			if (chunk >= s.chunks)
+				return;
+
+			const size_t begin = chunk * s.grain;
+			(*s.func)(begin, std::min(s.count, begin + s.grain));
+			s.done.fetch_add(1);
+		}
+	};
+
+	const size_t helpers = std::min<size_t>(chunks - 1, m_workers.size());
+	for (size_t i = 0; i < helpers; ++i)
+		Submit([state, work]() { work(*state); });
+
+	work(*state);
+
+	while (state->done.load() < chunks)
+		std::this_thread::yield();
+}
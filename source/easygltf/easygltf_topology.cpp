@@ -0,0 +1,632 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#include "easygltf_topology.h"
+#include "easygltf_compact.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Swaps the first user that matches with the last one and drops it, order is not kept
+template<typename T, typename F>
+static void RemoveUser(std::vector<std::vector<T>>& users, int32_t element, F match)
+{
+	if (element < 0 || static_cast<size_t>(element) >= users.size())
+		return;
+
+	std::vector<T>& list = users[element];
+	for (size_t i = 0; i < list.size(); ++i)
+	{
+		if (match(list[i]))
+		{
+			list[i] = list.back();
+			list.pop_back();
+			return;
+		}
+	}
+}
+
+template<typename T>
+static void AddUser(std::vector<std::vector<T>>& users, int32_t element, const T& user)
+{
+	if (element >= 0 && static_cast<size_t>(element) < users.size())
+		users[element].push_back(user);
+}
+
+static void AddAccessorUser(std::vector<std::vector<EGLTF::SGLTFAccessorUser>>& users, int32_t accessor, EGLTF::EGLTFAccessorUserType type, int32_t element, int32_t index)
+{
+	const EGLTF::SGLTFAccessorUser user = { type, element, index };
+	AddUser(users, accessor, user);
+}
+
+static void RemoveAccessorUser(std::vector<std::vector<EGLTF::SGLTFAccessorUser>>& users, int32_t accessor, EGLTF::EGLTFAccessorUserType type, int32_t element, int32_t index)
+{
+	RemoveUser(users, accessor, [&](const EGLTF::SGLTFAccessorUser& user) { return user.type == type && user.element == element && user.index == index; });
+}
+
+void EGLTF::CGLTFTopology::Clear()
+{
+	*this = CGLTFTopology();
+}
+
+void EGLTF::CGLTFTopology::Build(const SGLTFAsset& asset, const SGLTFCompactAsset* compact)
+{
+	Clear();
+
+	m_compact = compact && asset.nodes.empty() && !compact->nodes.empty();
+	const size_t nodeCount = m_compact ? compact->nodes.size() : asset.nodes.size();
+
+	m_parents.assign(nodeCount, -1);
+	m_firstChild.assign(nodeCount, -1);
+	m_lastChild.assign(nodeCount, -1);
+	m_nextSibling.assign(nodeCount, -1);
+	m_previousSibling.assign(nodeCount, -1);
+	m_nodeNames.reserve(nodeCount);
+
+	GrowUsers(asset);
+
+	// one pass over the nodes for everything they point at
+	for (size_t i = 0; i < nodeCount; ++i)
+	{
+		const int32_t index = static_cast<int32_t>(i);
+		if (m_compact)
+		{
+			const SGLTFCompact_Node& node = compact->nodes[i];
+			for (uint32_t c = 0; c < node.children.count; ++c)
+				Link(index, compact->children[node.children.offset + c]);
+
+			AddNodeUsers(index, node.mesh, node.skin, nullptr);
+			AddName(m_nodeNames, GetGLTFCompactNodeName(*compact, node), index);
+		}
+		else
+		{
+			const SGLTFAsset_Prop_Node& node = asset.nodes[i];
+			for (int32_t child : node.children)
+				Link(index, child);
+
+			AddNodeUsers(index, node.mesh, node.skin, &node.instancing);
+			AddName(m_nodeNames, node.name, index);
+		}
+	}
+
+	if (m_compact)
+		for (const SGLTFCompact_Instancing& instancing : compact->instancing)
+			AddNodeUsers(instancing.node, -1, -1, &instancing.attributes);
+
+	AddElements(asset);
+}
+
+bool EGLTF::CGLTFTopology::Sync(const SGLTFAsset& asset)
+{
+	if ((!m_compact && asset.nodes.size() < m_parents.size()) || asset.meshes.size() < m_meshCount || asset.materials.size() < m_materialCount ||
+		asset.skins.size() < m_skinCount || asset.animations.size() < m_animationCount || asset.accessors.size() < m_accessorUsers.size())
+	{
+		fprintf(stderr, "\nError: elements were removed from the asset, the topology has to be built again\n");
+		return false;
+	}
+
+	GrowUsers(asset);
+
+	const size_t begin = m_parents.size();
+	if (!m_compact && asset.nodes.size() > begin)
+	{
+		const size_t nodeCount = asset.nodes.size();
+		m_parents.resize(nodeCount, -1);
+		m_firstChild.resize(nodeCount, -1);
+		m_lastChild.resize(nodeCount, -1);
+		m_nextSibling.resize(nodeCount, -1);
+		m_previousSibling.resize(nodeCount, -1);
+
+		for (size_t i = begin; i < nodeCount; ++i)
+		{
+			const int32_t index = static_cast<int32_t>(i);
+			const SGLTFAsset_Prop_Node& node = asset.nodes[i];
+			for (int32_t child : node.children)
+				Link(index, child);
+
+			AddNodeUsers(index, node.mesh, node.skin, &node.instancing);
+			AddName(m_nodeNames, node.name, index);
+		}
+
+		m_orderStale = true;
+	}
+
+	AddElements(asset);
+	return true;
+}
+
+// Lists for elements that are new to the index, before anything can point at them
+void EGLTF::CGLTFTopology::GrowUsers(const SGLTFAsset& asset)
+{
+	m_meshUsers.resize(asset.meshes.size());
+	m_skinUsers.resize(asset.skins.size());
+	m_materialUsers.resize(asset.materials.size());
+	m_accessorUsers.resize(asset.accessors.size());
+}
+
+// Everything but the nodes from where the last Build or Sync stopped
+void EGLTF::CGLTFTopology::AddElements(const SGLTFAsset& asset)
+{
+	for (size_t m = m_meshCount; m < asset.meshes.size(); ++m)
+	{
+		const SGLTFAsset_Prop_Mesh& mesh = asset.meshes[m];
+		AddName(m_meshNames, mesh.name, static_cast<int32_t>(m));
+		for (size_t p = 0; p < mesh.primitives.size(); ++p)
+			AddPrimitiveUsers(mesh.primitives[p], static_cast<int32_t>(m), static_cast<int32_t>(p));
+	}
+	m_meshCount = asset.meshes.size();
+
+	for (size_t m = m_materialCount; m < asset.materials.size(); ++m)
+		AddName(m_materialNames, asset.materials[m].name, static_cast<int32_t>(m));
+	m_materialCount = asset.materials.size();
+
+	for (size_t s = m_skinCount; s < asset.skins.size(); ++s)
+		AddAccessorUser(m_accessorUsers, asset.skins[s].inverseBindMatrices, EGLTFAccessorUserType::INVERSE_BIND_MATRICES, static_cast<int32_t>(s), -1);
+	m_skinCount = asset.skins.size();
+
+	for (size_t a = m_animationCount; a < asset.animations.size(); ++a)
+	{
+		const std::vector<SGLTFAsset_Prop_Animation_Sampler>& samplers = asset.animations[a].samplers;
+		for (size_t s = 0; s < samplers.size(); ++s)
+		{
+			AddAccessorUser(m_accessorUsers, samplers[s].input, EGLTFAccessorUserType::ANIMATION_INPUT, static_cast<int32_t>(a), static_cast<int32_t>(s));
+			AddAccessorUser(m_accessorUsers, samplers[s].output, EGLTFAccessorUserType::ANIMATION_OUTPUT, static_cast<int32_t>(a), static_cast<int32_t>(s));
+		}
+	}
+	m_animationCount = asset.animations.size();
+}
+
+// Appends child to the children of parent, unless it is not a node or has a parent already
+void EGLTF::CGLTFTopology::Link(int32_t parent, int32_t child)
+{
+	if (child < 0 || static_cast<size_t>(child) >= m_parents.size())
+	{
+		const SGLTFTopologyIssue issue = { EGLTFTopologyIssueType::BAD_CHILD, child, parent };
+		m_issues.push_back(issue);
+		return;
+	}
+
+	if (m_parents[child] != -1)
+	{
+		const SGLTFTopologyIssue issue = { EGLTFTopologyIssueType::MULTIPLE_PARENTS, child, parent };
+		m_issues.push_back(issue);
+		return;
+	}
+
+	m_parents[child] = parent;
+	m_previousSibling[child] = m_lastChild[parent];
+	m_nextSibling[child] = -1;
+	if (m_lastChild[parent] != -1)
+		m_nextSibling[m_lastChild[parent]] = child;
+	else
+		m_firstChild[parent] = child;
+	m_lastChild[parent] = child;
+}
+
+void EGLTF::CGLTFTopology::Unlink(int32_t child)
+{
+	const int32_t parent = m_parents[child];
+	if (parent == -1)
+		return;
+
+	const int32_t previous = m_previousSibling[child];
+	const int32_t next = m_nextSibling[child];
+	if (previous != -1)
+		m_nextSibling[previous] = next;
+	else
+		m_firstChild[parent] = next;
+	if (next != -1)
+		m_previousSibling[next] = previous;
+	else
+		m_lastChild[parent] = previous;
+
+	m_parents[child] = -1;
+	m_previousSibling[child] = -1;
+	m_nextSibling[child] = -1;
+}
+
+void EGLTF::CGLTFTopology::AddNodeUsers(int32_t node, int32_t mesh, int32_t skin, const std::map<std::string, int32_t>* instancing)
+{
+	AddUser(m_meshUsers, mesh, node);
+	AddUser(m_skinUsers, skin, node);
+
+	if (instancing)
+		for (const auto& attribute : *instancing)
+			AddAccessorUser(m_accessorUsers, attribute.second, EGLTFAccessorUserType::INSTANCING, node, -1);
+}
+
+void EGLTF::CGLTFTopology::AddPrimitiveUsers(const SGLTFAsset_Prop_Mesh_Primitive& primitive, int32_t mesh, int32_t index)
+{
+	SGLTFPrimitiveRef ref;
+	ref.mesh = mesh;
+	ref.primitive = index;
+	AddUser(m_materialUsers, primitive.material, ref);
+
+	AddAccessorUser(m_accessorUsers, primitive.indices, EGLTFAccessorUserType::INDICES, mesh, index);
+	for (const auto& attribute : primitive.attributes)
+		AddAccessorUser(m_accessorUsers, attribute.second, EGLTFAccessorUserType::ATTRIBUTE, mesh, index);
+	for (const auto& target : primitive.targets)
+		for (const auto& attribute : target)
+			AddAccessorUser(m_accessorUsers, attribute.second, EGLTFAccessorUserType::TARGET, mesh, index);
+}
+
+int32_t EGLTF::CGLTFTopology::Find(const TNameMap& names, const std::string& name)
+{
+	const auto it = names.find(name);
+	return it != names.end() ? it->second : -1;
+}
+
+void EGLTF::CGLTFTopology::FindAll(const TNameMap& names, const std::string& name, std::vector<int32_t>& out)
+{
+	const auto range = names.equal_range(name);
+	for (auto it = range.first; it != range.second; ++it)
+		out.push_back(it->second);
+}
+
+void EGLTF::CGLTFTopology::AddName(TNameMap& names, const std::string& name, int32_t element)
+{
+	if (!name.empty())
+		names.emplace(name, element);
+}
+
+void EGLTF::CGLTFTopology::RemoveName(TNameMap& names, const std::string& name, int32_t element)
+{
+	const auto range = names.equal_range(name);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->second == element)
+		{
+			names.erase(it);
+			return;
+		}
+	}
+}
+
+void EGLTF::CGLTFTopology::UpdateOrder() const
+{
+	if (!m_orderStale)
+		return;
+
+	const size_t nodeCount = m_parents.size();
+	m_order.clear();
+	m_order.reserve(nodeCount);
+	m_roots.clear();
+	m_subtrees.assign(nodeCount, SGLTFNodeRange());
+	m_depths.assign(nodeCount, -1);
+
+	for (size_t i = 0; i < nodeCount; ++i)
+		if (m_parents[i] == -1)
+			m_roots.push_back(static_cast<int32_t>(i));
+
+	// walks the sibling lists, the parent links lead back up so there is no stack to keep
+	for (int32_t root : m_roots)
+	{
+		int32_t node = root;
+		int32_t depth = 0;
+		bool done = false;
+		while (!done)
+		{
+			m_subtrees[node].begin = static_cast<uint32_t>(m_order.size());
+			m_depths[node] = depth;
+			m_order.push_back(node);
+
+			if (m_firstChild[node] != -1)
+			{
+				node = m_firstChild[node];
+				++depth;
+				continue;
+			}
+
+			// close subtrees until one has a sibling left
+			for (;;)
+			{
+				m_subtrees[node].end = static_cast<uint32_t>(m_order.size());
+				if (node == root)
+				{
+					done = true;
+					break;
+				}
+
+				if (m_nextSibling[node] != -1)
+				{
+					node = m_nextSibling[node];
+					break;
+				}
+
+				node = m_parents[node];
+				--depth;
+			}
+		}
+	}
+
+	// whatever the walk did not reach has a loop somewhere above it, following the parents from there ends up going around it
+	m_allIssues = m_issues;
+	if (m_order.size() < nodeCount)
+	{
+		std::vector<int32_t> walk(nodeCount, -1);
+		for (size_t i = 0; i < nodeCount; ++i)
+		{
+			if (m_depths[i] != -1 || walk[i] != -1)
+				continue;
+
+			int32_t node = static_cast<int32_t>(i);
+			while (walk[node] == -1)
+			{
+				walk[node] = static_cast<int32_t>(i);
+				node = m_parents[node];
+			}
+
+			// a loop found by an earlier walk otherwise
+			if (walk[node] == static_cast<int32_t>(i))
+			{
+				const SGLTFTopologyIssue issue = { EGLTFTopologyIssueType::CYCLE, node, m_parents[node] };
+				m_allIssues.push_back(issue);
+			}
+		}
+	}
+
+	m_orderStale = false;
+}
+
+const std::vector<int32_t>& EGLTF::CGLTFTopology::GetOrder() const
+{
+	UpdateOrder();
+	return m_order;
+}
+
+const std::vector<int32_t>& EGLTF::CGLTFTopology::GetRoots() const
+{
+	UpdateOrder();
+	return m_roots;
+}
+
+const std::vector<EGLTF::SGLTFTopologyIssue>& EGLTF::CGLTFTopology::GetIssues() const
+{
+	UpdateOrder();
+	return m_allIssues;
+}
+
+EGLTF::SGLTFNodeRange EGLTF::CGLTFTopology::GetSubtree(int32_t node) const
+{
+	UpdateOrder();
+	return node >= 0 && static_cast<size_t>(node) < m_subtrees.size() ? m_subtrees[node] : SGLTFNodeRange();
+}
+
+int32_t EGLTF::CGLTFTopology::GetDepth(int32_t node) const
+{
+	UpdateOrder();
+	return node >= 0 && static_cast<size_t>(node) < m_depths.size() ? m_depths[node] : -1;
+}
+
+bool EGLTF::CGLTFTopology::IsAncestor(int32_t ancestor, int32_t node) const
+{
+	if (GetDepth(ancestor) < 0 || GetDepth(node) < 0)
+		return false;
+
+	const SGLTFNodeRange& range = m_subtrees[ancestor];
+	return m_subtrees[node].begin >= range.begin && m_subtrees[node].begin < range.end;
+}
+
+bool EGLTF::CGLTFTopology::CheckNode(const SGLTFAsset& asset, int32_t node) const
+{
+	if (m_compact)
+	{
+		fprintf(stderr, "\nError: the nodes of a compact asset can't be edited\n");
+		return false;
+	}
+
+	if (node < 0 || static_cast<size_t>(node) >= m_parents.size() || static_cast<size_t>(node) >= asset.nodes.size())
+	{
+		fprintf(stderr, "\nError: node %d does not exist\n", node);
+		return false;
+	}
+
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::CheckPrimitive(const SGLTFAsset& asset, int32_t mesh, int32_t primitive) const
+{
+	if (mesh < 0 || static_cast<size_t>(mesh) >= m_meshCount || static_cast<size_t>(mesh) >= asset.meshes.size() ||
+		primitive < 0 || static_cast<size_t>(primitive) >= asset.meshes[mesh].primitives.size())
+	{
+		fprintf(stderr, "\nError: primitive %d of mesh %d does not exist\n", primitive, mesh);
+		return false;
+	}
+
+	return true;
+}
+
+// Whether index is one of count elements, or -1 where that means none
+static bool CheckReference(int32_t index, size_t count, const char* what, bool optional = true)
+{
+	if (index < (optional ? -1 : 0) || (index >= 0 && static_cast<size_t>(index) >= count))
+	{
+		fprintf(stderr, "\nError: %s %d does not exist\n", what, index);
+		return false;
+	}
+
+	return true;
+}
+
+int32_t EGLTF::CGLTFTopology::AddNode(SGLTFAsset& asset, const std::string& name)
+{
+	if (m_compact)
+	{
+		fprintf(stderr, "\nError: the nodes of a compact asset can't be edited\n");
+		return -1;
+	}
+
+	// picks up whatever else was appended as well
+	SGLTFAsset_Prop_Node node;
+	node.matrix = {{ 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0 }};
+	node.name = name;
+	asset.nodes.push_back(node);
+	if (!Sync(asset))
+	{
+		asset.nodes.pop_back();
+		return -1;
+	}
+
+	return static_cast<int32_t>(asset.nodes.size() - 1);
+}
+
+bool EGLTF::CGLTFTopology::SetParent(SGLTFAsset& asset, int32_t node, int32_t parent)
+{
+	if (!CheckNode(asset, node) || (parent != -1 && !CheckNode(asset, parent)))
+		return false;
+
+	// up from the new parent, a loop that is there already would go on forever
+	size_t steps = 0;
+	for (int32_t n = parent; n != -1; n = m_parents[n])
+	{
+		if (n == node || ++steps > m_parents.size())
+		{
+			fprintf(stderr, "\nError: node %d can't be a child of node %d, that would make a cycle\n", node, parent);
+			return false;
+		}
+	}
+
+	const int32_t previous = m_parents[node];
+	if (previous == parent)
+		return true;
+
+	if (previous != -1)
+	{
+		std::vector<int32_t>& children = asset.nodes[previous].children;
+		const auto it = std::find(children.begin(), children.end(), node);
+		if (it != children.end())
+			children.erase(it);
+		Unlink(node);
+	}
+
+	if (parent != -1)
+	{
+		asset.nodes[parent].children.push_back(node);
+		Link(parent, node);
+	}
+
+	m_orderStale = true;
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetNodeMesh(SGLTFAsset& asset, int32_t node, int32_t mesh)
+{
+	if (!CheckNode(asset, node) || !CheckReference(mesh, m_meshUsers.size(), "mesh"))
+		return false;
+
+	int32_t& current = asset.nodes[node].mesh;
+	RemoveUser(m_meshUsers, current, [&](int32_t user) { return user == node; });
+	current = mesh;
+	AddUser(m_meshUsers, mesh, node);
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetNodeSkin(SGLTFAsset& asset, int32_t node, int32_t skin)
+{
+	if (!CheckNode(asset, node) || !CheckReference(skin, m_skinUsers.size(), "skin"))
+		return false;
+
+	int32_t& current = asset.nodes[node].skin;
+	RemoveUser(m_skinUsers, current, [&](int32_t user) { return user == node; });
+	current = skin;
+	AddUser(m_skinUsers, skin, node);
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetNodeName(SGLTFAsset& asset, int32_t node, const std::string& name)
+{
+	if (!CheckNode(asset, node))
+		return false;
+
+	RemoveName(m_nodeNames, asset.nodes[node].name, node);
+	asset.nodes[node].name = name;
+	AddName(m_nodeNames, name, node);
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetMeshName(SGLTFAsset& asset, int32_t mesh, const std::string& name)
+{
+	if (!CheckReference(mesh, std::min(m_meshCount, asset.meshes.size()), "mesh", false))
+		return false;
+
+	RemoveName(m_meshNames, asset.meshes[mesh].name, mesh);
+	asset.meshes[mesh].name = name;
+	AddName(m_meshNames, name, mesh);
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetMaterialName(SGLTFAsset& asset, int32_t material, const std::string& name)
+{
+	if (!CheckReference(material, std::min(m_materialCount, asset.materials.size()), "material", false))
+		return false;
+
+	RemoveName(m_materialNames, asset.materials[material].name, material);
+	asset.materials[material].name = name;
+	AddName(m_materialNames, name, material);
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetPrimitiveMaterial(SGLTFAsset& asset, int32_t mesh, int32_t primitive, int32_t material)
+{
+	if (!CheckPrimitive(asset, mesh, primitive) || !CheckReference(material, m_materialUsers.size(), "material"))
+		return false;
+
+	SGLTFAsset_Prop_Mesh_Primitive& prim = asset.meshes[mesh].primitives[primitive];
+	RemoveUser(m_materialUsers, prim.material, [&](const SGLTFPrimitiveRef& ref) { return ref.mesh == mesh && ref.primitive == primitive; });
+	prim.material = material;
+
+	SGLTFPrimitiveRef ref;
+	ref.mesh = mesh;
+	ref.primitive = primitive;
+	AddUser(m_materialUsers, material, ref);
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetPrimitiveIndices(SGLTFAsset& asset, int32_t mesh, int32_t primitive, int32_t accessor)
+{
+	if (!CheckPrimitive(asset, mesh, primitive) || !CheckReference(accessor, m_accessorUsers.size(), "accessor"))
+		return false;
+
+	int32_t& current = asset.meshes[mesh].primitives[primitive].indices;
+	RemoveAccessorUser(m_accessorUsers, current, EGLTFAccessorUserType::INDICES, mesh, primitive);
+	current = accessor;
+	AddAccessorUser(m_accessorUsers, accessor, EGLTFAccessorUserType::INDICES, mesh, primitive);
+	return true;
+}
+
+bool EGLTF::CGLTFTopology::SetPrimitiveAttribute(SGLTFAsset& asset, int32_t mesh, int32_t primitive, const std::string& attribute, int32_t accessor)
+{
+	if (!CheckPrimitive(asset, mesh, primitive) || !CheckReference(accessor, m_accessorUsers.size(), "accessor"))
+		return false;
+
+	TGLTFAsset_Prop_Mesh_Primitive_Attributes& attributes = asset.meshes[mesh].primitives[primitive].attributes;
+	const auto it = attributes.find(attribute);
+	if (it != attributes.end())
+	{
+		RemoveAccessorUser(m_accessorUsers, it->second, EGLTFAccessorUserType::ATTRIBUTE, mesh, primitive);
+		attributes.erase(it);
+	}
+
+	if (accessor != -1)
+	{
+		attributes[attribute] = accessor;
+		AddAccessorUser(m_accessorUsers, accessor, EGLTFAccessorUserType::ATTRIBUTE, mesh, primitive);
+	}
+
+	return true;
+}
@@ -0,0 +1,142 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_trace.h"
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+static const char* CategoryName(EGLTF::EGLTFLoadEventCategory category)
+{
+	switch (category)
+	{
+	case EGLTF::EGLTFLoadEventCategory::SECTION: return "section";
+	case EGLTF::EGLTFLoadEventCategory::FILE: return "file";
+	case EGLTF::EGLTFLoadEventCategory::JSON: return "json";
+	case EGLTF::EGLTFLoadEventCategory::GLB: return "glb";
+	}
+	return "";
+}
+
+void EGLTF::CGLTFChromeTraceExporter::OnEventEnd(const SGLTFLoadEvent& event)
+{
+	SRecord record;
+	record.event = event;
+	record.name = event.name;
+	record.thread = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	record.event.name = nullptr; // the string is owned by the record now
+	m_records.push_back(record);
+}
+
+std::string EGLTF::CGLTFChromeTraceExporter::GetJson() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+	// timestamps are relative to the first event so the numbers stay readable
+	uint64_t origin = ~0ULL;
+	for (const auto& r : m_records)
+		origin = std::min(origin, r.event.beginNs);
+
+	writer.StartObject();
+	writer.Key("displayTimeUnit");
+	writer.String("ms");
+	writer.Key("traceEvents");
+	writer.StartArray();
+	for (const auto& r : m_records)
+	{
+		writer.StartObject();
+		writer.Key("name");
+		writer.String(r.name.c_str(), static_cast<rapidjson::SizeType>(r.name.size()));
+		writer.Key("cat");
+		writer.String(CategoryName(r.event.category));
+		writer.Key("ph");
+		writer.String("X");
+		writer.Key("ts");
+		writer.Double((r.event.beginNs - origin) / 1000.0);
+		writer.Key("dur");
+		writer.Double((r.event.endNs - r.event.beginNs) / 1000.0);
+		writer.Key("pid");
+		writer.Int(1);
+		writer.Key("tid");
+		writer.Uint(r.thread);
+
+		writer.Key("args");
+		writer.StartObject();
+		writer.Key("bytesRead");
+		writer.Uint64(r.event.bytesRead);
+		writer.Key("bytesDecoded");
+		writer.Uint64(r.event.bytesDecoded);
+		writer.Key("allocations");
+		writer.Uint64(r.event.allocations);
+		writer.Key("elements");
+		writer.Uint64(r.event.elements);
+		writer.EndObject();
+
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+bool EGLTF::CGLTFChromeTraceExporter::Write(const std::string& filepath) const
+{
+	std::ofstream fh(filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fh.is_open())
+		return false;
+
+	const std::string json = GetJson();
+	fh.write(json.data(), json.size());
+
+	return fh.good();
+}
+
+void EGLTF::CGLTFChromeTraceExporter::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_records.clear();
+}
+
+void EGLTF::CGLTFProgressPrinter::OnEventEnd(const SGLTFLoadEvent& event)
+{
+	const double ms = (event.endNs - event.beginNs) / 1000000.0;
+
+	switch (event.category)
+	{
+	case EGLTFLoadEventCategory::SECTION:
+		fprintf(m_out, "Parsed %s (%llu elements) in %.3f ms\n", event.name, (unsigned long long) event.elements, ms);
+		break;
+	case EGLTFLoadEventCategory::FILE:
+		fprintf(m_out, "Loaded file: %s (%llu bytes) in %.3f ms\n", event.name, (unsigned long long) event.bytesRead, ms);
+		break;
+	case EGLTFLoadEventCategory::JSON:
+	case EGLTFLoadEventCategory::GLB:
+		fprintf(m_out, "Parsed %s in %.3f ms\n", event.name, ms);
+		break;
+	}
+}
@@ -0,0 +1,884 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+#include "easygltf_validator.h"
+#include "easygltf_threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EGLTF_VALIDATOR_SSE2
+#endif
+
+static const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+static std::string Path(const char* section, size_t index, const char* property = nullptr)
+{
+	std::string path = std::string(section) + "[" + std::to_string(index) + "]";
+	if (property)
+		path += std::string(".") + property;
+	return path;
+}
+
+static void AddIssue(std::vector<EGLTF::SGLTFValidationIssue>& issues, EGLTF::EGLTFValidationSeverity severity, const std::string& path, const std::string& message)
+{
+	EGLTF::SGLTFValidationIssue issue;
+	issue.severity = severity;
+	issue.path = path;
+	issue.message = message;
+	issues.push_back(issue);
+}
+
+static void Error(std::vector<EGLTF::SGLTFValidationIssue>& issues, const std::string& path, const std::string& message)
+{
+	AddIssue(issues, EGLTF::EGLTFValidationSeverity::ERROR, path, message);
+}
+
+static void Warning(std::vector<EGLTF::SGLTFValidationIssue>& issues, const std::string& path, const std::string& message)
+{
+	AddIssue(issues, EGLTF::EGLTFValidationSeverity::WARNING, path, message);
+}
+
+template<typename T>
+static bool InRange(int32_t index, const std::vector<T>& section)
+{
+	return index >= 0 && static_cast<size_t>(index) < section.size();
+}
+
+// An optional reference has to be -1 (not there) or valid
+static void CheckReference(std::vector<EGLTF::SGLTFValidationIssue>& issues, int32_t index, size_t count, const char* target, const std::string& path)
+{
+	if (index != -1 && (index < 0 || static_cast<size_t>(index) >= count))
+		Error(issues, path, "refers to " + std::string(target) + "[" + std::to_string(index) + "] which does not exist");
+}
+
+template<typename T>
+static void CheckReference(std::vector<EGLTF::SGLTFValidationIssue>& issues, int32_t index, const std::vector<T>& section, const char* target, const std::string& path)
+{
+	CheckReference(issues, index, section.size(), target, path);
+}
+
+static uint32_t ComponentSize(int32_t componentType)
+{
+	switch (componentType)
+	{
+	case 5120: case 5121: return 1; // BYTE, UNSIGNED_BYTE
+	case 5122: case 5123: return 2; // SHORT, UNSIGNED_SHORT
+	case 5125: case 5126: return 4; // UNSIGNED_INT, FLOAT
+	default: return 0;
+	}
+}
+
+static uint32_t ComponentCount(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+// Matrix columns of small components start on 4 byte boundaries
+static uint32_t ElementSize(int32_t componentType, const std::string& type)
+{
+	const uint32_t size = ComponentSize(componentType);
+	if (type == "MAT2" && size == 1) return 8;
+	if (type == "MAT3" && size == 1) return 12;
+	if (type == "MAT3" && size == 2) return 24;
+	return size * ComponentCount(type);
+}
+
+static double ReadComponent(const uint8_t* p, int32_t componentType)
+{
+	switch (componentType)
+	{
+	case 5120: { int8_t v; memcpy(&v, p, 1); return v; }
+	case 5121: { uint8_t v; memcpy(&v, p, 1); return v; }
+	case 5122: { int16_t v; memcpy(&v, p, 2); return v; }
+	case 5123: { uint16_t v; memcpy(&v, p, 2); return v; }
+	case 5125: { uint32_t v; memcpy(&v, p, 4); return v; }
+	case 5126: { float v; memcpy(&v, p, 4); return v; }
+	default: return 0.0;
+	}
+}
+
+// Min and max of a tightly packed index buffer, 16 bytes at a time where SSE2 is there
+static void ScanIndices(const uint8_t* data, size_t count, int32_t componentType, uint32_t& outMin, uint32_t& outMax)
+{
+	uint32_t lo = UINT32_MAX;
+	uint32_t hi = 0;
+	size_t i = 0;
+
+#ifdef EGLTF_VALIDATOR_SSE2
+	if (componentType == 5121 && count >= 16)
+	{
+		__m128i vmin = _mm_set1_epi8(static_cast<char>(0xFF));
+		__m128i vmax = _mm_setzero_si128();
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			vmin = _mm_min_epu8(vmin, v);
+			vmax = _mm_max_epu8(vmax, v);
+		}
+
+		uint8_t mins[16], maxs[16];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mins), vmin);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), vmax);
+		for (int k = 0; k < 16; ++k)
+		{
+			lo = std::min<uint32_t>(lo, mins[k]);
+			hi = std::max<uint32_t>(hi, maxs[k]);
+		}
+	}
+	else if (componentType == 5123 && count >= 8)
+	{
+		// SSE2 only has signed 16 bit min/max, flipping the sign bit maps unsigned order onto signed order
+		const __m128i flip = _mm_set1_epi16(static_cast<short>(0x8000));
+		__m128i vmin = _mm_set1_epi16(0x7FFF);
+		__m128i vmax = _mm_set1_epi16(static_cast<short>(0x8000));
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2)), flip);
+			vmin = _mm_min_epi16(vmin, v);
+			vmax = _mm_max_epi16(vmax, v);
+		}
+
+		uint16_t mins[8], maxs[8];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mins), _mm_xor_si128(vmin, flip));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), _mm_xor_si128(vmax, flip));
+		for (int k = 0; k < 8; ++k)
+		{
+			lo = std::min<uint32_t>(lo, mins[k]);
+			hi = std::max<uint32_t>(hi, maxs[k]);
+		}
+	}
+	else if (componentType == 5125 && count >= 4)
+	{
+		// no 32 bit min/max before SSE4.1, compare with the sign flipped and blend by hand
+		const __m128i flip = _mm_set1_epi32(static_cast<int>(0x80000000));
+		__m128i vmin = _mm_set1_epi32(0x7FFFFFFF);
+		__m128i vmax = _mm_set1_epi32(static_cast<int>(0x80000000));
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 4)), flip);
+
+			const __m128i less = _mm_cmplt_epi32(v, vmin);
+			vmin = _mm_or_si128(_mm_and_si128(less, v), _mm_andnot_si128(less, vmin));
+
+			const __m128i greater = _mm_cmpgt_epi32(v, vmax);
+			vmax = _mm_or_si128(_mm_and_si128(greater, v), _mm_andnot_si128(greater, vmax));
+		}
+
+		uint32_t mins[4], maxs[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mins), _mm_xor_si128(vmin, flip));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(maxs), _mm_xor_si128(vmax, flip));
+		for (int k = 0; k < 4; ++k)
+		{
+			lo = std::min(lo, mins[k]);
+			hi = std::max(hi, maxs[k]);
+		}
+	}
+#endif
+
+	const uint32_t size = ComponentSize(componentType);
+	for (; i < count; ++i)
+	{
+		const uint32_t v = static_cast<uint32_t>(ReadComponent(data + i * size, componentType));
+		lo = std::min(lo, v);
+		hi = std::max(hi, v);
+	}
+
+	outMin = lo;
+	outMax = hi;
+}
+
+bool EGLTF::SGLTFValidationReport::HasErrors() const
+{
+	for (const auto& issue : issues)
+		if (issue.severity == EGLTFValidationSeverity::ERROR)
+			return true;
+	return false;
+}
+
+void EGLTF::SGLTFValidationReport::Print(FILE* out) const
+{
+	for (const auto& issue : issues)
+		fprintf(out, "\n%s: %s %s", issue.severity == EGLTFValidationSeverity::ERROR ? "Error" : "Warning", issue.path.c_str(), issue.message.c_str());
+	if (!issues.empty())
+		fprintf(out, "\n");
+}
+
+bool EGLTF::ValidateGLB(const std::vector<uint8_t>& buffer, SGLTFValidationReport& report)
+{
+	return ValidateGLB(buffer.data(), buffer.size(), report);
+}
+
+bool EGLTF::ValidateGLB(const uint8_t* data, size_t size, SGLTFValidationReport& report)
+{
+	std::vector<SGLTFValidationIssue>& issues = report.issues;
+	const size_t before = issues.size();
+
+	if (size < 12)
+	{
+		Error(issues, "glb", "is " + std::to_string(size) + " bytes, too small for the header");
+		return false;
+	}
+
+	uint32_t header[3];
+	memcpy(header, data, sizeof(header));
+
+	if (header[0] != GLB_MAGIC)
+		Error(issues, "glb.magic", "is not glTF");
+	if (header[1] != 2)
+		Error(issues, "glb.version", "is " + std::to_string(header[1]) + ", only 2 is supported");
+	if (header[2] != size)
+		Error(issues, "glb.length", "says " + std::to_string(header[2]) + " bytes but there are " + std::to_string(size));
+
+	const size_t end = std::min<size_t>(header[2], size);
+	size_t offset = 12;
+	size_t index = 0;
+	bool hasJson = false;
+	bool hasBin = false;
+
+	while (offset < end)
+	{
+		const std::string path = Path("glb.chunks", index);
+
+		if (end - offset < 8)
+		{
+			Error(issues, path, "has " + std::to_string(end - offset) + " bytes left, not enough for a chunk header");
+			break;
+		}
+
+		uint32_t chunk[2];
+		memcpy(chunk, data + offset, sizeof(chunk));
+
+		if (chunk[0] > end - offset - 8)
+		{
+			Error(issues, path + ".chunkLength", "is " + std::to_string(chunk[0]) + ", past the end of the file");
+			break;
+		}
+		if (chunk[0] % 4 != 0)
+			Error(issues, path + ".chunkLength", "is " + std::to_string(chunk[0]) + ", chunks have to be padded to 4 bytes");
+
+		if (chunk[1] == GLB_CHUNK_JSON)
+		{
+			if (index != 0)
+				Error(issues, path, "is a json chunk, there can only be one and it has to come first");
+			hasJson = true;
+		}
+		else if (chunk[1] == GLB_CHUNK_BIN)
+		{
+			if (index != 1)
+				Error(issues, path, "is a binary chunk, there can only be one and it has to come right after the json");
+			hasBin = true;
+		}
+		else if (index < 2 && !(index == 1 && !hasBin))
+			Warning(issues, path, "has an unknown type, it is skipped");
+
+		offset += 8 + chunk[0];
+		++index;
+	}
+
+	if (!hasJson)
+		Error(issues, "glb", "has no json chunk");
+
+	for (size_t i = before; i < issues.size(); ++i)
+		if (issues[i].severity == EGLTFValidationSeverity::ERROR)
+			return false;
+	return true;
+}
+
+namespace
+{
+	// Where an accessor's data sits, worked out by the structural checks so the data checks don't have to redo them
+	struct SAccessorData
+	{
+		const uint8_t* data = nullptr; // nullptr when it can't or shouldn't be read
+		uint64_t stride = 0;
+		bool zeros = false; // no bufferView, all zeros until the sparse values go in
+		const uint8_t* sparseIndices = nullptr; // both set when the accessor is sparse and they can be read
+		const uint8_t* sparseValues = nullptr;
+		uint32_t indexLimit = UINT32_MAX; // smallest vertex count of the primitives using it as indices
+		bool isIndices = false;
+		std::vector<double> min, max; // the accessor's, or what the compact asset has for it
+		bool floatBounds = false; // compact ones, integers past 2^24 are rounded in them
+	};
+}
+
+static void CopyBounds(const std::vector<float>& bounds, const EGLTF::SGLTFCompact_Range& range, std::vector<double>& out)
+{
+	if (static_cast<size_t>(range.offset) + range.count <= bounds.size())
+		out.assign(bounds.begin() + range.offset, bounds.begin() + range.offset + range.count);
+}
+
+// What the data's value looks like as a declared bound
+static double Bound(const SAccessorData& layout, double value)
+{
+	return layout.floatBounds ? static_cast<float>(value) : value;
+}
+
+// References, index type and byte ranges of the sparse part of an accessor, and where its data is if it can be read.
+// Sparse byteOffsets are not kept by the parser, the readers take both from the start of their views and so does this.
+static void CheckSparse(const EGLTF::SGLTFAsset& asset, const EGLTF::SGLTFAsset_Prop_Accessor& accessor, size_t index, const std::vector<uint8_t>& resident,
+	SAccessorData& layout, std::vector<EGLTF::SGLTFValidationIssue>& issues)
+{
+	const EGLTF::SGLTFAsset_Prop_Accessor_Sparse& sparse = accessor.sparse;
+	const std::string path = Path("accessors", index, "sparse");
+
+	bool usable = true;
+	if (sparse.count < 1)
+	{
+		Error(issues, path + ".count", "is " + std::to_string(sparse.count));
+		usable = false;
+	}
+	else if (sparse.count > accessor.count)
+	{
+		Error(issues, path + ".count", "is larger than the accessor count");
+		usable = false;
+	}
+
+	const int32_t indexType = sparse.indices.second;
+	if (indexType != 5121 && indexType != 5123 && indexType != 5125)
+	{
+		Error(issues, path + ".indices.componentType", "is " + std::to_string(indexType) + ", has to be UNSIGNED_BYTE, UNSIGNED_SHORT or UNSIGNED_INT");
+		usable = false;
+	}
+
+	if (!InRange(sparse.values, asset.bufferViews))
+	{
+		Error(issues, path + ".values.bufferView", "refers to bufferViews[" + std::to_string(sparse.values) + "] which does not exist");
+		usable = false;
+	}
+	if (!InRange(sparse.indices.first, asset.bufferViews))
+	{
+		Error(issues, path + ".indices.bufferView", "refers to bufferViews[" + std::to_string(sparse.indices.first) + "] which does not exist");
+		usable = false;
+	}
+
+	const uint64_t elementSize = ElementSize(accessor.componentType, accessor.type);
+	if (!usable || elementSize == 0)
+		return;
+
+	auto locate = [&](int32_t viewIndex, uint64_t needed, const char* what) -> const uint8_t*
+	{
+		const EGLTF::SGLTFAsset_Prop_BufferView& view = asset.bufferViews[viewIndex];
+		if (needed > static_cast<uint64_t>(std::max<int64_t>(view.byteLength, 0)))
+		{
+			Error(issues, path + "." + what, "needs " + std::to_string(needed) + " bytes of a bufferView that is " + std::to_string(view.byteLength) + " bytes long");
+			return nullptr;
+		}
+
+		const uint64_t viewOffset = static_cast<uint64_t>(std::max<int64_t>(view.byteOffset, 0));
+		if (!InRange(view.buffer, asset.buffers) || !resident[view.buffer] || viewOffset + needed > asset.buffers[view.buffer].data.size())
+			return nullptr;
+		return asset.buffers[view.buffer].data.data() + viewOffset;
+	};
+
+	const uint64_t count = static_cast<uint64_t>(sparse.count);
+	const uint8_t* indices = locate(sparse.indices.first, count * ComponentSize(indexType), "indices");
+	const uint8_t* values = locate(sparse.values, count * elementSize, "values");
+	if (indices && values)
+	{
+		layout.sparseIndices = indices;
+		layout.sparseValues = values;
+	}
+}
+
+static void CheckAccessorData(const EGLTF::SGLTFAsset_Prop_Accessor& accessor, const SAccessorData& layout, size_t index, std::vector<EGLTF::SGLTFValidationIssue>& issues)
+{
+	// a sparse accessor is only checked with its sparse part, the data alone is not what it hands out
+	const bool sparse = accessor.sparse.count != -1;
+	if ((!layout.data && !layout.zeros) || accessor.count <= 0 || (sparse && !layout.sparseIndices))
+		return;
+
+	const uint32_t components = ComponentCount(accessor.type);
+	const uint32_t componentSize = ComponentSize(accessor.componentType);
+
+	// the values go in at these, in order and inside the accessor
+	const size_t sparseCount = sparse ? static_cast<size_t>(accessor.sparse.count) : 0;
+	const int32_t indexType = accessor.sparse.indices.second;
+	const uint32_t indexSize = ComponentSize(indexType);
+	auto sparseIndex = [&](size_t k) { return static_cast<uint64_t>(ReadComponent(layout.sparseIndices + k * indexSize, indexType)); };
+
+	for (size_t k = 0; k < sparseCount; ++k)
+	{
+		const uint64_t target = sparseIndex(k);
+		if (target >= static_cast<uint64_t>(accessor.count))
+		{
+			Error(issues, Path("accessors", index, "sparse.indices"), "[" + std::to_string(k) + "] is " + std::to_string(target) + " but the accessor only has " +
+				std::to_string(accessor.count) + " elements");
+			return;
+		}
+		if (k > 0 && target <= sparseIndex(k - 1))
+		{
+			Error(issues, Path("accessors", index, "sparse.indices"), "[" + std::to_string(k) + "] is " + std::to_string(target) + ", they have to be strictly increasing");
+			return;
+		}
+	}
+
+	if (layout.isIndices && layout.data && !sparse && layout.stride == componentSize)
+	{
+		uint32_t lo, hi;
+		ScanIndices(layout.data, static_cast<size_t>(accessor.count), accessor.componentType, lo, hi);
+
+		if (layout.indexLimit != UINT32_MAX && hi >= layout.indexLimit)
+			Error(issues, Path("accessors", index), "has index " + std::to_string(hi) + " but its primitive only has " + std::to_string(layout.indexLimit) + " vertices");
+
+		if (layout.min.size() == 1 && layout.max.size() == 1 && (layout.min[0] != Bound(layout, lo) || layout.max[0] != Bound(layout, hi)))
+			Error(issues, Path("accessors", index, "min"), "and max say [" + std::to_string(layout.min[0]) + ", " + std::to_string(layout.max[0]) +
+				"] but the data is [" + std::to_string(lo) + ", " + std::to_string(hi) + "]");
+		return;
+	}
+
+	if (layout.min.size() != components && layout.max.size() != components && !layout.isIndices)
+		return;
+
+	// matrices are skipped, their column padding makes this not worth it
+	if (accessor.type.compare(0, 3, "MAT") == 0)
+		return;
+
+	std::vector<double> lo(components, std::numeric_limits<double>::infinity());
+	std::vector<double> hi(components, -std::numeric_limits<double>::infinity());
+
+	// with the sparse values in place of the elements they replace, min/max are about what the accessor hands out
+	const uint64_t valueSize = static_cast<uint64_t>(componentSize) * components;
+	size_t next = 0;
+	for (int64_t e = 0; e < accessor.count; ++e)
+	{
+		const uint8_t* element = layout.data ? layout.data + e * layout.stride : nullptr;
+		if (next < sparseCount && sparseIndex(next) == static_cast<uint64_t>(e))
+			element = layout.sparseValues + next++ * valueSize;
+
+		for (uint32_t c = 0; c < components; ++c)
+		{
+			const double v = element ? ReadComponent(element + c * componentSize, accessor.componentType) : 0.0;
+			lo[c] = std::min(lo[c], v);
+			hi[c] = std::max(hi[c], v);
+		}
+	}
+
+	if (layout.isIndices && layout.indexLimit != UINT32_MAX && hi[0] >= layout.indexLimit)
+		Error(issues, Path("accessors", index), "has index " + std::to_string(static_cast<uint64_t>(hi[0])) + " but its primitive only has " +
+			std::to_string(layout.indexLimit) + " vertices");
+
+	// the json has the value in decimal, a float read back from it can be off in the last bits
+	auto differs = [&](double declared, double actual)
+	{
+		if (accessor.componentType != 5126)
+			return declared != Bound(layout, actual);
+		return std::fabs(declared - actual) > 1e-5 * std::max(1.0, std::fabs(actual));
+	};
+
+	for (uint32_t c = 0; c < components; ++c)
+	{
+		if (layout.min.size() == components && differs(layout.min[c], lo[c]))
+		{
+			Error(issues, Path("accessors", index, "min"), "[" + std::to_string(c) + "] is " + std::to_string(layout.min[c]) + " but the data has " + std::to_string(lo[c]));
+			break;
+		}
+		if (layout.max.size() == components && differs(layout.max[c], hi[c]))
+		{
+			Error(issues, Path("accessors", index, "max"), "[" + std::to_string(c) + "] is " + std::to_string(layout.max[c]) + " but the data has " + std::to_string(hi[c]));
+			break;
+		}
+	}
+}
+
+bool EGLTF::ValidateGLTFAsset(const SGLTFAsset& asset, SGLTFValidationReport& report, CGLTFThreadPool* pool, const SGLTFLoadSelection* selection,
+	const SGLTFCompactAsset* compact)
+{
+	std::vector<SGLTFValidationIssue>& issues = report.issues;
+	const size_t before = issues.size();
+
+	// left out elements are default constructed, which would be nothing but errors
+	const SGLTFLoadSelection all;
+	const SGLTFLoadSelection& selected = selection ? *selection : all;
+
+	// buffers, resident ones only get their data looked at
+	std::vector<uint8_t> resident(asset.buffers.size(), 0);
+	for (size_t i = 0; i < asset.buffers.size(); ++i)
+	{
+		if (!SGLTFLoadSelection::Has(selected.buffers, i))
+			continue;
+
+		const SGLTFAsset_Prop_Buffer& buffer = asset.buffers[i];
+		if (buffer.byteLength < 1)
+			Error(issues, Path("buffers", i, "byteLength"), "is " + std::to_string(buffer.byteLength));
+		else if (buffer.data.empty() && !buffer.uri.empty())
+			Warning(issues, Path("buffers", i), "is not loaded, its data is not checked");
+		else if (buffer.data.size() < static_cast<size_t>(buffer.byteLength))
+			Error(issues, Path("buffers", i, "byteLength"), "is " + std::to_string(buffer.byteLength) + " but only " + std::to_string(buffer.data.size()) + " bytes were loaded");
+		else
+			resident[i] = 1;
+	}
+
+	for (size_t i = 0; i < asset.bufferViews.size(); ++i)
+	{
+		if (!SGLTFLoadSelection::Has(selected.bufferViews, i))
+			continue;
+
+		const SGLTFAsset_Prop_BufferView& view = asset.bufferViews[i];
+		if (!InRange(view.buffer, asset.buffers))
+		{
+			Error(issues, Path("bufferViews", i, "buffer"), "refers to buffers[" + std::to_string(view.buffer) + "] which does not exist");
+			continue;
+		}
+
+		const uint64_t offset = static_cast<uint64_t>(std::max<int64_t>(view.byteOffset, 0));
+		if (view.byteLength < 1)
+			Error(issues, Path("bufferViews", i, "byteLength"), "is " + std::to_string(view.byteLength));
+		else if (offset + static_cast<uint64_t>(view.byteLength) > static_cast<uint64_t>(std::max<int64_t>(asset.buffers[view.buffer].byteLength, 0)))
+			Error(issues, Path("bufferViews", i), "covers bytes [" + std::to_string(offset) + ", " + std::to_string(offset + view.byteLength) +
+				") of a buffer that is " + std::to_string(asset.buffers[view.buffer].byteLength) + " bytes long");
+
+		if (view.byteStride != -1 && (view.byteStride < 4 || view.byteStride > 252 || view.byteStride % 4 != 0))
+			Error(issues, Path("bufferViews", i, "byteStride"), "is " + std::to_string(view.byteStride) + ", has to be a multiple of 4 in [4, 252]");
+	}
+
+	std::vector<SAccessorData> layouts(asset.accessors.size());
+	for (size_t i = 0; i < asset.accessors.size(); ++i)
+	{
+		if (!SGLTFLoadSelection::Has(selected.accessors, i))
+			continue;
+
+		const SGLTFAsset_Prop_Accessor& accessor = asset.accessors[i];
+
+		SAccessorData& layout = layouts[i];
+		layout.min = accessor.min;
+		layout.max = accessor.max;
+		if (compact && i < compact->accessorMin.size() && i < compact->accessorMax.size())
+		{
+			CopyBounds(compact->bounds, compact->accessorMin[i], layout.min);
+			CopyBounds(compact->bounds, compact->accessorMax[i], layout.max);
+			layout.floatBounds = true;
+		}
+
+		const uint32_t componentSize = ComponentSize(accessor.componentType);
+		const uint32_t components = ComponentCount(accessor.type);
+		if (componentSize == 0)
+			Error(issues, Path("accessors", i, "componentType"), "is " + std::to_string(accessor.componentType) + ", not a valid component type");
+		if (components == 0)
+			Error(issues, Path("accessors", i, "type"), "is '" + accessor.type + "', not a valid type");
+		if (accessor.count < 1)
+			Error(issues, Path("accessors", i, "count"), "is " + std::to_string(accessor.count));
+		if (accessor.normalized && (accessor.componentType == 5125 || accessor.componentType == 5126))
+			Error(issues, Path("accessors", i, "normalized"), "is true for a FLOAT or UNSIGNED_INT accessor");
+
+		if (!layout.min.empty() && layout.min.size() != components)
+			Error(issues, Path("accessors", i, "min"), "has " + std::to_string(layout.min.size()) + " values for a " + accessor.type);
+		if (!layout.max.empty() && layout.max.size() != components)
+			Error(issues, Path("accessors", i, "max"), "has " + std::to_string(layout.max.size()) + " values for a " + accessor.type);
+
+		if (accessor.sparse.count != -1)
+			CheckSparse(asset, accessor, i, resident, layout, issues);
+
+		if (accessor.bufferView == -1)
+		{
+			// all zeros, nothing to read but the sparse values
+			layout.zeros = componentSize != 0 && components != 0;
+			continue;
+		}
+
+		if (!InRange(accessor.bufferView, asset.bufferViews))
+		{
+			Error(issues, Path("accessors", i, "bufferView"), "refers to bufferViews[" + std::to_string(accessor.bufferView) + "] which does not exist");
+			continue;
+		}
+
+		if (componentSize == 0 || components == 0 || accessor.count < 1)
+			continue;
+
+		const SGLTFAsset_Prop_BufferView& view = asset.bufferViews[accessor.bufferView];
+		if (!InRange(view.buffer, asset.buffers) || view.byteLength < 1)
+			continue;
+
+		const uint64_t offset = static_cast<uint64_t>(std::max<int64_t>(accessor.byteOffset, 0));
+		const uint64_t elementSize = ElementSize(accessor.componentType, accessor.type);
+		const uint64_t stride = view.byteStride > 0 ? static_cast<uint64_t>(view.byteStride) : elementSize;
+		const uint64_t needed = offset + stride * (static_cast<uint64_t>(accessor.count) - 1) + elementSize;
+
+		if (offset % componentSize != 0)
+			Error(issues, Path("accessors", i, "byteOffset"), "is " + std::to_string(offset) + ", not aligned to its " + std::to_string(componentSize) + " byte components");
+		if (stride < elementSize)
+			Error(issues, Path("bufferViews", accessor.bufferView, "byteStride"), "is smaller than the elements of accessors[" + std::to_string(i) + "]");
+
+		if (needed > static_cast<uint64_t>(view.byteLength))
+		{
+			Error(issues, Path("accessors", i), "needs " + std::to_string(needed) + " bytes of a bufferView that is " + std::to_string(view.byteLength) + " bytes long");
+			continue;
+		}
+
+		const uint64_t viewOffset = static_cast<uint64_t>(std::max<int64_t>(view.byteOffset, 0));
+		if (resident[view.buffer] && stride >= elementSize && viewOffset + view.byteLength <= asset.buffers[view.buffer].data.size())
+		{
+			layout.data = asset.buffers[view.buffer].data.data() + viewOffset + offset;
+			layout.stride = stride;
+		}
+	}
+
+	for (size_t i = 0; i < asset.images.size(); ++i)
+	{
+		if (!SGLTFLoadSelection::Has(selected.images, i))
+			continue;
+
+		const SGLTFAsset_Prop_Image& image = asset.images[i];
+		CheckReference(issues, image.bufferView, asset.bufferViews, "bufferViews", Path("images", i, "bufferView"));
+		if (image.bufferView == -1 && image.data.empty() && image.uri.empty())
+			Error(issues, Path("images", i), "has neither data nor a bufferView");
+	}
+
+	for (size_t i = 0; i < asset.textures.size(); ++i)
+	{
+		CheckReference(issues, asset.textures[i].source, asset.images, "images", Path("textures", i, "source"));
+		CheckReference(issues, asset.textures[i].sampler, asset.samplers, "samplers", Path("textures", i, "sampler"));
+	}
+
+	for (size_t i = 0; i < asset.materials.size(); ++i)
+	{
+		const SGLTFAsset_Prop_Material& material = asset.materials[i];
+		CheckReference(issues, material.pbrMetallicRoughness.baseColorTexture.index, asset.textures, "textures", Path("materials", i, "pbrMetallicRoughness.baseColorTexture.index"));
+		CheckReference(issues, material.pbrMetallicRoughness.metallicRoughnessTexture.index, asset.textures, "textures", Path("materials", i, "pbrMetallicRoughness.metallicRoughnessTexture.index"));
+		CheckReference(issues, material.normalTexture.index, asset.textures, "textures", Path("materials", i, "normalTexture.index"));
+		CheckReference(issues, material.occlusionTexture.index, asset.textures, "textures", Path("materials", i, "occlusionTexture.index"));
+		CheckReference(issues, material.emissiveTexture.index, asset.textures, "textures", Path("materials", i, "emissiveTexture.index"));
+	}
+
+	for (size_t i = 0; i < asset.cameras.size(); ++i)
+	{
+		const SGLTFAsset_Prop_Camera& camera = asset.cameras[i];
+		if (camera.type == SGLTFAsset_Prop_Camera_Type::PERSPECTIVE)
+		{
+			if (!(camera.val1 > 0.0))
+				Error(issues, Path("cameras", i, "perspective.yfov"), "has to be greater than 0");
+			if (!(camera.znear > 0.0))
+				Error(issues, Path("cameras", i, "perspective.znear"), "has to be greater than 0");
+			if (camera.zfar != 0.0 && !(camera.zfar > camera.znear))
+				Error(issues, Path("cameras", i, "perspective.zfar"), "has to be greater than znear");
+			if (camera.val0 < 0.0)
+				Error(issues, Path("cameras", i, "perspective.aspectRatio"), "has to be greater than 0");
+		}
+		else
+		{
+			if (camera.val0 == 0.0 || camera.val1 == 0.0)
+				Error(issues, Path("cameras", i, "orthographic"), "xmag and ymag can't be 0");
+			if (camera.znear < 0.0)
+				Error(issues, Path("cameras", i, "orthographic.znear"), "can't be negative");
+			if (!(camera.zfar > camera.znear))
+				Error(issues, Path("cameras", i, "orthographic.zfar"), "has to be greater than znear");
+		}
+	}
+
+	for (size_t i = 0; i < asset.meshes.size(); ++i)
+	{
+		for (size_t p = 0; p < asset.meshes[i].primitives.size(); ++p)
+		{
+			const SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[i].primitives[p];
+			const std::string path = Path("meshes", i) + Path(".primitives", p);
+
+			if (primitive.mode < -1 || primitive.mode > 6)
+				Error(issues, path + ".mode", "is " + std::to_string(primitive.mode));
+			CheckReference(issues, primitive.material, asset.materials, "materials", path + ".material");
+
+			int64_t vertexCount = -1;
+			for (const auto& attribute : primitive.attributes)
+			{
+				if (!InRange(attribute.second, asset.accessors))
+				{
+					Error(issues, path + ".attributes." + attribute.first, "refers to accessors[" + std::to_string(attribute.second) + "] which does not exist");
+					continue;
+				}
+
+				const int64_t count = asset.accessors[attribute.second].count;
+				if (vertexCount != -1 && count != vertexCount)
+					Error(issues, path + ".attributes." + attribute.first, "has " + std::to_string(count) + " elements, the other attributes have " + std::to_string(vertexCount));
+				vertexCount = vertexCount == -1 ? count : std::min(vertexCount, count);
+			}
+
+			for (size_t t = 0; t < primitive.targets.size(); ++t)
+				for (const auto& attribute : primitive.targets[t])
+					CheckReference(issues, attribute.second, asset.accessors, "accessors", path + Path(".targets", t) + "." + attribute.first);
+
+			if (primitive.indices == -1)
+				continue;
+
+			if (!InRange(primitive.indices, asset.accessors))
+			{
+				Error(issues, path + ".indices", "refers to accessors[" + std::to_string(primitive.indices) + "] which does not exist");
+				continue;
+			}
+
+			const SGLTFAsset_Prop_Accessor& indices = asset.accessors[primitive.indices];
+			if ((indices.componentType != 5121 && indices.componentType != 5123 && indices.componentType != 5125) || indices.type != "SCALAR")
+			{
+				Error(issues, path + ".indices", "has to be an unsigned SCALAR accessor");
+				continue;
+			}
+
+			SAccessorData& layout = layouts[primitive.indices];
+			layout.isIndices = true;
+			if (vertexCount >= 0)
+				layout.indexLimit = static_cast<uint32_t>(std::min<int64_t>(layout.indexLimit, vertexCount));
+		}
+	}
+
+	// every node can only have one parent, and following parents has to end somewhere. A compact load has its nodes apart.
+	const size_t nodeCount = compact ? compact->nodes.size() : asset.nodes.size();
+	auto isNode = [nodeCount](int32_t node) { return node >= 0 && static_cast<size_t>(node) < nodeCount; };
+
+	std::vector<int32_t> parents(nodeCount, -1);
+	for (size_t i = 0; i < nodeCount; ++i)
+	{
+		int32_t mesh, skin, camera;
+		const int32_t* children = nullptr;
+		size_t childCount = 0;
+		if (compact)
+		{
+			const SGLTFCompact_Node& node = compact->nodes[i];
+			mesh = node.mesh;
+			skin = node.skin;
+			camera = node.camera;
+			if (static_cast<size_t>(node.children.offset) + node.children.count <= compact->children.size())
+			{
+				children = compact->children.data() + node.children.offset;
+				childCount = node.children.count;
+			}
+			else
+				Error(issues, Path("nodes", i, "children"), "are outside of the compact children table");
+		}
+		else
+		{
+			const SGLTFAsset_Prop_Node& node = asset.nodes[i];
+			mesh = node.mesh;
+			skin = node.skin;
+			camera = node.camera;
+			children = node.children.data();
+			childCount = node.children.size();
+		}
+
+		CheckReference(issues, mesh, asset.meshes, "meshes", Path("nodes", i, "mesh"));
+		CheckReference(issues, skin, asset.skins, "skins", Path("nodes", i, "skin"));
+		CheckReference(issues, camera, asset.cameras, "cameras", Path("nodes", i, "camera"));
+
+		for (size_t c = 0; c < childCount; ++c)
+		{
+			const int32_t child = children[c];
+			if (!isNode(child))
+				Error(issues, Path("nodes", i) + Path(".children", c), "refers to nodes[" + std::to_string(child) + "] which does not exist");
+			else if (parents[child] != -1)
+				Error(issues, Path("nodes", i) + Path(".children", c), "nodes[" + std::to_string(child) + "] already is a child of nodes[" + std::to_string(parents[child]) + "]");
+			else
+				parents[child] = static_cast<int32_t>(i);
+		}
+	}
+
+	std::vector<uint8_t> state(nodeCount, 0); // 0 not seen, 1 on the current walk, 2 known to end at a root
+	std::vector<int32_t> walk;
+	for (size_t i = 0; i < nodeCount; ++i)
+	{
+		walk.clear();
+		int32_t node = static_cast<int32_t>(i);
+		while (node != -1 && state[node] == 0)
+		{
+			state[node] = 1;
+			walk.push_back(node);
+			node = parents[node];
+		}
+
+		if (node != -1 && state[node] == 1)
+			Error(issues, Path("nodes", node), "is its own ancestor");
+
+		for (int32_t n : walk)
+			state[n] = 2;
+	}
+
+	for (size_t i = 0; i < asset.scenes.size(); ++i)
+	{
+		for (size_t n = 0; n < asset.scenes[i].nodes.size(); ++n)
+		{
+			const int32_t node = asset.scenes[i].nodes[n];
+			if (!isNode(node))
+				Error(issues, Path("scenes", i) + Path(".nodes", n), "refers to nodes[" + std::to_string(node) + "] which does not exist");
+			else if (parents[node] != -1)
+				Error(issues, Path("scenes", i) + Path(".nodes", n), "nodes[" + std::to_string(node) + "] is not a root node");
+		}
+	}
+
+	for (size_t i = 0; i < asset.skins.size(); ++i)
+	{
+		const SGLTFAsset_Prop_Skin& skin = asset.skins[i];
+		CheckReference(issues, skin.inverseBindMatrices, asset.accessors, "accessors", Path("skins", i, "inverseBindMatrices"));
+		CheckReference(issues, skin.skeleton, nodeCount, "nodes", Path("skins", i, "skeleton"));
+		for (size_t j = 0; j < skin.joints.size(); ++j)
+			if (!isNode(skin.joints[j]))
+				Error(issues, Path("skins", i) + Path(".joints", j), "refers to nodes[" + std::to_string(skin.joints[j]) + "] which does not exist");
+
+		if (InRange(skin.inverseBindMatrices, asset.accessors) && asset.accessors[skin.inverseBindMatrices].count < static_cast<int64_t>(skin.joints.size()))
+			Error(issues, Path("skins", i, "inverseBindMatrices"), "has fewer matrices than there are joints");
+	}
+
+	for (size_t i = 0; i < asset.animations.size(); ++i)
+	{
+		const SGLTFAsset_Prop_Animation& animation = asset.animations[i];
+		for (size_t c = 0; c < animation.channels.size(); ++c)
+		{
+			const std::string path = Path("animations", i) + Path(".channels", c);
+			if (!InRange(animation.channels[c].sampler, animation.samplers))
+				Error(issues, path + ".sampler", "refers to sampler " + std::to_string(animation.channels[c].sampler) + " which the animation does not have");
+			CheckReference(issues, animation.channels[c].target.node, nodeCount, "nodes", path + ".target.node");
+		}
+
+		for (size_t s = 0; s < animation.samplers.size(); ++s)
+		{
+			const std::string path = Path("animations", i) + Path(".samplers", s);
+			if (!InRange(animation.samplers[s].input, asset.accessors))
+				Error(issues, path + ".input", "refers to accessors[" + std::to_string(animation.samplers[s].input) + "] which does not exist");
+			if (!InRange(animation.samplers[s].output, asset.accessors))
+				Error(issues, path + ".output", "refers to accessors[" + std::to_string(animation.samplers[s].output) + "] which does not exist");
+		}
+	}
+
+	// the data checks are the expensive part, one accessor at a time with their issues kept apart so the order does not depend on threads
+	std::vector<std::vector<SGLTFValidationIssue>> dataIssues(asset.accessors.size());
+	auto checkData = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			CheckAccessorData(asset.accessors[i], layouts[i], i, dataIssues[i]);
+	};
+
+	if (pool && asset.accessors.size() > 1)
+		pool->ParallelFor(asset.accessors.size(), 1, checkData);
+	else
+		checkData(0, asset.accessors.size());
+
+	for (const auto& accessorIssues : dataIssues)
+		issues.insert(issues.end(), accessorIssues.begin(), accessorIssues.end());
+
+	for (size_t i = before; i < issues.size(); ++i)
+		if (issues[i].severity == EGLTFValidationSeverity::ERROR)
+			return false;
+	return true;
+}
@@ -0,0 +1,609 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+// off_t and stat sizes are 64 bit on 32 bit systems too, buffers can be larger than 4 GB
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "easygltf_vfs.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t GLTF_PACK_MAGIC = 0x4B504745; // "EGPK"
+static const uint32_t GLTF_PACK_VERSION = 1;
+static const uint64_t GLTF_PACK_ALIGNMENT = 16;
+
+static const uint32_t ZIP_END_OF_DIRECTORY = 0x06054B50;
+static const uint32_t ZIP_DIRECTORY_ENTRY = 0x02014B50;
+static const uint32_t ZIP_LOCAL_HEADER = 0x04034B50;
+
+template<typename T>
+static T ReadLE(const uint8_t* data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+// Folds "." and "..", a ".." that would leave a relative path stays
+static std::string CollapsePath(const std::string& path)
+{
+	std::vector<std::string> segments;
+	const bool absolute = !path.empty() && path[0] == '/';
+
+	size_t begin = 0;
+	while (begin <= path.size())
+	{
+		size_t end = path.find('/', begin);
+		if (end == std::string::npos)
+			end = path.size();
+
+		const std::string segment = path.substr(begin, end - begin);
+		if (segment == "..")
+		{
+			if (!segments.empty() && segments.back() != "..")
+				segments.pop_back();
+			else if (!absolute)
+				segments.push_back(segment);
+		}
+		else if (!segment.empty() && segment != ".")
+			segments.push_back(segment);
+
+		begin = end + 1;
+	}
+
+	std::string out = absolute ? "/" : "";
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		if (i > 0)
+			out += '/';
+		out += segments[i];
+	}
+	return out;
+}
+
+static int HexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+std::string EGLTF::ResolveGLTFUri(const std::string& directory, const std::string& uri)
+{
+	std::string decoded;
+	decoded.reserve(uri.size());
+
+	for (size_t i = 0; i < uri.size(); ++i)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size() && HexValue(uri[i + 1]) >= 0 && HexValue(uri[i + 2]) >= 0)
+		{
+			decoded += static_cast<char>(HexValue(uri[i + 1]) * 16 + HexValue(uri[i + 2]));
+			i += 2;
+		}
+		else
+			decoded += uri[i];
+	}
+
+	if (!decoded.empty() && decoded[0] == '/')
+		return CollapsePath(decoded);
+
+	return CollapsePath(directory + decoded);
+}
+
+// Disk
+
+EGLTF::CGLTFDiskFileSystem& EGLTF::CGLTFDiskFileSystem::Get()
+{
+	static CGLTFDiskFileSystem instance;
+	return instance;
+}
+
+bool EGLTF::CGLTFDiskFileSystem::ReadFile(const std::string& path, std::vector<uint8_t>& out)
+{
+	out.clear();
+
+	std::ifstream fh(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!fh.is_open())
+		return false;
+
+	const std::streamoff sz = fh.tellg();
+	if (sz < 0)
+		return false;
+
+	fh.seekg(0, std::ios::beg);
+
+	out.resize(static_cast<size_t>(sz));
+	if (sz > 0 && !fh.read((char*) out.data(), sz))
+	{
+		out.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool EGLTF::CGLTFDiskFileSystem::ReadFileRanges(const std::string& path, const SGLTFFileRead* reads, size_t count)
+{
+#ifdef _WIN32
+	std::ifstream fh(path, std::ios::in | std::ios::binary);
+	if (!fh.is_open())
+		return false;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		fh.seekg(static_cast<std::streamoff>(reads[i].offset), std::ios::beg);
+		if (!fh.read((char*) reads[i].out, static_cast<std::streamsize>(reads[i].length)))
+			return false;
+	}
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t done = 0;
+		while (done < reads[i].length)
+		{
+			const ssize_t n = pread(fd, reads[i].out + done, static_cast<size_t>(reads[i].length - done), static_cast<off_t>(reads[i].offset + done));
+			if (n <= 0)
+			{
+				close(fd);
+				return false;
+			}
+			done += static_cast<uint64_t>(n);
+		}
+	}
+
+	close(fd);
+#endif
+
+	return true;
+}
+
+bool EGLTF::CGLTFDiskFileSystem::StatFile(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+#endif
+
+	size = static_cast<uint64_t>(info.st_size);
+#ifdef __linux__
+	// seconds are too coarse for someone hitting save twice in a row
+	mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+#else
+	mtime = static_cast<int64_t>(info.st_mtime);
+#endif
+	return true;
+}
+
+// Memory
+
+void EGLTF::CGLTFMemoryFileSystem::AddFile(const std::string& path, std::vector<uint8_t> data)
+{
+	SFile& file = m_files[CollapsePath(path)];
+	file.owned = std::move(data);
+	file.data = file.owned.data();
+	file.size = file.owned.size();
+	file.version = ++m_version;
+}
+
+void EGLTF::CGLTFMemoryFileSystem::AddFileView(const std::string& path, const uint8_t* data, size_t size)
+{
+	SFile& file = m_files[CollapsePath(path)];
+	std::vector<uint8_t>().swap(file.owned);
+	file.data = data;
+	file.size = size;
+	file.version = ++m_version;
+}
+
+void EGLTF::CGLTFMemoryFileSystem::RemoveFile(const std::string& path)
+{
+	m_files.erase(CollapsePath(path));
+}
+
+const EGLTF::CGLTFMemoryFileSystem::SFile* EGLTF::CGLTFMemoryFileSystem::Find(const std::string& path) const
+{
+	auto iter = m_files.find(CollapsePath(path));
+	return iter != m_files.end() ? &iter->second : nullptr;
+}
+
+bool EGLTF::CGLTFMemoryFileSystem::ReadFile(const std::string& path, std::vector<uint8_t>& out)
+{
+	const SFile* file = Find(path);
+	if (!file)
+	{
+		out.clear();
+		return false;
+	}
+
+	out.assign(file->data, file->data + file->size);
+	return true;
+}
+
+bool EGLTF::CGLTFMemoryFileSystem::ReadFileRanges(const std::string& path, const SGLTFFileRead* reads, size_t count)
+{
+	const SFile* file = Find(path);
+	if (!file)
+		return false;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (reads[i].offset > file->size || reads[i].length > file->size - reads[i].offset)
+			return false;
+		memcpy(reads[i].out, file->data + reads[i].offset, static_cast<size_t>(reads[i].length));
+	}
+
+	return true;
+}
+
+bool EGLTF::CGLTFMemoryFileSystem::StatFile(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+	const SFile* file = Find(path);
+	if (!file)
+		return false;
+
+	size = file->size;
+	mtime = file->version;
+	return true;
+}
+
+bool EGLTF::CGLTFMemoryFileSystem::GetFileView(const std::string& path, const uint8_t*& data, uint64_t& size)
+{
+	const SFile* file = Find(path);
+	if (!file)
+		return false;
+
+	data = file->data;
+	size = file->size;
+	return true;
+}
+
+// Archive
+
+EGLTF::CGLTFArchiveFileSystem::~CGLTFArchiveFileSystem()
+{
+	Close();
+}
+
+bool EGLTF::CGLTFArchiveFileSystem::Open(const std::string& filepath)
+{
+	Close();
+
+	uint64_t statSize = 0;
+	if (!CGLTFDiskFileSystem::Get().StatFile(filepath, statSize, m_mtime))
+		return false;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < 16)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	m_file = file;
+	m_mapping = mapping;
+	m_size = static_cast<uint64_t>(size.QuadPart);
+
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+#else
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < 16)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file alive
+
+	if (mapped == MAP_FAILED)
+		return false;
+
+	m_data = static_cast<const uint8_t*>(mapped);
+	m_size = static_cast<uint64_t>(st.st_size);
+#endif
+
+	const bool ok = ReadLE<uint32_t>(m_data) == GLTF_PACK_MAGIC ? ParsePack() : ParseZip();
+	if (!ok)
+	{
+		fprintf(stderr, "\nError: %s is neither a pack nor a zip archive that can be read\n", filepath.c_str());
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void EGLTF::CGLTFArchiveFileSystem::Close()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_data)
+		munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_size));
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+	m_entries.clear();
+}
+
+bool EGLTF::CGLTFArchiveFileSystem::ParsePack()
+{
+	if (ReadLE<uint32_t>(m_data + 4) != GLTF_PACK_VERSION)
+		return false;
+
+	const uint32_t count = ReadLE<uint32_t>(m_data + 8);
+	uint64_t offset = 16;
+
+	m_entries.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (m_size - offset < 20)
+			return false;
+
+		SEntry entry;
+		entry.offset = ReadLE<uint64_t>(m_data + offset);
+		entry.size = ReadLE<uint64_t>(m_data + offset + 8);
+		const uint32_t nameLength = ReadLE<uint32_t>(m_data + offset + 16);
+		offset += 20;
+
+		if (m_size - offset < nameLength || entry.offset > m_size || entry.size > m_size - entry.offset)
+			return false;
+
+		m_entries[CollapsePath(std::string(reinterpret_cast<const char*>(m_data + offset), nameLength))] = entry;
+		offset += nameLength;
+	}
+
+	return true;
+}
+
+bool EGLTF::CGLTFArchiveFileSystem::ParseZip()
+{
+	// the end of central directory record is the last thing in the file, followed by a comment of up to 64 KB
+	if (m_size < 22)
+		return false;
+
+	const uint64_t searchEnd = m_size > 22 + 0xFFFF ? m_size - 22 - 0xFFFF : 0;
+	uint64_t end = m_size - 22;
+	for (;;)
+	{
+		if (ReadLE<uint32_t>(m_data + end) == ZIP_END_OF_DIRECTORY)
+			break;
+		if (end == searchEnd)
+			return false;
+		--end;
+	}
+
+	const uint16_t count = ReadLE<uint16_t>(m_data + end + 10);
+	uint64_t offset = ReadLE<uint32_t>(m_data + end + 16);
+
+	m_entries.reserve(count);
+	for (uint16_t i = 0; i < count; ++i)
+	{
+		if (offset > m_size || m_size - offset < 46 || ReadLE<uint32_t>(m_data + offset) != ZIP_DIRECTORY_ENTRY)
+			return false;
+
+		const uint16_t method = ReadLE<uint16_t>(m_data + offset + 10);
+		const uint32_t compressedSize = ReadLE<uint32_t>(m_data + offset + 20);
+		const uint32_t size = ReadLE<uint32_t>(m_data + offset + 24);
+		const uint16_t nameLength = ReadLE<uint16_t>(m_data + offset + 28);
+		const uint16_t extraLength = ReadLE<uint16_t>(m_data + offset + 30);
+		const uint16_t commentLength = ReadLE<uint16_t>(m_data + offset + 32);
+		const uint64_t local = ReadLE<uint32_t>(m_data + offset + 42);
+
+		if (m_size - offset - 46 < nameLength)
+			return false;
+
+		const std::string name(reinterpret_cast<const char*>(m_data + offset + 46), nameLength);
+		offset += 46 + nameLength + extraLength + commentLength;
+
+		// directories have no data, compressed entries can't be handed out as views
+		if (name.empty() || name.back() == '/')
+			continue;
+		if (method != 0 || compressedSize != size)
+		{
+			fprintf(stderr, "\nError: %s is compressed, only stored zip entries can be read\n", name.c_str());
+			continue;
+		}
+
+		// the data follows the local header, whose name and extra field don't have to match the central directory's
+		if (local > m_size || m_size - local < 30 || ReadLE<uint32_t>(m_data + local) != ZIP_LOCAL_HEADER)
+			return false;
+
+		SEntry entry;
+		entry.offset = local + 30 + ReadLE<uint16_t>(m_data + local + 26) + ReadLE<uint16_t>(m_data + local + 28);
+		entry.size = size;
+
+		if (entry.offset > m_size || entry.size > m_size - entry.offset)
+			return false;
+
+		m_entries[CollapsePath(name)] = entry;
+	}
+
+	return true;
+}
+
+bool EGLTF::CGLTFArchiveFileSystem::ReadFile(const std::string& path, std::vector<uint8_t>& out)
+{
+	const uint8_t* data;
+	uint64_t size;
+	if (!GetFileView(path, data, size))
+	{
+		out.clear();
+		return false;
+	}
+
+	out.assign(data, data + size);
+	return true;
+}
+
+bool EGLTF::CGLTFArchiveFileSystem::ReadFileRanges(const std::string& path, const SGLTFFileRead* reads, size_t count)
+{
+	const uint8_t* data;
+	uint64_t size;
+	if (!GetFileView(path, data, size))
+		return false;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (reads[i].offset > size || reads[i].length > size - reads[i].offset)
+			return false;
+		memcpy(reads[i].out, data + reads[i].offset, static_cast<size_t>(reads[i].length));
+	}
+
+	return true;
+}
+
+bool EGLTF::CGLTFArchiveFileSystem::StatFile(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+	auto iter = m_entries.find(CollapsePath(path));
+	if (iter == m_entries.end())
+		return false;
+
+	size = iter->second.size;
+	mtime = m_mtime;
+	return true;
+}
+
+bool EGLTF::CGLTFArchiveFileSystem::GetFileView(const std::string& path, const uint8_t*& data, uint64_t& size)
+{
+	auto iter = m_entries.find(CollapsePath(path));
+	if (iter == m_entries.end())
+		return false;
+
+	data = m_data + iter->second.offset;
+	size = iter->second.size;
+	return true;
+}
+
+bool EGLTF::WriteGLTFPackage(const std::string& filepath, const std::vector<SGLTFPackageFile>& files)
+{
+	std::vector<std::vector<uint8_t>> contents(files.size());
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!CGLTFDiskFileSystem::Get().ReadFile(files[i].source, contents[i]))
+		{
+			fprintf(stderr, "\nError: could not read %s for the package\n", files[i].source.c_str());
+			return false;
+		}
+	}
+
+	uint64_t tableSize = 16;
+	for (const auto& file : files)
+		tableSize += 20 + file.name.size();
+
+	std::vector<uint8_t> header;
+	header.reserve(static_cast<size_t>(tableSize));
+
+	auto put = [&header](const void* data, size_t size)
+	{
+		header.insert(header.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+	};
+
+	const uint32_t head[4] = { GLTF_PACK_MAGIC, GLTF_PACK_VERSION, static_cast<uint32_t>(files.size()), 0 };
+	put(head, sizeof(head));
+
+	std::vector<uint64_t> offsets(files.size());
+	uint64_t offset = tableSize;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		offset = (offset + GLTF_PACK_ALIGNMENT - 1) / GLTF_PACK_ALIGNMENT * GLTF_PACK_ALIGNMENT;
+		offsets[i] = offset;
+
+		const uint64_t size = contents[i].size();
+		const uint32_t nameLength = static_cast<uint32_t>(files[i].name.size());
+		put(&offset, sizeof(offset));
+		put(&size, sizeof(size));
+		put(&nameLength, sizeof(nameLength));
+		put(files[i].name.data(), nameLength);
+
+		offset += size;
+	}
+
+	std::ofstream fh(filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fh.is_open())
+		return false;
+
+	fh.write((const char*) header.data(), header.size());
+
+	uint64_t written = header.size();
+	static const char padding[GLTF_PACK_ALIGNMENT] = {};
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		fh.write(padding, static_cast<std::streamsize>(offsets[i] - written));
+		fh.write((const char*) contents[i].data(), static_cast<std::streamsize>(contents[i].size()));
+		written = offsets[i] + contents[i].size();
+	}
+
+	return fh.good();
+}
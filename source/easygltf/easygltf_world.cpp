@@ -0,0 +1,725 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+
+#include "easygltf_world.h"
+#include "easygltf_compact.h"
+#include "easygltf_geometry.h"
+#include "easygltf_instancing.h"
+#include "easygltf_threadpool.h"
+#include "easygltf_vfs.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <thread>
+
+#define GLTF_WORLD_MAGIC 0x49574745u // "EGWI"
+#define GLTF_WORLD_VERSION 1u
+#define GLTF_WORLD_MAX_CELLS (1u << 22)
+
+static bool EndsWith(const std::string& str, const char* suffix)
+{
+	const size_t len = strlen(suffix);
+	return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+static bool LoadTile(EGLTF::CEasyGLTF& easygltf, const std::string& filepath)
+{
+	if (EndsWith(filepath, ".glb") || EndsWith(filepath, ".GLB"))
+		return easygltf.LoadGLB_file(filepath);
+
+	return easygltf.LoadGLTF_file(filepath);
+}
+
+static bool IsEmpty(const EGLTF::SGLTFWorldTile& tile)
+{
+	return tile.boundsMin[0] > tile.boundsMax[0];
+}
+
+// World bounds of every mesh instance of the default scene, from the POSITION min/max, read from the data where those are missing
+static void ComputeTileBounds(const EGLTF::SGLTFAsset& asset, EGLTF::SGLTFWorldTile& tile)
+{
+	for (int i = 0; i < 3; ++i)
+		tile.boundsMin[i] = FLT_MAX, tile.boundsMax[i] = -FLT_MAX;
+
+	EGLTF::SGLTFInstancing instancing;
+	if (!EGLTF::BuildGLTFInstanceGroups(asset, instancing))
+		return;
+
+	std::vector<float> positions;
+	for (const auto& group : instancing.groups)
+	{
+		for (const auto& primitive : asset.meshes[group.mesh].primitives)
+		{
+			auto attribute = primitive.attributes.find("POSITION");
+			if (attribute == primitive.attributes.end() || attribute->second < 0 || static_cast<size_t>(attribute->second) >= asset.accessors.size())
+				continue;
+
+			const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[attribute->second];
+			float localMin[3], localMax[3];
+			if (accessor.min.size() >= 3 && accessor.max.size() >= 3)
+			{
+				for (int i = 0; i < 3; ++i)
+					localMin[i] = static_cast<float>(accessor.min[i]), localMax[i] = static_cast<float>(accessor.max[i]);
+			}
+			else
+			{
+				positions.clear();
+				if (!EGLTF::ReadGLTFAccessor(asset, attribute->second, positions) || positions.size() < 3)
+					continue;
+
+				for (int i = 0; i < 3; ++i)
+					localMin[i] = FLT_MAX, localMax[i] = -FLT_MAX;
+				for (size_t v = 0; v + 2 < positions.size(); v += 3)
+					for (int i = 0; i < 3; ++i)
+					{
+						localMin[i] = std::min(localMin[i], positions[v + i]);
+						localMax[i] = std::max(localMax[i], positions[v + i]);
+					}
+			}
+
+			for (size_t t = 0; t + 16 <= group.transforms.size(); t += 16)
+			{
+				const float* m = &group.transforms[t];
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					const float p[3] = { corner & 1 ? localMax[0] : localMin[0], corner & 2 ? localMax[1] : localMin[1], corner & 4 ? localMax[2] : localMin[2] };
+					for (int i = 0; i < 3; ++i)
+					{
+						const float world = m[i] * p[0] + m[4 + i] * p[1] + m[8 + i] * p[2] + m[12 + i];
+						tile.boundsMin[i] = std::min(tile.boundsMin[i], world);
+						tile.boundsMax[i] = std::max(tile.boundsMax[i], world);
+					}
+				}
+			}
+		}
+	}
+}
+
+bool EGLTF::CGLTFWorldIndex::Build(const std::vector<std::string>& files, float cellSize, CGLTFThreadPool* pool, const CGLTFWorldIndex* previous)
+{
+	IGLTFFileSystem& fileSystem = m_fileSystem ? *m_fileSystem : CGLTFDiskFileSystem::Get();
+
+	std::map<std::string, const SGLTFWorldTile*> previousTiles;
+	if (previous)
+		for (const auto& tile : previous->m_tiles)
+			previousTiles[tile.filepath] = &tile;
+
+	m_tiles.assign(files.size(), SGLTFWorldTile());
+	std::vector<uint8_t> failed(files.size(), 0);
+
+	auto build = [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			SGLTFWorldTile& tile = m_tiles[i];
+			tile.filepath = files[i];
+			for (int k = 0; k < 3; ++k)
+				tile.boundsMin[k] = FLT_MAX, tile.boundsMax[k] = -FLT_MAX;
+
+			if (!fileSystem.StatFile(tile.filepath, tile.fileSize, tile.mtime))
+			{
+				failed[i] = 1;
+				continue;
+			}
+
+			auto found = previousTiles.find(tile.filepath);
+			if (found != previousTiles.end() && !IsEmpty(*found->second) && found->second->fileSize == tile.fileSize && found->second->mtime == tile.mtime)
+			{
+				tile = *found->second;
+				continue;
+			}
+
+			CEasyGLTF easygltf;
+			easygltf.SetFileSystem(m_fileSystem);
+			if (!LoadTile(easygltf, tile.filepath))
+			{
+				failed[i] = 1;
+				continue;
+			}
+
+			ComputeTileBounds(easygltf.GetAssetInstance(), tile);
+			tile.bytes = GetGLTFMemoryReport(easygltf.GetAssetInstance()).total;
+		}
+	};
+
+	if (pool)
+		pool->ParallelFor(files.size(), 1, build);
+	else
+		build(0, files.size());
+
+	bool ok = true;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (failed[i])
+		{
+			fprintf(stderr, "\nError: world tile %s could not be loaded\n", files[i].c_str());
+			ok = false;
+		}
+	}
+
+	BuildGrid(cellSize);
+	return ok;
+}
+
+void EGLTF::CGLTFWorldIndex::BuildGrid(float cellSize)
+{
+	float minX = FLT_MAX, minZ = FLT_MAX, maxX = -FLT_MAX, maxZ = -FLT_MAX;
+	std::vector<float> extents;
+	for (const auto& tile : m_tiles)
+	{
+		if (IsEmpty(tile))
+			continue;
+
+		minX = std::min(minX, tile.boundsMin[0]);
+		minZ = std::min(minZ, tile.boundsMin[2]);
+		maxX = std::max(maxX, tile.boundsMax[0]);
+		maxZ = std::max(maxZ, tile.boundsMax[2]);
+		extents.push_back(std::max(tile.boundsMax[0] - tile.boundsMin[0], tile.boundsMax[2] - tile.boundsMin[2]));
+	}
+
+	if (extents.empty())
+	{
+		m_cellSize = 1.0f;
+		m_origin[0] = m_origin[1] = 0.0f;
+		m_columns = m_rows = 1;
+		m_cellOffsets.assign(2, 0);
+		m_cellTiles.clear();
+		return;
+	}
+
+	if (!(cellSize > 0.0f))
+	{
+		std::nth_element(extents.begin(), extents.begin() + extents.size() / 2, extents.end());
+		cellSize = extents[extents.size() / 2];
+	}
+	cellSize = std::max(cellSize, std::max(maxX - minX, maxZ - minZ) * 1e-6f);
+	if (!(cellSize > 0.0f))
+		cellSize = 1.0f;
+
+	// a few huge tiles and many tiny ones could ask for more cells than tiles are worth
+	for (;;)
+	{
+		m_columns = static_cast<uint32_t>(std::min(std::floor((maxX - minX) / cellSize) + 1.0f, float(GLTF_WORLD_MAX_CELLS)));
+		m_rows = static_cast<uint32_t>(std::min(std::floor((maxZ - minZ) / cellSize) + 1.0f, float(GLTF_WORLD_MAX_CELLS)));
+		if (uint64_t(m_columns) * m_rows <= GLTF_WORLD_MAX_CELLS)
+			break;
+		cellSize *= 2.0f;
+	}
+
+	m_cellSize = cellSize;
+	m_origin[0] = minX;
+	m_origin[1] = minZ;
+
+	auto forCells = [this](const SGLTFWorldTile& tile, const std::function<void(uint32_t cell)>& func)
+	{
+		const uint32_t x0 = static_cast<uint32_t>((tile.boundsMin[0] - m_origin[0]) / m_cellSize);
+		const uint32_t z0 = static_cast<uint32_t>((tile.boundsMin[2] - m_origin[1]) / m_cellSize);
+		const uint32_t x1 = std::min(static_cast<uint32_t>((tile.boundsMax[0] - m_origin[0]) / m_cellSize), m_columns - 1);
+		const uint32_t z1 = std::min(static_cast<uint32_t>((tile.boundsMax[2] - m_origin[1]) / m_cellSize), m_rows - 1);
+		for (uint32_t z = z0; z <= z1; ++z)
+			for (uint32_t x = x0; x <= x1; ++x)
+				func(z * m_columns + x);
+	};
+
+	m_cellOffsets.assign(size_t(m_columns) * m_rows + 1, 0);
+	for (const auto& tile : m_tiles)
+		if (!IsEmpty(tile))
+			forCells(tile, [this](uint32_t cell) { ++m_cellOffsets[cell + 1]; });
+
+	for (size_t c = 1; c < m_cellOffsets.size(); ++c)
+		m_cellOffsets[c] += m_cellOffsets[c - 1];
+
+	m_cellTiles.resize(m_cellOffsets.back());
+	std::vector<uint32_t> fill(m_cellOffsets.begin(), m_cellOffsets.end() - 1);
+	for (uint32_t t = 0; t < m_tiles.size(); ++t)
+		if (!IsEmpty(m_tiles[t]))
+			forCells(m_tiles[t], [&](uint32_t cell) { m_cellTiles[fill[cell]++] = t; });
+}
+
+bool EGLTF::CGLTFWorldIndex::Save(const std::string& filepath) const
+{
+	std::vector<uint8_t> out;
+	auto put = [&out](const void* data, size_t size)
+	{
+		out.insert(out.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+	};
+
+	const uint32_t head[5] = { GLTF_WORLD_MAGIC, GLTF_WORLD_VERSION, static_cast<uint32_t>(m_tiles.size()), m_columns, m_rows };
+	put(head, sizeof(head));
+	put(&m_cellSize, sizeof(m_cellSize));
+	put(m_origin, sizeof(m_origin));
+
+	for (const auto& tile : m_tiles)
+	{
+		const uint32_t pathLength = static_cast<uint32_t>(tile.filepath.size());
+		put(tile.boundsMin.data(), sizeof(float) * 3);
+		put(tile.boundsMax.data(), sizeof(float) * 3);
+		put(&tile.bytes, sizeof(tile.bytes));
+		put(&tile.fileSize, sizeof(tile.fileSize));
+		put(&tile.mtime, sizeof(tile.mtime));
+		put(&pathLength, sizeof(pathLength));
+		put(tile.filepath.data(), pathLength);
+	}
+
+	put(m_cellOffsets.data(), m_cellOffsets.size() * sizeof(uint32_t));
+	put(m_cellTiles.data(), m_cellTiles.size() * sizeof(uint32_t));
+
+	std::ofstream fh(filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fh.is_open())
+	{
+		fprintf(stderr, "\nError: could not write the world index %s\n", filepath.c_str());
+		return false;
+	}
+
+	fh.write((const char*) out.data(), out.size());
+	return fh.good();
+}
+
+bool EGLTF::CGLTFWorldIndex::Load(const std::string& filepath)
+{
+	std::vector<uint8_t> data;
+	if (!CGLTFDiskFileSystem::Get().ReadFile(filepath, data))
+		return false;
+
+	size_t pos = 0;
+	auto get = [&](void* out, size_t size)
+	{
+		if (data.size() - pos < size)
+			return false;
+		memcpy(out, data.data() + pos, size);
+		pos += size;
+		return true;
+	};
+
+	uint32_t head[5];
+	float cellSize, origin[2];
+	if (!get(head, sizeof(head)) || head[0] != GLTF_WORLD_MAGIC || head[1] != GLTF_WORLD_VERSION || !get(&cellSize, sizeof(cellSize)) ||
+		!get(origin, sizeof(origin)) || uint64_t(head[3]) * head[4] > GLTF_WORLD_MAX_CELLS || !(cellSize > 0.0f))
+	{
+		fprintf(stderr, "\nError: %s is not a world index\n", filepath.c_str());
+		return false;
+	}
+
+	std::vector<SGLTFWorldTile> tiles(head[2]);
+	for (auto& tile : tiles)
+	{
+		uint32_t pathLength;
+		if (!get(tile.boundsMin.data(), sizeof(float) * 3) || !get(tile.boundsMax.data(), sizeof(float) * 3) || !get(&tile.bytes, sizeof(tile.bytes)) ||
+			!get(&tile.fileSize, sizeof(tile.fileSize)) || !get(&tile.mtime, sizeof(tile.mtime)) || !get(&pathLength, sizeof(pathLength)) ||
+			data.size() - pos < pathLength)
+		{
+			fprintf(stderr, "\nError: world index %s is truncated\n", filepath.c_str());
+			return false;
+		}
+
+		tile.filepath.assign((const char*) data.data() + pos, pathLength);
+		pos += pathLength;
+	}
+
+	std::vector<uint32_t> offsets(size_t(head[3]) * head[4] + 1);
+	if (!get(offsets.data(), offsets.size() * sizeof(uint32_t)) || offsets[0] != 0 || !std::is_sorted(offsets.begin(), offsets.end()) ||
+		(data.size() - pos) / sizeof(uint32_t) != offsets.back())
+	{
+		fprintf(stderr, "\nError: world index %s is broken\n", filepath.c_str());
+		return false;
+	}
+
+	std::vector<uint32_t> cellTiles(offsets.back());
+	get(cellTiles.data(), cellTiles.size() * sizeof(uint32_t));
+	for (uint32_t t : cellTiles)
+	{
+		if (t >= tiles.size())
+		{
+			fprintf(stderr, "\nError: world index %s is broken\n", filepath.c_str());
+			return false;
+		}
+	}
+
+	m_tiles = std::move(tiles);
+	m_cellSize = cellSize;
+	m_origin[0] = origin[0];
+	m_origin[1] = origin[1];
+	m_columns = head[3];
+	m_rows = head[4];
+	m_cellOffsets = std::move(offsets);
+	m_cellTiles = std::move(cellTiles);
+	m_queryMarks.clear();
+	return true;
+}
+
+size_t EGLTF::CGLTFWorldIndex::CountStaleTiles() const
+{
+	IGLTFFileSystem& fileSystem = m_fileSystem ? *m_fileSystem : CGLTFDiskFileSystem::Get();
+
+	size_t stale = 0;
+	for (const auto& tile : m_tiles)
+	{
+		uint64_t size;
+		int64_t mtime;
+		if (!fileSystem.StatFile(tile.filepath, size, mtime) || size != tile.fileSize || mtime != tile.mtime)
+			++stale;
+	}
+
+	return stale;
+}
+
+float EGLTF::CGLTFWorldIndex::GetDistance(uint32_t tile, const std::array<float, 3>& position) const
+{
+	const SGLTFWorldTile& t = m_tiles[tile];
+	if (IsEmpty(t))
+		return FLT_MAX;
+
+	float squared = 0.0f;
+	for (int i = 0; i < 3; ++i)
+	{
+		const float d = std::max(std::max(t.boundsMin[i] - position[i], position[i] - t.boundsMax[i]), 0.0f);
+		squared += d * d;
+	}
+
+	return std::sqrt(squared);
+}
+
+void EGLTF::CGLTFWorldIndex::Query(const std::array<float, 3>& position, float radius, std::vector<uint32_t>& out) const
+{
+	out.clear();
+	if (m_cellTiles.empty() || !(radius >= 0.0f))
+		return;
+
+	const float fx0 = std::floor((position[0] - radius - m_origin[0]) / m_cellSize);
+	const float fz0 = std::floor((position[2] - radius - m_origin[1]) / m_cellSize);
+	const float fx1 = std::floor((position[0] + radius - m_origin[0]) / m_cellSize);
+	const float fz1 = std::floor((position[2] + radius - m_origin[1]) / m_cellSize);
+	if (fx1 < 0.0f || fz1 < 0.0f || fx0 >= float(m_columns) || fz0 >= float(m_rows))
+		return;
+
+	const uint32_t x0 = static_cast<uint32_t>(std::max(fx0, 0.0f));
+	const uint32_t z0 = static_cast<uint32_t>(std::max(fz0, 0.0f));
+	const uint32_t x1 = static_cast<uint32_t>(std::min(fx1, float(m_columns - 1)));
+	const uint32_t z1 = static_cast<uint32_t>(std::min(fz1, float(m_rows - 1)));
+
+	if (m_queryMarks.size() != m_tiles.size() || ++m_queryStamp == 0)
+	{
+		m_queryMarks.assign(m_tiles.size(), 0);
+		m_queryStamp = 1;
+	}
+
+	for (uint32_t z = z0; z <= z1; ++z)
+	{
+		for (uint32_t x = x0; x <= x1; ++x)
+		{
+			const uint32_t cell = z * m_columns + x;
+			for (uint32_t i = m_cellOffsets[cell]; i < m_cellOffsets[cell + 1]; ++i)
+			{
+				const uint32_t tile = m_cellTiles[i];
+				if (m_queryMarks[tile] == m_queryStamp)
+					continue;
+
+				m_queryMarks[tile] = m_queryStamp;
+				if (GetDistance(tile, position) <= radius)
+					out.push_back(tile);
+			}
+		}
+	}
+
+	std::sort(out.begin(), out.end());
+}
+
+static double MillisecondsSince(const std::chrono::steady_clock::time_point& epoch)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+EGLTF::CGLTFWorldStreamer::CGLTFWorldStreamer(const CGLTFWorldIndex& index, CGLTFThreadPool& pool)
+	: m_index(index), m_pool(pool), m_slots(index.GetTiles().size()), m_epoch(std::chrono::steady_clock::now())
+{
+}
+
+EGLTF::CGLTFWorldStreamer::~CGLTFWorldStreamer()
+{
+	WaitIdle();
+}
+
+float EGLTF::CGLTFWorldStreamer::GetDistance(uint32_t tile, const std::vector<std::array<float, 3>>& cameras) const
+{
+	float distance = FLT_MAX;
+	for (const auto& camera : cameras)
+		distance = std::min(distance, m_index.GetDistance(tile, camera));
+
+	return distance;
+}
+
+uint64_t EGLTF::CGLTFWorldStreamer::GetFootprint(uint32_t tile) const
+{
+	return m_slots[tile].measuredBytes > 0 ? m_slots[tile].measuredBytes : m_index.GetTiles()[tile].bytes;
+}
+
+void EGLTF::CGLTFWorldStreamer::StartLoad(uint32_t tile)
+{
+	STileSlot& slot = m_slots[tile];
+	slot.state = ETileState::LOADING;
+	slot.unwanted = false;
+	slot.bytes = GetFootprint(tile);
+	slot.easygltf.reset(new CEasyGLTF());
+	slot.easygltf->SetThreadPool(&m_pool);
+	slot.easygltf->SetFileSystem(m_index.GetFileSystem());
+
+	m_reservedBytes += slot.bytes;
+	++m_loading;
+
+	CEasyGLTF* easygltf = slot.easygltf.get();
+	const std::string& filepath = m_index.GetTiles()[tile].filepath;
+	m_pool.Submit([this, tile, easygltf, &filepath]()
+	{
+		const bool ok = LoadTile(*easygltf, filepath);
+		const uint64_t bytes = ok ? GetGLTFMemoryReport(easygltf->GetAssetInstance()).total : 0;
+
+		std::lock_guard<std::mutex> lock(m_finishedMutex);
+		m_finished.push_back({ tile, ok, bytes });
+	});
+}
+
+void EGLTF::CGLTFWorldStreamer::Unload(uint32_t tile)
+{
+	STileSlot& slot = m_slots[tile];
+	slot.state = ETileState::UNLOADED;
+	slot.easygltf.reset();
+	slot.wantedSince = -1.0;
+	m_residentBytes -= slot.bytes;
+	slot.bytes = 0;
+
+	for (size_t i = 0; i < m_resident.size(); ++i)
+	{
+		if (m_resident[i] == tile)
+		{
+			m_resident[i] = m_resident.back();
+			m_resident.pop_back();
+			m_residentDistances[i] = m_residentDistances.back();
+			m_residentDistances.pop_back();
+			break;
+		}
+	}
+}
+
+void EGLTF::CGLTFWorldStreamer::TakeFinished(double now)
+{
+	std::vector<SFinished> finished;
+	{
+		std::lock_guard<std::mutex> lock(m_finishedMutex);
+		finished.swap(m_finished);
+	}
+
+	bool overBudget = false;
+	for (const auto& f : finished)
+	{
+		STileSlot& slot = m_slots[f.tile];
+		--m_loading;
+		m_reservedBytes -= slot.bytes;
+		++m_stats.loads;
+
+		// the memory was held by the time the load finished, whatever happens to the tile now
+		if (f.ok)
+		{
+			slot.measuredBytes = f.bytes;
+			m_stats.peakBytes = std::max(m_stats.peakBytes, m_residentBytes + m_reservedBytes + f.bytes);
+			overBudget = overBudget || m_residentBytes + m_reservedBytes + f.bytes > m_options.memoryBudget;
+		}
+
+		if (!f.ok || slot.unwanted)
+		{
+			if (!f.ok)
+			{
+				++m_stats.failures;
+				slot.failed = true; // not tried again
+			}
+			else
+				++m_stats.discarded;
+
+			slot.state = ETileState::UNLOADED;
+			slot.easygltf.reset();
+			slot.bytes = 0;
+			slot.wantedSince = -1.0;
+			continue;
+		}
+
+		slot.state = ETileState::RESIDENT;
+		slot.bytes = f.bytes;
+		m_residentBytes += f.bytes;
+		m_resident.push_back(f.tile);
+		m_residentDistances.push_back(0.0f);
+
+		if (slot.wantedSince >= 0.0)
+			m_latencies.push_back(static_cast<float>(now - slot.wantedSince));
+		slot.wantedSince = -1.0;
+	}
+
+	if (overBudget)
+		++m_stats.overBudget;
+}
+
+void EGLTF::CGLTFWorldStreamer::Update(const std::vector<std::array<float, 3>>& cameras)
+{
+	const double now = MillisecondsSince(m_epoch);
+	++m_frame;
+
+	TakeFinished(now);
+
+	// out of range first, then whatever came out bigger than indexed, farthest first
+	for (size_t i = 0; i < m_resident.size();)
+	{
+		m_residentDistances[i] = GetDistance(m_resident[i], cameras);
+		if (m_residentDistances[i] > m_options.unloadRadius)
+		{
+			Unload(m_resident[i]);
+			++m_stats.unloads;
+		}
+		else
+			++i;
+	}
+
+	auto evictFarthest = [this](float beyond)
+	{
+		size_t farthest = SIZE_MAX;
+		for (size_t i = 0; i < m_resident.size(); ++i)
+			if (m_residentDistances[i] > beyond && (farthest == SIZE_MAX || m_residentDistances[i] > m_residentDistances[farthest]))
+				farthest = i;
+
+		if (farthest == SIZE_MAX)
+			return false;
+
+		Unload(m_resident[farthest]);
+		++m_stats.evictions;
+		return true;
+	};
+
+	while (m_residentBytes + m_reservedBytes > m_options.memoryBudget && evictFarthest(-1.0f))
+	{
+	}
+
+	// loads that are out of range by now get dropped once they finish
+	for (uint32_t t = 0; t < m_slots.size() && m_loading > 0; ++t)
+		if (m_slots[t].state == ETileState::LOADING)
+			m_slots[t].unwanted = GetDistance(t, cameras) > m_options.unloadRadius;
+
+	m_nearby.clear();
+	std::vector<uint32_t> found;
+	for (const auto& camera : cameras)
+	{
+		m_index.Query(camera, m_options.loadRadius, found);
+		m_nearby.insert(m_nearby.end(), found.begin(), found.end());
+	}
+	std::sort(m_nearby.begin(), m_nearby.end());
+	m_nearby.erase(std::unique(m_nearby.begin(), m_nearby.end()), m_nearby.end());
+
+	m_wanted.clear();
+	for (uint32_t tile : m_nearby)
+	{
+		STileSlot& slot = m_slots[tile];
+		if (slot.state == ETileState::RESIDENT || slot.failed)
+			continue;
+
+		// the wait counts from the first of an unbroken run of frames that wanted it
+		if (slot.wantedFrame + 1 != m_frame && slot.state == ETileState::UNLOADED)
+			slot.wantedSince = now;
+		slot.wantedFrame = m_frame;
+
+		if (slot.state == ETileState::UNLOADED)
+			m_wanted.push_back(std::make_pair(GetDistance(tile, cameras), tile));
+	}
+	std::sort(m_wanted.begin(), m_wanted.end());
+
+	const float hysteresis = std::max(m_options.unloadRadius - m_options.loadRadius, 0.0f);
+	for (const auto& wanted : m_wanted)
+	{
+		if (m_loading >= m_options.maxLoadsInFlight)
+			break;
+
+		const uint64_t bytes = GetFootprint(wanted.second);
+		if (bytes > m_options.memoryBudget)
+			continue;
+
+		// nearest first, a tile that does not fit keeps the farther ones from loading ahead of it
+		while (m_residentBytes + m_reservedBytes + bytes > m_options.memoryBudget && evictFarthest(wanted.first + hysteresis))
+		{
+		}
+		if (m_residentBytes + m_reservedBytes + bytes > m_options.memoryBudget)
+			break;
+
+		StartLoad(wanted.second);
+	}
+
+	m_stats.peakBytes = std::max(m_stats.peakBytes, m_residentBytes + m_reservedBytes);
+}
+
+const EGLTF::CEasyGLTF* EGLTF::CGLTFWorldStreamer::GetTile(uint32_t tile) const
+{
+	if (tile >= m_slots.size() || m_slots[tile].state != ETileState::RESIDENT)
+		return nullptr;
+
+	return m_slots[tile].easygltf.get();
+}
+
+void EGLTF::CGLTFWorldStreamer::WaitIdle()
+{
+	for (;;)
+	{
+		size_t finished;
+		{
+			std::lock_guard<std::mutex> lock(m_finishedMutex);
+			finished = m_finished.size();
+		}
+
+		if (finished >= m_loading)
+			break;
+
+		if (!m_pool.RunPendingTask())
+			std::this_thread::yield();
+	}
+
+	TakeFinished(MillisecondsSince(m_epoch));
+}
+
+EGLTF::SGLTFStreamingStats EGLTF::CGLTFWorldStreamer::GetStats() const
+{
+	SGLTFStreamingStats stats = m_stats;
+	stats.resident = static_cast<uint32_t>(m_resident.size());
+	stats.loading = m_loading;
+	stats.residentBytes = m_residentBytes;
+	stats.reservedBytes = m_reservedBytes;
+
+	if (!m_latencies.empty())
+	{
+		std::vector<float> sorted = m_latencies;
+		std::sort(sorted.begin(), sorted.end());
+
+		double sum = 0.0;
+		for (float latency : sorted)
+			sum += latency;
+
+		stats.averageLatencyMs = sum / sorted.size();
+		stats.p95LatencyMs = sorted[std::min(sorted.size() - 1, sorted.size() * 95 / 100)];
+		stats.maxLatencyMs = sorted.back();
+	}
+
+	return stats;
+}
@@ -0,0 +1,1120 @@
+// Copyright (C) 2020 livvv2k <ml.smiley3@gmail.com>
+//
+// This file is part of EasyGLTF.
+//
+// EasyGLTF is free software : you can redistribute itand /or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// EasyGLTF is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
+
+// Writes synthetic, but valid, .gltf/.glb files of whatever size is needed for scaling tests.
+// The output only depends on the options and the seed, so the same command line always gives byte identical files.
+//
+// usage: easygltf_generator --out big.glb [options]
+//   --seed N             (default 1)
+//   --nodes N            number of nodes (default 100)
+//   --hierarchy TYPE     wide | deep | tree (default wide)
+//   --branching N        children per node for tree hierarchies (default 4)
+//   --meshes N           (default 10)
+//   --primitives N       primitives per mesh (default 1)
+//   --vertices N         vertices per primitive, rounded to a grid (default 1024)
+//   --targets N          morph targets per primitive (default 0)
+//   --animations N       (default 0)
+//   --channels N         channels per animation (default 4)
+//   --keyframes N        keyframes per channel (default 60)
+//   --materials N        (default 4)
+//   --images N           (default 0)
+//   --image-size N       width and height of the generated images in pixels (default 64)
+//   --cameras N          cameras on the last N nodes, perspective without a far plane, orthographic and perspective in turn (default 0)
+//   --embedded           base64 encode buffers and images into the .gltf instead of writing external files
+//   --origin X Y Z       where the root node goes (default 0 0 0), to lay out the tiles of a world
+//   --hole GB            leaves a hole of that many GiB at the start of the external .bin and puts the data after it, sparse on
+//                        file systems that have sparse files. Gives offsets past 4 GB without needing the disk space.
+//
+// The buffer data is streamed to disk for external .bin files and .glb files, so the asset size is not bound by memory.
+// Embedded assets are built in memory.
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+#include "base64.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct SGeneratorConfig
+{
+	std::string out;
+	uint64_t seed = 1;
+	uint32_t nodes = 100;
+	std::string hierarchy = "wide";
+	uint32_t branching = 4;
+	uint32_t meshes = 10;
+	uint32_t primitives = 1;
+	uint32_t vertices = 1024;
+	uint32_t targets = 0;
+	uint32_t animations = 0;
+	uint32_t channels = 4;
+	uint32_t keyframes = 60;
+	uint32_t materials = 4;
+	uint32_t images = 0;
+	uint32_t imageSize = 64;
+	uint32_t cameras = 0;
+	bool embedded = false;
+	bool glb = false;
+	float origin[3] = { 0.0f, 0.0f, 0.0f };
+	uint64_t hole = 0; // bytes
+};
+
+// splitmix64, its output is fully specified unlike the std distributions, so files are identical across platforms
+class CRandom
+{
+public:
+	explicit CRandom(uint64_t seed) : m_state(seed) {}
+
+	uint64_t Next()
+	{
+		uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	// [0, 1)
+	float NextFloat() { return (Next() >> 40) * (1.0f / 16777216.0f); }
+
+	// [lo, hi]
+	float Range(float lo, float hi) { return lo + (hi - lo) * NextFloat(); }
+
+private:
+	uint64_t m_state;
+};
+
+static uint64_t SeedFor(uint64_t seed, uint64_t stream)
+{
+	CRandom rng(seed ^ (stream * 0xD1B54A32D192ED03ULL));
+	return rng.Next();
+}
+
+static const float GRID_SPACING = 0.1f;
+static const float HEIGHT_AMPLITUDE = 0.05f;
+static const float MORPH_AMPLITUDE = 0.02f;
+static const float KEYFRAME_RATE = 30.0f;
+
+enum class EBlockType
+{
+	INDICES,
+	POSITION,
+	NORMAL,
+	TEXCOORD,
+	TARGET_POSITION,
+	ANIM_INPUT,
+	ANIM_OUTPUT,
+	IMAGE
+};
+
+// One bufferView worth of data
+struct SBlock
+{
+	EBlockType type;
+	uint32_t owner; // primitive, animation or image index
+	uint32_t sub; // target or channel index
+	uint64_t byteOffset;
+	uint64_t byteLength;
+};
+
+struct SPrimitivePlan
+{
+	uint32_t gridW;
+	uint32_t gridH;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	bool wideIndices;
+	uint32_t firstAccessor; // indices, POSITION, NORMAL, TEXCOORD_0, targets...
+};
+
+struct SPlan
+{
+	std::vector<SPrimitivePlan> primitives;
+	std::vector<SBlock> blocks; // blocks that are not images map 1:1 to accessors
+	std::vector<uint32_t> animationFirstAccessor; // input, then one output per channel
+	std::vector<uint32_t> imageBlocks; // only for glb
+	std::vector<std::vector<uint8_t>> images; // encoded PNGs
+	uint64_t hole = 0; // bytes before the first block, never written
+	uint64_t binLength = 0;
+};
+
+static uint64_t Align4(uint64_t val)
+{
+	return (val + 3) & ~3ULL;
+}
+
+static uint32_t AddBlock(SPlan& plan, EBlockType type, uint32_t owner, uint32_t sub, uint64_t byteLength)
+{
+	SBlock block;
+	block.type = type;
+	block.owner = owner;
+	block.sub = sub;
+	block.byteOffset = Align4(plan.binLength);
+	block.byteLength = byteLength;
+	plan.binLength = block.byteOffset + byteLength;
+	plan.blocks.push_back(block);
+	return static_cast<uint32_t>(plan.blocks.size() - 1);
+}
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+	static uint32_t table[256] = {};
+	if (table[1] == 0)
+	{
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void PutBE32(std::vector<uint8_t>& out, uint32_t val)
+{
+	out.push_back(static_cast<uint8_t>(val >> 24));
+	out.push_back(static_cast<uint8_t>(val >> 16));
+	out.push_back(static_cast<uint8_t>(val >> 8));
+	out.push_back(static_cast<uint8_t>(val));
+}
+
+static void PutPNGChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+	PutBE32(out, static_cast<uint32_t>(data.size()));
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	PutBE32(out, Crc32(out.data() + start, out.size() - start));
+}
+
+// RGBA8 PNG using uncompressed (stored) deflate blocks, its still a perfectly valid PNG
+static std::vector<uint8_t> MakePNG(uint32_t size, CRandom& rng)
+{
+	std::vector<uint8_t> raw;
+	raw.reserve(static_cast<size_t>(size) * (size * 4 + 1));
+	const uint8_t base[3] = { static_cast<uint8_t>(rng.Next()), static_cast<uint8_t>(rng.Next()), static_cast<uint8_t>(rng.Next()) };
+	for (uint32_t y = 0; y < size; ++y)
+	{
+		raw.push_back(0); // no filter
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			const uint8_t noise = static_cast<uint8_t>(rng.Next() & 0x1F);
+			raw.push_back(base[0] ^ noise);
+			raw.push_back(base[1] ^ noise);
+			raw.push_back(base[2] ^ noise);
+			raw.push_back(0xFF);
+		}
+	}
+
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	for (size_t pos = 0;;)
+	{
+		const size_t len = std::min<size_t>(raw.size() - pos, 0xFFFF);
+		const bool last = pos + len >= raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(len & 0xFF));
+		zlib.push_back(static_cast<uint8_t>(len >> 8));
+		zlib.push_back(static_cast<uint8_t>(~len & 0xFF));
+		zlib.push_back(static_cast<uint8_t>((~len >> 8) & 0xFF));
+		zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+		pos += len;
+		if (last)
+			break;
+	}
+
+	uint32_t a = 1, b = 0;
+	for (uint8_t v : raw)
+	{
+		a = (a + v) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBE32(zlib, (b << 16) | a);
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+	std::vector<uint8_t> ihdr;
+	PutBE32(ihdr, size);
+	PutBE32(ihdr, size);
+	ihdr.push_back(8); // bit depth
+	ihdr.push_back(6); // RGBA
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+
+	PutPNGChunk(png, "IHDR", ihdr);
+	PutPNGChunk(png, "IDAT", zlib);
+	PutPNGChunk(png, "IEND", std::vector<uint8_t>());
+	return png;
+}
+
+static SPlan MakePlan(const SGeneratorConfig& config)
+{
+	SPlan plan;
+	plan.hole = config.hole;
+	plan.binLength = config.hole;
+
+	const uint32_t primitiveCount = config.meshes * config.primitives;
+	plan.primitives.reserve(primitiveCount);
+
+	for (uint32_t i = 0; i < primitiveCount; ++i)
+	{
+		SPrimitivePlan prim;
+		prim.gridW = std::max<uint32_t>(2, static_cast<uint32_t>(std::sqrt(static_cast<double>(config.vertices))));
+		prim.gridH = std::max<uint32_t>(2, config.vertices / prim.gridW);
+		prim.vertexCount = prim.gridW * prim.gridH;
+		prim.indexCount = (prim.gridW - 1) * (prim.gridH - 1) * 6;
+		prim.wideIndices = prim.vertexCount > 0xFFFF;
+		prim.firstAccessor = static_cast<uint32_t>(plan.blocks.size());
+
+		AddBlock(plan, EBlockType::INDICES, i, 0, static_cast<uint64_t>(prim.indexCount) * (prim.wideIndices ? 4 : 2));
+		AddBlock(plan, EBlockType::POSITION, i, 0, static_cast<uint64_t>(prim.vertexCount) * 12);
+		AddBlock(plan, EBlockType::NORMAL, i, 0, static_cast<uint64_t>(prim.vertexCount) * 12);
+		AddBlock(plan, EBlockType::TEXCOORD, i, 0, static_cast<uint64_t>(prim.vertexCount) * 8);
+		for (uint32_t t = 0; t < config.targets; ++t)
+			AddBlock(plan, EBlockType::TARGET_POSITION, i, t, static_cast<uint64_t>(prim.vertexCount) * 12);
+
+		plan.primitives.push_back(prim);
+	}
+
+	const uint32_t keyframes = std::max<uint32_t>(config.keyframes, 1);
+	for (uint32_t a = 0; a < config.animations; ++a)
+	{
+		plan.animationFirstAccessor.push_back(static_cast<uint32_t>(plan.blocks.size()));
+		AddBlock(plan, EBlockType::ANIM_INPUT, a, 0, static_cast<uint64_t>(keyframes) * 4);
+		for (uint32_t c = 0; c < config.channels; ++c)
+			AddBlock(plan, EBlockType::ANIM_OUTPUT, a, c, static_cast<uint64_t>(keyframes) * 12);
+	}
+
+	for (uint32_t i = 0; i < config.images; ++i)
+	{
+		CRandom rng(SeedFor(config.seed, 0xFFFF0000ULL + i));
+		plan.images.push_back(MakePNG(config.imageSize, rng));
+
+		if (config.glb)
+			plan.imageBlocks.push_back(AddBlock(plan, EBlockType::IMAGE, i, 0, plan.images.back().size()));
+	}
+
+	return plan;
+}
+
+// Streams the contents of the BIN buffer, the sink gets called with chunks in file order
+static void GenerateBinary(const SGeneratorConfig& config, const SPlan& plan, const std::function<void(const uint8_t*, size_t)>& sink)
+{
+	std::vector<uint8_t> chunk;
+	chunk.reserve(1 << 16);
+
+	uint64_t written = plan.hole; // the sink skipped it
+	auto flush = [&]()
+	{
+		sink(chunk.data(), chunk.size());
+		written += chunk.size();
+		chunk.clear();
+	};
+	auto put = [&](const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		chunk.insert(chunk.end(), bytes, bytes + size);
+		if (chunk.size() >= (1 << 16))
+			flush();
+	};
+
+	for (size_t b = 0; b < plan.blocks.size(); ++b)
+	{
+		const SBlock& block = plan.blocks[b];
+		static const uint8_t zeros[4] = {};
+		put(zeros, static_cast<size_t>(block.byteOffset - (written + chunk.size())));
+
+		CRandom rng(SeedFor(config.seed, b));
+
+		switch (block.type)
+		{
+		case EBlockType::INDICES:
+		{
+			const SPrimitivePlan& prim = plan.primitives[block.owner];
+			for (uint32_t y = 0; y + 1 < prim.gridH; ++y)
+			{
+				for (uint32_t x = 0; x + 1 < prim.gridW; ++x)
+				{
+					const uint32_t i0 = y * prim.gridW + x;
+					const uint32_t quad[6] = { i0, i0 + prim.gridW, i0 + 1, i0 + 1, i0 + prim.gridW, i0 + prim.gridW + 1 };
+					for (uint32_t idx : quad)
+					{
+						if (prim.wideIndices)
+							put(&idx, 4);
+						else
+						{
+							uint16_t idx16 = static_cast<uint16_t>(idx);
+							put(&idx16, 2);
+						}
+					}
+				}
+			}
+			break;
+		}
+		case EBlockType::POSITION:
+		{
+			const SPrimitivePlan& prim = plan.primitives[block.owner];
+			for (uint32_t v = 0; v < prim.vertexCount; ++v)
+			{
+				// the first two vertices pin the height range so min/max are exact without a second pass
+				float height = v == 0 ? -HEIGHT_AMPLITUDE : v == 1 ? HEIGHT_AMPLITUDE : rng.Range(-HEIGHT_AMPLITUDE, HEIGHT_AMPLITUDE);
+				float pos[3] = { (v % prim.gridW) * GRID_SPACING, height, (v / prim.gridW) * GRID_SPACING };
+				put(pos, sizeof(pos));
+			}
+			break;
+		}
+		case EBlockType::NORMAL:
+		{
+			const SPrimitivePlan& prim = plan.primitives[block.owner];
+			const float normal[3] = { 0.0f, 1.0f, 0.0f };
+			for (uint32_t v = 0; v < prim.vertexCount; ++v)
+				put(normal, sizeof(normal));
+			break;
+		}
+		case EBlockType::TEXCOORD:
+		{
+			const SPrimitivePlan& prim = plan.primitives[block.owner];
+			for (uint32_t v = 0; v < prim.vertexCount; ++v)
+			{
+				float uv[2] = { static_cast<float>(v % prim.gridW) / (prim.gridW - 1), static_cast<float>(v / prim.gridW) / (prim.gridH - 1) };
+				put(uv, sizeof(uv));
+			}
+			break;
+		}
+		case EBlockType::TARGET_POSITION:
+		{
+			const SPrimitivePlan& prim = plan.primitives[block.owner];
+			for (uint32_t v = 0; v < prim.vertexCount; ++v)
+			{
+				float delta[3] = { 0.0f, v == 0 ? -MORPH_AMPLITUDE : v == 1 ? MORPH_AMPLITUDE : rng.Range(-MORPH_AMPLITUDE, MORPH_AMPLITUDE), 0.0f };
+				put(delta, sizeof(delta));
+			}
+			break;
+		}
+		case EBlockType::ANIM_INPUT:
+		{
+			for (uint64_t k = 0; k < block.byteLength / 4; ++k)
+			{
+				float t = k / KEYFRAME_RATE;
+				put(&t, 4);
+			}
+			break;
+		}
+		case EBlockType::ANIM_OUTPUT:
+		{
+			for (uint64_t k = 0; k < block.byteLength / 12; ++k)
+			{
+				float translation[3] = { rng.Range(-1.0f, 1.0f), rng.Range(-1.0f, 1.0f), rng.Range(-1.0f, 1.0f) };
+				put(translation, sizeof(translation));
+			}
+			break;
+		}
+		case EBlockType::IMAGE:
+		{
+			put(plan.images[block.owner].data(), plan.images[block.owner].size());
+			break;
+		}
+		}
+	}
+
+	flush();
+}
+
+typedef rapidjson::Writer<rapidjson::StringBuffer> TWriter;
+
+static void WriteFloatArray(TWriter& writer, const float* values, size_t count)
+{
+	writer.StartArray();
+	for (size_t i = 0; i < count; ++i)
+		writer.Double(values[i]);
+	writer.EndArray();
+}
+
+static void WriteAccessor(TWriter& writer, uint32_t bufferView, int32_t componentType, uint32_t count, const char* type, const float* min = nullptr, const float* max = nullptr, size_t minMaxCount = 0)
+{
+	writer.StartObject();
+	writer.Key("bufferView");
+	writer.Uint(bufferView);
+	writer.Key("componentType");
+	writer.Int(componentType);
+	writer.Key("count");
+	writer.Uint(count);
+	writer.Key("type");
+	writer.String(type);
+	if (min && max)
+	{
+		writer.Key("min");
+		WriteFloatArray(writer, min, minMaxCount);
+		writer.Key("max");
+		WriteFloatArray(writer, max, minMaxCount);
+	}
+	writer.EndObject();
+}
+
+static std::string FileStem(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static std::string Directory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static void WriteJson(const SGeneratorConfig& config, const SPlan& plan, const std::string& bufferUri, TWriter& writer)
+{
+	writer.StartObject();
+
+	writer.Key("asset");
+	writer.StartObject();
+	writer.Key("version");
+	writer.String("2.0");
+	writer.Key("generator");
+	writer.String("easygltf_generator");
+	writer.EndObject();
+
+	// nodes
+	writer.Key("scene");
+	writer.Int(0);
+	writer.Key("scenes");
+	writer.StartArray();
+	writer.StartObject();
+	writer.Key("nodes");
+	writer.StartArray();
+	if (config.nodes > 0)
+		writer.Uint(0);
+	writer.EndArray();
+	writer.EndObject();
+	writer.EndArray();
+
+	CRandom nodeRng(SeedFor(config.seed, 0xAAAA0000ULL));
+
+	writer.Key("nodes");
+	writer.StartArray();
+	for (uint32_t i = 0; i < config.nodes; ++i)
+	{
+		writer.StartObject();
+
+		writer.Key("children");
+		writer.StartArray();
+		if (config.hierarchy == "deep")
+		{
+			if (i + 1 < config.nodes)
+				writer.Uint(i + 1);
+		}
+		else if (config.hierarchy == "tree")
+		{
+			const uint64_t first = static_cast<uint64_t>(i) * config.branching + 1;
+			for (uint64_t c = first; c < first + config.branching && c < config.nodes; ++c)
+				writer.Uint(static_cast<uint32_t>(c));
+		}
+		else if (i == 0)
+		{
+			for (uint32_t c = 1; c < config.nodes; ++c)
+				writer.Uint(c);
+		}
+		writer.EndArray();
+
+		float translation[3] = { nodeRng.Range(-10.0f, 10.0f), nodeRng.Range(-10.0f, 10.0f), nodeRng.Range(-10.0f, 10.0f) };
+		if (i == 0)
+			for (int k = 0; k < 3; ++k)
+				translation[k] += config.origin[k];
+		float rotation[4] = { nodeRng.Range(-1.0f, 1.0f), nodeRng.Range(-1.0f, 1.0f), nodeRng.Range(-1.0f, 1.0f), nodeRng.Range(0.1f, 1.0f) };
+		const float len = std::sqrt(rotation[0] * rotation[0] + rotation[1] * rotation[1] + rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+		for (float& v : rotation)
+			v /= len;
+		const float s = nodeRng.Range(0.5f, 2.0f);
+		const float scale[3] = { s, s, s };
+
+		writer.Key("translation");
+		WriteFloatArray(writer, translation, 3);
+		writer.Key("rotation");
+		WriteFloatArray(writer, rotation, 4);
+		writer.Key("scale");
+		WriteFloatArray(writer, scale, 3);
+
+		// the root is only a transform, everything else instances one of the meshes
+		if (i > 0 && config.meshes > 0)
+		{
+			writer.Key("mesh");
+			writer.Uint((i - 1) % config.meshes);
+		}
+
+		if (i > 0 && i + config.cameras >= config.nodes)
+		{
+			writer.Key("camera");
+			writer.Uint(config.nodes - 1 - i);
+		}
+
+		char name[32];
+		snprintf(name, sizeof(name), "node_%u", i);
+		writer.Key("name");
+		writer.String(name);
+
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	// meshes
+	writer.Key("meshes");
+	writer.StartArray();
+	for (uint32_t m = 0; m < config.meshes; ++m)
+	{
+		writer.StartObject();
+
+		char name[32];
+		snprintf(name, sizeof(name), "mesh_%u", m);
+		writer.Key("name");
+		writer.String(name);
+
+		writer.Key("primitives");
+		writer.StartArray();
+		for (uint32_t p = 0; p < config.primitives; ++p)
+		{
+			const uint32_t index = m * config.primitives + p;
+			const SPrimitivePlan& prim = plan.primitives[index];
+
+			writer.StartObject();
+			writer.Key("mode");
+			writer.Int(4);
+			writer.Key("indices");
+			writer.Uint(prim.firstAccessor);
+			if (config.materials > 0)
+			{
+				writer.Key("material");
+				writer.Uint(index % config.materials);
+			}
+			writer.Key("attributes");
+			writer.StartObject();
+			writer.Key("POSITION");
+			writer.Uint(prim.firstAccessor + 1);
+			writer.Key("NORMAL");
+			writer.Uint(prim.firstAccessor + 2);
+			writer.Key("TEXCOORD_0");
+			writer.Uint(prim.firstAccessor + 3);
+			writer.EndObject();
+
+			if (config.targets > 0)
+			{
+				writer.Key("targets");
+				writer.StartArray();
+				for (uint32_t t = 0; t < config.targets; ++t)
+				{
+					writer.StartObject();
+					writer.Key("POSITION");
+					writer.Uint(prim.firstAccessor + 4 + t);
+					writer.EndObject();
+				}
+				writer.EndArray();
+			}
+			writer.EndObject();
+		}
+		writer.EndArray();
+
+		if (config.targets > 0)
+		{
+			writer.Key("weights");
+			writer.StartArray();
+			for (uint32_t t = 0; t < config.targets; ++t)
+				writer.Double(0.0);
+			writer.EndArray();
+		}
+
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	// accessors, one per block apart from images, in block order
+	writer.Key("accessors");
+	writer.StartArray();
+	for (uint32_t b = 0; b < plan.blocks.size(); ++b)
+	{
+		const SBlock& block = plan.blocks[b];
+		switch (block.type)
+		{
+		case EBlockType::INDICES:
+		{
+			const SPrimitivePlan& prim = plan.primitives[block.owner];
+			WriteAccessor(writer, b, prim.wideIndices ? 5125 : 5123, prim.indexCount, "SCALAR");
+			break;
+		}
+		case EBlockType::POSITION:
+		{
+			const SPrimitivePlan& prim = plan.primitives[block.owner];
+			const float min[3] = { 0.0f, -HEIGHT_AMPLITUDE, 0.0f };
+			const float max[3] = { (prim.gridW - 1) * GRID_SPACING, HEIGHT_AMPLITUDE, (prim.gridH - 1) * GRID_SPACING };
+			WriteAccessor(writer, b, 5126, prim.vertexCount, "VEC3", min, max, 3);
+			break;
+		}
+		case EBlockType::NORMAL:
+			WriteAccessor(writer, b, 5126, plan.primitives[block.owner].vertexCount, "VEC3");
+			break;
+		case EBlockType::TEXCOORD:
+			WriteAccessor(writer, b, 5126, plan.primitives[block.owner].vertexCount, "VEC2");
+			break;
+		case EBlockType::TARGET_POSITION:
+		{
+			const float min[3] = { 0.0f, -MORPH_AMPLITUDE, 0.0f };
+			const float max[3] = { 0.0f, MORPH_AMPLITUDE, 0.0f };
+			WriteAccessor(writer, b, 5126, plan.primitives[block.owner].vertexCount, "VEC3", min, max, 3);
+			break;
+		}
+		case EBlockType::ANIM_INPUT:
+		{
+			const uint32_t count = static_cast<uint32_t>(block.byteLength / 4);
+			const float min[1] = { 0.0f };
+			const float max[1] = { (count - 1) / KEYFRAME_RATE };
+			WriteAccessor(writer, b, 5126, count, "SCALAR", min, max, 1);
+			break;
+		}
+		case EBlockType::ANIM_OUTPUT:
+			WriteAccessor(writer, b, 5126, static_cast<uint32_t>(block.byteLength / 12), "VEC3");
+			break;
+		case EBlockType::IMAGE:
+			break;
+		}
+	}
+	writer.EndArray();
+
+	writer.Key("bufferViews");
+	writer.StartArray();
+	for (const SBlock& block : plan.blocks)
+	{
+		writer.StartObject();
+		writer.Key("buffer");
+		writer.Int(0);
+		writer.Key("byteOffset");
+		writer.Uint64(block.byteOffset);
+		writer.Key("byteLength");
+		writer.Uint64(block.byteLength);
+		if (block.type == EBlockType::INDICES)
+		{
+			writer.Key("target");
+			writer.Int(34963);
+		}
+		else if (block.type != EBlockType::IMAGE && block.type != EBlockType::ANIM_INPUT && block.type != EBlockType::ANIM_OUTPUT)
+		{
+			writer.Key("target");
+			writer.Int(34962);
+		}
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.Key("buffers");
+	writer.StartArray();
+	writer.StartObject();
+	writer.Key("byteLength");
+	writer.Uint64(plan.binLength);
+	if (!bufferUri.empty())
+	{
+		writer.Key("uri");
+		writer.String(bufferUri.c_str());
+	}
+	writer.EndObject();
+	writer.EndArray();
+
+	// cameras
+	if (config.cameras > 0)
+	{
+		writer.Key("cameras");
+		writer.StartArray();
+		for (uint32_t c = 0; c < config.cameras; ++c)
+		{
+			writer.StartObject();
+			const bool orthographic = c % 3 == 1;
+			writer.Key("type");
+			writer.String(orthographic ? "orthographic" : "perspective");
+			writer.Key(orthographic ? "orthographic" : "perspective");
+			writer.StartObject();
+			if (orthographic)
+			{
+				writer.Key("xmag");
+				writer.Double(20.0);
+				writer.Key("ymag");
+				writer.Double(20.0);
+				writer.Key("znear");
+				writer.Double(0.0);
+				writer.Key("zfar");
+				writer.Double(100.5);
+			}
+			else
+			{
+				writer.Key("yfov");
+				writer.Double(0.8);
+				writer.Key("znear");
+				writer.Double(0.05);
+				// a far plane that isn't a whole number, the first one has none
+				if (c > 0)
+				{
+					writer.Key("zfar");
+					writer.Double(250.75);
+				}
+			}
+			writer.EndObject();
+			writer.EndObject();
+		}
+		writer.EndArray();
+	}
+
+	// materials
+	CRandom materialRng(SeedFor(config.seed, 0xBBBB0000ULL));
+	writer.Key("materials");
+	writer.StartArray();
+	for (uint32_t m = 0; m < config.materials; ++m)
+	{
+		writer.StartObject();
+
+		char name[32];
+		snprintf(name, sizeof(name), "material_%u", m);
+		writer.Key("name");
+		writer.String(name);
+
+		writer.Key("pbrMetallicRoughness");
+		writer.StartObject();
+		const float color[4] = { materialRng.NextFloat(), materialRng.NextFloat(), materialRng.NextFloat(), 1.0f };
+		writer.Key("baseColorFactor");
+		WriteFloatArray(writer, color, 4);
+		writer.Key("metallicFactor");
+		writer.Double(materialRng.NextFloat());
+		writer.Key("roughnessFactor");
+		writer.Double(materialRng.NextFloat());
+		if (config.images > 0)
+		{
+			writer.Key("baseColorTexture");
+			writer.StartObject();
+			writer.Key("index");
+			writer.Uint(m % config.images);
+			writer.EndObject();
+		}
+		writer.EndObject();
+
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	if (config.images > 0)
+	{
+		writer.Key("samplers");
+		writer.StartArray();
+		writer.StartObject();
+		writer.Key("magFilter");
+		writer.Int(9729);
+		writer.Key("minFilter");
+		writer.Int(9987);
+		writer.Key("wrapS");
+		writer.Int(10497);
+		writer.Key("wrapT");
+		writer.Int(10497);
+		writer.EndObject();
+		writer.EndArray();
+
+		writer.Key("textures");
+		writer.StartArray();
+		for (uint32_t i = 0; i < config.images; ++i)
+		{
+			writer.StartObject();
+			writer.Key("sampler");
+			writer.Int(0);
+			writer.Key("source");
+			writer.Uint(i);
+			writer.EndObject();
+		}
+		writer.EndArray();
+
+		writer.Key("images");
+		writer.StartArray();
+		for (uint32_t i = 0; i < config.images; ++i)
+		{
+			writer.StartObject();
+			if (config.glb)
+			{
+				writer.Key("bufferView");
+				writer.Uint(plan.imageBlocks[i]);
+				writer.Key("mimeType");
+				writer.String("image/png");
+			}
+			else if (config.embedded)
+			{
+				const std::string png(plan.images[i].begin(), plan.images[i].end());
+				std::string uri = "data:image/png;base64," + macaron::Base64::Encode(png);
+				writer.Key("uri");
+				writer.String(uri.c_str(), static_cast<rapidjson::SizeType>(uri.size()));
+			}
+			else
+			{
+				char uri[64];
+				snprintf(uri, sizeof(uri), "%s_image%u.png", FileStem(config.out).c_str(), i);
+				writer.Key("uri");
+				writer.String(uri);
+			}
+			writer.EndObject();
+		}
+		writer.EndArray();
+	}
+
+	// animations
+	if (config.animations > 0)
+	{
+		writer.Key("animations");
+		writer.StartArray();
+		for (uint32_t a = 0; a < config.animations; ++a)
+		{
+			const uint32_t first = plan.animationFirstAccessor[a];
+
+			writer.StartObject();
+			writer.Key("channels");
+			writer.StartArray();
+			for (uint32_t c = 0; c < config.channels; ++c)
+			{
+				writer.StartObject();
+				writer.Key("sampler");
+				writer.Uint(c);
+				writer.Key("target");
+				writer.StartObject();
+				writer.Key("node");
+				writer.Uint(config.nodes > 0 ? (a * config.channels + c) % config.nodes : 0);
+				writer.Key("path");
+				writer.String("translation");
+				writer.EndObject();
+				writer.EndObject();
+			}
+			writer.EndArray();
+
+			writer.Key("samplers");
+			writer.StartArray();
+			for (uint32_t c = 0; c < config.channels; ++c)
+			{
+				writer.StartObject();
+				writer.Key("input");
+				writer.Uint(first);
+				writer.Key("output");
+				writer.Uint(first + 1 + c);
+				writer.Key("interpolation");
+				writer.String("LINEAR");
+				writer.EndObject();
+			}
+			writer.EndArray();
+			writer.EndObject();
+		}
+		writer.EndArray();
+	}
+
+	writer.EndObject();
+}
+
+static bool WriteGLB(const SGeneratorConfig& config, const SPlan& plan)
+{
+	rapidjson::StringBuffer json;
+	TWriter writer(json);
+	WriteJson(config, plan, std::string(), writer);
+
+	const uint64_t jsonLength = Align4(json.GetSize());
+	const uint64_t binLength = Align4(plan.binLength);
+	const uint64_t total = 12 + 8 + jsonLength + 8 + binLength;
+
+	if (total > 0xFFFFFFFFULL)
+	{
+		fprintf(stderr, "A glb file cannot be larger than 4GB (this one would be %llu bytes), use a .gltf with an external buffer instead\n", (unsigned long long) total);
+		return false;
+	}
+
+	std::ofstream fh(config.out, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fh.is_open())
+		return false;
+
+	auto putU32 = [&](uint32_t val) { fh.write((const char*) &val, 4); };
+
+	putU32(0x46546C67); // "glTF"
+	putU32(2);
+	putU32(static_cast<uint32_t>(total));
+
+	putU32(static_cast<uint32_t>(jsonLength));
+	putU32(0x4E4F534A); // JSON
+	fh.write(json.GetString(), json.GetSize());
+	for (uint64_t i = json.GetSize(); i < jsonLength; ++i)
+		fh.put(' ');
+
+	putU32(static_cast<uint32_t>(binLength));
+	putU32(0x004E4942); // BIN
+	GenerateBinary(config, plan, [&](const uint8_t* data, size_t size) { fh.write((const char*) data, size); });
+	for (uint64_t i = plan.binLength; i < binLength; ++i)
+		fh.put('\0');
+
+	return fh.good();
+}
+
+static bool WriteGLTF(const SGeneratorConfig& config, const SPlan& plan)
+{
+	std::string bufferUri;
+
+	if (config.embedded)
+	{
+		std::string bin;
+		bin.reserve(static_cast<size_t>(plan.binLength));
+		GenerateBinary(config, plan, [&](const uint8_t* data, size_t size) { bin.append((const char*) data, size); });
+		bufferUri = "data:application/octet-stream;base64," + macaron::Base64::Encode(bin);
+	}
+	else
+	{
+		bufferUri = FileStem(config.out) + ".bin";
+
+		std::ofstream bin(Directory(config.out) + bufferUri, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!bin.is_open())
+			return false;
+		// seeking past the end leaves a hole the file system does not have to store
+		bin.seekp(static_cast<std::streamoff>(plan.hole));
+		GenerateBinary(config, plan, [&](const uint8_t* data, size_t size) { bin.write((const char*) data, size); });
+		if (!bin.good())
+			return false;
+
+		for (uint32_t i = 0; i < config.images; ++i)
+		{
+			char uri[64];
+			snprintf(uri, sizeof(uri), "%s_image%u.png", FileStem(config.out).c_str(), i);
+			std::ofstream image(Directory(config.out) + uri, std::ios::out | std::ios::binary | std::ios::trunc);
+			image.write((const char*) plan.images[i].data(), plan.images[i].size());
+		}
+	}
+
+	rapidjson::StringBuffer json;
+	TWriter writer(json);
+	WriteJson(config, plan, bufferUri, writer);
+
+	std::ofstream fh(config.out, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fh.is_open())
+		return false;
+	fh.write(json.GetString(), json.GetSize());
+
+	return fh.good();
+}
+
+static bool ParseArgs(int argc, char** argv, SGeneratorConfig& config)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--embedded")
+			config.embedded = true;
+		else if (arg == "--origin" && i + 3 < argc)
+		{
+			for (int k = 0; k < 3; ++k)
+				config.origin[k] = static_cast<float>(atof(argv[++i]));
+		}
+		else if (!hasValue)
+			return false;
+		else if (arg == "--out")
+			config.out = argv[++i];
+		else if (arg == "--seed")
+			config.seed = strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--nodes")
+			config.nodes = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--hierarchy")
+			config.hierarchy = argv[++i];
+		else if (arg == "--branching")
+			config.branching = std::max<uint32_t>(1, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+		else if (arg == "--meshes")
+			config.meshes = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--primitives")
+			config.primitives = std::max<uint32_t>(1, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+		else if (arg == "--vertices")
+			config.vertices = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--targets")
+			config.targets = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--animations")
+			config.animations = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--channels")
+			config.channels = std::max<uint32_t>(1, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+		else if (arg == "--keyframes")
+			config.keyframes = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--materials")
+			config.materials = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--images")
+			config.images = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--image-size")
+			config.imageSize = std::max<uint32_t>(1, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+		else if (arg == "--cameras")
+			config.cameras = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--hole")
+			config.hole = static_cast<uint64_t>(atof(argv[++i]) * 1024.0 * 1024.0 * 1024.0) & ~3ULL;
+		else
+			return false;
+	}
+
+	if (config.out.empty())
+		return false;
+
+	// the root has no camera
+	config.cameras = std::min(config.cameras, config.nodes > 0 ? config.nodes - 1 : 0);
+
+	if (config.hierarchy != "wide" && config.hierarchy != "deep" && config.hierarchy != "tree")
+		return false;
+
+	const std::string ext = config.out.size() > 4 ? config.out.substr(config.out.size() - 4) : std::string();
+	config.glb = ext == ".glb";
+
+	// only an external .bin can have a hole
+	if (config.hole > 0 && (config.glb || config.embedded))
+		return false;
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	SGeneratorConfig config;
+	if (!ParseArgs(argc, argv, config))
+	{
+		fprintf(stderr, "usage: easygltf_generator --out <file.gltf|file.glb> [--seed N] [--nodes N] [--hierarchy wide|deep|tree] [--branching N]\n"
+			"  [--meshes N] [--primitives N] [--vertices N] [--targets N] [--animations N] [--channels N] [--keyframes N]\n"
+			"  [--materials N] [--images N] [--image-size N] [--cameras N] [--embedded] [--origin X Y Z] [--hole GB]\n");
+		return 1;
+	}
+
+	SPlan plan = MakePlan(config);
+
+	const bool ok = config.glb ? WriteGLB(config, plan) : WriteGLTF(config, plan);
+	if (!ok)
+	{
+		fprintf(stderr, "Failed to write %s\n", config.out.c_str());
+		return 1;
+	}
+
+	printf("%s: %u nodes, %u meshes, %zu primitives, %zu accessors, %u images, %llu buffer bytes\n", config.out.c_str(), config.nodes,
+		config.meshes, plan.primitives.size(), plan.blocks.size() - plan.imageBlocks.size(), config.images, (unsigned long long) plan.binLength);
+
+	return 0;
+}
@@ -16,15 +16,1344 @@
 // along with EasyGLTF.If not, see < https://www.gnu.org/licenses/>.
 
 #include <easygltf/easygltf.h>
+#include <easygltf/easygltf_animation.h>
+#include <easygltf/easygltf_geometry.h>
+#include <easygltf/easygltf_instancing.h>
+#include <easygltf/easygltf_megabuffer.h>
+#include <easygltf/easygltf_meshlet.h>
+#include <easygltf/easygltf_progressive.h>
+#include <easygltf/easygltf_quantize.h>
+#include <easygltf/easygltf_raster.h>
+#include <easygltf/easygltf_snapshot.h>
+#include <easygltf/easygltf_threadpool.h>
+#include <easygltf/easygltf_topology.h>
+#include <easygltf/easygltf_trace.h>
+#include <easygltf/easygltf_validator.h>
+#include <easygltf/easygltf_vfs.h>
+
+#include "rapidjson/document.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Loads the Monster variants and a generated asset and runs the library's modules over them, the exit code is 1 if any check fails
+
+static const char* MONSTER_VARIANTS[] = {
+	"Monster/glTF/Monster.gltf",
+	"Monster/glTF-Embedded/Monster.gltf",
+	"Monster/glTF-Binary/Monster.glb"
+};
+
+static bool EndsWith(const std::string& str, const std::string& suffix)
+{
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Many nodes sharing a few meshes, skinned, morphed, animated and with cameras, written to the working directory and removed at the end
+static const char* GENERATED_ASSET = "testprogram_generated.glb";
+static const char* GENERATED_ARGS = "--seed 3 --nodes 300 --hierarchy tree --meshes 6 --primitives 2 --vertices 2000 --targets 2 --animations 2 --materials 3 --cameras 3";
+
+// A small textured one for the golden images, the hash of all of its renders. Whatever changes the rendering changes this as well,
+// the renders that don't match are written next to the program to look at.
+static const char* RENDER_ASSET = "testprogram_render.glb";
+static const char* RENDER_ARGS = "--seed 5 --nodes 40 --hierarchy tree --meshes 4 --vertices 400 --materials 3 --images 2 --image-size 32 --cameras 3";
+static const uint64_t RENDER_HASH = 0x85E10A77A9F499A5ULL;
+
+// The same asset twice, once with a hole of 4.5 GiB at the start of its .bin (sparse, it takes no disk space) and once as a .glb,
+// so reads past 4 GB can be checked against the bytes they have to give. Big enough for a strided view to span several read chunks.
+static const char* HOLED_ASSET = "testprogram_holed.gltf";
+static const char* HOLED_BINARY = "testprogram_holed.bin";
+static const char* HOLED_REFERENCE = "testprogram_holed_reference.glb";
+static const char* HOLED_ARGS = "--seed 2 --nodes 20 --meshes 2 --vertices 200000 --targets 1 --animations 1";
+static const char* HOLE_ARGS = " --hole 4.5";
+
+// External images, which a pooled load reads on the workers, and an external .bin with more than one mesh in it
+static const char* EVENTS_ASSET = "testprogram_events.gltf";
+static const char* EVENTS_ARGS = "--seed 4 --nodes 20 --meshes 2 --vertices 200 --materials 2 --images 3 --image-size 16";
+static const char* EVENTS_FILES[] = { "testprogram_events.gltf", "testprogram_events.bin", "testprogram_events_image0.png",
+	"testprogram_events_image1.png", "testprogram_events_image2.png" };
+
+// Edited on disk and reloaded
+static const char* RELOAD_ASSET = "testprogram_reload.gltf";
+static const char* RELOAD_ARGS = "--seed 6 --nodes 30 --meshes 2 --vertices 200 --materials 3 --images 2 --image-size 16";
+static const char* RELOAD_FILES[] = { "testprogram_reload.gltf", "testprogram_reload.bin", "testprogram_reload_image0.png",
+	"testprogram_reload_image1.png" };
+
+// A .gltf whose json is above the size the pool splits the parse at (4 MiB), its .bin is tiny
+static const char* SPLIT_ASSET = "testprogram_split.gltf";
+static const char* SPLIT_BINARY = "testprogram_split.bin";
+static const char* SPLIT_ARGS = "--seed 7 --nodes 24000 --hierarchy tree --meshes 3 --vertices 100 --animations 1 --materials 2 --cameras 2";
+static const size_t SPLIT_JSON_MIN = 4u << 20;
+
+static bool Generate(const std::string& filepath, const std::string& args)
+{
+	const std::string command = std::string("\"") + EASYGLTF_GENERATOR + "\" --out \"" + filepath + "\" " + args;
+	if (system(command.c_str()) == 0)
+		return true;
+
+	fprintf(stderr, "\nError: could not generate %s\n", filepath.c_str());
+	return false;
+}
+
+static bool Load(EGLTF::CEasyGLTF& easygltf, const std::string& filepath)
+{
+	if (EndsWith(filepath, ".glb") ? easygltf.LoadGLB_file(filepath) : easygltf.LoadGLTF_file(filepath))
+		return true;
+
+	fprintf(stderr, "\nError: could not load %s\n", filepath.c_str());
+	return false;
+}
+
+// Bakes the asset, maps it again and compares what came back
+static bool TestSnapshot(const std::string& filepath)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	const std::string snapshotPath = "testprogram.egsn";
+	const uint64_t sourceHash = EGLTF::HashGLTFSnapshotSource(filepath);
+
+	EGLTF::CGLTFSnapshot snapshot;
+	if (!EGLTF::WriteGLTFSnapshot(asset, snapshotPath, sourceHash) || !snapshot.Open(snapshotPath, sourceHash, true))
+	{
+		fprintf(stderr, "\nError: snapshot of %s could not be written or opened\n", filepath.c_str());
+		return false;
+	}
+
+	bool ok = snapshot.GetNodeCount() == asset.nodes.size() && snapshot.GetMeshCount() == asset.meshes.size() &&
+		snapshot.GetBufferCount() == asset.buffers.size() && snapshot.GetAccessorCount() == asset.accessors.size() &&
+		snapshot.GetMaterialCount() == asset.materials.size() && snapshot.GetAnimationCount() == asset.animations.size() &&
+		snapshot.GetCameraCount() == asset.cameras.size();
+
+	for (uint32_t i = 0; ok && i < snapshot.GetNodeCount(); ++i)
+	{
+		const EGLTF::SGLTFSnapshot_Node& node = snapshot.GetNode(i);
+		ok = node.mesh == asset.nodes[i].mesh && node.skin == asset.nodes[i].skin && node.children.count == asset.nodes[i].children.size() &&
+			node.camera == asset.nodes[i].camera && memcmp(node.matrix, asset.nodes[i].matrix.data(), sizeof(node.matrix)) == 0 &&
+			asset.nodes[i].name == snapshot.GetString(node.name);
+	}
+
+	for (uint32_t i = 0; ok && i < snapshot.GetCameraCount(); ++i)
+	{
+		const EGLTF::SGLTFSnapshot_Camera& camera = snapshot.GetCamera(i);
+		ok = camera.type == static_cast<int32_t>(asset.cameras[i].type) && camera.znear == asset.cameras[i].znear &&
+			camera.zfar == asset.cameras[i].zfar && camera.val0 == asset.cameras[i].val0 && camera.val1 == asset.cameras[i].val1;
+	}
+
+	for (uint32_t i = 0; ok && i < snapshot.GetAccessorCount(); ++i)
+	{
+		const EGLTF::SGLTFSnapshot_Accessor& accessor = snapshot.GetAccessor(i);
+		ok = accessor.count == asset.accessors[i].count && accessor.byteOffset == asset.accessors[i].byteOffset &&
+			accessor.bufferView == asset.accessors[i].bufferView && asset.accessors[i].type == snapshot.GetString(accessor.type);
+	}
+
+	for (uint32_t i = 0; ok && i < snapshot.GetBufferCount(); ++i)
+	{
+		const EGLTF::SGLTFSnapshot_Buffer& buffer = snapshot.GetBuffer(i);
+		ok = buffer.data.size == asset.buffers[i].data.size() &&
+			(buffer.data.size == 0 || memcmp(snapshot.GetData(buffer.data), asset.buffers[i].data.data(), asset.buffers[i].data.size()) == 0);
+	}
+
+	snapshot.Close();
+	remove(snapshotPath.c_str());
+
+	if (!ok)
+		fprintf(stderr, "\nError: snapshot of %s does not match the asset\n", filepath.c_str());
+	return ok;
+}
+
+static bool ReadBytes(const std::string& filepath, std::vector<uint8_t>& out)
+{
+	FILE* fh = fopen(filepath.c_str(), "rb");
+	if (!fh)
+		return false;
+
+	out.clear();
+	uint8_t chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), fh)) > 0)
+		out.insert(out.end(), chunk, chunk + read);
+	fclose(fh);
+	return true;
+}
+
+// Hash of the snapshot of an asset, what two loads of the same file have to agree on
+static bool HashAsset(const EGLTF::SGLTFAsset& asset, uint64_t& hash)
+{
+	const std::string snapshotPath = "testprogram_hash.egsn";
+	std::vector<uint8_t> bytes;
+	const bool ok = EGLTF::WriteGLTFSnapshot(asset, snapshotPath) && ReadBytes(snapshotPath, bytes);
+	remove(snapshotPath.c_str());
+	if (!ok)
+		return false;
+
+	hash = EGLTF::HashGLTFSnapshotData(bytes.data(), bytes.size());
+	return true;
+}
+
+static bool Validate(const EGLTF::SGLTFAsset& asset, const std::string& what)
+{
+	EGLTF::SGLTFValidationReport report;
+	if (EGLTF::ValidateGLTFAsset(asset, report))
+		return true;
+
+	report.Print();
+	fprintf(stderr, "\nError: %s does not validate\n", what.c_str());
+	return false;
+}
+
+// Bytes read and decoded per section, the events end on whatever thread did the work
+class CSectionTotals : public EGLTF::IGLTFLoadListener
+{
+public:
+	void OnEventEnd(const EGLTF::SGLTFLoadEvent& event) override
+	{
+		if (event.category != EGLTF::EGLTFLoadEventCategory::SECTION)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_totals[event.name].first += event.bytesRead;
+		m_totals[event.name].second += event.bytesDecoded;
+	}
+
+	std::map<std::string, std::pair<uint64_t, uint64_t>> m_totals;
+
+private:
+	std::mutex m_mutex;
+};
+
+// The files and base64 blobs of buffers and images belong to their section, loaded on the pool or not
+static bool TestLoadEvents(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	CSectionTotals serial;
+	CSectionTotals pooled;
+	uint64_t bufferBytes = 0;
+	uint64_t imageBytes = 0;
+	{
+		EGLTF::CEasyGLTF easygltf;
+		easygltf.SetLoadListener(&serial);
+		if (!Load(easygltf, filepath))
+			return false;
+
+		// embedded blobs are decoded and external files read, the glb chunk is neither. Embedded images are copied and lose their uri.
+		const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+		for (const auto& buffer : asset.buffers)
+			bufferBytes += EndsWith(filepath, ".glb") ? 0 : buffer.data.size();
+		for (const auto& image : asset.images)
+			imageBytes += image.uri.empty() ? 0 : image.data.size();
+	}
+	{
+		EGLTF::CEasyGLTF easygltf;
+		easygltf.SetLoadListener(&pooled);
+		easygltf.SetThreadPool(&pool);
+		if (!Load(easygltf, filepath))
+			return false;
+	}
+
+	if (serial.m_totals != pooled.m_totals || serial.m_totals["buffers"].first + serial.m_totals["buffers"].second != bufferBytes ||
+		serial.m_totals["images"].first != imageBytes)
+	{
+		fprintf(stderr, "\nError: bytes of the sections of %s are missing or differ on the pool\n", filepath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// Streams the first primitive of every other mesh and the images in, they have to read the same as after a regular load. External
+// files must not have taken any memory for what nobody asked for.
+static bool TestProgressive(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& expected = easygltf.GetAssetInstance();
+
+	EGLTF::CGLTFProgressiveLoader loader(pool);
+	if (!loader.Open(filepath))
+	{
+		fprintf(stderr, "\nError: %s could not be opened progressively\n", filepath.c_str());
+		return false;
+	}
+
+	const EGLTF::SGLTFAsset& asset = loader.GetAsset();
+	std::atomic<bool> loaded(true);
+	auto callback = [&loaded](EGLTF::CGLTFProgressiveLoader::TRequestId, bool ok) { if (!ok) loaded = false; };
+
+	std::vector<int32_t> accessors;
+	for (size_t i = 0; i < asset.meshes.size(); i += 2)
+	{
+		if (asset.meshes[i].primitives.empty())
+			continue;
+
+		const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[i].primitives[0];
+		accessors.push_back(primitive.indices);
+		for (const auto& attribute : primitive.attributes)
+			accessors.push_back(attribute.second);
+		for (const auto& target : primitive.targets)
+			for (const auto& attribute : target)
+				accessors.push_back(attribute.second);
+
+		loader.RequestPrimitive(static_cast<int32_t>(i), 0, static_cast<int>(i), callback);
+	}
+
+	for (size_t i = 0; i < asset.images.size(); ++i)
+		loader.RequestImage(static_cast<int32_t>(i), 0, callback);
+
+	loader.WaitIdle();
+
+	bool ok = loaded && asset.bufferViews.size() == expected.bufferViews.size() && asset.images.size() == expected.images.size();
+
+	std::vector<uint8_t> requested(asset.bufferViews.size(), 0);
+	std::vector<uint8_t> streamed, reference;
+	for (size_t i = 0; ok && i < accessors.size(); ++i)
+	{
+		if (accessors[i] < 0)
+			continue;
+
+		const EGLTF::SGLTFAsset_Prop_Accessor& accessor = asset.accessors[accessors[i]];
+		if (accessor.bufferView >= 0)
+			requested[accessor.bufferView] = 1;
+		if (accessor.sparse.count > 0)
+			requested[accessor.sparse.values] = requested[accessor.sparse.indices.first] = 1;
+
+		ok = EGLTF::ReadGLTFAccessorBytes(asset, accessors[i], streamed) && EGLTF::ReadGLTFAccessorBytes(expected, accessors[i], reference) &&
+			streamed == reference;
+	}
+
+	for (size_t i = 0; ok && i < asset.images.size(); ++i)
+	{
+		if (asset.images[i].bufferView >= 0)
+			requested[asset.images[i].bufferView] = 1;
+		ok = asset.images[i].data == expected.images[i].data && loader.IsImageResident(static_cast<int32_t>(i));
+	}
+
+	// external files themselves are never allocated, their views get buffers of their own
+	for (size_t i = 0; ok && i < expected.buffers.size(); ++i)
+		ok = expected.buffers[i].uri.empty() || expected.buffers[i].uri.compare(0, 5, "data:") == 0 || asset.buffers[i].data.capacity() == 0;
+
+	for (size_t i = 0; ok && i < asset.bufferViews.size(); ++i)
+	{
+		const int32_t buffer = asset.bufferViews[i].buffer;
+		if (buffer >= static_cast<int32_t>(expected.buffers.size()))
+			ok = requested[i] ? loader.IsBufferViewResident(static_cast<int32_t>(i)) : asset.buffers[buffer].data.capacity() == 0;
+	}
+
+	if (!ok)
+		fprintf(stderr, "\nError: what was streamed from %s does not match a regular load, or more was read than requested\n", filepath.c_str());
+	return ok;
+}
+
+// The file and everything it refers to handed over in memory, loaded on the pool, has to give what a load from disk gives
+static bool TestMemoryFileSystem(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF disk;
+	if (!Load(disk, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& expected = disk.GetAssetInstance();
+	const size_t slash = filepath.find_last_of('/');
+	const std::string directory = slash == std::string::npos ? std::string() : filepath.substr(0, slash + 1);
+
+	std::vector<std::string> files(1, filepath);
+	for (const auto& buffer : expected.buffers)
+		if (!buffer.uri.empty() && buffer.uri.compare(0, 5, "data:") != 0)
+			files.push_back(EGLTF::ResolveGLTFUri(directory, buffer.uri));
+	for (const auto& image : expected.images)
+		if (!image.uri.empty() && image.uri.compare(0, 5, "data:") != 0)
+			files.push_back(EGLTF::ResolveGLTFUri(directory, image.uri));
+
+	EGLTF::CGLTFMemoryFileSystem memory;
+	for (const auto& file : files)
+	{
+		std::vector<uint8_t> bytes;
+		if (!ReadBytes(file, bytes))
+		{
+			fprintf(stderr, "\nError: could not read %s\n", file.c_str());
+			return false;
+		}
+		memory.AddFile(file, std::move(bytes));
+	}
+
+	EGLTF::CEasyGLTF easygltf;
+	easygltf.SetFileSystem(&memory);
+	easygltf.SetThreadPool(&pool);
+	if (!Load(easygltf, filepath))
+		return false;
+
+	uint64_t hash = 0, reference = 0;
+	if (!HashAsset(easygltf.GetAssetInstance(), hash) || !HashAsset(expected, reference) || hash != reference)
+	{
+		fprintf(stderr, "\nError: a load of %s from memory does not match a load from disk\n", filepath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// A document big enough for the json to be parsed in pieces on the pool has to give the asset the serial parse gives
+static bool TestSplitParse(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	std::vector<uint8_t> json;
+	if (!ReadBytes(filepath, json) || json.size() < SPLIT_JSON_MIN)
+	{
+		fprintf(stderr, "\nError: %s is missing or too small to be split\n", filepath.c_str());
+		return false;
+	}
+
+	EGLTF::CEasyGLTF serial;
+	if (!Load(serial, filepath))
+		return false;
+
+	EGLTF::CEasyGLTF pooled;
+	pooled.SetThreadPool(&pool);
+	if (!Load(pooled, filepath))
+		return false;
+
+	uint64_t hash = 0, reference = 0;
+	if (!HashAsset(pooled.GetAssetInstance(), hash) || !HashAsset(serial.GetAssetInstance(), reference) || hash != reference ||
+		pooled.GetAssetInstance().nodes.size() != serial.GetAssetInstance().nodes.size())
+	{
+		fprintf(stderr, "\nError: the split parse of %s does not give the asset the serial parse gives\n", filepath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// Loads every other mesh with ranged reads, what was selected has to read the same as after a full load and whatever the meshes use
+// has to have made it in
+static bool TestFilteredLoad(const std::string& filepath)
+{
+	EGLTF::CEasyGLTF full;
+	if (!Load(full, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& expected = full.GetAssetInstance();
+
+	EGLTF::SGLTFLoadFilter filter;
+	for (size_t i = 0; i < expected.meshes.size(); i += 2)
+		filter.meshes.push_back(static_cast<int32_t>(i));
+	filter.rangedReads = true;
+
+	EGLTF::CEasyGLTF filtered;
+	filtered.SetLoadFilter(filter);
+	if (!Load(filtered, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& asset = filtered.GetAssetInstance();
+	const EGLTF::SGLTFLoadSelection& selection = filtered.GetLoadSelection();
+
+	bool ok = asset.meshes.size() == expected.meshes.size() && asset.accessors.size() == expected.accessors.size() &&
+		asset.materials.size() == expected.materials.size() && asset.images.size() == expected.images.size();
+
+	auto used = [&ok](const std::vector<uint8_t>& section, int32_t index) { if (index >= 0 && !EGLTF::SGLTFLoadSelection::Has(section, index)) ok = false; };
+	for (size_t i = 0; ok && i < asset.meshes.size(); ++i)
+	{
+		if (EGLTF::SGLTFLoadSelection::Has(selection.meshes, i) != (i % 2 == 0))
+			ok = false;
+		if (!ok || i % 2 != 0)
+			continue;
+
+		ok = asset.meshes[i].name == expected.meshes[i].name && asset.meshes[i].primitives.size() == expected.meshes[i].primitives.size();
+		for (size_t p = 0; ok && p < asset.meshes[i].primitives.size(); ++p)
+		{
+			const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[i].primitives[p];
+			ok = primitive.attributes == expected.meshes[i].primitives[p].attributes && primitive.indices == expected.meshes[i].primitives[p].indices &&
+				primitive.material == expected.meshes[i].primitives[p].material && primitive.targets == expected.meshes[i].primitives[p].targets;
+
+			used(selection.accessors, primitive.indices);
+			used(selection.materials, primitive.material);
+			for (const auto& attribute : primitive.attributes)
+				used(selection.accessors, attribute.second);
+			for (const auto& target : primitive.targets)
+				for (const auto& attribute : target)
+					used(selection.accessors, attribute.second);
+		}
+	}
+
+	std::vector<uint8_t> bytes, reference;
+	for (size_t i = 0; ok && i < asset.accessors.size(); ++i)
+	{
+		if (EGLTF::SGLTFLoadSelection::Has(selection.accessors, i))
+			ok = EGLTF::ReadGLTFAccessorBytes(asset, static_cast<int32_t>(i), bytes) &&
+				EGLTF::ReadGLTFAccessorBytes(expected, static_cast<int32_t>(i), reference) && bytes == reference;
+	}
+
+	for (size_t i = 0; ok && i < asset.materials.size(); ++i)
+	{
+		if (EGLTF::SGLTFLoadSelection::Has(selection.materials, i))
+			ok = asset.materials[i].name == expected.materials[i].name &&
+				asset.materials[i].pbrMetallicRoughness.baseColorFactor == expected.materials[i].pbrMetallicRoughness.baseColorFactor;
+	}
+
+	for (size_t i = 0; ok && i < asset.images.size(); ++i)
+	{
+		if (EGLTF::SGLTFLoadSelection::Has(selection.images, i))
+			ok = asset.images[i].data == expected.images[i].data;
+	}
+
+	if (!ok)
+		fprintf(stderr, "\nError: a filtered load of %s does not match the same elements of a full load\n", filepath.c_str());
+	return ok;
+}
+
+static bool WriteBytes(const std::string& filepath, const void* data, size_t size)
+{
+	FILE* fh = fopen(filepath.c_str(), "wb");
+	if (!fh)
+		return false;
+
+	const bool ok = fwrite(data, 1, size, fh) == size;
+	return fclose(fh) == 0 && ok;
+}
+
+// Writes the json of a .gltf back after edit had its way with it
+template<typename F>
+static bool EditJson(const std::string& filepath, F edit)
+{
+	std::vector<uint8_t> text;
+	rapidjson::Document document;
+	if (!ReadBytes(filepath, text) || document.Parse(reinterpret_cast<const char*>(text.data()), text.size()).HasParseError())
+		return false;
+
+	edit(document);
+
+	rapidjson::StringBuffer buffer;
+	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+	document.Accept(writer);
+	return WriteBytes(filepath, buffer.GetString(), buffer.GetSize());
+}
+
+static bool ReloadChanges(EGLTF::CEasyGLTF& easygltf, EGLTF::SGLTFChangeSet& changes)
+{
+	if (easygltf.Reload(&changes))
+		return true;
+
+	fprintf(stderr, "\nError: reload failed\n");
+	return false;
+}
+
+// Only the listed sections may have changed, each with exactly the expected indices
+static bool IsChangeSet(const EGLTF::SGLTFChangeSet& changes, const std::vector<int32_t>& images, const std::vector<int32_t>& textures,
+	const std::vector<int32_t>& materials, const std::vector<int32_t>& nodes)
+{
+	return changes.any == (!images.empty() || !textures.empty() || !materials.empty() || !nodes.empty()) &&
+		changes.images == images && changes.textures == textures && changes.materials == materials && changes.nodes == nodes &&
+		changes.buffers.empty() && changes.bufferViews.empty() && changes.accessors.empty() && changes.samplers.empty() &&
+		changes.meshes.empty() && changes.cameras.empty() && changes.skins.empty() && changes.animations.empty() && changes.scenes.empty();
+}
+
+// Reloads a .gltf untouched, rewritten with the same json, with one material and one node edited and with one of its images replaced.
+// Each time the change set has to list what was edited and what depends on it, nothing else.
+static bool TestReload(const std::string& filepath)
+{
+	EGLTF::CEasyGLTF easygltf;
+	easygltf.SetTrackChanges(true);
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	if (asset.materials.size() < 2 || asset.nodes.size() < 6 || asset.images.size() < 2)
+	{
+		fprintf(stderr, "\nError: %s is too small to be edited\n", filepath.c_str());
+		return false;
+	}
+
+	EGLTF::SGLTFChangeSet changes;
+	bool ok = ReloadChanges(easygltf, changes) && IsChangeSet(changes, {}, {}, {}, {});
+
+	// a new mtime and formatting, but the same json
+	ok = ok && EditJson(filepath, [](rapidjson::Document&) {}) && ReloadChanges(easygltf, changes) && IsChangeSet(changes, {}, {}, {}, {});
+	if (!ok)
+	{
+		fprintf(stderr, "\nError: reloading %s untouched reported changes\n", filepath.c_str());
+		return false;
+	}
+
+	const double color = 0.125;
+	ok = EditJson(filepath, [color](rapidjson::Document& document)
+	{
+		document["materials"][1]["pbrMetallicRoughness"]["baseColorFactor"][0].SetDouble(color);
+		document["nodes"][5]["name"].SetString("edited");
+	});
+	ok = ok && ReloadChanges(easygltf, changes) && IsChangeSet(changes, {}, {}, { 1 }, { 5 }) &&
+		asset.materials[1].pbrMetallicRoughness.baseColorFactor[0] == color && asset.nodes[5].name == "edited";
+	if (!ok)
+	{
+		fprintf(stderr, "\nError: reloading %s with an edited material and node did not report exactly those\n", filepath.c_str());
+		return false;
+	}
+
+	// the textures of the image and the materials using those
+	std::vector<int32_t> textures, materials;
+	for (size_t i = 0; i < asset.textures.size(); ++i)
+		if (asset.textures[i].source == 1)
+			textures.push_back(static_cast<int32_t>(i));
+	for (size_t i = 0; i < asset.materials.size(); ++i)
+		if (std::find(textures.begin(), textures.end(), asset.materials[i].pbrMetallicRoughness.baseColorTexture.index) != textures.end())
+			materials.push_back(static_cast<int32_t>(i));
+
+	const std::string directory = filepath.substr(0, filepath.find_last_of('/') + 1);
+	std::vector<uint8_t> image;
+	ok = ReadBytes(directory + asset.images[0].uri, image) && WriteBytes(directory + asset.images[1].uri, image.data(), image.size()) &&
+		ReloadChanges(easygltf, changes) && IsChangeSet(changes, { 1 }, textures, materials, {}) && asset.images[1].data == image;
+	if (!ok)
+		fprintf(stderr, "\nError: reloading %s with a replaced image did not report it and its dependents\n", filepath.c_str());
+	return ok;
+}
+
+// A compact load keeps its nodes apart from the asset, validation has to find them there
+static bool TestCompactValidation(const std::string& filepath)
+{
+	EGLTF::CEasyGLTF easygltf;
+	easygltf.SetCompact(true);
+	easygltf.SetValidation(true);
+	if (!Load(easygltf, filepath))
+		return false;
+
+	if (easygltf.GetCompactAsset().nodes.empty() || !easygltf.GetAssetInstance().nodes.empty())
+	{
+		fprintf(stderr, "\nError: compact load of %s did not keep its nodes apart\n", filepath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// A sparse copy of a float accessor that moves some elements far out, with the bounds of what it hands out. Returns its index.
+static int32_t AddSparseCopy(EGLTF::SGLTFAsset& asset, int32_t base, const std::vector<uint32_t>& indices)
+{
+	EGLTF::SGLTFAsset_Prop_Accessor sparse = asset.accessors[base];
+	const uint32_t elementSize = EGLTF::GetGLTFElementSize(sparse.componentType, sparse.type);
+
+	EGLTF::SGLTFAsset_Prop_Buffer buffer;
+	buffer.data.resize(indices.size() * (sizeof(uint32_t) + elementSize));
+	memcpy(buffer.data.data(), indices.data(), indices.size() * sizeof(uint32_t));
+	for (size_t i = 0; i < indices.size() * elementSize / sizeof(float); ++i)
+	{
+		const float value = 1000.0f + static_cast<float>(i);
+		memcpy(buffer.data.data() + indices.size() * sizeof(uint32_t) + i * sizeof(float), &value, sizeof(value));
+	}
+	buffer.byteLength = static_cast<int64_t>(buffer.data.size());
+	asset.buffers.push_back(buffer);
+
+	EGLTF::SGLTFAsset_Prop_BufferView view;
+	view.buffer = static_cast<int32_t>(asset.buffers.size() - 1);
+	view.byteOffset = 0;
+	view.byteLength = static_cast<int64_t>(indices.size() * sizeof(uint32_t));
+	asset.bufferViews.push_back(view);
+
+	view.byteOffset = view.byteLength;
+	view.byteLength = static_cast<int64_t>(indices.size() * elementSize);
+	asset.bufferViews.push_back(view);
+
+	sparse.sparse.count = static_cast<int64_t>(indices.size());
+	sparse.sparse.indices = std::make_pair(static_cast<int32_t>(asset.bufferViews.size() - 2), 5125);
+	sparse.sparse.values = static_cast<int32_t>(asset.bufferViews.size() - 1);
+	asset.accessors.push_back(sparse);
+
+	// only indices a reader takes, the others are there to fail validation
+	bool readable = true;
+	for (size_t i = 0; i < indices.size(); ++i)
+		readable &= indices[i] < sparse.count && (i == 0 || indices[i] > indices[i - 1]);
+
+	const int32_t index = static_cast<int32_t>(asset.accessors.size() - 1);
+	std::vector<float> values;
+	if (readable && EGLTF::ReadGLTFAccessor(asset, index, values))
+	{
+		const size_t components = sparse.min.size();
+		asset.accessors[index].min.assign(values.begin(), values.begin() + components);
+		asset.accessors[index].max.assign(values.begin(), values.begin() + components);
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			asset.accessors[index].min[i % components] = std::min<double>(asset.accessors[index].min[i % components], values[i]);
+			asset.accessors[index].max[i % components] = std::max<double>(asset.accessors[index].max[i % components], values[i]);
+		}
+	}
+	return index;
+}
+
+// Min/max of a sparse accessor are about the data with the sparse values in, and its indices have to be increasing, inside the
+// accessor and inside their view
+static bool TestSparseValidation(const std::string& filepath)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& loaded = easygltf.GetAssetInstance();
+	int32_t base = -1;
+	for (size_t i = 0; base < 0 && i < loaded.accessors.size(); ++i)
+		if (loaded.accessors[i].componentType == 5126 && loaded.accessors[i].type == "VEC3" && loaded.accessors[i].min.size() == 3 &&
+			loaded.accessors[i].max.size() == 3 && loaded.accessors[i].count > 8 && loaded.accessors[i].sparse.count == -1)
+			base = static_cast<int32_t>(i);
+	if (base < 0)
+		return true;
+
+	const uint32_t last = static_cast<uint32_t>(loaded.accessors[base].count - 1);
+	auto validates = [&](const std::vector<uint32_t>& indices, bool shortValues, bool baseBounds)
+	{
+		EGLTF::SGLTFAsset asset = loaded;
+		const int32_t sparse = AddSparseCopy(asset, base, indices);
+		if (shortValues)
+			asset.bufferViews[asset.accessors[sparse].sparse.values].byteLength -= 4;
+		if (baseBounds)
+		{
+			asset.accessors[sparse].min = loaded.accessors[base].min;
+			asset.accessors[sparse].max = loaded.accessors[base].max;
+		}
+
+		EGLTF::SGLTFValidationReport report;
+		return EGLTF::ValidateGLTFAsset(asset, report);
+	};
+
+	if (!validates({ 0, 3, last }, false, false) || validates({ 0, 3, last }, false, true) || validates({ 0, 3, 3 }, false, false) ||
+		validates({ 0, 3, last + 1 }, false, false) || validates({ 0, 3, last }, true, false))
+	{
+		fprintf(stderr, "\nError: sparse accessors of %s are not validated as they should be\n", filepath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// Drops NORMAL and TANGENT and generates them again, serially and on the pool. Both have to give the same unit normals and
+// an asset that validates.
+static bool TestGeometry(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	EGLTF::SGLTFAsset serial = easygltf.GetAssetInstance();
+	for (auto& mesh : serial.meshes)
+		for (auto& primitive : mesh.primitives)
+		{
+			primitive.attributes.erase("NORMAL");
+			primitive.attributes.erase("TANGENT");
+		}
+	EGLTF::SGLTFAsset pooled = serial;
+
+	if (!EGLTF::GenerateGLTFGeometry(serial) || !EGLTF::GenerateGLTFGeometry(pooled, EGLTF::SGLTFGeometryOptions(), &pool))
+	{
+		fprintf(stderr, "\nError: geometry of %s could not be generated\n", filepath.c_str());
+		return false;
+	}
+
+	bool ok = serial.buffers.size() == pooled.buffers.size() && serial.buffers.back().data == pooled.buffers.back().data;
+	for (const auto& mesh : serial.meshes)
+		for (const auto& primitive : mesh.primitives)
+		{
+			const auto normal = primitive.attributes.find("NORMAL");
+			if (normal == primitive.attributes.end() || (primitive.attributes.count("TEXCOORD_0") && !primitive.attributes.count("TANGENT")))
+			{
+				ok = false;
+				continue;
+			}
+
+			std::vector<float> normals;
+			ok &= EGLTF::ReadGLTFAccessor(serial, normal->second, normals);
+			for (size_t i = 0; i + 2 < normals.size(); i += 3)
+				ok &= std::fabs(std::sqrt(normals[i] * normals[i] + normals[i + 1] * normals[i + 1] + normals[i + 2] * normals[i + 2]) - 1.0f) < 1e-3f;
+		}
+
+	if (!ok)
+	{
+		fprintf(stderr, "\nError: generated geometry of %s is missing, not unit length or differs on the pool\n", filepath.c_str());
+		return false;
+	}
+
+	return Validate(serial, filepath + " with generated geometry");
+}
+
+// A copy of a mesh reading its data through accessors of its own has to be found as a duplicate. Instance groups have to
+// account for every mesh node and primitive and come out the same on the pool.
+static bool TestInstancing(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	EGLTF::SGLTFAsset asset = easygltf.GetAssetInstance();
+	if (asset.meshes.empty())
+		return true;
+
+	auto duplicate = [&](int32_t& accessor)
+	{
+		if (accessor < 0)
+			return;
+		asset.accessors.push_back(asset.accessors[accessor]);
+		accessor = static_cast<int32_t>(asset.accessors.size() - 1);
+	};
+
+	EGLTF::SGLTFAsset_Prop_Mesh copy = asset.meshes[0];
+	for (auto& primitive : copy.primitives)
+	{
+		duplicate(primitive.indices);
+		for (auto& attribute : primitive.attributes)
+			duplicate(attribute.second);
+		for (auto& target : primitive.targets)
+			for (auto& attribute : target)
+				duplicate(attribute.second);
+	}
+	asset.meshes.push_back(copy);
+
+	std::vector<int32_t> remap;
+	if (EGLTF::FindGLTFDuplicateMeshes(asset, remap, &pool) < 1 || remap.back() != 0)
+	{
+		fprintf(stderr, "\nError: the copy of mesh 0 of %s is not found as a duplicate\n", filepath.c_str());
+		return false;
+	}
+
+	EGLTF::SGLTFInstancing serial, pooled;
+	if (!EGLTF::BuildGLTFInstanceGroups(asset, serial) || !EGLTF::BuildGLTFInstanceGroups(asset, pooled, -1, nullptr, &pool))
+	{
+		fprintf(stderr, "\nError: instance groups of %s could not be built\n", filepath.c_str());
+		return false;
+	}
+
+	size_t drawCalls = 0, instancedDrawCalls = 0;
+	bool ok = serial.groups.size() == pooled.groups.size();
+	for (size_t g = 0; ok && g < serial.groups.size(); ++g)
+	{
+		const EGLTF::SGLTFInstanceGroup& group = serial.groups[g];
+		drawCalls += group.nodes.size() * asset.meshes[group.mesh].primitives.size();
+		instancedDrawCalls += asset.meshes[group.mesh].primitives.size();
+		ok = group.transforms.size() == group.nodes.size() * 16 && group.nodes == pooled.groups[g].nodes && group.transforms == pooled.groups[g].transforms;
+	}
+
+	if (!ok || drawCalls != serial.drawCalls || instancedDrawCalls != serial.instancedDrawCalls || serial.instancedDrawCalls > serial.drawCalls)
+	{
+		fprintf(stderr, "\nError: instance groups of %s do not add up or differ on the pool\n", filepath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// Every draw has to cover its primitive's indices once per instance of it, point at the POSITION data it came from and come out
+// the same on the pool
+static bool TestMegaBuffer(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	std::vector<EGLTF::SGLTFSceneSource> sources(1);
+	sources[0].asset = &asset;
+
+	EGLTF::SGLTFCompiledScene serial, pooled;
+	EGLTF::SGLTFInstancing instancing;
+	if (!EGLTF::CompileGLTFScene(sources, serial) || !EGLTF::CompileGLTFScene(sources, pooled, &pool) || !EGLTF::BuildGLTFInstanceGroups(asset, instancing))
+	{
+		fprintf(stderr, "\nError: scene of %s could not be compiled\n", filepath.c_str());
+		return false;
+	}
+
+	bool ok = serial.buffers.size() == pooled.buffers.size() && serial.instanceTransforms == pooled.instanceTransforms &&
+		serial.commands.size() == serial.draws.size() && serial.instanceTransforms.size() == serial.instanceNodes.size() * 16;
+	for (size_t b = 0; ok && b < serial.buffers.size(); ++b)
+		ok = serial.buffers[b].vertices == pooled.buffers[b].vertices && serial.buffers[b].indices == pooled.buffers[b].indices;
+
+	size_t instances = 0;
+	for (size_t c = 0; ok && c < serial.commands.size(); ++c)
+	{
+		const EGLTF::SGLTFDrawElementsIndirectCommand& command = serial.commands[c];
+		const EGLTF::SGLTFDrawInfo& draw = serial.draws[c];
+		const EGLTF::SGLTFMegaBuffer& buffer = serial.buffers[draw.buffer];
+		const EGLTF::SGLTFAsset_Prop_Mesh_Primitive& primitive = asset.meshes[draw.mesh].primitives[draw.primitive];
+		instances += command.instanceCount;
+
+		std::vector<float> positions;
+		ok = EGLTF::ReadGLTFAccessor(asset, primitive.attributes.at("POSITION"), positions) &&
+			command.firstIndex + command.count <= buffer.indices.size() && command.baseInstance + command.instanceCount <= serial.instanceNodes.size();
+
+		const EGLTF::SGLTFVertexAttribute* position = nullptr;
+		for (const auto& attribute : buffer.layout.attributes)
+			if (attribute.name == "POSITION")
+				position = &attribute;
+
+		const size_t vertexCount = buffer.vertices.size() / buffer.layout.stride;
+		for (uint32_t i = 0; ok && i < command.count; ++i)
+		{
+			const uint32_t index = buffer.indices[command.firstIndex + i];
+			const size_t vertex = static_cast<size_t>(command.baseVertex) + index;
+			ok = position && index * 3 + 2 < positions.size() && vertex < vertexCount &&
+				memcmp(&buffer.vertices[vertex * buffer.layout.stride + position->offset], &positions[index * 3], sizeof(float) * 3) == 0;
+		}
+	}
+
+	if (!ok || instances != instancing.drawCalls)
+	{
+		fprintf(stderr, "\nError: compiled scene of %s does not match the asset or differs on the pool\n", filepath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+// Meshlets of every triangle primitive, serially and on the pool, have to pass ValidateGLTFMeshlets and agree
+static bool TestMeshlets(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	std::vector<EGLTF::SGLTFMeshletPrimitive> serial, pooled;
+	if (!EGLTF::BuildGLTFMeshlets(asset, serial) || !EGLTF::BuildGLTFMeshlets(asset, pooled, EGLTF::SGLTFMeshletOptions(), &pool) || serial.empty())
+	{
+		fprintf(stderr, "\nError: meshlets of %s could not be built\n", filepath.c_str());
+		return false;
+	}
+
+	bool ok = serial.size() == pooled.size();
+	for (size_t i = 0; ok && i < serial.size(); ++i)
+	{
+		EGLTF::SGLTFValidationReport report;
+		if (!EGLTF::ValidateGLTFMeshlets(asset, serial[i], report))
+		{
+			report.Print();
+			fprintf(stderr, "\nError: meshlets of mesh %d primitive %d of %s do not validate\n", serial[i].mesh, serial[i].primitive, filepath.c_str());
+			return false;
+		}
+
+		ok = serial[i].vertices == pooled[i].vertices && serial[i].triangles == pooled[i].triangles && serial[i].meshlets.size() == pooled[i].meshlets.size();
+	}
+
+	if (!ok)
+		fprintf(stderr, "\nError: meshlets of %s differ on the pool\n", filepath.c_str());
+	return ok;
+}
+
+// Quantizing has to shrink the buffers, stay within the error bounds, validate and give the same bytes on the pool
+static bool TestQuantize(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	EGLTF::SGLTFQuantizationOptions options;
+	options.texcoordError = 0.001f;
+
+	EGLTF::SGLTFAsset serial = easygltf.GetAssetInstance();
+	EGLTF::SGLTFAsset pooled = serial;
+	EGLTF::SGLTFQuantizationReport report, pooledReport;
+	if (!EGLTF::QuantizeGLTFAsset(serial, report, options) || !EGLTF::QuantizeGLTFAsset(pooled, pooledReport, options, nullptr, &pool))
+	{
+		fprintf(stderr, "\nError: %s could not be quantized\n", filepath.c_str());
+		return false;
+	}
+
+	bool ok = report.quantized > 0 && report.bytesAfter < report.bytesBefore && report.maxNormalError <= options.normalError &&
+		report.maxTexcoordError <= options.texcoordError && serial.buffers.size() == pooled.buffers.size();
+	for (size_t b = 0; ok && b < serial.buffers.size(); ++b)
+		ok = serial.buffers[b].data == pooled.buffers[b].data;
+
+	if (!ok)
+	{
+		report.Print(stderr);
+		fprintf(stderr, "\nError: quantized %s is over its bounds, not smaller or differs on the pool\n", filepath.c_str());
+		return false;
+	}
+
+	return Validate(serial, "quantized " + filepath);
+}
+
+// The advertised error has to hold, the poses are checked against sampling the accessors
+static bool TestAnimations(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	if (asset.animations.empty())
+		return true;
+
+	const EGLTF::SGLTFAnimationCompressionOptions options;
+	std::vector<EGLTF::SGLTFCompressedAnimation> serial, pooled;
+	EGLTF::SGLTFAnimationCompressionReport report, pooledReport;
+	if (!EGLTF::CompressGLTFAnimations(asset, serial, report, options) || !EGLTF::CompressGLTFAnimations(asset, pooled, pooledReport, options, &pool))
+	{
+		fprintf(stderr, "\nError: animations of %s could not be compressed\n", filepath.c_str());
+		return false;
+	}
+
+	if (report.maxError > options.maxError || report.maxWeightError > options.weightError || report.maxError != pooledReport.maxError ||
+		report.bytesAfter != pooledReport.bytesAfter)
+	{
+		report.Print(stderr);
+		fprintf(stderr, "\nError: animations of %s are off by more than the options allow or differ on the pool\n", filepath.c_str());
+		return false;
+	}
+
+	std::vector<EGLTF::SGLTFNodePose> reference, compressed;
+	EGLTF::GetGLTFRestPose(asset, reference);
+	EGLTF::GetGLTFRestPose(asset, compressed);
+	for (size_t a = 0; a < serial.size(); ++a)
+	{
+		const int frames = 30;
+		for (int f = 0; f < frames; ++f)
+		{
+			const float time = serial[a].start + serial[a].duration * f / (frames - 1);
+			if (!EGLTF::SampleGLTFAnimation(asset, static_cast<int32_t>(a), time, reference))
+				return false;
+			EGLTF::SampleGLTFCompressedAnimation(serial[a], time, compressed);
+
+			// a node's own translation is one of its tracks, within its share
+			for (size_t n = 0; n < reference.size(); ++n)
+			{
+				double distance = 0.0;
+				for (int i = 0; i < 3; ++i)
+					distance += double(reference[n].translation[i] - compressed[n].translation[i]) * (reference[n].translation[i] - compressed[n].translation[i]);
+				if (std::sqrt(distance) > options.maxError)
+				{
+					fprintf(stderr, "\nError: animations[%zu] of %s moves node %zu by %g at %g\n", a, filepath.c_str(), n, std::sqrt(distance), time);
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// Through the framing and every camera, on the calling thread and on the pool. The images have to be identical and match the hash.
+static bool TestRender(const std::string& filepath, EGLTF::CGLTFThreadPool& pool)
+{
+	EGLTF::CEasyGLTF easygltf;
+	if (!Load(easygltf, filepath))
+		return false;
+
+	const EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	if (!Validate(asset, filepath))
+		return false;
+
+	// the far planes have to come through as they are
+	if (asset.cameras.size() != 3 || asset.cameras[0].zfar != 0.0 || asset.cameras[1].zfar != 100.5 || asset.cameras[2].zfar != 250.75)
+	{
+		fprintf(stderr, "\nError: cameras of %s did not load as written\n", filepath.c_str());
+		return false;
+	}
+
+	std::vector<int32_t> views(1, -1);
+	for (size_t i = 0; i < asset.nodes.size(); ++i)
+		if (asset.nodes[i].camera >= 0)
+			views.push_back(static_cast<int32_t>(i));
+
+	EGLTF::CGLTFRasterizer serial, pooled;
+	pooled.SetThreadPool(&pool);
+
+	uint64_t hash = EGLTF::HashGLTFSnapshotData(nullptr, 0);
+	std::vector<EGLTF::SGLTFBitmap> images(views.size());
+	for (size_t v = 0; v < views.size(); ++v)
+	{
+		EGLTF::SGLTFRenderOptions options;
+		options.width = 96;
+		options.height = 64;
+		options.supersampling = 2;
+		options.camera = views[v];
+
+		EGLTF::SGLTFBitmap other;
+		if (!serial.Render(asset, images[v], options) || !pooled.Render(asset, other, options))
+		{
+			fprintf(stderr, "\nError: %s could not be rendered through node %d\n", filepath.c_str(), views[v]);
+			return false;
+		}
+
+		if (images[v].rgba != other.rgba || images[v].width != options.width || images[v].height != options.height)
+		{
+			fprintf(stderr, "\nError: rendering %s through node %d differs on the pool\n", filepath.c_str(), views[v]);
+			return false;
+		}
+
+		hash = EGLTF::HashGLTFSnapshotData(images[v].rgba.data(), images[v].rgba.size(), hash);
+	}
+
+	if (hash == RENDER_HASH)
+		return true;
+
+	for (size_t v = 0; v < views.size(); ++v)
+		EGLTF::WriteGLTFPNG("testprogram_render_" + std::to_string(v) + ".png", images[v]);
+	fprintf(stderr, "\nError: renders of %s have the hash 0x%016llX instead of 0x%016llX, they are in testprogram_render_*.png\n", filepath.c_str(),
+		static_cast<unsigned long long>(hash), static_cast<unsigned long long>(RENDER_HASH));
+	return false;
+}
+
+// The index built during the load against scans over the nodes, then again after moving a subtree
+static bool TestTopology(const std::string& filepath)
+{
+	EGLTF::CEasyGLTF easygltf;
+	easygltf.SetBuildTopology(true);
+	if (!Load(easygltf, filepath))
+		return false;
+
+	EGLTF::SGLTFAsset& asset = easygltf.GetAssetInstance();
+	EGLTF::CGLTFTopology* topology = easygltf.GetTopology();
+	if (!topology || topology->GetNodeCount() != asset.nodes.size() || !topology->GetIssues().empty())
+	{
+		fprintf(stderr, "\nError: topology of %s is missing or has issues\n", filepath.c_str());
+		return false;
+	}
+
+	auto check = [&](const char* when)
+	{
+		std::vector<int32_t> parents(asset.nodes.size(), -1);
+		for (size_t i = 0; i < asset.nodes.size(); ++i)
+			for (int32_t child : asset.nodes[i].children)
+				parents[child] = static_cast<int32_t>(i);
+
+		bool ok = topology->GetOrder().size() == asset.nodes.size();
+		for (size_t i = 0; ok && i < asset.nodes.size(); ++i)
+		{
+			const int32_t node = static_cast<int32_t>(i);
+			const EGLTF::SGLTFNodeRange range = topology->GetSubtree(node);
+			uint32_t size = 1;
+			for (int32_t child : asset.nodes[i].children)
+				size += topology->GetSubtree(child).end - topology->GetSubtree(child).begin;
+
+			ok = topology->GetParent(node) == parents[i] && range.end - range.begin == size && topology->GetOrder()[range.begin] == node &&
+				topology->GetDepth(node) == (parents[i] < 0 ? 0 : topology->GetDepth(parents[i]) + 1);
+
+			if (ok && !asset.nodes[i].name.empty())
+				ok = asset.nodes[topology->FindNode(asset.nodes[i].name)].name == asset.nodes[i].name;
+		}
+
+		std::vector<std::vector<int32_t>> meshUsers(asset.meshes.size());
+		for (size_t i = 0; i < asset.nodes.size(); ++i)
+			if (asset.nodes[i].mesh >= 0)
+				meshUsers[asset.nodes[i].mesh].push_back(static_cast<int32_t>(i));
+		for (size_t m = 0; ok && m < asset.meshes.size(); ++m)
+		{
+			std::vector<int32_t> users = topology->GetMeshUsers(static_cast<int32_t>(m));
+			std::sort(users.begin(), users.end());
+			ok = users == meshUsers[m];
+		}
+
+		if (!ok)
+			fprintf(stderr, "\nError: topology of %s does not match its nodes %s\n", filepath.c_str(), when);
+		return ok;
+	};
+
+	if (!check("after the load"))
+		return false;
+
+	// the last node under the first root, unless it is that root or above it. The root can't go under it then, that error is expected.
+	const int32_t root = topology->GetRoots().front();
+	const int32_t node = static_cast<int32_t>(asset.nodes.size() - 1);
+	if (node != root && !topology->IsAncestor(node, root))
+	{
+		if (!topology->SetParent(asset, node, root) || !topology->IsAncestor(root, node) || topology->GetParent(node) != root ||
+			topology->SetParent(asset, root, node))
+		{
+			fprintf(stderr, "\nError: moving nodes[%d] of %s under nodes[%d] went wrong\n", node, filepath.c_str(), root);
+			return false;
+		}
+	}
+
+	const int32_t added = topology->AddNode(asset, "testprogram_added");
+	if (added != static_cast<int32_t>(asset.nodes.size() - 1) || topology->FindNode("testprogram_added") != added ||
+		!topology->SetParent(asset, added, node))
+	{
+		fprintf(stderr, "\nError: adding a node to %s went wrong\n", filepath.c_str());
+		return false;
+	}
+
+	return check("after the edits");
+}
+
+// A view with a stride that isn't the element size over all of buffer 0 after the first view, and a copy of the first accessor
+// with sparse values from a buffer in memory. Added the same way to both assets, the offsets only differ by the hole.
+static void AddStridedAndSparse(EGLTF::SGLTFAsset& asset)
+{
+	const int64_t begin = asset.bufferViews[0].byteOffset;
+	const int64_t stride = 28;
+
+	EGLTF::SGLTFAsset_Prop_BufferView strided;
+	strided.buffer = 0;
+	strided.byteOffset = begin;
+	strided.byteLength = asset.buffers[0].byteLength - begin;
+	strided.byteStride = static_cast<int32_t>(stride);
+	asset.bufferViews.push_back(strided);
+
+	EGLTF::SGLTFAsset_Prop_Accessor accessor;
+	accessor.bufferView = static_cast<int32_t>(asset.bufferViews.size() - 1);
+	accessor.byteOffset = 0;
+	accessor.componentType = 5126;
+	accessor.type = "VEC3";
+	accessor.count = (strided.byteLength - 12) / stride + 1;
+	asset.accessors.push_back(accessor);
+
+	// indices and values of the sparse accessor
+	const EGLTF::SGLTFAsset_Prop_Accessor& base = asset.accessors[0];
+	const uint32_t elementSize = EGLTF::GetGLTFElementSize(base.componentType, base.type);
+	const uint32_t indices[] = { 0, 3, static_cast<uint32_t>(base.count / 2), static_cast<uint32_t>(base.count - 1) };
+
+	EGLTF::SGLTFAsset_Prop_Buffer buffer;
+	buffer.data.resize(sizeof(indices) + 4 * elementSize);
+	memcpy(buffer.data.data(), indices, sizeof(indices));
+	for (size_t i = sizeof(indices); i < buffer.data.size(); ++i)
+		buffer.data[i] = static_cast<uint8_t>(i * 37);
+	buffer.byteLength = static_cast<int64_t>(buffer.data.size());
+	asset.buffers.push_back(buffer);
+
+	EGLTF::SGLTFAsset_Prop_BufferView sparseIndices;
+	sparseIndices.buffer = static_cast<int32_t>(asset.buffers.size() - 1);
+	sparseIndices.byteOffset = 0;
+	sparseIndices.byteLength = sizeof(indices);
+	asset.bufferViews.push_back(sparseIndices);
+
+	EGLTF::SGLTFAsset_Prop_BufferView sparseValues = sparseIndices;
+	sparseValues.byteOffset = sizeof(indices);
+	sparseValues.byteLength = 4 * elementSize;
+	asset.bufferViews.push_back(sparseValues);
+
+	EGLTF::SGLTFAsset_Prop_Accessor sparse = base;
+	sparse.sparse.count = 4;
+	sparse.sparse.indices = std::make_pair(static_cast<int32_t>(asset.bufferViews.size() - 2), 5125);
+	sparse.sparse.values = static_cast<int32_t>(asset.bufferViews.size() - 1);
+	asset.accessors.push_back(sparse);
+}
+
+// Every accessor of the holed asset, loaded deferred, read a range at a time from past 4 GB against the whole of it in the reference
+static bool TestLargeOffsets()
+{
+	EGLTF::CEasyGLTF reference, holed;
+	holed.SetDeferResources(true);
+	if (!Load(reference, HOLED_REFERENCE) || !Load(holed, HOLED_ASSET))
+		return false;
+
+	EGLTF::SGLTFAsset& expected = reference.GetAssetInstance();
+	EGLTF::SGLTFAsset& asset = holed.GetAssetInstance();
+	if (asset.accessors.size() != expected.accessors.size() || asset.bufferViews.size() != expected.bufferViews.size() || asset.buffers.size() != 1 ||
+		!asset.buffers[0].data.empty())
+	{
+		fprintf(stderr, "\nError: %s and %s don't have the same layout\n", HOLED_ASSET, HOLED_REFERENCE);
+		return false;
+	}
+
+	const int64_t hole = asset.bufferViews[0].byteOffset - expected.bufferViews[0].byteOffset;
+	for (size_t i = 0; i < asset.bufferViews.size(); ++i)
+	{
+		if (asset.bufferViews[i].byteOffset - expected.bufferViews[i].byteOffset != hole || asset.bufferViews[i].byteOffset <= (int64_t(4) << 30))
+		{
+			fprintf(stderr, "\nError: bufferViews[%zu] of %s is not past 4 GB by the hole\n", i, HOLED_ASSET);
+			return false;
+		}
+	}
+
+	AddStridedAndSparse(expected);
+	AddStridedAndSparse(asset);
+
+	uint64_t state = 1;
+	auto random = [&state](uint64_t range)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return range > 0 ? (state >> 33) % range : 0;
+	};
+
+	std::vector<uint8_t> all, part;
+	for (size_t i = 0; i < asset.accessors.size(); ++i)
+	{
+		const int32_t accessor = static_cast<int32_t>(i);
+		const uint64_t count = static_cast<uint64_t>(expected.accessors[i].count);
+		const uint64_t elementSize = EGLTF::GetGLTFElementSize(expected.accessors[i].componentType, expected.accessors[i].type);
+		if (!EGLTF::ReadGLTFAccessorBytes(expected, accessor, all) || all.size() != count * elementSize)
+		{
+			fprintf(stderr, "\nError: accessors[%zu] of %s can't be read\n", i, HOLED_REFERENCE);
+			return false;
+		}
+
+		// all of it, then a few ranges anywhere in it
+		for (int r = 0; r < 5; ++r)
+		{
+			const uint64_t first = r == 0 ? 0 : random(count);
+			const uint64_t length = r == 0 ? count : 1 + random(count - first);
+			if (!EGLTF::ReadGLTFAccessorRange(asset, accessor, first, length, holed.GetFileSystem(), holed.GetDirectory(), part) ||
+				part.size() != length * elementSize || memcmp(part.data(), all.data() + first * elementSize, part.size()) != 0)
+			{
+				fprintf(stderr, "\nError: elements %llu to %llu of accessors[%zu] of %s don't match %s\n", static_cast<unsigned long long>(first),
+					static_cast<unsigned long long>(first + length), i, HOLED_ASSET, HOLED_REFERENCE);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
 
 int main(int argc, char** argv)
 {
 	EGLTF::CEasyGLTF* easygltf = new EGLTF::CEasyGLTF();
 
+	EGLTF::CGLTFProgressPrinter printer;
+	easygltf->SetLoadListener(&printer);
+
 	if (!easygltf->LoadGLTF_file("Monster/glTF-Embedded/Monster.gltf"))
 	{
 		return 1;
 	}
 
+	delete easygltf;
+
+	// more threads than cores is fine, what matters is that the results don't depend on them
+	EGLTF::CGLTFThreadPool pool(4);
+
+	std::vector<std::string> assets(std::begin(MONSTER_VARIANTS), std::end(MONSTER_VARIANTS));
+	if (!Generate(GENERATED_ASSET, GENERATED_ARGS))
+		return 1;
+	assets.push_back(GENERATED_ASSET);
+
+	bool ok = Generate(RENDER_ASSET, RENDER_ARGS) && TestRender(RENDER_ASSET, pool);
+	remove(RENDER_ASSET);
+
+	ok = ok && Generate(EVENTS_ASSET, EVENTS_ARGS) && TestLoadEvents(EVENTS_ASSET, pool) && TestProgressive(EVENTS_ASSET, pool) &&
+		TestFilteredLoad(EVENTS_ASSET) && TestMemoryFileSystem(EVENTS_ASSET, pool);
+	for (const char* file : EVENTS_FILES)
+		remove(file);
+
+	ok = ok && Generate(RELOAD_ASSET, RELOAD_ARGS) && TestReload(RELOAD_ASSET);
+	for (const char* file : RELOAD_FILES)
+		remove(file);
+
+	ok = ok && Generate(SPLIT_ASSET, SPLIT_ARGS) && TestSplitParse(SPLIT_ASSET, pool);
+	remove(SPLIT_ASSET);
+	remove(SPLIT_BINARY);
+
+	ok = ok && Generate(HOLED_ASSET, std::string(HOLED_ARGS) + HOLE_ARGS) && Generate(HOLED_REFERENCE, HOLED_ARGS) && TestLargeOffsets();
+	remove(HOLED_ASSET);
+	remove(HOLED_BINARY);
+	remove(HOLED_REFERENCE);
+
+	for (size_t i = 0; ok && i < assets.size(); ++i)
+	{
+		const std::string& asset = assets[i];
+		ok = TestLoadEvents(asset, pool) && TestProgressive(asset, pool) && TestFilteredLoad(asset) && TestMemoryFileSystem(asset, pool) &&
+			TestCompactValidation(asset) && TestSparseValidation(asset) && TestSnapshot(asset) && TestGeometry(asset, pool) && TestInstancing(asset, pool) && TestMegaBuffer(asset, pool) &&
+			TestMeshlets(asset, pool) && TestAnimations(asset, pool) && TestQuantize(asset, pool) && TestTopology(asset);
+	}
+
+	remove(GENERATED_ASSET);
+	if (!ok)
+		return 1;
+
+	printf("\nAll checks passed\n");
 	return 0;
 }